@@ -0,0 +1,21 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout (std140, set = 0, binding = 0) uniform bufferVals {
+    float brightFactor;// 亮度调节系数
+} myBufferVals;
+
+layout (push_constant) uniform constantVals {
+    layout (offset = 64) uint texIndex;// 纹理在纹理表中的索引(前64字节为顶点着色器的最终变换矩阵)
+} myConstantVals;
+
+layout (set = 1, binding = 0) uniform sampler2D texTable[];// 纹理表，所有纹理共用一个描述集
+layout (location = 0) in vec2 inTexCoor;// 接收的顶点纹理坐标
+layout (location = 0) out vec4 outColor;// 输出到管线的片元颜色
+
+void main() {
+    outColor = myBufferVals.brightFactor * textureLod(texTable[myConstantVals.texIndex], inTexCoor, 0.0); // 计算最终颜色值
+}
@@ -0,0 +1,51 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (std140, set = 0, binding = 0) uniform vtParams {
+    ivec4 virtualInfo;// 第0级宽高, 第0级水平/竖直页数
+    ivec4 cacheInfo;// 物理缓存每行槽位数, 槽位行数, mip级数, 瓦片内容边长
+} params;
+layout (set = 0, binding = 1) uniform sampler2D physicalCache;// 物理缓存纹理
+layout (set = 0, binding = 2) uniform sampler2D indirection;// 间接纹理(槽位列号, 槽位行号, mip级, 是否有效)
+#ifdef VT_FEEDBACK
+layout (std430, set = 0, binding = 3) buffer feedbackVals {
+    uint requestMip[];// 第0级每页本帧需要的最细mip级
+} feedback;
+#endif
+layout (location = 0) in vec2 inTexCoor;// 接收的顶点纹理坐标
+layout (location = 0) out vec4 outColor;// 输出到管线的片元颜色
+
+const float TILE_SIZE = 128.0;// 瓦片边长(含边框), 与VT_TILE_SIZE一致
+const float TILE_BORDER = 4.0;// 瓦片边框, 与VT_TILE_BORDER一致
+
+void main() {
+    vec2 uv = clamp(inTexCoor, 0.0, 1.0);
+    vec2 texel0 = uv * vec2(params.virtualInfo.xy);// 第0级纹素坐标
+    int content = params.cacheInfo.w;
+    ivec2 page0 = min(ivec2(texel0) / content, params.virtualInfo.zw - 1);// 第0级页号
+
+    vec2 dx = dFdx(texel0);// 由屏幕空间导数估计需要的mip级
+    vec2 dy = dFdy(texel0);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+    int wantMip = min(int(lod), params.cacheInfo.z - 1);
+#ifdef VT_FEEDBACK
+    atomicMin(feedback.requestMip[page0.y * params.virtualInfo.z + page0.x], uint(wantMip));// 记录请求
+#endif
+
+    vec4 entry = texelFetch(indirection, page0, 0);
+    if (entry.a < 0.5) {// 最粗一级尚未常驻
+        outColor = vec4(0.5, 0.5, 0.5, 1.0);
+        return;
+    }
+    ivec3 mapping = ivec3(entry.rgb * 255.0 + 0.5);
+    int mip = mapping.z;
+    ivec2 mipSize = max(params.virtualInfo.xy >> mip, ivec2(1));// 与VirtualTexture::pagesX/pagesY的计算一致
+    ivec2 mipPages = (mipSize + content - 1) / content;
+    ivec2 page = min(page0 >> mip, mipPages - 1);
+    vec2 local = uv * vec2(mipSize) - vec2(page * content);// 页内坐标, 限制在边框之内
+    local = clamp(local, vec2(0.5 - TILE_BORDER), vec2(float(content) + TILE_BORDER - 0.5));
+    vec2 cachePos = vec2(mapping.xy) * TILE_SIZE + TILE_BORDER + local;
+    outColor = textureLod(physicalCache, cachePos / (vec2(params.cacheInfo.xy) * TILE_SIZE), 0.0);
+}
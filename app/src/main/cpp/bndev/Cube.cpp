@@ -15,46 +15,47 @@
 //void Cube::drawSelf(VkCommandBuffer cmd,
 //                    VkPipelineLayout &pipelineLayout,
 //                    VkPipeline &pipeline,
-//                    VkDescriptorSet *desSetPointer) {
+//                    VkDescriptorSet *desSetPointer,
+//                    uint32_t uniformOffset) {
 //  // 前
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, 0, UNIT_SIZE);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 后
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, 0, -UNIT_SIZE);
 //  MatrixState3D::rotate(180, 0, 1, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 左
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(-UNIT_SIZE, 0, 0);
 //  MatrixState3D::rotate(-90, 0, 1, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 右
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(UNIT_SIZE, 0, 0);
 //  MatrixState3D::rotate(90, 0, 1, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 上
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, UNIT_SIZE, 0);
 //  MatrixState3D::rotate(-90, 1, 0, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 下
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, -UNIT_SIZE, 0);
 //  MatrixState3D::rotate(90, 1, 0, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //}
 
@@ -72,32 +73,33 @@ Cube::Cube(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties,
 void Cube::drawSelf(VkCommandBuffer cmd,
                     VkPipelineLayout &pipelineLayout,
                     VkPipeline &pipeline,
-                    VkDescriptorSet *desSetPointer) {
+                    VkDescriptorSet *desSetPointer,
+                    uint32_t uniformOffset) {
   // 绘制前小面
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, 0, unit_size);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 绘制后小面
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, 0, -unit_size);
 //  MatrixState3D::rotate(180, 0, 1, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 绘制上大面
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, unit_size, 0);
 //  MatrixState3D::rotate(-90, 1, 0, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 绘制下大面
 //  MatrixState3D::pushMatrix();
 //  MatrixState3D::translate(0, -unit_size, 0);
 //  MatrixState3D::rotate(90, 1, 0, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 绘制左大面
@@ -105,7 +107,7 @@ void Cube::drawSelf(VkCommandBuffer cmd,
 //  MatrixState3D::translate(unit_size, 0, 0);
 //  MatrixState3D::rotate(-90, 1, 0, 0);
 //  MatrixState3D::rotate(90, 0, 1, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 //
 //  // 绘制右大面
@@ -113,7 +115,7 @@ void Cube::drawSelf(VkCommandBuffer cmd,
 //  MatrixState3D::translate(-unit_size, 0, 0);
 //  MatrixState3D::rotate(90, 1, 0, 0);
 //  MatrixState3D::rotate(-90, 0, 1, 0);
-//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer);
+//  colorRect->drawSelf(cmd, pipelineLayout, pipeline, desSetPointer, uniformOffset);
 //  MatrixState3D::popMatrix();
 }
 
@@ -13,7 +13,8 @@ class Cube {
   void drawSelf(VkCommandBuffer cmd,
                 VkPipelineLayout &pipelineLayout,
                 VkPipeline &pipeline,
-                VkDescriptorSet *desSetPointer);
+                VkDescriptorSet *desSetPointer,
+                uint32_t uniformOffset);
 
 //  Cube(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties);
   /// Sample4_12
@@ -4,11 +4,29 @@
 #include <cassert>
 #include <chrono>
 #include <ctime>
+#include <cstring>
+#include <algorithm>
 
 #include "../util/FileUtil.h"
 #include "../util/TextureManager.h"
+#include "../util/StagingRing.h"
+#include "../util/DeviceMemoryAllocator.h"
+#include "../util/AsyncUploader.h"
+#include "../util/GeometryBuffer.h"
+#include "../util/GeometryPool.h"
+#include "../util/DeviceMemoryDefragmenter.h"
+#include "../util/ParallelRecorder.h"
+#include "../util/CommandBufferCache.h"
+#include "../util/UniformRing.h"
+#include "../util/TextureStreamer.h"
+#include "../util/BindlessTextureTable.h"
+#include "../util/VirtualTextureManager.h"
 #include "../util/HelpFunction.h"
-#include "../util/FPSUtil.h"
+#include "../util/FramePacer.h"
+#include "../util/JobSystem.h"
+#include "../util/GpuTimer.h"
+#include "../util/HeadlessRenderer.h"
+#include "../util/ResourceStateTracker.h"
 #include "MyVulkanManager.h"
 #include "ThreadTask.h"
 #include "TriangleData.h"
@@ -28,7 +46,15 @@
 
 // 静态成员实现
 android_app *MyVulkanManager::Android_application;
-bool MyVulkanManager::loopDrawFlag = true;
+std::atomic<bool> MyVulkanManager::loopDrawFlag(true);
+std::mutex MyVulkanManager::windowMutex;
+std::condition_variable MyVulkanManager::windowCond;
+bool MyVulkanManager::vulkanRunning = false;
+std::atomic<bool> MyVulkanManager::windowReady(false);
+std::atomic<bool> MyVulkanManager::drawPaused(false);
+bool MyVulkanManager::surfaceInUse = false;
+bool MyVulkanManager::queueFamiliesChosen = false;
+std::atomic<bool> MyVulkanManager::swapChainOutOfDate(false);
 std::vector<const char *>  MyVulkanManager::instanceExtensionNames;
 VkInstance MyVulkanManager::instance;
 uint32_t MyVulkanManager::gpuCount;
@@ -37,40 +63,51 @@ uint32_t MyVulkanManager::queueFamilyCount;
 std::vector<VkQueueFamilyProperties> MyVulkanManager::queueFamilyprops;
 uint32_t MyVulkanManager::queueGraphicsFamilyIndex;
 VkQueue MyVulkanManager::queueGraphics;
+uint32_t MyVulkanManager::queueTransferFamilyIndex;
+VkQueue MyVulkanManager::queueTransfer;
 uint32_t MyVulkanManager::queuePresentFamilyIndex;
 std::vector<const char *> MyVulkanManager::deviceExtensionNames;
+bool MyVulkanManager::displayTimingSupported = false;
 VkDevice MyVulkanManager::device;
 VkCommandPool MyVulkanManager::cmdPool;
 VkCommandBuffer MyVulkanManager::cmdBuffer;
+FrameContext MyVulkanManager::frames[MAX_FRAMES_IN_FLIGHT];
+int MyVulkanManager::framesInFlight = FRAMES_IN_FLIGHT;
+int MyVulkanManager::frameIndex = 0;
 VkCommandBufferBeginInfo MyVulkanManager::cmd_buf_info;
 VkCommandBuffer  MyVulkanManager::cmd_bufs[1];
 VkSubmitInfo MyVulkanManager::submit_info[1];
 uint32_t MyVulkanManager::screenWidth;
 uint32_t MyVulkanManager::screenHeight;
-VkSurfaceKHR MyVulkanManager::surface;
+VkSurfaceKHR MyVulkanManager::surface = VK_NULL_HANDLE;
 std::vector<VkFormat> MyVulkanManager::formats;
 VkSurfaceCapabilitiesKHR MyVulkanManager::surfCapabilities;
 uint32_t MyVulkanManager::presentModeCount;
 std::vector<VkPresentModeKHR> MyVulkanManager::presentModes;
 VkExtent2D MyVulkanManager::swapchainExtent;
-VkSwapchainKHR MyVulkanManager::swapChain;
+VkSwapchainKHR MyVulkanManager::swapChain = VK_NULL_HANDLE;
 uint32_t MyVulkanManager::swapchainImageCount;
 std::vector<VkImage> MyVulkanManager::swapchainImages;
 std::vector<VkImageView> MyVulkanManager::swapchainImageViews;
 VkFormat MyVulkanManager::depthFormat;
 VkFormatProperties MyVulkanManager::depthFormatProps;
-VkImage MyVulkanManager::depthImage;
 VkPhysicalDeviceMemoryProperties MyVulkanManager::memoryroperties;
-VkDeviceMemory MyVulkanManager::memDepth;
-VkImageView MyVulkanManager::depthImageView;
-VkSemaphore MyVulkanManager::imageAcquiredSemaphore;
+std::vector<VkSemaphore> MyVulkanManager::renderFinishedSemaphores;
+std::vector<VkFence> MyVulkanManager::imageFences;
+std::vector<VkSemaphore> MyVulkanManager::frameWaitSemaphores;
+std::vector<VkPipelineStageFlags> MyVulkanManager::frameWaitStages;
 uint32_t MyVulkanManager::currentBuffer;
 VkRenderPass MyVulkanManager::renderPass;
-VkClearValue MyVulkanManager::clear_values[2];
-VkRenderPassBeginInfo MyVulkanManager::rp_begin;
-VkFence MyVulkanManager::taskFinishFence;
+RGResource MyVulkanManager::colorTarget = -1;
+RGResource MyVulkanManager::depthTarget = -1;
+RGPass MyVulkanManager::scenePass = -1;
+std::map<std::pair<VkDescriptorSet, uint32_t>, std::vector<char> > MyVulkanManager::writtenDescriptors;
+bool MyVulkanManager::framesInFlightBenchmark = false;
+bool MyVulkanManager::commandCacheBenchmark = false;
+int MyVulkanManager::gridCacheEntry = -1;
+float MyVulkanManager::gridCacheXAngle = 0;
+float MyVulkanManager::gridCacheYAngle = 0;
 VkPresentInfoKHR MyVulkanManager::present;
-VkFramebuffer *MyVulkanManager::framebuffers;
 ShaderQueueSuit_Common *MyVulkanManager::sqsCL;
 float MyVulkanManager::xAngle = 0;
 
@@ -137,6 +174,13 @@ ColorObject *MyVulkanManager::skyForDrawBig;
 ColorObject *MyVulkanManager::skyForDrawSmall;
 DrawableObjectCommon *MyVulkanManager::planetForDraw;
 
+/// 无绑定纹理
+ShaderQueueSuit_Bindless *MyVulkanManager::sqsBL;
+std::vector<uint32_t> MyVulkanManager::texIndexList;
+
+/// 虚拟纹理
+ShaderQueueSuit_VirtualTexture *MyVulkanManager::sqsVT;
+
 /**
  * 创建Vulkan实例的方法
  */
@@ -161,8 +205,11 @@ void MyVulkanManager::init_vulkan_instance() {
   inst_info.pNext = nullptr;                                                // 自定义数据的指针
   inst_info.flags = 0;                                                      // 供将来使用的标志
   inst_info.pApplicationInfo = &app_info;                                   // 绑定应用信息结构体
-  instanceExtensionNames.push_back(VK_KHR_SURFACE_EXTENSION_NAME);          // 该扩展名称列表用于支持KHR表面
-  instanceExtensionNames.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);  // 该扩展名称列表用于支持Android下的KHR表面
+  if (!HeadlessRenderer::enabled) {                                         // 离屏无窗口模式不创建表面
+    instanceExtensionNames.push_back(VK_KHR_SURFACE_EXTENSION_NAME);        // 该扩展名称列表用于支持KHR表面
+    instanceExtensionNames.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME); // 该扩展名称列表用于支持Android下的KHR表面
+  }
+//  BindlessTextureTable::addInstanceExtensions(instanceExtensionNames);      // 无绑定纹理-查询设备特性所需的实例扩展
   inst_info.enabledExtensionCount = instanceExtensionNames.size();          // 扩展的数量
   inst_info.ppEnabledExtensionNames = instanceExtensionNames.data();        // 扩展名称列表数据
   inst_info.enabledLayerCount = 0;                                          // 启动的层数量
@@ -235,7 +282,28 @@ void MyVulkanManager::create_vulkan_devices() {
   queueInfo.queueCount = 1;                                                 // 指定队列数量
   queueInfo.pQueuePriorities = queue_priorities;                            // 给出每个队列的优先级
   queueInfo.queueFamilyIndex = queueGraphicsFamilyIndex;                    // 绑定队列家族索引
-  deviceExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);          // 设置逻辑设备所需的扩展名称列表，使创建的设备支持交换链的使用
+
+  // 优先选用独立的传输队列家族执行异步上传, 没有时与图形工作共用同一队列
+  queueTransferFamilyIndex = AsyncUploader::selectTransferFamily(queueFamilyprops, queueGraphicsFamilyIndex);
+  LOGI("the queue family index for async uploads is %d", queueTransferFamilyIndex);
+  VkDeviceQueueCreateInfo queueInfos[2] = {queueInfo, queueInfo};           // 图形队列与传输队列
+  queueInfos[1].queueFamilyIndex = queueTransferFamilyIndex;
+  uint32_t queueInfoCount = queueTransferFamilyIndex == queueGraphicsFamilyIndex ? 1 : 2;
+  if (!HeadlessRenderer::enabled) {                                         // 离屏无窗口模式不创建交换链
+    deviceExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);        // 设置逻辑设备所需的扩展名称列表，使创建的设备支持交换链的使用
+  }
+  uint32_t extensionCount = 0;
+  vk::vkEnumerateDeviceExtensionProperties(gpus[0], nullptr, &extensionCount, nullptr); // 获取设备扩展数量
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vk::vkEnumerateDeviceExtensionProperties(gpus[0], nullptr, &extensionCount, extensions.data());
+  displayTimingSupported = false;
+  for (uint32_t i = 0; i < extensionCount; ++i) {                           // 支持时启用显示时序扩展, 帧节奏按显示器刷新周期对齐
+    if (!HeadlessRenderer::enabled &&                                       // 离屏无窗口模式没有交换链
+        strcmp(extensions[i].extensionName, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) == 0) {
+      displayTimingSupported = true;
+      deviceExtensionNames.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    }
+  }
 
   /// Sample4_7、Sample6_11 *************************************** start
   VkPhysicalDeviceFeatures pdf;                                             // 构建物理设备属性实例
@@ -251,8 +319,8 @@ void MyVulkanManager::create_vulkan_devices() {
   VkDeviceCreateInfo deviceInfo = {};                                       // 构建逻辑设备创建信息结构体实例
   deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;                  // 给出结构体类型
   deviceInfo.pNext = nullptr;                                               // 自定义数据的指针
-  deviceInfo.queueCreateInfoCount = 1;                                      // 指定设备队列创建信息结构体数量
-  deviceInfo.pQueueCreateInfos = &queueInfo;                                // 给定设备队列创建信息结构体列表
+  deviceInfo.queueCreateInfoCount = queueInfoCount;                        // 指定设备队列创建信息结构体数量
+  deviceInfo.pQueueCreateInfos = queueInfos;                                // 给定设备队列创建信息结构体列表
   deviceInfo.enabledExtensionCount = deviceExtensionNames.size();           // 所需扩展数量
   deviceInfo.ppEnabledExtensionNames = deviceExtensionNames.data();         // 所需扩展列表
   deviceInfo.enabledLayerCount = 0;                                         // 需启动Layer的数量
@@ -261,15 +329,25 @@ void MyVulkanManager::create_vulkan_devices() {
   /// Sample4_7-创建的逻辑设备启用所有设备能够支持的特性(绘制宽度大于1的线需要启用wideLines特性)
   deviceInfo.pEnabledFeatures = &pdf;
 
+  /// 无绑定纹理 ************************************************** start
+//  BindlessTextureTable::checkSupport(instance, gpus[0]);                  // 检查描述符索引特性, 不支持时自动退回传统方式
+//  BindlessTextureTable::enableDeviceFeatures(deviceInfo, deviceExtensionNames); // 启用所需扩展与特性
+  /// 无绑定纹理 **************************************************** end
+
   VkResult result = vk::vkCreateDevice(gpus[0], &deviceInfo, nullptr, &device); // 创建逻辑设备
   assert(result == VK_SUCCESS);                                             // 检查逻辑设备是否创建成功
+  DeviceMemoryAllocator::init(gpus[0]);                                     // 之后所有缓冲与图像的内存都从子分配器分配
+  UniformRing::create(device, gpus[0]);                                     // 创建所有管线共用的每帧一致变量环形缓冲
 }
 
 /**
  * 销毁逻辑设备
  */
 void MyVulkanManager::destroy_vulkan_devices() {
+  UniformRing::destroy(device);                                             // 销毁一致变量环形缓冲
+  DeviceMemoryAllocator::destroy(device);                                   // 释放所有设备内存块
   vk::vkDestroyDevice(device, nullptr);
+  queueFamiliesChosen = false;                                              // 绘制线程重新启动时在新表面上重新选定
   LOGI("destroy_vulkan_devices completed！");
 }
 
@@ -291,8 +369,14 @@ void MyVulkanManager::create_vulkan_CommandBuffer() {
   cmdBAI.commandPool = cmdPool;                                             // 指定命令池
   cmdBAI.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;                           // 分配的命令缓冲级别(主命令缓冲)
   cmdBAI.commandBufferCount = 1;                                            // 分配的命令缓冲数量
-  result = vk::vkAllocateCommandBuffers(device, &cmdBAI, &cmdBuffer);       // 分配命令缓冲
-  assert(result == VK_SUCCESS);                                             // 检查分配是否成功
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {                          // 每个在途帧一个命令缓冲
+    result = vk::vkAllocateCommandBuffers(device, &cmdBAI, &frames[i].cmdBuffer); // 分配命令缓冲
+    assert(result == VK_SUCCESS);                                           // 检查分配是否成功
+  }
+  cmdBuffer = frames[0].cmdBuffer;                                          // 初始化阶段(纹理上传等)使用0号帧的命令缓冲
+  ParallelRecorder::create(device, queueGraphicsFamilyIndex, MAX_FRAMES_IN_FLIGHT); // 每个在途帧、每段一个命令池
+  CommandBufferCache::create(device, queueGraphicsFamilyIndex);             // 静态场景的二级命令缓冲在各帧间重用
+  GpuTimer::create(device, gpus[0], queueGraphicsFamilyIndex, MAX_FRAMES_IN_FLIGHT); // 每个在途帧一对时间戳查询
 
   cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;         // 给定结构体类型
   cmd_buf_info.pNext = nullptr;                                             // 自定义数据的指针
@@ -315,37 +399,53 @@ void MyVulkanManager::create_vulkan_CommandBuffer() {
  * 销毁命令缓冲
  */
 void MyVulkanManager::destroy_vulkan_CommandBuffer() {
-  VkCommandBuffer cmdBufferArray[1] = {cmdBuffer};                          // 创建要释放的命令缓冲数组
+  ParallelRecorder::destroy(device);                                        // 销毁各段的命令池
+  CommandBufferCache::destroy(device);                                      // 销毁缓存的二级命令缓冲
+  GpuTimer::destroy(device);                                                // 销毁时间戳查询池
+  VkCommandBuffer cmdBufferArray[MAX_FRAMES_IN_FLIGHT];                     // 创建要释放的命令缓冲数组
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    cmdBufferArray[i] = frames[i].cmdBuffer;
+  }
   vk::vkFreeCommandBuffers(                                                 // 释放命令缓冲
       device,                                                               // 所属逻辑设备
       cmdPool,                                                              // 所属命令池
-      1,                                                                    // 要销毁的命令缓冲数量
+      MAX_FRAMES_IN_FLIGHT,                                                 // 要销毁的命令缓冲数量
       cmdBufferArray                                                        // 要销毁的命令缓冲数组
   );
   vk::vkDestroyCommandPool(device, cmdPool, nullptr);                       // 销毁命令池
 }
 
 /**
- * 创建绘制用交换链
+ * 创建KHR表面
+ * 在windowMutex下重新检查窗口是否可用并标记表面在用, 窗口在此之前已终止(首次初始化期间或重建之前)时等待新窗口,
+ * 等待期间应用销毁则不创建并返回false; 标记之后onWindowTerm须等待表面释放才返回, 窗口不会在使用期间失效
+ * 第一次创建时选定同时支持图形与显示工作的队列家族; 窗口重建后逻辑设备保持不变, 只检查原队列家族能否在新表面上呈现
  */
-void MyVulkanManager::create_vulkan_swapChain() {
-  screenWidth = ANativeWindow_getWidth(Android_application->window);        // 获取屏幕宽度
-  screenHeight = ANativeWindow_getHeight(Android_application->window);      // 获取屏幕高度
-  LOGI("screen width: %d screen height: %d", screenWidth, screenHeight);
-
-  VkAndroidSurfaceCreateInfoKHR createInfo;                                 // 构建KHR表面创建信息结构体实例
-  createInfo.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;     // 给定结构体类型
-  createInfo.pNext = nullptr;                                               // 自定义数据的指针
-  createInfo.flags = 0;                                                     // 供未来使用的标志
-  createInfo.window = Android_application->window;                          // 给定窗体
+bool MyVulkanManager::create_vulkan_surface() {
+  if (HeadlessRenderer::enabled) {                                          // 离屏无窗口模式不创建表面
+    return true;
+  }
   auto fpCreateAndroidSurfaceKHR =                                          // 动态加载创建KHR表面的方法
       (PFN_vkCreateAndroidSurfaceKHR) vk::vkGetInstanceProcAddr(instance,
                                                                 "vkCreateAndroidSurfaceKHR"); // 加载Android平台所需方法
   if (fpCreateAndroidSurfaceKHR == nullptr) {
     LOGE("can't find extension function: vkCreateAndroidSurfaceKHR");
   }
+  std::unique_lock<std::mutex> lock(windowMutex);
+  windowCond.wait(lock, [] { return windowReady || !loopDrawFlag; });      // 窗口已终止时等待新窗口或应用销毁
+  if (!windowReady) {
+    LOGI("app destroyed while waiting for a window, surface not created");
+    return false;
+  }
+  VkAndroidSurfaceCreateInfoKHR createInfo;                                 // 构建KHR表面创建信息结构体实例
+  createInfo.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;     // 给定结构体类型
+  createInfo.pNext = nullptr;                                               // 自定义数据的指针
+  createInfo.flags = 0;                                                     // 供未来使用的标志
+  createInfo.window = Android_application->window;                          // 给定窗体
   VkResult result = fpCreateAndroidSurfaceKHR(instance, &createInfo, nullptr, &surface); // 创建Android平台用KHR表面
   assert(result == VK_SUCCESS);
+  surfaceInUse = true;                                                      // 之后窗口终止时主线程等待表面释放
+  lock.unlock();
 
   auto *pSupportsPresent = (VkBool32 *) malloc(queueFamilyCount * sizeof(VkBool32));
   for (uint32_t i = 0; i < queueFamilyCount; ++i) {                         // 遍历设备对应的队列家族列表
@@ -353,28 +453,34 @@ void MyVulkanManager::create_vulkan_swapChain() {
     LOGI("queue family Index = %d %s Present", i, (pSupportsPresent[i] == 1 ? "support" : "NOT support"));
   }
 
-  queueGraphicsFamilyIndex = UINT32_MAX;                                    // 支持图形工作的队列家族索引
-  queuePresentFamilyIndex = UINT32_MAX;                                     // 支持显示(呈现)工作的队列家族索引
-  for (uint32_t i = 0; i < queueFamilyCount; ++i) {                         // 遍历设备对应的队列家族列表
-    if ((queueFamilyprops[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {    // 若此队列家族支持图形工作
-      if (queueGraphicsFamilyIndex == UINT32_MAX) {
-        queueGraphicsFamilyIndex = i;                                       // 记录支持图形工作的队列家族索引
-      }
-      if (pSupportsPresent[i] == VK_TRUE) {                                 // 如果当前队列家族支持显示工作
-        queueGraphicsFamilyIndex = i;                                       // 记录此队列家族索引为支持图形工作的
-        queuePresentFamilyIndex = i;                                        // 记录此队列家族索引为支持显示工作的
-        LOGI("queue family index = %d support both Graphics and Present work", i); // 找到既支持图形工作又支持显示工作的队列家族索引
-        break;
+  if (!queueFamiliesChosen) {
+    queueGraphicsFamilyIndex = UINT32_MAX;                                  // 支持图形工作的队列家族索引
+    queuePresentFamilyIndex = UINT32_MAX;                                   // 支持显示(呈现)工作的队列家族索引
+    for (uint32_t i = 0; i < queueFamilyCount; ++i) {                       // 遍历设备对应的队列家族列表
+      if ((queueFamilyprops[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {  // 若此队列家族支持图形工作
+        if (queueGraphicsFamilyIndex == UINT32_MAX) {
+          queueGraphicsFamilyIndex = i;                                     // 记录支持图形工作的队列家族索引
+        }
+        if (pSupportsPresent[i] == VK_TRUE) {                               // 如果当前队列家族支持显示工作
+          queueGraphicsFamilyIndex = i;                                     // 记录此队列家族索引为支持图形工作的
+          queuePresentFamilyIndex = i;                                      // 记录此队列家族索引为支持显示工作的
+          LOGI("queue family index = %d support both Graphics and Present work", i); // 找到既支持图形工作又支持显示工作的队列家族索引
+          break;
+        }
       }
     }
-  }
-  if (queuePresentFamilyIndex == UINT32_MAX) {                              // 若没有找到同时支持两项工作的队列家族
-    for (size_t i = 0; i < queueFamilyCount; ++i) {                         // 遍历设备对应的队列家族列表
-      if (pSupportsPresent[i] == VK_TRUE) {                                 // 判断是否支持显示工作
-        queuePresentFamilyIndex = i;                                        // 记录此队列家族索引为支持显示工作的
-        break;
+    if (queuePresentFamilyIndex == UINT32_MAX) {                            // 若没有找到同时支持两项工作的队列家族
+      for (size_t i = 0; i < queueFamilyCount; ++i) {                       // 遍历设备对应的队列家族列表
+        if (pSupportsPresent[i] == VK_TRUE) {                               // 判断是否支持显示工作
+          queuePresentFamilyIndex = i;                                      // 记录此队列家族索引为支持显示工作的
+          break;
+        }
       }
     }
+    queueFamiliesChosen = true;
+  } else if (pSupportsPresent[queuePresentFamilyIndex] != VK_TRUE) {
+    LOGE("queue family %d can't present to the new surface", queuePresentFamilyIndex);
+    assert(false);                                                          // 设备创建后不能更换队列家族
   }
 
   free(pSupportsPresent);                                                   // 释放存储是否支持呈现工作的布尔值列表
@@ -383,7 +489,46 @@ void MyVulkanManager::create_vulkan_swapChain() {
     LOGE("NOT find queue family supports Graphics or Present work");        // 没有找到支持图形或显示工作的队列家族
     assert(false);                                                          // 若没有支持图形或显示操作的队列家族则程序终止
   }
+  return true;
+}
+
+/**
+ * 销毁KHR表面
+ */
+void MyVulkanManager::destroy_vulkan_surface() {
+  if (surface == VK_NULL_HANDLE) {
+    return;
+  }
+  vk::vkDestroySurfaceKHR(instance, surface, nullptr);
+  std::lock_guard<std::mutex> lock(windowMutex);
+  surface = VK_NULL_HANDLE;
+  surfaceInUse = false;
+  windowCond.notify_all();                                                  // 等待表面释放的主线程可以返回
+  LOGI("Destroy surface success!");
+}
 
+/**
+ * 创建绘制用交换链
+ * 已有交换链时(重建)以其为前导交换链创建新交换链, 之后销毁旧交换链及其图像视图
+ */
+void MyVulkanManager::create_vulkan_swapChain() {
+  if (HeadlessRenderer::enabled) {                                          // 离屏无窗口模式: 以离屏颜色图像代替交换链图像
+    screenWidth = HeadlessRenderer::width;
+    screenHeight = HeadlessRenderer::height;
+    swapchainExtent.width = screenWidth;
+    swapchainExtent.height = screenHeight;
+    formats.assign(1, HEADLESS_COLOR_FORMAT);
+    queuePresentFamilyIndex = queueGraphicsFamilyIndex;                     // 不呈现, 沿用创建设备时选定的图形队列家族
+    swapchainImageCount = HEADLESS_IMAGE_COUNT;
+    HeadlessRenderer::createTargets(device, swapchainImageCount, formats[0], swapchainImages, swapchainImageViews);
+    return;
+  }
+  screenWidth = ANativeWindow_getWidth(Android_application->window);        // 获取屏幕宽度
+  screenHeight = ANativeWindow_getHeight(Android_application->window);      // 获取屏幕高度
+  LOGI("screen width: %d screen height: %d", screenWidth, screenHeight);
+
+  VkFormat previousFormat = formats.empty() ? VK_FORMAT_UNDEFINED : formats[0]; // 重建前的格式(渲染通道与管线按其创建)
+  VkResult result;
   uint32_t formatCount;                                                     // 支持的格式数量
   result = vk::vkGetPhysicalDeviceSurfaceFormatsKHR(gpus[0], surface, &formatCount, nullptr); // 获取KHR表面支持的格式数量
   LOGI("supported format count = %d", formatCount);
@@ -400,6 +545,14 @@ void MyVulkanManager::create_vulkan_swapChain() {
     formats[0] = VK_FORMAT_B8G8R8A8_UNORM;
   }
   free(surfFormats);                                                        // 释放辅助内存
+  if (previousFormat != VK_FORMAT_UNDEFINED && !HeadlessRenderer::enabled) { // 重建时沿用原格式, 渲染通道与管线才能继续使用
+    auto it = std::find(formats.begin(), formats.end(), previousFormat);
+    if (it == formats.end()) {
+      LOGE("new surface doesn't support format %d", previousFormat);
+      assert(false);
+    }
+    std::iter_swap(formats.begin(), it);
+  }
 
   result = vk::vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpus[0], surface, &surfCapabilities); // 获取KHR表面的能力
   assert(result == VK_SUCCESS);
@@ -474,7 +627,7 @@ void MyVulkanManager::create_vulkan_swapChain() {
   swapchain_ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;          // 混合Alpha值
   swapchain_ci.imageArrayLayers = 1;                                        // 图像数组层数
   swapchain_ci.presentMode = swapchainPresentMode;                          // 交换链的显示模式
-  swapchain_ci.oldSwapchain = VK_NULL_HANDLE;                               // 前导交换链
+  swapchain_ci.oldSwapchain = swapChain;                                    // 前导交换链(重建时为被替换的交换链)
   swapchain_ci.clipped = true;                                              // 开启裁剪
   swapchain_ci.imageColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;          // 色彩空间
   swapchain_ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;            // 图像用途(表示将作为帧缓冲的颜色附件使用)
@@ -489,8 +642,25 @@ void MyVulkanManager::create_vulkan_swapChain() {
     swapchain_ci.pQueueFamilyIndices = queueFamilyIndices;                  // 交换链所需的队列家族索引列表
   }
 
+  VkSwapchainKHR oldSwapChain = swapChain;
   result = vk::vkCreateSwapchainKHR(device, &swapchain_ci, nullptr, &swapChain); // 创建交换链
   assert(result == VK_SUCCESS);                                             // 检查交换链是否创建成功
+  if (oldSwapChain != VK_NULL_HANDLE) {                                     // 重建: 旧交换链已被新交换链替换(调用前已等待设备空闲)
+    for (uint32_t i = 0; i < swapchainImageCount; i++) {
+      vk::vkDestroyImageView(device, swapchainImageViews[i], nullptr);
+    }
+    vk::vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+  }
+
+  if (displayTimingSupported) {                                             // 查询显示器刷新周期, 帧间隔取其整数倍
+    auto getRefreshCycleDuration = (PFN_vkGetRefreshCycleDurationGOOGLE) vk::vkGetDeviceProcAddr(
+        device, "vkGetRefreshCycleDurationGOOGLE");
+    VkRefreshCycleDurationGOOGLE refreshCycle = {};
+    if (getRefreshCycleDuration != nullptr &&
+        getRefreshCycleDuration(device, swapChain, &refreshCycle) == VK_SUCCESS) {
+      FramePacer::setRefreshInterval((long long) refreshCycle.refreshDuration);
+    }
+  }
 
   result = vk::vkGetSwapchainImagesKHR(device, swapChain, &swapchainImageCount, nullptr); // 获取交换链中的图像数量
   assert(result == VK_SUCCESS);                                             // 检查是否获取成功
@@ -526,196 +696,63 @@ void MyVulkanManager::create_vulkan_swapChain() {
  * 销毁交换链相关
  */
 void MyVulkanManager::destroy_vulkan_swapChain() {
+  if (HeadlessRenderer::enabled) {
+    HeadlessRenderer::destroyTargets(device, swapchainImages, swapchainImageViews);
+    LOGI("Destroy offscreen targets success!");
+    return;
+  }
+  if (swapChain == VK_NULL_HANDLE) {                                        // 窗口终止时已经销毁
+    return;
+  }
   for (uint32_t i = 0; i < swapchainImageCount; i++) {
     vk::vkDestroyImageView(device, swapchainImageViews[i], nullptr);
     LOGI("Destroy swapchainImageViews[%d] success!", i);
   }
   vk::vkDestroySwapchainKHR(device, swapChain, nullptr);
+  swapChain = VK_NULL_HANDLE;
   LOGI("Destroy SwapChain success!");
 }
 
 /**
- * 创建深度缓冲
+ * 确定深度缓冲的格式
+ * 深度图像由渲染图作为瞬时附件创建: 只在渲染通道内使用、不写回内存, 设备支持时使用惰性分配的内存
  */
 void MyVulkanManager::create_vulkan_DepthBuffer() {
   depthFormat = VK_FORMAT_D16_UNORM;                                      // 指定深度图像的格式
-  VkImageCreateInfo image_info = {};                                      // 构建深度图像创建信息结构体实例
   vk::vkGetPhysicalDeviceFormatProperties(gpus[0], depthFormat, &depthFormatProps); // 获取物理设备支持的指定格式的属性
-
-  // 通过物理设备支持的指定格式的属性确定深度图像的平铺方式
-  if (depthFormatProps.linearTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) { // 是否支持线性瓦片组织方式
-    image_info.tiling = VK_IMAGE_TILING_LINEAR;                           // 采用线性瓦片组织方式
-    LOGI("tiling = VK_IMAGE_TILING_LINEAR!");
-  } else if (depthFormatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) { // 是否支持最优瓦片组织方式
-    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;                          // 采用最优瓦片组织方式
-    LOGI("tiling = VK_IMAGE_TILING_OPTIMAL!");
-  } else {
+  if (!(depthFormatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)) { // 渲染图的附件采用最优瓦片组织方式
     LOGE("unsupported VK_FORMAT_D16_UNORM!");                             // 打印不支持指定格式的提示信息
   }
-
-  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;                 // 指定结构体类型
-  image_info.pNext = nullptr;                                             // 自定义数据的指针
-  image_info.imageType = VK_IMAGE_TYPE_2D;                                // 图像类型
-  image_info.format = depthFormat;                                        // 图像格式
-  image_info.extent.width = screenWidth;                                  // 图像宽度
-  image_info.extent.height = screenHeight;                                // 图像高度
-  image_info.extent.depth = 1;                                            // 图像深度
-  image_info.mipLevels = 1;                                               // 图像Mipmap级数
-  image_info.arrayLayers = 1;                                             // 图像数组层数量
-  image_info.samples = VK_SAMPLE_COUNT_1_BIT;                             // 采样模式
-  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;                   // 初始布局
-  image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;         // 图像用途
-  image_info.queueFamilyIndexCount = 0;                                   // 队列家族数量(共享模式为EXCLUSIVE时应该为0)
-  image_info.pQueueFamilyIndices = nullptr;                               // 队列家族索引列表(共享模式为EXCLUSIVE时应设置为空)
-  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;                     // 共享模式(表示图像不允许被多个队列家族的队列访问，CONCURRENT则允许)
-  image_info.flags = 0;                                                   // 标志
-
-  VkMemoryAllocateInfo mem_alloc = {};                                    // 构建内存分配信息结构体实例
-  mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;               // 结构体类型
-  mem_alloc.pNext = nullptr;                                              // 自定义数据的指针
-  mem_alloc.allocationSize = 0;                                           // 分配的内存字节数
-  mem_alloc.memoryTypeIndex = 0;                                          // 内存的类型索引
-
-  VkImageViewCreateInfo view_info = {};                                   // 构建深度图像视图创建信息结构体实例
-  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;             // 设置结构体类型
-  view_info.pNext = nullptr;                                              // 自定义数据的指针
-  view_info.image = VK_NULL_HANDLE;                                       // 对应的图像
-  view_info.format = depthFormat;                                         // 图像视图的格式
-  view_info.components.r = VK_COMPONENT_SWIZZLE_R;                        // 设置R通道调和
-  view_info.components.g = VK_COMPONENT_SWIZZLE_G;                        // 设置G通道调和
-  view_info.components.b = VK_COMPONENT_SWIZZLE_B;                        // 设置B通道调和
-  view_info.components.a = VK_COMPONENT_SWIZZLE_A;                        // 设置A通道调和
-  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;      // 图像视图使用方面
-  view_info.subresourceRange.baseMipLevel = 0;                            // 基础Mipmap级别
-  view_info.subresourceRange.levelCount = 1;                              // Mipmap级别的数量
-  view_info.subresourceRange.baseArrayLayer = 0;                          // 基础数组层
-  view_info.subresourceRange.layerCount = 1;                              // 数组层的数量
-  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;                             // 图像视图的类型
-  view_info.flags = 0;                                                    // 标志
-
-  VkResult result = vk::vkCreateImage(device, &image_info, nullptr, &depthImage); // 创建深度图像(等待分配内存)
-  assert(result == VK_SUCCESS);
-
-  VkMemoryRequirements mem_reqs;
-  vk::vkGetImageMemoryRequirements(device, depthImage, &mem_reqs);        // 获取图像内存需求
-  mem_alloc.allocationSize = mem_reqs.size;                               // 获取所需内存字节数
-  VkFlags requirements_mask = 0;                                          // 需要的内存类型掩码(0表示无特殊内存要求)
-  bool flag = memoryTypeFromProperties(                                   // 获取所需内存类型索引
-      memoryroperties, mem_reqs.memoryTypeBits, requirements_mask, &mem_alloc.memoryTypeIndex);
-  assert(flag);                                                           // 检查获取是否成功
-  LOGI("confirm memory type success, memoryTypeIndex = %d", mem_alloc.memoryTypeIndex);
-
-  result = vk::vkAllocateMemory(device, &mem_alloc, nullptr, &memDepth);  // 分配内存
-  assert(result == VK_SUCCESS);
-  result = vk::vkBindImageMemory(device, depthImage, memDepth, 0);        // 绑定图像和内存，这才确定图像在设备内存中的存储位置
-  assert(result == VK_SUCCESS);
-  view_info.image = depthImage;                                           // 指定图像视图对应图像
-
-  // Vulkan中的图像不能直接被访问，必须通过配套的图像视图进行访问
-  result = vk::vkCreateImageView(device, &view_info, nullptr, &depthImageView); // 创建深度图像视图
-  assert(result == VK_SUCCESS);
-}
-
-/**
- * 销毁深度缓冲相关
- */
-void MyVulkanManager::destroy_vulkan_DepthBuffer() {
-  vk::vkDestroyImageView(device, depthImageView, nullptr);
-  vk::vkDestroyImage(device, depthImage, nullptr);
-  vk::vkFreeMemory(device, memDepth, nullptr);
-  LOGI("destroy_vulkan_DepthBuffer success!");
 }
 
 /**
  * 创建渲染通道
  */
 void MyVulkanManager::create_render_pass() {
-  VkSemaphoreCreateInfo imageAcquiredSemaphoreCreateInfo;                 // 构建信号量创建信息结构体实例
-  imageAcquiredSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO; // 结构体类型
-  imageAcquiredSemaphoreCreateInfo.pNext = nullptr;                       // 自定义数据的指针
-  imageAcquiredSemaphoreCreateInfo.flags = 0;                             // 供将来使用的标志
-  VkResult result = vk::vkCreateSemaphore(                                // 创建信号量
-      device, &imageAcquiredSemaphoreCreateInfo, nullptr, &imageAcquiredSemaphore);
-  assert(result == VK_SUCCESS);                                           // 检测信号量是否创建成功
-
-  VkAttachmentDescription attachments[2];                                 // 声明了长度为2的附件描述信息数组
-  // 颜色附件描述信息
-  attachments[0].format = formats[0];                                     // 设置颜色附件的格式
-  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;                         // 设置采样模式
-  attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;                    // 子渲染通道开始时的操作(针对颜色附件)
-  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;                  // 子渲染通道结束时的操作(针对颜色附件)
-  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;         // 子渲染通道开始时的操作(针对模板附件)
-  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;       // 子渲染通道结束时的操作(针对模板附件)
-  attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;               // 开始时的布局
-  attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;           // 结束时的最终布局(将画面进行呈现)
-  attachments[0].flags = 0;                                               // 设置位掩码
-  // 深度附件描述信息
-  attachments[1].format = depthFormat;                                    // 设置位深附件的格式
-  attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;                         // 设置采样模式
-  attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;                    // 子渲染通道开始时的操作(针对深度附件)
-  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;              // 子渲染通道结束时的操作(针对深度附件)
-  attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;         // 子渲染通道开始时的操作(针对模板附件)
-  attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;       // 子渲染通道结束时的操作(针对模板附件)
-  attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;               // 开始时的布局
-  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; // 结束时的布局
-  attachments[1].flags = 0;                                               // 设置位掩码
-
-  VkAttachmentReference color_reference = {};                             // 颜色附件引用
-  color_reference.attachment = 0;                                         // 对应附件描述信息数组下标
-  color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;      // 设置附件布局
-
-  VkAttachmentReference depth_reference = {};                             // 深度附件引用
-  depth_reference.attachment = 1;                                         // 对应附件描述信息数组下标
-  depth_reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; // 设置附件布局
-
-  VkSubpassDescription subpass = {};                                      // 构建渲染子通道描述信息结构体实例
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;            // 设置管线绑定点
-  subpass.flags = 0;                                                      // 设置掩码
-  subpass.inputAttachmentCount = 0;                                       // 输入附件数量
-  subpass.pInputAttachments = nullptr;                                    // 输入附件列表
-  subpass.colorAttachmentCount = 1;                                       // 颜色附件数量
-  subpass.pColorAttachments = &color_reference;                           // 颜色附件列表
-  subpass.pResolveAttachments = nullptr;                                  // Resolve附件
-  subpass.pDepthStencilAttachment = &depth_reference;                     // 深度模板附件
-  subpass.preserveAttachmentCount = 0;                                    // preserve附件数量
-  subpass.pPreserveAttachments = nullptr;                                 // preserve附件列表
-
-  VkRenderPassCreateInfo rp_info = {};                                    // 构建渲染通道创建信息结构体实例
-  rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;              // 结构体类型
-  rp_info.pNext = nullptr;                                                // 自定义数据的指针
-  rp_info.attachmentCount = 2;                                            // 附件的数量
-  rp_info.pAttachments = attachments;                                     // 附件列表
-  rp_info.subpassCount = 1;                                               // 渲染子通道数量
-  rp_info.pSubpasses = &subpass;                                          // 渲染子通道列表
-  rp_info.dependencyCount = 0;                                            // 子通道依赖数量
-  rp_info.pDependencies = nullptr;                                        // 子通道依赖列表
-  result = vk::vkCreateRenderPass(device, &rp_info, nullptr, &renderPass); // 创建渲染通道
-  assert(result == VK_SUCCESS);                                           // 检查是否创建成功
-
-  clear_values[0].color.float32[0] = 0.0f;                                // 帧缓冲清除用R分量值
-  clear_values[0].color.float32[1] = 0.0f;                                // 帧缓冲清除用G分量值
-  clear_values[0].color.float32[2] = 0.0f;                                // 帧缓冲清除用B分量值
-  clear_values[0].color.float32[3] = 0.0f;                                // 帧缓冲清除用A分量值
-  clear_values[1].depthStencil.depth = 1.0f;                              // 帧缓冲清除用深度值
-  clear_values[1].depthStencil.stencil = 0;                               // 帧缓冲清除用模板值
-
-  rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;              // 渲染通道启动信息结构体类型
-  rp_begin.pNext = nullptr;                                               // 自定义数据的指针
-  rp_begin.renderPass = renderPass;                                       // 指定要启动的渲染通道
-  rp_begin.renderArea.offset.x = 0;                                       // 渲染区域起始x坐标
-  rp_begin.renderArea.offset.y = 0;                                       // 渲染区域起始y坐标
-  rp_begin.renderArea.extent.width = screenWidth;                         // 渲染区域宽度
-  rp_begin.renderArea.extent.height = screenHeight;                       // 渲染区域高度
-  rp_begin.clearValueCount = 2;                                           // 帧缓冲清除值数量
-  rp_begin.pClearValues = clear_values;                                   // 帧缓冲清除值数组
+  VkPipelineStageFlags acquireStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // 与图像获取信号量的等待阶段一致
+  ResourceUsage finalUsage = RESOURCE_USAGE_PRESENT;                      // 绘制完毕后呈现
+  if (HeadlessRenderer::enabled) {
+    acquireStages = 0;                                                    // 离屏颜色图像由渲染图跨帧跟踪
+    finalUsage = RESOURCE_USAGE_TRANSFER_READ;                            // 离屏无窗口模式不呈现, 结束时转为可读回的布局
+  }
+  colorTarget = RenderGraph::importImage("swapchain", formats[0], VK_IMAGE_ASPECT_COLOR_BIT, acquireStages, finalUsage);
+  depthTarget = RenderGraph::createImage("depth", depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+  VkClearColorValue clearColor = {{0.0f, 0.0f, 0.0f, 0.0f}};              // 帧缓冲清除用颜色值
+  VkClearDepthStencilValue clearDepth = {1.0f, 0};                        // 帧缓冲清除用深度值与模板值
+  scenePass = RenderGraph::addPass("scene");                              // 场景由drawObject自行录制
+  RenderGraph::writeColor(scenePass, colorTarget, &clearColor);
+  RenderGraph::writeDepth(scenePass, depthTarget, &clearDepth);           // 之后没有通道读取, 深度不写回内存
+  RenderGraph::compile(device);                                           // 推导附件的载入、写回操作并创建渲染通道
+  renderPass = RenderGraph::renderPassOf(scenePass);                      // 管线与二级命令缓冲使用场景通道的渲染通道
 }
 
 /**
  * 销毁渲染通道相关
  */
 void MyVulkanManager::destroy_render_pass() {
-  vk::vkDestroyRenderPass(device, renderPass, nullptr);
-  vk::vkDestroySemaphore(device, imageAcquiredSemaphore, nullptr);
+  RenderGraph::destroy(device);                                           // 销毁各通道的渲染通道并清空渲染图
+  renderPass = VK_NULL_HANDLE;
 }
 
 /**
@@ -723,46 +760,24 @@ void MyVulkanManager::destroy_render_pass() {
  */
 void MyVulkanManager::init_queue() {
   vk::vkGetDeviceQueue(device, queueGraphicsFamilyIndex, 0, &queueGraphics); // 获取指定家族中索引为0的队列
+  vk::vkGetDeviceQueue(device, queueTransferFamilyIndex, 0, &queueTransfer); // 异步上传使用的队列(可能与图形队列相同)
 }
 
 /**
  * 创建帧缓冲
+ * 交换链图像作为渲染图的外部资源, 渲染图按屏幕尺寸创建深度附件与各交换链图像对应的帧缓冲
  */
 void MyVulkanManager::create_frame_buffer() {
-  VkImageView attachments[2];                                             // 附件图像视图数组
-  attachments[1] = depthImageView;                                        // 给定深度图像视图
-
-  VkFramebufferCreateInfo fb_info = {};                                   // 构建帧缓冲创建信息结构体实例
-  fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;              // 结构体类型
-  fb_info.pNext = nullptr;                                                // 自定义数据的指针
-  fb_info.renderPass = renderPass;                                        // 指定渲染通道
-  fb_info.attachmentCount = 2;                                            // 附件数量
-  fb_info.pAttachments = attachments;                                     // 附件图像视图数组
-  fb_info.width = screenWidth;                                            // 宽度
-  fb_info.height = screenHeight;                                          // 高度
-  fb_info.layers = 1;                                                     // 层数
-
-  // 根据交换链中的图像数量分配了对应数量帧缓冲所需的内存
-  framebuffers = (VkFramebuffer *) malloc(swapchainImageCount * sizeof(VkFramebuffer)); // 为帧缓冲序列动态分配内存
-  assert(framebuffers);                                                   // 检查内存分配是否成功
-
-  for (uint32_t i = 0; i < swapchainImageCount; ++i) {                    // 遍历交换链中的各个图像
-    attachments[0] = swapchainImageViews[i];                              // 给定颜色附件对应图像视图
-    VkResult result = vk::vkCreateFramebuffer(device, &fb_info, nullptr, &framebuffers[i]); // 为每一个图像创建对应帧缓冲
-    assert(result == VK_SUCCESS);                                         // 检查是否创建成功
-    LOGI("create framebuffer[%d] success!", i);
-  }
+  RenderGraph::setImportedImages(colorTarget, swapchainImages, swapchainImageViews);
+  RenderGraph::createTargets(device, memoryroperties, screenWidth, screenHeight);
+  RenderGraph::logStats();                                                // 打印各附件的载入、写回操作与瞬时附件的内存
 }
 
 /**
- * 销毁帧缓冲
- * 遍历销毁交换链中各个图像对应的帧缓冲
+ * 销毁帧缓冲与深度附件
  */
 void MyVulkanManager::destroy_frame_buffer() {
-  for (int i = 0; i < swapchainImageCount; i++) {
-    vk::vkDestroyFramebuffer(device, framebuffers[i], nullptr);
-  }
-  free(framebuffers);
+  RenderGraph::destroyTargets(device);                                    // 窗口终止时已经销毁则不做任何事
   LOGI("destroy_frame_buffer success!");
 }
 
@@ -771,7 +786,32 @@ void MyVulkanManager::destroy_frame_buffer() {
  * Sample6_1
  */
 void MyVulkanManager::init_texture() {
-  TextureManager::initTextures(device, gpus[0], memoryroperties, cmdBuffer, queueGraphics);
+  StagingRing::create(device, memoryroperties);                          // 创建所有上传共用的中转环形缓冲
+  AsyncUploader::init(device, queueTransfer, queueTransferFamilyIndex, queueGraphicsFamilyIndex); // 初始化传输队列上的异步上传
+  GeometryPool::create(device, gpus[0]);                                  // 创建静态网格共用的几何缓冲池
+//  TextureManager::benchmarkMipmapGenerator();                            // CPU端mipmap生成基准测试
+//  TextureManager::benchmarkTextureUpload(device, gpus[0], memoryroperties, cmdBuffer, queueGraphics); // 纹理上传基准测试
+  TextureManager::initTextures(device, gpus[0], memoryroperties, cmdPool, cmdBuffer, queueGraphics);
+
+  /// 纹理流式加载 ************************************************ start
+//  TextureStreamer::init(device, gpus[0], memoryroperties, cmdBuffer, queueGraphics); // 初始化流式纹理管理(默认预算)
+//  for (int i = 0; i < TextureManager::texNames.size(); ++i) {             // 注册纹理, 此时只上传占位纹理
+//    TextureStreamer::registerTexture(TextureManager::texNames[i]);
+//  }
+  /// 纹理流式加载 ************************************************** end
+
+  /// 无绑定纹理 ************************************************** start
+//  BindlessTextureTable::create(device);                                   // 创建纹理表(传统模式下不创建)
+//  texIndexList.clear();
+//  for (int i = 0; i < TextureManager::texNames.size(); ++i) {             // 所有纹理放入纹理表, 记录绘制用的纹理索引
+//    texIndexList.push_back(BindlessTextureTable::registerTexture(device, TextureManager::texNames[i]));
+//  }
+  /// 无绑定纹理 **************************************************** end
+
+  /// 虚拟纹理 **************************************************** start
+//  VirtualTexture::simulate(16384, 8192, VT_CACHE_COLS, VT_CACHE_ROWS, 600, true); // 用模拟的反馈流检查页表与瓦片缓存
+//  VirtualTextureManager::create(device, gpus[0], memoryroperties, cmdBuffer, queueGraphics, "texture/earth.bntex");
+  /// 虚拟纹理 ****************************************************** end
 }
 
 /**
@@ -868,6 +908,21 @@ void MyVulkanManager::createDrawableObject() {
 //  };
 //  texTri = new DrawableObjectCommon(vdataIn, 15 * 4, 3, device, memoryroperties); // 创建三角形绘制物体
   /// Sample6_1、Sample6_7、Sample6_10 ****************************** end
+  /// 无绑定纹理-同样使用上面Sample6_1的纹理三角形texTri(纹理名称列表同Sample6_3)
+
+  /// 虚拟纹理 **************************************************** start
+//  float *vdataIn = new float[30]{                                         // 2:1的纹理矩形(x, y, z, s, t)
+//      20, 10, 0, 1, 0, -20, 10, 0, 0, 0, -20, -10, 0, 0, 1,
+//      20, 10, 0, 1, 0, -20, -10, 0, 0, 1, 20, -10, 0, 1, 1
+//  };
+//  texTri = new DrawableObjectCommon(vdataIn, 30 * 4, 6, device, memoryroperties);
+  /// 虚拟纹理 ****************************************************** end
+
+  /// 纹理图集 *************************************************** start
+//  TriangleData::genTexVertexData(&(TextureManager::atlasRegionList["texture/robot0.bntex"])); // 纹理坐标映射到图集中的区域
+//  texTri = new DrawableObjectCommon(
+//      TriangleData::vdata, TriangleData::dataByteCount, TriangleData::vCount, device, memoryroperties);
+  /// 纹理图集 ***************************************************** end
 
   /// Sample6_3 ************************************************** start
 //  float *vdataIn = new float[30]{                                         // 顶点数据数组(x, y, z, s, t)
@@ -964,6 +1019,7 @@ void MyVulkanManager::createDrawableObject() {
  * 销毁绘制用物体
  */
 void MyVulkanManager::destroyDrawableObject() {
+  GeometryBuffer::logStats();                                             // 打印几何缓冲的上传统计
   /// Sample4_1、Sample4_14
 //  delete triForDraw;
 
@@ -1004,26 +1060,339 @@ void MyVulkanManager::destroyDrawableObject() {
  * Sample6_1
  */
 void MyVulkanManager::destroy_textures() {
+  AsyncUploader::destroy(device);                                         // 等待在途的异步上传完成(须在销毁纹理之前)
+  GeometryPool::destroy(device);                                          // 销毁几何缓冲池(网格已随物体释放)
+//  VirtualTextureManager::destroy(device);                                 // 虚拟纹理-销毁物理缓存与间接纹理
+//  TextureStreamer::logStats();                                            // 纹理流式加载-打印统计
+//  TextureStreamer::destroy();                                             // 纹理流式加载-销毁流式纹理
+//  BindlessTextureTable::destroy(device);                                  // 无绑定纹理-销毁纹理表
   TextureManager::destroyTextures(device);
+  DeviceMemoryDefragmenter::destroy(device);                              // 销毁整理时换下的旧资源(登记已随资源取消)
+  StagingRing::destroy(device);                                           // 销毁中转环形缓冲
+  ResourceStateTracker::logStats();                                       // 打印上传时推导出的屏障统计
+  ResourceStateTracker::reset();
 }
 
 /**
- * 创建用于等待指定任务执行完毕的栅栏
+ * 创建各在途帧的栅栏与图像获取信号量, 以及各交换链图像的渲染完成信号量
  */
 void MyVulkanManager::createFence() {
   VkFenceCreateInfo fenceInfo;                                            // 栅栏创建信息结构体实例
   fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fenceInfo.pNext = nullptr;
   // 若设置为VK_FENCE_CREATE_SIGNALED_BIT，则栅栏的初始状态为触发态(一般代表任务已完成)
-  fenceInfo.flags = 0;                                                    // 栅栏在初始状态下为未触发态(一般代表任务未完成)
-  vk::vkCreateFence(device, &fenceInfo, nullptr, &taskFinishFence);       // 创建栅栏
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;                         // 每帧开始时先等待栅栏, 第一次不应阻塞
+  VkSemaphoreCreateInfo semaphoreInfo;                                    // 信号量创建信息结构体实例
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = nullptr;
+  semaphoreInfo.flags = 0;
+  VkResult result;
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    result = vk::vkCreateFence(device, &fenceInfo, nullptr, &frames[i].fence); // 创建栅栏
+    assert(result == VK_SUCCESS);
+    result = vk::vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frames[i].imageAcquiredSemaphore);
+    assert(result == VK_SUCCESS);
+  }
+  createImageSemaphores();
+  setFramesInFlight(framesInFlight);                                      // 通知各每帧资源的使用者
+}
+
+/**
+ * 创建各交换链图像的渲染完成信号量(交换链重建后图像数可能变化, 随之重建)
+ * 渲染完成信号量按交换链图像而不是按帧分配: 呈现对信号量的等待不受栅栏保护,
+ * 只有再次获取到同一幅图像时才能确定上一次呈现已经等待过它
+ */
+void MyVulkanManager::createImageSemaphores() {
+  VkSemaphoreCreateInfo semaphoreInfo;                                    // 信号量创建信息结构体实例
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = nullptr;
+  semaphoreInfo.flags = 0;
+  renderFinishedSemaphores.resize(swapchainImageCount);
+  for (uint32_t i = 0; i < swapchainImageCount; ++i) {
+    VkResult result = vk::vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]);
+    assert(result == VK_SUCCESS);
+  }
+  imageFences.assign(swapchainImageCount, VK_NULL_HANDLE);
 }
 
 /**
- * 销毁栅栏
+ * 销毁栅栏与信号量
  */
 void MyVulkanManager::destroyFence() {
-  vk::vkDestroyFence(device, taskFinishFence, nullptr);
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    vk::vkDestroyFence(device, frames[i].fence, nullptr);
+    vk::vkDestroySemaphore(device, frames[i].imageAcquiredSemaphore, nullptr);
+  }
+  destroyImageSemaphores();
+}
+
+/**
+ * 销毁各交换链图像的渲染完成信号量
+ */
+void MyVulkanManager::destroyImageSemaphores() {
+  for (uint32_t i = 0; i < renderFinishedSemaphores.size(); ++i) {
+    vk::vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+  }
+  renderFinishedSemaphores.clear();
+  imageFences.clear();
+}
+
+/**
+ * 等待所有在途帧执行完毕(栅栏创建时为触发态, 未提交过的帧不会阻塞)
+ */
+void MyVulkanManager::waitFramesInFlight() {
+  VkFence fences[MAX_FRAMES_IN_FLIGHT];
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    fences[i] = frames[i].fence;
+  }
+  VkResult result;
+  do {
+    result = vk::vkWaitForFences(device, MAX_FRAMES_IN_FLIGHT, fences, VK_TRUE, FENCE_TIMEOUT);
+  } while (result == VK_TIMEOUT);
+}
+
+/**
+ * 重建交换链: 逻辑设备、渲染通道、管线、纹理与网格保持不变, 只重建表面(窗口终止时已释放)、交换链、深度缓冲与帧缓冲
+ * 尺寸变化时管线中静态的视口与剪裁窗口随之失效, 才重建管线并按新的宽高比重新设置投影
+ * 表面已释放且等待新窗口期间应用销毁时不销毁任何对象, 返回false(绘制循环应结束)
+ */
+bool MyVulkanManager::recreateSwapChain() {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if (surface == VK_NULL_HANDLE && !create_vulkan_surface()) {           // 窗口终止后重新获得了窗口(等待期间应用销毁则放弃重建)
+    return false;
+  }
+  vk::vkDeviceWaitIdle(device);                                           // 旧帧缓冲与交换链图像不再被使用(包括呈现)
+  uint32_t oldWidth = screenWidth;
+  uint32_t oldHeight = screenHeight;
+  destroy_frame_buffer();                                                 // 同时销毁深度附件
+  destroyImageSemaphores();                                               // 新交换链的图像数可能不同
+  create_vulkan_swapChain();                                              // 以旧交换链为前导交换链创建
+  create_frame_buffer();                                                  // 渲染区域与深度附件随交换链尺寸变化
+  createImageSemaphores();
+  if (screenWidth != oldWidth || screenHeight != oldHeight) {
+    LOGI("swapchain size changed: %d x %d -> %d x %d, rebuilding pipelines", oldWidth, oldHeight, screenWidth,
+         screenHeight);
+    destroyPipeline();
+    initPipeline();
+    writtenDescriptors.clear();                                           // 新管线对象的描述集尚未写入
+    CommandBufferCache::invalidateAll();                                  // 缓存的命令引用了旧管线
+    initMatrixAndLight();                                                 // 按新的宽高比设置投影
+  }
+  swapChainOutOfDate = false;
+  FramePacer::reset();                                                    // 重建耗时不计入帧间隔统计
+  LOGI("swapchain recreated in %.2f ms", std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count());
+  return true;
+}
+
+/**
+ * 窗口终止时释放依赖窗口的对象: 帧缓冲、深度缓冲、交换链与表面(此后主线程才能让窗口失效)
+ */
+void MyVulkanManager::releaseSurface() {
+  vk::vkDeviceWaitIdle(device);                                           // 等待所有在途帧与呈现
+  destroy_frame_buffer();
+  destroy_vulkan_swapChain();
+  destroy_vulkan_surface();                                               // 通知等待中的主线程
+  LOGI("surface released, device and resources kept");
+}
+
+/**
+ * 每帧开始时在绘制线程中调用
+ * 窗口终止时释放表面, 失去焦点或没有窗口时等待, 重新获得窗口或交换链过时后重建交换链; 绘制循环应结束时返回false
+ */
+bool MyVulkanManager::waitForWindow() {
+  if (HeadlessRenderer::enabled) {                                        // 离屏无窗口模式与窗口无关
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(windowMutex);
+  bool paused = false;
+  while (true) {
+    if (!loopDrawFlag) {
+      return false;
+    }
+    if (!windowReady && surfaceInUse) {                                   // 窗口已终止, 主线程正在等待表面释放
+      lock.unlock();
+      releaseSurface();
+      lock.lock();
+      continue;
+    }
+    if (windowReady && !drawPaused) {
+      break;
+    }
+    if (!paused) {
+      LOGI("drawing paused");
+      paused = true;
+    }
+    windowCond.wait(lock);                                                // 等待窗口恢复、焦点恢复或应用销毁
+  }
+  bool recreate = surface == VK_NULL_HANDLE || swapChainOutOfDate;
+  lock.unlock();
+  if (recreate && !recreateSwapChain()) {                                 // 等待窗口期间应用销毁: 没有交换链, 结束绘制循环
+    return false;
+  }
+  if (paused) {
+    LOGI("drawing resumed");
+    FramePacer::reset();                                                  // 暂停的时间不计入帧间隔统计
+  }
+  return true;
+}
+
+/**
+ * 设置同时在途的帧数: 等待在途帧执行完毕后切换, 并通知推迟回收每帧资源的各模块
+ */
+void MyVulkanManager::setFramesInFlight(int frames) {
+  assert(frames >= 1 && frames <= MAX_FRAMES_IN_FLIGHT);
+  assert(frames <= UniformRing::frameCount);                              // 一致变量环形缓冲的帧区域不能少于在途帧数
+  waitFramesInFlight();
+  framesInFlight = frames;
+  frameIndex = 0;
+  AsyncUploader::setFramesInFlight(frames);                               // 中转区域在这么多帧之后重用
+  GeometryPool::setFramesInFlight(frames);                                // 释放的网格与整理后的旧缓冲在这么多帧之后回收
+  DeviceMemoryDefragmenter::setFramesInFlight(frames);                    // 移动后的旧资源在这么多帧之后销毁
+  VirtualTextureManager::setFramesInFlight(frames);                       // 在途帧引用的瓦片槽位不逐出
+  LOGI("frames in flight: %d", frames);
+}
+
+/**
+ * 吞吐量测试: 依次以1、2、3帧在途各绘制FRAMES_IN_FLIGHT_BENCHMARK_FRAMES帧(不限帧率), 打印每秒帧数,
+ * 结束后恢复默认的在途帧数
+ */
+void MyVulkanManager::stepFramesInFlightBenchmark() {
+  static int frameCount = -1;                                             // 当前在途帧数下已绘制的帧数(-1为尚未开始)
+  static std::chrono::steady_clock::time_point start;
+  static double fps[MAX_FRAMES_IN_FLIGHT];
+  if (frameCount < 0) {                                                   // 从1帧在途开始
+    setFramesInFlight(1);
+    frameCount = 0;
+    start = std::chrono::steady_clock::now();
+    return;
+  }
+  if (++frameCount < FRAMES_IN_FLIGHT_BENCHMARK_FRAMES) {
+    return;
+  }
+  waitFramesInFlight();                                                   // 计入已提交帧的GPU时间
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fps[framesInFlight - 1] = frameCount / seconds;
+  LOGI("frames in flight %d: %d frames in %.3f s, %.1f fps", framesInFlight, frameCount, seconds,
+       fps[framesInFlight - 1]);
+  if (framesInFlight < MAX_FRAMES_IN_FLIGHT) {                            // 下一种在途帧数
+    setFramesInFlight(framesInFlight + 1);
+    frameCount = 0;
+    start = std::chrono::steady_clock::now();
+    return;
+  }
+  LOGI("frames in flight benchmark: 1 -> %.1f fps, 2 -> %.1f fps (x%.2f), 3 -> %.1f fps (x%.2f)",
+       fps[0], fps[1], fps[1] / fps[0], fps[2], fps[2] / fps[0]);
+  framesInFlightBenchmark = false;
+  frameCount = -1;
+  setFramesInFlight(FRAMES_IN_FLIGHT);
+}
+
+/**
+ * 更新描述集: 只写入内容与上次写入不同的描述, 有变化时先等待在途帧执行完毕
+ * (在途的命令缓冲仍在使用的描述集不能被更新; 内容不变时每帧调用也不会阻塞CPU与GPU的并行)
+ */
+void MyVulkanManager::updateDescriptorSets(uint32_t writeCount, const VkWriteDescriptorSet *writes) {
+  std::vector<VkWriteDescriptorSet> changed;
+  for (uint32_t i = 0; i < writeCount; ++i) {
+    const VkWriteDescriptorSet &write = writes[i];
+    const char *data;
+    size_t size;
+    if (write.pImageInfo != nullptr) {                                    // 按描述类型取出描述信息的字节
+      data = (const char *) write.pImageInfo;
+      size = sizeof(VkDescriptorImageInfo) * write.descriptorCount;
+    } else if (write.pBufferInfo != nullptr) {
+      data = (const char *) write.pBufferInfo;
+      size = sizeof(VkDescriptorBufferInfo) * write.descriptorCount;
+    } else {
+      data = (const char *) write.pTexelBufferView;
+      size = sizeof(VkBufferView) * write.descriptorCount;
+    }
+    std::vector<char> &written = writtenDescriptors[std::make_pair(write.dstSet, write.dstBinding)];
+    if (written.size() == size && memcmp(written.data(), data, size) == 0) {
+      continue;
+    }
+    written.assign(data, data + size);
+    changed.push_back(write);
+  }
+  if (changed.empty()) {
+    return;
+  }
+  waitFramesInFlight();
+  vk::vkUpdateDescriptorSets(device, (uint32_t) changed.size(), changed.data(), 0, nullptr);
+  CommandBufferCache::invalidateAll();                                    // 引用被改写描述集的已录制命令不再有效
+}
+
+/**
+ * 并行录制-在cmd中录制物体网格中下标[begin, end)的物体(在作业系统的各线程中调用)
+ * 管线、描述集与顶点缓冲每个二级命令缓冲绑定一次; 推送常量用局部数组, 不能写所有线程共用的pushConstantData
+ */
+void MyVulkanManager::recordObjectGrid(VkCommandBuffer &cmd, uint32_t begin, uint32_t end) {
+  if (!objForDraw->uploaded()) {                                          // 顶点数据尚在上传, 本帧不绘制
+    return;
+  }
+  vk::vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, sqsCL->pipeline);
+  vk::vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, sqsCL->pipelineLayout, 0, 1,
+                              &(sqsCL->descSet[0]), 1, &(sqsCL->uniformOffset));
+  objForDraw->bindVertexBuffer(cmd);
+  uint32_t firstVertex = objForDraw->firstVertex();
+  float pushData[32];                                                     // 本线程的推送常量数据(最终变换矩阵与基本变换矩阵)
+  for (uint32_t i = begin; i < end; i++) {
+    MatrixState3D::pushMatrix();                                          // 各线程有自己的矩阵栈
+    MatrixState3D::translate(((int) (i % PARALLEL_GRID_SIDE) - PARALLEL_GRID_SIDE / 2) * 3.0f, 0,
+                             -(float) (i / PARALLEL_GRID_SIDE) * 3.0f);
+    MatrixState3D::rotate(yAngle, 0, 1, 0);
+    memcpy(pushData, MatrixState3D::getFinalMatrix(), sizeof(float) * 16);
+    memcpy(pushData + 16, MatrixState3D::getMMatrix(), sizeof(float) * 16);
+    vk::vkCmdPushConstants(cmd, sqsCL->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float) * 32, pushData);
+    vk::vkCmdDraw(cmd, objForDraw->vCount, 1, firstVertex, 0);
+    MatrixState3D::popMatrix();
+  }
+}
+
+/**
+ * 命令缓冲缓存-录制整个物体网格(在渲染线程中调用), 顶点数据尚在上传时录制不完整
+ */
+bool MyVulkanManager::recordCachedGrid(VkCommandBuffer &cmd) {
+  MatrixState3D::pushMatrix();
+  MatrixState3D::translate(0, -2.0f, -25.0f);
+  MatrixState3D::rotate(gridCacheXAngle, 1, 0, 0);
+  recordObjectGrid(cmd, 0, PARALLEL_GRID_SIDE * PARALLEL_GRID_SIDE);
+  MatrixState3D::popMatrix();
+  return objForDraw->uploaded();
+}
+
+/**
+ * 命令缓冲缓存测试: 先关闭缓存、再开启缓存各绘制COMMAND_CACHE_BENCHMARK_FRAMES帧(不限帧率),
+ * 打印每帧录制与提交的平均CPU耗时, 结束后保持缓存开启
+ */
+void MyVulkanManager::stepCommandCacheBenchmark(double cpuMillis) {
+  static int frameCount = -1;                                             // 当前阶段已绘制的帧数(-1为尚未开始)
+  static double totalMillis = 0;
+  static double offMillis = 0;                                            // 关闭缓存时的平均CPU帧时间
+  if (frameCount < 0) {                                                   // 从关闭缓存开始(本帧不计入)
+    CommandBufferCache::enabled = false;
+    frameCount = 0;
+    totalMillis = 0;
+    return;
+  }
+  totalMillis += cpuMillis;
+  if (++frameCount < COMMAND_CACHE_BENCHMARK_FRAMES) {
+    return;
+  }
+  double average = totalMillis / frameCount;
+  if (!CommandBufferCache::enabled) {
+    offMillis = average;
+    LOGI("command buffer cache off: %.3f ms CPU per frame", offMillis);
+    CommandBufferCache::enabled = true;
+    frameCount = 0;
+    totalMillis = 0;
+    return;
+  }
+  LOGI("command buffer cache on: %.3f ms CPU per frame (x%.2f)", average, offMillis / average);
+  CommandBufferCache::logStats();
+  commandCacheBenchmark = false;
+  frameCount = -1;
 }
 
 /**
@@ -1034,8 +1403,8 @@ void MyVulkanManager::initPresentInfo() {
   present.pNext = nullptr;
   present.swapchainCount = 1;                                             // 交换链的数量
   present.pSwapchains = &swapChain;                                       // 交换链列表
-  present.waitSemaphoreCount = 0;                                         // 等待的信号量数量
-  present.pWaitSemaphores = nullptr;                                      // 等待的信号量列表
+  present.waitSemaphoreCount = 1;                                         // 等待的信号量数量
+  present.pWaitSemaphores = nullptr;                                      // 等待的信号量列表(每帧指向当前图像的渲染完成信号量)
   // 呈现操作结果标志列表：指向元素数量与交换链数量相同的VkResult型数组首元素的指针，
   // 当呈现完成后Vulkan会根据各个交换链执行呈现的情况来填充此数组对应的元素值
   present.pResults = nullptr;
@@ -1060,6 +1429,11 @@ void MyVulkanManager::initMatrixAndLight() {
 //  MatrixState3D::setCamera(0, 0, 70, 0, 0, 0, 0, 1, 0); // Sample6_9
 //  MatrixState3D::setCamera(0, 0, 11, 0, 0, 0, 0, 1, 0); // Sample6_11
   MatrixState3D::setCamera(0, 0, 0, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f); // Sample7_1
+  HeadlessRenderer::clearCameraKeys();                                    // 离屏无窗口-脚本摄像机: 从左到右绕过物体再回到原位
+  HeadlessRenderer::addCameraKey(0, 0, 0, 0, -2.0f, -25.0f);
+  HeadlessRenderer::addCameraKey(-12.0f, 4.0f, -8.0f, 0, -2.0f, -25.0f);
+  HeadlessRenderer::addCameraKey(12.0f, 4.0f, -8.0f, 0, -2.0f, -25.0f);
+  HeadlessRenderer::addCameraKey(0, 0, 0, 0, -2.0f, -25.0f);
 
   MatrixState3D::setInitStack();                                          // 初始化基本变换矩阵
   float ratio = (float) screenWidth / (float) screenHeight;               // 求屏幕宽高比
@@ -1205,24 +1579,21 @@ void MyVulkanManager::flushUniformBuffer() {
 //      LightManager::lightSpecularA
 //  };
 
-  uint8_t *pData;                                                         // CPU访问设备内存时的辅助指针
-  VkResult result = vk::vkMapMemory(                                      // 将设备内存映射为CPU可访问
-      device, sqsCL->memUniformBuf, 0, sqsCL->bufferByteCount, 0, (void **) &pData);
-  assert(result == VK_SUCCESS);                                           // 检查映射是否成功
-  memcpy(pData, vertexUniformData, sqsCL->bufferByteCount);               // 将最终矩阵数据复制进设备内存
-//  memcpy(pData, fragmentUniformData, sqsCL->bufferByteCount);             // Sample6_1、Sample6_7-将数据拷贝进设备内存
-  vk::vkUnmapMemory(device, sqsCL->memUniformBuf);                        // 解除内存映射
+  // 写入本帧的环形缓冲区域(缓冲保持映射), 返回的动态偏移量在绑定描述集时使用, 不会改写GPU仍在读取的区域
+  sqsCL->uniformOffset = UniformRing::push(vertexUniformData, sqsCL->bufferByteCount);
+//  sqsCL->uniformOffset = UniformRing::push(fragmentUniformData, sqsCL->bufferByteCount); // Sample6_1、Sample6_7
+
+  /// 无绑定纹理 ************************************************** start
+//  sqsBL->uniformOffset = UniformRing::push(fragmentUniformData, sqsBL->bufferByteCount); // 亮度调节系数(同Sample6_1)
+  /// 无绑定纹理 **************************************************** end
+
+  /// 虚拟纹理 **************************************************** start
+//  sqsVT->uniformOffset = UniformRing::push(sqsVT->params, sqsVT->bufferByteCount); // 虚拟纹理参数
+  /// 虚拟纹理 ****************************************************** end
 
   /// Sample6_6 ************************************************** start
-//  uint8_t *pData;
-//  VkResult result = vk::vkMapMemory(device, sqsSTL->memUniformBuf, 0, sqsSTL->bufferByteCount, 0, (void **) &pData);
-//  assert(result == VK_SUCCESS);
-//  memcpy(pData, vertexUniformData, sqsSTL->bufferByteCount);
-//  vk::vkUnmapMemory(device, sqsSTL->memUniformBuf);
-//  result = vk::vkMapMemory(device, sqsDTL->memUniformBuf, 0, sqsDTL->bufferByteCount, 0, (void **) &pData);
-//  assert(result == VK_SUCCESS);
-//  memcpy(pData, vertexUniformData, sqsDTL->bufferByteCount);
-//  vk::vkUnmapMemory(device, sqsDTL->memUniformBuf);
+//  sqsSTL->uniformOffset = UniformRing::push(vertexUniformData, sqsSTL->bufferByteCount);
+//  sqsDTL->uniformOffset = UniformRing::push(vertexUniformData, sqsDTL->bufferByteCount);
   /// Sample6_6 **************************************************** end
 }
 
@@ -1231,33 +1602,56 @@ void MyVulkanManager::flushUniformBuffer() {
  */
 void MyVulkanManager::flushTexToDesSet() {
   sqsCL->writes[0].dstSet = sqsCL->descSet[0];                            // 更新描述集对应的写入属性
-  vk::vkUpdateDescriptorSets(device, 1, sqsCL->writes, 0, nullptr);       // 更新描述集
+  updateDescriptorSets(1, sqsCL->writes);                                 // 更新描述集(内容不变时不写入)
 
   /// Sample6_1、6_7、7_4 将纹理等数据与描述集关联******************** start
 //  for (int i = 0; i < TextureManager::texNames.size(); ++i) {             // 遍历所有纹理
 //    sqsCL->writes[0].dstSet = sqsCL->descSet[i];                          // 更新描述集对应的写入属性0(一致变量)
 //    sqsCL->writes[1].dstSet = sqsCL->descSet[i];                          // 更新描述集对应的写入属性1(纹理)
-//    sqsCL->writes[1].pImageInfo = &(TextureManager::texImageInfoList[TextureManager::texNames[i]]); // 写入属性1对应的纹理图像信息
-//    vk::vkUpdateDescriptorSets(device, 2, sqsCL->writes, 0, nullptr);     // 更新描述集
+//    sqsCL->writes[1].pImageInfo = &(ResourceRegistry::imageInfos[TextureManager::texHandles[i]]); // 写入属性1对应的纹理图像信息
+//    updateDescriptorSets(2, sqsCL->writes);                             // 更新描述集
 //  }
   /// Sample6_1、6_7、7_4 ****************************************** end
 
+  /// 纹理流式加载 ************************************************ start
+//  for (int i = 0; i < TextureStreamer::textures.size(); ++i) {            // 遍历所有流式纹理
+//    sqsCL->writes[0].dstSet = sqsCL->descSet[i];
+//    sqsCL->writes[1].dstSet = sqsCL->descSet[i];
+//    sqsCL->writes[1].pImageInfo = &(TextureStreamer::request(i));         // 请求纹理, 未常驻时使用占位纹理
+//    updateDescriptorSets(2, sqsCL->writes);
+//  }
+  /// 纹理流式加载 ************************************************** end
+
+  /// 无绑定纹理 ************************************************** start
+//  if (BindlessTextureTable::enabled) {                                    // 纹理表在注册纹理时已写入, 只需更新一致变量描述集
+//    sqsBL->writes[0].dstSet = sqsBL->descSet[0];
+//    updateDescriptorSets(1, sqsBL->writes);
+//  } else {                                                                // 传统模式同Sample6_1, 每幅纹理一个描述集
+//    for (int i = 0; i < TextureManager::texNames.size(); ++i) {
+//      sqsBL->writes[0].dstSet = sqsBL->descSet[i];
+//      sqsBL->writes[1].dstSet = sqsBL->descSet[i];
+//      sqsBL->writes[1].pImageInfo = &(ResourceRegistry::imageInfos[TextureManager::texHandles[i]]);
+//      updateDescriptorSets(2, sqsBL->writes);
+//    }
+//  }
+  /// 无绑定纹理 **************************************************** end
+
   /// Sample6_6 ************************************************** start
 //  for (int i = 0; i < TextureManager::texNamesSingle.size(); ++i) {
 //    sqsSTL->writes[0].dstSet = sqsSTL->descSet[i];
 //    sqsSTL->writes[1].dstSet = sqsSTL->descSet[i];
-//    sqsSTL->writes[1].pImageInfo = &(TextureManager::texImageInfoList[TextureManager::texNamesSingle[i]]);
-//    vk::vkUpdateDescriptorSets(device, 2, sqsSTL->writes, 0, nullptr);
+//    sqsSTL->writes[1].pImageInfo = &(ResourceRegistry::imageInfos[TextureManager::texHandlesSingle[i]]);
+//    updateDescriptorSets(2, sqsSTL->writes);
 //  }
 //  for (int i = 0; i < TextureManager::texNamesPair.size() / 2; ++i) {     // 遍历所有地球纹理组
 //    sqsDTL->writes[0].dstSet = sqsDTL->descSet[i];                        // 更新描述集对应的写入属性0(一致变量)
 //    sqsDTL->writes[1].dstSet = sqsDTL->descSet[i];                        // 更新描述集对应的写入属性1(纹理)
 //    sqsDTL->writes[1].pImageInfo =                                        // 写入属性1对应的纹理图像信息(白天)
-//        &(TextureManager::texImageInfoList[TextureManager::texNamesPair[i * 2]]);
+//        &(ResourceRegistry::imageInfos[TextureManager::texHandlesPair[i * 2]]);
 //    sqsDTL->writes[2].dstSet = sqsDTL->descSet[i];                        // 更新描述集对应的写入属性2(纹理)
 //    sqsDTL->writes[2].pImageInfo =                                        // 写入属性2对应的纹理图像信息(黑夜)
-//        &(TextureManager::texImageInfoList[TextureManager::texNamesPair[i * 2 + 1]]);
-//    vk::vkUpdateDescriptorSets(device, 3, sqsDTL->writes, 0, nullptr);    // 更新描述集
+//        &(ResourceRegistry::imageInfos[TextureManager::texHandlesPair[i * 2 + 1]]);
+//    updateDescriptorSets(3, sqsDTL->writes);                            // 更新描述集
 //  }
   /// Sample6_6 **************************************************** end
 }
@@ -1267,7 +1661,13 @@ void MyVulkanManager::flushTexToDesSet() {
  * 其中建立了渲染循环以持续绘制各帧画面
  */
 void MyVulkanManager::drawObject() {
-  FPSUtil::init();                                                        // 初始化FPS计算
+  FramePacer::setTargetFps(60);                                           // 帧率不超过60(按显示器刷新周期对齐)
+  FramePacer::reset();                                                    // 第一帧作为帧节奏的起点
+  int drawnFrames = 0;                                                    // 已绘制的帧数
+  if (HeadlessRenderer::enabled) {
+    HeadlessRenderer::reset();
+    LOGI("headless: drawing %d frames at %d x %d", HeadlessRenderer::frameCount, screenWidth, screenHeight);
+  }
 
   /// Sample4_1 ************************************************** start
 //  vpCenterX = screenWidth / 2;
@@ -1280,9 +1680,31 @@ void MyVulkanManager::drawObject() {
 //  float sAngle = 0;                                                       // 星空自转角
   /// Sample6_6 **************************************************** end
 
+//  JobSystem::benchmark();                                                 // 作业系统-测试1~N个线程的调度开销与并行循环加速比
+//  framesInFlightBenchmark = true;                                         // 多帧在途-测试1~3帧在途的吞吐量
+//  ParallelRecorder::benchmark(renderPass, RenderGraph::framebufferOf(scenePass),                // 并行录制-测试拆分为1~N段录制物体网格的耗时
+//                              PARALLEL_GRID_SIDE * PARALLEL_GRID_SIDE, recordObjectGrid);
+//  gridCacheEntry = CommandBufferCache::add(recordCachedGrid);             // 命令缓冲缓存-物体网格只在旋转角变化时重新录制
+//  commandCacheBenchmark = true;                                           // 命令缓冲缓存-对比关闭、开启缓存时的CPU帧时间
   while (MyVulkanManager::loopDrawFlag) {                                 // 每循环一次绘制一帧画面
-    FPSUtil::calFPS();                                                    // 计算FPS
-    FPSUtil::before();                                                    // 一帧开始
+    if (!waitForWindow()) {                                               // 没有窗口或失去焦点时在此等待, 按需重建交换链
+      break;
+    }
+    FramePacer::begin();                                                  // 一帧开始(统计帧率与帧间隔抖动)
+    if (framesInFlightBenchmark) {
+      stepFramesInFlightBenchmark();                                      // 计时并按需切换在途帧数
+    }
+    FrameContext &frame = frames[frameIndex];                             // 本帧使用的命令缓冲与同步对象
+    VkResult result;
+    do {
+      result = vk::vkWaitForFences(device, 1, &frame.fence, VK_TRUE, FENCE_TIMEOUT); // 等待framesInFlight帧之前的同一上下文执行完毕
+    } while (result == VK_TIMEOUT);
+    double gpuMs;
+    if (GpuTimer::read(device, frameIndex, gpuMs) && HeadlessRenderer::enabled) { // 该上下文上一次提交的GPU耗时
+      HeadlessRenderer::recordGpu(gpuMs);
+    }
+    JobSystem::runMainThreadJobs();                                       // 执行只能在渲染线程中执行的作业
+//    TextureStreamer::update();                                            // 纹理流式加载-处理加载队列与逐出
 
     /// Sample6_6 ************************************************** start
 //    eAngle = float(eAngle + 0.4);                                         // 更新地球自转角
@@ -1294,12 +1716,54 @@ void MyVulkanManager::drawObject() {
 //    CameraUtil::flushCameraToMatrix();
     /// Sample6_6 **************************************************** end
 
-    VkResult result = vk::vkAcquireNextImageKHR(                          // 获取交换链中的当前帧索引
-        device, swapChain, UINT64_MAX, imageAcquiredSemaphore, VK_NULL_HANDLE, &currentBuffer);
-    rp_begin.framebuffer = framebuffers[currentBuffer];                   // 为渲染通道设置此次绘制使用的帧缓冲索引
+    if (HeadlessRenderer::enabled) {                                      // 离屏无窗口模式轮流使用离屏颜色图像
+      currentBuffer = (uint32_t) (drawnFrames % swapchainImageCount);
+      HeadlessRenderer::applyCamera(drawnFrames);                         // 按脚本移动摄像机
+    } else {
+      result = vk::vkAcquireNextImageKHR(                                 // 获取交换链中的当前帧索引
+          device, swapChain, UINT64_MAX, frame.imageAcquiredSemaphore, VK_NULL_HANDLE, &currentBuffer);
+      if (result == VK_ERROR_SURFACE_LOST_KHR) {                          // 表面丢失: 释放后由下一帧在当前窗口上重新创建
+        releaseSurface();
+        FramePacer::reset();                                              // 没有绘制的一帧不计入帧间隔统计
+        continue;
+      }
+      if (result == VK_ERROR_OUT_OF_DATE_KHR) {                           // 交换链已不能使用(没有获取到图像), 由waitForWindow在窗口可用时重建
+        swapChainOutOfDate = true;
+        FramePacer::reset();
+        continue;
+      }
+      if (result == VK_SUBOPTIMAL_KHR) {                                  // 仍可呈现, 本帧照常绘制, 下一帧开始前重建
+        swapChainOutOfDate = true;
+      }
+    }
+    if (imageFences[currentBuffer] != VK_NULL_HANDLE && imageFences[currentBuffer] != frame.fence) {
+      do {                                                                // 交换链图像少于在途帧数时, 该图像可能仍被其他帧使用
+        result = vk::vkWaitForFences(device, 1, &imageFences[currentBuffer], VK_TRUE, FENCE_TIMEOUT);
+      } while (result == VK_TIMEOUT);
+    }
+    imageFences[currentBuffer] = frame.fence;
+    RenderGraph::beginFrame(currentBuffer);                               // 渲染图本帧使用当前交换链图像及其帧缓冲
+    cmdBuffer = frame.cmdBuffer;                                          // 本帧记录到自己的命令缓冲中
+    cmd_bufs[0] = cmdBuffer;
+    std::chrono::steady_clock::time_point cpuStart = std::chrono::steady_clock::now(); // 本帧录制与提交的CPU耗时起点
     vk::vkResetCommandBuffer(cmdBuffer, 0);                               // 恢复命令缓冲到初始状态
     result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);          // 启动命令缓冲
+    GpuTimer::begin(cmdBuffer, frameIndex);                               // 本帧GPU耗时的起点
 
+    frameWaitSemaphores.assign(1, frame.imageAcquiredSemaphore);          // 图像获取信号量之外再等待已完成的异步上传
+    frameWaitStages.assign(1, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    if (HeadlessRenderer::enabled) {                                      // 离屏无窗口模式没有图像获取信号量
+      frameWaitSemaphores.clear();
+      frameWaitStages.clear();
+    }
+//    VirtualTextureManager::update(device);                                // 虚拟纹理-读回反馈, 提交瓦片并刷新间接纹理
+    AsyncUploader::pump(device);                                          // 在传输队列上提交本帧预算内的上传
+    AsyncUploader::recordAcquire(device, cmdBuffer, frameWaitSemaphores, frameWaitStages); // 获取已完成上传的所有权(渲染通道之外)
+    GeometryPool::beginFrame(device, cmdBuffer);                          // 回收释放的网格空间, 碎片过多时整理几何缓冲池
+    DeviceMemoryDefragmenter::step(device, cmdBuffer);                    // 在预算内把稀疏内存块中的资源移到其他内存块
+    CommandBufferCache::beginFrame();                                     // 顶点缓冲被整理或移动后重新录制缓存的命令
+
+    UniformRing::beginFrame();                                            // 切换到一致变量环形缓冲的下一帧区域
     MyVulkanManager::flushUniformBuffer();                                // 将当前帧相关数据送入一致变量缓冲
     MyVulkanManager::flushTexToDesSet();                                  // 更新绘制用描述集
 
@@ -1320,7 +1784,8 @@ void MyVulkanManager::drawObject() {
 
     // VK_SUBPASS_CONTENTS_INLINE：表示仅采用主命令缓冲而没有采用二级命令缓冲(或称之为子命令缓冲)
     // 若需要采用二级命令缓冲，则第三个参数应该选用VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
-    vk::vkCmdBeginRenderPass(cmdBuffer, &rp_begin, VK_SUBPASS_CONTENTS_INLINE); // 启动渲染通道
+    RenderGraph::beginPass(cmdBuffer, scenePass, VK_SUBPASS_CONTENTS_INLINE); // 加入附件所需的屏障并启动渲染通道
+//    RenderGraph::beginPass(cmdBuffer, scenePass, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS); // 并行录制-渲染通道内容全部来自二级命令缓冲
 
     /// Sample4_2 ************************************************** start
 //    MatrixState3D::pushMatrix();                                          // 保护现场
@@ -1330,7 +1795,7 @@ void MyVulkanManager::drawObject() {
 //      MatrixState3D::pushMatrix();                                        // 保护现场
 //      MatrixState3D::translate(0, 0, i * 0.5);                    // 沿Z轴平移
 //      objForDraw->drawSelf(                                               // 绘制物体
-//          cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//          cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //      MatrixState3D::popMatrix();                                         // 恢复现场
 //    }
 //    MatrixState3D::popMatrix();                                           // 恢复现场
@@ -1342,21 +1807,21 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::rotate(yAngle, 0, 1, 0);
 //    MatrixState3D::pushMatrix();
 //    objForDraw->drawSelf(                                                 // 绘制第一个立方体
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(3.5f, 0, 0);                         // Sample4_4-沿x方向平移3.5
 //    MatrixState3D::rotate(30, 0, 0, 1);                      // Sample4_5-绕z轴旋转30°
 //    MatrixState3D::scale(0.4f, 2.0f, 0.6f);                       // Sample4_6-x轴、y轴、z轴3个方向按各自的缩放因子进行缩放
 //    objForDraw->drawSelf(                                                 // 绘制变换后的立方体
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::popMatrix();
     /// Sample4_4 **************************************************** end
 
     /// Sample4_7 ************************************************** start
 //    objForDraw->drawSelf(
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline[topologyWay], &(sqsCL->descSet[0]));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline[topologyWay], &(sqsCL->descSet[0]), sqsCL->uniformOffset);
     /// Sample4_7 **************************************************** end
 
     /// Sample4_8 ************************************************** start
@@ -1367,13 +1832,13 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(90, 0, 0);
 //    triForDraw->drawSelf(                                                 // 绘制三角形条带
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline[0], &(sqsCL->descSet[0]));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline[0], &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(-90, 0, 0);
 //    cirForDraw->drawSelf(                                                 // 绘制扇形
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline[1], &(sqsCL->descSet[0]));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline[1], &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //
 //    MatrixState3D::popMatrix();
@@ -1386,16 +1851,16 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(0, 50, 0);
 ////    cirForDraw->drawSelf(                                                 // 绘制正十边形
-////        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), 0, CircleData::iCount);
+////        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset, 0, CircleData::iCount);
 //    cirForDraw->drawSelf(                                                 // Sample4_16-间接绘制正十边形
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), 0);
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset, 0);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(0, -50, 0);
 ////    cirForDraw->drawSelf(                                                 // 绘制正十边形的下半部分
-////        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), 0, CircleData::iCount / 2 + 1);
+////        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset, 0, CircleData::iCount / 2 + 1);
 //    cirForDraw->drawSelf(                                                 // Sample4_16-间接绘制正十边形的下半部分
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sizeof(VkDrawIndexedIndirectCommand));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset, sizeof(VkDrawIndexedIndirectCommand));
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::popMatrix();
     /// Sample4_10、Sample4_16 *************************************** end
@@ -1410,13 +1875,13 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::translate(-80, 0, 0);
 //    MatrixState3D::rotate(-30, 0, 1, 0);
 //    cubeForDraw->drawSelf(                                                // 绘制第一个立方体
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(80, 0, 0);
 //    MatrixState3D::rotate(30, 0, 1, 0);
 //    cubeForDraw->drawSelf(                                                // 绘制第二个立方体
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::popMatrix();
     /// Sample4_11 *************************************************** end
@@ -1427,12 +1892,12 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::rotate(-zAngle, 0, 0, 1);
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(250, 0, 0);
-//    cube1ForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    cube1ForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(-250, 0, 0);
-//    cube2ForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    cube2ForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::popMatrix();
     /// Sample4_12 *************************************************** end
@@ -1444,7 +1909,7 @@ void MyVulkanManager::drawObject() {
 //    vk::vkCmdSetDepthBias(cmdBuffer, 0.0, 0.0, 0.0);                      // 设置青色矩形的深度偏移信息
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(-250.0f, 0.0f, 0.0f);
-//    colorRectG->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    colorRectG->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //
 //    switch (depthOffsetFlag) {                                            // 根据索引设置黄色矩形深度偏移参数
@@ -1456,7 +1921,7 @@ void MyVulkanManager::drawObject() {
 //    }
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(250.0f, 0.0f, 0.0f);
-//    colorRectY->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    colorRectY->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::popMatrix();
     /// Sample4_13 *************************************************** end
@@ -1465,18 +1930,18 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::rotate(xAngle, 1, 0, 0);
 //    MatrixState3D::rotate(yAngle, 0, 1, 0);
-//    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
     /// Sample5_1 **************************************************** end
 
     /// Sample5_2 ************************************************** start
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(-1.5f, 0, -15);
-//    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(1.5f, 0, -15);
-//    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
     /// Sample5_2 **************************************************** end
 
@@ -1485,20 +1950,20 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::translate(-1.5f, 0, -15);
 //    MatrixState3D::rotate(45, 1, 0, 0);
 //    MatrixState3D::rotate(45, 0, 0, 1);
-//    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(1.5f, 0, -15);
 //    MatrixState3D::rotate(45, 1, 0, 0);
 //    MatrixState3D::rotate(45, 0, 0, 1);
-//    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
     /// Sample5_7 **************************************************** end
 
     /// Sample5_9 ************************************************** start
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(0, 0, -15);
-//    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+//    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
     /// Sample5_9 **************************************************** end
 
@@ -1507,8 +1972,9 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::rotate(yAngle, 0, 1, 0);
 //    MatrixState3D::rotate(zAngle, 0, 0, 1);
 //    texTri->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, // 绘制纹理三角形
-////                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/wall.bntex")]));
-//                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/wall.pkm")])); // Sample6_7
+////                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/wall.bntex"))]), sqsCL->uniformOffset);
+//                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/wall.pkm"))]), sqsCL->uniformOffset); // Sample6_7
+////                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/robot0.bntex"))]), sqsCL->uniformOffset); // 纹理图集-子纹理共用图集的描述集
 //    MatrixState3D::popMatrix();
     /// Sample6_1、Sample6_7 ***************************************** end
 
@@ -1516,41 +1982,62 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::rotate(yAngle, 0, 1, 0);
 //    MatrixState3D::rotate(zAngle, 0, 0, 1);
-//    string textureName;                                                   // 当前纹理名称
+//    ResHandle textureHandle;                                              // 当前纹理句柄
 //    switch (samplerType) {
-//      case 0:textureName = "texture/robot0.bntex";
+//      case 0:textureHandle = RES_HANDLE("texture/robot0.bntex");
 //        break;
-//      case 1:textureName = "texture/robot1.bntex";
+//      case 1:textureHandle = RES_HANDLE("texture/robot1.bntex");
 //        break;
-//      case 2:textureName = "texture/robot2.bntex";
+//      case 2:textureHandle = RES_HANDLE("texture/robot2.bntex");
 //        break;
-//      case 3:textureName = "texture/robot3.bntex";
+//      case 3:textureHandle = RES_HANDLE("texture/robot3.bntex");
 //        break;
 //      default:break;
 //    }
 //    if (texType == 0) {                                                   // 采用4×4纹理坐标范围
 //      texTri->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, // 绘制物体0
-//                       &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(textureName)]));
+//                       &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(textureHandle)]), sqsCL->uniformOffset);
 //    } else if (texType == 1) {                                            // 采用4×2纹理坐标范围
 //      texTri1->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,  // 绘制物体1
-//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(textureName)]));
+//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(textureHandle)]), sqsCL->uniformOffset);
 //    } else if (texType == 2) {                                            // 采用1×1纹理坐标范围
 //      texTri2->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,  // 绘制物体2
-//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(textureName)]));
+//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(textureHandle)]), sqsCL->uniformOffset);
 //    }
 //    MatrixState3D::popMatrix();
     /// Sample6_3 **************************************************** end
 
+    /// 无绑定纹理 ************************************************ start
+//    vk::vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sqsBL->pipeline); // 每条管线只绑定一次
+//    BindlessTextureTable::bindTable(cmdBuffer, sqsBL->pipelineLayout, sqsBL->descSet[0], sqsBL->uniformOffset); // 纹理表同样只绑定一次
+//    for (int i = 0; i < texIndexList.size(); ++i) {                       // 每个物体使用不同的纹理, 只推送纹理索引
+//      MatrixState3D::pushMatrix();
+//      MatrixState3D::translate((i - (texIndexList.size() - 1) * 0.5f) * 20, 0, 0);
+//      MatrixState3D::rotate(yAngle, 0, 1, 0);
+//      MatrixState3D::rotate(zAngle, 0, 0, 1);
+//      texTri->drawSelfBindless(cmdBuffer, sqsBL->pipelineLayout, texIndexList[i], sqsBL->descSet, sqsBL->uniformOffset);
+//      MatrixState3D::popMatrix();
+//    }
+    /// 无绑定纹理 ************************************************** end
+
+    /// 虚拟纹理 ************************************************** start
+//    MatrixState3D::pushMatrix();
+//    MatrixState3D::rotate(-60 + xAngle, 1, 0, 0);                         // 倾斜的平面上同时出现多个mip级
+//    MatrixState3D::rotate(yAngle, 0, 0, 1);
+//    texTri->drawSelf(cmdBuffer, sqsVT->pipelineLayout, sqsVT->pipeline, &(sqsVT->descSet[0]), sqsVT->uniformOffset);
+//    MatrixState3D::popMatrix();
+    /// 虚拟纹理 **************************************************** end
+
     /// Sample6_4 ************************************************** start
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(0, 10, 0);
 //    MatrixState3D::rotate(-30, 0, 0, 1);
 //    if (smallType == 0) {                                                 // 采用最近点采样
 //      texTri->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, // 绘制小纹理矩形
-//                       &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/256Nearest.bntex")]));
+//                       &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/256Nearest.bntex"))]), sqsCL->uniformOffset);
 //    } else {                                                              // 采用线性采样
 //      texTri->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, // 绘制小纹理矩形
-//                       &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/256Linear.bntex")]));
+//                       &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/256Linear.bntex"))]), sqsCL->uniformOffset);
 //    }
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
@@ -1558,10 +2045,10 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::rotate(-30, 0, 0, 1);
 //    if (bigType == 0) {                                                   // 采用最近点采样
 //      texTri1->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, // 绘制大纹理矩形
-//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/32Nearest.bntex")]));
+//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/32Nearest.bntex"))]), sqsCL->uniformOffset);
 //    } else {                                                              // 采用线性采样
 //      texTri1->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, // 绘制大纹理矩形
-//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/32Linear.bntex")]));
+//                        &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/32Linear.bntex"))]), sqsCL->uniformOffset);
 //    }
 //    MatrixState3D::popMatrix();
     /// Sample6_4 **************************************************** end
@@ -1579,7 +2066,7 @@ void MyVulkanManager::drawObject() {
 //        MatrixState3D::rotate(yAngle, 0, 1, 0);
 //        MatrixState3D::rotate(zAngle, 0, 0, 1);
 //        texRect->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, // 绘制正方形
-//                          &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/mipmap.bntex")]),
+//                          &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/mipmap.bntex"))]), sqsCL->uniformOffset,
 //                          currLodLevel);                                  // 传入纹理采样细节级别
 //        MatrixState3D::popMatrix();
 //      }
@@ -1592,12 +2079,12 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::scale(3, 3, 3);                                // 进行缩放(地球比月球大)
 //    planetForDraw->drawSelf(cmdBuffer, sqsDTL->pipelineLayout,      // 绘制地球
-//                            sqsDTL->pipeline, &(sqsDTL->descSet[0]));
+//                            sqsDTL->pipeline, &(sqsDTL->descSet[0]), sqsDTL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::translate(180, 0, 0);                          // 沿x轴平移(地月距离)
 //    MatrixState3D::rotate(mAngle, 0, 1, 0);                       // 绕y轴旋转(月球自转)
 //    planetForDraw->drawSelf(cmdBuffer, sqsSTL->pipelineLayout, sqsSTL->pipeline, // 绘制月球
-//                            &(sqsSTL->descSet[TextureManager::getVkDescriptorSetIndex("texture/moon.bntex")]));
+//                            &(sqsSTL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/moon.bntex"))]), sqsSTL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::rotate(sAngle, 0, 1, 0);                       // 绕y轴旋转(星空缓慢自转)
@@ -1614,8 +2101,8 @@ void MyVulkanManager::drawObject() {
 //    texTri->drawSelf(cmdBuffer,
 //                     sqsCL->pipelineLayout,
 //                     sqsCL->pipeline,
-////                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/fp.bntex")]));
-//                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/vulkan.bntexa")]), // Sample6_10
+////                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/fp.bntex"))]), sqsCL->uniformOffset);
+//                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/vulkan.bntexa"))]), sqsCL->uniformOffset, // Sample6_10
 //                     0);                                          // Sample6_10
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
@@ -1625,8 +2112,8 @@ void MyVulkanManager::drawObject() {
 //    texTri->drawSelf(cmdBuffer,
 //                     sqsCL->pipelineLayout,
 //                     sqsCL->pipeline,
-////                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/fp.bntex")]));
-//                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/vulkan.bntexa")]), // Sample6_10
+////                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/fp.bntex"))]), sqsCL->uniformOffset);
+//                     &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/vulkan.bntexa"))]), sqsCL->uniformOffset, // Sample6_10
 //                     1);                                          // Sample6_10
 //    MatrixState3D::popMatrix();
     /// Sample6_8、Sample6_10 **************************************** end
@@ -1637,14 +2124,14 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::rotate(yAngle, 0, 1, 0);
 //    MatrixState3D::rotate(zAngle, 0, 0, 1);
 //    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,
-//                          &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/boardRed.bn3dtex")]));
+//                          &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/boardRed.bn3dtex"))]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(15, 0, 0);
 //    MatrixState3D::rotate(yAngle, 0, 1, 0);
 //    MatrixState3D::rotate(zAngle, 0, 0, 1);
 //    ballForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,
-//                          &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/boardGreen.bn3dtex")]));
+//                          &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/boardGreen.bn3dtex"))]), sqsCL->uniformOffset);
 //    MatrixState3D::popMatrix();
     /// Sample6_9 **************************************************** end
 
@@ -1657,27 +2144,27 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(startX + SPAN * 2.4f, startY - 1 * SPAN, 0);
 //    texRect->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,
-//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/mipmapIsotropy.bntex")]),
+//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/mipmapIsotropy.bntex"))]), sqsCL->uniformOffset,
 //                      currLodLevel);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(startX + SPAN * 1.35f, startY - 1 * SPAN, 0);
 //    MatrixState3D::rotate(90, 0, 1, 0);
 //    texRect->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,
-//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/mipmapIsotropy.bntex")]),
+//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/mipmapIsotropy.bntex"))]), sqsCL->uniformOffset,
 //                      currLodLevel);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(startX + SPAN * 0.65f, startY - 1 * SPAN, 0);
 //    MatrixState3D::rotate(90, 0, 1, 0);
 //    texRect->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,
-//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/mipmapAnisotropy.bntex")]),
+//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/mipmapAnisotropy.bntex"))]), sqsCL->uniformOffset,
 //                      currLodLevel);
 //    MatrixState3D::popMatrix();
 //    MatrixState3D::pushMatrix();
 //    MatrixState3D::translate(startX + SPAN * -0.4f, startY - 1 * SPAN, 0);
 //    texRect->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline,
-//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex("texture/mipmapAnisotropy.bntex")]),
+//                      &(sqsCL->descSet[TextureManager::getVkDescriptorSetIndex(RES_HANDLE("texture/mipmapAnisotropy.bntex"))]), sqsCL->uniformOffset,
 //                      currLodLevel);
 //    MatrixState3D::popMatrix();
     /// Sample6_11 *************************************************** end
@@ -1688,31 +2175,104 @@ void MyVulkanManager::drawObject() {
 //    MatrixState3D::translate(0, -5.0f, -70.0f);                   // Sample7_4
     MatrixState3D::rotate(yAngle, 0, 1, 0);
     MatrixState3D::rotate(xAngle, 1, 0, 0);
-    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
+    objForDraw->drawSelf(cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
     MatrixState3D::popMatrix();
     /// Sample7_1、Sample7_4 ****************************************** end
 
+    /// 并行录制 ************************************************** start
+    // 物体网格按下标分为若干段作业, 各自录制二级命令缓冲后由主命令缓冲执行(须注释掉上面的内联绘制)
+//    MatrixState3D::pushMatrix();
+//    MatrixState3D::translate(0, -2.0f, -25.0f);
+//    MatrixState3D::rotate(xAngle, 1, 0, 0);
+//    ParallelRecorder::record(cmdBuffer, frameIndex, renderPass, RenderGraph::framebufferOf(scenePass),
+//                             PARALLEL_GRID_SIDE * PARALLEL_GRID_SIDE, recordObjectGrid);
+//    MatrixState3D::popMatrix();
+    /// 并行录制 **************************************************** end
+
+    /// 命令缓冲缓存 ************************************************ start
+    // 物体网格录制在二级命令缓冲中, 旋转角不变时各帧直接执行(渲染通道须以SECONDARY_COMMAND_BUFFERS启动, 须注释掉上面的内联绘制)
+    // 光照与摄像机位置每帧经一致变量环形缓冲传入, 其动态偏移量作为键
+//    if (xAngle != gridCacheXAngle || yAngle != gridCacheYAngle) {         // 绘制列表中的变换矩阵已变化
+//      gridCacheXAngle = xAngle;
+//      gridCacheYAngle = yAngle;
+//      CommandBufferCache::invalidate(gridCacheEntry);
+//    }
+//    CommandBufferCache::execute(cmdBuffer, gridCacheEntry, frameIndex, renderPass, sqsCL->uniformOffset);
+    /// 命令缓冲缓存 ************************************************** end
+
+    /// 几何缓冲池-多绘制间接 ***************************************** start
+    // 共享顶点缓冲只绑定一次, 同一管线与描述集下的网格合并为一次间接调用(逐物体数据由着色器按gl_InstanceIndex索引)
+//    vk::vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sqsCL->pipeline);
+//    vk::vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sqsCL->pipelineLayout, 0, 1,
+//                                &(sqsCL->descSet[0]), 1, &(sqsCL->uniformOffset));
+//    memcpy(objForDraw->pushConstantData, MatrixState3D::getFinalMatrix(), sizeof(float) * 16);
+//    memcpy(objForDraw->pushConstantData + 16, MatrixState3D::getMMatrix(), sizeof(float) * 16);
+//    vk::vkCmdPushConstants(cmdBuffer, sqsCL->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float) * 32,
+//                           objForDraw->pushConstantData);
+//    GeometryPool::addDraw(objForDraw->geometryMesh);                      // 追加各网格的绘制命令
+//    GeometryPool::drawBatch(cmdBuffer);                                   // 一次间接调用绘制所有追加的命令
+    /// 几何缓冲池-多绘制间接 ******************************************* end
+
 //    triForDraw->drawSelf(                                                 // 绘制三色三角形、Sample4_14-卷绕和背面剪裁
-//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]));
-    vk::vkCmdEndRenderPass(cmdBuffer);                                    // 结束渲染通道
+//        cmdBuffer, sqsCL->pipelineLayout, sqsCL->pipeline, &(sqsCL->descSet[0]), sqsCL->uniformOffset);
+    RenderGraph::endPass(cmdBuffer, scenePass);                           // 结束渲染通道(之后交换链图像转为呈现布局)
+//    VirtualTextureManager::recordFeedbackBarrier(cmdBuffer);              // 虚拟纹理-反馈写入对下一帧的CPU读取可见
+    GpuTimer::end(cmdBuffer, frameIndex);                                 // 本帧GPU耗时的终点
     result = vk::vkEndCommandBuffer(cmdBuffer);                           // 结束命令缓冲
+    UniformRing::flush(device);                                           // 刷新本帧写入的一致变量(非一致内存时)
 
-    submit_info[0].waitSemaphoreCount = 1;                                // 等待的信号量数量
-    // 该信号量是前面获取交换链中当前帧索引时设置的。
+    submit_info[0].waitSemaphoreCount = frameWaitSemaphores.size();       // 等待的信号量数量
+    // 第一个信号量是前面获取交换链中当前帧索引时设置的。
     // 这样命令缓冲提交后，在执行前就会等待此信号量到位，避免多个队列同时执行导致的并发问题
-    submit_info[0].pWaitSemaphores = &imageAcquiredSemaphore;             // 等待的信号量列表
-    result = vk::vkQueueSubmit(queueGraphics, 1, submit_info, taskFinishFence); // 提交命令缓冲到指定的队列执行并指定栅栏
-
-    do {
-      result = vk::vkWaitForFences(device, 1, &taskFinishFence, VK_TRUE, FENCE_TIMEOUT); // 循环等待提交到队列的任务完成
-    } while (result == VK_TIMEOUT);                                       // 等待渲染完毕
-    vk::vkResetFences(device, 1, &taskFinishFence);                       // 重置栅栏
+    // 其余为本帧获取的异步上传信号量(传输已完成, 等待不会阻塞)
+    submit_info[0].pWaitSemaphores = frameWaitSemaphores.data();          // 等待的信号量列表
+    submit_info[0].pWaitDstStageMask = frameWaitStages.data();            // 各信号量对应的等待阶段
+    submit_info[0].signalSemaphoreCount = HeadlessRenderer::enabled ? 0 : 1; // 渲染完毕后设置当前图像的渲染完成信号量(不呈现时不设置)
+    submit_info[0].pSignalSemaphores = &renderFinishedSemaphores[currentBuffer];
+    vk::vkResetFences(device, 1, &frame.fence);                           // 重置栅栏(紧接提交之前, 保证每次等待都有对应的提交)
+    result = vk::vkQueueSubmit(queueGraphics, 1, submit_info, frame.fence); // 提交命令缓冲到指定的队列执行并指定栅栏
+    if (commandCacheBenchmark) {
+      stepCommandCacheBenchmark(std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - cpuStart).count());          // 累计本帧的CPU帧时间
+    }
 
-    present.pImageIndices = &currentBuffer;                               // 指定此次呈现的交换链图像索引
-    result = vk::vkQueuePresentKHR(queueGraphics, &present);              // 执行呈现(执行完毕后，就可以看到一帧完整的画面了)
+    if (HeadlessRenderer::enabled) {
+      HeadlessRenderer::recordCpu(std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - cpuStart).count());          // 本帧录制与提交的CPU耗时
+    } else {
+      // 呈现在GPU上等待渲染完成信号量, CPU不再等待本帧执行完毕, 直接开始记录下一帧
+      present.pWaitSemaphores = &renderFinishedSemaphores[currentBuffer];
+      present.pImageIndices = &currentBuffer;                             // 指定此次呈现的交换链图像索引
+      result = vk::vkQueuePresentKHR(queueGraphics, &present);            // 执行呈现(执行完毕后，就可以看到一帧完整的画面了)
+      if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        swapChainOutOfDate = true;                                        // 下一帧开始前重建(表面丢失由下一次获取图像处理)
+      }
+    }
+    frameIndex = (frameIndex + 1) % framesInFlight;                       // 下一帧使用下一套上下文
+    drawnFrames++;
+    if (HeadlessRenderer::enabled && drawnFrames >= HeadlessRenderer::frameCount) {
+      loopDrawFlag = false;                                               // 离屏无窗口模式绘制固定帧数后结束
+    }
 
-    FPSUtil::after(60);                                             // 限制FPS不超过指定的值
+    bool pace = !framesInFlightBenchmark && !commandCacheBenchmark && !HeadlessRenderer::enabled; // 测试与离屏绘制时不限帧率
+    FramePacer::end(pace);                                                // 等待到下一帧的开始时刻
   }
+  waitFramesInFlight();                                                   // 销毁资源之前等待所有在途帧执行完毕
+  FramePacer::logStats();
+  if (HeadlessRenderer::enabled) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {                      // 读取最后几帧的GPU耗时
+      double gpuMs;
+      if (GpuTimer::read(device, i, gpuMs)) {
+        HeadlessRenderer::recordGpu(gpuMs);
+      }
+    }
+    HeadlessRenderer::logStats();
+    if (HeadlessRenderer::readback && drawnFrames > 0) {                  // 保存最后一帧绘制的离屏图像
+      HeadlessRenderer::saveImage(device, queueGraphics, cmdBuffer, swapchainImages[currentBuffer],
+                                  HeadlessRenderer::outputPath);
+    }
+  }
+  JobSystem::logStats();
 }
 
 /**
@@ -1725,6 +2285,9 @@ void MyVulkanManager::initPipeline() {
 //  sqsDTL = new ShaderQueueSuit_Earth(&device, renderPass, memoryroperties);
 //  sqsSTL = new ShaderQueueSuit_Moon(&device, renderPass, memoryroperties);
   /// Sample6_6 **************************************************** end
+
+//  sqsBL = new ShaderQueueSuit_Bindless(&device, renderPass, memoryroperties); // 无绑定纹理(须在纹理表创建之后)
+//  sqsVT = new ShaderQueueSuit_VirtualTexture(&device, renderPass, memoryroperties); // 虚拟纹理(须在虚拟纹理创建之后)
 }
 
 /**
@@ -1736,6 +2299,12 @@ void MyVulkanManager::destroyPipeline() {
   /// Sample6_6
 //  delete sqsDTL;
 //  delete sqsSTL;
+
+  /// 无绑定纹理
+//  delete sqsBL;
+
+  /// 虚拟纹理
+//  delete sqsVT;
 }
 
 /**
@@ -1746,3 +2315,56 @@ void MyVulkanManager::doVulkan() {
   thread t1(&ThreadTask::doTask, tt);                             // 创建线程执行任务方法doTask
   t1.detach();                                                    // 将子线程与主线程分离
 }
+
+/**
+ * 窗口可用(主线程)
+ * 第一次启动绘制线程完成全部初始化; 之后绘制线程仍在运行, 只需通知它在新窗口上重建表面与交换链
+ */
+void MyVulkanManager::onWindowInit() {
+  std::unique_lock<std::mutex> lock(windowMutex);
+  windowReady = true;
+  if (!vulkanRunning) {
+    vulkanRunning = true;
+    loopDrawFlag = true;
+    lock.unlock();
+    doVulkan();
+    return;
+  }
+  windowCond.notify_all();
+}
+
+/**
+ * 窗口终止(主线程)
+ * 返回后窗口即失效, 须等待绘制线程销毁建立在该窗口上的交换链与表面; 设备、管线、纹理与网格保留
+ */
+void MyVulkanManager::onWindowTerm() {
+  std::unique_lock<std::mutex> lock(windowMutex);
+  windowReady = false;
+  windowCond.notify_all();
+  windowCond.wait(lock, [] { return !surfaceInUse || !vulkanRunning; }); // 表面尚未创建时绘制线程创建前会重新检查窗口
+}
+
+/**
+ * 焦点变化(主线程): 失去焦点时暂停绘制, 交换链保留
+ */
+void MyVulkanManager::onFocusChanged(bool focused) {
+  std::lock_guard<std::mutex> lock(windowMutex);
+  drawPaused = !focused;
+  windowCond.notify_all();
+}
+
+/**
+ * 窗口尺寸变化(主线程): 绘制线程在下一帧开始前重建交换链
+ */
+void MyVulkanManager::onWindowResized() {
+  swapChainOutOfDate = true;
+}
+
+/**
+ * 应用销毁(主线程): 结束绘制循环, 绘制线程随后销毁全部Vulkan对象
+ */
+void MyVulkanManager::onAppDestroy() {
+  std::lock_guard<std::mutex> lock(windowMutex);
+  loopDrawFlag = false;
+  windowCond.notify_all();
+}
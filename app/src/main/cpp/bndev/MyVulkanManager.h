@@ -3,6 +3,10 @@
 
 #include <android_native_app_glue.h>
 #include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <vulkan/vulkan.h>
 #include "../vksysutil/vulkan_wrapper.h"
 #include "mylog.h"
@@ -10,17 +14,43 @@
 #include "ShaderQueueSuit_Common.h"
 #include "Cube.h"
 #include "TexDataObject.h"
+#include "DeviceMemoryAllocator.h"
+#include "RenderGraph.h"
 #include "ShaderQueueSuit_Earth.h"
 #include "ShaderQueueSuit_Moon.h"
+#include "ShaderQueueSuit_Bindless.h"
+#include "ShaderQueueSuit_VirtualTexture.h"
 #include "ColorObject.h"
 #include "PlanetData.h"
 
 #define FENCE_TIMEOUT 100000000                           // 栅栏的超时时间
+#define MAX_FRAMES_IN_FLIGHT 3                            // 同时在途帧数的上限(每帧一套命令缓冲与同步对象)
+#define FRAMES_IN_FLIGHT 2                                // 默认同时在途的帧数
+#define FRAMES_IN_FLIGHT_BENCHMARK_FRAMES 300             // 吞吐量测试中每种在途帧数绘制的帧数
+#define PARALLEL_GRID_SIDE 64                             // 并行录制-物体网格每边的物体数(共64 * 64个物体)
+#define COMMAND_CACHE_BENCHMARK_FRAMES 300                // 命令缓冲缓存测试中关闭、开启缓存各绘制的帧数
+
+/**
+ * 一帧独占的命令缓冲与同步对象, 在途帧之间轮流使用
+ */
+struct FrameContext {
+  VkCommandBuffer cmdBuffer;                              // 本帧的命令缓冲
+  VkFence fence;                                          // 本帧提交完成的栅栏(创建时为触发态)
+  VkSemaphore imageAcquiredSemaphore;                     // 本帧的交换链图像获取完成信号量
+};
 
 class MyVulkanManager {
  public:
   static android_app *Android_application;                // Android应用指针
-  static bool loopDrawFlag;                               // 绘制的循环工作标志
+  static std::atomic<bool> loopDrawFlag;                  // 绘制的循环工作标志
+  static std::mutex windowMutex;                          // 保护窗口状态(主线程与绘制线程之间)
+  static std::condition_variable windowCond;              // 窗口状态或表面释放的通知
+  static bool vulkanRunning;                              // 绘制线程是否在运行(设备等在窗口之间保留)
+  static std::atomic<bool> windowReady;                   // 窗口是否可用(APP_CMD_INIT_WINDOW到APP_CMD_TERM_WINDOW之间)
+  static std::atomic<bool> drawPaused;                    // 失去焦点时暂停绘制(保留交换链)
+  static bool surfaceInUse;                               // 绘制线程正在创建或使用建立在窗口上的表面(只在windowMutex下访问)
+  static bool queueFamiliesChosen;                        // 队列家族是否已选定(销毁逻辑设备时重置)
+  static std::atomic<bool> swapChainOutOfDate;            // 窗口尺寸变化或呈现返回过时, 下一帧开始前重建交换链
   static std::vector<const char *> instanceExtensionNames;// 需要使用的实例扩展名称列表
   static VkInstance instance;                             // Vulkan实例
   static uint32_t gpuCount;                               // 物理设备数量
@@ -29,11 +59,17 @@ class MyVulkanManager {
   static std::vector<VkQueueFamilyProperties> queueFamilyprops; // 物理设备对应的队列家族属性列表
   static uint32_t queueGraphicsFamilyIndex;               // 支持图形工作的队列家族索引
   static VkQueue queueGraphics;                           // 支持图形工作的队列
+  static uint32_t queueTransferFamilyIndex;               // 异步上传使用的队列家族索引(没有独立传输家族时与图形家族相同)
+  static VkQueue queueTransfer;                           // 异步上传使用的队列
   static uint32_t queuePresentFamilyIndex;                // 支持显示工作的队列家族索引
   static std::vector<const char *> deviceExtensionNames;  // 所需的设备扩展名称列表
+  static bool displayTimingSupported;                     // 是否启用了VK_GOOGLE_display_timing(用于查询显示器刷新周期)
   static VkDevice device;                                 // 逻辑设备
   static VkCommandPool cmdPool;                           // 命令池
-  static VkCommandBuffer cmdBuffer;                       // 命令缓冲
+  static VkCommandBuffer cmdBuffer;                       // 当前帧的命令缓冲(初始化阶段为0号帧的命令缓冲)
+  static FrameContext frames[MAX_FRAMES_IN_FLIGHT];       // 各帧的命令缓冲与同步对象
+  static int framesInFlight;                              // 同时在途的帧数
+  static int frameIndex;                                  // 当前帧在frames中的下标
   static VkCommandBufferBeginInfo cmd_buf_info;           // 命令缓冲启动信息
   static VkCommandBuffer cmd_bufs[1];                     // 供提交执行的命令缓冲数组
   static VkSubmitInfo submit_info[1];                     // 命令缓冲提交执行信息数组
@@ -51,18 +87,23 @@ class MyVulkanManager {
   static std::vector<VkImageView> swapchainImageViews;    // 交换链对应的图像视图列表
   static VkFormat depthFormat;                            // 深度图像格式
   static VkFormatProperties depthFormatProps;             // 物理设备支持的深度格式属性
-  static VkImage depthImage;                              // 深度缓冲图像
   static VkPhysicalDeviceMemoryProperties memoryroperties;// 物理设备内存属性
-  static VkDeviceMemory memDepth;                         // 深度缓冲图像对应的内存
-  static VkImageView depthImageView;                      // 深度缓冲图像视图
-  static VkSemaphore imageAcquiredSemaphore;              // 渲染目标图像获取完成信号量
+  static std::vector<VkSemaphore> renderFinishedSemaphores; // 各交换链图像的渲染完成信号量(呈现时在GPU上等待)
+  static std::vector<VkFence> imageFences;                // 各交换链图像最后一次被使用的帧的栅栏
+  static std::vector<VkSemaphore> frameWaitSemaphores;    // 每帧图形提交等待的信号量(图像获取与已完成的异步上传)
+  static std::vector<VkPipelineStageFlags> frameWaitStages; // 与等待信号量对应的管线阶段
   static uint32_t currentBuffer;                          // 从交换链中获取的当前渲染用图像对应的缓冲编号
-  static VkRenderPass renderPass;                         // 渲染通道
-  static VkClearValue clear_values[2];                    // 渲染通道用清除帧缓冲深度、颜色附件的数据
-  static VkRenderPassBeginInfo rp_begin;                  // 渲染通道启动信息
-  static VkFence taskFinishFence;                         // 等待任务完毕的栅栏
+  static VkRenderPass renderPass;                         // 场景通道的渲染通道(由渲染图编译)
+  static RGResource colorTarget;                          // 渲染图中的交换链图像(离屏无窗口模式为离屏颜色图像)
+  static RGResource depthTarget;                          // 渲染图中的深度附件(瞬时附件)
+  static RGPass scenePass;                                // 渲染图中绘制场景的通道
+  static std::map<std::pair<VkDescriptorSet, uint32_t>, std::vector<char> > writtenDescriptors; // 各描述集绑定最后写入的描述信息
+  static bool framesInFlightBenchmark;                    // 是否在绘制循环中测试1~3帧在途的吞吐量
+  static bool commandCacheBenchmark;                      // 是否在绘制循环中对比关闭、开启命令缓冲缓存时的CPU帧时间
+  static int gridCacheEntry;                              // 命令缓冲缓存-物体网格的缓存编号(-1为未使用)
+  static float gridCacheXAngle;                           // 命令缓冲缓存-录制物体网格时的旋转角
+  static float gridCacheYAngle;
   static VkPresentInfoKHR present;                        // 呈现信息
-  static VkFramebuffer *framebuffers;                     // 帧缓冲序列首指针
   static ShaderQueueSuit_Common *sqsCL;                   // 着色器管线指针
   static DrawableObjectCommon *triForDraw;                // Sample4_1-绘制用3色三角形物体对象指针
   static DrawableObjectCommon *objForDraw;                // Sample4_2-六角星
@@ -121,12 +162,20 @@ class MyVulkanManager {
   static ColorObject *skyForDrawSmall;
   static DrawableObjectCommon *planetForDraw;
 
+  /// 无绑定纹理
+  static ShaderQueueSuit_Bindless *sqsBL;
+  static std::vector<uint32_t> texIndexList;              // 各纹理在纹理表中的索引(与texNames一一对应)
+
+  /// 虚拟纹理
+  static ShaderQueueSuit_VirtualTexture *sqsVT;
+
   static void init_vulkan_instance();                     // 创建Vulkan实例
   static void enumerate_vulkan_phy_devices();             // 初始化物理设备
   static void create_vulkan_devices();                    // 创建逻辑设备
   static void create_vulkan_CommandBuffer();              // 创建命令缓冲
+  static bool create_vulkan_surface();                    // 创建KHR表面(等待窗口可用, 应用已销毁时返回false)
   static void create_vulkan_swapChain();                  // 初始化交换链
-  static void create_vulkan_DepthBuffer();                // 创建深度缓冲相关
+  static void create_vulkan_DepthBuffer();                // 确定深度缓冲格式(深度图像由渲染图创建)
   static void create_render_pass();                       // 创建渲染通道
   static void init_queue();                               // 获取设备中支持图形工作的队列
   static void create_frame_buffer();                      // 创建帧缓冲
@@ -136,19 +185,36 @@ class MyVulkanManager {
   static void doVulkan();                                 // 启动线程执行Vulkan任务
   static void initPipeline();                             // 初始化管线
   static void createFence();                              // 创建栅栏
+  static void createImageSemaphores();                    // 创建各交换链图像的渲染完成信号量
   static void initPresentInfo();                          // 初始化显示信息
 //  static void initMatrix();                               // 初始化矩阵
   static void initMatrixAndLight();                       // Sample5_2-初始化矩阵和光照
   static void flushUniformBuffer();                       // 将一致变量数据送入缓冲
   static void flushTexToDesSet();                         // 将纹理等数据与描述集关联
   static void destroyFence();                             // 销毁栅栏
+  static void destroyImageSemaphores();                   // 销毁各交换链图像的渲染完成信号量
+  static bool recreateSwapChain();                        // 只重建表面(已释放时)、交换链、深度缓冲与帧缓冲, 应用销毁时返回false
+  static void releaseSurface();                           // 窗口终止时释放帧缓冲、深度缓冲、交换链与表面
+  static bool waitForWindow();                            // 每帧开始时调用: 处理窗口终止、暂停与重建, 返回是否继续绘制
+  static void onWindowInit();                             // 主线程: 窗口可用(第一次启动绘制线程, 之后恢复绘制)
+  static void onWindowTerm();                             // 主线程: 窗口终止, 等待绘制线程释放表面后返回
+  static void onFocusChanged(bool focused);               // 主线程: 焦点变化时暂停或恢复绘制
+  static void onWindowResized();                          // 主线程: 窗口尺寸变化
+  static void onAppDestroy();                             // 主线程: 应用销毁, 结束绘制循环
+  static void waitFramesInFlight();                       // 等待所有在途帧执行完毕
+  static void setFramesInFlight(int frames);              // 设置同时在途的帧数(等待在途帧执行完毕后切换)
+  static void stepFramesInFlightBenchmark();              // 吞吐量测试: 每帧开始时调用, 计时并切换在途帧数
+  static void updateDescriptorSets(uint32_t writeCount, const VkWriteDescriptorSet *writes); // 只写入有变化的描述
+  static void recordObjectGrid(VkCommandBuffer &cmd, uint32_t begin, uint32_t end); // 并行录制-录制物体网格中下标[begin, end)的物体
+  static bool recordCachedGrid(VkCommandBuffer &cmd);     // 命令缓冲缓存-录制整个物体网格(返回录制是否完整)
+  static void stepCommandCacheBenchmark(double cpuMillis); // 命令缓冲缓存测试: 每帧提交后调用, 累计CPU帧时间并切换缓存开关
   static void destroyPipeline();                          // 销毁管线
   static void destroyDrawableObject();                    // 销毁绘制用物体
   static void destroy_textures();                         // 销毁纹理
   static void destroy_frame_buffer();                     // 销毁帧缓冲
   static void destroy_render_pass();                      // 销毁渲染通道
-  static void destroy_vulkan_DepthBuffer();               // 销毁深度缓冲相关
   static void destroy_vulkan_swapChain();                 // 销毁交换链
+  static void destroy_vulkan_surface();                   // 销毁KHR表面
   static void destroy_vulkan_CommandBuffer();             // 销毁命令缓冲
   static void destroy_vulkan_devices();                   // 销毁逻辑设备
   static void destroy_vulkan_instance();                  // 销毁实例
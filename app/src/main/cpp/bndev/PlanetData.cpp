@@ -1,5 +1,6 @@
 #include "PlanetData.h"
 #include <vector>
+#include <math.h>
 
 float *PlanetData::vdata;
 int PlanetData::dataByteCount;
@@ -9,7 +10,7 @@ float toRadian(float degree) {
   return float(degree * 3.1415926535898 / 180);
 }
 
-float *generateTexCoor(int bw, int bh) {
+float *generateTexCoor(int bw, int bh, const AtlasRegion *region) {
   float *result = new float[bw * bh * 6 * 2];
   float sizew = 1.0f / bw;
   float sizeh = 1.0f / bh;
@@ -32,10 +33,15 @@ float *generateTexCoor(int bw, int bh) {
       result[c++] = t + sizeh;
     }
   }
+  if (region != nullptr) {                                                // 映射到纹理图集中的区域
+    for (int i = 0; i < c; i += 2) {
+      TextureAtlas::remap(*region, result[i], result[i + 1]);
+    }
+  }
   return result;
 }
 
-void PlanetData::genPlanetData(float angleSpan) {
+void PlanetData::genPlanetData(float angleSpan, const AtlasRegion *region) {
   const float r = 30.0f;
   std::vector<float> alVertix;
   for (float vAngle = 90; vAngle > -90; vAngle = vAngle - angleSpan) {
@@ -77,7 +83,7 @@ void PlanetData::genPlanetData(float angleSpan) {
     }
   }
 
-  float *texCoor = generateTexCoor((int) (360 / angleSpan), (int) (180 / angleSpan));
+  float *texCoor = generateTexCoor((int) (360 / angleSpan), (int) (180 / angleSpan), region);
   vCount = alVertix.size() / 3;
   dataByteCount = vCount * 8 * sizeof(float);
   vdata = new float[vCount * 8];
@@ -1,12 +1,14 @@
 #ifndef DEEPERVULKAN_PLANETDATA_H
 #define DEEPERVULKAN_PLANETDATA_H
 
+#include "TextureAtlas.h"
+
 class PlanetData {
  public:
   static float *vdata;
   static int dataByteCount;
   static int vCount;
-  static void genPlanetData(float angleSpan);
+  static void genPlanetData(float angleSpan, const AtlasRegion *region = nullptr); // region不为空时纹理坐标映射到图集区域
 };
 
 #endif // DEEPERVULKAN_PLANETDATA_H
@@ -0,0 +1,50 @@
+#ifndef DEEPERVULKAN_SHADERQUEUESUIT_BINDLESS_H
+#define DEEPERVULKAN_SHADERQUEUESUIT_BINDLESS_H
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../util/UniformRing.h"
+
+/**
+ * 无绑定纹理管线(顶点格式与Sample6_1的纹理三角形相同)
+ * BindlessTextureTable启用时: 0号描述集为一致变量, 1号描述集为纹理表, 纹理索引通过片元阶段的推送常量传入
+ * 未启用时退回Sample6_1的方式: 每幅纹理一个描述集(一致变量+纹理采样器), 推送常量布局保持不变
+ */
+class ShaderQueueSuit_Bindless {
+
+ private:
+  VkDescriptorBufferInfo uniformBufferInfo;
+  int NUM_DESCRIPTOR_SETS;
+  std::vector<VkDescriptorSetLayout> descLayouts;
+  VkPipelineShaderStageCreateInfo shaderStages[2];
+  VkVertexInputBindingDescription vertexBinding;
+  VkVertexInputAttributeDescription vertexAttribs[2];
+  VkPipelineCache pipelineCache;
+  VkDevice *devicePointer;
+  VkDescriptorPool descPool;
+
+  void create_uniform_buffer(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties);
+  void destroy_uniform_buffer(VkDevice &device);
+  void create_pipeline_layout(VkDevice &device);
+  void destroy_pipeline_layout(VkDevice &device);
+  void init_descriptor_set(VkDevice &device);
+  void create_shader(VkDevice &device);
+  void destroy_shader(VkDevice &device);
+  void initVertexAttributeInfo();
+  void create_pipe_line(VkDevice &device, VkRenderPass &renderPass);
+  void destroy_pipe_line(VkDevice &device);
+
+ public:
+  int bufferByteCount;
+  uint32_t uniformOffset;
+  VkWriteDescriptorSet writes[2];
+  std::vector<VkDescriptorSet> descSet;                 // 无绑定模式下只有一个(一致变量), 传统模式下每幅纹理一个
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+
+  ShaderQueueSuit_Bindless(VkDevice *deviceIn, VkRenderPass &renderPass,
+                           VkPhysicalDeviceMemoryProperties &memoryroperties);
+  ~ShaderQueueSuit_Bindless();
+};
+
+#endif
@@ -41,57 +41,16 @@ void ShaderQueueSuit_Common::create_uniform_buffer(VkDevice &device,
   bufferByteCount = sizeof(float) * 20;                                   // Sample5_5、7_2
 //  bufferByteCount = sizeof(float);                                        // Sample6_1
 
-  VkBufferCreateInfo buf_info = {};                                       // 构建一致变量缓冲创建信息结构体实例
-  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;                  // 结构体的类型
-  buf_info.pNext = nullptr;                                               // 自定义数据的指针
-  buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;                    // 缓冲的用途
-  buf_info.size = bufferByteCount;                                        // 缓冲总字节数
-  buf_info.queueFamilyIndexCount = 0;                                     // 队列家族数量
-  buf_info.pQueueFamilyIndices = nullptr;                                 // 队列家族索引列表
-  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;                       // 共享模式
-  buf_info.flags = 0;                                                     // 标志
-
-  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &uniformBuf); // 创建一致变量缓冲
-  assert(result == VK_SUCCESS);                                           // 检查创建是否成功
-
-  VkMemoryRequirements mem_reqs;                                          // 内存需求变量
-  vk::vkGetBufferMemoryRequirements(device, uniformBuf, &mem_reqs);       // 获取此缓冲的内存需求
-
-  VkMemoryAllocateInfo alloc_info = {};                                   // 构建内存分配信息结构体实例
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;              // 结构体类型
-  alloc_info.pNext = nullptr;                                             // 自定义数据的指针
-  alloc_info.memoryTypeIndex = 0;                                         // 内存类型索引
-  alloc_info.allocationSize = mem_reqs.size;                              // 缓冲内存分配字节数
-
-  VkFlags requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |       // 需要的内存类型掩码
-      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;                               // 该组合表示分配的设备内存可以被CPU访问，同时保证CPU与GPU访问的一致性
-  bool flag = memoryTypeFromProperties(                                   // 获取所需内存类型索引
-      memoryroperties, mem_reqs.memoryTypeBits, requirements_mask, &alloc_info.memoryTypeIndex);
-
-  if (flag) {
-    LOGI("confirm memory type of uniformBuf succeed, memoryTypeIndex = %d", alloc_info.memoryTypeIndex);
-  } else {
-    LOGE("confirm memory type of uniformBuf failed!");
-  }
-
-  result = vk::vkAllocateMemory(device, &alloc_info, nullptr, &memUniformBuf); // 分配内存
-  assert(result == VK_SUCCESS);                                           // 检查内存分配是否成功
-
-  result = vk::vkBindBufferMemory(device, uniformBuf, memUniformBuf, 0);  // 将内存和一致变量缓冲绑定
-  assert(result == VK_SUCCESS);                                           // 检查绑定操作是否成功
-
-  // 完善了一致变量缓冲信息结构体实例，为后面对缓冲的使用做好准备
-  uniformBufferInfo.buffer = uniformBuf;                                  // 指定一致变量缓冲
-  uniformBufferInfo.offset = 0;                                           // 起始偏移量
-  uniformBufferInfo.range = bufferByteCount;                              // 一致变量缓冲总字节数
+  // 一致变量位于每帧的环形缓冲中, 描述集只记录缓冲与范围, 实际位置在绑定描述集时以动态偏移量指定
+  uniformBufferInfo = UniformRing::descriptorInfo(bufferByteCount);
+  uniformOffset = 0;                                                      // 每帧由flushUniformBuffer写入数据后更新
 }
 
 /**
- * 销毁一致变量缓冲并释放对应设备内存
+ * 销毁一致变量缓冲(环形缓冲由UniformRing统一管理)
  */
 void ShaderQueueSuit_Common::destroy_uniform_buffer(VkDevice &device) {
-  vk::vkDestroyBuffer(device, uniformBuf, nullptr);
-  vk::vkFreeMemory(device, memUniformBuf, nullptr);
+  // 环形缓冲由UniformRing统一创建与销毁, 这里无需释放
 }
 
 /**
@@ -107,7 +66,7 @@ void ShaderQueueSuit_Common::create_pipeline_layout(VkDevice &device) {
   VkDescriptorSetLayoutBinding layout_bindings[1];                        // 描述集布局绑定数组
 //  VkDescriptorSetLayoutBinding layout_bindings[2];                        // Sample6_1、Sample7_4
   layout_bindings[0].binding = 0;                                         // 此绑定的绑定点编号(需要与着色器中给定的对应绑定点编号一致)
-  layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;  // 描述类型(此绑定对应类型为一致变量缓冲)
+  layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;  // 描述类型(此绑定对应类型为一致变量缓冲)
   layout_bindings[0].descriptorCount = 1;                                 // 描述数量
   layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;             // 目标着色器阶段(此绑定对应的是顶点着色器)
 //  layout_bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;           // Sample5_1、5_9、6_1-目标着色器阶段(此绑定对应的是片元着色器)
@@ -183,12 +142,12 @@ void ShaderQueueSuit_Common::destroy_pipeline_layout(VkDevice &device) {
  */
 void ShaderQueueSuit_Common::init_descriptor_set(VkDevice &device) {
   VkDescriptorPoolSize type_count[1];                                     // 描述集池尺寸实例数组
-  type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;                 // 描述类型(一致变量缓冲)
+  type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;         // 描述类型(一致变量缓冲)
   type_count[0].descriptorCount = 1;                                      // 描述数量
 
   /// Sample6_1、Sample7_4 *************************************** start
 //  VkDescriptorPoolSize type_count[2];                                     // 描述集池尺寸实例数组
-//  type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;                 // 第1个描述类型
+//  type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;         // 第1个描述类型
 //  type_count[0].descriptorCount = TextureManager::texNames.size();        // 第1个描述数量
 //  type_count[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;         // 第2个描述类型
 //  type_count[1].descriptorCount = TextureManager::texNames.size();        // 第2个描述数量
@@ -227,7 +186,7 @@ void ShaderQueueSuit_Common::init_descriptor_set(VkDevice &device) {
   writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
   writes[0].pNext = nullptr;
   writes[0].descriptorCount = 1;                                          // 描述数量
-  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;           // 描述类型(一致变量缓冲)
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;   // 描述类型(一致变量缓冲)
   writes[0].pBufferInfo = &uniformBufferInfo;                             // 对应一致变量缓冲的信息
   writes[0].dstArrayElement = 0;                                          // 目标数组起始元素
   writes[0].dstBinding = 0;                                               // 目标绑定编号(与着色器中绑定编号对应)
@@ -4,13 +4,13 @@
 #include <vector>
 #include <vulkan/vulkan.h>
 #include "../vksysutil/vulkan_wrapper.h"
+#include "../util/UniformRing.h"
 
 /**
  * 封装渲染管线
  */
 class ShaderQueueSuit_Common {
  private:
-  VkBuffer uniformBuf;                                // 一致变量缓冲
   VkDescriptorBufferInfo uniformBufferInfo;           // 一致变量缓冲描述信息
   int NUM_DESCRIPTOR_SETS;                            // 描述集数量
   std::vector<VkDescriptorSetLayout> descLayouts;     // 描述集布局列表
@@ -35,7 +35,7 @@ class ShaderQueueSuit_Common {
 
  public:
   int bufferByteCount;                                // 一致缓冲总字节数
-  VkDeviceMemory memUniformBuf;                       // 一致变量缓冲内存
+  uint32_t uniformOffset;                             // 本帧一致变量在环形缓冲中的动态偏移量
 //  VkWriteDescriptorSet writes[1];                     // 一致变量写入描述集
   VkWriteDescriptorSet writes[2];                     // Sample6_1
   std::vector<VkDescriptorSet> descSet;               // 描述集列表
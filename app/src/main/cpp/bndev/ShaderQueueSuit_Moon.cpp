@@ -8,49 +8,19 @@
 
 void ShaderQueueSuit_Moon::create_uniform_buffer(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties) {
   bufferByteCount = sizeof(float) * 20;
-  VkBufferCreateInfo buf_info = {};
-  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  buf_info.pNext = NULL;
-  buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-  buf_info.size = bufferByteCount;
-  buf_info.queueFamilyIndexCount = 0;
-  buf_info.pQueueFamilyIndices = NULL;
-  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  buf_info.flags = 0;
-  VkResult result = vk::vkCreateBuffer(device, &buf_info, NULL, &uniformBuf);
-  assert(result == VK_SUCCESS);
-  VkMemoryRequirements mem_reqs;
-  vk::vkGetBufferMemoryRequirements(device, uniformBuf, &mem_reqs);
-  VkMemoryAllocateInfo alloc_info = {};
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.pNext = NULL;
-  alloc_info.memoryTypeIndex = 0;
-  alloc_info.allocationSize = mem_reqs.size;
-  VkFlags requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-  bool flag = memoryTypeFromProperties(memoryroperties,
-                                       mem_reqs.memoryTypeBits,
-                                       requirements_mask,
-                                       &alloc_info.memoryTypeIndex);
-  if (flag) { LOGE("确定内存类型成功 类型索引为%d", alloc_info.memoryTypeIndex); } else { LOGE("确定内存类型失败!"); }
-  result = vk::vkAllocateMemory(device, &alloc_info, NULL, &memUniformBuf);
-  assert(result == VK_SUCCESS);
-  result = vk::vkBindBufferMemory(device, uniformBuf, memUniformBuf, 0);
-  assert(result == VK_SUCCESS);
-  uniformBufferInfo.buffer = uniformBuf;
-  uniformBufferInfo.offset = 0;
-  uniformBufferInfo.range = bufferByteCount;
+  uniformBufferInfo = UniformRing::descriptorInfo(bufferByteCount);       // 一致变量位于每帧的环形缓冲中
+  uniformOffset = 0;
 }
 
 void ShaderQueueSuit_Moon::destroy_uniform_buffer(VkDevice &device) {
-  vk::vkDestroyBuffer(device, uniformBuf, NULL);
-  vk::vkFreeMemory(device, memUniformBuf, NULL);
+  // 环形缓冲由UniformRing统一创建与销毁, 这里无需释放
 }
 
 void ShaderQueueSuit_Moon::create_pipeline_layout(VkDevice &device) {
   NUM_DESCRIPTOR_SETS = 1;
   VkDescriptorSetLayoutBinding layout_bindings[2];
   layout_bindings[0].binding = 0;
-  layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   layout_bindings[0].descriptorCount = 1;
   layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   layout_bindings[0].pImmutableSamplers = NULL;
@@ -92,7 +62,7 @@ void ShaderQueueSuit_Moon::destroy_pipeline_layout(VkDevice &device) {
 
 void ShaderQueueSuit_Moon::init_descriptor_set(VkDevice &device) {
   VkDescriptorPoolSize type_count[2];
-  type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   type_count[0].descriptorCount = TextureManager::texNamesSingle.size();
   type_count[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
   type_count[1].descriptorCount = TextureManager::texNamesSingle.size();
@@ -121,7 +91,7 @@ void ShaderQueueSuit_Moon::init_descriptor_set(VkDevice &device) {
   writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
   writes[0].pNext = NULL;
   writes[0].descriptorCount = 1;
-  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   writes[0].pBufferInfo = &uniformBufferInfo;
   writes[0].dstArrayElement = 0;
   writes[0].dstBinding = 0;
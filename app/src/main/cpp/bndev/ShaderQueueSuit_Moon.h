@@ -3,11 +3,11 @@
 
 #include <vector>
 #include <vulkan/vulkan.h>
+#include "../util/UniformRing.h"
 
 class ShaderQueueSuit_Moon {
 
  private:
-  VkBuffer uniformBuf;
   VkDescriptorBufferInfo uniformBufferInfo;
   int NUM_DESCRIPTOR_SETS;
   std::vector<VkDescriptorSetLayout> descLayouts;
@@ -30,8 +30,8 @@ class ShaderQueueSuit_Moon {
   void destroy_pipe_line(VkDevice &device);
 
  public:
-  VkDeviceMemory memUniformBuf;
   int bufferByteCount;
+  uint32_t uniformOffset;
   VkWriteDescriptorSet writes[2];
   std::vector<VkDescriptorSet> descSet;
   VkPipelineLayout pipelineLayout;
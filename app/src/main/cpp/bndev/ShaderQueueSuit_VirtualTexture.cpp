@@ -0,0 +1,338 @@
+#include "ShaderQueueSuit_VirtualTexture.h"
+#include <assert.h>
+#include <cstring>
+#include "../util/HelpFunction.h"
+#include "../util/FileUtil.h"
+#include "../util/VirtualTextureManager.h"
+#include "MyVulkanManager.h"
+#include "ShaderCompileUtil.h"
+
+void ShaderQueueSuit_VirtualTexture::create_uniform_buffer(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties) {
+  bufferByteCount = sizeof(int) * 8;                                      // 虚拟纹理参数(两个ivec4)
+  uniformBufferInfo = UniformRing::descriptorInfo(bufferByteCount);       // 一致变量位于每帧的环形缓冲中
+  uniformOffset = 0;
+
+  VirtualTexture *vt = VirtualTextureManager::vt;                         // 参数在创建后不再变化, 每帧原样写入环形缓冲
+  int values[8] = {
+      vt->width, vt->height, vt->pagesX(0), vt->pagesY(0),                // 第0级宽高与页数
+      vt->cacheCols, vt->cacheRows, vt->levels, VT_TILE_CONTENT           // 物理缓存槽位数、mip级数与瓦片内容边长
+  };
+  memcpy(params, values, bufferByteCount);
+}
+void ShaderQueueSuit_VirtualTexture::destroy_uniform_buffer(VkDevice &device) {
+  // 环形缓冲由UniformRing统一创建与销毁, 这里无需释放
+}
+
+void ShaderQueueSuit_VirtualTexture::create_pipeline_layout(VkDevice &device) {
+  NUM_DESCRIPTOR_SETS = 1;
+  VkDescriptorSetLayoutBinding layout_bindings[4];
+  VkDescriptorType types[4] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                               VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+  for (uint32_t i = 0; i < 4; ++i) {
+    layout_bindings[i].binding = i;
+    layout_bindings[i].descriptorType = types[i];
+    layout_bindings[i].descriptorCount = 1;
+    layout_bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    layout_bindings[i].pImmutableSamplers = NULL;
+  }
+  VkDescriptorSetLayoutCreateInfo descriptor_layout = {};
+  descriptor_layout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_layout.pNext = NULL;
+  descriptor_layout.bindingCount = VirtualTextureManager::feedbackSupported ? 4 : 3; // 不支持GPU反馈时没有反馈缓冲
+  descriptor_layout.pBindings = layout_bindings;
+  descLayouts.resize(NUM_DESCRIPTOR_SETS);
+  VkResult result = vk::vkCreateDescriptorSetLayout(device, &descriptor_layout, NULL, descLayouts.data());
+  assert(result == VK_SUCCESS);
+  const unsigned push_constant_range_count = 1;
+  VkPushConstantRange push_constant_ranges[push_constant_range_count] = {};
+  push_constant_ranges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;        // 最终变换矩阵
+  push_constant_ranges[0].offset = 0;
+  push_constant_ranges[0].size = sizeof(float) * 16;
+  VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = {};
+  pPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pPipelineLayoutCreateInfo.pNext = NULL;
+  pPipelineLayoutCreateInfo.pushConstantRangeCount = push_constant_range_count;
+  pPipelineLayoutCreateInfo.pPushConstantRanges = push_constant_ranges;
+  pPipelineLayoutCreateInfo.setLayoutCount = NUM_DESCRIPTOR_SETS;
+  pPipelineLayoutCreateInfo.pSetLayouts = descLayouts.data();
+  result = vk::vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, NULL, &pipelineLayout);
+  assert(result == VK_SUCCESS);
+}
+
+void ShaderQueueSuit_VirtualTexture::destroy_pipeline_layout(VkDevice &device) {
+  for (int i = 0; i < NUM_DESCRIPTOR_SETS; i++) {
+    vk::vkDestroyDescriptorSetLayout(device, descLayouts[i], NULL);
+  }
+  vk::vkDestroyDescriptorPool(device, descPool, NULL);                    // 描述集随描述集池一起释放
+  vk::vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+}
+
+void ShaderQueueSuit_VirtualTexture::init_descriptor_set(VkDevice &device) {
+  uint32_t bindingCount = VirtualTextureManager::feedbackSupported ? 4 : 3;
+  VkDescriptorPoolSize type_count[3];
+  type_count[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  type_count[0].descriptorCount = 1;
+  type_count[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  type_count[1].descriptorCount = 2;
+  type_count[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  type_count[2].descriptorCount = 1;
+  VkDescriptorPoolCreateInfo descriptor_pool = {};
+  descriptor_pool.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  descriptor_pool.pNext = NULL;
+  descriptor_pool.maxSets = NUM_DESCRIPTOR_SETS;
+  descriptor_pool.poolSizeCount = bindingCount - 1;
+  descriptor_pool.pPoolSizes = type_count;
+  VkResult result = vk::vkCreateDescriptorPool(device, &descriptor_pool, NULL, &descPool);
+  assert(result == VK_SUCCESS);
+  VkDescriptorSetAllocateInfo alloc_info[1];
+  alloc_info[0].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info[0].pNext = NULL;
+  alloc_info[0].descriptorPool = descPool;
+  alloc_info[0].descriptorSetCount = NUM_DESCRIPTOR_SETS;
+  alloc_info[0].pSetLayouts = descLayouts.data();
+  descSet.resize(NUM_DESCRIPTOR_SETS);
+  result = vk::vkAllocateDescriptorSets(device, alloc_info, descSet.data());
+  assert(result == VK_SUCCESS);
+  for (uint32_t i = 0; i < 4; ++i) {
+    writes[i] = {};
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].pNext = NULL;
+    writes[i].dstSet = descSet[0];
+    writes[i].dstBinding = i;
+    writes[i].dstArrayElement = 0;
+    writes[i].descriptorCount = 1;
+  }
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  writes[0].pBufferInfo = &uniformBufferInfo;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[1].pImageInfo = &VirtualTextureManager::cacheImageInfo;
+  writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[2].pImageInfo = &VirtualTextureManager::indirectionImageInfo;
+  writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  writes[3].pBufferInfo = &VirtualTextureManager::feedbackBufferInfo;
+  vk::vkUpdateDescriptorSets(device, bindingCount, writes, 0, NULL);     // 资源在创建后不再更换
+}
+
+void ShaderQueueSuit_VirtualTexture::create_shader(VkDevice &device) {
+  std::string vertStr = FileUtil::loadAssetStr("shader/sample6_1.vert");
+  std::string fragStr = FileUtil::loadAssetStr("shader/virtualTex.frag");
+  if (VirtualTextureManager::feedbackSupported) {                         // 在版本声明之后打开反馈写入
+    size_t lineEnd = fragStr.find('\n');
+    fragStr.insert(lineEnd + 1, "#define VT_FEEDBACK\n");
+  }
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].pNext = NULL;
+  shaderStages[0].pSpecializationInfo = NULL;
+  shaderStages[0].flags = 0;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].pName = "main";
+  std::vector<unsigned int> vtx_spv;
+  bool retVal = GLSLtoSPV(VK_SHADER_STAGE_VERTEX_BIT, vertStr.c_str(), vtx_spv);
+  assert(retVal);
+  LOGE("顶点着色器脚本编译SPV成功！");
+  VkShaderModuleCreateInfo moduleCreateInfo;
+  moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleCreateInfo.pNext = NULL;
+  moduleCreateInfo.flags = 0;
+  moduleCreateInfo.codeSize = vtx_spv.size() * sizeof(unsigned int);
+  moduleCreateInfo.pCode = vtx_spv.data();
+  VkResult result = vk::vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderStages[0].module);
+  assert(result == VK_SUCCESS);
+  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[1].pNext = NULL;
+  shaderStages[1].pSpecializationInfo = NULL;
+  shaderStages[1].flags = 0;
+  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[1].pName = "main";
+  std::vector<unsigned int> frag_spv;
+  retVal = GLSLtoSPV(VK_SHADER_STAGE_FRAGMENT_BIT, fragStr.c_str(), frag_spv);
+  assert(retVal);
+  LOGE("片元着色器脚本编译SPV成功！");
+  moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleCreateInfo.pNext = NULL;
+  moduleCreateInfo.flags = 0;
+  moduleCreateInfo.codeSize = frag_spv.size() * sizeof(unsigned int);
+  moduleCreateInfo.pCode = frag_spv.data();
+  result = vk::vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderStages[1].module);
+  assert(result == VK_SUCCESS);
+}
+
+void ShaderQueueSuit_VirtualTexture::destroy_shader(VkDevice &device) {
+  vk::vkDestroyShaderModule(device, shaderStages[0].module, NULL);
+  vk::vkDestroyShaderModule(device, shaderStages[1].module, NULL);
+}
+
+void ShaderQueueSuit_VirtualTexture::initVertexAttributeInfo() {
+  vertexBinding.binding = 0;
+  vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  vertexBinding.stride = sizeof(float) * 5;                               // 顶点位置3个分量, 纹理坐标2个分量
+  vertexAttribs[0].binding = 0;
+  vertexAttribs[0].location = 0;
+  vertexAttribs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+  vertexAttribs[0].offset = 0;
+  vertexAttribs[1].binding = 0;
+  vertexAttribs[1].location = 1;
+  vertexAttribs[1].format = VK_FORMAT_R32G32_SFLOAT;
+  vertexAttribs[1].offset = 12;
+}
+
+void ShaderQueueSuit_VirtualTexture::create_pipe_line(VkDevice &device, VkRenderPass &renderPass) {
+  VkDynamicState dynamicStateEnables[VK_DYNAMIC_STATE_RANGE_SIZE];
+  memset(dynamicStateEnables, 0, sizeof dynamicStateEnables);
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.pNext = NULL;
+  dynamicState.pDynamicStates = dynamicStateEnables;
+  dynamicState.dynamicStateCount = 0;
+  VkPipelineVertexInputStateCreateInfo vi;
+  vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vi.pNext = NULL;
+  vi.flags = 0;
+  vi.vertexBindingDescriptionCount = 1;
+  vi.pVertexBindingDescriptions = &vertexBinding;
+  vi.vertexAttributeDescriptionCount = 2;
+  vi.pVertexAttributeDescriptions = vertexAttribs;
+  VkPipelineInputAssemblyStateCreateInfo ia;
+  ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  ia.pNext = NULL;
+  ia.flags = 0;
+  ia.primitiveRestartEnable = VK_FALSE;
+  ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkPipelineRasterizationStateCreateInfo rs;
+  rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rs.pNext = NULL;
+  rs.flags = 0;
+  rs.polygonMode = VK_POLYGON_MODE_FILL;
+  rs.cullMode = VK_CULL_MODE_NONE;
+  rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rs.depthClampEnable = VK_TRUE;
+  rs.rasterizerDiscardEnable = VK_FALSE;
+  rs.depthBiasEnable = VK_FALSE;
+  rs.depthBiasConstantFactor = 0;
+  rs.depthBiasClamp = 0;
+  rs.depthBiasSlopeFactor = 0;
+  rs.lineWidth = 1.0f;
+  VkPipelineColorBlendAttachmentState att_state[1];
+  att_state[0].colorWriteMask = 0xf;
+  att_state[0].blendEnable = VK_FALSE;
+  att_state[0].alphaBlendOp = VK_BLEND_OP_ADD;
+  att_state[0].colorBlendOp = VK_BLEND_OP_ADD;
+  att_state[0].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+  att_state[0].dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+  att_state[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  att_state[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  VkPipelineColorBlendStateCreateInfo cb;
+  cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  cb.pNext = NULL;
+  cb.flags = 0;
+  cb.attachmentCount = 1;
+  cb.pAttachments = att_state;
+  cb.logicOpEnable = VK_FALSE;
+  cb.logicOp = VK_LOGIC_OP_NO_OP;
+  cb.blendConstants[0] = 1.0f;
+  cb.blendConstants[1] = 1.0f;
+  cb.blendConstants[2] = 1.0f;
+  cb.blendConstants[3] = 1.0f;
+  VkViewport viewports;
+  viewports.minDepth = 0.0f;
+  viewports.maxDepth = 1.0f;
+  viewports.x = 0;
+  viewports.y = 0;
+  viewports.width = (float) MyVulkanManager::screenWidth;
+  viewports.height = (float) MyVulkanManager::screenHeight;
+  VkRect2D scissor;
+  scissor.extent.width = MyVulkanManager::screenWidth;
+  scissor.extent.height = MyVulkanManager::screenHeight;
+  scissor.offset.x = 0;
+  scissor.offset.y = 0;
+  VkPipelineViewportStateCreateInfo vp = {};
+  vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  vp.pNext = NULL;
+  vp.flags = 0;
+  vp.viewportCount = 1;
+  vp.scissorCount = 1;
+  vp.pScissors = &scissor;
+  vp.pViewports = &viewports;
+  VkPipelineDepthStencilStateCreateInfo ds;
+  ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  ds.pNext = NULL;
+  ds.flags = 0;
+  ds.depthTestEnable = VK_TRUE;
+  ds.depthWriteEnable = VK_TRUE;
+  ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  ds.depthBoundsTestEnable = VK_FALSE;
+  ds.minDepthBounds = 0;
+  ds.maxDepthBounds = 0;
+  ds.stencilTestEnable = VK_FALSE;
+  ds.back.failOp = VK_STENCIL_OP_KEEP;
+  ds.back.passOp = VK_STENCIL_OP_KEEP;
+  ds.back.compareOp = VK_COMPARE_OP_ALWAYS;
+  ds.back.compareMask = 0;
+  ds.back.reference = 0;
+  ds.back.depthFailOp = VK_STENCIL_OP_KEEP;
+  ds.back.writeMask = 0;
+  ds.front = ds.back;
+  VkPipelineMultisampleStateCreateInfo ms;
+  ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  ms.pNext = NULL;
+  ms.flags = 0;
+  ms.pSampleMask = NULL;
+  ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  ms.sampleShadingEnable = VK_FALSE;
+  ms.alphaToCoverageEnable = VK_FALSE;
+  ms.alphaToOneEnable = VK_FALSE;
+  ms.minSampleShading = 0.0;
+  VkGraphicsPipelineCreateInfo pipelineInfo;
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = NULL;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = 0;
+  pipelineInfo.flags = 0;
+  pipelineInfo.pVertexInputState = &vi;
+  pipelineInfo.pInputAssemblyState = &ia;
+  pipelineInfo.pRasterizationState = &rs;
+  pipelineInfo.pColorBlendState = &cb;
+  pipelineInfo.pTessellationState = NULL;
+  pipelineInfo.pMultisampleState = &ms;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.pViewportState = &vp;
+  pipelineInfo.pDepthStencilState = &ds;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = 0;
+  VkPipelineCacheCreateInfo pipelineCacheInfo;
+  pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  pipelineCacheInfo.pNext = NULL;
+  pipelineCacheInfo.initialDataSize = 0;
+  pipelineCacheInfo.pInitialData = NULL;
+  pipelineCacheInfo.flags = 0;
+  VkResult result = vk::vkCreatePipelineCache(device, &pipelineCacheInfo, NULL, &pipelineCache);
+  assert(result == VK_SUCCESS);
+  result = vk::vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, NULL, &pipeline);
+  assert(result == VK_SUCCESS);
+}
+
+void ShaderQueueSuit_VirtualTexture::destroy_pipe_line(VkDevice &device) {
+  vk::vkDestroyPipeline(device, pipeline, NULL);
+  vk::vkDestroyPipelineCache(device, pipelineCache, NULL);
+}
+
+ShaderQueueSuit_VirtualTexture::ShaderQueueSuit_VirtualTexture(VkDevice *deviceIn,
+                                                               VkRenderPass &renderPass,
+                                                               VkPhysicalDeviceMemoryProperties &memoryroperties) {
+  this->devicePointer = deviceIn;
+  create_uniform_buffer(*devicePointer, memoryroperties);
+  create_pipeline_layout(*devicePointer);
+  init_descriptor_set(*devicePointer);
+  create_shader(*devicePointer);
+  initVertexAttributeInfo();
+  create_pipe_line(*devicePointer, renderPass);
+}
+ShaderQueueSuit_VirtualTexture::~ShaderQueueSuit_VirtualTexture() {
+  destroy_pipe_line(*devicePointer);
+  destroy_shader(*devicePointer);
+  destroy_pipeline_layout(*devicePointer);
+  destroy_uniform_buffer(*devicePointer);
+}
\ No newline at end of file
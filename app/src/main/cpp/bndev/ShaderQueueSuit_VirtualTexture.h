@@ -0,0 +1,51 @@
+#ifndef DEEPERVULKAN_SHADERQUEUESUIT_VIRTUALTEXTURE_H
+#define DEEPERVULKAN_SHADERQUEUESUIT_VIRTUALTEXTURE_H
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../util/UniformRing.h"
+
+/**
+ * 虚拟纹理管线(顶点格式与Sample6_1的纹理三角形相同, 须在VirtualTextureManager创建之后创建)
+ * 唯一的描述集: 0-虚拟纹理参数(一致变量) 1-物理缓存纹理 2-间接纹理 3-反馈缓冲(支持GPU反馈时)
+ * 描述集在创建时写入一次, 之后瓦片与页表的变化只改写图像内容; 参数每帧以动态偏移量绑定
+ */
+class ShaderQueueSuit_VirtualTexture {
+
+ private:
+  VkDescriptorBufferInfo uniformBufferInfo;
+  int NUM_DESCRIPTOR_SETS;
+  std::vector<VkDescriptorSetLayout> descLayouts;
+  VkPipelineShaderStageCreateInfo shaderStages[2];
+  VkVertexInputBindingDescription vertexBinding;
+  VkVertexInputAttributeDescription vertexAttribs[2];
+  VkPipelineCache pipelineCache;
+  VkDevice *devicePointer;
+  VkDescriptorPool descPool;
+
+  void create_uniform_buffer(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties);
+  void destroy_uniform_buffer(VkDevice &device);
+  void create_pipeline_layout(VkDevice &device);
+  void destroy_pipeline_layout(VkDevice &device);
+  void init_descriptor_set(VkDevice &device);
+  void create_shader(VkDevice &device);
+  void destroy_shader(VkDevice &device);
+  void initVertexAttributeInfo();
+  void create_pipe_line(VkDevice &device, VkRenderPass &renderPass);
+  void destroy_pipe_line(VkDevice &device);
+
+ public:
+  int bufferByteCount;
+  uint32_t uniformOffset;
+  int params[8];                            // 虚拟纹理参数(由flushUniformBuffer每帧写入环形缓冲)
+  VkWriteDescriptorSet writes[4];
+  std::vector<VkDescriptorSet> descSet;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+
+  ShaderQueueSuit_VirtualTexture(VkDevice *deviceIn, VkRenderPass &renderPass,
+                                 VkPhysicalDeviceMemoryProperties &memoryroperties);
+  ~ShaderQueueSuit_VirtualTexture();
+};
+
+#endif
@@ -1,21 +1,33 @@
 #include "ThreadTask.h"
 #include "MyVulkanManager.h"
 #include "ShaderQueueSuit_Common.h"
+#include "../util/JobSystem.h"
 
 ThreadTask::ThreadTask() {}
 
 ThreadTask::~ThreadTask() {}
 
 void ThreadTask::doTask() {
+  JobSystem::init();                                // 启动作业系统(渲染线程为主线程)
   MyVulkanManager::init_vulkan_instance();          // 创建Vulkan实例
   MyVulkanManager::enumerate_vulkan_phy_devices();  // 获取物理设备列表
   MyVulkanManager::create_vulkan_devices();         // 创建逻辑设备
   MyVulkanManager::create_vulkan_CommandBuffer();   // 创建命令缓冲
   MyVulkanManager::init_queue();                    // 获取设备中支持图形工作的队列
+  if (!MyVulkanManager::create_vulkan_surface()) {  // 创建KHR表面(等待窗口期间应用销毁则直接结束)
+    MyVulkanManager::destroy_vulkan_CommandBuffer();
+    MyVulkanManager::destroy_vulkan_devices();
+    MyVulkanManager::destroy_vulkan_instance();
+    JobSystem::shutdown();
+    std::lock_guard<std::mutex> lock(MyVulkanManager::windowMutex);
+    MyVulkanManager::vulkanRunning = false;
+    MyVulkanManager::windowCond.notify_all();
+    return;
+  }
   MyVulkanManager::create_vulkan_swapChain();       // 初始化交换链
-  MyVulkanManager::create_vulkan_DepthBuffer();     // 创建深度缓冲
-  MyVulkanManager::create_render_pass();            // 创建渲染通道
-  MyVulkanManager::create_frame_buffer();           // 创建帧缓冲
+  MyVulkanManager::create_vulkan_DepthBuffer();     // 确定深度缓冲格式
+  MyVulkanManager::create_render_pass();            // 声明并编译渲染图(创建渲染通道)
+  MyVulkanManager::create_frame_buffer();           // 创建帧缓冲与深度附件
   MyVulkanManager::init_texture();                  // Sample6_1-初始化纹理
   MyVulkanManager::createDrawableObject();          // 创建绘制用的物体
   MyVulkanManager::initPipeline();                  // 初始化渲染管线
@@ -30,9 +42,13 @@ void ThreadTask::doTask() {
   MyVulkanManager::destroy_textures();              // Sample6_1-销毁纹理
   MyVulkanManager::destroy_frame_buffer();          // 销毁帧缓冲
   MyVulkanManager::destroy_render_pass();           // 销毁渲染通道相关
-  MyVulkanManager::destroy_vulkan_DepthBuffer();    // 销毁深度缓冲相关
-  MyVulkanManager::destroy_vulkan_swapChain();      // 销毁交换链相关
+  MyVulkanManager::destroy_vulkan_swapChain();      // 销毁交换链相关(窗口终止时已销毁则跳过)
+  MyVulkanManager::destroy_vulkan_surface();        // 销毁KHR表面
   MyVulkanManager::destroy_vulkan_CommandBuffer();  // 销毁命令缓冲
   MyVulkanManager::destroy_vulkan_devices();        // 销毁逻辑设备
   MyVulkanManager::destroy_vulkan_instance();       // 销毁Vulkan实例
+  JobSystem::shutdown();                            // 停止作业系统
+  std::lock_guard<std::mutex> lock(MyVulkanManager::windowMutex);
+  MyVulkanManager::vulkanRunning = false;           // 之后获得窗口时重新启动绘制线程
+  MyVulkanManager::windowCond.notify_all();         // 等待表面释放的主线程可以返回
 }
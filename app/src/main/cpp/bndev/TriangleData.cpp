@@ -28,3 +28,16 @@ void TriangleData::genVertexData() {          // 顶点数据生成方法
   };
   /// Sample4_14 *************************************************** end
 }
+
+void TriangleData::genTexVertexData(const AtlasRegion *region) {
+  vCount = 3;
+  dataByteCount = vCount * 5 * sizeof(float);
+  vdata = new float[vCount * 5]{                // 每个顶点的位置和纹理坐标(x, y, z, s, t)
+      0, 10, 0, 0.5, 0,
+      -9, -5, 0, 0, 1,
+      9, -5, 0, 1, 1
+  };
+  if (region != nullptr) {
+    TextureAtlas::remapVertexData(*region, vdata, vCount, 5, 3);
+  }
+}
@@ -1,12 +1,15 @@
 #ifndef DEEPERVULKAN_TRIANGLE_DATA_H
 #define DEEPERVULKAN_TRIANGLE_DATA_H
 
+#include "TextureAtlas.h"
+
 class TriangleData {
  public:
   static float *vdata;          // 数据数组首地址指针
   static int dataByteCount;     // 数据所占总字节数量
   static int vCount;            // 顶点数量
   static void genVertexData();  // 生成数据的方法
+  static void genTexVertexData(const AtlasRegion *region = nullptr); // 生成带纹理坐标的数据(region不为空时映射到图集区域)
 };
 
 #endif
@@ -9,6 +9,7 @@
 #include "mylog.h"
 #include "LightManager.h"
 #include "CameraUtil.h"
+#include "HeadlessRenderer.h"
 
 extern "C"
 {
@@ -249,19 +250,31 @@ static void engine_handle_cmd(struct android_app *app, int32_t cmd) {
       LOGI("APP_CMD_SAVE_STATE");
       break;
     case APP_CMD_INIT_WINDOW://初始化窗口事件
-      MyVulkanManager::doVulkan();
+      if (!HeadlessRenderer::enabled) {//离屏无窗口模式已在启动时开始绘制
+        MyVulkanManager::onWindowInit();//第一次启动绘制线程, 之后只重建表面与交换链
+      }
       LOGI("APP_CMD_INIT_WINDOW");
       break;
     case APP_CMD_TERM_WINDOW://终止窗口事件
+      MyVulkanManager::onWindowTerm();//等待绘制线程释放表面与交换链(设备与资源保留)
       LOGI("APP_CMD_TERM_WINDOW");
       break;
+    case APP_CMD_WINDOW_RESIZED://窗口尺寸变化事件
+      MyVulkanManager::onWindowResized();
+      LOGI("APP_CMD_WINDOW_RESIZED");
+      break;
     case APP_CMD_GAINED_FOCUS://获取焦点事件
+      MyVulkanManager::onFocusChanged(true);
       LOGI("APP_CMD_GAINED_FOCUS");
       break;
     case APP_CMD_LOST_FOCUS://失去焦点事件
-      MyVulkanManager::loopDrawFlag = false;
+      MyVulkanManager::onFocusChanged(false);//暂停绘制
       LOGI("APP_CMD_LOST_FOCUS");
       break;
+    case APP_CMD_DESTROY://销毁事件
+      MyVulkanManager::onAppDestroy();//结束绘制循环并销毁全部Vulkan对象
+      LOGI("APP_CMD_DESTROY");
+      break;
   }
 }
 
@@ -279,6 +292,13 @@ void android_main(struct android_app *app) {
   app->onInputEvent = engine_handle_input;
   //将应用指针设置给MyData
   md.app = app;
+  /// 离屏无窗口 ************************************************* start
+  //不等待窗口, 离屏绘制固定帧数后打印CPU、GPU耗时统计并保存最后一帧
+//  HeadlessRenderer::enabled = true;
+//  HeadlessRenderer::readback = true;
+//  HeadlessRenderer::outputPath = std::string(app->activity->internalDataPath) + "/headless.ppm";
+//  MyVulkanManager::doVulkan();
+  /// 离屏无窗口 *************************************************** end
   //标志位
   bool beginFlag = false;
   while (true) {
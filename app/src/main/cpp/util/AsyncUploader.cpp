@@ -0,0 +1,376 @@
+#include "AsyncUploader.h"
+#include <cassert>
+#include <cstring>
+#include "StagingRing.h"
+#include "../bndev/mylog.h"
+
+uint32_t AsyncUploader::transferFamilyIndex = 0;
+uint32_t AsyncUploader::graphicsFamilyIndex = 0;
+bool AsyncUploader::dedicated = false;
+VkDeviceSize AsyncUploader::frameBudgetBytes = UPLOAD_FRAME_BUDGET_BYTES;
+long long AsyncUploader::uploadedBytes = 0;
+int AsyncUploader::uploadedJobs = 0;
+int AsyncUploader::submittedBatches = 0;
+int AsyncUploader::budgetDeferrals = 0;
+int AsyncUploader::batchStarvations = 0;
+VkQueue AsyncUploader::queue = VK_NULL_HANDLE;
+VkCommandPool AsyncUploader::cmdPool = VK_NULL_HANDLE;
+UploadBatch AsyncUploader::batches[UPLOAD_BATCH_COUNT];
+std::deque<int> AsyncUploader::freeBatches;
+std::deque<int> AsyncUploader::submittedBatchList;
+std::deque<int> AsyncUploader::acquiredBatchList;
+std::deque<UploadJob> AsyncUploader::pendingJobs;
+unsigned long long AsyncUploader::nextTicket = 1;
+unsigned long long AsyncUploader::acquiredTicket = 0;
+long long AsyncUploader::frame = 0;
+int AsyncUploader::framesInFlight = 1;
+bool AsyncUploader::initialized = false;
+
+uint32_t AsyncUploader::selectTransferFamily(const std::vector<VkQueueFamilyProperties> &families,
+                                             uint32_t graphicsFamily) {
+  uint32_t best = graphicsFamily;
+  int bestScore = 0;                                                      // 0-图形家族 1-计算家族 2-只支持传输的家族
+  for (uint32_t i = 0; i < families.size(); ++i) {
+    VkQueueFlags flags = families[i].queueFlags;
+    if (families[i].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+    int score;
+    if (flags & VK_QUEUE_COMPUTE_BIT) {                                   // 计算家族隐含支持传输
+      score = 1;
+    } else if (flags & VK_QUEUE_TRANSFER_BIT) {
+      score = 2;
+    } else {
+      continue;
+    }
+    if (score > bestScore) {
+      best = i;
+      bestScore = score;
+    }
+  }
+  return best;
+}
+
+void AsyncUploader::init(VkDevice &device, VkQueue &transferQueue, uint32_t transferFamily, uint32_t graphicsFamily) {
+  queue = transferQueue;
+  transferFamilyIndex = transferFamily;
+  graphicsFamilyIndex = graphicsFamily;
+  dedicated = transferFamily != graphicsFamily;
+
+  VkCommandPoolCreateInfo cmd_pool_info = {};
+  cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmd_pool_info.pNext = nullptr;
+  cmd_pool_info.queueFamilyIndex = transferFamilyIndex;                   // 命令缓冲提交到传输队列
+  cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  VkResult result = vk::vkCreateCommandPool(device, &cmd_pool_info, nullptr, &cmdPool);
+  assert(result == VK_SUCCESS);
+
+  VkCommandBuffer cmdBuffers[UPLOAD_BATCH_COUNT];
+  VkCommandBufferAllocateInfo cmdBAI = {};
+  cmdBAI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBAI.pNext = nullptr;
+  cmdBAI.commandPool = cmdPool;
+  cmdBAI.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBAI.commandBufferCount = UPLOAD_BATCH_COUNT;
+  result = vk::vkAllocateCommandBuffers(device, &cmdBAI, cmdBuffers);
+  assert(result == VK_SUCCESS);
+
+  VkSemaphoreCreateInfo semaphoreInfo;
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = nullptr;
+  semaphoreInfo.flags = 0;
+  for (int i = 0; i < UPLOAD_BATCH_COUNT; ++i) {
+    batches[i].cmdBuffer = cmdBuffers[i];
+    result = vk::vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batches[i].semaphore);
+    assert(result == VK_SUCCESS);
+    batches[i].fence = VK_NULL_HANDLE;
+    batches[i].lastTicket = 0;
+    batches[i].acquireFrame = -1;
+    freeBatches.push_back(i);
+  }
+  initialized = true;
+  LOGI("AsyncUploader: transfer family %d, graphics family %d (%s)", transferFamilyIndex, graphicsFamilyIndex,
+       dedicated ? "dedicated transfer queue" : "shared graphics queue");
+}
+
+void AsyncUploader::destroy(VkDevice &device) {
+  if (!initialized) {
+    return;
+  }
+  logStats();
+  vk::vkQueueWaitIdle(queue);                                             // 等待已提交的上传完成
+  StagingRing::waitIdle(device);
+  for (size_t i = 0; i < pendingJobs.size(); ++i) {                       // 丢弃尚未提交的上传
+    delete[] pendingJobs[i].data;
+  }
+  pendingJobs.clear();
+  VkCommandBuffer cmdBuffers[UPLOAD_BATCH_COUNT];
+  for (int i = 0; i < UPLOAD_BATCH_COUNT; ++i) {
+    cmdBuffers[i] = batches[i].cmdBuffer;
+    vk::vkDestroySemaphore(device, batches[i].semaphore, nullptr);
+    batches[i].jobs.clear();
+  }
+  vk::vkFreeCommandBuffers(device, cmdPool, UPLOAD_BATCH_COUNT, cmdBuffers);
+  vk::vkDestroyCommandPool(device, cmdPool, nullptr);
+  freeBatches.clear();
+  submittedBatchList.clear();
+  acquiredBatchList.clear();
+  nextTicket = 1;
+  acquiredTicket = 0;
+  frame = 0;
+  uploadedBytes = 0;
+  uploadedJobs = 0;
+  submittedBatches = 0;
+  budgetDeferrals = 0;
+  batchStarvations = 0;
+  initialized = false;
+}
+
+bool AsyncUploader::active() {
+  return initialized;
+}
+
+unsigned long long AsyncUploader::uploadImage(VkImage image, uint32_t levels,
+                                              const std::vector<VkBufferImageCopy> &regions,
+                                              unsigned char *data, VkDeviceSize byteCount) {
+  assert(initialized);
+  UploadJob job;
+  job.ticket = nextTicket++;
+  job.image = image;
+  job.levels = levels;
+  job.regions = regions;
+  job.keepLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  job.buffer = VK_NULL_HANDLE;
+  job.bufferOffset = 0;
+  job.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;                  // 纹理在片元着色器中采样
+  job.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+  job.data = data;
+  job.byteCount = byteCount;
+  pendingJobs.push_back(job);
+  return job.ticket;
+}
+
+unsigned long long AsyncUploader::uploadImageRegions(VkImage image, VkImageLayout layout,
+                                                     const std::vector<VkBufferImageCopy> &regions,
+                                                     unsigned char *data, VkDeviceSize byteCount) {
+  assert(initialized && layout == VK_IMAGE_LAYOUT_GENERAL);              // 其他布局的拷贝与采样不能在两个队列上同时进行
+  unsigned long long ticket = uploadImage(image, 1, regions, data, byteCount);
+  pendingJobs.back().keepLayout = layout;
+  return ticket;
+}
+
+unsigned long long AsyncUploader::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data,
+                                               VkDeviceSize byteCount, VkPipelineStageFlags dstStage,
+                                               VkAccessFlags dstAccess) {
+  assert(initialized);
+  UploadJob job;
+  job.ticket = nextTicket++;
+  job.image = VK_NULL_HANDLE;
+  job.levels = 0;
+  job.keepLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  job.buffer = buffer;
+  job.bufferOffset = offset;
+  job.dstStage = dstStage;
+  job.dstAccess = dstAccess;
+  job.data = new unsigned char[byteCount];                                // 调用者的数据可立即释放
+  memcpy(job.data, data, (size_t) byteCount);
+  job.byteCount = byteCount;
+  pendingJobs.push_back(job);
+  return job.ticket;
+}
+
+void AsyncUploader::pump(VkDevice &device) {
+  if (!initialized) {
+    return;
+  }
+  frame++;
+  while (!acquiredBatchList.empty() &&                                    // 等待其信号量的图形提交已完成
+      frame - batches[acquiredBatchList.front()].acquireFrame >= framesInFlight) {
+    freeBatches.push_back(acquiredBatchList.front());
+    acquiredBatchList.pop_front();
+  }
+  if (pendingJobs.empty()) {
+    return;
+  }
+  if (freeBatches.empty()) {                                              // 在途批次已满, 下一帧再提交
+    batchStarvations++;
+    return;
+  }
+
+  int index = freeBatches.front();
+  UploadBatch &batch = batches[index];
+  VkCommandBufferBeginInfo cmd_buf_info = {};
+  cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmd_buf_info.pNext = nullptr;
+  cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  cmd_buf_info.pInheritanceInfo = nullptr;
+  vk::vkResetCommandBuffer(batch.cmdBuffer, 0);
+  VkResult result = vk::vkBeginCommandBuffer(batch.cmdBuffer, &cmd_buf_info);
+  assert(result == VK_SUCCESS);
+
+  VkDeviceSize bytes = 0;
+  while (!pendingJobs.empty()) {
+    UploadJob &job = pendingJobs.front();
+    if (!batch.jobs.empty() && bytes + job.byteCount > frameBudgetBytes) { // 至少上传一项, 超大资源也能前进
+      budgetDeferrals++;
+      break;
+    }
+    if (!recordJob(device, batch.cmdBuffer, job)) {
+      break;
+    }
+    bytes += job.byteCount;
+    delete[] job.data;
+    job.data = nullptr;
+    batch.jobs.push_back(job);
+    pendingJobs.pop_front();
+  }
+  result = vk::vkEndCommandBuffer(batch.cmdBuffer);
+  assert(result == VK_SUCCESS);
+  if (batch.jobs.empty()) {
+    return;
+  }
+
+  freeBatches.pop_front();
+  batch.fence = StagingRing::submit(device, queue, batch.cmdBuffer, batch.semaphore); // 不等待栅栏
+  batch.lastTicket = batch.jobs.back().ticket;
+  batch.acquireFrame = -1;
+  submittedBatchList.push_back(index);
+  submittedBatches++;
+  uploadedJobs += (int) batch.jobs.size();
+  uploadedBytes += bytes;
+}
+
+bool AsyncUploader::recordJob(VkDevice &device, VkCommandBuffer &cmdBuffer, UploadJob &job) {
+  VkDeviceSize stagingOffset;
+  uint8_t *pData;
+  if (!StagingRing::allocate(device, job.byteCount, STAGING_COPY_ALIGNMENT, stagingOffset, pData)) {
+    return false;                                                         // 本批次已占满中转环形缓冲
+  }
+  memcpy(pData, job.data, (size_t) job.byteCount);
+
+  if (job.image != VK_NULL_HANDLE && job.keepLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+    std::vector<VkBufferImageCopy> regions = job.regions;                 // 布局不变, 由信号量保证写入对图形队列可见
+    for (size_t i = 0; i < regions.size(); ++i) {
+      regions[i].bufferOffset += stagingOffset;
+    }
+    vk::vkCmdCopyBufferToImage(cmdBuffer, StagingRing::buffer, job.image, job.keepLayout,
+                               (uint32_t) regions.size(), regions.data());
+    return true;
+  } else if (job.image != VK_NULL_HANDLE) {
+    VkImageMemoryBarrier barrier = {};                                    // 所有级别转换为传输目标布局
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = job.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = job.levels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vk::vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+    std::vector<VkBufferImageCopy> regions = job.regions;
+    for (size_t i = 0; i < regions.size(); ++i) {
+      regions[i].bufferOffset += stagingOffset;
+    }
+    vk::vkCmdCopyBufferToImage(cmdBuffer, StagingRing::buffer, job.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               (uint32_t) regions.size(), regions.data());
+  } else {
+    VkBufferCopy copy;
+    copy.srcOffset = stagingOffset;
+    copy.dstOffset = job.bufferOffset;
+    copy.size = job.byteCount;
+    vk::vkCmdCopyBuffer(cmdBuffer, StagingRing::buffer, job.buffer, 1, &copy);
+  }
+  ownershipBarrier(cmdBuffer, job, true);
+  return true;
+}
+
+void AsyncUploader::ownershipBarrier(VkCommandBuffer &cmdBuffer, const UploadJob &job, bool release) {
+  uint32_t srcFamily = dedicated ? transferFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+  uint32_t dstFamily = dedicated ? graphicsFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+  // 释放: 传输写入 -> (无); 获取: (无) -> 图形队列的首次使用, 两者的布局与家族必须一致
+  VkAccessFlags srcAccess = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+  VkAccessFlags dstAccess = release ? 0 : job.dstAccess;
+  VkPipelineStageFlags srcStage = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : job.dstStage; // 获取时与信号量等待阶段衔接
+  VkPipelineStageFlags dstStage = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : job.dstStage;
+
+  if (job.image != VK_NULL_HANDLE) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;             // 布局转换在释放时执行一次
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.image = job.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = job.levels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vk::vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+  } else {
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.buffer = job.buffer;
+    barrier.offset = job.bufferOffset;
+    barrier.size = job.byteCount;
+    vk::vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+  }
+}
+
+void AsyncUploader::recordAcquire(VkDevice &device, VkCommandBuffer &cmdBuffer,
+                                  std::vector<VkSemaphore> &waitSemaphores,
+                                  std::vector<VkPipelineStageFlags> &waitStages) {
+  if (!initialized) {
+    return;
+  }
+  while (!submittedBatchList.empty()) {                                   // 按提交顺序获取, 票号单调完成
+    int index = submittedBatchList.front();
+    UploadBatch &batch = batches[index];
+    if (!StagingRing::poll(device, batch.fence)) {                        // 未完成时不等待, 下一帧再查
+      break;
+    }
+    VkPipelineStageFlags stages = 0;
+    for (size_t i = 0; i < batch.jobs.size(); ++i) {
+      if (dedicated && batch.jobs[i].keepLayout == VK_IMAGE_LAYOUT_UNDEFINED) { // 同一家族时释放屏障已完成布局转换
+        ownershipBarrier(cmdBuffer, batch.jobs[i], false);
+      }
+      stages |= batch.jobs[i].dstStage;
+    }
+    waitSemaphores.push_back(batch.semaphore);                            // 信号量已发出, 等待不会阻塞图形队列
+    waitStages.push_back(stages);
+    acquiredTicket = batch.lastTicket;
+    batch.acquireFrame = frame;
+    batch.jobs.clear();
+    submittedBatchList.pop_front();
+    acquiredBatchList.push_back(index);
+  }
+}
+
+bool AsyncUploader::isComplete(unsigned long long ticket) {
+  return ticket <= acquiredTicket;
+}
+
+void AsyncUploader::setFramesInFlight(int frames) {
+  assert(frames >= 1);
+  framesInFlight = frames;
+}
+
+void AsyncUploader::logStats() {
+  LOGI("AsyncUploader: %d jobs, %lld bytes in %d batches, budget deferrals %d, batch starvations %d, pending %d",
+       uploadedJobs, uploadedBytes, submittedBatches, budgetDeferrals, batchStarvations, (int) pendingJobs.size());
+}
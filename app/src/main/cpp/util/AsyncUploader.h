@@ -0,0 +1,154 @@
+#ifndef DEEPERVULKAN_ASYNCUPLOADER_H_
+#define DEEPERVULKAN_ASYNCUPLOADER_H_
+
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+#define UPLOAD_FRAME_BUDGET_BYTES (4 * 1024 * 1024) // 每帧提交到传输队列的默认上传字节数
+#define UPLOAD_BATCH_COUNT 3                         // 可同时在途的上传批次数(每批一个命令缓冲与信号量)
+
+/**
+ * 等待上传的一项资源(图像的若干级或缓冲的一段)
+ */
+struct UploadJob {
+  unsigned long long ticket;                // 上传票号(按提交顺序递增)
+  VkImage image;                            // 目标图像(上传缓冲时为VK_NULL_HANDLE)
+  uint32_t levels;                          // 目标图像的mipmap级数
+  std::vector<VkBufferImageCopy> regions;   // 图像各级的拷贝区域(bufferOffset相对于data)
+  VkImageLayout keepLayout;                 // 图像保持的布局(UNDEFINED为首次上传, 上传后转换为着色器只读布局)
+  VkBuffer buffer;                          // 目标缓冲(上传图像时为VK_NULL_HANDLE)
+  VkDeviceSize bufferOffset;                // 目标缓冲中的偏移量
+  VkPipelineStageFlags dstStage;            // 图形队列上首次使用该资源的管线阶段
+  VkAccessFlags dstAccess;                  // 图形队列上首次使用该资源的访问类型
+  unsigned char *data;                      // 待上传的数据(记录拷贝后删除)
+  VkDeviceSize byteCount;                   // 待上传的字节数
+};
+
+/**
+ * 一个上传批次: 一次传输队列提交及其在图形队列上的获取
+ */
+struct UploadBatch {
+  VkCommandBuffer cmdBuffer;                // 传输队列上的命令缓冲
+  VkSemaphore semaphore;                    // 传输完成后发出、图形队列提交时等待的信号量
+  VkFence fence;                            // 中转环形缓冲返回的栅栏
+  std::vector<UploadJob> jobs;              // 本批次的资源(数据已删除, 只用于记录获取屏障)
+  unsigned long long lastTicket;            // 本批次最后一项的票号
+  long long acquireFrame;                   // 记录获取屏障的帧号(-1为尚未获取)
+};
+
+/**
+ * 异步上传
+ * 纹理与缓冲数据在传输队列(设备有独立的传输队列家族时)上上传, 不阻塞图形队列也不在CPU上等待栅栏
+ * 每帧调用pump按字节预算提交一批上传; 传输完成后由recordAcquire在图形命令缓冲中记录所有权获取屏障,
+ * 并把信号量加入图形提交的等待列表; 队列家族相同时不转移所有权, 只用信号量排序
+ * 票号按提交顺序完成, isComplete为真后资源即可在图形队列上使用
+ */
+class AsyncUploader {
+ public:
+  static uint32_t transferFamilyIndex;              // 上传使用的队列家族索引
+  static uint32_t graphicsFamilyIndex;              // 图形队列家族索引
+  static bool dedicated;                            // 是否使用独立的传输队列家族(需要转移所有权)
+  static VkDeviceSize frameBudgetBytes;             // 每帧上传字节预算
+  static long long uploadedBytes;                   // 累计上传字节数(统计用)
+  static int uploadedJobs;                          // 累计上传的资源数(统计用)
+  static int submittedBatches;                      // 累计提交的批次数(统计用)
+  static int budgetDeferrals;                       // 因超出预算而推迟到下一帧的次数(统计用)
+  static int batchStarvations;                      // 因没有空闲批次而推迟的次数(统计用)
+
+  /**
+   * 选择上传使用的队列家族: 优先只支持传输的家族, 其次不支持图形的传输/计算家族, 都没有时使用图形家族
+   */
+  static uint32_t selectTransferFamily(const std::vector<VkQueueFamilyProperties> &families,
+                                       uint32_t graphicsFamily);
+
+  /**
+   * 创建传输命令池、各批次的命令缓冲与信号量(须在中转环形缓冲创建之后调用)
+   */
+  static void init(VkDevice &device, VkQueue &transferQueue, uint32_t transferFamily, uint32_t graphicsFamily);
+
+  /**
+   * 等待已提交的上传完成, 丢弃尚未提交的上传并销毁所有对象(须在销毁目标资源之前调用)
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 是否已初始化
+   */
+  static bool active();
+
+  /**
+   * 上传图像的各级数据(图像须为UNDEFINED布局, 上传后为SHADER_READ_ONLY_OPTIMAL布局), 接管data, 返回票号
+   */
+  static unsigned long long uploadImage(VkImage image, uint32_t levels, const std::vector<VkBufferImageCopy> &regions,
+                                        unsigned char *data, VkDeviceSize byteCount);
+
+  /**
+   * 更新图像的部分区域(接管data, 返回票号), 图像始终保持layout布局(须为GENERAL), 不做布局转换与所有权转移
+   * 使用独立传输队列家族时图像须以CONCURRENT共享模式创建; 调用者须保证被写入的区域不在在途的帧中使用
+   */
+  static unsigned long long uploadImageRegions(VkImage image, VkImageLayout layout,
+                                               const std::vector<VkBufferImageCopy> &regions,
+                                               unsigned char *data, VkDeviceSize byteCount);
+
+  /**
+   * 上传缓冲数据(复制data), dstStage/dstAccess为图形队列上首次使用的阶段与访问类型, 返回票号
+   */
+  static unsigned long long uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize byteCount,
+                                         VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+  /**
+   * 每帧调用一次: 在预算内把等待的上传记录到一个命令缓冲并提交到传输队列
+   */
+  static void pump(VkDevice &device);
+
+  /**
+   * 为已完成的批次在图形命令缓冲中记录所有权获取屏障(须在渲染通道之外),
+   * 并把对应信号量与等待阶段追加到本帧图形提交的等待列表
+   */
+  static void recordAcquire(VkDevice &device, VkCommandBuffer &cmdBuffer,
+                            std::vector<VkSemaphore> &waitSemaphores,
+                            std::vector<VkPipelineStageFlags> &waitStages);
+
+  /**
+   * 指定票号的上传是否已被图形队列获取
+   */
+  static bool isComplete(unsigned long long ticket);
+
+  /**
+   * 设置同时在途的帧数, 获取后的批次在这么多帧之后才重用(其信号量的等待已执行完)
+   */
+  static void setFramesInFlight(int frames);
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  static VkQueue queue;                             // 上传使用的队列
+  static VkCommandPool cmdPool;                     // 上传使用的命令池
+  static UploadBatch batches[UPLOAD_BATCH_COUNT];   // 所有批次
+  static std::deque<int> freeBatches;               // 空闲批次
+  static std::deque<int> submittedBatchList;        // 已提交未获取的批次(按提交顺序)
+  static std::deque<int> acquiredBatchList;         // 已获取等待重用的批次(按获取顺序)
+  static std::deque<UploadJob> pendingJobs;         // 尚未提交的上传
+  static unsigned long long nextTicket;             // 下一个票号
+  static unsigned long long acquiredTicket;         // 已获取的最大票号
+  static long long frame;                           // 当前帧号
+  static int framesInFlight;                        // 同时在途的帧数
+  static bool initialized;                          // 是否已初始化
+
+  /**
+   * 把一项上传记录到命令缓冲, 返回是否成功(中转环形缓冲已被本批次占满时返回false)
+   */
+  static bool recordJob(VkDevice &device, VkCommandBuffer &cmdBuffer, UploadJob &job);
+
+  /**
+   * 为资源生成所有权转移屏障(release为true时为传输队列上的释放, 否则为图形队列上的获取)
+   */
+  static void ownershipBarrier(VkCommandBuffer &cmdBuffer, const UploadJob &job, bool release);
+};
+
+#endif //DEEPERVULKAN_ASYNCUPLOADER_H_
@@ -0,0 +1,266 @@
+#include "BindlessTextureTable.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include "TextureManager.h"
+#include "../bndev/mylog.h"
+
+bool BindlessTextureTable::enabled = false;
+uint32_t BindlessTextureTable::capacity = 0;
+VkDescriptorSetLayout BindlessTextureTable::layout = VK_NULL_HANDLE;
+VkDescriptorSet BindlessTextureTable::descSet = VK_NULL_HANDLE;
+VkDescriptorPool BindlessTextureTable::descPool = VK_NULL_HANDLE;
+std::map<std::string, uint32_t> BindlessTextureTable::indexOfTexture;
+std::vector<uint32_t> BindlessTextureTable::freeSlots;
+uint32_t BindlessTextureTable::nextSlot = 0;
+bool BindlessTextureTable::instanceProps2 = false;
+VkPhysicalDeviceDescriptorIndexingFeaturesEXT BindlessTextureTable::indexingFeatures;
+
+/**
+ * 判断扩展属性列表中是否含有指定名称的扩展
+ */
+static bool hasExtension(std::vector<VkExtensionProperties> &extensions, const char *name) {
+  for (size_t i = 0; i < extensions.size(); ++i) {
+    if (strcmp(extensions[i].extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BindlessTextureTable::addInstanceExtensions(std::vector<const char *> &instanceExtensionNames) {
+  uint32_t count = 0;
+  vk::vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);  // 获取实例扩展数量
+  std::vector<VkExtensionProperties> extensions(count);
+  vk::vkEnumerateInstanceExtensionProperties(nullptr, &count, extensions.data());
+  instanceProps2 = hasExtension(extensions, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  if (instanceProps2) {                                                   // 查询描述符索引特性需要此扩展
+    instanceExtensionNames.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  }
+}
+
+bool BindlessTextureTable::checkSupport(VkInstance &instance, VkPhysicalDevice &gpu) {
+  enabled = false;
+  capacity = 0;
+  if (!instanceProps2) {
+    LOGE("bindless textures: %s missing, fall back to per-texture descriptor sets",
+         VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    return false;
+  }
+
+  uint32_t count = 0;
+  vk::vkEnumerateDeviceExtensionProperties(gpu, nullptr, &count, nullptr); // 获取设备扩展数量
+  std::vector<VkExtensionProperties> extensions(count);
+  vk::vkEnumerateDeviceExtensionProperties(gpu, nullptr, &count, extensions.data());
+  if (!hasExtension(extensions, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+      !hasExtension(extensions, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+    LOGE("bindless textures: %s missing, fall back to per-texture descriptor sets",
+         VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    return false;
+  }
+
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vk::vkGetInstanceProcAddr(
+      instance, "vkGetPhysicalDeviceFeatures2KHR");
+  auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR) vk::vkGetInstanceProcAddr(
+      instance, "vkGetPhysicalDeviceProperties2KHR");
+  if (getFeatures2 == nullptr || getProperties2 == nullptr) {
+    LOGE("bindless textures: vkGetPhysicalDeviceFeatures2KHR unavailable, fall back to per-texture descriptor sets");
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};           // 查询设备支持的描述符索引特性
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  VkPhysicalDeviceFeatures2KHR features2 = {};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features2.pNext = &supported;
+  getFeatures2(gpu, &features2);
+  if (!features2.features.shaderSampledImageArrayDynamicIndexing ||      // 用推送常量中的索引访问纹理数组
+      !supported.runtimeDescriptorArray ||                                // 着色器中的纹理数组不指定长度
+      !supported.descriptorBindingPartiallyBound ||                       // 纹理表中允许存在未写入的位置
+      !supported.descriptorBindingSampledImageUpdateAfterBind) {          // 绑定后仍可写入新纹理(并使用更高的数量限制)
+    LOGE("bindless textures: descriptor indexing features missing, fall back to per-texture descriptor sets");
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = {};            // 查询绑定后更新描述集的数量限制
+  limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2KHR properties2 = {};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+  properties2.pNext = &limits;
+  getProperties2(gpu, &properties2);
+  capacity = BINDLESS_MAX_TEXTURES;                                       // 组合图像采样器同时计入采样器与采样图像的限制
+  capacity = std::min(capacity, limits.maxPerStageDescriptorUpdateAfterBindSamplers);
+  capacity = std::min(capacity, limits.maxPerStageDescriptorUpdateAfterBindSampledImages);
+  capacity = std::min(capacity, limits.maxDescriptorSetUpdateAfterBindSamplers);
+  capacity = std::min(capacity, limits.maxDescriptorSetUpdateAfterBindSampledImages);
+  if (capacity < TextureManager::texNames.size()) {
+    LOGE("bindless textures: table capacity %d too small, fall back to per-texture descriptor sets", capacity);
+    capacity = 0;
+    return false;
+  }
+
+  indexingFeatures = {};                                                  // 只启用需要的特性
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+  indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+  indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  enabled = true;
+  LOGI("bindless textures enabled, table capacity %d", capacity);
+  return true;
+}
+
+void BindlessTextureTable::enableDeviceFeatures(VkDeviceCreateInfo &deviceInfo,
+                                                std::vector<const char *> &deviceExtensionNames) {
+  if (!enabled) {
+    return;
+  }
+  deviceExtensionNames.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+  deviceExtensionNames.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  deviceInfo.enabledExtensionCount = deviceExtensionNames.size();
+  deviceInfo.ppEnabledExtensionNames = deviceExtensionNames.data();
+  indexingFeatures.pNext = (void *) deviceInfo.pNext;                     // 链接到设备创建信息上(pEnabledFeatures保持不变)
+  deviceInfo.pNext = &indexingFeatures;
+}
+
+void BindlessTextureTable::create(VkDevice &device) {
+  indexOfTexture.clear();
+  freeSlots.clear();
+  nextSlot = 0;
+  if (!enabled) {
+    return;
+  }
+
+  VkDescriptorSetLayoutBinding binding = {};                              // 纹理表只有一个绑定: 纹理采样器数组
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  binding.descriptorCount = capacity;
+  binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  binding.pImmutableSamplers = nullptr;
+
+  VkDescriptorBindingFlagsEXT bindingFlags =                              // 允许未写入的位置, 允许绑定后写入
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+  bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  bindingFlagsInfo.pNext = nullptr;
+  bindingFlagsInfo.bindingCount = 1;
+  bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+  VkDescriptorSetLayoutCreateInfo descriptor_layout = {};
+  descriptor_layout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptor_layout.pNext = &bindingFlagsInfo;
+  descriptor_layout.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+  descriptor_layout.bindingCount = 1;
+  descriptor_layout.pBindings = &binding;
+  VkResult result = vk::vkCreateDescriptorSetLayout(device, &descriptor_layout, nullptr, &layout);
+  assert(result == VK_SUCCESS);
+
+  VkDescriptorPoolSize type_count[1];
+  type_count[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  type_count[0].descriptorCount = capacity;
+  VkDescriptorPoolCreateInfo descriptor_pool = {};
+  descriptor_pool.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  descriptor_pool.pNext = nullptr;
+  descriptor_pool.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+  descriptor_pool.maxSets = 1;
+  descriptor_pool.poolSizeCount = 1;
+  descriptor_pool.pPoolSizes = type_count;
+  result = vk::vkCreateDescriptorPool(device, &descriptor_pool, nullptr, &descPool);
+  assert(result == VK_SUCCESS);
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.pNext = nullptr;
+  alloc_info.descriptorPool = descPool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &layout;
+  result = vk::vkAllocateDescriptorSets(device, &alloc_info, &descSet);
+  assert(result == VK_SUCCESS);
+}
+
+void BindlessTextureTable::destroy(VkDevice &device) {
+  if (enabled) {
+    vk::vkDestroyDescriptorPool(device, descPool, nullptr);               // 描述集随描述集池一起释放
+    vk::vkDestroyDescriptorSetLayout(device, layout, nullptr);
+  }
+  descPool = VK_NULL_HANDLE;
+  layout = VK_NULL_HANDLE;
+  descSet = VK_NULL_HANDLE;
+  indexOfTexture.clear();
+  freeSlots.clear();
+  nextSlot = 0;
+}
+
+uint32_t BindlessTextureTable::registerTexture(VkDevice &device, std::string texName) {
+  std::map<std::string, uint32_t>::iterator it = indexOfTexture.find(texName);
+  if (it != indexOfTexture.end()) {
+    return it->second;
+  }
+  uint32_t index;
+  if (!enabled) {                                                         // 传统模式: 索引即描述集索引
+    int setIndex = TextureManager::getVkDescriptorSetIndex(texName);
+    assert(setIndex >= 0);
+    index = (uint32_t) setIndex;
+  } else {
+    if (!freeSlots.empty()) {                                             // 优先重用已释放的位置
+      index = freeSlots.back();
+      freeSlots.pop_back();
+    } else {
+      assert(nextSlot < capacity);
+      index = nextSlot++;
+    }
+    updateTexture(device, index, ResourceRegistry::imageInfos[ResourceRegistry::find(texName)]);
+  }
+  indexOfTexture[texName] = index;
+  return index;
+}
+
+void BindlessTextureTable::unregisterTexture(std::string texName) {
+  std::map<std::string, uint32_t>::iterator it = indexOfTexture.find(texName);
+  if (it == indexOfTexture.end()) {
+    return;
+  }
+  if (enabled) {                                                          // 旧的描述不再被访问, 部分绑定下无需清除
+    freeSlots.push_back(it->second);
+  }
+  indexOfTexture.erase(it);
+}
+
+void BindlessTextureTable::updateTexture(VkDevice &device, uint32_t index, const VkDescriptorImageInfo &imageInfo) {
+  if (!enabled) {
+    return;
+  }
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.pNext = nullptr;
+  write.dstSet = descSet;
+  write.dstBinding = 0;
+  write.dstArrayElement = index;                                          // 写入纹理表的指定位置
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &imageInfo;
+  vk::vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+int BindlessTextureTable::getIndex(std::string texName) {
+  std::map<std::string, uint32_t>::iterator it = indexOfTexture.find(texName);
+  return it == indexOfTexture.end() ? -1 : (int) it->second;
+}
+
+void BindlessTextureTable::bindTable(VkCommandBuffer &cmd, VkPipelineLayout &pipelineLayout,
+                                     VkDescriptorSet &uniformSet, uint32_t uniformOffset) {
+  if (!enabled) {
+    return;
+  }
+  VkDescriptorSet sets[2] = {uniformSet, descSet};                        // 0号为一致变量, BINDLESS_SET_INDEX号为纹理表
+  vk::vkCmdBindDescriptorSets(                                            // 只有0号描述集含动态一致变量
+      cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 1, &uniformOffset);
+}
+
+void BindlessTextureTable::bindTexture(VkCommandBuffer &cmd, VkPipelineLayout &pipelineLayout, uint32_t index,
+                                       std::vector<VkDescriptorSet> &classicSets, uint32_t uniformOffset) {
+  if (enabled) {                                                          // 纹理索引已通过推送常量传入
+    return;
+  }
+  vk::vkCmdBindDescriptorSets(
+      cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &classicSets[index], 1, &uniformOffset);
+}
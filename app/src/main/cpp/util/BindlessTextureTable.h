@@ -0,0 +1,94 @@
+#ifndef DEEPERVULKAN_BINDLESSTEXTURETABLE_H_
+#define DEEPERVULKAN_BINDLESSTEXTURETABLE_H_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+#define BINDLESS_MAX_TEXTURES 1024  // 纹理表的最大容量(实际容量还受设备限制)
+#define BINDLESS_SET_INDEX 1        // 纹理表在管线布局中的描述集编号(0号描述集仍为一致变量)
+
+/**
+ * 无绑定纹理表(基于VK_EXT_descriptor_indexing)
+ * 所有纹理放入一个描述集中的大型纹理采样器数组, 绘制时通过推送常量传入纹理在数组中的索引,
+ * 整个纹理表每条管线只绑定一次, 不再按纹理切换描述集
+ * 设备不支持所需特性时自动退回传统方式: 索引即TextureManager中的描述集索引, 每次绘制绑定对应描述集
+ */
+class BindlessTextureTable {
+ public:
+  static bool enabled;                          // 是否使用无绑定模式(由checkSupport决定)
+  static uint32_t capacity;                     // 纹理表容量
+  static VkDescriptorSetLayout layout;          // 纹理表的描述集布局
+  static VkDescriptorSet descSet;               // 纹理表描述集
+
+  /**
+   * 创建Vulkan实例前调用: 实例支持VK_KHR_get_physical_device_properties2时将其加入扩展名称列表
+   */
+  static void addInstanceExtensions(std::vector<const char *> &instanceExtensionNames);
+
+  /**
+   * 创建逻辑设备前调用: 检查设备扩展、描述符索引特性与相关限制, 决定是否启用无绑定模式
+   */
+  static bool checkSupport(VkInstance &instance, VkPhysicalDevice &gpu);
+
+  /**
+   * 创建逻辑设备前调用: 无绑定模式下加入所需设备扩展, 并将描述符索引特性链接到设备创建信息上
+   */
+  static void enableDeviceFeatures(VkDeviceCreateInfo &deviceInfo, std::vector<const char *> &deviceExtensionNames);
+
+  /**
+   * 创建纹理表的描述集布局、描述集池与描述集(传统模式下不创建任何对象)
+   */
+  static void create(VkDevice &device);
+
+  /**
+   * 销毁纹理表
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 将TextureManager中的纹理放入纹理表, 返回绘制时使用的纹理索引(已注册时直接返回原索引)
+   * 传统模式下返回该纹理的描述集索引
+   */
+  static uint32_t registerTexture(VkDevice &device, std::string texName);
+
+  /**
+   * 从纹理表中移除纹理, 其位置可被之后注册的纹理重用
+   */
+  static void unregisterTexture(std::string texName);
+
+  /**
+   * 以新的图像描述信息更新指定索引处的纹理(如流式纹理在占位与完整纹理之间切换时)
+   */
+  static void updateTexture(VkDevice &device, uint32_t index, const VkDescriptorImageInfo &imageInfo);
+
+  /**
+   * 返回已注册纹理的索引, 未注册时返回-1
+   */
+  static int getIndex(std::string texName);
+
+  /**
+   * 绑定管线后调用: 无绑定模式下绑定一致变量描述集与纹理表, 之后的绘制只需推送纹理索引
+   * uniformOffset为一致变量在环形缓冲中的动态偏移量
+   */
+  static void bindTable(VkCommandBuffer &cmd, VkPipelineLayout &pipelineLayout, VkDescriptorSet &uniformSet,
+                        uint32_t uniformOffset);
+
+  /**
+   * 每次绘制前调用: 传统模式下绑定索引对应的描述集, 无绑定模式下什么也不做
+   */
+  static void bindTexture(VkCommandBuffer &cmd, VkPipelineLayout &pipelineLayout, uint32_t index,
+                          std::vector<VkDescriptorSet> &classicSets, uint32_t uniformOffset);
+
+ private:
+  static VkDescriptorPool descPool;             // 纹理表的描述集池
+  static std::map<std::string, uint32_t> indexOfTexture; // 纹理名称对应的纹理表索引
+  static std::vector<uint32_t> freeSlots;       // 已释放可重用的索引
+  static uint32_t nextSlot;                     // 从未使用过的第一个索引
+  static bool instanceProps2;                   // 实例是否启用了VK_KHR_get_physical_device_properties2
+  static VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures; // 需要启用的描述符索引特性
+};
+
+#endif //DEEPERVULKAN_BINDLESSTEXTURETABLE_H_
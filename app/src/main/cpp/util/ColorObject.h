@@ -3,6 +3,7 @@
 
 #include <vulkan/vulkan.h>
 #include <string>
+#include "DeviceMemoryAllocator.h"
 
 class ColorObject {
 
@@ -13,15 +14,20 @@ class ColorObject {
   float *pushConstantData;
   float pointSize;
   VkBuffer vertexDatabuf;
-  VkDeviceMemory vertexDataMem;
+  MemoryAllocation vertexDataMem;
   VkDescriptorBufferInfo vertexDataBufferInfo;
+  bool dynamic;
+  unsigned long long vertexUploadTicket;
+  int geometryMesh;
+  int vertexMovableId;
 
   ColorObject(float *vdataIn,
               int dataByteCount,
               int vCountIn,
               VkDevice &device,
               VkPhysicalDeviceMemoryProperties &memoryroperties,
-              float pointSizeIn);
+              float pointSizeIn,
+              bool dynamicIn = false);
 
   ~ColorObject();
 
@@ -0,0 +1,164 @@
+#include "CommandBufferCache.h"
+#include <cassert>
+#include <chrono>
+#include "GeometryPool.h"
+#include "DeviceMemoryDefragmenter.h"
+#include "../bndev/mylog.h"
+
+bool CommandBufferCache::enabled = true;
+long long CommandBufferCache::hits = 0;
+long long CommandBufferCache::records = 0;
+long long CommandBufferCache::recordMicros = 0;
+int CommandBufferCache::invalidations = 0;
+VkDevice *CommandBufferCache::devicePointer = nullptr;
+VkCommandPool CommandBufferCache::pool = VK_NULL_HANDLE;
+std::vector<CachedCommandEntry> CommandBufferCache::entries;
+std::vector<int> CommandBufferCache::freeEntries;
+unsigned long long CommandBufferCache::stamp = 0;
+unsigned long long CommandBufferCache::invalidatedStamp = 0;
+int CommandBufferCache::lastCompactions = 0;
+int CommandBufferCache::lastMovedResources = 0;
+
+void CommandBufferCache::create(VkDevice &device, uint32_t queueFamilyIndex) {
+  devicePointer = &device;
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.pNext = nullptr;
+  poolInfo.queueFamilyIndex = queueFamilyIndex;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;      // 各录制结果单独重新录制
+  VkResult result = vk::vkCreateCommandPool(device, &poolInfo, nullptr, &pool);
+  assert(result == VK_SUCCESS);
+  lastCompactions = GeometryPool::compactions;
+  lastMovedResources = DeviceMemoryDefragmenter::movedResources;
+}
+
+void CommandBufferCache::destroy(VkDevice &device) {
+  if (devicePointer == nullptr) {
+    return;
+  }
+  logStats();
+  vk::vkDestroyCommandPool(device, pool, nullptr);                        // 同时释放所有录制结果
+  pool = VK_NULL_HANDLE;
+  entries.clear();
+  freeEntries.clear();
+  devicePointer = nullptr;
+}
+
+int CommandBufferCache::add(CachedRecordTask task) {
+  int id;
+  if (!freeEntries.empty()) {
+    id = freeEntries.back();
+    freeEntries.pop_back();
+  } else {
+    id = (int) entries.size();
+    entries.push_back(CachedCommandEntry());
+  }
+  CachedCommandEntry &entry = entries[id];
+  entry.task = task;
+  entry.recordings.clear();
+  entry.invalidatedStamp = ++stamp;
+  entry.live = true;
+  return id;
+}
+
+void CommandBufferCache::remove(int entry) {
+  if (entry < 0) {
+    return;
+  }
+  CachedCommandEntry &e = entries[entry];
+  assert(e.live);
+  for (size_t i = 0; i < e.recordings.size(); i++) {
+    vk::vkFreeCommandBuffers(*devicePointer, pool, 1, &e.recordings[i].cmd);
+  }
+  e.recordings.clear();
+  e.task = nullptr;
+  e.live = false;
+  freeEntries.push_back(entry);
+}
+
+void CommandBufferCache::invalidate(int entry) {
+  entries[entry].invalidatedStamp = ++stamp;
+}
+
+void CommandBufferCache::invalidateAll() {
+  invalidatedStamp = ++stamp;
+  invalidations++;
+}
+
+void CommandBufferCache::beginFrame() {
+  if (GeometryPool::compactions != lastCompactions ||                     // 共享顶点缓冲被替换, 首顶点也已变化
+      DeviceMemoryDefragmenter::movedResources != lastMovedResources) {   // 单独的顶点缓冲或纹理被移动
+    lastCompactions = GeometryPool::compactions;
+    lastMovedResources = DeviceMemoryDefragmenter::movedResources;
+    invalidateAll();
+  }
+}
+
+void CommandBufferCache::execute(VkCommandBuffer &primary, int entry, int slot, VkRenderPass renderPass,
+                                 unsigned long long key) {
+  CachedCommandEntry &e = entries[entry];
+  assert(e.live);
+  CachedRecording *recording = nullptr;
+  for (size_t i = 0; i < e.recordings.size(); i++) {
+    if (e.recordings[i].slot == slot && e.recordings[i].key == key) {
+      recording = &e.recordings[i];
+      break;
+    }
+  }
+  if (recording == nullptr) {                                             // 该帧区域与键下尚无录制结果
+    CachedRecording created = {};
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.commandPool = pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = 1;
+    VkResult result = vk::vkAllocateCommandBuffers(*devicePointer, &allocInfo, &created.cmd);
+    assert(result == VK_SUCCESS);
+    created.slot = slot;
+    created.key = key;
+    created.renderPass = renderPass;
+    created.stamp = 0;                                                    // 早于任何失效, 必然录制
+    created.complete = false;
+    e.recordings.push_back(created);
+    recording = &e.recordings.back();
+  }
+  if (!enabled || !recording->complete || recording->renderPass != renderPass ||
+      recording->stamp < e.invalidatedStamp || recording->stamp < invalidatedStamp) {
+    recording->renderPass = renderPass;
+    record(e, *recording);
+  } else {
+    hits++;
+  }
+  vk::vkCmdExecuteCommands(primary, 1, &recording->cmd);
+}
+
+void CommandBufferCache::logStats() {
+  LOGI("CommandBufferCache: %lld hits, %lld records (%.3f ms average), %d invalidations",
+       hits, records, records == 0 ? 0.0 : recordMicros / 1000.0 / records, invalidations);
+}
+
+void CommandBufferCache::record(CachedCommandEntry &entry, CachedRecording &recording) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  VkCommandBufferInheritanceInfo inheritance = {};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.pNext = nullptr;
+  inheritance.renderPass = recording.renderPass;
+  inheritance.subpass = 0;
+  inheritance.framebuffer = VK_NULL_HANDLE;                               // 不绑定帧缓冲, 可在任意交换链图像上执行
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.pNext = nullptr;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;     // 不带ONE_TIME_SUBMIT, 可重复提交
+  beginInfo.pInheritanceInfo = &inheritance;
+  VkResult result = vk::vkBeginCommandBuffer(recording.cmd, &beginInfo);  // 隐式重置上一次的录制结果
+  assert(result == VK_SUCCESS);
+  GeometryPool::invalidateBinding();                                      // 新的命令缓冲需重新绑定共享缓冲
+  recording.complete = entry.task(recording.cmd);
+  result = vk::vkEndCommandBuffer(recording.cmd);
+  assert(result == VK_SUCCESS);
+  recording.stamp = ++stamp;
+  records++;
+  recordMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,115 @@
+#ifndef DEEPERVULKAN_COMMANDBUFFERCACHE_H_
+#define DEEPERVULKAN_COMMANDBUFFERCACHE_H_
+
+#include <vector>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+/**
+ * 录制一段可缓存的绘制命令, 返回录制是否完整(例如几何数据尚在上传而跳过了绘制时返回false, 下次使用前重新录制)
+ */
+typedef std::function<bool(VkCommandBuffer &cmd)> CachedRecordTask;
+
+/**
+ * 一次录制的结果: 帧区域与键相同、且此后没有失效时可直接重用
+ */
+struct CachedRecording {
+  VkCommandBuffer cmd;                      // 二级命令缓冲
+  int slot;                                 // 帧区域(在途帧的序号, 同一区域的上一次提交已确认完成)
+  unsigned long long key;                   // 录制时写入命令的动态数据(如一致变量的动态偏移量)
+  VkRenderPass renderPass;                  // 录制时继承的渲染通道
+  unsigned long long stamp;                 // 录制时的时间戳
+  bool complete;                            // 录制是否完整
+};
+
+/**
+ * 缓存的一组命令: 一个录制回调及其在各帧区域、各键下的录制结果
+ */
+struct CachedCommandEntry {
+  CachedRecordTask task;                    // 录制回调
+  std::vector<CachedRecording> recordings;  // 已有的录制结果
+  unsigned long long invalidatedStamp;      // 最后一次失效的时间戳
+  bool live;                                // 是否有效
+};
+
+/**
+ * 命令缓冲缓存
+ * 场景中静态的部分(绘制列表与管线不变)录制到二级命令缓冲中, 之后各帧在主命令缓冲中直接执行, 不再逐帧录制
+ * 每帧变化的数据经一致变量环形缓冲传入: 动态偏移量录制在命令中, 作为键区分各帧区域的录制结果
+ * 绘制列表或管线变化时由调用者使缓存失效; 描述集被改写、几何缓冲池整理或内存整理移动了资源时全部失效
+ * 同一帧区域的录制结果只在该区域的上一次提交完成后才重新录制, 不与在途帧冲突
+ */
+class CommandBufferCache {
+ public:
+  static bool enabled;                                  // 是否启用缓存(关闭时每次都重新录制, 用于对比)
+  static long long hits;                                // 直接重用录制结果的次数(统计用)
+  static long long records;                             // 录制次数(统计用)
+  static long long recordMicros;                        // 累计录制耗时(微秒, 统计用)
+  static int invalidations;                             // 全部失效的次数(统计用)
+
+  /**
+   * 创建命令池(录制与执行都在渲染线程中进行)
+   */
+  static void create(VkDevice &device, uint32_t queueFamilyIndex);
+
+  /**
+   * 销毁命令池及所有录制结果(须在设备空闲之后调用)
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 添加一组可缓存的命令, 返回其编号
+   */
+  static int add(CachedRecordTask task);
+
+  /**
+   * 删除一组命令(须在引用其录制结果的帧执行完毕之后调用, entry为-1时不做任何事)
+   */
+  static void remove(int entry);
+
+  /**
+   * 使一组命令的录制结果失效(绘制列表或管线变化后调用), 下次执行前重新录制
+   */
+  static void invalidate(int entry);
+
+  /**
+   * 使所有录制结果失效(描述集被改写、顶点缓冲被替换后调用)
+   */
+  static void invalidateAll();
+
+  /**
+   * 每帧调用一次(须在GeometryPool::beginFrame与DeviceMemoryDefragmenter::step之后):
+   * 几何缓冲池整理或内存整理移动了资源时使所有录制结果失效
+   */
+  static void beginFrame();
+
+  /**
+   * 在主命令缓冲中执行一组命令(须在以SECONDARY_COMMAND_BUFFERS启动的渲染通道内调用)
+   * slot为当前在途帧的序号, key为录制时写入命令的动态数据; 没有可重用的录制结果时先录制
+   */
+  static void execute(VkCommandBuffer &primary, int entry, int slot, VkRenderPass renderPass,
+                      unsigned long long key = 0);
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  static VkDevice *devicePointer;                       // 指向逻辑设备的指针
+  static VkCommandPool pool;                            // 录制结果所用的命令池
+  static std::vector<CachedCommandEntry> entries;       // 各组命令(下标为编号)
+  static std::vector<int> freeEntries;                  // 可重用的编号
+  static unsigned long long stamp;                      // 时间戳(每次录制或失效时加1)
+  static unsigned long long invalidatedStamp;           // 最后一次全部失效的时间戳
+  static int lastCompactions;                           // 上一帧时几何缓冲池的整理次数
+  static int lastMovedResources;                        // 上一帧时内存整理移动的资源数
+
+  /**
+   * 把一组命令录制到recording的二级命令缓冲中(先隐式重置)
+   */
+  static void record(CachedCommandEntry &entry, CachedRecording &recording);
+};
+
+#endif //DEEPERVULKAN_COMMANDBUFFERCACHE_H_
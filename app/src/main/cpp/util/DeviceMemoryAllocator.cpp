@@ -0,0 +1,418 @@
+#include "DeviceMemoryAllocator.h"
+#include <cassert>
+#include <algorithm>
+#include "HelpFunction.h"
+#include "../bndev/mylog.h"
+
+VkDeviceSize DeviceMemoryAllocator::bufferImageGranularity = 1;
+VkDeviceSize DeviceMemoryAllocator::nonCoherentAtomSize = 1;
+int DeviceMemoryAllocator::deviceAllocationCount = 0;
+int DeviceMemoryAllocator::liveAllocationCount = 0;
+long long DeviceMemoryAllocator::allocatedBlockBytes = 0;
+long long DeviceMemoryAllocator::usedBytes = 0;
+long long DeviceMemoryAllocator::peakUsedBytes = 0;
+bool DeviceMemoryAllocator::unifiedMemory = false;
+VkPhysicalDeviceMemoryProperties DeviceMemoryAllocator::memoryProperties;
+std::vector<MemoryBlock> DeviceMemoryAllocator::blocks;
+std::mutex DeviceMemoryAllocator::allocatorMutex;
+
+void DeviceMemoryAllocator::init(VkPhysicalDevice &gpu) {
+  VkPhysicalDeviceMemoryProperties props;
+  vk::vkGetPhysicalDeviceMemoryProperties(gpu, &props);
+  VkPhysicalDeviceProperties gpuProps;
+  vk::vkGetPhysicalDeviceProperties(gpu, &gpuProps);
+  init(props, gpuProps.limits.bufferImageGranularity, gpuProps.limits.nonCoherentAtomSize);
+}
+
+void DeviceMemoryAllocator::init(const VkPhysicalDeviceMemoryProperties &memoryroperties,
+                                 VkDeviceSize bufferImageGranularity, VkDeviceSize nonCoherentAtomSize) {
+  memoryProperties = memoryroperties;
+  DeviceMemoryAllocator::bufferImageGranularity = std::max(bufferImageGranularity, (VkDeviceSize) 1);
+  DeviceMemoryAllocator::nonCoherentAtomSize = std::max(nonCoherentAtomSize, (VkDeviceSize) 1);
+  deviceAllocationCount = 0;
+  liveAllocationCount = 0;
+  allocatedBlockBytes = 0;
+  usedBytes = 0;
+  peakUsedBytes = 0;
+  bool allLocal = true;                                                   // 独立显卡至少有一个不在设备本地的系统内存堆
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+    if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+      allLocal = false;
+    }
+  }
+  unifiedMemory = allLocal && hasMemoryType(0xFFFFFFFFu,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+  LOGI("DeviceMemoryAllocator: %d memory types, bufferImageGranularity %d, nonCoherentAtomSize %d, unified %d",
+       (int) memoryProperties.memoryTypeCount, (int) DeviceMemoryAllocator::bufferImageGranularity,
+       (int) DeviceMemoryAllocator::nonCoherentAtomSize, (int) unifiedMemory);
+}
+
+bool DeviceMemoryAllocator::hasMemoryType(uint32_t typeBits, VkFlags requirementsMask) {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+    if ((typeBits & (1u << i)) != 0 &&
+        (memoryProperties.memoryTypes[i].propertyFlags & requirementsMask) == requirementsMask) {
+      return true;
+    }
+  }
+  return false;
+}
+
+VkDeviceSize DeviceMemoryAllocator::blockSizeFor(uint32_t memoryTypeIndex) {
+  const VkMemoryType &type = memoryProperties.memoryTypes[memoryTypeIndex];
+  VkDeviceSize size = (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 ?
+                      MEMORY_HOST_BLOCK_BYTES : MEMORY_BLOCK_BYTES;
+  VkDeviceSize heapSize = memoryProperties.memoryHeaps[type.heapIndex].size;
+  return std::min(size, std::max(heapSize / MEMORY_HEAP_BLOCK_DIVISOR, (VkDeviceSize) 1)); // 小内存堆时相应减小
+}
+
+int DeviceMemoryAllocator::createBlock(VkDevice &device, uint32_t memoryTypeIndex, VkDeviceSize size,
+                                       bool optimal, bool dedicated) {
+  VkMemoryAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.pNext = nullptr;
+  alloc_info.memoryTypeIndex = memoryTypeIndex;
+  alloc_info.allocationSize = size;
+  MemoryBlock block;
+  VkResult result = vk::vkAllocateMemory(device, &alloc_info, nullptr, &block.memory);
+  if (result != VK_SUCCESS) {
+    return -1;
+  }
+  deviceAllocationCount++;
+  block.size = size;
+  block.memoryTypeIndex = memoryTypeIndex;
+  block.optimal = optimal;
+  block.dedicated = dedicated;
+  block.allocator = dedicated ? nullptr : new TlsfAllocator(size);
+  block.mapped = nullptr;
+  block.evacuating = false;
+  if ((memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+    result = vk::vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, (void **) &block.mapped); // 持久映射
+    assert(result == VK_SUCCESS);
+  }
+  allocatedBlockBytes += size;
+  for (size_t i = 0; i < blocks.size(); ++i) {                            // 优先重用已释放块的空位
+    if (blocks[i].memory == VK_NULL_HANDLE) {
+      blocks[i] = block;
+      return (int) i;
+    }
+  }
+  blocks.push_back(block);
+  return (int) blocks.size() - 1;
+}
+
+void DeviceMemoryAllocator::releaseBlock(VkDevice &device, int block) {
+  MemoryBlock &b = blocks[block];
+  if (b.mapped != nullptr) {
+    vk::vkUnmapMemory(device, b.memory);
+  }
+  vk::vkFreeMemory(device, b.memory, nullptr);
+  delete b.allocator;
+  allocatedBlockBytes -= b.size;
+  b.memory = VK_NULL_HANDLE;
+  b.allocator = nullptr;
+  b.mapped = nullptr;
+}
+
+bool DeviceMemoryAllocator::allocate(VkDevice &device, const VkMemoryRequirements &requirements,
+                                     VkFlags requirementsMask, bool optimal, MemoryAllocation &allocation) {
+  allocation.memory = VK_NULL_HANDLE;
+  allocation.offset = 0;
+  allocation.size = 0;
+  allocation.block = -1;
+  allocation.handle = TLSF_NONE;
+  allocation.mapped = nullptr;
+  uint32_t typeIndex;
+  if (!memoryTypeFromProperties(memoryProperties, requirements.memoryTypeBits, requirementsMask, &typeIndex)) {
+    LOGE("DeviceMemoryAllocator: no memory type for bits 0x%x mask 0x%x",
+         requirements.memoryTypeBits, (unsigned) requirementsMask);
+    return false;
+  }
+  VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[typeIndex].propertyFlags;
+  VkDeviceSize alignment = std::max(requirements.alignment, (VkDeviceSize) 1);
+  if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 && (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+    alignment = std::max(alignment, nonCoherentAtomSize);                 // 刷新范围不与相邻资源重叠
+  }
+  bool group = bufferImageGranularity > 1 && optimal;                     // 粒度为1时不区分资源种类
+
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  VkDeviceSize blockSize = blockSizeFor(typeIndex);
+  int block = -1;
+  uint64_t offset = 0;
+  uint32_t handle = TLSF_NONE;
+  if (requirements.size > blockSize / 2) {                                // 大资源单独分配, 避免浪费内存块
+    block = createBlock(device, typeIndex, requirements.size, group, true);
+  } else {
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      MemoryBlock &b = blocks[i];
+      if (b.memory == VK_NULL_HANDLE || b.dedicated || b.evacuating ||
+          b.memoryTypeIndex != typeIndex || b.optimal != group) {
+        continue;
+      }
+      if (b.allocator->allocate(requirements.size, alignment, offset, handle)) {
+        block = (int) i;
+        break;
+      }
+    }
+    while (block < 0 && blockSize >= requirements.size) {                 // 分配新的内存块, 失败时逐次减半
+      block = createBlock(device, typeIndex, blockSize, group, false);
+      if (block >= 0) {
+        bool ok = blocks[block].allocator->allocate(requirements.size, alignment, offset, handle);
+        assert(ok);
+      } else {
+        blockSize /= 2;
+      }
+    }
+  }
+  if (block < 0) {
+    LOGE("DeviceMemoryAllocator: out of memory (type %d, %d bytes)", (int) typeIndex, (int) requirements.size);
+    return false;
+  }
+
+  fillAllocation(block, typeIndex, offset, handle, allocation);
+  return true;
+}
+
+void DeviceMemoryAllocator::fillAllocation(int block, uint32_t memoryTypeIndex, uint64_t offset, uint32_t handle,
+                                           MemoryAllocation &allocation) {
+  MemoryBlock &b = blocks[block];
+  allocation.memory = b.memory;
+  allocation.offset = b.dedicated ? 0 : offset;
+  allocation.size = b.dedicated ? b.size : b.allocator->sizeOf(handle);
+  allocation.memoryTypeIndex = memoryTypeIndex;
+  allocation.block = block;
+  allocation.handle = handle;
+  allocation.mapped = b.mapped == nullptr ? nullptr : b.mapped + allocation.offset;
+  liveAllocationCount++;
+  usedBytes += allocation.size;
+  peakUsedBytes = std::max(peakUsedBytes, usedBytes);
+}
+
+bool DeviceMemoryAllocator::allocateMoved(VkDevice &device, const VkMemoryRequirements &requirements,
+                                          const MemoryAllocation &from, MemoryAllocation &allocation) {
+  assert(from.block >= 0);
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  const MemoryBlock &source = blocks[from.block];
+  VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[from.memoryTypeIndex].propertyFlags;
+  VkDeviceSize alignment = std::max(requirements.alignment, (VkDeviceSize) 1);
+  if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 && (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+    alignment = std::max(alignment, nonCoherentAtomSize);
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    MemoryBlock &b = blocks[i];
+    if (b.memory == VK_NULL_HANDLE || b.dedicated || b.evacuating || (int) i == from.block ||
+        b.memoryTypeIndex != from.memoryTypeIndex || b.optimal != source.optimal ||
+        (requirements.memoryTypeBits & (1u << b.memoryTypeIndex)) == 0) {
+      continue;
+    }
+    uint64_t offset = 0;
+    uint32_t handle = TLSF_NONE;
+    if (b.allocator->allocate(requirements.size, alignment, offset, handle)) {
+      fillAllocation((int) i, b.memoryTypeIndex, offset, handle, allocation);
+      return true;
+    }
+  }
+  return false;
+}
+
+void DeviceMemoryAllocator::fragmentationStats(VkDeviceSize &freeBytes, VkDeviceSize &largestFree, int &freeRanges) {
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  collectFreeStats(freeBytes, largestFree, freeRanges);
+}
+
+void DeviceMemoryAllocator::collectFreeStats(VkDeviceSize &freeBytes, VkDeviceSize &largestFree, int &freeRanges) {
+  freeBytes = 0;
+  largestFree = 0;
+  freeRanges = 0;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const MemoryBlock &b = blocks[i];
+    if (b.memory == VK_NULL_HANDLE || b.dedicated) {
+      continue;
+    }
+    freeBytes += b.allocator->size - b.allocator->usedBytes;
+    largestFree = std::max(largestFree, (VkDeviceSize) b.allocator->largestFree());
+    freeRanges += b.allocator->freeBlockCount();
+  }
+}
+
+double DeviceMemoryAllocator::fragmentation() {
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  VkDeviceSize freeBytes, largestFree;
+  int freeRanges;
+  collectFreeStats(freeBytes, largestFree, freeRanges);
+  return freeBytes == 0 ? 0.0 : 1.0 - (double) largestFree / (double) freeBytes;
+}
+
+void DeviceMemoryAllocator::findSparseBlocks(double maxUsage, std::vector<int> &sparse) {
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  sparse.clear();
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const MemoryBlock &b = blocks[i];
+    if (b.memory == VK_NULL_HANDLE || b.dedicated || b.allocator->allocationCount == 0 ||
+        (double) b.allocator->usedBytes >= maxUsage * (double) b.size) {
+      continue;
+    }
+    bool densest = true;                                                  // 同类型中使用率最高的块不清空, 作为目标
+    for (size_t j = 0; j < blocks.size(); ++j) {
+      const MemoryBlock &o = blocks[j];
+      if (j == i || o.memory == VK_NULL_HANDLE || o.dedicated ||
+          o.memoryTypeIndex != b.memoryTypeIndex || o.optimal != b.optimal) {
+        continue;
+      }
+      double usage = (double) o.allocator->usedBytes / (double) o.size;
+      double own = (double) b.allocator->usedBytes / (double) b.size;
+      if (usage > own || (usage == own && j < i)) {
+        densest = false;
+        break;
+      }
+    }
+    if (!densest) {
+      sparse.push_back((int) i);
+    }
+  }
+}
+
+void DeviceMemoryAllocator::setEvacuating(int block, bool evacuating) {
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  if (block >= 0 && block < (int) blocks.size() && blocks[block].memory != VK_NULL_HANDLE) {
+    blocks[block].evacuating = evacuating;
+  }
+}
+
+bool DeviceMemoryAllocator::allocate(VkDevice &device, const VkMemoryRequirements &requirements,
+                                     const VkFlags *preferences, int preferenceCount, bool optimal,
+                                     MemoryAllocation &allocation) {
+  for (int i = 0; i < preferenceCount; ++i) {
+    if (!hasMemoryType(requirements.memoryTypeBits, preferences[i])) {    // 不存在的类型直接跳过, 不打印错误
+      continue;
+    }
+    if (allocate(device, requirements, preferences[i], optimal, allocation)) {
+      return true;
+    }
+  }
+  LOGE("DeviceMemoryAllocator: no preferred memory type for bits 0x%x", requirements.memoryTypeBits);
+  return false;
+}
+
+void DeviceMemoryAllocator::allocateBuffer(VkDevice &device, VkBuffer &buffer, const VkFlags *preferences,
+                                           int preferenceCount, MemoryAllocation &allocation) {
+  VkMemoryRequirements mem_reqs;
+  vk::vkGetBufferMemoryRequirements(device, buffer, &mem_reqs);
+  bool flag = allocate(device, mem_reqs, preferences, preferenceCount, false, allocation);
+  assert(flag);
+  VkResult result = vk::vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+  assert(result == VK_SUCCESS);
+}
+
+void DeviceMemoryAllocator::allocateBuffer(VkDevice &device, VkBuffer &buffer, VkFlags requirementsMask,
+                                           MemoryAllocation &allocation) {
+  VkMemoryRequirements mem_reqs;
+  vk::vkGetBufferMemoryRequirements(device, buffer, &mem_reqs);
+  bool flag = allocate(device, mem_reqs, requirementsMask, false, allocation);
+  assert(flag);
+  VkResult result = vk::vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+  assert(result == VK_SUCCESS);
+}
+
+void DeviceMemoryAllocator::allocateImage(VkDevice &device, VkImage &image, VkFlags requirementsMask, bool optimal,
+                                          MemoryAllocation &allocation) {
+  VkMemoryRequirements mem_reqs;
+  vk::vkGetImageMemoryRequirements(device, image, &mem_reqs);
+  bool flag = allocate(device, mem_reqs, requirementsMask, optimal, allocation);
+  assert(flag);
+  VkResult result = vk::vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+  assert(result == VK_SUCCESS);
+}
+
+void DeviceMemoryAllocator::free(VkDevice &device, MemoryAllocation &allocation) {
+  if (allocation.block < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  MemoryBlock &b = blocks[allocation.block];
+  assert(b.memory == allocation.memory);
+  liveAllocationCount--;
+  usedBytes -= allocation.size;
+  if (b.dedicated) {
+    releaseBlock(device, allocation.block);
+  } else {
+    b.allocator->free(allocation.handle);
+    if (b.allocator->allocationCount == 0) {                              // 同类型已有空块时释放该块
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        const MemoryBlock &o = blocks[i];
+        if ((int) i != allocation.block && o.memory != VK_NULL_HANDLE && !o.dedicated &&
+            o.memoryTypeIndex == b.memoryTypeIndex && o.optimal == b.optimal && o.allocator->allocationCount == 0) {
+          releaseBlock(device, allocation.block);
+          break;
+        }
+      }
+    }
+  }
+  allocation.memory = VK_NULL_HANDLE;
+  allocation.block = -1;
+  allocation.handle = TLSF_NONE;
+  allocation.mapped = nullptr;
+}
+
+void DeviceMemoryAllocator::flush(VkDevice &device, const MemoryAllocation &allocation,
+                                  VkDeviceSize offset, VkDeviceSize size) {
+  if (allocation.block < 0) {
+    return;
+  }
+  VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags;
+  if ((flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) {
+    return;
+  }
+  if (size == VK_WHOLE_SIZE || offset + size > allocation.size) {
+    size = allocation.size - offset;
+  }
+  VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize; // 按原子大小扩展范围
+  VkDeviceSize end = (allocation.offset + offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize *
+                     nonCoherentAtomSize;
+  VkMappedMemoryRange range = {};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.pNext = nullptr;
+  range.memory = allocation.memory;
+  range.offset = begin;
+  range.size = std::min(end, blocks[allocation.block].size) - begin;
+  VkResult result = vk::vkFlushMappedMemoryRanges(device, 1, &range);
+  assert(result == VK_SUCCESS);
+}
+
+void DeviceMemoryAllocator::logStats() {
+  std::lock_guard<std::mutex> lock(allocatorMutex);
+  int blockCount = 0;
+  int dedicatedCount = 0;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const MemoryBlock &b = blocks[i];
+    if (b.memory == VK_NULL_HANDLE) {
+      continue;
+    }
+    blockCount++;
+    if (b.dedicated) {
+      dedicatedCount++;
+    }
+  }
+  VkDeviceSize freeBytes, largest;
+  int freeBlocks;
+  collectFreeStats(freeBytes, largest, freeBlocks);
+  LOGI("DeviceMemoryAllocator: %d blocks (%d dedicated), %d allocations, %lld/%lld bytes used, peak %lld, "
+       "%d vkAllocateMemory calls, %d free ranges, largest free %lld of %lld free, fragmentation %.2f",
+       blockCount, dedicatedCount, liveAllocationCount, usedBytes, allocatedBlockBytes, peakUsedBytes,
+       deviceAllocationCount, freeBlocks, (long long) largest, (long long) freeBytes,
+       freeBytes == 0 ? 0.0 : 1.0 - (double) largest / (double) freeBytes);
+}
+
+void DeviceMemoryAllocator::destroy(VkDevice &device) {
+  logStats();
+  if (liveAllocationCount != 0) {
+    LOGE("DeviceMemoryAllocator: %d allocations still alive at destroy", liveAllocationCount);
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    if (blocks[i].memory != VK_NULL_HANDLE) {
+      releaseBlock(device, (int) i);
+    }
+  }
+  blocks.clear();
+  liveAllocationCount = 0;
+  usedBytes = 0;
+}
@@ -0,0 +1,184 @@
+#ifndef DEEPERVULKAN_DEVICEMEMORYALLOCATOR_H_
+#define DEEPERVULKAN_DEVICEMEMORYALLOCATOR_H_
+
+#include <vector>
+#include <mutex>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "TlsfAllocator.h"
+
+#define MEMORY_BLOCK_BYTES (64 * 1024 * 1024)       // 设备本地内存块的默认字节数
+#define MEMORY_HOST_BLOCK_BYTES (16 * 1024 * 1024)  // 主机可见内存块的默认字节数
+#define MEMORY_HEAP_BLOCK_DIVISOR 8                 // 内存块不超过所在堆的这一分之一(小内存堆)
+
+/**
+ * 从设备内存块中划出的一段, 代替各资源独立分配的VkDeviceMemory
+ */
+struct MemoryAllocation {
+  VkDeviceMemory memory;      // 所在内存块的设备内存
+  VkDeviceSize offset;        // 在内存块中的偏移量(已对齐)
+  VkDeviceSize size;          // 字节数
+  uint32_t memoryTypeIndex;   // 内存类型索引
+  int block;                  // 所在内存块的编号(-1为空分配)
+  uint32_t handle;            // 内存块内的分配句柄
+  unsigned char *mapped;      // 映射后的CPU地址(内存类型不可映射时为nullptr)
+};
+
+/**
+ * 一个设备内存块, 主机可见的内存块在分配时即持久映射
+ */
+struct MemoryBlock {
+  VkDeviceMemory memory;      // 设备内存
+  VkDeviceSize size;          // 字节数
+  uint32_t memoryTypeIndex;   // 内存类型索引
+  bool optimal;               // 是否存放最优平铺的图像(与缓冲、线性图像分开存放)
+  bool dedicated;             // 是否为超过内存块大小的资源单独分配
+  TlsfAllocator *allocator;   // 块内偏移量分配器(单独分配的块为nullptr)
+  unsigned char *mapped;      // 映射后的CPU地址
+  bool evacuating;            // 是否正在被内存整理清空(不再向其中分配)
+};
+
+/**
+ * 设备内存子分配器: 每种内存类型按需分配大的内存块, 资源在块内以TLSF分配偏移量
+ * bufferImageGranularity大于1时最优平铺图像与缓冲、线性图像放在不同的内存块中, 从而无需考虑粒度冲突
+ * 主机可见的内存块持久映射, 资源通过MemoryAllocation::mapped直接写入, 不再调用vkMapMemory
+ * 所有缓冲、图像的内存都应经由此分配, vkAllocateMemory的调用次数只随内存块数增长
+ */
+class DeviceMemoryAllocator {
+ public:
+  static VkDeviceSize bufferImageGranularity;           // 缓冲与最优平铺图像相邻时的粒度要求
+  static VkDeviceSize nonCoherentAtomSize;              // 非一致内存刷新范围的对齐值
+  static int deviceAllocationCount;                     // 累计vkAllocateMemory调用次数(统计用)
+  static int liveAllocationCount;                       // 当前分配数(统计用)
+  static long long allocatedBlockBytes;                 // 当前内存块总字节数(统计用)
+  static long long usedBytes;                           // 当前已分配给资源的字节数(统计用)
+  static long long peakUsedBytes;                       // 已分配字节数的峰值(统计用)
+  static bool unifiedMemory;                            // 是否为统一内存设备(所有堆均为设备本地且有可映射的设备本地类型)
+
+  /**
+   * 读取设备的内存属性与限制, 须在创建逻辑设备之后、创建任何资源之前调用
+   */
+  static void init(VkPhysicalDevice &gpu);
+
+  /**
+   * 以给定的内存属性与限制初始化(主机测试时使用伪造的内存属性表)
+   */
+  static void init(const VkPhysicalDeviceMemoryProperties &memoryroperties, VkDeviceSize bufferImageGranularity,
+                   VkDeviceSize nonCoherentAtomSize);
+
+  /**
+   * 按内存需求与属性掩码分配, optimal为资源是否为最优平铺的图像, 返回是否成功
+   */
+  static bool allocate(VkDevice &device, const VkMemoryRequirements &requirements, VkFlags requirementsMask,
+                       bool optimal, MemoryAllocation &allocation);
+
+  /**
+   * 按偏好顺序依次尝试preferences中的属性掩码, 使用第一个存在且分配成功的内存类型, 返回是否成功
+   */
+  static bool allocate(VkDevice &device, const VkMemoryRequirements &requirements, const VkFlags *preferences,
+                       int preferenceCount, bool optimal, MemoryAllocation &allocation);
+
+  /**
+   * 为缓冲分配内存并绑定
+   */
+  static void allocateBuffer(VkDevice &device, VkBuffer &buffer, VkFlags requirementsMask,
+                             MemoryAllocation &allocation);
+
+  /**
+   * 按偏好顺序为缓冲分配内存并绑定
+   */
+  static void allocateBuffer(VkDevice &device, VkBuffer &buffer, const VkFlags *preferences, int preferenceCount,
+                             MemoryAllocation &allocation);
+
+  /**
+   * 为图像分配内存并绑定, optimal为图像是否为最优平铺
+   */
+  static void allocateImage(VkDevice &device, VkImage &image, VkFlags requirementsMask, bool optimal,
+                            MemoryAllocation &allocation);
+
+  /**
+   * 释放分配, 空的内存块只保留每种类型一个, 单独分配的块立即释放
+   */
+  static void free(VkDevice &device, MemoryAllocation &allocation);
+
+  /**
+   * 写入非一致内存后刷新[offset, offset+size)(相对分配起点), 一致内存时不做任何事
+   */
+  static void flush(VkDevice &device, const MemoryAllocation &allocation,
+                    VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+  /**
+   * 为移动的资源分配: 只在与from同类型、未在清空的已有内存块中分配, 不创建新块, 返回是否成功
+   */
+  static bool allocateMoved(VkDevice &device, const VkMemoryRequirements &requirements,
+                            const MemoryAllocation &from, MemoryAllocation &allocation);
+
+  /**
+   * 碎片统计: 所有子分配内存块中的空闲总字节数、最大的单个空闲段与空闲段数
+   */
+  static void fragmentationStats(VkDeviceSize &freeBytes, VkDeviceSize &largestFree, int &freeRanges);
+
+  /**
+   * 碎片率: 1 - 最大空闲段 / 空闲总字节数(0为空闲空间连续, 接近1时大资源可能分配失败)
+   */
+  static double fragmentation();
+
+  /**
+   * 查找使用率低于maxUsage的稀疏内存块(每种类型保留使用率最高的块作为整理的目标)
+   */
+  static void findSparseBlocks(double maxUsage, std::vector<int> &sparse);
+
+  /**
+   * 标记内存块是否正在被清空
+   */
+  static void setEvacuating(int block, bool evacuating);
+
+  /**
+   * 打印统计信息: 内存块数、已用与总字节数、空闲段数与最大空闲段、碎片率
+   */
+  static void logStats();
+
+  /**
+   * 释放所有内存块(须在销毁所有资源之后调用), 仍有未释放的分配时打印警告
+   */
+  static void destroy(VkDevice &device);
+
+ private:
+  static VkPhysicalDeviceMemoryProperties memoryProperties; // 设备内存属性
+  static std::vector<MemoryBlock> blocks;               // 内存块(释放后的空位memory为VK_NULL_HANDLE)
+  static std::mutex allocatorMutex;                     // 保护内存块与统计(纹理可能在加载线程中创建)
+
+  /**
+   * 是否存在满足掩码的内存类型
+   */
+  static bool hasMemoryType(uint32_t typeBits, VkFlags requirementsMask);
+
+  /**
+   * 内存类型对应的内存块大小
+   */
+  static VkDeviceSize blockSizeFor(uint32_t memoryTypeIndex);
+
+  /**
+   * 分配并(主机可见时)映射一个新的内存块, 返回其编号, 失败时返回-1
+   */
+  static int createBlock(VkDevice &device, uint32_t memoryTypeIndex, VkDeviceSize size, bool optimal,
+                         bool dedicated);
+
+  /**
+   * 释放内存块
+   */
+  static void releaseBlock(VkDevice &device, int block);
+
+  /**
+   * 统计空闲空间(调用者须已持有锁)
+   */
+  static void collectFreeStats(VkDeviceSize &freeBytes, VkDeviceSize &largestFree, int &freeRanges);
+
+  /**
+   * 以内存块中的一段填写分配
+   */
+  static void fillAllocation(int block, uint32_t memoryTypeIndex, uint64_t offset, uint32_t handle,
+                             MemoryAllocation &allocation);
+};
+
+#endif //DEEPERVULKAN_DEVICEMEMORYALLOCATOR_H_
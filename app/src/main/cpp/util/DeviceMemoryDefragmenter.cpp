@@ -0,0 +1,380 @@
+#include "DeviceMemoryDefragmenter.h"
+#include <cassert>
+#include <chrono>
+#include <algorithm>
+#include "AsyncUploader.h"
+#include "ResourceStateTracker.h"
+#include "../bndev/mylog.h"
+
+long long DeviceMemoryDefragmenter::frameBudgetMicros = DEFRAG_FRAME_BUDGET_US;
+VkDeviceSize DeviceMemoryDefragmenter::frameBudgetBytes = DEFRAG_FRAME_BUDGET_BYTES;
+int DeviceMemoryDefragmenter::passes = 0;
+int DeviceMemoryDefragmenter::movedResources = 0;
+long long DeviceMemoryDefragmenter::movedBytes = 0;
+int DeviceMemoryDefragmenter::failedMoves = 0;
+std::vector<MovableResource> DeviceMemoryDefragmenter::resources;
+std::vector<int> DeviceMemoryDefragmenter::freeIds;
+std::vector<RetiredResource> DeviceMemoryDefragmenter::retired;
+std::vector<int> DeviceMemoryDefragmenter::evacuatingBlocks;
+std::vector<int> DeviceMemoryDefragmenter::moveQueue;
+long long DeviceMemoryDefragmenter::frame = 0;
+long long DeviceMemoryDefragmenter::lastCheckFrame = 0;
+int DeviceMemoryDefragmenter::framesInFlight = 1;
+bool DeviceMemoryDefragmenter::passRequested = false;
+
+static int addResource(std::vector<MovableResource> &resources, std::vector<int> &freeIds,
+                       const MovableResource &resource) {
+  if (!freeIds.empty()) {
+    int id = freeIds.back();
+    freeIds.pop_back();
+    resources[id] = resource;
+    return id;
+  }
+  resources.push_back(resource);
+  return (int) resources.size() - 1;
+}
+
+int DeviceMemoryDefragmenter::registerBuffer(VkBuffer buffer, const VkBufferCreateInfo &info,
+                                             const MemoryAllocation &allocation, VkPipelineStageFlags stages,
+                                             VkAccessFlags access, unsigned long long uploadTicket,
+                                             RelocateCallback relocated) {
+  VkBufferUsageFlags transfer = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  assert((info.usage & transfer) == transfer);
+  MovableResource r = {};
+  r.buffer = buffer;
+  r.bufferInfo = info;
+  r.bufferInfo.pNext = nullptr;
+  r.bufferInfo.queueFamilyIndexCount = 0;                                 // 只移动独占的资源
+  r.bufferInfo.pQueueFamilyIndices = nullptr;
+  r.image = VK_NULL_HANDLE;
+  r.stages = stages;
+  r.access = access;
+  r.allocation = allocation;
+  r.uploadTicket = uploadTicket;
+  r.relocated = relocated;
+  r.live = true;
+  return addResource(resources, freeIds, r);
+}
+
+int DeviceMemoryDefragmenter::registerImage(VkImage image, const VkImageCreateInfo &info, VkImageAspectFlags aspect,
+                                            VkImageLayout layout, const MemoryAllocation &allocation,
+                                            VkPipelineStageFlags stages, VkAccessFlags access,
+                                            RelocateCallback relocated) {
+  VkImageUsageFlags transfer = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  assert((info.usage & transfer) == transfer && info.tiling == VK_IMAGE_TILING_OPTIMAL);
+  MovableResource r = {};
+  r.buffer = VK_NULL_HANDLE;
+  r.image = image;
+  r.imageInfo = info;
+  r.imageInfo.pNext = nullptr;
+  r.imageInfo.queueFamilyIndexCount = 0;
+  r.imageInfo.pQueueFamilyIndices = nullptr;
+  r.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  r.aspect = aspect;
+  r.layout = layout;
+  r.stages = stages;
+  r.access = access;
+  r.allocation = allocation;
+  r.uploadTicket = 0;
+  r.relocated = relocated;
+  r.live = true;
+  return addResource(resources, freeIds, r);
+}
+
+void DeviceMemoryDefragmenter::unregister(int id) {
+  if (id < 0) {
+    return;
+  }
+  assert(id < (int) resources.size() && resources[id].live);
+  resources[id].live = false;
+  resources[id].relocated = nullptr;
+  freeIds.push_back(id);
+}
+
+void DeviceMemoryDefragmenter::requestPass() {
+  passRequested = true;
+}
+
+bool DeviceMemoryDefragmenter::beginPass() {
+  DeviceMemoryAllocator::findSparseBlocks(DEFRAG_SPARSE_USAGE, evacuatingBlocks);
+  moveQueue.clear();
+  for (size_t i = 0; i < resources.size(); ++i) {
+    const MovableResource &r = resources[i];
+    if (r.live && std::find(evacuatingBlocks.begin(), evacuatingBlocks.end(), r.allocation.block) !=
+                  evacuatingBlocks.end()) {
+      moveQueue.push_back((int) i);
+    }
+  }
+  if (moveQueue.empty()) {                                                // 稀疏块中没有可移动的资源
+    evacuatingBlocks.clear();
+    return false;
+  }
+  for (size_t i = 0; i < evacuatingBlocks.size(); ++i) {                  // 新的分配不再放入正在清空的块
+    DeviceMemoryAllocator::setEvacuating(evacuatingBlocks[i], true);
+  }
+  passes++;
+  LOGI("DeviceMemoryDefragmenter: pass %d, evacuating %d blocks, %d resources to move, fragmentation %.2f",
+       passes, (int) evacuatingBlocks.size(), (int) moveQueue.size(), DeviceMemoryAllocator::fragmentation());
+  return true;
+}
+
+void DeviceMemoryDefragmenter::endPass() {
+  for (size_t i = 0; i < evacuatingBlocks.size(); ++i) {
+    DeviceMemoryAllocator::setEvacuating(evacuatingBlocks[i], false);
+  }
+  evacuatingBlocks.clear();
+  moveQueue.clear();
+}
+
+void DeviceMemoryDefragmenter::recordBufferCopy(VkCommandBuffer &cmdBuffer, const MovableResource &r,
+                                                VkBuffer newBuffer) {
+  VkBufferMemoryBarrier barriers[2] = {};
+  barriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;            // 之前的读取(及上传的获取)完成后再拷贝
+  barriers[0].pNext = nullptr;
+  barriers[0].srcAccessMask = 0;
+  barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barriers[0].buffer = r.buffer;
+  barriers[0].offset = 0;
+  barriers[0].size = VK_WHOLE_SIZE;
+  vk::vkCmdPipelineBarrier(cmdBuffer, r.stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                           0, nullptr, 1, &barriers[0], 0, nullptr);
+  VkBufferCopy region;
+  region.srcOffset = 0;
+  region.dstOffset = 0;
+  region.size = r.bufferInfo.size;
+  vk::vkCmdCopyBuffer(cmdBuffer, r.buffer, newBuffer, 1, &region);
+  barriers[1] = barriers[0];                                              // 拷贝完成后才能按原来的方式使用
+  barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[1].dstAccessMask = r.access;
+  barriers[1].buffer = newBuffer;
+  vk::vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, r.stages, 0,
+                           0, nullptr, 1, &barriers[1], 0, nullptr);
+}
+
+void DeviceMemoryDefragmenter::recordImageCopy(VkCommandBuffer &cmdBuffer, const MovableResource &r,
+                                               VkImage newImage) {
+  VkImageMemoryBarrier barriers[2] = {};
+  for (int i = 0; i < 2; ++i) {
+    barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[i].pNext = nullptr;
+    barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].subresourceRange.aspectMask = r.aspect;
+    barriers[i].subresourceRange.baseMipLevel = 0;
+    barriers[i].subresourceRange.levelCount = r.imageInfo.mipLevels;
+    barriers[i].subresourceRange.baseArrayLayer = 0;
+    barriers[i].subresourceRange.layerCount = r.imageInfo.arrayLayers;
+  }
+  barriers[0].image = r.image;                                            // 旧图像: 之前的读取完成后转为拷贝源
+  barriers[0].srcAccessMask = 0;
+  barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barriers[0].oldLayout = r.layout;
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barriers[1].image = newImage;                                           // 新图像: 内容未定义, 转为拷贝目标
+  barriers[1].srcAccessMask = 0;
+  barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  vk::vkCmdPipelineBarrier(cmdBuffer, r.stages | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0, 0, nullptr, 0, nullptr, 2, barriers);
+
+  std::vector<VkImageCopy> regions(r.imageInfo.mipLevels);               // 每级一个区域, 包含所有数组层
+  for (uint32_t level = 0; level < r.imageInfo.mipLevels; ++level) {
+    VkImageCopy &region = regions[level];
+    region.srcSubresource.aspectMask = r.aspect;
+    region.srcSubresource.mipLevel = level;
+    region.srcSubresource.baseArrayLayer = 0;
+    region.srcSubresource.layerCount = r.imageInfo.arrayLayers;
+    region.srcOffset.x = 0;
+    region.srcOffset.y = 0;
+    region.srcOffset.z = 0;
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffset = region.srcOffset;
+    region.extent.width = std::max(r.imageInfo.extent.width >> level, 1u);
+    region.extent.height = std::max(r.imageInfo.extent.height >> level, 1u);
+    region.extent.depth = std::max(r.imageInfo.extent.depth >> level, 1u);
+  }
+  vk::vkCmdCopyImage(cmdBuffer, r.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t) regions.size(), regions.data());
+
+  barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;               // 新图像: 拷贝完成后转为原来的布局
+  barriers[1].dstAccessMask = r.access;
+  barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barriers[1].newLayout = r.layout;
+  vk::vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, r.stages,
+                           0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+}
+
+VkDeviceSize DeviceMemoryDefragmenter::move(VkDevice &device, VkCommandBuffer &cmdBuffer, int id) {
+  MovableResource &r = resources[id];
+  VkBuffer newBuffer = VK_NULL_HANDLE;
+  VkImage newImage = VK_NULL_HANDLE;
+  VkMemoryRequirements mem_reqs;
+  VkResult result;
+  if (r.buffer != VK_NULL_HANDLE) {
+    result = vk::vkCreateBuffer(device, &r.bufferInfo, nullptr, &newBuffer);
+    assert(result == VK_SUCCESS);
+    vk::vkGetBufferMemoryRequirements(device, newBuffer, &mem_reqs);
+  } else {
+    result = vk::vkCreateImage(device, &r.imageInfo, nullptr, &newImage);
+    assert(result == VK_SUCCESS);
+    vk::vkGetImageMemoryRequirements(device, newImage, &mem_reqs);
+  }
+  MemoryAllocation allocation;
+  if (!DeviceMemoryAllocator::allocateMoved(device, mem_reqs, r.allocation, allocation)) {
+    if (newBuffer != VK_NULL_HANDLE) {                                    // 不创建新的内存块, 放弃本轮
+      vk::vkDestroyBuffer(device, newBuffer, nullptr);
+    } else {
+      vk::vkDestroyImage(device, newImage, nullptr);
+    }
+    failedMoves++;
+    return 0;
+  }
+  if (newBuffer != VK_NULL_HANDLE) {
+    result = vk::vkBindBufferMemory(device, newBuffer, allocation.memory, allocation.offset);
+    assert(result == VK_SUCCESS);
+    recordBufferCopy(cmdBuffer, r, newBuffer);
+  } else {
+    result = vk::vkBindImageMemory(device, newImage, allocation.memory, allocation.offset);
+    assert(result == VK_SUCCESS);
+    recordImageCopy(cmdBuffer, r, newImage);
+  }
+
+  RetiredResource old;                                                    // 本帧的拷贝与在途帧仍使用旧资源
+  old.buffer = r.buffer;
+  old.image = r.image;
+  old.view = VK_NULL_HANDLE;
+  old.allocation = r.allocation;
+  old.frame = frame;
+  retired.push_back(old);
+
+  r.buffer = newBuffer;
+  r.image = newImage;
+  r.allocation = allocation;
+  if (r.relocated) {
+    r.relocated(device, r);                                               // 所有者更新句柄、视图与描述集
+  }
+  movedResources++;
+  movedBytes += allocation.size;
+  return allocation.size;
+}
+
+void DeviceMemoryDefragmenter::step(VkDevice &device, VkCommandBuffer &cmdBuffer) {
+  frame++;
+  for (size_t i = 0; i < retired.size();) {                               // 销毁在途帧已不再使用的旧资源
+    RetiredResource &old = retired[i];
+    if (frame - old.frame < framesInFlight) {
+      ++i;
+      continue;
+    }
+    if (old.view != VK_NULL_HANDLE) {
+      vk::vkDestroyImageView(device, old.view, nullptr);
+    }
+    if (old.buffer != VK_NULL_HANDLE) {
+      vk::vkDestroyBuffer(device, old.buffer, nullptr);
+    }
+    if (old.image != VK_NULL_HANDLE) {
+      ResourceStateTracker::forgetImage(old.image);                       // 旧图像可能在上传时被跟踪
+      vk::vkDestroyImage(device, old.image, nullptr);
+    }
+    DeviceMemoryAllocator::free(device, old.allocation);                  // 清空后的内存块由分配器回收
+    retired[i] = retired.back();
+    retired.pop_back();
+  }
+
+  if (evacuatingBlocks.empty()) {
+    if (!passRequested && frame - lastCheckFrame < DEFRAG_CHECK_INTERVAL) {
+      return;
+    }
+    passRequested = false;
+    lastCheckFrame = frame;
+    if (!beginPass()) {
+      return;
+    }
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  VkDeviceSize bytes = 0;
+  while (!moveQueue.empty()) {
+    int id = moveQueue.back();
+    const MovableResource &r = resources[id];
+    if (!r.live || std::find(evacuatingBlocks.begin(), evacuatingBlocks.end(), r.allocation.block) ==
+                   evacuatingBlocks.end()) {                              // 已取消登记
+      moveQueue.pop_back();
+      continue;
+    }
+    if (!AsyncUploader::isComplete(r.uploadTicket)) {                     // 上传完成之前不移动, 下一帧再试
+      break;
+    }
+    if (bytes > 0 && bytes + r.allocation.size > frameBudgetBytes) {       // 本帧的拷贝已达预算
+      break;
+    }
+    VkDeviceSize moved = move(device, cmdBuffer, id);
+    if (moved == 0) {                                                     // 其他内存块已满, 放弃本轮
+      LOGE("DeviceMemoryDefragmenter: no room to move resource %d, pass aborted", id);
+      endPass();
+      return;
+    }
+    moveQueue.pop_back();
+    bytes += moved;
+    long long micros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (micros >= frameBudgetMicros) {                                    // 本帧的CPU时间已达预算
+      break;
+    }
+  }
+  if (moveQueue.empty()) {
+    endPass();
+    LOGI("DeviceMemoryDefragmenter: pass %d finished, fragmentation %.2f",
+         passes, DeviceMemoryAllocator::fragmentation());
+  }
+}
+
+void DeviceMemoryDefragmenter::retireView(VkImageView view) {
+  RetiredResource old = {};
+  old.buffer = VK_NULL_HANDLE;
+  old.image = VK_NULL_HANDLE;
+  old.view = view;
+  old.allocation.block = -1;                                              // 空分配, 释放时不做任何事
+  old.frame = frame;
+  retired.push_back(old);
+}
+
+void DeviceMemoryDefragmenter::setFramesInFlight(int frames) {
+  assert(frames >= 1);
+  framesInFlight = frames;
+}
+
+void DeviceMemoryDefragmenter::destroy(VkDevice &device) {
+  logStats();
+  endPass();
+  frame += framesInFlight;                                                // 设备已空闲, 所有旧资源均可销毁
+  for (size_t i = 0; i < retired.size(); ++i) {
+    if (retired[i].view != VK_NULL_HANDLE) {
+      vk::vkDestroyImageView(device, retired[i].view, nullptr);
+    }
+    if (retired[i].buffer != VK_NULL_HANDLE) {
+      vk::vkDestroyBuffer(device, retired[i].buffer, nullptr);
+    }
+    if (retired[i].image != VK_NULL_HANDLE) {
+      ResourceStateTracker::forgetImage(retired[i].image);
+      vk::vkDestroyImage(device, retired[i].image, nullptr);
+    }
+    DeviceMemoryAllocator::free(device, retired[i].allocation);
+  }
+  retired.clear();
+  resources.clear();
+  freeIds.clear();
+}
+
+void DeviceMemoryDefragmenter::logStats() {
+  VkDeviceSize freeBytes, largestFree;
+  int freeRanges;
+  DeviceMemoryAllocator::fragmentationStats(freeBytes, largestFree, freeRanges);
+  LOGI("DeviceMemoryDefragmenter: %d passes, %d resources moved (%lld bytes), %d failed moves; "
+       "largest free %lld of %lld free bytes in %d ranges, fragmentation %.2f",
+       passes, movedResources, movedBytes, failedMoves, (long long) largestFree, (long long) freeBytes,
+       freeRanges, DeviceMemoryAllocator::fragmentation());
+}
@@ -0,0 +1,155 @@
+#ifndef DEEPERVULKAN_DEVICEMEMORYDEFRAGMENTER_H_
+#define DEEPERVULKAN_DEVICEMEMORYDEFRAGMENTER_H_
+
+#include <vector>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
+
+#define DEFRAG_FRAME_BUDGET_US 500                  // 每帧记录移动命令的CPU时间预算(微秒)
+#define DEFRAG_FRAME_BUDGET_BYTES (4 * 1024 * 1024) // 每帧拷贝的字节预算(限制GPU拷贝耗时)
+#define DEFRAG_SPARSE_USAGE 0.5                     // 使用率低于这一比例的内存块被清空
+#define DEFRAG_CHECK_INTERVAL 120                   // 每隔这么多帧检查一次是否有稀疏内存块
+
+struct MovableResource;
+
+/**
+ * 资源移动后的回调: 所有者在其中换用新的句柄与内存, 重建图像视图(旧视图交给retireView)并更新描述集
+ */
+typedef std::function<void(VkDevice &device, const MovableResource &resource)> RelocateCallback;
+
+/**
+ * 登记为可移动的缓冲或图像
+ */
+struct MovableResource {
+  VkBuffer buffer;                          // 缓冲(图像时为VK_NULL_HANDLE)
+  VkBufferCreateInfo bufferInfo;            // 缓冲的创建信息(用于创建移动后的缓冲)
+  VkImage image;                            // 图像(缓冲时为VK_NULL_HANDLE)
+  VkImageCreateInfo imageInfo;              // 图像的创建信息
+  VkImageAspectFlags aspect;                // 图像的使用方面
+  VkImageLayout layout;                     // 图像在帧之间保持的布局
+  VkPipelineStageFlags stages;              // 图形队列上使用该资源的管线阶段
+  VkAccessFlags access;                     // 图形队列上的访问类型
+  MemoryAllocation allocation;              // 当前的内存
+  unsigned long long uploadTicket;          // 上传票号(上传完成前不移动)
+  RelocateCallback relocated;               // 移动后的回调
+  bool live;                                // 登记是否有效
+};
+
+/**
+ * 移动后等待在途帧结束再销毁的旧资源
+ */
+struct RetiredResource {
+  VkBuffer buffer;                          // 旧缓冲
+  VkImage image;                            // 旧图像
+  VkImageView view;                         // 旧图像视图
+  MemoryAllocation allocation;              // 旧内存
+  long long frame;                          // 最后使用的帧号
+};
+
+/**
+ * 设备内存在线整理
+ * 长时间加载、卸载模型与纹理后子分配的内存块中留下大量空洞, 总空闲足够时大资源仍可能分配失败
+ * 资源的所有者把缓冲或图像登记为可移动; 整理时找出使用率低的稀疏内存块并标记为正在清空,
+ * 每帧在时间与字节预算内把其中的资源在图形队列上拷贝到同类型的其他内存块, 通过回调让所有者更新引用,
+ * 旧资源在在途帧结束后销毁, 清空后的内存块由分配器回收
+ * 未登记的资源不会被移动, 所在内存块也就无法完全清空(整理只是尽力而为)
+ */
+class DeviceMemoryDefragmenter {
+ public:
+  static long long frameBudgetMicros;                   // 每帧CPU时间预算(微秒)
+  static VkDeviceSize frameBudgetBytes;                 // 每帧拷贝字节预算
+  static int passes;                                    // 整理轮数(统计用)
+  static int movedResources;                            // 移动的资源数(统计用)
+  static long long movedBytes;                          // 移动的字节数(统计用)
+  static int failedMoves;                               // 因其他内存块没有空间而放弃的移动数(统计用)
+
+  /**
+   * 登记可移动的缓冲(用途须包含TRANSFER_SRC与TRANSFER_DST), 返回登记号
+   */
+  static int registerBuffer(VkBuffer buffer, const VkBufferCreateInfo &info, const MemoryAllocation &allocation,
+                            VkPipelineStageFlags stages, VkAccessFlags access, unsigned long long uploadTicket,
+                            RelocateCallback relocated);
+
+  /**
+   * 登记可移动的最优平铺图像(用途须包含TRANSFER_SRC与TRANSFER_DST), 返回登记号
+   */
+  static int registerImage(VkImage image, const VkImageCreateInfo &info, VkImageAspectFlags aspect,
+                           VkImageLayout layout, const MemoryAllocation &allocation,
+                           VkPipelineStageFlags stages, VkAccessFlags access, RelocateCallback relocated);
+
+  /**
+   * 取消登记(销毁资源之前调用, id为-1时不做任何事)
+   */
+  static void unregister(int id);
+
+  /**
+   * 请求在下一帧开始一轮整理(例如卸载场景之后)
+   */
+  static void requestPass();
+
+  /**
+   * 每帧调用一次(须在渲染通道之外): 销毁在途帧已结束的旧资源, 按间隔检查稀疏内存块,
+   * 整理进行中时在预算内记录移动拷贝
+   */
+  static void step(VkDevice &device, VkCommandBuffer &cmdBuffer);
+
+  /**
+   * 推迟销毁移动前的图像视图(在移动回调中调用)
+   */
+  static void retireView(VkImageView view);
+
+  /**
+   * 设置同时在途的帧数, 旧资源在这么多帧之后销毁
+   */
+  static void setFramesInFlight(int frames);
+
+  /**
+   * 销毁所有旧资源并清除登记(须在设备空闲、销毁登记的资源之后调用)
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 打印统计信息与当前碎片率
+   */
+  static void logStats();
+
+ private:
+  static std::vector<MovableResource> resources;        // 登记的资源(下标为登记号)
+  static std::vector<int> freeIds;                      // 可重用的登记号
+  static std::vector<RetiredResource> retired;          // 等待销毁的旧资源
+  static std::vector<int> evacuatingBlocks;             // 本轮正在清空的内存块
+  static std::vector<int> moveQueue;                    // 本轮待移动的登记号
+  static long long frame;                               // 当前帧号
+  static long long lastCheckFrame;                      // 上次检查稀疏内存块的帧号
+  static int framesInFlight;                            // 同时在途的帧数
+  static bool passRequested;                            // 是否请求了整理
+
+  /**
+   * 找出稀疏内存块并收集其中可移动的资源, 返回是否开始了一轮整理
+   */
+  static bool beginPass();
+
+  /**
+   * 结束本轮整理, 取消内存块的清空标记
+   */
+  static void endPass();
+
+  /**
+   * 移动一个资源, 返回拷贝的字节数(其他内存块没有空间时返回0并放弃本轮)
+   */
+  static VkDeviceSize move(VkDevice &device, VkCommandBuffer &cmdBuffer, int id);
+
+  /**
+   * 记录缓冲的拷贝命令
+   */
+  static void recordBufferCopy(VkCommandBuffer &cmdBuffer, const MovableResource &r, VkBuffer newBuffer);
+
+  /**
+   * 记录图像各级、各层的拷贝命令与布局转换
+   */
+  static void recordImageCopy(VkCommandBuffer &cmdBuffer, const MovableResource &r, VkImage newImage);
+};
+
+#endif //DEEPERVULKAN_DEVICEMEMORYDEFRAGMENTER_H_
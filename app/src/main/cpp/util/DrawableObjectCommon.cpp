@@ -3,6 +3,10 @@
 #include <assert.h>
 #include "HelpFunction.h"
 #include "MatrixState3D.h"
+#include "BindlessTextureTable.h"
+#include "GeometryBuffer.h"
+#include "GeometryPool.h"
+#include "AsyncUploader.h"
 #include <string.h>
 
 DrawableObjectCommon::DrawableObjectCommon(
@@ -17,7 +21,8 @@ DrawableObjectCommon::DrawableObjectCommon(
 //    int iCountIn,
 
     VkDevice &device,
-    VkPhysicalDeviceMemoryProperties &memoryroperties
+    VkPhysicalDeviceMemoryProperties &memoryroperties,
+    bool dynamicIn
 ) {
 //  pushConstantData = new float[16];                                       // Sample4_2、6_1、6_7-推送常量数据数组的初始化(4X4的最终变换矩阵)
   pushConstantData = new float[32];                                       // Sample5_1、6_6、7_2
@@ -28,54 +33,35 @@ DrawableObjectCommon::DrawableObjectCommon(
   this->vdata = vdataIn;                                                  // 接收顶点数据数组首地址指针并保存
   this->vCount = vCountIn;                                                // 接收顶点数量并保存
 
-  VkBufferCreateInfo buf_info = {};                                       // 构建缓冲创建信息结构体实例
-  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;                  // 设置结构体类型
-  buf_info.pNext = nullptr;                                               // 自定义数据的指针
-  buf_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;                     // 缓冲的用途为顶点数据
-  buf_info.size = dataByteCount;                                          // 设置数据总字节数
-  buf_info.queueFamilyIndexCount = 0;                                     // 队列家族数量(共享模式EXCLUSIVE时为0)
-  buf_info.pQueueFamilyIndices = nullptr;                                 // 队列家族索引列表(共享模式EXCLUSIVE时为空)
-  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;                       // 共享模式(表示缓冲不允许被多个队列家族的队列访问)
-  buf_info.flags = 0;                                                     // 标志
-  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &vertexDatabuf); // 创建缓冲
-  assert(result == VK_SUCCESS);                                           // 检查缓冲创建是否成功
-
-  // 注：缓冲创建后只是一种逻辑存在，Vulkan并没有自动为其在设备内存中开辟存储空间，还需要
-  // 为缓冲分配匹配的设备内存，并将设备内存与缓冲绑定才真正确定缓冲在设备内存中的存储位置
-  VkMemoryRequirements mem_reqs;                                          // 缓冲内存需求
-  vk::vkGetBufferMemoryRequirements(device, vertexDatabuf, &mem_reqs);    // 获取缓冲内存需求
-  assert(dataByteCount <= mem_reqs.size);                                 // 检查内存需求获取是否正确
-
-  VkMemoryAllocateInfo alloc_info = {};                                   // 构建内存分配信息结构体实例
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;              // 结构体类型
-  alloc_info.pNext = nullptr;                                             // 自定义数据的指针
-  alloc_info.memoryTypeIndex = 0;                                         // 内存类型索引
-  alloc_info.allocationSize = mem_reqs.size;                              // 内存总字节数
-  VkFlags requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT         // 需要的内存类型掩码
-      | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;                             // 该组合表示分配的设备内存可以被CPU访问，同时保证CPU与GPU访问的一致性
-  bool flag = memoryTypeFromProperties(                                   // 获取所需内存类型索引
-      memoryroperties, mem_reqs.memoryTypeBits, requirements_mask, &alloc_info.memoryTypeIndex);
-  if (flag) {
-    LOGI("confirm memory type success, memoryTypeIndex = %d", alloc_info.memoryTypeIndex);
-  } else {
-    LOGE("confirm memory type failed!");
-  }
-  result = vk::vkAllocateMemory(device, &alloc_info, nullptr, &vertexDataMem); // 为顶点数据缓冲分配内存
-  assert(result == VK_SUCCESS);                                           // 检查内存分配是否成功
+  this->dynamic = dynamicIn;                                              // 顶点数据是否每帧由CPU改写
 
-  // 将数据送入设备内存
-  uint8_t *pData;                                                         // CPU访问时的辅助指针
-  result = vk::vkMapMemory(device, vertexDataMem, 0, mem_reqs.size, 0, (void **) &pData); // 将设备内存映射为可供CPU访问
-  assert(result == VK_SUCCESS);                                           // 检查映射是否成功
-  memcpy(pData, vdata, dataByteCount);                                    // 将顶点数据(坐标、颜色)复制进设备内存
-  vk::vkUnmapMemory(device, vertexDataMem);                               // 解除内存映射
-
-  result = vk::vkBindBufferMemory(device, vertexDatabuf, vertexDataMem, 0); // 绑定内存与缓冲
-  assert(result == VK_SUCCESS);
+  geometryMesh = -1;
+  vertexMovableId = -1;
+  vertexUploadTicket = 0;
+  vertexDatabuf = VK_NULL_HANDLE;
+  vertexDataMem.block = -1;
+  if (!dynamic && GeometryPool::active()) {                               // 静态顶点数据子分配在共享的几何缓冲池中
+    geometryMesh = GeometryPool::allocate(device, vdata, vCount, dataByteCount / vCount);
+  }
+  if (geometryMesh < 0) {                                                 // 动态数据或缓冲池已满时使用单独的顶点缓冲
+    // 静态顶点数据放入设备本地内存, 经中转环形缓冲在传输队列上拷贝(票号完成前跳过绘制);
+    // 统一内存设备与动态数据直接写入可映射的内存
+    vertexUploadTicket = GeometryBuffer::create(                          // 创建顶点数据缓冲, 分配内存并写入顶点数据
+        device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vdata, dataByteCount, dynamic, vertexDatabuf, vertexDataMem);
+    LOGI("confirm memory type success, memoryTypeIndex = %d", vertexDataMem.memoryTypeIndex);
+    vertexMovableId = GeometryBuffer::registerMovable(                    // 设备本地的顶点缓冲可在内存整理时移动
+        vertexDatabuf, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, dataByteCount, vertexDataMem, vertexUploadTicket,
+        [this](VkDevice &device, const MovableResource &resource) {       // 移动后换用新缓冲(下一次绘制时绑定)
+          vertexDatabuf = resource.buffer;
+          vertexDataMem = resource.allocation;
+          vertexDataBufferInfo.buffer = resource.buffer;
+        });
+  }
+  indexUploadTicket = 0;                                                  // 无索引数据
 
   vertexDataBufferInfo.buffer = vertexDatabuf;                            // 指定数据缓冲
   vertexDataBufferInfo.offset = 0;                                        // 数据缓冲起始偏移量
-  vertexDataBufferInfo.range = mem_reqs.size;                             // 数据缓冲所占字节数
+  vertexDataBufferInfo.range = dataByteCount;                             // 数据缓冲所占字节数
 
   /// Sample4_10、Sample4_16 上述被以下两个函数替代********************* start
 //  this->idata = idataIn;                                                  // 接收索引数据数组首地址指针并保存
@@ -96,55 +82,14 @@ DrawableObjectCommon::DrawableObjectCommon(
 void DrawableObjectCommon::createVertexBuffer(int dataByteCount,
                                               VkDevice &device,
                                               VkPhysicalDeviceMemoryProperties &memoryroperties) {
-  VkBufferCreateInfo buf_info = {};                                       // 构建缓冲创建信息结构体实例，为创建顶点数据缓冲服务
-  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;                  // 设置结构体类型
-  buf_info.pNext = nullptr;                                               // 自定义数据的指针
-  buf_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;                     // 缓冲的用途为顶点数据
-  buf_info.size = dataByteCount;                                          // 设置数据总字节数
-  buf_info.queueFamilyIndexCount = 0;                                     // 队列家族数量(共享模式EXCLUSIVE时为0)
-  buf_info.pQueueFamilyIndices = nullptr;                                 // 队列家族索引列表(共享模式EXCLUSIVE时为空)
-  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;                       // 共享模式(表示缓冲不允许被多个队列家族的队列访问)
-  buf_info.flags = 0;                                                     // 标志
-  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &vertexDatabuf); // 创建缓冲
-  assert(result == VK_SUCCESS);                                           // 检查缓冲创建是否成功
-
-  // 注：缓冲创建后只是一种逻辑存在，Vulkan并没有自动为其在设备内存中开辟存储空间，还需要
-  // 为缓冲分配匹配的设备内存，并将设备内存与缓冲绑定才真正确定缓冲在设备内存中的存储位置
-  VkMemoryRequirements mem_reqs;                                          // 缓冲内存需求
-  vk::vkGetBufferMemoryRequirements(device, vertexDatabuf, &mem_reqs);    // 获取缓冲内存需求
-  assert(dataByteCount <= mem_reqs.size);                                 // 检查内存需求获取是否正确
-
-  VkMemoryAllocateInfo alloc_info = {};                                   // 构建内存分配信息结构体实例
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;              // 结构体类型
-  alloc_info.pNext = nullptr;                                             // 自定义数据的指针
-  alloc_info.memoryTypeIndex = 0;                                         // 内存类型索引
-  alloc_info.allocationSize = mem_reqs.size;                              // 内存总字节数
-  VkFlags requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT         // 需要的内存类型掩码
-      | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;                             // 该组合表示分配的设备内存可以被CPU访问，同时保证CPU与GPU访问的一致性
-  bool flag = memoryTypeFromProperties(                                   // 获取所需内存类型索引
-      memoryroperties, mem_reqs.memoryTypeBits, requirements_mask, &alloc_info.memoryTypeIndex);
-  if (flag) {
-    LOGI("confirm memory type success, memoryTypeIndex = %d", alloc_info.memoryTypeIndex);
-  } else {
-    LOGE("confirm memory type failed!");
-  }
-  result = vk::vkAllocateMemory(device, &alloc_info, nullptr, &vertexDataMem); // 为顶点数据缓冲分配内存
-  assert(result == VK_SUCCESS);                                           // 检查内存分配是否成功
-
-  // 将数据送入设备内存
-  uint8_t *pData;                                                         // CPU访问时的辅助指针
-  result = vk::vkMapMemory(device, vertexDataMem, 0, mem_reqs.size, 0, (void **) &pData); // 将显存映射为可供CPU访问
-  assert(result == VK_SUCCESS);                                           // 检查映射是否成功
-  memcpy(pData, vdata, dataByteCount);                                    // 将顶点数据(坐标、颜色)复制进显存
-  vk::vkUnmapMemory(device, vertexDataMem);                               // 解除内存映射
-
-  result = vk::vkBindBufferMemory(device, vertexDatabuf, vertexDataMem, 0); // 绑定内存与缓冲
-  assert(result == VK_SUCCESS);
+  vertexUploadTicket = GeometryBuffer::create(                            // 创建顶点数据缓冲, 分配内存并写入顶点数据
+      device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vdata, dataByteCount, dynamic, vertexDatabuf, vertexDataMem);
+  LOGI("confirm memory type success, memoryTypeIndex = %d", vertexDataMem.memoryTypeIndex);
 
   // 记录Buffer Info
   vertexDataBufferInfo.buffer = vertexDatabuf;                            // 指定数据缓冲
   vertexDataBufferInfo.offset = 0;                                        // 数据缓冲起始偏移量
-  vertexDataBufferInfo.range = mem_reqs.size;                             // 数据缓冲所占字节数
+  vertexDataBufferInfo.range = dataByteCount;                             // 数据缓冲所占字节数
 }
 
 /**
@@ -154,64 +99,15 @@ void DrawableObjectCommon::createVertexBuffer(int dataByteCount,
 void DrawableObjectCommon::createIndexBuffer(int indexByteCount,
                                              VkDevice &device,
                                              VkPhysicalDeviceMemoryProperties &memoryroperties) {
-  // 创建Buffer创建信息实例，为创建索引数据Buffer服务
-  VkBufferCreateInfo index_buf_info = {};
-  index_buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  index_buf_info.pNext = nullptr;
-  index_buf_info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;                // 索引缓冲用法
-  index_buf_info.size = indexByteCount;
-  index_buf_info.queueFamilyIndexCount = 0;
-  index_buf_info.pQueueFamilyIndices = nullptr;
-  index_buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  index_buf_info.flags = 0;
-  VkResult result = vk::vkCreateBuffer(device, &index_buf_info, nullptr, &indexDatabuf);
-  assert(result == VK_SUCCESS);
-
-  // 获取内存需求
-  VkMemoryRequirements index_mem_reqs;
-  vk::vkGetBufferMemoryRequirements(device, indexDatabuf, &index_mem_reqs);
-  assert(indexByteCount <= index_mem_reqs.size);
-
-  // 内存分配信息
-  VkMemoryAllocateInfo index_alloc_info = {};
-  index_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  index_alloc_info.pNext = nullptr;
-  index_alloc_info.memoryTypeIndex = 0;
-  index_alloc_info.allocationSize = index_mem_reqs.size;
-
-  // 需要的内存类型掩码
-  VkFlags index_requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-  // 获取所需内存类型索引
-  bool index_flag = memoryTypeFromProperties(
-      memoryroperties, index_mem_reqs.memoryTypeBits, index_requirements_mask, &index_alloc_info.memoryTypeIndex);
-  if (index_flag) {
-    LOGI("confirm index-memory type success, memoryTypeIndex = %d", index_alloc_info.memoryTypeIndex);
-  } else {
-    LOGE("confirm index-memory type failed!");
-  }
-  // 为索引数据缓冲分配内存
-  result = vk::vkAllocateMemory(device, &index_alloc_info, nullptr, &indexDataMem);
-  assert(result == VK_SUCCESS);
-
-  uint8_t *index_pData;
-  // 将显存映射为CPU可访问
-  result = vk::vkMapMemory(device, indexDataMem, 0, index_mem_reqs.size, 0, (void **) &index_pData);
-  assert(result == VK_SUCCESS);
-
-  // 将索引数据拷贝进显存
-  memcpy(index_pData, idata, indexByteCount);
-  // 解除内存映射
-  vk::vkUnmapMemory(device, indexDataMem);
-
-  // 绑定内存与缓冲
-  result = vk::vkBindBufferMemory(device, indexDatabuf, indexDataMem, 0);
-  assert(result == VK_SUCCESS);
+  // 创建索引数据缓冲, 分配内存并写入索引数据(静态数据经中转拷贝到设备本地内存)
+  indexUploadTicket = GeometryBuffer::create(
+      device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, idata, indexByteCount, dynamic, indexDatabuf, indexDataMem);
+  LOGI("confirm index-memory type success, memoryTypeIndex = %d", indexDataMem.memoryTypeIndex);
 
   // 记录Buffer Info
   indexDataBufferInfo.buffer = indexDatabuf;
   indexDataBufferInfo.offset = 0;
-  indexDataBufferInfo.range = index_mem_reqs.size;
+  indexDataBufferInfo.range = indexByteCount;
 }
 
 /**
@@ -236,32 +132,11 @@ void DrawableObjectCommon::initDrawCmdbuf(VkDevice &device, VkPhysicalDeviceMemo
   VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &drawCmdbuf);  // 创建缓冲
   assert(result == VK_SUCCESS);
 
-  VkMemoryRequirements mem_reqs;                                          // 缓冲内存需求
-  vk::vkGetBufferMemoryRequirements(device, drawCmdbuf, &mem_reqs);       // 获取缓冲内存需求
-  assert(drawCmdbufbytes <= mem_reqs.size);                               // 检查内存需求获取是否正确
-
-  VkMemoryAllocateInfo alloc_info = {};                                   // 构建内存分配信息结构体实例
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.pNext = nullptr;
-  alloc_info.memoryTypeIndex = 0;                                         // 内存类型索引
-  alloc_info.allocationSize = mem_reqs.size;                              // 内存总字节数
-
   VkFlags requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT         // 需要的内存类型掩码
       | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-  bool flag = memoryTypeFromProperties(                                   // 获取所需内存类型索引
-      memoryroperties, mem_reqs.memoryTypeBits, requirements_mask, &alloc_info.memoryTypeIndex);
-  if (flag) {
-    LOGI("Determining memory type succeeded, alloc_info.memoryTypeIndex=%d", alloc_info.memoryTypeIndex);
-  } else {
-    LOGE("Determining memory type failed!");
-  }
-
-  result = vk::vkAllocateMemory(device, &alloc_info, nullptr, &drawCmdMem); // 为缓冲分配内存
-  assert(result == VK_SUCCESS);
-
-  uint8_t *pData;                                                         // CPU访问时的辅助指针
-  result = vk::vkMapMemory(device, drawCmdMem, 0, mem_reqs.size, 0, (void **) &pData); // 将设备内存映射为CPU可访问
-  assert(result == VK_SUCCESS);
+  DeviceMemoryAllocator::allocateBuffer(device, drawCmdbuf, requirements_mask, drawCmdMem); // 从子分配器为缓冲分配内存并绑定
+  assert((VkDeviceSize) drawCmdbufbytes <= drawCmdMem.size);              // 检查分配的内存是否足够
+  LOGI("Determining memory type succeeded, memoryTypeIndex=%d", drawCmdMem.memoryTypeIndex);
 
   /// Sample4_15 ************************************************* start
   // VkDrawIndirectCommand的参数含义与vk::vkCmdDraw方法参数含义相同
@@ -286,11 +161,7 @@ void DrawableObjectCommon::initDrawCmdbuf(VkDevice &device, VkPhysicalDeviceMemo
   dic[1].firstInstance = 0;                                               // 第2组绘制信息数据的首实例索引
   /// Sample4_16 *************************************************** end
 
-  memcpy(pData, &dic, drawCmdbufbytes);                                   // 将数据拷贝进设备内存
-  vk::vkUnmapMemory(device, vertexDataMem);                               // 解除内存映射
-
-  result = vk::vkBindBufferMemory(device, drawCmdbuf, drawCmdMem, 0);     // 绑定内存与缓冲
-  assert(result == VK_SUCCESS);
+  memcpy(drawCmdMem.mapped, &dic, drawCmdbufbytes);                       // 将数据拷贝进设备内存(内存块保持映射)
 }
 
 DrawableObjectCommon::~DrawableObjectCommon() {
@@ -302,18 +173,23 @@ DrawableObjectCommon::~DrawableObjectCommon() {
 //  delete[] pushConstantDataFrag;
   /// Sample6_5 **************************************************** end
 
-  vk::vkDestroyBuffer(*devicePointer, vertexDatabuf, nullptr);            // 销毁顶点数据缓冲
-  vk::vkFreeMemory(*devicePointer, vertexDataMem, nullptr);               // 释放顶点数据缓冲对应设备内存
+  if (geometryMesh >= 0) {
+    GeometryPool::free(geometryMesh);                                     // 归还几何缓冲池中的空间
+  } else {
+    DeviceMemoryDefragmenter::unregister(vertexMovableId);                // 取消内存整理的登记
+    vk::vkDestroyBuffer(*devicePointer, vertexDatabuf, nullptr);          // 销毁顶点数据缓冲
+    DeviceMemoryAllocator::free(*devicePointer, vertexDataMem);           // 释放顶点数据缓冲对应设备内存
+  }
 
   /// Sample4_10、Sample4_16 ************************************* start
 //  delete[] idata;                                                         // 释放索引数据内存
 //  vk::vkDestroyBuffer(*devicePointer, indexDatabuf, nullptr);             // 销毁索引数据缓冲
-//  vk::vkFreeMemory(*devicePointer, indexDataMem, nullptr);                // 释放索引数据缓冲对应设备内存
+//  DeviceMemoryAllocator::free(*devicePointer, indexDataMem);              // 释放索引数据缓冲对应设备内存
   /// Sample4_10、Sample4_16 *************************************** end
 
   /// Sample4_15、Sample4_16 ************************************* start
 //  vk::vkDestroyBuffer(*devicePointer, drawCmdbuf, nullptr);
-//  vk::vkFreeMemory(*devicePointer, drawCmdMem, nullptr);
+//  DeviceMemoryAllocator::free(*devicePointer, drawCmdMem);
   /// Sample4_15、Sample4_16 *************************************** end
 }
 
@@ -324,7 +200,8 @@ void DrawableObjectCommon::drawSelf(
     VkCommandBuffer &cmd,
     VkPipelineLayout &pipelineLayout,
     VkPipeline &pipeline,
-    VkDescriptorSet *desSetPointer
+    VkDescriptorSet *desSetPointer,
+    uint32_t uniformOffset
 
     /// Sample4_10
 //    uint32_t sIndex,
@@ -339,18 +216,14 @@ void DrawableObjectCommon::drawSelf(
     /// Sample6_10
 //    int texArrayIndex
 ) {
+  if (!uploaded()) {                                                      // 顶点(索引)数据尚在上传, 本帧不绘制
+    return;
+  }
   // VK_PIPELINE_BIND_POINT_GRAPHICS表示绑定的管线为图形渲染管线
   vk::vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);  // 将当前使用的命令缓冲与指定管线绑定
   vk::vkCmdBindDescriptorSets(                                            // 将命令缓冲、管线布局、描述集绑定
-      cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, desSetPointer, 0, nullptr);
-  const VkDeviceSize offsetsVertex[1] = {0};                              // 顶点数据偏移量数组
-  vk::vkCmdBindVertexBuffers(                                             // 将顶点数据与当前使用的命令缓冲绑定
-      cmd,                                                                // 当前使用的命令缓冲
-      0,                                                                  // 顶点数据缓冲在列表中的首索引
-      1,                                                                  // 绑定顶点缓冲的数量
-      &(vertexDatabuf),                                                   // 绑定的顶点数据缓冲列表
-      offsetsVertex                                                       // 各个顶点数据缓冲的内部偏移量
-  );
+      cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, desSetPointer, 1, &uniformOffset); // 动态偏移量指定本帧的一致变量
+  bindVertexBuffer(cmd);                                                  // 将顶点数据与当前使用的命令缓冲绑定
 
   /// Sample4_2、6_1、6_7、6_10 ********************************** start
 //  float *mvp = MatrixState3D::getFinalMatrix();                           // 获取最终变换矩阵
@@ -379,7 +252,7 @@ void DrawableObjectCommon::drawSelf(
 //                         VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(float) * 16, sizeof(float) * 1, pushConstantDataFrag);
   /// Sample6_5 **************************************************** end
 
-  vk::vkCmdDraw(cmd, vCount, 1, 0, 0);                                    // 执行绘制
+  vk::vkCmdDraw(cmd, vCount, 1, firstVertex(), 0);                        // 执行绘制
 
   /// Sample4_10 ************************************************* start
 //  vk::vkCmdBindIndexBuffer(                                               // 将索引数据与当前使用的命令缓冲绑定
@@ -418,3 +291,62 @@ void DrawableObjectCommon::drawSelf(
 //  );
   /// Sample4_16 *************************************************** end
 }
+
+/**
+ * 无绑定纹理-绘制物体
+ */
+void DrawableObjectCommon::drawSelfBindless(
+    VkCommandBuffer &cmd,
+    VkPipelineLayout &pipelineLayout,
+    uint32_t texIndex,
+    std::vector<VkDescriptorSet> &classicSets,
+    uint32_t uniformOffset
+) {
+  if (!uploaded()) {
+    return;
+  }
+  BindlessTextureTable::bindTexture(cmd, pipelineLayout, texIndex, classicSets, uniformOffset); // 仅传统模式下绑定描述集
+  bindVertexBuffer(cmd);
+  float *mvp = MatrixState3D::getFinalMatrix();                           // 获取最终变换矩阵
+  vk::vkCmdPushConstants(cmd, pipelineLayout,                             // 推送最终变换矩阵
+                         VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float) * 16, mvp);
+  vk::vkCmdPushConstants(cmd, pipelineLayout,                             // 推送纹理在纹理表中的索引
+                         VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(float) * 16, sizeof(uint32_t), &texIndex);
+  vk::vkCmdDraw(cmd, vCount, 1, firstVertex(), 0);                        // 执行绘制
+}
+
+/**
+ * 几何数据是否已上传完成
+ */
+bool DrawableObjectCommon::uploaded() {
+  if (geometryMesh >= 0) {
+    return GeometryPool::ready(geometryMesh);
+  }
+  return AsyncUploader::isComplete(vertexUploadTicket) && AsyncUploader::isComplete(indexUploadTicket);
+}
+
+/**
+ * 绘制用的首顶点
+ */
+uint32_t DrawableObjectCommon::firstVertex() {
+  return geometryMesh >= 0 ? GeometryPool::mesh(geometryMesh).firstVertex : 0;
+}
+
+/**
+ * 绑定顶点缓冲
+ */
+void DrawableObjectCommon::bindVertexBuffer(VkCommandBuffer &cmd) {
+  if (geometryMesh >= 0) {
+    GeometryPool::bind(cmd);                                              // 共享顶点缓冲在本帧的命令缓冲中只绑定一次
+    return;
+  }
+  const VkDeviceSize offsetsVertex[1] = {0};                              // 顶点数据偏移量数组
+  vk::vkCmdBindVertexBuffers(                                             // 将顶点数据与当前使用的命令缓冲绑定
+      cmd,                                                                // 当前使用的命令缓冲
+      0,                                                                  // 顶点数据缓冲在列表中的首索引
+      1,                                                                  // 绑定顶点缓冲的数量
+      &(vertexDatabuf),                                                   // 绑定的顶点数据缓冲列表
+      offsetsVertex                                                       // 各个顶点数据缓冲的内部偏移量
+  );
+  GeometryPool::invalidateBinding();                                      // 下一个缓冲池中的物体须重新绑定共享缓冲
+}
@@ -3,7 +3,9 @@
 
 #include <vulkan/vulkan.h>
 #include "vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
 #include <string>
+#include <vector>
 
 class DrawableObjectCommon {
  public:
@@ -14,21 +16,26 @@ class DrawableObjectCommon {
   float *vdata;                                 // 顶点数据数组首地址指针
   int vCount;                                   // 顶点数量
   VkBuffer vertexDatabuf;                       // 顶点数据缓冲
-  VkDeviceMemory vertexDataMem;                 // 顶点数据所需设备内存
+  MemoryAllocation vertexDataMem;               // 顶点数据所需设备内存
   VkDescriptorBufferInfo vertexDataBufferInfo;  // 顶点数据缓冲描述信息
+  bool dynamic;                                 // 几何数据是否每帧由CPU改写(是则放在主机可见内存中)
+  unsigned long long vertexUploadTicket;        // 顶点数据的上传票号(直接写入时为0)
+  int geometryMesh;                             // 在几何缓冲池中的网格编号(-1为单独的顶点缓冲)
+  int vertexMovableId;                          // 单独的顶点缓冲在内存整理中的登记号(-1为不可移动)
 
   /// Sample4_10
   uint16_t *idata;                              // 索引数据数组首地址指针
   int iCount;                                   // 索引数量
   VkBuffer indexDatabuf;                        // 索引数据缓冲
-  VkDeviceMemory indexDataMem;                  // 索引数据所需设备内存
+  MemoryAllocation indexDataMem;                // 索引数据所需设备内存
   VkDescriptorBufferInfo indexDataBufferInfo;   // 索引数据缓冲描述信息
+  unsigned long long indexUploadTicket;         // 索引数据的上传票号(直接写入时为0)
 
   /// Sample4_15 ************************************************* start
   int indirectDrawCount;                        // 间接绘制信息数据组的数量
   int drawCmdbufbytes;                          // 间接绘制信息数据所占总字节数
   VkBuffer drawCmdbuf;                          // 间接绘制信息数据缓冲
-  VkDeviceMemory drawCmdMem;                    // 间接绘制信息数据缓冲对应设备内存
+  MemoryAllocation drawCmdMem;                  // 间接绘制信息数据缓冲对应设备内存
   void initDrawCmdbuf(                          // 用于创建间接绘制信息数据缓冲的方法
       VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties);
   /// Sample4_15 *************************************************** end
@@ -49,7 +56,8 @@ class DrawableObjectCommon {
 //      int iCountIn,
 
       VkDevice &device,
-      VkPhysicalDeviceMemoryProperties &memoryroperties
+      VkPhysicalDeviceMemoryProperties &memoryroperties,
+      bool dynamicIn = false                    // 静态数据放入设备本地内存, 动态数据放入主机可见内存
   );
 
   ~DrawableObjectCommon();
@@ -61,7 +69,8 @@ class DrawableObjectCommon {
       VkCommandBuffer &secondary_cmd,
       VkPipelineLayout &pipelineLayout,
       VkPipeline &pipeline,
-      VkDescriptorSet *desSetPointer
+      VkDescriptorSet *desSetPointer,
+      uint32_t uniformOffset                    // 一致变量在环形缓冲中的动态偏移量(每个物体可写入自己的一致变量)
 
       /// Sample4_10
 //      uint32_t sIndex,
@@ -77,6 +86,33 @@ class DrawableObjectCommon {
 //      int texArrayIndex
   );
 
+  /**
+   * 几何数据是否已上传完成(完成前各绘制方法直接返回)
+   */
+  bool uploaded();
+
+  /**
+   * 绘制用的首顶点(在几何缓冲池中时为网格在共享顶点缓冲中的位置, 整理后会变化)
+   */
+  uint32_t firstVertex();
+
+  /**
+   * 绑定顶点缓冲: 在几何缓冲池中时每个命令缓冲只绑定一次共享缓冲
+   */
+  void bindVertexBuffer(VkCommandBuffer &cmd);
+
+  /**
+   * 无绑定纹理-绘制物体: 管线与纹理表由调用者每条管线绑定一次, 这里只推送最终变换矩阵与纹理索引
+   * 纹理表未启用时在此绑定索引对应的描述集(classicSets)
+   */
+  void drawSelfBindless(
+      VkCommandBuffer &cmd,
+      VkPipelineLayout &pipelineLayout,
+      uint32_t texIndex,
+      std::vector<VkDescriptorSet> &classicSets,
+      uint32_t uniformOffset
+  );
+
   /// Sample4_10 ************************************************* start
  private:
   /**
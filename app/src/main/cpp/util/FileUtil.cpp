@@ -145,3 +145,19 @@ TexArrayDataObject *FileUtil::load2DArrayTexData(string fname) {
   TexArrayDataObject *ctdo = new TexArrayDataObject(width, height, length, data);
   return ctdo;
 }
+
+/**
+ * 打开3D纹理或2D纹理数组文件, 仅读取文件头, 返回按切片流式读取的对象
+ */
+TexSliceStream *FileUtil::openTexSliceStream(string fname) {
+  AAsset *asset = AAssetManager_open(aam, fname.c_str(), AASSET_MODE_STREAMING); // 以流方式打开
+  assert(asset);
+  unsigned char buf[4];
+  AAsset_read(asset, (void *) buf, 4);
+  int width = fromBytesToInt(buf);                                        // 纹理宽度
+  AAsset_read(asset, (void *) buf, 4);
+  int height = fromBytesToInt(buf);                                       // 纹理高度
+  AAsset_read(asset, (void *) buf, 4);
+  int sliceCount = fromBytesToInt(buf);                                   // 3D纹理深度或纹理数组长度
+  return new TexSliceStream(asset, width, height, sliceCount);
+}
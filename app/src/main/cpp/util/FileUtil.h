@@ -6,6 +6,7 @@
 #include <string>
 #include "ThreeDTexDataObject.h"
 #include "TexArrayDataObject.h"
+#include "TexSliceStream.h"
 
 /// Sample6_1
 #include "TexDataObject.h"
@@ -47,6 +48,12 @@ class FileUtil {
    * Sample6_10
    */
   static TexArrayDataObject *load2DArrayTexData(string fname);
+
+  /**
+   * 打开3D纹理或2D纹理数组文件, 仅读取文件头, 返回按切片流式读取的对象
+   * (与load3DTexData、load2DArrayTexData不同, 不一次性加载全部纹理数据)
+   */
+  static TexSliceStream *openTexSliceStream(string fname);
 };
 
 #endif
@@ -0,0 +1,144 @@
+#include "FramePacer.h"
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include "../bndev/mylog.h"
+
+long long FramePacer::refreshIntervalNs = FRAME_PACER_REFRESH_NS;
+long long FramePacer::targetIntervalNs = 0;
+float FramePacer::currFPS = 0;
+double FramePacer::jitterMs = 0;
+double FramePacer::maxIntervalMs = 0;
+long long FramePacer::frames = 0;
+long long FramePacer::missedFrames = 0;
+PacerNowFunc FramePacer::nowFunc;
+PacerSleepFunc FramePacer::sleepFunc;
+double FramePacer::requestedFps = 0;
+long long FramePacer::nextStart = 0;
+long long FramePacer::lastBegin = 0;
+long long FramePacer::periodStart = 0;
+int FramePacer::periodFrames = 0;
+double FramePacer::periodSum = 0;
+double FramePacer::periodSquareSum = 0;
+double FramePacer::periodMax = 0;
+
+void FramePacer::setClock(PacerNowFunc now, PacerSleepFunc sleep) {
+  if (now && sleep) {
+    nowFunc = now;
+    sleepFunc = sleep;
+  } else {
+    nowFunc = nullptr;
+    sleepFunc = nullptr;
+  }
+  reset();
+}
+
+void FramePacer::setRefreshInterval(long long ns) {
+  refreshIntervalNs = ns > 0 ? ns : FRAME_PACER_REFRESH_NS;
+  updateTarget();
+  LOGI("FramePacer: refresh interval %.3f ms, frame interval %.3f ms",
+       refreshIntervalNs / 1e6, targetIntervalNs / 1e6);
+}
+
+void FramePacer::setTargetFps(double fps) {
+  requestedFps = fps;
+  updateTarget();
+}
+
+void FramePacer::reset() {
+  nextStart = 0;
+  lastBegin = 0;
+  periodStart = 0;
+  periodFrames = 0;
+  periodSum = 0;
+  periodSquareSum = 0;
+  periodMax = 0;
+  frames = 0;
+  missedFrames = 0;
+}
+
+void FramePacer::begin() {
+  long long t = now();
+  if (nextStart == 0) {                                                   // 第一帧作为节奏的起点
+    nextStart = t;
+  }
+  if (periodStart == 0) {
+    periodStart = t;
+  }
+  if (lastBegin != 0) {                                                   // 累计帧间隔
+    double interval = (t - lastBegin) / 1e6;
+    periodFrames++;
+    periodSum += interval;
+    periodSquareSum += interval * interval;
+    periodMax = std::max(periodMax, interval);
+  }
+  lastBegin = t;
+  if (t - periodStart >= FRAME_PACER_LOG_INTERVAL_NS && periodFrames > 0) {
+    double mean = periodSum / periodFrames;
+    currFPS = (float) (1000.0 / mean);
+    jitterMs = std::sqrt(std::max(0.0, periodSquareSum / periodFrames - mean * mean));
+    maxIntervalMs = periodMax;
+    LOGI("FPS: %.2f, frame interval %.3f ms, jitter %.3f ms, max %.3f ms, %lld missed",
+         currFPS, mean, jitterMs, maxIntervalMs, missedFrames);
+    periodStart = t;
+    periodFrames = 0;
+    periodSum = 0;
+    periodSquareSum = 0;
+    periodMax = 0;
+  }
+}
+
+void FramePacer::end(bool pace) {
+  frames++;
+  long long t = now();
+  if (!pace || targetIntervalNs == 0) {                                   // 不限帧率: 以当前时刻为新的起点
+    nextStart = t;
+    return;
+  }
+  nextStart += targetIntervalNs;
+  if (t > nextStart) {                                                    // 本帧超时, 跳到下一个对齐的时刻
+    missedFrames++;
+    nextStart += ((t - nextStart) / targetIntervalNs + 1) * targetIntervalNs;
+  }
+  waitUntil(nextStart);
+}
+
+long long FramePacer::now() {
+  if (nowFunc) {
+    return nowFunc();
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FramePacer::logStats() {
+  LOGI("FramePacer: %lld frames, %lld missed, %.2f fps, jitter %.3f ms",
+       frames, missedFrames, currFPS, jitterMs);
+}
+
+void FramePacer::updateTarget() {
+  if (requestedFps <= 0) {
+    targetIntervalNs = 0;
+    return;
+  }
+  double ratio = 1e9 / requestedFps / refreshIntervalNs;                 // 目标帧间隔是刷新周期的几倍
+  long long multiple = std::max(1LL, (long long) std::ceil(ratio - FRAME_PACER_REFRESH_SLACK));
+  targetIntervalNs = multiple * refreshIntervalNs;
+}
+
+void FramePacer::waitUntil(long long deadline) {
+  long long remaining = deadline - now();
+  if (remaining > FRAME_PACER_SPIN_NS) {                                  // 先休眠到目标时刻之前
+    if (sleepFunc) {
+      sleepFunc(remaining - FRAME_PACER_SPIN_NS);
+    } else {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - FRAME_PACER_SPIN_NS));
+    }
+  }
+  while (now() < deadline) {                                              // 余下的时间自旋
+    if (!sleepFunc) {
+      std::this_thread::yield();
+    }
+  }
+}
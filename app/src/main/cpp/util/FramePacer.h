@@ -0,0 +1,102 @@
+#ifndef DEEPERVULKAN_FRAMEPACER_H_
+#define DEEPERVULKAN_FRAMEPACER_H_
+
+#include <functional>
+
+#define FRAME_PACER_REFRESH_NS 16666667LL          // 查询不到显示器刷新周期时的默认值(60Hz)
+#define FRAME_PACER_SPIN_NS 2000000LL              // 距目标时刻不足这一时长时改为自旋(休眠的唤醒误差通常在1~2毫秒内)
+#define FRAME_PACER_LOG_INTERVAL_NS 1000000000LL   // 每隔这么久打印一次帧率与帧间隔抖动
+#define FRAME_PACER_REFRESH_SLACK 0.05             // 目标帧间隔超过刷新周期整数倍的比例不大于此值时视为该整数倍
+
+/**
+ * 返回当前时间(纳秒, 单调递增)
+ */
+typedef std::function<long long()> PacerNowFunc;
+
+/**
+ * 休眠指定的纳秒数
+ */
+typedef std::function<void(long long)> PacerSleepFunc;
+
+/**
+ * 帧节奏控制
+ * 以steady_clock的纳秒时间戳为每帧安排开始时刻: 第k帧在起点 + k * 帧间隔开始, 不会像逐帧计算休眠时长那样累积误差
+ * 等待时先休眠到目标时刻之前FRAME_PACER_SPIN_NS, 余下的时间自旋, 使帧开始时刻准确落在目标上
+ * 帧间隔取显示器刷新周期的整数倍(如90Hz显示器上限制30帧即每3个刷新周期一帧), 各帧在显示器上停留的时间一致
+ * 某帧超时后跳到下一个对齐的时刻, 不连续补帧; 时钟与休眠函数可替换, 以便在主机上确定性地测试
+ */
+class FramePacer {
+ public:
+  static long long refreshIntervalNs;                   // 显示器刷新周期(纳秒)
+  static long long targetIntervalNs;                    // 实际使用的帧间隔(刷新周期的整数倍, 0为不限帧率)
+  static float currFPS;                                 // 最近一个统计周期的帧率
+  static double jitterMs;                               // 最近一个统计周期内帧间隔的标准差(毫秒)
+  static double maxIntervalMs;                          // 最近一个统计周期内的最长帧间隔(毫秒)
+  static long long frames;                              // 已完成的帧数(统计用)
+  static long long missedFrames;                        // 超过目标时刻才结束的帧数(统计用)
+
+  /**
+   * 替换时钟与休眠函数(任一为空时恢复为steady_clock与sleep_for)
+   * 自旋阶段反复调用now, 替换的时钟每次调用都应前进, 否则自旋不会结束
+   */
+  static void setClock(PacerNowFunc now, PacerSleepFunc sleep);
+
+  /**
+   * 设置显示器刷新周期(纳秒), 帧间隔随之重新对齐
+   */
+  static void setRefreshInterval(long long ns);
+
+  /**
+   * 设置目标帧率(0为不限帧率), 实际帧间隔取不短于1 / fps的刷新周期整数倍
+   */
+  static void setTargetFps(double fps);
+
+  /**
+   * 重新开始: 下一次begin作为节奏的起点, 清除统计
+   */
+  static void reset();
+
+  /**
+   * 一帧开始时调用: 记录帧间隔, 每个统计周期打印一次帧率与抖动
+   */
+  static void begin();
+
+  /**
+   * 一帧结束时调用: pace为true时等待到下一帧的开始时刻, 为false时(如吞吐量测试)不等待并以当前时刻为新的起点
+   */
+  static void end(bool pace = true);
+
+  /**
+   * 当前时间(纳秒)
+   */
+  static long long now();
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  static PacerNowFunc nowFunc;                          // 时钟
+  static PacerSleepFunc sleepFunc;                      // 休眠函数
+  static double requestedFps;                           // 请求的目标帧率
+  static long long nextStart;                           // 下一帧的开始时刻(0为尚未开始)
+  static long long lastBegin;                           // 上一帧的开始时刻(0为尚无)
+  static long long periodStart;                         // 本统计周期的起点
+  static int periodFrames;                              // 本统计周期的帧数
+  static double periodSum;                              // 本统计周期内帧间隔之和(毫秒)
+  static double periodSquareSum;                        // 本统计周期内帧间隔平方之和
+  static double periodMax;                              // 本统计周期内的最长帧间隔
+
+  /**
+   * 按目标帧率与刷新周期计算帧间隔
+   */
+  static void updateTarget();
+
+  /**
+   * 休眠并自旋到指定时刻
+   */
+  static void waitUntil(long long deadline);
+};
+
+#endif //DEEPERVULKAN_FRAMEPACER_H_
@@ -0,0 +1,118 @@
+#include "GeometryBuffer.h"
+#include <cassert>
+#include <cstring>
+#include "AsyncUploader.h"
+#include "../bndev/mylog.h"
+
+int GeometryBuffer::stagedBuffers = 0;
+long long GeometryBuffer::stagedBytes = 0;
+int GeometryBuffer::directBuffers = 0;
+
+static const VkFlags unifiedPreferences[] = {                             // 统一内存: 可映射的设备本地内存直接写入
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+};
+static const VkFlags staticPreferences[] = {                              // 独立显存: 设备本地内存经中转拷贝, 显存不足时退回主机内存
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+};
+static const VkFlags dynamicPreferences[] = {                             // 动态数据: 主机可见内存
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+};
+
+unsigned long long GeometryBuffer::create(VkDevice &device, VkBufferUsageFlags usage, const void *data,
+                                          VkDeviceSize byteCount, bool dynamic, VkBuffer &buffer,
+                                          MemoryAllocation &memory) {
+  bool staged = !dynamic && AsyncUploader::active();                      // 未初始化异步上传时按动态数据处理
+  VkBufferCreateInfo buf_info = {};
+  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buf_info.pNext = nullptr;
+  buf_info.usage = usage | (staged ? VK_BUFFER_USAGE_TRANSFER_DST_BIT      // 中转拷贝的目标
+                                   | VK_BUFFER_USAGE_TRANSFER_SRC_BIT : 0); // 内存整理时作为拷贝源
+  buf_info.size = byteCount;
+  buf_info.queueFamilyIndexCount = 0;
+  buf_info.pQueueFamilyIndices = nullptr;
+  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;                       // 独立传输队列时由AsyncUploader转移所有权
+  buf_info.flags = 0;
+  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &buffer);
+  assert(result == VK_SUCCESS);
+
+  if (!staged) {
+    DeviceMemoryAllocator::allocateBuffer(device, buffer, dynamicPreferences,
+                                          sizeof(dynamicPreferences) / sizeof(VkFlags), memory);
+  } else if (DeviceMemoryAllocator::unifiedMemory) {
+    DeviceMemoryAllocator::allocateBuffer(device, buffer, unifiedPreferences,
+                                          sizeof(unifiedPreferences) / sizeof(VkFlags), memory);
+  } else {
+    DeviceMemoryAllocator::allocateBuffer(device, buffer, staticPreferences,
+                                          sizeof(staticPreferences) / sizeof(VkFlags), memory);
+  }
+  assert(byteCount <= memory.size);
+
+  if (memory.mapped != nullptr) {                                         // 可映射(主机内存或统一内存)时直接写入
+    memcpy(memory.mapped, data, (size_t) byteCount);
+    DeviceMemoryAllocator::flush(device, memory, 0, byteCount);
+    directBuffers++;
+    return 0;
+  }
+  VkPipelineStageFlags dstStage;                                          // 图形队列上首次使用的阶段与访问类型
+  VkAccessFlags dstAccess;
+  usageStages(usage, dstStage, dstAccess);
+  stagedBuffers++;
+  stagedBytes += byteCount;
+  return AsyncUploader::uploadBuffer(buffer, 0, data, byteCount, dstStage, dstAccess);
+}
+
+int GeometryBuffer::registerMovable(VkBuffer buffer, VkBufferUsageFlags usage, VkDeviceSize byteCount,
+                                    const MemoryAllocation &memory, unsigned long long uploadTicket,
+                                    RelocateCallback relocated) {
+  if (memory.mapped != nullptr) {                                         // 直接写入的缓冲没有拷贝用途
+    return -1;
+  }
+  VkBufferCreateInfo buf_info = {};                                       // 与create中的创建信息相同
+  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buf_info.pNext = nullptr;
+  buf_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buf_info.size = byteCount;
+  buf_info.queueFamilyIndexCount = 0;
+  buf_info.pQueueFamilyIndices = nullptr;
+  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buf_info.flags = 0;
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+  usageStages(usage, stages, access);
+  return DeviceMemoryDefragmenter::registerBuffer(buffer, buf_info, memory, stages, access, uploadTicket, relocated);
+}
+
+void GeometryBuffer::usageStages(VkBufferUsageFlags usage, VkPipelineStageFlags &dstStage, VkAccessFlags &dstAccess) {
+  dstStage = 0;
+  dstAccess = 0;
+  if ((usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) != 0) {
+    dstStage |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    dstAccess |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  }
+  if ((usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) != 0) {
+    dstStage |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    dstAccess |= VK_ACCESS_INDEX_READ_BIT;
+  }
+  if ((usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) != 0) {
+    dstStage |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    dstAccess |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  }
+  if ((usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) != 0) {
+    dstStage |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dstAccess |= VK_ACCESS_SHADER_READ_BIT;
+  }
+  if (dstStage == 0) {
+    dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    dstAccess = VK_ACCESS_MEMORY_READ_BIT;
+  }
+}
+
+void GeometryBuffer::logStats() {
+  LOGI("GeometryBuffer: %d staged buffers (%lld bytes), %d direct buffers, unified memory %d",
+       stagedBuffers, stagedBytes, directBuffers, (int) DeviceMemoryAllocator::unifiedMemory);
+}
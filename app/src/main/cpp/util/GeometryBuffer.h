@@ -0,0 +1,50 @@
+#ifndef DEEPERVULKAN_GEOMETRYBUFFER_H_
+#define DEEPERVULKAN_GEOMETRYBUFFER_H_
+
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
+#include "DeviceMemoryDefragmenter.h"
+
+/**
+ * 顶点、索引等几何数据缓冲的创建
+ * 静态数据放入设备本地内存, 经中转环形缓冲由AsyncUploader在传输队列上拷贝, 票号完成之前不得用于绘制;
+ * 统一内存设备上优先使用可映射的设备本地内存直接写入, 省去中转拷贝;
+ * 动态数据(每帧由CPU改写)始终放入主机可见内存并直接写入
+ * 经中转拷贝的缓冲可登记给DeviceMemoryDefragmenter, 在内存整理时被移动
+ */
+class GeometryBuffer {
+ public:
+  static int stagedBuffers;                   // 经中转拷贝上传的缓冲数(统计用)
+  static long long stagedBytes;               // 经中转拷贝上传的字节数(统计用)
+  static int directBuffers;                   // 直接写入映射内存的缓冲数(统计用)
+
+  /**
+   * 创建用途为usage的缓冲, 分配内存并写入byteCount字节的data(调用后data即可释放)
+   * 返回上传票号, 直接写入时返回0(AsyncUploader::isComplete始终为真)
+   */
+  static unsigned long long create(VkDevice &device, VkBufferUsageFlags usage, const void *data,
+                                   VkDeviceSize byteCount, bool dynamic, VkBuffer &buffer,
+                                   MemoryAllocation &memory);
+
+  /**
+   * 把create创建的缓冲登记为可被内存整理移动, 返回登记号
+   * 直接写入映射内存的缓冲(动态数据与统一内存)不移动, 返回-1
+   */
+  static int registerMovable(VkBuffer buffer, VkBufferUsageFlags usage, VkDeviceSize byteCount,
+                             const MemoryAllocation &memory, unsigned long long uploadTicket,
+                             RelocateCallback relocated);
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  /**
+   * 按缓冲用途得到图形队列上使用它的管线阶段与访问类型
+   */
+  static void usageStages(VkBufferUsageFlags usage, VkPipelineStageFlags &dstStage, VkAccessFlags &dstAccess);
+};
+
+#endif //DEEPERVULKAN_GEOMETRYBUFFER_H_
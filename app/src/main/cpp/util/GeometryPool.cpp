@@ -0,0 +1,444 @@
+#include "GeometryPool.h"
+#include <cassert>
+#include <cstring>
+#include "AsyncUploader.h"
+#include "ResourceStateTracker.h"
+#include "../bndev/mylog.h"
+
+bool GeometryPool::multiDrawIndirect = false;
+int GeometryPool::meshCount = 0;
+int GeometryPool::allocationFailures = 0;
+int GeometryPool::compactions = 0;
+long long GeometryPool::compactedBytes = 0;
+long long GeometryPool::batchedDraws = 0;
+long long GeometryPool::indirectCalls = 0;
+GeometryArena GeometryPool::vertexArena;
+GeometryArena GeometryPool::indexArena;
+std::vector<GeometryMesh> GeometryPool::meshes;
+std::vector<int> GeometryPool::freeSlots;
+std::vector<int> GeometryPool::releasingSlots;
+std::vector<RetiredGeometryBuffer> GeometryPool::retired;
+std::vector<VkDrawIndirectCommand> GeometryPool::pendingDraws;
+std::vector<VkDrawIndexedIndirectCommand> GeometryPool::pendingIndexedDraws;
+VkDevice *GeometryPool::devicePointer = nullptr;
+VkBuffer GeometryPool::indirectBuffer = VK_NULL_HANDLE;
+MemoryAllocation GeometryPool::indirectMemory;
+VkDeviceSize GeometryPool::indirectHead = 0;
+thread_local VkCommandBuffer GeometryPool::boundCmd = VK_NULL_HANDLE;
+unsigned long long GeometryPool::lastTicket = 0;
+long long GeometryPool::uploadsIdleFrame = -1;
+long long GeometryPool::frame = 0;
+int GeometryPool::framesInFlight = 1;
+bool GeometryPool::created = false;
+
+static const VkFlags unifiedPreferences[] = {                             // 统一内存: 可映射的设备本地内存直接写入
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+};
+static const VkFlags staticPreferences[] = {                              // 独立显存: 设备本地内存经中转拷贝
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+};
+static const VkFlags indirectPreferences[] = {                            // 间接绘制命令每帧由CPU写入
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+};
+
+#define INDIRECT_REGION_BYTES (GEOMETRY_POOL_INDIRECT_COUNT * sizeof(VkDrawIndexedIndirectCommand))
+
+void GeometryPool::createArena(VkDevice &device, VkBufferUsageFlags usage, VkDeviceSize size, GeometryArena &arena) {
+  VkBufferCreateInfo buf_info = {};
+  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buf_info.pNext = nullptr;
+  buf_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT              // 上传与整理拷贝的目标
+      | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;                                 // 整理拷贝的源
+  buf_info.size = size;
+  buf_info.queueFamilyIndexCount = 0;
+  buf_info.pQueueFamilyIndices = nullptr;
+  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;                       // 独立传输队列时由AsyncUploader按段转移所有权
+  buf_info.flags = 0;
+  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &arena.buffer);
+  assert(result == VK_SUCCESS);
+  ResourceStateTracker::registerBuffer(arena.buffer);                     // 跟踪整理拷贝的访问
+  if (DeviceMemoryAllocator::unifiedMemory) {
+    DeviceMemoryAllocator::allocateBuffer(device, arena.buffer, unifiedPreferences,
+                                          sizeof(unifiedPreferences) / sizeof(VkFlags), arena.memory);
+  } else {
+    DeviceMemoryAllocator::allocateBuffer(device, arena.buffer, staticPreferences,
+                                          sizeof(staticPreferences) / sizeof(VkFlags), arena.memory);
+  }
+  arena.usage = usage;
+}
+
+void GeometryPool::create(VkDevice &device, VkPhysicalDevice &gpu, VkDeviceSize vertexBytes,
+                          VkDeviceSize indexBytes) {
+  assert(AsyncUploader::active());
+  devicePointer = &device;
+  VkPhysicalDeviceFeatures features;                                      // 创建逻辑设备时已启用所有支持的特性
+  vk::vkGetPhysicalDeviceFeatures(gpu, &features);
+  multiDrawIndirect = features.multiDrawIndirect == VK_TRUE && features.drawIndirectFirstInstance == VK_TRUE;
+
+  createArena(device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBytes, vertexArena);
+  vertexArena.allocator = new TlsfAllocator(vertexBytes);
+  createArena(device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBytes, indexArena);
+  indexArena.allocator = new TlsfAllocator(indexBytes);
+
+  VkBufferCreateInfo buf_info = {};
+  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buf_info.pNext = nullptr;
+  buf_info.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+  buf_info.size = INDIRECT_REGION_BYTES * GEOMETRY_POOL_FRAMES;
+  buf_info.queueFamilyIndexCount = 0;
+  buf_info.pQueueFamilyIndices = nullptr;
+  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buf_info.flags = 0;
+  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &indirectBuffer);
+  assert(result == VK_SUCCESS);
+  DeviceMemoryAllocator::allocateBuffer(device, indirectBuffer, indirectPreferences,
+                                        sizeof(indirectPreferences) / sizeof(VkFlags), indirectMemory);
+  assert(indirectMemory.mapped != nullptr);
+
+  meshes.clear();
+  freeSlots.clear();
+  releasingSlots.clear();
+  retired.clear();
+  pendingDraws.clear();
+  pendingIndexedDraws.clear();
+  indirectHead = 0;
+  boundCmd = VK_NULL_HANDLE;
+  lastTicket = 0;
+  uploadsIdleFrame = -1;
+  frame = 0;
+  meshCount = 0;
+  created = true;
+  LOGI("GeometryPool created: %d vertex bytes, %d index bytes, direct write %d, multiDrawIndirect %d",
+       (int) vertexBytes, (int) indexBytes, (int) (vertexArena.memory.mapped != nullptr), (int) multiDrawIndirect);
+}
+
+void GeometryPool::destroy(VkDevice &device) {
+  if (!created) {
+    return;
+  }
+  logStats();
+  if (meshCount != 0) {
+    LOGE("GeometryPool: %d meshes still alive at destroy", meshCount);
+  }
+  for (size_t i = 0; i < retired.size(); ++i) {
+    ResourceStateTracker::forgetBuffer(retired[i].buffer);
+    vk::vkDestroyBuffer(device, retired[i].buffer, nullptr);
+    DeviceMemoryAllocator::free(device, retired[i].memory);
+  }
+  retired.clear();
+  GeometryArena *arenas[2] = {&vertexArena, &indexArena};
+  for (int i = 0; i < 2; ++i) {
+    ResourceStateTracker::forgetBuffer(arenas[i]->buffer);
+    vk::vkDestroyBuffer(device, arenas[i]->buffer, nullptr);
+    DeviceMemoryAllocator::free(device, arenas[i]->memory);
+    delete arenas[i]->allocator;
+    arenas[i]->buffer = VK_NULL_HANDLE;
+    arenas[i]->allocator = nullptr;
+  }
+  vk::vkDestroyBuffer(device, indirectBuffer, nullptr);
+  DeviceMemoryAllocator::free(device, indirectMemory);
+  indirectBuffer = VK_NULL_HANDLE;
+  meshes.clear();
+  freeSlots.clear();
+  releasingSlots.clear();
+  created = false;
+}
+
+bool GeometryPool::active() {
+  return created;
+}
+
+unsigned long long GeometryPool::write(VkDevice &device, GeometryArena &arena, VkDeviceSize offset,
+                                       const void *data, VkDeviceSize byteCount) {
+  if (arena.memory.mapped != nullptr) {                                   // 统一内存时直接写入
+    memcpy(arena.memory.mapped + offset, data, (size_t) byteCount);
+    DeviceMemoryAllocator::flush(device, arena.memory, offset, byteCount);
+    return 0;
+  }
+  VkAccessFlags dstAccess = (arena.usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) != 0 ?
+                            VK_ACCESS_INDEX_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  lastTicket = AsyncUploader::uploadBuffer(arena.buffer, offset, data, byteCount,
+                                           VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, dstAccess);
+  return lastTicket;
+}
+
+int GeometryPool::allocate(VkDevice &device, const void *vertexData, uint32_t vertexCount, uint32_t stride,
+                           const uint16_t *indexData, uint32_t indexCount) {
+  assert(created && vertexCount > 0 && stride > 0);
+  uint64_t vertexOffset = 0;
+  uint32_t vertexHandle = TLSF_NONE;
+  if (!vertexArena.allocator->allocate((uint64_t) vertexCount * stride, stride, vertexOffset, vertexHandle)) {
+    allocationFailures++;                                                 // 碎片导致失败时下一帧整理
+    LOGE("GeometryPool: no room for %d vertices x %d bytes", (int) vertexCount, (int) stride);
+    return -1;
+  }
+  uint64_t indexOffset = 0;
+  uint32_t indexHandle = TLSF_NONE;
+  if (indexCount > 0 &&
+      !indexArena.allocator->allocate((uint64_t) indexCount * sizeof(uint16_t), sizeof(uint16_t),
+                                      indexOffset, indexHandle)) {
+    vertexArena.allocator->free(vertexHandle);
+    allocationFailures++;
+    LOGE("GeometryPool: no room for %d indices", (int) indexCount);
+    return -1;
+  }
+
+  int slot;
+  if (freeSlots.empty()) {
+    slot = (int) meshes.size();
+    meshes.push_back(GeometryMesh());
+  } else {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  GeometryMesh &m = meshes[slot];
+  m.firstVertex = (uint32_t) (vertexOffset / stride);
+  m.vertexCount = vertexCount;
+  m.stride = stride;
+  m.firstIndex = (uint32_t) (indexOffset / sizeof(uint16_t));
+  m.indexCount = indexCount;
+  m.vertexHandle = vertexHandle;
+  m.indexHandle = indexHandle;
+  m.live = true;
+  m.releaseFrame = -1;
+  m.uploadTicket = write(device, vertexArena, vertexOffset, vertexData, (VkDeviceSize) vertexCount * stride);
+  if (indexCount > 0) {
+    m.uploadTicket = write(device, indexArena, indexOffset, indexData, (VkDeviceSize) indexCount * sizeof(uint16_t));
+  }
+  meshCount++;
+  return slot;
+}
+
+void GeometryPool::free(int mesh) {
+  assert(mesh >= 0 && mesh < (int) meshes.size() && meshes[mesh].live);
+  meshes[mesh].live = false;                                              // 在途帧可能仍在读取, 稍后回收空间
+  meshes[mesh].releaseFrame = frame;
+  releasingSlots.push_back(mesh);
+  meshCount--;
+}
+
+const GeometryMesh &GeometryPool::mesh(int mesh) {
+  return meshes[mesh];
+}
+
+bool GeometryPool::ready(int mesh) {
+  return AsyncUploader::isComplete(meshes[mesh].uploadTicket);
+}
+
+bool GeometryPool::fragmented(const GeometryArena &arena) {
+  const TlsfAllocator &a = *arena.allocator;
+  uint64_t freeBytes = a.size - a.usedBytes;
+  return a.freeBlockCount() > 1 && a.largestFree() < freeBytes * GEOMETRY_POOL_COMPACT_RATIO;
+}
+
+void GeometryPool::compactArena(VkDevice &device, VkCommandBuffer &cmdBuffer, GeometryArena &arena, bool vertex) {
+  GeometryArena packed;
+  createArena(device, arena.usage, arena.allocator->size, packed);
+  packed.allocator = new TlsfAllocator(arena.allocator->size);
+
+  std::vector<VkBufferCopy> regions;
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    GeometryMesh &m = meshes[i];
+    uint32_t &handle = vertex ? m.vertexHandle : m.indexHandle;
+    if (handle == TLSF_NONE) {
+      continue;
+    }
+    if (!m.live) {                                                        // 等待回收的网格: 空间随旧缓冲一起回收
+      handle = TLSF_NONE;
+      continue;
+    }
+    uint64_t size = vertex ? (uint64_t) m.vertexCount * m.stride : (uint64_t) m.indexCount * sizeof(uint16_t);
+    uint64_t alignment = vertex ? m.stride : sizeof(uint16_t);
+    uint64_t offset = 0;
+    uint32_t newHandle = TLSF_NONE;
+    bool flag = packed.allocator->allocate(size, alignment, offset, newHandle); // 按编号顺序依次放入, 不会失败
+    assert(flag);
+    VkBufferCopy region;
+    region.srcOffset = arena.allocator->offsetOf(handle);
+    region.dstOffset = offset;
+    region.size = size;
+    regions.push_back(region);
+    handle = newHandle;
+    if (vertex) {
+      m.firstVertex = (uint32_t) (offset / m.stride);
+    } else {
+      m.firstIndex = (uint32_t) (offset / sizeof(uint16_t));
+    }
+    compactedBytes += size;
+  }
+  if (!regions.empty()) {                                                 // 上次整理拷贝的写入须对本次拷贝可见
+    ResourceStateTracker::useBuffer(cmdBuffer, arena.buffer, RESOURCE_USAGE_TRANSFER_READ);
+    ResourceStateTracker::useBuffer(cmdBuffer, packed.buffer, RESOURCE_USAGE_TRANSFER_WRITE);
+    ResourceStateTracker::flush(cmdBuffer);
+    vk::vkCmdCopyBuffer(cmdBuffer, arena.buffer, packed.buffer, (uint32_t) regions.size(), regions.data());
+  }
+  ResourceStateTracker::useBuffer(cmdBuffer, packed.buffer,               // 拷贝完成后才能作为顶点(索引)数据读取
+                                  vertex ? RESOURCE_USAGE_VERTEX_BUFFER : RESOURCE_USAGE_INDEX_BUFFER);
+
+  RetiredGeometryBuffer old;                                              // 本帧的拷贝仍读取旧缓冲
+  old.buffer = arena.buffer;
+  old.memory = arena.memory;
+  old.frame = frame;
+  retired.push_back(old);
+  delete arena.allocator;
+  arena = packed;
+}
+
+void GeometryPool::beginFrame(VkDevice &device, VkCommandBuffer &cmdBuffer) {
+  if (!created) {
+    return;
+  }
+  frame++;
+  for (size_t i = 0; i < releasingSlots.size();) {                        // 在途帧已结束的网格回收其空间
+    GeometryMesh &m = meshes[releasingSlots[i]];
+    if (frame - m.releaseFrame < framesInFlight) {
+      ++i;
+      continue;
+    }
+    if (m.vertexHandle != TLSF_NONE) {
+      vertexArena.allocator->free(m.vertexHandle);
+    }
+    if (m.indexHandle != TLSF_NONE) {
+      indexArena.allocator->free(m.indexHandle);
+    }
+    m.vertexHandle = TLSF_NONE;
+    m.indexHandle = TLSF_NONE;
+    freeSlots.push_back(releasingSlots[i]);
+    releasingSlots[i] = releasingSlots.back();
+    releasingSlots.pop_back();
+  }
+  for (size_t i = 0; i < retired.size();) {                               // 销毁在途帧已不再使用的旧缓冲
+    if (frame - retired[i].frame < framesInFlight) {
+      ++i;
+      continue;
+    }
+    ResourceStateTracker::forgetBuffer(retired[i].buffer);
+    vk::vkDestroyBuffer(device, retired[i].buffer, nullptr);
+    DeviceMemoryAllocator::free(device, retired[i].memory);
+    retired[i] = retired.back();
+    retired.pop_back();
+  }
+  // 整理须等上传完成且获取上传的帧已执行完, 否则传输队列可能仍在写入旧缓冲
+  if (!AsyncUploader::isComplete(lastTicket)) {
+    uploadsIdleFrame = -1;
+  } else if (uploadsIdleFrame < 0) {
+    uploadsIdleFrame = frame;
+  }
+  if (uploadsIdleFrame >= 0 && frame - uploadsIdleFrame >= framesInFlight) {
+    if (fragmented(vertexArena)) {
+      compactArena(device, cmdBuffer, vertexArena, true);
+      compactions++;
+    }
+    if (fragmented(indexArena)) {
+      compactArena(device, cmdBuffer, indexArena, false);
+      compactions++;
+    }
+    ResourceStateTracker::flush(cmdBuffer);                               // 发出最后一次整理拷贝之后的屏障
+  }
+  indirectHead = 0;
+  boundCmd = VK_NULL_HANDLE;                                              // 命令缓冲每帧重新录制
+  pendingDraws.clear();
+  pendingIndexedDraws.clear();
+}
+
+void GeometryPool::bind(VkCommandBuffer &cmdBuffer) {
+  if (boundCmd == cmdBuffer) {
+    return;
+  }
+  const VkDeviceSize offsetsVertex[1] = {0};
+  vk::vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexArena.buffer, offsetsVertex);
+  vk::vkCmdBindIndexBuffer(cmdBuffer, indexArena.buffer, 0, VK_INDEX_TYPE_UINT16);
+  boundCmd = cmdBuffer;
+}
+
+void GeometryPool::invalidateBinding() {
+  boundCmd = VK_NULL_HANDLE;
+}
+
+void GeometryPool::addDraw(int mesh, uint32_t instanceCount, uint32_t firstInstance) {
+  const GeometryMesh &m = meshes[mesh];
+  if (!m.live || !AsyncUploader::isComplete(m.uploadTicket)) {           // 尚在上传的网格本帧不绘制
+    return;
+  }
+  if (m.indexCount > 0) {
+    VkDrawIndexedIndirectCommand dic;
+    dic.indexCount = m.indexCount;
+    dic.instanceCount = instanceCount;
+    dic.firstIndex = m.firstIndex;
+    dic.vertexOffset = (int32_t) m.firstVertex;                           // 索引相对于网格自己的首顶点
+    dic.firstInstance = firstInstance;
+    pendingIndexedDraws.push_back(dic);
+  } else {
+    VkDrawIndirectCommand dic;
+    dic.vertexCount = m.vertexCount;
+    dic.instanceCount = instanceCount;
+    dic.firstVertex = m.firstVertex;
+    dic.firstInstance = firstInstance;
+    pendingDraws.push_back(dic);
+  }
+}
+
+void GeometryPool::drawBatch(VkCommandBuffer &cmdBuffer) {
+  if (pendingDraws.empty() && pendingIndexedDraws.empty()) {
+    return;
+  }
+  bind(cmdBuffer);
+  VkDeviceSize bytes = pendingDraws.size() * sizeof(VkDrawIndirectCommand) +
+                       pendingIndexedDraws.size() * sizeof(VkDrawIndexedIndirectCommand);
+  if (!multiDrawIndirect || indirectHead + bytes > INDIRECT_REGION_BYTES) { // 不支持或本帧区域已满时逐条直接绘制
+    for (size_t i = 0; i < pendingDraws.size(); ++i) {
+      const VkDrawIndirectCommand &d = pendingDraws[i];
+      vk::vkCmdDraw(cmdBuffer, d.vertexCount, d.instanceCount, d.firstVertex, d.firstInstance);
+    }
+    for (size_t i = 0; i < pendingIndexedDraws.size(); ++i) {
+      const VkDrawIndexedIndirectCommand &d = pendingIndexedDraws[i];
+      vk::vkCmdDrawIndexed(cmdBuffer, d.indexCount, d.instanceCount, d.firstIndex, d.vertexOffset, d.firstInstance);
+    }
+  } else {
+    VkDeviceSize regionOffset = INDIRECT_REGION_BYTES * (frame % GEOMETRY_POOL_FRAMES);
+    VkDeviceSize offset = regionOffset + indirectHead;
+    if (!pendingDraws.empty()) {
+      VkDeviceSize size = pendingDraws.size() * sizeof(VkDrawIndirectCommand);
+      memcpy(indirectMemory.mapped + offset, pendingDraws.data(), (size_t) size);
+      vk::vkCmdDrawIndirect(cmdBuffer, indirectBuffer, offset, (uint32_t) pendingDraws.size(),
+                            sizeof(VkDrawIndirectCommand));
+      offset += size;
+      indirectCalls++;
+    }
+    if (!pendingIndexedDraws.empty()) {
+      VkDeviceSize size = pendingIndexedDraws.size() * sizeof(VkDrawIndexedIndirectCommand);
+      memcpy(indirectMemory.mapped + offset, pendingIndexedDraws.data(), (size_t) size);
+      vk::vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, offset, (uint32_t) pendingIndexedDraws.size(),
+                                   sizeof(VkDrawIndexedIndirectCommand));
+      indirectCalls++;
+    }
+    DeviceMemoryAllocator::flush(*devicePointer, indirectMemory, regionOffset + indirectHead, bytes);
+    indirectHead += bytes;
+    batchedDraws += pendingDraws.size() + pendingIndexedDraws.size();
+  }
+  pendingDraws.clear();
+  pendingIndexedDraws.clear();
+}
+
+void GeometryPool::setFramesInFlight(int frames) {
+  assert(frames >= 1 && frames <= GEOMETRY_POOL_FRAMES);
+  framesInFlight = frames;
+}
+
+void GeometryPool::logStats() {
+  LOGI("GeometryPool: %d meshes, vertex %lld/%lld bytes (%d free ranges, largest %lld), "
+       "index %lld/%lld bytes (%d free ranges, largest %lld)",
+       meshCount,
+       (long long) vertexArena.allocator->usedBytes, (long long) vertexArena.allocator->size,
+       vertexArena.allocator->freeBlockCount(), (long long) vertexArena.allocator->largestFree(),
+       (long long) indexArena.allocator->usedBytes, (long long) indexArena.allocator->size,
+       indexArena.allocator->freeBlockCount(), (long long) indexArena.allocator->largestFree());
+  LOGI("GeometryPool: %d compactions (%lld bytes moved), %d allocation failures, "
+       "%lld batched draws in %lld indirect calls",
+       compactions, compactedBytes, allocationFailures, batchedDraws, indirectCalls);
+}
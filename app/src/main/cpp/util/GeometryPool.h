@@ -0,0 +1,187 @@
+#ifndef DEEPERVULKAN_GEOMETRYPOOL_H_
+#define DEEPERVULKAN_GEOMETRYPOOL_H_
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
+#include "TlsfAllocator.h"
+
+#define GEOMETRY_POOL_VERTEX_BYTES (32 * 1024 * 1024) // 共享顶点缓冲的默认字节数
+#define GEOMETRY_POOL_INDEX_BYTES (8 * 1024 * 1024)   // 共享索引缓冲的默认字节数
+#define GEOMETRY_POOL_INDIRECT_COUNT 1024             // 每帧最多合并的间接绘制命令数
+#define GEOMETRY_POOL_FRAMES 3                        // 间接绘制命令缓冲的帧区域数
+#define GEOMETRY_POOL_COMPACT_RATIO 0.5               // 最大空闲段小于空闲总量的这一比例时整理
+
+/**
+ * 共享缓冲池中的一个网格: 顶点与索引各占一段, 绘制时只需首顶点与首索引
+ */
+struct GeometryMesh {
+  uint32_t firstVertex;                     // 首顶点(共享顶点缓冲中的字节偏移量 / 顶点跨度)
+  uint32_t vertexCount;                     // 顶点数
+  uint32_t stride;                          // 顶点跨度(字节)
+  uint32_t firstIndex;                      // 首索引(共享索引缓冲中的字节偏移量 / 2)
+  uint32_t indexCount;                      // 索引数(0为无索引)
+  uint32_t vertexHandle;                    // 顶点段的分配句柄
+  uint32_t indexHandle;                     // 索引段的分配句柄(无索引时为TLSF_NONE)
+  unsigned long long uploadTicket;          // 最后一项上传的票号(直接写入时为0)
+  bool live;                                // 网格是否存活
+  long long releaseFrame;                   // 释放时的帧号(在途帧结束后才回收其空间, -1为未释放)
+};
+
+/**
+ * 共享缓冲池的一个缓冲(顶点或索引): 一个大缓冲, 各网格以TLSF在其中分配偏移量
+ */
+struct GeometryArena {
+  VkBuffer buffer;                          // 共享缓冲
+  MemoryAllocation memory;                  // 缓冲的设备内存
+  TlsfAllocator *allocator;                 // 缓冲内偏移量分配器
+  VkBufferUsageFlags usage;                 // 缓冲用途(顶点或索引)
+};
+
+/**
+ * 整理后等待在途帧结束再销毁的旧缓冲
+ */
+struct RetiredGeometryBuffer {
+  VkBuffer buffer;                          // 旧缓冲
+  MemoryAllocation memory;                  // 旧缓冲的设备内存
+  long long frame;                          // 最后使用旧缓冲的帧号
+};
+
+/**
+ * 几何缓冲池: 所有静态网格的顶点、索引数据子分配在两个共享的大缓冲中
+ * 每个命令缓冲只绑定一次顶点缓冲与索引缓冲, 物体绘制时以firstVertex/firstIndex/vertexOffset区分网格,
+ * 从而同一管线下的绘制可合并为多绘制间接(multiDrawIndirect)调用; 设备不支持时逐条直接绘制
+ * 网格释放后空闲段由TLSF合并, 碎片超过阈值时在帧开始的命令缓冲中把存活网格紧凑拷贝到新缓冲,
+ * 网格以编号引用, 整理后首顶点等随之更新, 旧缓冲在在途帧结束后销毁
+ * 动态几何数据(每帧由CPU改写)不进入缓冲池, 仍由GeometryBuffer单独创建
+ */
+class GeometryPool {
+ public:
+  static bool multiDrawIndirect;                        // 设备是否支持一次间接调用绘制多条命令
+  static int meshCount;                                 // 当前网格数(统计用)
+  static int allocationFailures;                        // 缓冲池空间不足而退回单独缓冲的次数(统计用)
+  static int compactions;                               // 整理次数(统计用)
+  static long long compactedBytes;                      // 整理时拷贝的字节数(统计用)
+  static long long batchedDraws;                        // 经间接调用合并绘制的命令数(统计用)
+  static long long indirectCalls;                       // 间接绘制调用次数(统计用)
+
+  /**
+   * 创建共享顶点、索引缓冲与间接绘制命令缓冲(须在AsyncUploader初始化之后调用)
+   */
+  static void create(VkDevice &device, VkPhysicalDevice &gpu,
+                     VkDeviceSize vertexBytes = GEOMETRY_POOL_VERTEX_BYTES,
+                     VkDeviceSize indexBytes = GEOMETRY_POOL_INDEX_BYTES);
+
+  /**
+   * 销毁所有缓冲(须在销毁所有网格、且在途的上传完成之后调用)
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 是否已创建
+   */
+  static bool active();
+
+  /**
+   * 分配网格并上传顶点(与索引)数据(调用后数据即可释放), 返回网格编号, 空间不足时返回-1
+   */
+  static int allocate(VkDevice &device, const void *vertexData, uint32_t vertexCount, uint32_t stride,
+                      const uint16_t *indexData = nullptr, uint32_t indexCount = 0);
+
+  /**
+   * 释放网格, 其空间在在途帧结束后回收
+   */
+  static void free(int mesh);
+
+  /**
+   * 网格的当前位置(整理后会变化, 不要长期保存其中的偏移量)
+   */
+  static const GeometryMesh &mesh(int mesh);
+
+  /**
+   * 网格数据是否已上传完成
+   */
+  static bool ready(int mesh);
+
+  /**
+   * 每帧调用一次(须在渲染通道之外): 回收已释放网格的空间, 销毁不再使用的旧缓冲,
+   * 碎片超过阈值且没有在途的上传时记录整理拷贝, 重置本帧的绑定与间接命令
+   */
+  static void beginFrame(VkDevice &device, VkCommandBuffer &cmdBuffer);
+
+  /**
+   * 在命令缓冲中绑定共享顶点、索引缓冲, 本帧已在该命令缓冲中绑定过时不做任何事
+   * 可在多个录制线程中调用(各线程分别记录已绑定的命令缓冲), addDraw与drawBatch只能在录制线程中调用
+   */
+  static void bind(VkCommandBuffer &cmdBuffer);
+
+  /**
+   * 绑定了其他顶点缓冲之后(或工作线程开始录制新的命令缓冲时)调用, 当前线程下一次bind重新绑定共享缓冲
+   */
+  static void invalidateBinding();
+
+  /**
+   * 追加一条绘制命令, 在drawBatch时与其他命令合并(firstInstance供着色器索引逐物体数据)
+   */
+  static void addDraw(int mesh, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+  /**
+   * 以当前绑定的管线与描述集绘制所有追加的命令: 支持multiDrawIndirect时各一次间接调用, 否则逐条直接绘制
+   */
+  static void drawBatch(VkCommandBuffer &cmdBuffer);
+
+  /**
+   * 设置同时在途的帧数, 整理后的旧缓冲在这么多帧之后销毁
+   */
+  static void setFramesInFlight(int frames);
+
+  /**
+   * 打印统计信息: 网格数、各缓冲的使用量与碎片、整理与合并绘制次数
+   */
+  static void logStats();
+
+ private:
+  static GeometryArena vertexArena;                     // 共享顶点缓冲
+  static GeometryArena indexArena;                      // 共享索引缓冲
+  static std::vector<GeometryMesh> meshes;              // 网格槽位
+  static std::vector<int> freeSlots;                    // 可重用的网格槽位
+  static std::vector<int> releasingSlots;               // 已释放、等待在途帧结束后回收空间的网格槽位
+  static std::vector<RetiredGeometryBuffer> retired;    // 等待销毁的旧缓冲
+  static std::vector<VkDrawIndirectCommand> pendingDraws;              // 本批无索引的绘制命令
+  static std::vector<VkDrawIndexedIndirectCommand> pendingIndexedDraws; // 本批有索引的绘制命令
+  static VkDevice *devicePointer;                       // 指向逻辑设备的指针
+  static VkBuffer indirectBuffer;                       // 间接绘制命令缓冲(每帧一个区域)
+  static MemoryAllocation indirectMemory;               // 间接绘制命令缓冲的设备内存
+  static VkDeviceSize indirectHead;                     // 本帧区域中已写入的字节数
+  static thread_local VkCommandBuffer boundCmd;         // 本帧已绑定共享缓冲的命令缓冲(每个录制线程一份)
+  static unsigned long long lastTicket;                 // 最后一项上传的票号
+  static long long uploadsIdleFrame;                    // 所有上传均已完成时的帧号(-1为仍有上传)
+  static long long frame;                               // 当前帧号
+  static int framesInFlight;                            // 同时在途的帧数
+  static bool created;                                  // 是否已创建
+
+  /**
+   * 创建共享缓冲并分配内存
+   */
+  static void createArena(VkDevice &device, VkBufferUsageFlags usage, VkDeviceSize size, GeometryArena &arena);
+
+  /**
+   * 创建与arena同样大小的新缓冲, 按网格编号顺序把存活段紧凑拷贝过去, 旧缓冲放入等待销毁列表
+   * 等待回收的网格不再拷贝, 其空间随旧缓冲一起回收
+   */
+  static void compactArena(VkDevice &device, VkCommandBuffer &cmdBuffer, GeometryArena &arena, bool vertex);
+
+  /**
+   * 把data写入缓冲的[offset, offset+byteCount): 可映射时直接写入, 否则经传输队列上传, 返回票号
+   */
+  static unsigned long long write(VkDevice &device, GeometryArena &arena, VkDeviceSize offset,
+                                  const void *data, VkDeviceSize byteCount);
+
+  /**
+   * 缓冲的碎片是否超过阈值
+   */
+  static bool fragmented(const GeometryArena &arena);
+};
+
+#endif //DEEPERVULKAN_GEOMETRYPOOL_H_
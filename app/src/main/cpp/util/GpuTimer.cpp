@@ -0,0 +1,81 @@
+#include "GpuTimer.h"
+#include <cassert>
+#include "../bndev/mylog.h"
+
+bool GpuTimer::supported = false;
+double GpuTimer::lastGpuMs = 0;
+VkQueryPool GpuTimer::queryPool = VK_NULL_HANDLE;
+double GpuTimer::periodNs = 1;
+uint64_t GpuTimer::validMask = 0;
+std::vector<bool> GpuTimer::written;
+
+void GpuTimer::create(VkDevice &device, VkPhysicalDevice &gpu, uint32_t queueFamilyIndex, int frameCount) {
+  uint32_t familyCount = 0;
+  vk::vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vk::vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+  uint32_t validBits = queueFamilyIndex < familyCount ? families[queueFamilyIndex].timestampValidBits : 0;
+  supported = validBits > 0;
+  if (!supported) {
+    LOGE("GpuTimer: queue family %d does not support timestamps", queueFamilyIndex);
+    return;
+  }
+  VkPhysicalDeviceProperties properties;
+  vk::vkGetPhysicalDeviceProperties(gpu, &properties);
+  periodNs = properties.limits.timestampPeriod;
+  validMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.pNext = nullptr;
+  poolInfo.flags = 0;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = (uint32_t) frameCount * 2;                        // 每帧区域开始、结束各一个
+  poolInfo.pipelineStatistics = 0;
+  VkResult result = vk::vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool);
+  assert(result == VK_SUCCESS);
+  written.assign(frameCount, false);
+  LOGI("GpuTimer: %d frame regions, timestamp period %.3f ns, %d valid bits", frameCount, periodNs, validBits);
+}
+
+void GpuTimer::destroy(VkDevice &device) {
+  if (queryPool != VK_NULL_HANDLE) {
+    vk::vkDestroyQueryPool(device, queryPool, nullptr);
+    queryPool = VK_NULL_HANDLE;
+  }
+  written.clear();
+  supported = false;
+}
+
+void GpuTimer::begin(VkCommandBuffer &cmd, int frame) {
+  if (queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  vk::vkCmdResetQueryPool(cmd, queryPool, (uint32_t) frame * 2, 2);       // 查询须在重置后才能再次写入
+  vk::vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, (uint32_t) frame * 2);
+}
+
+void GpuTimer::end(VkCommandBuffer &cmd, int frame) {
+  if (queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  vk::vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, (uint32_t) frame * 2 + 1);
+  written[frame] = true;
+}
+
+bool GpuTimer::read(VkDevice &device, int frame, double &gpuMs) {
+  if (queryPool == VK_NULL_HANDLE || !written[frame]) {
+    return false;
+  }
+  uint64_t stamps[2];
+  VkResult result = vk::vkGetQueryPoolResults(device, queryPool, (uint32_t) frame * 2, 2, sizeof(stamps), stamps,
+                                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT); // 栅栏已触发, 结果已可用
+  if (result != VK_SUCCESS) {
+    return false;
+  }
+  written[frame] = false;
+  uint64_t ticks = ((stamps[1] & validMask) - (stamps[0] & validMask)) & validMask; // 有效位不足64位时可能回绕
+  gpuMs = ticks * periodNs / 1e6;
+  lastGpuMs = gpuMs;
+  return true;
+}
@@ -0,0 +1,50 @@
+#ifndef DEEPERVULKAN_GPUTIMER_H_
+#define DEEPERVULKAN_GPUTIMER_H_
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+/**
+ * 以时间戳查询测量每帧命令缓冲在GPU上的执行时间
+ * 每个帧区域占查询池中相邻的两个查询(开始、结束), 在该帧区域的栅栏触发后读取, 读取时不会阻塞
+ * 队列家族不支持时间戳(timestampValidBits为0)时不创建查询池, 各方法不做任何事
+ */
+class GpuTimer {
+ public:
+  static bool supported;                        // 图形队列家族是否支持时间戳
+  static double lastGpuMs;                      // 最近一次读取的GPU时间(毫秒)
+
+  /**
+   * 创建frameCount个帧区域的查询池
+   */
+  static void create(VkDevice &device, VkPhysicalDevice &gpu, uint32_t queueFamilyIndex, int frameCount);
+
+  /**
+   * 销毁查询池
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 在命令缓冲开头(渲染通道之外)调用: 重置frame帧区域的查询并写入开始时间戳
+   */
+  static void begin(VkCommandBuffer &cmd, int frame);
+
+  /**
+   * 在命令缓冲结尾(渲染通道之外)调用: 写入结束时间戳
+   */
+  static void end(VkCommandBuffer &cmd, int frame);
+
+  /**
+   * frame帧区域的栅栏触发后调用: 读取该帧区域上一次提交的GPU时间, 没有可读的结果时返回false
+   */
+  static bool read(VkDevice &device, int frame, double &gpuMs);
+
+ private:
+  static VkQueryPool queryPool;                 // 时间戳查询池(每帧区域两个查询)
+  static double periodNs;                       // 时间戳每加1经过的纳秒数
+  static uint64_t validMask;                    // 时间戳的有效位
+  static std::vector<bool> written;             // 各帧区域是否有已提交且尚未读取的时间戳
+};
+
+#endif //DEEPERVULKAN_GPUTIMER_H_
@@ -0,0 +1,266 @@
+#include "HeadlessRenderer.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "MatrixState3D.h"
+#include "ResourceStateTracker.h"
+#include "../bndev/mylog.h"
+
+bool HeadlessRenderer::enabled = false;
+uint32_t HeadlessRenderer::width = HEADLESS_WIDTH;
+uint32_t HeadlessRenderer::height = HEADLESS_HEIGHT;
+int HeadlessRenderer::frameCount = HEADLESS_FRAMES;
+bool HeadlessRenderer::readback = false;
+std::string HeadlessRenderer::outputPath = "headless.ppm";
+std::vector<double> HeadlessRenderer::cpuMs;
+std::vector<double> HeadlessRenderer::gpuMs;
+std::vector<MemoryAllocation> HeadlessRenderer::targetMemory;
+std::vector<CameraKey> HeadlessRenderer::cameraKeys;
+
+void HeadlessRenderer::createTargets(VkDevice &device, uint32_t count, VkFormat format,
+                                     std::vector<VkImage> &images, std::vector<VkImageView> &views) {
+  images.resize(count);
+  views.resize(count);
+  targetMemory.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext = nullptr;
+    imageInfo.flags = 0;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // 作为颜色附件并可复制读回
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.queueFamilyIndexCount = 0;
+    imageInfo.pQueueFamilyIndices = nullptr;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult result = vk::vkCreateImage(device, &imageInfo, nullptr, &images[i]);
+    assert(result == VK_SUCCESS);
+    DeviceMemoryAllocator::allocateImage(
+        device, images[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, targetMemory[i]);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.pNext = nullptr;
+    viewInfo.flags = 0;
+    viewInfo.image = images[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
+    viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
+    viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
+    viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    result = vk::vkCreateImageView(device, &viewInfo, nullptr, &views[i]);
+    assert(result == VK_SUCCESS);
+  }
+  LOGI("HeadlessRenderer: %d offscreen targets %d x %d", count, width, height);
+}
+
+void HeadlessRenderer::destroyTargets(VkDevice &device, std::vector<VkImage> &images,
+                                      std::vector<VkImageView> &views) {
+  for (size_t i = 0; i < images.size(); ++i) {
+    vk::vkDestroyImageView(device, views[i], nullptr);
+    vk::vkDestroyImage(device, images[i], nullptr);
+    DeviceMemoryAllocator::free(device, targetMemory[i]);
+  }
+  images.clear();
+  views.clear();
+  targetMemory.clear();
+}
+
+void HeadlessRenderer::clearCameraKeys() {
+  cameraKeys.clear();
+}
+
+void HeadlessRenderer::addCameraKey(float ex, float ey, float ez, float tx, float ty, float tz) {
+  CameraKey key = {{ex, ey, ez}, {tx, ty, tz}};
+  cameraKeys.push_back(key);
+}
+
+void HeadlessRenderer::applyCamera(int frame) {
+  if (cameraKeys.empty()) {
+    return;
+  }
+  float t = 0;                                                            // 在关键帧序列中的位置
+  if (cameraKeys.size() > 1 && frameCount > 1) {
+    t = (float) std::min(frame, frameCount - 1) * (cameraKeys.size() - 1) / (frameCount - 1);
+  }
+  size_t index = std::min((size_t) t, cameraKeys.size() - 1);
+  size_t next = std::min(index + 1, cameraKeys.size() - 1);
+  float s = t - index;                                                    // 两个关键帧之间的插值系数
+  float eye[3];
+  float target[3];
+  for (int i = 0; i < 3; ++i) {
+    eye[i] = cameraKeys[index].eye[i] + (cameraKeys[next].eye[i] - cameraKeys[index].eye[i]) * s;
+    target[i] = cameraKeys[index].target[i] + (cameraKeys[next].target[i] - cameraKeys[index].target[i]) * s;
+  }
+  MatrixState3D::setCamera(eye[0], eye[1], eye[2], target[0], target[1], target[2], 0, 1, 0);
+}
+
+void HeadlessRenderer::reset() {
+  cpuMs.clear();
+  gpuMs.clear();
+  cpuMs.reserve(frameCount);
+  gpuMs.reserve(frameCount);
+}
+
+void HeadlessRenderer::recordCpu(double ms) {
+  cpuMs.push_back(ms);
+}
+
+void HeadlessRenderer::recordGpu(double ms) {
+  gpuMs.push_back(ms);
+}
+
+void HeadlessRenderer::logStats() {
+  const std::vector<double> *series[2] = {&cpuMs, &gpuMs};
+  const char *names[2] = {"CPU", "GPU"};
+  for (int i = 0; i < 2; ++i) {
+    const std::vector<double> &values = *series[i];
+    double sum = 0;
+    for (size_t j = 0; j < values.size(); ++j) {
+      sum += values[j];
+    }
+    LOGI("HeadlessRenderer %s: %d frames, mean %.3f ms, median %.3f ms, p95 %.3f ms, max %.3f ms",
+         names[i], (int) values.size(), values.empty() ? 0.0 : sum / values.size(),
+         percentile(values, 0.5), percentile(values, 0.95), percentile(values, 1.0));
+  }
+}
+
+bool HeadlessRenderer::saveImage(VkDevice &device, VkQueue &queue, VkCommandBuffer &cmd, VkImage image,
+                                 const std::string &path) {
+  VkDeviceSize rowPitch = (VkDeviceSize) width * 4;
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = nullptr;
+  bufferInfo.flags = 0;
+  bufferInfo.size = rowPitch * height;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = 0;
+  bufferInfo.pQueueFamilyIndices = nullptr;
+  VkBuffer buffer;
+  VkResult result = vk::vkCreateBuffer(device, &bufferInfo, nullptr, &buffer);
+  assert(result == VK_SUCCESS);
+  VkFlags preferences[2] = {                                              // 优先选择带缓存的内存, CPU读取更快
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+  MemoryAllocation memory;
+  DeviceMemoryAllocator::allocateBuffer(device, buffer, preferences, 2, memory);
+  ResourceStateTracker::registerBuffer(buffer);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.pNext = nullptr;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = nullptr;
+  vk::vkResetCommandBuffer(cmd, 0);
+  result = vk::vkBeginCommandBuffer(cmd, &beginInfo);
+  assert(result == VK_SUCCESS);
+
+  VkImageMemoryBarrier imageBarrier = {};                                 // 渲染通道写入的颜色对复制可见
+  imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  imageBarrier.pNext = nullptr;
+  imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.image = image;
+  imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  imageBarrier.subresourceRange.baseMipLevel = 0;
+  imageBarrier.subresourceRange.levelCount = 1;
+  imageBarrier.subresourceRange.baseArrayLayer = 0;
+  imageBarrier.subresourceRange.layerCount = 1;
+  vk::vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                           0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+  VkBufferImageCopy region = {};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;                                             // 紧密排列
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {width, height, 1};
+  ResourceStateTracker::useBuffer(cmd, buffer, RESOURCE_USAGE_TRANSFER_WRITE); // 新缓冲: 不需要屏障
+  ResourceStateTracker::flush(cmd);
+  vk::vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+  ResourceStateTracker::useBuffer(cmd, buffer, RESOURCE_USAGE_HOST_READ); // 复制结果对CPU读取可见
+  ResourceStateTracker::flush(cmd);
+  result = vk::vkEndCommandBuffer(cmd);
+  assert(result == VK_SUCCESS);
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = nullptr;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmd;
+  result = vk::vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+  assert(result == VK_SUCCESS);
+  vk::vkQueueWaitIdle(queue);                                             // 只在结束时读回一次, 直接等待队列空闲
+
+  bool saved = false;
+  if (memory.mapped != nullptr) {
+    std::vector<unsigned char> ppm;
+    encodePPM(memory.mapped, width, height, (size_t) rowPitch, ppm);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file != nullptr) {
+      saved = fwrite(ppm.data(), 1, ppm.size(), file) == ppm.size();
+      fclose(file);
+    }
+  }
+  if (saved) {
+    LOGI("HeadlessRenderer: saved %d x %d image to %s", width, height, path.c_str());
+  } else {
+    LOGE("HeadlessRenderer: failed to save image to %s", path.c_str());
+  }
+  ResourceStateTracker::forgetBuffer(buffer);
+  vk::vkDestroyBuffer(device, buffer, nullptr);
+  DeviceMemoryAllocator::free(device, memory);
+  return saved;
+}
+
+void HeadlessRenderer::encodePPM(const unsigned char *rgba, uint32_t width, uint32_t height, size_t rowPitch,
+                                 std::vector<unsigned char> &out) {
+  char header[32];
+  int headerLength = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+  out.resize(headerLength + (size_t) width * height * 3);
+  memcpy(out.data(), header, headerLength);
+  unsigned char *dst = out.data() + headerLength;
+  for (uint32_t y = 0; y < height; ++y) {
+    const unsigned char *src = rgba + y * rowPitch;
+    for (uint32_t x = 0; x < width; ++x) {
+      *dst++ = src[x * 4];
+      *dst++ = src[x * 4 + 1];
+      *dst++ = src[x * 4 + 2];
+    }
+  }
+}
+
+double HeadlessRenderer::percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  size_t rank = (size_t) std::ceil(p * values.size());                    // 最近秩
+  rank = std::max((size_t) 1, std::min(rank, values.size()));
+  return values[rank - 1];
+}
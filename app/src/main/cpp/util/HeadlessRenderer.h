@@ -0,0 +1,111 @@
+#ifndef DEEPERVULKAN_HEADLESSRENDERER_H_
+#define DEEPERVULKAN_HEADLESSRENDERER_H_
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
+
+#define HEADLESS_WIDTH 1280                       // 离屏颜色图像的默认宽度
+#define HEADLESS_HEIGHT 720                       // 离屏颜色图像的默认高度
+#define HEADLESS_FRAMES 600                       // 默认绘制的帧数
+#define HEADLESS_IMAGE_COUNT 2                    // 离屏颜色图像数(代替交换链图像轮流使用)
+#define HEADLESS_COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM // 离屏颜色图像的格式(读回时按RGBA8解释)
+
+/**
+ * 脚本摄像机的一个关键帧
+ */
+struct CameraKey {
+  float eye[3];                             // 摄像机位置
+  float target[3];                          // 目标点
+};
+
+/**
+ * 离屏无窗口绘制
+ * 不创建表面与交换链, 以若干离屏颜色图像代替交换链图像, 渲染通道结束时转为TRANSFER_SRC布局以便读回;
+ * 绘制固定帧数, 摄像机沿关键帧插值移动(与触控输入无关, 每次运行结果相同), 记录每帧的CPU录制提交耗时与GPU执行耗时,
+ * 结束时打印统计并可把最后一帧保存为PPM图像
+ * 只使用Vulkan 1.0核心功能, 可在lavapipe、SwiftShader等CPU实现上运行
+ */
+class HeadlessRenderer {
+ public:
+  static bool enabled;                          // 是否以离屏无窗口模式运行(须在创建Vulkan实例之前设置)
+  static uint32_t width;                        // 离屏颜色图像宽度
+  static uint32_t height;                       // 离屏颜色图像高度
+  static int frameCount;                        // 绘制的帧数
+  static bool readback;                         // 结束时是否读回最后一帧
+  static std::string outputPath;                // 读回图像的保存路径(PPM格式)
+  static std::vector<double> cpuMs;             // 每帧CPU录制与提交耗时(毫秒)
+  static std::vector<double> gpuMs;             // 每帧GPU执行耗时(毫秒, 设备不支持时间戳时为空)
+
+  /**
+   * 创建count幅离屏颜色图像及其图像视图(用途为颜色附件与传输源)
+   */
+  static void createTargets(VkDevice &device, uint32_t count, VkFormat format,
+                            std::vector<VkImage> &images, std::vector<VkImageView> &views);
+
+  /**
+   * 销毁离屏颜色图像及其图像视图
+   */
+  static void destroyTargets(VkDevice &device, std::vector<VkImage> &images, std::vector<VkImageView> &views);
+
+  /**
+   * 清空脚本摄像机的关键帧
+   */
+  static void clearCameraKeys();
+
+  /**
+   * 追加一个关键帧, 各关键帧在frameCount帧中均匀分布
+   */
+  static void addCameraKey(float ex, float ey, float ez, float tx, float ty, float tz);
+
+  /**
+   * 按第frame帧在关键帧之间线性插值并设置摄像机(没有关键帧时不改变摄像机)
+   */
+  static void applyCamera(int frame);
+
+  /**
+   * 开始计时前清空统计
+   */
+  static void reset();
+
+  /**
+   * 记录一帧的CPU耗时
+   */
+  static void recordCpu(double ms);
+
+  /**
+   * 记录一帧的GPU耗时
+   */
+  static void recordGpu(double ms);
+
+  /**
+   * 打印CPU、GPU耗时的平均值、中位数、95%分位数与最大值
+   */
+  static void logStats();
+
+  /**
+   * 把处于TRANSFER_SRC_OPTIMAL布局的离屏颜色图像复制到主机可见缓冲并保存为PPM文件
+   * 使用cmd录制复制命令并等待队列空闲(须在所有帧执行完毕之后调用), 返回是否成功
+   */
+  static bool saveImage(VkDevice &device, VkQueue &queue, VkCommandBuffer &cmd, VkImage image,
+                        const std::string &path);
+
+  /**
+   * 把RGBA8像素(每行rowPitch字节)编码为二进制PPM(P6), 丢弃Alpha分量
+   */
+  static void encodePPM(const unsigned char *rgba, uint32_t width, uint32_t height, size_t rowPitch,
+                        std::vector<unsigned char> &out);
+
+  /**
+   * 求values的p分位数(p为0~1, 最近秩法), values为空时返回0
+   */
+  static double percentile(std::vector<double> values, double p);
+
+ private:
+  static std::vector<MemoryAllocation> targetMemory; // 各离屏颜色图像对应的内存
+  static std::vector<CameraKey> cameraKeys;     // 脚本摄像机的关键帧
+};
+
+#endif //DEEPERVULKAN_HEADLESSRENDERER_H_
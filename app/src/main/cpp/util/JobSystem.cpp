@@ -0,0 +1,300 @@
+#include "JobSystem.h"
+#include <cassert>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include "../bndev/mylog.h"
+
+int JobSystem::workerCount = 1;
+std::atomic<long long> JobSystem::executedJobs(0);
+std::atomic<long long> JobSystem::stolenJobs(0);
+JobQueue *JobSystem::queues = nullptr;
+JobQueue JobSystem::mainQueue;
+std::vector<std::thread> JobSystem::workers;
+std::atomic<int> JobSystem::queuedJobs(0);
+std::atomic<int> JobSystem::sleepingWorkers(0);
+std::atomic<unsigned int> JobSystem::nextQueue(0);
+std::mutex JobSystem::sleepMutex;
+std::condition_variable JobSystem::wakeCondition;
+std::atomic<bool> JobSystem::stopping(false);
+bool JobSystem::initialized = false;
+thread_local int JobSystem::workerIndex = -1;
+
+void JobSystem::init(int threads) {
+  assert(!initialized);
+  if (threads <= 0) {
+    threads = std::max(1, (int) std::thread::hardware_concurrency());
+  }
+  workerCount = std::min(threads, JOB_SYSTEM_MAX_THREADS);
+  queues = new JobQueue[workerCount];
+  queuedJobs = 0;
+  sleepingWorkers = 0;
+  stopping = false;
+  workerIndex = 0;                                                        // 调用线程为主线程
+  initialized = true;
+  for (int i = 1; i < workerCount; i++) {
+    workers.push_back(std::thread(workerMain, i));
+  }
+  LOGI("JobSystem: %d worker threads", workerCount);
+}
+
+void JobSystem::shutdown() {
+  if (!initialized) {
+    return;
+  }
+  assert(isMainThread());
+  Job job;
+  while (take(job, true)) {                                               // 先执行完剩余的作业
+    execute(job);
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+  workers.clear();
+  delete[] queues;
+  queues = nullptr;
+  initialized = false;
+  workerIndex = -1;
+  workerCount = 1;
+}
+
+bool JobSystem::active() {
+  return initialized;
+}
+
+bool JobSystem::isMainThread() {
+  return !initialized || workerIndex == 0;
+}
+
+void JobSystem::run(JobFunc func, JobCounter *counter, JobCounter *dependency, bool mainThread) {
+  Job job;
+  job.func = func;
+  job.counter = counter;
+  job.mainThread = mainThread;
+  if (counter != nullptr) {
+    counter->value++;
+  }
+  if (dependency != nullptr) {
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (!dependency->done()) {                                            // 挂在依赖的计数器上, 归0时再调度
+      dependency->continuations.push_back(job);
+      return;
+    }
+  }
+  if (!initialized) {                                                     // 未初始化时直接执行
+    execute(job);
+  } else if (mainThread) {
+    std::lock_guard<std::mutex> lock(mainQueue.mutex);
+    mainQueue.jobs.push_back(job);
+  } else {
+    enqueue(job);
+  }
+}
+
+void JobSystem::wait(JobCounter *counter) {
+  if (counter == nullptr) {
+    return;
+  }
+  bool allowMainThread = isMainThread();
+  while (!counter->done()) {
+    Job job;
+    if (initialized && take(job, allowMainThread)) {                      // 等待期间执行其他作业
+      execute(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  std::lock_guard<std::mutex> lock(counter->mutex);                       // 等完成者释放计数器后再返回(之后计数器可被销毁)
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const JobRangeFunc &body) {
+  if (count == 0) {
+    return;
+  }
+  grain = std::max(1u, grain);
+  JobCounter counter;
+  JobRangeFunc split = [&](uint32_t begin, uint32_t end) {
+    while (end - begin > grain) {                                         // 后一半交给作业系统, 前一半继续二分
+      uint32_t mid = begin + (end - begin) / 2;
+      run([&split, mid, end] { split(mid, end); }, &counter);
+      end = mid;
+    }
+    body(begin, end);
+  };
+  split(0, count);
+  wait(&counter);
+}
+
+void JobSystem::runMainThreadJobs() {
+  assert(isMainThread());
+  while (true) {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(mainQueue.mutex);
+      if (mainQueue.jobs.empty()) {
+        return;
+      }
+      job = mainQueue.jobs.front();
+      mainQueue.jobs.pop_front();
+    }
+    execute(job);
+  }
+}
+
+void JobSystem::benchmark(int maxThreads) {
+  int originalCount = initialized ? workerCount : 0;
+  if (maxThreads <= 0) {
+    maxThreads = std::min(std::max(1, (int) std::thread::hardware_concurrency()), JOB_SYSTEM_MAX_THREADS);
+  }
+  std::vector<float> data(JOB_SYSTEM_BENCHMARK_ITEMS, 1.0f);
+  double singleMs = 0;
+  for (int threads = 1; threads <= maxThreads; threads++) {
+    shutdown();
+    init(threads);
+
+    JobCounter counter;                                                   // 空作业: 提交、窃取与完成的开销
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < JOB_SYSTEM_BENCHMARK_JOBS; i++) {
+      run([] {}, &counter);
+    }
+    wait(&counter);
+    double jobNs = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / JOB_SYSTEM_BENCHMARK_JOBS;
+
+    start = std::chrono::steady_clock::now();                             // 细粒度并行循环
+    for (int repeat = 0; repeat < 10; repeat++) {
+      parallelFor(JOB_SYSTEM_BENCHMARK_ITEMS, JOB_SYSTEM_BENCHMARK_GRAIN, [&data](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          data[i] = std::sqrt(data[i] * 0.5f + (float) (i & 255));
+        }
+      });
+    }
+    double loopMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / 10;
+    if (threads == 1) {
+      singleMs = loopMs;
+    }
+    LOGI("JobSystem benchmark: %d threads, %.0f ns per empty job, parallelFor %d items (grain %d) %.3f ms (x%.2f)",
+         threads, jobNs, JOB_SYSTEM_BENCHMARK_ITEMS, JOB_SYSTEM_BENCHMARK_GRAIN, loopMs, singleMs / loopMs);
+  }
+  shutdown();
+  if (originalCount > 0) {                                                // 恢复原来的线程数
+    init(originalCount);
+  }
+}
+
+void JobSystem::logStats() {
+  LOGI("JobSystem: %d threads, %lld jobs executed, %lld stolen",
+       workerCount, executedJobs.load(), stolenJobs.load());
+}
+
+void JobSystem::workerMain(int index) {
+  workerIndex = index;
+  int idleRounds = 0;
+  while (true) {
+    Job job;
+    if (take(job, false)) {
+      execute(job);
+      idleRounds = 0;
+      continue;
+    }
+    if (stopping) {                                                       // 队列已空且正在停止
+      return;
+    }
+    if (++idleRounds < JOB_SYSTEM_SPIN_ROUNDS) {                          // 短暂自旋, 连续提交的作业不必等待唤醒
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepingWorkers++;
+    wakeCondition.wait(lock, [] { return queuedJobs > 0 || stopping; });
+    sleepingWorkers--;
+    idleRounds = 0;
+  }
+}
+
+void JobSystem::enqueue(const Job &job) {
+  int index = workerIndex >= 0 ? workerIndex : (int) (nextQueue++ % workerCount);
+  {
+    std::lock_guard<std::mutex> lock(queues[index].mutex);
+    queues[index].jobs.push_back(job);
+  }
+  queuedJobs++;
+  if (sleepingWorkers > 0) {                                              // 持有休眠互斥量时通知, 不会丢失唤醒
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wakeCondition.notify_one();
+  }
+}
+
+bool JobSystem::take(Job &job, bool allowMainThread) {
+  int self = workerIndex;
+  if (self >= 0) {                                                        // 自己队列的尾部(最近压入的作业)
+    std::lock_guard<std::mutex> lock(queues[self].mutex);
+    if (!queues[self].jobs.empty()) {
+      job = queues[self].jobs.back();
+      queues[self].jobs.pop_back();
+      queuedJobs--;
+      return true;
+    }
+  }
+  if (allowMainThread && self == 0) {                                     // 只能在主线程中执行的作业
+    std::lock_guard<std::mutex> lock(mainQueue.mutex);
+    if (!mainQueue.jobs.empty()) {
+      job = mainQueue.jobs.front();
+      mainQueue.jobs.pop_front();
+      return true;
+    }
+  }
+  if (queuedJobs == 0) {
+    return false;
+  }
+  int first = self >= 0 ? self : 0;
+  for (int i = 1; i <= workerCount; i++) {                                // 从其他队列的头部窃取
+    int victim = (first + i) % workerCount;
+    if (victim == self) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(queues[victim].mutex);
+    if (!queues[victim].jobs.empty()) {
+      job = queues[victim].jobs.front();
+      queues[victim].jobs.pop_front();
+      queuedJobs--;
+      stolenJobs++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::execute(Job &job) {
+  job.func();
+  executedJobs++;
+  finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter *counter) {
+  if (counter == nullptr) {
+    return;
+  }
+  std::vector<Job> ready;
+  {
+    std::lock_guard<std::mutex> lock(counter->mutex);                     // 与挂起依赖作业的run互斥
+    if (--counter->value == 0) {
+      ready.swap(counter->continuations);
+    }
+  }
+  for (size_t i = 0; i < ready.size(); i++) {                             // 调度依赖这组作业的作业
+    if (!initialized) {
+      execute(ready[i]);
+    } else if (ready[i].mainThread) {
+      std::lock_guard<std::mutex> lock(mainQueue.mutex);
+      mainQueue.jobs.push_back(ready[i]);
+    } else {
+      enqueue(ready[i]);
+    }
+  }
+}
@@ -0,0 +1,171 @@
+#ifndef DEEPERVULKAN_JOBSYSTEM_H_
+#define DEEPERVULKAN_JOBSYSTEM_H_
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#define JOB_SYSTEM_MAX_THREADS 8                  // 工作线程数上限(含主线程)
+#define JOB_SYSTEM_SPIN_ROUNDS 64                 // 工作线程找不到作业时休眠前的自旋轮数
+#define JOB_SYSTEM_BENCHMARK_JOBS 100000          // 基准测试中空作业的数量
+#define JOB_SYSTEM_BENCHMARK_ITEMS (1 << 20)      // 基准测试中并行循环的元素数
+#define JOB_SYSTEM_BENCHMARK_GRAIN 256            // 基准测试中并行循环每段的元素数
+
+/**
+ * 作业函数
+ */
+typedef std::function<void()> JobFunc;
+
+/**
+ * 并行循环的循环体: 处理下标[begin, end)
+ */
+typedef std::function<void(uint32_t begin, uint32_t end)> JobRangeFunc;
+
+struct JobCounter;
+
+/**
+ * 一项作业
+ */
+struct Job {
+  JobFunc func;                             // 作业函数
+  JobCounter *counter;                      // 完成后减1的计数器(可为空)
+  bool mainThread;                          // 是否只能在主线程中执行
+};
+
+/**
+ * 作业计数器: 提交作业时加1, 作业完成时减1, 为0时表示这组作业全部完成
+ * 依赖这组作业的作业挂在计数器上, 计数器归0时才进入队列
+ * 计数器须在等待其归0之后才能销毁
+ */
+struct JobCounter {
+  std::atomic<int> value;                   // 未完成的作业数
+  std::mutex mutex;                         // 保护continuations
+  std::vector<Job> continuations;           // 等待计数器归0的作业
+
+  JobCounter() : value(0) {}
+
+  /**
+   * 这组作业是否全部完成
+   */
+  bool done() const { return value.load() == 0; }
+};
+
+/**
+ * 一个工作线程的作业队列: 所有者从尾部压入、取出(后进先出, 缓存友好), 其他线程从头部窃取(先进先出, 窃取较大的任务)
+ */
+struct JobQueue {
+  std::mutex mutex;                         // 保护jobs
+  std::deque<Job> jobs;                     // 作业
+};
+
+/**
+ * 工作窃取作业系统
+ * 调用init的线程(渲染线程)为0号工作线程, 另有若干常驻工作线程; 每个线程有自己的作业队列,
+ * 自己的队列为空时从其他线程的队列窃取; 作业以计数器表示完成与依赖关系
+ * 等待计数器的线程不会空等, 而是继续执行其他作业; 只能在主线程中执行的作业(如提交Vulkan队列)
+ * 放入单独的队列, 由主线程在等待时或每帧调用runMainThreadJobs时执行
+ * 未初始化时run直接在调用线程中执行作业, 便于在没有工作线程的环境中使用
+ */
+class JobSystem {
+ public:
+  static int workerCount;                               // 工作线程数(含主线程, 未初始化时为1)
+  static std::atomic<long long> executedJobs;           // 执行的作业数(统计用)
+  static std::atomic<long long> stolenJobs;             // 从其他线程窃取的作业数(统计用)
+
+  /**
+   * 以调用线程为主线程启动作业系统, threads为0时取CPU核数(不超过JOB_SYSTEM_MAX_THREADS)
+   */
+  static void init(int threads = 0);
+
+  /**
+   * 执行完所有作业后停止工作线程(须在主线程中调用)
+   */
+  static void shutdown();
+
+  /**
+   * 是否已初始化
+   */
+  static bool active();
+
+  /**
+   * 当前线程是否为主线程
+   */
+  static bool isMainThread();
+
+  /**
+   * 提交作业: counter不为空时加1并在作业完成时减1; dependency不为空且未归0时作业等其归0后才进入队列
+   * mainThread为true时作业只在主线程中执行
+   */
+  static void run(JobFunc func, JobCounter *counter = nullptr, JobCounter *dependency = nullptr,
+                  bool mainThread = false);
+
+  /**
+   * 等待计数器归0, 等待期间执行其他作业(主线程还会执行只能在主线程中执行的作业)
+   */
+  static void wait(JobCounter *counter);
+
+  /**
+   * 并行循环: 把[0, count)递归二分为不少于grain个元素的段分给各线程执行, 返回时全部完成
+   */
+  static void parallelFor(uint32_t count, uint32_t grain, const JobRangeFunc &body);
+
+  /**
+   * 执行所有只能在主线程中执行的作业(主线程每帧调用一次)
+   */
+  static void runMainThreadJobs();
+
+  /**
+   * 基准测试: 测量每个空作业的调度开销, 以及细粒度并行循环在1到maxThreads个线程下的耗时与加速比
+   * 会以不同线程数重新初始化作业系统, 须在没有其他作业时于主线程中调用, 结束后恢复原线程数
+   */
+  static void benchmark(int maxThreads = 0);
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  static JobQueue *queues;                              // 各工作线程的作业队列
+  static JobQueue mainQueue;                            // 只能在主线程中执行的作业
+  static std::vector<std::thread> workers;              // 常驻工作线程(1号到workerCount - 1号)
+  static std::atomic<int> queuedJobs;                   // 各工作线程队列中的作业总数
+  static std::atomic<int> sleepingWorkers;              // 正在休眠的工作线程数
+  static std::atomic<unsigned int> nextQueue;           // 非工作线程提交作业时轮流选择的队列
+  static std::mutex sleepMutex;                         // 休眠用的互斥量
+  static std::condition_variable wakeCondition;         // 唤醒休眠的工作线程
+  static std::atomic<bool> stopping;                    // 是否正在停止
+  static bool initialized;                              // 是否已初始化
+  static thread_local int workerIndex;                  // 当前线程的工作线程编号(-1为非工作线程)
+
+  /**
+   * 工作线程的主循环
+   */
+  static void workerMain(int index);
+
+  /**
+   * 把作业放入当前线程(非工作线程时轮流选择)的队列并唤醒休眠的线程
+   */
+  static void enqueue(const Job &job);
+
+  /**
+   * 取出一项作业: 先取自己队列的尾部, 主线程再取主线程队列, 最后从其他队列的头部窃取
+   */
+  static bool take(Job &job, bool allowMainThread);
+
+  /**
+   * 执行作业, 完成后计数器减1, 归0时把挂在计数器上的作业放入队列
+   */
+  static void execute(Job &job);
+
+  /**
+   * 计数器减1, 归0时调度挂在计数器上的作业
+   */
+  static void finish(JobCounter *counter);
+};
+
+#endif //DEEPERVULKAN_JOBSYSTEM_H_
@@ -7,6 +7,7 @@
 
 #include "FileUtil.h"
 #include "Normal.h"
+#include "JobSystem.h"
 
 using namespace std;
 
@@ -268,35 +269,36 @@ DrawableObjectCommon *LoadUtil::loadFromFile(
   float *vdataIn = new float[vCount * 6];                                 // Sample7_2
 //  int dataByteCount = vCount * 8 * sizeof(float);                         // Sample7_4
 //  float *vdataIn = new float[vCount * 8];                                 // Sample7_4
-  set<Normal *> setNTemp;                                                 // Sample7_3-存放一个顶点法向量集合的辅助变量
-  float *nTemp;                                                           // Sample7_3-指向存放向量三分量数据数组的指针
-  int indexTemp = 0;
-  for (int i = 0; i < vCount; i++) {
-    vdataIn[indexTemp++] = alvResult[i * 3];
-    vdataIn[indexTemp++] = alvResult[i * 3 + 1];
-    vdataIn[indexTemp++] = alvResult[i * 3 + 2];
+  int floatsPerVertex = vCount == 0 ? 0 : dataByteCount / vCount / (int) sizeof(float); // 每个顶点的数据个数
+  JobSystem::parallelFor((uint32_t) vCount, LOAD_UTIL_VERTEX_GRAIN, [&](uint32_t begin, uint32_t end) { // 各段互不重叠, 只读共享数据
+    for (int i = (int) begin; i < (int) end; i++) {
+      int indexTemp = i * floatsPerVertex;
+      vdataIn[indexTemp++] = alvResult[i * 3];
+      vdataIn[indexTemp++] = alvResult[i * 3 + 1];
+      vdataIn[indexTemp++] = alvResult[i * 3 + 2];
 
-    /// Sample7_4-将纹理ST坐标转存到顶点数据数组中
-//    vdataIn[indexTemp++] = altResult[i * 2];
-//    vdataIn[indexTemp++] = altResult[i * 2 + 1];
+      /// Sample7_4-将纹理ST坐标转存到顶点数据数组中
+//      vdataIn[indexTemp++] = altResult[i * 2];
+//      vdataIn[indexTemp++] = altResult[i * 2 + 1];
 
-    /// Sample7_2-计算面法向量
-//    vdataIn[indexTemp++] = alnResult[i * 3];
-//    vdataIn[indexTemp++] = alnResult[i * 3 + 1];
-//    vdataIn[indexTemp++] = alnResult[i * 3 + 2];
+      /// Sample7_2-计算面法向量
+//      vdataIn[indexTemp++] = alnResult[i * 3];
+//      vdataIn[indexTemp++] = alnResult[i * 3 + 1];
+//      vdataIn[indexTemp++] = alnResult[i * 3 + 2];
 
-    /// Sample7_3-计算平均法向量
-    setNTemp = (hmn[alFaceIndex.at(i)]);                                  // 获取当前顶点的法向量集合
-    nTemp = Normal::getAverage(setNTemp);                              // 求出此顶点的平均法向量
-    vdataIn[indexTemp++] = nTemp[0];                                      // 将平均法向量的三个分量转存到顶点数据数组中
-    vdataIn[indexTemp++] = nTemp[1];
-    vdataIn[indexTemp++] = nTemp[2];
+      /// Sample7_3-计算平均法向量
+      const set<Normal *> &setNTemp = hmn.at(alFaceIndex.at(i));          // 获取当前顶点的法向量集合(at不修改map, 可并行读取)
+      float *nTemp = Normal::getAverage(setNTemp);                     // 求出此顶点的平均法向量
+      vdataIn[indexTemp++] = nTemp[0];                                    // 将平均法向量的三个分量转存到顶点数据数组中
+      vdataIn[indexTemp++] = nTemp[1];
+      vdataIn[indexTemp++] = nTemp[2];
 
-    /// Sample7_5-直接读取法向量
-//    vdataIn[indexTemp++] = alnResult[i * 3];
-//    vdataIn[indexTemp++] = alnResult[i * 3 + 1];
-//    vdataIn[indexTemp++] = alnResult[i * 3 + 2];
-  }
+      /// Sample7_5-直接读取法向量
+//      vdataIn[indexTemp++] = alnResult[i * 3];
+//      vdataIn[indexTemp++] = alnResult[i * 3 + 1];
+//      vdataIn[indexTemp++] = alnResult[i * 3 + 2];
+    }
+  });
 
   lo = new DrawableObjectCommon(vdataIn, dataByteCount, vCount, device, memoryProperties);
   return lo;
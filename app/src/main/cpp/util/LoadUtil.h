@@ -4,6 +4,8 @@
 #include <string>
 #include "DrawableObjectCommon.h"
 
+#define LOAD_UTIL_VERTEX_GRAIN 4096               // 并行组装顶点数据时每段至少包含的顶点数
+
 class LoadUtil {
  public:
 
@@ -2,12 +2,12 @@
 #include <cmath>
 
 float MatrixState3D::vulkanClipMatrix[16];
-float MatrixState3D::currMatrix[16];
+thread_local float MatrixState3D::currMatrix[16];
 float MatrixState3D::mProjMatrix[16];
 float MatrixState3D::mVMatrix[16];
-float MatrixState3D::mMVPMatrix[16];
-float MatrixState3D::mStack[10][16];
-int MatrixState3D::stackTop = -1;
+thread_local float MatrixState3D::mMVPMatrix[16];
+thread_local float MatrixState3D::mStack[10][16];
+thread_local int MatrixState3D::stackTop = -1;
 float MatrixState3D::cx, MatrixState3D::cy, MatrixState3D::cz;
 
 /**
@@ -43,6 +43,16 @@ void MatrixState3D::setInitStack() {
   vulkanClipMatrix[15] = 1.0f;
 }
 
+/**
+ * 将当前线程的基本变换矩阵设置为m(不改变矩阵栈)
+ * 摄像机与投影矩阵为所有线程共用, 基本变换矩阵及其栈每个线程各有一份, 工作线程中的初值为零矩阵
+ */
+void MatrixState3D::loadMatrix(const float *m) {
+  for (int i = 0; i < 16; i++) {
+    currMatrix[i] = m[i];
+  }
+}
+
 /**
  * 保存基本变换矩阵入栈(保护现场)
  */
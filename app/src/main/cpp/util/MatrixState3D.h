@@ -5,16 +5,17 @@
 
 class MatrixState3D {
  public:
-  static float currMatrix[16];        // 当前基本变换矩阵
+  static thread_local float currMatrix[16]; // 当前基本变换矩阵(每个录制线程一份)
   static float mProjMatrix[16];       // 投影矩阵
   static float mVMatrix[16];          // 摄像机观察矩阵
-  static float mMVPMatrix[16];        // 总变换矩阵
+  static thread_local float mMVPMatrix[16]; // 总变换矩阵(每个录制线程一份)
   static float vulkanClipMatrix[16];  // Vulkan专用标准设备空间调整矩阵(剪裁空间矩阵 X不变 Y置反 Z减半)
-  static float mStack[10][16];        // 保存基本变换矩阵的栈
-  static int stackTop;                // 栈顶索引
+  static thread_local float mStack[10][16]; // 保存基本变换矩阵的栈(每个录制线程一份)
+  static thread_local int stackTop;   // 栈顶索引
   static float cx, cy, cz;            // 摄像机位置坐标
 
   static void setInitStack();                                 // 初始化基本变换矩阵的方法
+  static void loadMatrix(const float *m);                     // 将当前线程的基本变换矩阵设置为m(并行录制时工作线程以录制线程的矩阵为起点)
   static void pushMatrix();                                   // 保存基本变换矩阵入栈(保护现场)的方法
   static void popMatrix();                                    // 从栈恢复基本变换矩阵(恢复现场)的方法
   static void translate(float x, float y, float z);           // 沿x、y、z轴平移
@@ -0,0 +1,398 @@
+#include "MipmapGenerator.h"
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include "JobSystem.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIPMAP_USE_NEON
+#elif defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MIPMAP_USE_SSE
+#endif
+
+namespace {
+
+/// 一个RGBA浮点像素对应的SIMD向量 **************************************
+#if defined(MIPMAP_USE_NEON)
+typedef float32x4_t Vec4;
+inline Vec4 vLoad(const float *p) { return vld1q_f32(p); }
+inline void vStore(float *p, Vec4 v) { vst1q_f32(p, v); }
+inline Vec4 vZero() { return vdupq_n_f32(0.0f); }
+inline Vec4 vAdd(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 vScale(Vec4 a, float s) { return vmulq_n_f32(a, s); }
+inline Vec4 vMulAdd(Vec4 acc, Vec4 a, float s) { return vmlaq_n_f32(acc, a, s); }
+#elif defined(MIPMAP_USE_SSE)
+typedef __m128 Vec4;
+inline Vec4 vLoad(const float *p) { return _mm_loadu_ps(p); }
+inline void vStore(float *p, Vec4 v) { _mm_storeu_ps(p, v); }
+inline Vec4 vZero() { return _mm_setzero_ps(); }
+inline Vec4 vAdd(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 vScale(Vec4 a, float s) { return _mm_mul_ps(a, _mm_set1_ps(s)); }
+inline Vec4 vMulAdd(Vec4 acc, Vec4 a, float s) { return _mm_add_ps(acc, _mm_mul_ps(a, _mm_set1_ps(s))); }
+#else
+struct Vec4 { float v[4]; };
+inline Vec4 vLoad(const float *p) { Vec4 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void vStore(float *p, Vec4 v) { memcpy(p, v.v, sizeof(v.v)); }
+inline Vec4 vZero() { Vec4 r = {{0, 0, 0, 0}}; return r; }
+inline Vec4 vAdd(Vec4 a, Vec4 b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+inline Vec4 vScale(Vec4 a, float s) { for (int i = 0; i < 4; ++i) a.v[i] *= s; return a; }
+inline Vec4 vMulAdd(Vec4 acc, Vec4 a, float s) { for (int i = 0; i < 4; ++i) acc.v[i] += a.v[i] * s; return acc; }
+#endif
+
+const int LINEAR_TABLE_SIZE = 4096;         // 线性值转sRGB查找表的大小
+const int MIN_ROWS_PER_THREAD = 16;         // 每个线程至少处理的行数, 行数太少时不拆分
+const float FILTER_PI = 3.14159265358979f;
+const float KAISER_BETA = 4.0f;             // Kaiser窗的形状参数
+const float WINDOWED_RADIUS = 3.0f;         // Kaiser与Lanczos过滤器的半径(以目标像素计)
+
+/**
+ * sRGB与线性颜色值互相转换的查找表
+ */
+struct ColorTables {
+  float toLinear[256];
+  unsigned char toSrgb[LINEAR_TABLE_SIZE];
+
+  ColorTables() {
+    for (int i = 0; i < 256; ++i) {
+      float c = i / 255.0f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < LINEAR_TABLE_SIZE; ++i) {
+      float l = i / (float) (LINEAR_TABLE_SIZE - 1);
+      float s = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+      toSrgb[i] = (unsigned char) (s * 255.0f + 0.5f);
+    }
+  }
+};
+
+const ColorTables &colorTables() {
+  static ColorTables tables;                // C++11保证局部静态变量的初始化是线程安全的
+  return tables;
+}
+
+/**
+ * 将[0, rows)的行拆分给多个线程执行task(beginRow, endRow)
+ * 作业系统已启动时拆分为作业, 否则临时创建线程
+ */
+void parallelRows(int rows, int threadCount, const std::function<void(int, int)> &task) {
+  int workers = std::min(threadCount, std::max(1, rows / MIN_ROWS_PER_THREAD));
+  if (workers <= 1) {
+    task(0, rows);
+    return;
+  }
+  int chunk = (rows + workers - 1) / workers;
+  if (JobSystem::active()) {
+    JobSystem::parallelFor((uint32_t) rows, (uint32_t) chunk, [&task](uint32_t begin, uint32_t end) {
+      task((int) begin, (int) end);
+    });
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (int i = 1; i < workers; ++i) {
+    int begin = i * chunk;
+    int end = std::min(rows, begin + chunk);
+    if (begin < end) {
+      threads.push_back(std::thread(task, begin, end));
+    }
+  }
+  task(0, std::min(rows, chunk));                                         // 当前线程处理第一段
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+float sinc(float x) {
+  if (fabsf(x) < 1e-6f) {
+    return 1.0f;
+  }
+  x *= FILTER_PI;
+  return sinf(x) / x;
+}
+
+float besselI0(float x) {                  // 第一类零阶修正贝塞尔函数(级数展开)
+  float sum = 1.0f;
+  float term = 1.0f;
+  float half = x * 0.5f;
+  for (int k = 1; k < 20; ++k) {
+    term *= (half / k) * (half / k);
+    sum += term;
+  }
+  return sum;
+}
+
+float kernelWeight(MipmapFilter filter, float x) {
+  x = fabsf(x);
+  if (x >= WINDOWED_RADIUS) {
+    return 0.0f;
+  }
+  if (filter == MIPMAP_FILTER_LANCZOS) {
+    return sinc(x) * sinc(x / WINDOWED_RADIUS);
+  }
+  float t = x / WINDOWED_RADIUS;                                          // Kaiser窗sinc
+  return sinc(x) * besselI0(KAISER_BETA * sqrtf(1.0f - t * t)) / besselI0(KAISER_BETA);
+}
+
+/**
+ * 一维缩小时每个目标像素对应的源像素索引与权重
+ */
+struct FilterTaps {
+  int tapCount;                             // 每个目标像素的采样数
+  std::vector<int> index;                   // 源像素索引(已按边缘截取)
+  std::vector<float> weight;                // 归一化后的权重
+};
+
+void buildTaps(MipmapFilter filter, int srcSize, int dstSize, FilterTaps &taps) {
+  float scale = (float) srcSize / dstSize;
+  float support = (filter == MIPMAP_FILTER_BOX ? 0.5f : WINDOWED_RADIUS) * scale; // 源像素空间中的半径
+  taps.tapCount = (int) ceilf(support * 2.0f) + 1;
+  taps.index.assign((size_t) dstSize * taps.tapCount, 0);
+  taps.weight.assign((size_t) dstSize * taps.tapCount, 0.0f);
+  for (int i = 0; i < dstSize; ++i) {
+    float center = (i + 0.5f) * scale;                                    // 目标像素中心在源像素空间的位置
+    int first = (int) floorf(center - support);
+    float sum = 0.0f;
+    for (int t = 0; t < taps.tapCount; ++t) {
+      int j = first + t;
+      float w;
+      if (filter == MIPMAP_FILTER_BOX) {                                  // 盒式: 源像素与覆盖区间的重叠长度
+        w = std::max(0.0f, std::min(j + 1.0f, center + support) - std::max((float) j, center - support));
+      } else {
+        w = kernelWeight(filter, (j + 0.5f - center) / scale);
+      }
+      taps.index[i * taps.tapCount + t] = std::min(std::max(j, 0), srcSize - 1);
+      taps.weight[i * taps.tapCount + t] = w;
+      sum += w;
+    }
+    if (sum != 0.0f) {
+      for (int t = 0; t < taps.tapCount; ++t) {
+        taps.weight[i * taps.tapCount + t] /= sum;
+      }
+    }
+  }
+}
+
+/**
+ * 可分离过滤器缩小: 先水平后垂直
+ */
+void resample(const float *src, int srcW, int srcH, float *dst, int dstW, int dstH,
+              MipmapFilter filter, int threadCount) {
+  FilterTaps tapsX, tapsY;
+  buildTaps(filter, srcW, dstW, tapsX);
+  buildTaps(filter, srcH, dstH, tapsY);
+  std::vector<float> tmp((size_t) dstW * srcH * 4);
+  float *tmpData = tmp.data();
+
+  parallelRows(srcH, threadCount, [&](int beginRow, int endRow) {        // 水平方向
+    for (int y = beginRow; y < endRow; ++y) {
+      const float *row = src + (size_t) y * srcW * 4;
+      float *out = tmpData + (size_t) y * dstW * 4;
+      for (int x = 0; x < dstW; ++x) {
+        const int *idx = &tapsX.index[x * tapsX.tapCount];
+        const float *w = &tapsX.weight[x * tapsX.tapCount];
+        Vec4 acc = vZero();
+        for (int t = 0; t < tapsX.tapCount; ++t) {
+          if (w[t] != 0.0f) {
+            acc = vMulAdd(acc, vLoad(row + idx[t] * 4), w[t]);
+          }
+        }
+        vStore(out + x * 4, acc);
+      }
+    }
+  });
+
+  parallelRows(dstH, threadCount, [&](int beginRow, int endRow) {        // 垂直方向(按行累加, 访存连续)
+    for (int y = beginRow; y < endRow; ++y) {
+      float *out = dst + (size_t) y * dstW * 4;
+      const int *idx = &tapsY.index[y * tapsY.tapCount];
+      const float *w = &tapsY.weight[y * tapsY.tapCount];
+      for (int x = 0; x < dstW; ++x) {
+        vStore(out + x * 4, vZero());
+      }
+      for (int t = 0; t < tapsY.tapCount; ++t) {
+        if (w[t] == 0.0f) {
+          continue;
+        }
+        const float *row = tmpData + (size_t) idx[t] * dstW * 4;
+        for (int x = 0; x < dstW; ++x) {
+          vStore(out + x * 4, vMulAdd(vLoad(out + x * 4), vLoad(row + x * 4), w[t]));
+        }
+      }
+    }
+  });
+}
+
+/**
+ * 宽高均为偶数时的盒式过滤快速路径(2x2平均)
+ */
+void boxHalve(const float *src, int srcW, float *dst, int dstW, int dstH, int threadCount) {
+  parallelRows(dstH, threadCount, [&](int beginRow, int endRow) {
+    for (int y = beginRow; y < endRow; ++y) {
+      const float *row0 = src + (size_t) (2 * y) * srcW * 4;
+      const float *row1 = row0 + (size_t) srcW * 4;
+      float *out = dst + (size_t) y * dstW * 4;
+      for (int x = 0; x < dstW; ++x) {
+        Vec4 sum = vAdd(vAdd(vLoad(row0 + x * 8), vLoad(row0 + x * 8 + 4)),
+                        vAdd(vLoad(row1 + x * 8), vLoad(row1 + x * 8 + 4)));
+        vStore(out + x * 4, vScale(sum, 0.25f));
+      }
+    }
+  });
+}
+
+/**
+ * alpha乘以scale后大于阈值的像素比例
+ */
+float alphaCoverage(const float *pixels, int pixelCount, float cutoff, float scale) {
+  int covered = 0;
+  for (int i = 0; i < pixelCount; ++i) {
+    if (std::min(1.0f, pixels[i * 4 + 3] * scale) > cutoff) {
+      covered++;
+    }
+  }
+  return (float) covered / pixelCount;
+}
+
+/**
+ * 二分查找使本级alpha覆盖率与目标覆盖率一致的alpha缩放系数
+ */
+float findAlphaScale(const float *pixels, int pixelCount, float cutoff, float targetCoverage) {
+  float low = 0.0f;
+  float high = 4.0f;
+  for (int i = 0; i < 10; ++i) {
+    float mid = (low + high) * 0.5f;
+    if (alphaCoverage(pixels, pixelCount, cutoff, mid) < targetCoverage) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return (low + high) * 0.5f;
+}
+
+inline float clamp01(float v) {
+  return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+}  // namespace
+
+int MipmapGenerator::getLevelCount(int width, int height) {
+  int levels = 1;
+  int size = std::max(width, height);
+  while (size > 1) {
+    size >>= 1;
+    levels++;
+  }
+  return levels;
+}
+
+TexDataObject *MipmapGenerator::generate(TexDataObject *base, int levels, std::vector<int> &levelOffsets,
+                                         const MipmapOptions &options) {
+  int threadCount = options.threadCount;
+  if (threadCount <= 0) {
+    threadCount = std::max(1, (int) std::thread::hardware_concurrency());
+  }
+  levels = std::max(1, std::min(levels, getLevelCount(base->width, base->height)));
+
+  levelOffsets.clear();                                                   // 计算各级在结果中的偏移量
+  int totalBytes = 0;
+  for (int i = 0, w = base->width, h = base->height; i < levels; ++i) {
+    levelOffsets.push_back(totalBytes);
+    totalBytes += w * h * 4;
+    w = std::max(1, w >> 1);
+    h = std::max(1, h >> 1);
+  }
+  auto *data = new unsigned char[totalBytes];
+  memcpy(data, base->data, (size_t) base->width * base->height * 4);      // 第0级原样拷贝
+
+  const ColorTables &tables = colorTables();
+  int srcW = base->width;
+  int srcH = base->height;
+  std::vector<float> current((size_t) srcW * srcH * 4);
+  std::vector<float> next;
+  parallelRows(srcH, threadCount, [&](int beginRow, int endRow) {        // 解码为线性浮点数据
+    for (int i = beginRow * srcW; i < endRow * srcW; ++i) {
+      const unsigned char *p = base->data + (size_t) i * 4;
+      float *out = &current[(size_t) i * 4];
+      for (int c = 0; c < 3; ++c) {
+        out[c] = options.srgb ? tables.toLinear[p[c]] : p[c] / 255.0f;
+      }
+      out[3] = p[3] / 255.0f;                                             // alpha始终为线性值
+    }
+  });
+  float baseCoverage = 0.0f;
+  if (options.alphaCutoff > 0.0f) {
+    baseCoverage = alphaCoverage(current.data(), srcW * srcH, options.alphaCutoff, 1.0f);
+  }
+
+  for (int level = 1; level < levels; ++level) {
+    int dstW = std::max(1, srcW >> 1);
+    int dstH = std::max(1, srcH >> 1);
+    next.resize((size_t) dstW * dstH * 4);
+    if (options.filter == MIPMAP_FILTER_BOX && srcW == dstW * 2 && srcH == dstH * 2) {
+      boxHalve(current.data(), srcW, next.data(), dstW, dstH, threadCount);
+    } else {
+      resample(current.data(), srcW, srcH, next.data(), dstW, dstH, options.filter, threadCount);
+    }
+
+    float alphaScale = 1.0f;                                              // 只影响本级输出, 不影响后续级的生成
+    if (options.alphaCutoff > 0.0f) {
+      alphaScale = findAlphaScale(next.data(), dstW * dstH, options.alphaCutoff, baseCoverage);
+    }
+    unsigned char *levelData = data + levelOffsets[level];
+    const float *levelPixels = next.data();
+    parallelRows(dstH, threadCount, [&](int beginRow, int endRow) {      // 编码为RGBA8
+      for (int i = beginRow * dstW; i < endRow * dstW; ++i) {
+        const float *p = levelPixels + (size_t) i * 4;
+        unsigned char *out = levelData + (size_t) i * 4;
+        for (int c = 0; c < 3; ++c) {
+          float v = clamp01(p[c]);
+          out[c] = options.srgb ? tables.toSrgb[(int) (v * (LINEAR_TABLE_SIZE - 1) + 0.5f)]
+                                : (unsigned char) (v * 255.0f + 0.5f);
+        }
+        out[3] = (unsigned char) (clamp01(p[3] * alphaScale) * 255.0f + 0.5f);
+      }
+    });
+
+    current.swap(next);
+    srcW = dstW;
+    srcH = dstH;
+  }
+  return new TexDataObject(base->width, base->height, data, totalBytes);
+}
+
+double MipmapGenerator::benchmark(int width, int height, const MipmapOptions &options, int iterations,
+                                  long long &producedPixels) {
+  auto *pixels = new unsigned char[width * height * 4];                   // 合成测试纹理
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      unsigned char *p = pixels + ((size_t) y * width + x) * 4;
+      p[0] = (unsigned char) (x * 255 / width);
+      p[1] = (unsigned char) (y * 255 / height);
+      p[2] = (unsigned char) ((x ^ y) & 0xFF);
+      p[3] = (unsigned char) (((x / 8 + y / 8) & 1) ? 255 : 0);
+    }
+  }
+  TexDataObject base(width, height, pixels, width * height * 4);
+  int levels = getLevelCount(width, height);
+
+  producedPixels = 0;                                                     // 第0级之外各级的像素总数
+  for (int i = 1, w = width, h = height; i < levels; ++i) {
+    w = std::max(1, w >> 1);
+    h = std::max(1, h >> 1);
+    producedPixels += (long long) w * h;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    std::vector<int> levelOffsets;
+    TexDataObject *chain = generate(&base, levels, levelOffsets, options);
+    delete chain;
+  }
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+  return producedPixels * (double) iterations / seconds.count() / 1000000.0;
+}
@@ -0,0 +1,55 @@
+#ifndef DEEPERVULKAN_MIPMAPGENERATOR_H_
+#define DEEPERVULKAN_MIPMAPGENERATOR_H_
+
+#include <vector>
+#include "TexDataObject.h"
+
+/**
+ * mipmap缩小时使用的过滤器
+ */
+enum MipmapFilter {
+  MIPMAP_FILTER_BOX,      // 盒式过滤(2x2平均)
+  MIPMAP_FILTER_KAISER,   // Kaiser窗sinc过滤
+  MIPMAP_FILTER_LANCZOS   // Lanczos3过滤
+};
+
+/**
+ * mipmap生成选项
+ */
+struct MipmapOptions {
+  MipmapFilter filter;    // 过滤器
+  bool srgb;              // 颜色数据是否为sRGB编码(为true时在线性空间中平均)
+  float alphaCutoff;      // 镂空纹理的alpha测试阈值, 大于0时各级保持与第0级相同的alpha覆盖率
+  int threadCount;        // 工作线程数量, 0表示使用全部CPU核心
+
+  MipmapOptions() : filter(MIPMAP_FILTER_BOX), srgb(true), alphaCutoff(0.0f), threadCount(0) {}
+};
+
+/**
+ * CPU端mipmap生成器
+ * 不依赖Vulkan与Android, 既可在加载时使用, 也可在离线烘焙工具中使用
+ * 使用SSE/NEON按RGBA四通道并行计算, 并将每级的行分配到多个线程
+ */
+class MipmapGenerator {
+ public:
+  /**
+   * 计算完整mipmap链的级数
+   */
+  static int getLevelCount(int width, int height);
+
+  /**
+   * 根据第0级RGBA8纹理数据生成levels级mipmap链
+   * 返回的纹理数据对象中各级数据紧密排列, levelOffsets[i]为第i级的字节偏移量
+   */
+  static TexDataObject *generate(TexDataObject *base, int levels, std::vector<int> &levelOffsets,
+                                 const MipmapOptions &options);
+
+  /**
+   * 基准测试: 对width*height的合成纹理生成完整mipmap链iterations次
+   * 返回每秒产生的mipmap像素数(百万), producedPixels返回一次生成产生的像素数
+   */
+  static double benchmark(int width, int height, const MipmapOptions &options, int iterations,
+                          long long &producedPixels);
+};
+
+#endif //DEEPERVULKAN_MIPMAPGENERATOR_H_
@@ -0,0 +1,160 @@
+#include "ParallelRecorder.h"
+#include <cassert>
+#include <chrono>
+#include <algorithm>
+#include "MatrixState3D.h"
+#include "GeometryPool.h"
+#include "JobSystem.h"
+#include "../bndev/mylog.h"
+
+int ParallelRecorder::threadCount = 0;
+long long ParallelRecorder::recordedFrames = 0;
+long long ParallelRecorder::recordedItems = 0;
+long long ParallelRecorder::recordMicros = 0;
+VkDevice *ParallelRecorder::devicePointer = nullptr;
+std::vector<VkCommandPool> ParallelRecorder::pools;
+std::vector<VkCommandBuffer> ParallelRecorder::secondaries;
+const RecordTask *ParallelRecorder::currentTask = nullptr;
+uint32_t ParallelRecorder::currentItemCount = 0;
+int ParallelRecorder::currentThreads = 1;
+int ParallelRecorder::currentFrame = 0;
+VkCommandBufferInheritanceInfo ParallelRecorder::inheritance;
+float ParallelRecorder::baseMatrix[16];
+
+void ParallelRecorder::create(VkDevice &device, uint32_t queueFamilyIndex, int frameCount, int threads) {
+  assert(frameCount >= 1);
+  if (threads <= 0) {
+    threads = JobSystem::workerCount;
+  }
+  threadCount = std::min(threads, PARALLEL_RECORDER_MAX_CHUNKS);
+  devicePointer = &device;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.pNext = nullptr;
+  poolInfo.queueFamilyIndex = queueFamilyIndex;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;                  // 每帧整体重置, 不单独重置命令缓冲
+  pools.resize(frameCount * threadCount);
+  secondaries.resize(frameCount * threadCount);
+  for (size_t i = 0; i < pools.size(); i++) {
+    VkResult result = vk::vkCreateCommandPool(device, &poolInfo, nullptr, &pools[i]);
+    assert(result == VK_SUCCESS);
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.commandPool = pools[i];
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;                  // 二级命令缓冲
+    allocInfo.commandBufferCount = 1;
+    result = vk::vkAllocateCommandBuffers(device, &allocInfo, &secondaries[i]);
+    assert(result == VK_SUCCESS);
+  }
+  LOGI("ParallelRecorder: up to %d chunks, %d frame regions", threadCount, frameCount);
+}
+
+void ParallelRecorder::destroy(VkDevice &device) {
+  if (devicePointer == nullptr) {
+    return;
+  }
+  logStats();
+  for (size_t i = 0; i < pools.size(); i++) {
+    vk::vkDestroyCommandPool(device, pools[i], nullptr);                  // 同时释放其中的二级命令缓冲
+  }
+  pools.clear();
+  secondaries.clear();
+  devicePointer = nullptr;
+}
+
+bool ParallelRecorder::active() {
+  return devicePointer != nullptr;
+}
+
+void ParallelRecorder::record(VkCommandBuffer &primary, int frame, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                              uint32_t itemCount, const RecordTask &task, int threads) {
+  if (threads <= 0) {                                                     // 按物体数选择段数
+    threads = (int) std::max(1u, itemCount / PARALLEL_RECORDER_MIN_ITEMS);
+  }
+  threads = std::min(threads, threadCount);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  recordSecondaries(frame, renderPass, framebuffer, itemCount, task, threads);
+  vk::vkCmdExecuteCommands(primary, (uint32_t) threads, &secondaries[frame * threadCount]); // 按物体顺序执行各段
+  recordMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  recordedFrames++;
+  recordedItems += itemCount;
+}
+
+void ParallelRecorder::benchmark(VkRenderPass renderPass, VkFramebuffer framebuffer,
+                                 uint32_t itemCount, const RecordTask &task) {
+  double singleMs = 0;
+  for (int threads = 1; threads <= threadCount; threads++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < PARALLEL_RECORDER_BENCHMARK_FRAMES; i++) {
+      recordSecondaries(0, renderPass, framebuffer, itemCount, task, threads);
+    }
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+    double frameMs = ms.count() / PARALLEL_RECORDER_BENCHMARK_FRAMES;
+    if (threads == 1) {
+      singleMs = frameMs;
+    }
+    LOGI("ParallelRecorder benchmark: %u items, %d chunks, %.3f ms per frame (x%.2f)",
+         itemCount, threads, frameMs, singleMs / frameMs);
+  }
+}
+
+void ParallelRecorder::logStats() {
+  LOGI("ParallelRecorder: %lld frames, %lld items, %.3f ms average recording time",
+       recordedFrames, recordedItems, recordedFrames == 0 ? 0.0 : recordMicros / 1000.0 / recordedFrames);
+}
+
+void ParallelRecorder::recordChunk(int chunk) {
+  int index = currentFrame * threadCount + chunk;
+  VkResult result = vk::vkResetCommandPool(*devicePointer, pools[index], 0); // 回收上次在该帧区域录制的命令
+  assert(result == VK_SUCCESS);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.pNext = nullptr;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+      VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;                   // 整个二级命令缓冲都在渲染通道内
+  beginInfo.pInheritanceInfo = &inheritance;
+  result = vk::vkBeginCommandBuffer(secondaries[index], &beginInfo);
+  assert(result == VK_SUCCESS);
+
+  MatrixState3D::loadMatrix(baseMatrix);                                  // 以调用线程的当前矩阵为起点
+  GeometryPool::invalidateBinding();                                      // 新的命令缓冲需重新绑定共享缓冲
+  uint32_t begin = (uint32_t) ((unsigned long long) currentItemCount * chunk / currentThreads);
+  uint32_t end = (uint32_t) ((unsigned long long) currentItemCount * (chunk + 1) / currentThreads);
+  (*currentTask)(secondaries[index], begin, end);
+
+  result = vk::vkEndCommandBuffer(secondaries[index]);
+  assert(result == VK_SUCCESS);
+}
+
+void ParallelRecorder::recordSecondaries(int frame, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                                         uint32_t itemCount, const RecordTask &task, int threads) {
+  assert(devicePointer != nullptr && threads >= 1 && threads <= threadCount);
+  assert(frame >= 0 && (size_t) (frame + 1) * threadCount <= pools.size());
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.pNext = nullptr;
+  inheritance.renderPass = renderPass;
+  inheritance.subpass = 0;
+  inheritance.framebuffer = framebuffer;                                  // 指定帧缓冲可让驱动更好地优化
+  inheritance.occlusionQueryEnable = VK_FALSE;
+  inheritance.queryFlags = 0;
+  inheritance.pipelineStatistics = 0;
+  float *m = MatrixState3D::getMMatrix();
+  for (int i = 0; i < 16; i++) {
+    baseMatrix[i] = m[i];
+  }
+  currentTask = &task;                                                    // 提交作业之前写入, 作业队列的互斥量保证其可见
+  currentItemCount = itemCount;
+  currentThreads = threads;
+  currentFrame = frame;
+  JobCounter counter;
+  for (int chunk = 1; chunk < threads; chunk++) {
+    JobSystem::run([chunk] { recordChunk(chunk); }, &counter);
+  }
+  recordChunk(0);                                                         // 调用线程录制第一段
+  JobSystem::wait(&counter);                                              // 等待期间执行尚未被取走的段
+  MatrixState3D::loadMatrix(baseMatrix);                                  // 调用线程录制过的段不改变其当前矩阵
+}
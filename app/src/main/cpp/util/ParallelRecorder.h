@@ -0,0 +1,90 @@
+#ifndef DEEPERVULKAN_PARALLELRECORDER_H_
+#define DEEPERVULKAN_PARALLELRECORDER_H_
+
+#include <vector>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+#define PARALLEL_RECORDER_MAX_CHUNKS 8            // 每帧最多拆分的段数
+#define PARALLEL_RECORDER_MIN_ITEMS 256           // 每段至少包含的物体数(物体太少时作业调度的开销大于收益)
+#define PARALLEL_RECORDER_BENCHMARK_FRAMES 60     // 基准测试中每种段数录制的次数
+
+/**
+ * 录制一段物体的绘制命令: 在cmd中录制下标[begin, end)的物体(在工作线程中调用, 只能读取共享的场景数据)
+ */
+typedef std::function<void(VkCommandBuffer &cmd, uint32_t begin, uint32_t end)> RecordTask;
+
+/**
+ * 并行命令录制
+ * 可见物体列表按下标均分为若干段, 每段作为一项作业在作业系统中录制一个二级命令缓冲,
+ * 主命令缓冲再以vkCmdExecuteCommands依次执行(渲染通道须以VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS启动)
+ * 命令池不能同时被多个线程使用, 因此每个(帧区域, 段)各有一个命令池, 录制前整体重置, 不与在途帧冲突
+ * 调用线程自己录制第一段并在等待时执行其他段; 各线程的基本变换矩阵与几何缓冲池的绑定记录互相独立
+ */
+class ParallelRecorder {
+ public:
+  static int threadCount;                       // 每帧最多拆分的段数(默认与作业系统的线程数相同)
+  static long long recordedFrames;              // 并行录制的帧数(统计用)
+  static long long recordedItems;               // 录制的物体总数(统计用)
+  static long long recordMicros;                // 累计录制耗时(微秒, 统计用)
+
+  /**
+   * 为每个帧区域、每段创建命令池与二级命令缓冲(须在JobSystem::init之后调用)
+   * threads为0时取作业系统的线程数(不超过PARALLEL_RECORDER_MAX_CHUNKS)
+   */
+  static void create(VkDevice &device, uint32_t queueFamilyIndex, int frameCount, int threads = 0);
+
+  /**
+   * 销毁命令池(须在设备空闲之后调用)
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 是否已创建
+   */
+  static bool active();
+
+  /**
+   * 把itemCount个物体分段录制到frame帧区域的二级命令缓冲中, 再在主命令缓冲中执行它们
+   * 须在以SECONDARY_COMMAND_BUFFERS启动的渲染通道内调用; 各段的基本变换矩阵以调用线程的当前矩阵为起点, 返回后该矩阵不变
+   * threads为0时按物体数自动选择段数
+   */
+  static void record(VkCommandBuffer &primary, int frame, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                     uint32_t itemCount, const RecordTask &task, int threads = 0);
+
+  /**
+   * 分别拆分为1到threadCount段录制同一组物体并打印平均录制耗时(只录制二级命令缓冲, 不提交)
+   * 须在帧区域0不在途时调用(例如进入渲染循环之前)
+   */
+  static void benchmark(VkRenderPass renderPass, VkFramebuffer framebuffer, uint32_t itemCount, const RecordTask &task);
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  static VkDevice *devicePointer;               // 指向逻辑设备的指针
+  static std::vector<VkCommandPool> pools;      // 命令池(下标为帧区域 * threadCount + 段)
+  static std::vector<VkCommandBuffer> secondaries; // 二级命令缓冲(与命令池一一对应)
+  static const RecordTask *currentTask;         // 本次录制的任务
+  static uint32_t currentItemCount;             // 本次录制的物体数
+  static int currentThreads;                    // 本次录制的段数
+  static int currentFrame;                      // 本次录制的帧区域
+  static VkCommandBufferInheritanceInfo inheritance; // 二级命令缓冲继承的渲染通道与帧缓冲
+  static float baseMatrix[16];                  // 调用线程的基本变换矩阵(各段的起点)
+
+  /**
+   * 录制第chunk段物体到对应的二级命令缓冲(可在任意线程中执行)
+   */
+  static void recordChunk(int chunk);
+
+  /**
+   * 把第1段及之后的各段作为作业提交, 调用线程录制第一段后等待所有段完成
+   */
+  static void recordSecondaries(int frame, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                                uint32_t itemCount, const RecordTask &task, int threads);
+};
+
+#endif //DEEPERVULKAN_PARALLELRECORDER_H_
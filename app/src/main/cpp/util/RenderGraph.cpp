@@ -0,0 +1,633 @@
+#include "RenderGraph.h"
+#include <cassert>
+#include <algorithm>
+#include "../bndev/mylog.h"
+
+long long RenderGraph::transientBytes = 0;
+long long RenderGraph::unaliasedBytes = 0;
+int RenderGraph::lazyResources = 0;
+std::vector<RGResourceDesc> RenderGraph::resources;
+std::vector<RGPassDesc> RenderGraph::passes;
+std::vector<RGPass> RenderGraph::order;
+std::vector<RGMemorySlot> RenderGraph::slots;
+uint32_t RenderGraph::width = 0;
+uint32_t RenderGraph::height = 0;
+uint32_t RenderGraph::imageIndex = 0;
+bool RenderGraph::targetsCreated = false;
+
+/**
+ * 是否为深度模板附件
+ */
+static bool isDepthAspect(VkImageAspectFlags aspectMask) {
+  return (aspectMask & (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT)) != 0;
+}
+
+static const char *loadOpName(const RGAccess &access, bool load) {
+  return access.clear ? "CLEAR" : (load ? "LOAD" : "DONT_CARE");
+}
+
+RGResource RenderGraph::importImage(const std::string &name, VkFormat format, VkImageAspectFlags aspectMask,
+                                    VkPipelineStageFlags acquireStages, ResourceUsage finalUsage) {
+  RGResourceDesc desc;
+  desc.name = name;
+  desc.format = format;
+  desc.aspectMask = aspectMask;
+  desc.imported = true;
+  desc.acquireStages = acquireStages;
+  desc.finalUsage = finalUsage;
+  desc.firstPass = -1;
+  desc.lastPass = -1;
+  desc.transient = false;
+  desc.slot = -1;
+  desc.aliasPrev = -1;
+  desc.acquired = false;
+  resources.push_back(desc);
+  return (RGResource) resources.size() - 1;
+}
+
+RGResource RenderGraph::createImage(const std::string &name, VkFormat format, VkImageAspectFlags aspectMask) {
+  RGResource resource = importImage(name, format, aspectMask, 0, RESOURCE_USAGE_COUNT);
+  resources[resource].imported = false;
+  return resource;
+}
+
+RGPass RenderGraph::addPass(const std::string &name, RGRecordFunc record) {
+  RGPassDesc desc;
+  desc.name = name;
+  desc.record = record;
+  desc.culled = false;
+  desc.renderPass = VK_NULL_HANDLE;
+  passes.push_back(desc);
+  return (RGPass) passes.size() - 1;
+}
+
+void RenderGraph::writeColor(RGPass pass, RGResource resource, const VkClearColorValue *clear) {
+  RGAccess access = {};
+  access.resource = resource;
+  access.type = RG_ACCESS_COLOR;
+  access.clear = clear != nullptr;
+  if (clear != nullptr) {
+    access.clearValue.color = *clear;
+  }
+  passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::writeDepth(RGPass pass, RGResource resource, const VkClearDepthStencilValue *clear) {
+  RGAccess access = {};
+  access.resource = resource;
+  access.type = RG_ACCESS_DEPTH;
+  access.clear = clear != nullptr;
+  if (clear != nullptr) {
+    access.clearValue.depthStencil = *clear;
+  }
+  passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::sample(RGPass pass, RGResource resource) {
+  RGAccess access = {};
+  access.resource = resource;
+  access.type = RG_ACCESS_SAMPLED;
+  access.clear = false;
+  passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::sortPasses() {
+  size_t passCount = passes.size();
+  std::vector<std::vector<RGPass>> next(passCount);                       // 依赖于各通道的通道
+  std::vector<int> indegree(passCount, 0);                                // 各通道尚未执行的前驱数
+  for (RGResource r = 0; r < (RGResource) resources.size(); ++r) {
+    std::vector<RGPass> writers;                                          // 按声明顺序的写入者
+    std::vector<RGPass> readers;
+    for (RGPass p = 0; p < (RGPass) passCount; ++p) {
+      for (const RGAccess &access : passes[p].accesses) {
+        if (access.resource == r) {
+          (access.type == RG_ACCESS_SAMPLED ? readers : writers).push_back(p);
+        }
+      }
+    }
+    for (size_t i = 1; i < writers.size(); ++i) {                         // 写入者按声明顺序执行
+      assert(writers[i - 1] != writers[i]);                               // 一个通道只能写入同一资源一次
+      next[writers[i - 1]].push_back(writers[i]);
+      indegree[writers[i]]++;
+    }
+    for (RGPass reader : readers) {                                       // 读取者在所有写入者之后执行
+      if (writers.empty()) {
+        continue;
+      }
+      assert(std::find(writers.begin(), writers.end(), reader) == writers.end()); // 不能同时作为附件与采样
+      next[writers.back()].push_back(reader);
+      indegree[reader]++;
+    }
+  }
+
+  std::vector<RGPass> sorted;                                             // 拓扑排序, 可同时执行时取声明在前的通道
+  std::vector<bool> done(passCount, false);
+  while (sorted.size() < passCount) {
+    RGPass ready = -1;
+    for (RGPass p = 0; p < (RGPass) passCount && ready < 0; ++p) {
+      if (!done[p] && indegree[p] == 0) {
+        ready = p;
+      }
+    }
+    if (ready < 0) {
+      LOGE("RenderGraph: passes depend on each other in a cycle");
+      assert(false);
+      break;
+    }
+    done[ready] = true;
+    sorted.push_back(ready);
+    for (RGPass p : next[ready]) {
+      indegree[p]--;
+    }
+  }
+
+  // 从后往前剔除: 通道写入的内容被之后的通道使用, 或写入外部资源时才执行
+  std::vector<bool> contentNeeded(resources.size(), false);               // 之后执行的通道是否需要资源当前的内容
+  for (size_t r = 0; r < resources.size(); ++r) {
+    contentNeeded[r] = resources[r].imported;
+  }
+  std::vector<bool> live(passCount, false);
+  for (int i = (int) sorted.size() - 1; i >= 0; --i) {
+    RGPassDesc &pass = passes[sorted[i]];
+    for (const RGAccess &access : pass.accesses) {
+      if (access.type != RG_ACCESS_SAMPLED && contentNeeded[access.resource]) {
+        live[sorted[i]] = true;
+      }
+    }
+    if (!live[sorted[i]]) {
+      continue;
+    }
+    for (const RGAccess &access : pass.accesses) {
+      if (access.type == RG_ACCESS_SAMPLED || !access.clear) {            // 采样或载入之前的内容
+        contentNeeded[access.resource] = true;
+      } else {
+        contentNeeded[access.resource] = false;                           // 清除之后之前的内容不再需要
+      }
+    }
+  }
+  order.clear();
+  for (RGPass p : sorted) {
+    passes[p].culled = !live[p];
+    if (live[p]) {
+      order.push_back(p);
+    }
+  }
+}
+
+void RenderGraph::compile(VkDevice &device) {
+  sortPasses();
+  for (RGResourceDesc &resource : resources) {
+    resource.firstPass = -1;
+    resource.lastPass = -1;
+    resource.transient = !resource.imported;
+  }
+  for (int i = 0; i < (int) order.size(); ++i) {
+    for (const RGAccess &access : passes[order[i]].accesses) {
+      RGResourceDesc &resource = resources[access.resource];
+      if (resource.firstPass < 0) {
+        resource.firstPass = i;
+      }
+      resource.lastPass = i;
+      if (access.type == RG_ACCESS_SAMPLED) {
+        resource.transient = false;                                       // 采样的内容须写回内存
+      }
+    }
+  }
+
+  for (int i = 0; i < (int) order.size(); ++i) {
+    RGPassDesc &pass = passes[order[i]];
+    std::vector<const RGAccess *> attachmentAccesses;                     // 颜色附件在前, 深度附件在后
+    for (const RGAccess &access : pass.accesses) {
+      if (access.type == RG_ACCESS_COLOR) {
+        attachmentAccesses.push_back(&access);
+      }
+    }
+    uint32_t colorCount = (uint32_t) attachmentAccesses.size();
+    assert(colorCount <= RENDER_GRAPH_MAX_COLOR_ATTACHMENTS);
+    for (const RGAccess &access : pass.accesses) {
+      if (access.type == RG_ACCESS_DEPTH) {
+        assert(attachmentAccesses.size() == colorCount);                  // 只能有一个深度附件
+        attachmentAccesses.push_back(&access);
+      }
+    }
+
+    pass.attachments.clear();
+    pass.clearValues.clear();
+    pass.loads.clear();
+    pass.stores.clear();
+    std::vector<VkAttachmentDescription> descriptions;
+    for (const RGAccess *access : attachmentAccesses) {
+      RGResourceDesc &resource = resources[access->resource];
+      bool writtenBefore = false;                                         // 之前的通道是否写入过内容
+      for (int j = 0; j < i && !writtenBefore; ++j) {
+        for (const RGAccess &other : passes[order[j]].accesses) {
+          writtenBefore |= other.resource == access->resource && other.type != RG_ACCESS_SAMPLED;
+        }
+      }
+      bool persistent = resource.imported && resource.acquireStages == 0; // 内容跨帧保留的外部资源
+      bool load = !access->clear && (writtenBefore || persistent);
+      bool store = resource.imported;                                     // 外部资源的内容由finalUsage使用
+      for (int k = i + 1; k < (int) order.size() && !store; ++k) {
+        for (const RGAccess &other : passes[order[k]].accesses) {
+          store |= other.resource == access->resource && (other.type == RG_ACCESS_SAMPLED || !other.clear);
+        }
+      }
+      if (store) {
+        resource.transient = false;                                       // 内容须写回内存
+      }
+
+      bool depth = access->type == RG_ACCESS_DEPTH;
+      VkImageLayout layout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                   : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      VkAttachmentLoadOp loadOp = access->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                                : (load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+      VkAttachmentStoreOp storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      bool stencil = (resource.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+      VkAttachmentDescription description = {};
+      description.flags = 0;
+      description.format = resource.format;
+      description.samples = VK_SAMPLE_COUNT_1_BIT;
+      description.loadOp = loadOp;
+      description.storeOp = storeOp;
+      description.stencilLoadOp = stencil ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      description.stencilStoreOp = stencil ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      description.initialLayout = layout;                                 // 布局转换由通道之前的屏障完成
+      description.finalLayout = layout;                                   // 之后的用法由下一次使用时的屏障转换
+      descriptions.push_back(description);
+
+      pass.attachments.push_back(access->resource);
+      pass.clearValues.push_back(access->clearValue);
+      pass.loads.push_back(load);
+      pass.stores.push_back(store);
+    }
+
+    VkAttachmentReference colorReferences[RENDER_GRAPH_MAX_COLOR_ATTACHMENTS];
+    for (uint32_t c = 0; c < colorCount; ++c) {
+      colorReferences[c].attachment = c;
+      colorReferences[c].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+    VkAttachmentReference depthReference = {};
+    depthReference.attachment = colorCount;
+    depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.flags = 0;
+    subpass.inputAttachmentCount = 0;
+    subpass.pInputAttachments = nullptr;
+    subpass.colorAttachmentCount = colorCount;
+    subpass.pColorAttachments = colorCount > 0 ? colorReferences : nullptr;
+    subpass.pResolveAttachments = nullptr;
+    subpass.pDepthStencilAttachment = descriptions.size() > colorCount ? &depthReference : nullptr;
+    subpass.preserveAttachmentCount = 0;
+    subpass.pPreserveAttachments = nullptr;
+
+    VkRenderPassCreateInfo rp_info = {};
+    rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    rp_info.pNext = nullptr;
+    rp_info.attachmentCount = (uint32_t) descriptions.size();
+    rp_info.pAttachments = descriptions.data();
+    rp_info.subpassCount = 1;
+    rp_info.pSubpasses = &subpass;
+    rp_info.dependencyCount = 0;                                          // 与其他命令的同步由屏障完成
+    rp_info.pDependencies = nullptr;
+    VkResult result = vk::vkCreateRenderPass(device, &rp_info, nullptr, &pass.renderPass);
+    assert(result == VK_SUCCESS);
+  }
+}
+
+void RenderGraph::setImportedImages(RGResource resource, const std::vector<VkImage> &images,
+                                    const std::vector<VkImageView> &views) {
+  RGResourceDesc &desc = resources[resource];
+  assert(desc.imported && images.size() == views.size());
+  desc.images = images;
+  desc.views = views;
+  if (desc.acquireStages == 0) {                                          // 跨帧保持跟踪状态(每帧获取的图像在首次使用时登记)
+    for (VkImage image : images) {
+      ResourceStateTracker::registerImage(image, desc.aspectMask, 1, 1);
+    }
+  }
+}
+
+void RenderGraph::createTargets(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties,
+                                uint32_t width, uint32_t height) {
+  RenderGraph::width = width;
+  RenderGraph::height = height;
+
+  std::vector<RGResource> created;                                        // 由渲染图创建的附件, 按第一次使用的顺序
+  std::vector<VkMemoryRequirements> requirements(resources.size());
+  for (RGResource r = 0; r < (RGResource) resources.size(); ++r) {
+    RGResourceDesc &resource = resources[r];
+    if (resource.imported || resource.firstPass < 0) {
+      continue;
+    }
+    VkImageUsageFlags usage = resource.transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0;
+    for (RGPass p : order) {
+      for (const RGAccess &access : passes[p].accesses) {
+        if (access.resource != r) {
+          continue;
+        }
+        usage |= access.type == RG_ACCESS_COLOR ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                 : access.type == RG_ACCESS_DEPTH ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                 : VK_IMAGE_USAGE_SAMPLED_BIT;
+      }
+    }
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.pNext = nullptr;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = resource.format;
+    image_info.extent.width = width;
+    image_info.extent.height = height;
+    image_info.extent.depth = 1;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = usage;
+    image_info.queueFamilyIndexCount = 0;
+    image_info.pQueueFamilyIndices = nullptr;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.flags = 0;
+    VkImage image;
+    VkResult result = vk::vkCreateImage(device, &image_info, nullptr, &image);
+    assert(result == VK_SUCCESS);
+    resource.images.assign(1, image);
+    ResourceStateTracker::registerImage(image, resource.aspectMask, 1, 1);
+    vk::vkGetImageMemoryRequirements(device, image, &requirements[r]);
+    created.push_back(r);
+  }
+  std::stable_sort(created.begin(), created.end(), [](RGResource a, RGResource b) {
+    return resources[a].firstPass < resources[b].firstPass;
+  });
+
+  // 生命期不重叠、内存类型兼容的附件放入同一内存槽
+  transientBytes = 0;
+  unaliasedBytes = 0;
+  lazyResources = 0;
+  slots.clear();
+  for (RGResource r : created) {
+    RGResourceDesc &resource = resources[r];
+    const VkMemoryRequirements &req = requirements[r];
+    unaliasedBytes += req.size;
+    int found = -1;
+    for (int s = 0; s < (int) slots.size() && found < 0; ++s) {
+      if (slots[s].lastPass < resource.firstPass && slots[s].transient == resource.transient &&
+          (slots[s].requirements.memoryTypeBits & req.memoryTypeBits) != 0) {
+        found = s;
+      }
+    }
+    if (found < 0) {
+      RGMemorySlot slot;
+      slot.requirements = req;
+      slot.transient = resource.transient;
+      slots.push_back(slot);
+      found = (int) slots.size() - 1;
+    }
+    RGMemorySlot &slot = slots[found];
+    slot.requirements.size = std::max(slot.requirements.size, req.size);
+    slot.requirements.alignment = std::max(slot.requirements.alignment, req.alignment);
+    slot.requirements.memoryTypeBits &= req.memoryTypeBits;
+    slot.lastPass = resource.lastPass;
+    slot.resources.push_back(r);
+    resource.slot = found;
+  }
+
+  for (RGMemorySlot &slot : slots) {
+    const VkFlags lazyPreferences[2] = {                                  // 只作附件的图像优先使用惰性分配的内存
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+    const VkFlags *preferences = slot.transient ? lazyPreferences : lazyPreferences + 1;
+    bool flag = DeviceMemoryAllocator::allocate(
+        device, slot.requirements, preferences, slot.transient ? 2 : 1, true, slot.allocation);
+    assert(flag);
+    transientBytes += slot.requirements.size;
+    bool lazy = (memoryroperties.memoryTypes[slot.allocation.memoryTypeIndex].propertyFlags &
+        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+    for (size_t k = 0; k < slot.resources.size(); ++k) {
+      RGResourceDesc &resource = resources[slot.resources[k]];
+      VkResult result = vk::vkBindImageMemory(device, resource.images[0], slot.allocation.memory,
+                                              slot.allocation.offset);
+      assert(result == VK_SUCCESS);
+      VkImageViewCreateInfo view_info = {};
+      view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      view_info.pNext = nullptr;
+      view_info.image = resource.images[0];
+      view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      view_info.format = resource.format;
+      view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+      view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+      view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+      view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+      view_info.subresourceRange.aspectMask = resource.aspectMask;
+      view_info.subresourceRange.baseMipLevel = 0;
+      view_info.subresourceRange.levelCount = 1;
+      view_info.subresourceRange.baseArrayLayer = 0;
+      view_info.subresourceRange.layerCount = 1;
+      view_info.flags = 0;
+      VkImageView view;
+      result = vk::vkCreateImageView(device, &view_info, nullptr, &view);
+      assert(result == VK_SUCCESS);
+      resource.views.assign(1, view);
+      // 每帧第一次使用时等待上一个占用者(第一个占用者等待上一帧的最后一个占用者)
+      resource.aliasPrev = k > 0 ? slot.resources[k - 1]
+                                 : (slot.resources.size() > 1 ? slot.resources.back() : -1);
+      lazyResources += lazy ? 1 : 0;
+    }
+  }
+
+  size_t frameImages = 1;                                                 // 外部资源的帧图像数
+  for (const RGResourceDesc &resource : resources) {
+    if (resource.imported && resource.firstPass >= 0) {
+      assert(!resource.images.empty());
+      frameImages = std::max(frameImages, resource.images.size());
+    }
+  }
+  for (RGPass p : order) {
+    RGPassDesc &pass = passes[p];
+    pass.framebuffers.resize(frameImages);
+    for (size_t f = 0; f < frameImages; ++f) {
+      std::vector<VkImageView> views;
+      for (RGResource r : pass.attachments) {
+        views.push_back(resources[r].views[f % resources[r].views.size()]);
+      }
+      VkFramebufferCreateInfo fb_info = {};
+      fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+      fb_info.pNext = nullptr;
+      fb_info.renderPass = pass.renderPass;
+      fb_info.attachmentCount = (uint32_t) views.size();
+      fb_info.pAttachments = views.data();
+      fb_info.width = width;
+      fb_info.height = height;
+      fb_info.layers = 1;
+      VkResult result = vk::vkCreateFramebuffer(device, &fb_info, nullptr, &pass.framebuffers[f]);
+      assert(result == VK_SUCCESS);
+    }
+  }
+  targetsCreated = true;
+}
+
+void RenderGraph::destroyTargets(VkDevice &device) {
+  if (!targetsCreated) {                                                  // 窗口终止时已经销毁
+    return;
+  }
+  for (RGPassDesc &pass : passes) {
+    for (VkFramebuffer framebuffer : pass.framebuffers) {
+      vk::vkDestroyFramebuffer(device, framebuffer, nullptr);
+    }
+    pass.framebuffers.clear();
+  }
+  for (RGResourceDesc &resource : resources) {
+    for (VkImage image : resource.images) {
+      ResourceStateTracker::forgetImage(image);
+    }
+    if (!resource.imported) {                                             // 外部资源的图像由其所有者销毁
+      for (VkImageView view : resource.views) {
+        vk::vkDestroyImageView(device, view, nullptr);
+      }
+      for (VkImage image : resource.images) {
+        vk::vkDestroyImage(device, image, nullptr);
+      }
+    }
+    resource.images.clear();
+    resource.views.clear();
+    resource.slot = -1;
+    resource.aliasPrev = -1;
+  }
+  for (RGMemorySlot &slot : slots) {
+    DeviceMemoryAllocator::free(device, slot.allocation);
+  }
+  slots.clear();
+  targetsCreated = false;
+}
+
+void RenderGraph::beginFrame(uint32_t imageIndex) {
+  RenderGraph::imageIndex = imageIndex;
+  for (RGResourceDesc &resource : resources) {
+    resource.acquired = false;
+  }
+}
+
+VkImage RenderGraph::imageOf(RGResource resource) {
+  const RGResourceDesc &desc = resources[resource];
+  assert(!desc.images.empty());
+  return desc.images[imageIndex % desc.images.size()];
+}
+
+void RenderGraph::acquire(VkCommandBuffer &cmd, RGResource resource) {
+  RGResourceDesc &desc = resources[resource];
+  if (desc.acquired) {
+    return;
+  }
+  desc.acquired = true;
+  VkImage image = imageOf(resource);
+  if (desc.imported && desc.acquireStages != 0) {                         // 每帧获取的图像: 之后的屏障从获取的等待阶段开始
+    ResourceStateTracker::registerImage(image, desc.aspectMask, 1, 1);
+    ResourceAccess acquired = {desc.acquireStages, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+    ResourceStateTracker::useImage(cmd, image, acquired);
+  } else if (desc.aliasPrev >= 0) {                                       // 共用内存: 等待之前占用者的访问
+    ResourceStateTracker::aliasImage(image, imageOf(desc.aliasPrev));
+  }
+}
+
+void RenderGraph::execute(VkCommandBuffer &cmd) {
+  for (RGPass p : order) {
+    if (!passes[p].record) {                                              // 由调用者自行录制
+      continue;
+    }
+    beginPass(cmd, p, VK_SUBPASS_CONTENTS_INLINE);
+    passes[p].record(cmd);
+    endPass(cmd, p);
+  }
+}
+
+void RenderGraph::beginPass(VkCommandBuffer &cmd, RGPass pass, VkSubpassContents contents) {
+  RGPassDesc &desc = passes[pass];
+  assert(!desc.culled && targetsCreated);
+  for (const RGAccess &access : desc.accesses) {
+    acquire(cmd, access.resource);
+  }
+  for (size_t i = 0; i < desc.attachments.size(); ++i) {
+    RGResourceDesc &resource = resources[desc.attachments[i]];
+    VkImage image = imageOf(desc.attachments[i]);
+    if (!desc.loads[i]) {
+      ResourceStateTracker::discardImage(image);                          // 不载入的内容无需保留, 从UNDEFINED转换
+    }
+    ResourceStateTracker::useImage(cmd, image, isDepthAspect(resource.aspectMask) ?
+        RESOURCE_USAGE_DEPTH_ATTACHMENT_WRITE : RESOURCE_USAGE_COLOR_ATTACHMENT_WRITE);
+  }
+  for (const RGAccess &access : desc.accesses) {
+    if (access.type == RG_ACCESS_SAMPLED) {
+      ResourceStateTracker::useImage(cmd, imageOf(access.resource), RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED);
+    }
+  }
+  ResourceStateTracker::flush(cmd);                                       // 本通道所需的屏障合并为一次调用
+
+  VkRenderPassBeginInfo rp_begin = {};
+  rp_begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  rp_begin.pNext = nullptr;
+  rp_begin.renderPass = desc.renderPass;
+  rp_begin.framebuffer = framebufferOf(pass);
+  rp_begin.renderArea.offset.x = 0;
+  rp_begin.renderArea.offset.y = 0;
+  rp_begin.renderArea.extent.width = width;
+  rp_begin.renderArea.extent.height = height;
+  rp_begin.clearValueCount = (uint32_t) desc.clearValues.size();
+  rp_begin.pClearValues = desc.clearValues.data();
+  vk::vkCmdBeginRenderPass(cmd, &rp_begin, contents);
+}
+
+void RenderGraph::endPass(VkCommandBuffer &cmd, RGPass pass) {
+  vk::vkCmdEndRenderPass(cmd);
+  int position = (int) (std::find(order.begin(), order.end(), pass) - order.begin());
+  for (const RGAccess &access : passes[pass].accesses) {
+    const RGResourceDesc &resource = resources[access.resource];
+    if (resource.imported && resource.lastPass == position) {             // 外部资源转为之后的用法(呈现、读回等)
+      ResourceStateTracker::useImage(cmd, imageOf(access.resource), resource.finalUsage);
+    }
+  }
+  ResourceStateTracker::flush(cmd);
+}
+
+VkRenderPass RenderGraph::renderPassOf(RGPass pass) {
+  return passes[pass].renderPass;
+}
+
+VkFramebuffer RenderGraph::framebufferOf(RGPass pass) {
+  const RGPassDesc &desc = passes[pass];
+  assert(!desc.framebuffers.empty());
+  return desc.framebuffers[imageIndex % desc.framebuffers.size()];
+}
+
+void RenderGraph::destroy(VkDevice &device) {
+  destroyTargets(device);
+  for (RGPassDesc &pass : passes) {
+    if (pass.renderPass != VK_NULL_HANDLE) {
+      vk::vkDestroyRenderPass(device, pass.renderPass, nullptr);
+    }
+  }
+  resources.clear();
+  passes.clear();
+  order.clear();
+}
+
+void RenderGraph::logStats() {
+  LOGI("RenderGraph: %d passes, %d culled", (int) order.size(), (int) (passes.size() - order.size()));
+  for (RGPass p : order) {
+    const RGPassDesc &pass = passes[p];
+    for (size_t i = 0; i < pass.attachments.size(); ++i) {
+      const RGAccess *access = nullptr;
+      for (const RGAccess &a : pass.accesses) {
+        if (a.resource == pass.attachments[i]) {
+          access = &a;
+        }
+      }
+      const RGResourceDesc &resource = resources[pass.attachments[i]];
+      LOGI("  %s: %s load %s, store %s%s", pass.name.c_str(), resource.name.c_str(), loadOpName(*access, pass.loads[i]),
+           pass.stores[i] ? "STORE" : "DONT_CARE", resource.transient ? " (transient)" : "");
+    }
+  }
+  LOGI("RenderGraph: transient attachments use %lld bytes (%lld without aliasing), %d lazily allocated",
+       transientBytes, unaliasedBytes, lazyResources);
+}
@@ -0,0 +1,226 @@
+#ifndef DEEPERVULKAN_RENDERGRAPH_H_
+#define DEEPERVULKAN_RENDERGRAPH_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
+#include "ResourceStateTracker.h"
+
+#define RENDER_GRAPH_MAX_COLOR_ATTACHMENTS 4        // 一个通道的颜色附件数上限
+
+typedef int RGResource;                             // 渲染图中的图像资源编号
+typedef int RGPass;                                 // 渲染图中的通道编号
+
+/**
+ * 通道录制函数(在渲染通道实例之内调用)
+ */
+typedef std::function<void(VkCommandBuffer &cmd)> RGRecordFunc;
+
+/**
+ * 通道访问资源的方式
+ */
+enum RGAccessType {
+  RG_ACCESS_COLOR,                          // 颜色附件
+  RG_ACCESS_DEPTH,                          // 深度模板附件
+  RG_ACCESS_SAMPLED                         // 片元着色器中采样
+};
+
+/**
+ * 通道对一个资源的访问
+ */
+struct RGAccess {
+  RGResource resource;                      // 资源编号
+  RGAccessType type;                        // 访问方式
+  bool clear;                               // 附件开始时是否清除
+  VkClearValue clearValue;                  // 清除值
+};
+
+/**
+ * 渲染图中的图像资源: 外部资源(交换链图像等)或由渲染图创建的瞬时附件
+ */
+struct RGResourceDesc {
+  std::string name;                         // 名称(打印统计用)
+  VkFormat format;                          // 像素格式
+  VkImageAspectFlags aspectMask;            // 图像方面
+  bool imported;                            // 是否为外部资源
+  VkPipelineStageFlags acquireStages;       // 外部资源每帧开始时内容无效并等待的阶段(交换链图像获取信号量的等待阶段), 0为跨帧保持跟踪状态
+  ResourceUsage finalUsage;                 // 外部资源在最后一个通道之后的用法
+  std::vector<VkImage> images;              // 图像(外部资源按帧图像索引各一幅, 瞬时附件一幅)
+  std::vector<VkImageView> views;           // 对应的图像视图
+  int firstPass;                            // 第一个使用它的通道在执行顺序中的位置(-1为未使用)
+  int lastPass;                             // 最后一个使用它的通道在执行顺序中的位置
+  bool transient;                           // 内容从不需要写回内存(只作附件且不保存), 可使用惰性分配的内存
+  int slot;                                 // 所在的内存槽(-1为外部资源或未使用)
+  RGResource aliasPrev;                     // 同一内存槽中之前使用这段内存的资源(-1为独占内存槽)
+  bool acquired;                            // 本帧是否已开始使用
+};
+
+/**
+ * 渲染图中的通道: 一个只有一个子通道的渲染通道
+ */
+struct RGPassDesc {
+  std::string name;                         // 名称(打印统计用)
+  RGRecordFunc record;                      // 录制函数(为空时由调用者以beginPass、endPass自行录制)
+  std::vector<RGAccess> accesses;           // 声明的资源访问
+  bool culled;                              // 输出没有被使用, 不执行
+  VkRenderPass renderPass;                  // 编译出的渲染通道
+  std::vector<RGResource> attachments;      // 帧缓冲附件(颜色附件在前, 深度附件在后)
+  std::vector<VkClearValue> clearValues;    // 各附件的清除值
+  std::vector<bool> loads;                  // 各附件是否载入之前的内容(否则开始前丢弃内容)
+  std::vector<bool> stores;                 // 各附件是否写回内容
+  std::vector<VkFramebuffer> framebuffers;  // 按帧图像索引的帧缓冲
+};
+
+/**
+ * 共用一段内存的瞬时附件(生命期不重叠)
+ */
+struct RGMemorySlot {
+  VkMemoryRequirements requirements;        // 合并后的内存需求
+  bool transient;                           // 是否存放只作附件的瞬时附件(可惰性分配)
+  int lastPass;                             // 最后一个占用者的最后使用位置
+  std::vector<RGResource> resources;        // 按使用顺序的占用者
+  MemoryAllocation allocation;              // 分配的内存
+};
+
+/**
+ * 渲染图
+ * 各通道声明读写的附件与采样的图像, 编译时推导:
+ * 执行顺序(同一资源的写入者按声明顺序, 读取者在所有写入者之后), 输出未被使用的通道被剔除;
+ * 附件的LOAD/CLEAR/DONT_CARE与STORE/DONT_CARE(之前没有写入的内容不载入, 之后没有读取且不是外部资源的内容不写回);
+ * 瞬时附件的内存: 只作附件且从不写回的图像使用TRANSIENT_ATTACHMENT用途与惰性分配的内存(设备支持时),
+ * 生命期不重叠的瞬时附件共用同一段内存(别名)
+ * 通道之间的屏障与布局转换由ResourceStateTracker按实际访问推导, 外部资源在最后一个通道之后转为finalUsage
+ * 使用方式: 声明资源与通道, compile创建渲染通道(与尺寸无关), setImportedImages设置外部资源的图像, createTargets按尺寸创建
+ * 瞬时附件与帧缓冲(尺寸变化时destroyTargets后重新创建); 每帧beginFrame选择外部资源的图像, 然后execute按顺序录制各通道,
+ * 或以beginPass、endPass自行录制
+ * 只在渲染线程中使用
+ */
+class RenderGraph {
+ public:
+  static long long transientBytes;          // 瞬时附件实际占用的内存字节数(统计用)
+  static long long unaliasedBytes;          // 瞬时附件不共用内存时需要的字节数(统计用)
+  static int lazyResources;                 // 使用惰性分配内存的瞬时附件数(统计用)
+
+  /**
+   * 声明外部资源, acquireStages与finalUsage见RGResourceDesc
+   */
+  static RGResource importImage(const std::string &name, VkFormat format, VkImageAspectFlags aspectMask,
+                                VkPipelineStageFlags acquireStages, ResourceUsage finalUsage);
+
+  /**
+   * 声明由渲染图创建的附件(尺寸与渲染图相同)
+   */
+  static RGResource createImage(const std::string &name, VkFormat format, VkImageAspectFlags aspectMask);
+
+  /**
+   * 声明通道, record为空时由调用者自行录制
+   */
+  static RGPass addPass(const std::string &name, RGRecordFunc record = RGRecordFunc());
+
+  /**
+   * 通道写入颜色附件, clear不为空时开始时清除为该值(否则保留之前的内容)
+   */
+  static void writeColor(RGPass pass, RGResource resource, const VkClearColorValue *clear = nullptr);
+
+  /**
+   * 通道写入深度模板附件, clear不为空时开始时清除为该值
+   */
+  static void writeDepth(RGPass pass, RGResource resource, const VkClearDepthStencilValue *clear = nullptr);
+
+  /**
+   * 通道在片元着色器中采样资源
+   */
+  static void sample(RGPass pass, RGResource resource);
+
+  /**
+   * 推导执行顺序与附件操作, 为各通道创建渲染通道, 须在声明所有资源与通道之后调用
+   */
+  static void compile(VkDevice &device);
+
+  /**
+   * 设置外部资源各帧的图像与图像视图(在createTargets之前调用)
+   */
+  static void setImportedImages(RGResource resource, const std::vector<VkImage> &images,
+                                const std::vector<VkImageView> &views);
+
+  /**
+   * 按尺寸创建瞬时附件(生命期不重叠的共用内存)与各通道的帧缓冲
+   */
+  static void createTargets(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties,
+                            uint32_t width, uint32_t height);
+
+  /**
+   * 销毁瞬时附件与帧缓冲(没有创建时不做任何事)
+   */
+  static void destroyTargets(VkDevice &device);
+
+  /**
+   * 开始一帧, imageIndex选择外部资源本帧使用的图像(交换链图像索引)
+   */
+  static void beginFrame(uint32_t imageIndex);
+
+  /**
+   * 按执行顺序录制所有有录制函数的通道
+   */
+  static void execute(VkCommandBuffer &cmd);
+
+  /**
+   * 加入通道所需的屏障并启动其渲染通道实例
+   */
+  static void beginPass(VkCommandBuffer &cmd, RGPass pass, VkSubpassContents contents);
+
+  /**
+   * 结束渲染通道实例, 最后使用外部资源的通道之后把外部资源转为finalUsage
+   */
+  static void endPass(VkCommandBuffer &cmd, RGPass pass);
+
+  /**
+   * 通道编译出的渲染通道(创建管线、二级命令缓冲的继承信息使用)
+   */
+  static VkRenderPass renderPassOf(RGPass pass);
+
+  /**
+   * 通道本帧使用的帧缓冲
+   */
+  static VkFramebuffer framebufferOf(RGPass pass);
+
+  /**
+   * 销毁渲染通道与所有目标, 清空声明
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 打印执行顺序、各附件的载入与写回操作以及瞬时附件的内存统计
+   */
+  static void logStats();
+
+ private:
+  static std::vector<RGResourceDesc> resources;   // 声明的资源
+  static std::vector<RGPassDesc> passes;          // 声明的通道
+  static std::vector<RGPass> order;               // 执行顺序(不含被剔除的通道)
+  static std::vector<RGMemorySlot> slots;         // 瞬时附件的内存槽
+  static uint32_t width;                          // 目标宽度
+  static uint32_t height;                         // 目标高度
+  static uint32_t imageIndex;                     // 本帧外部资源的图像索引
+  static bool targetsCreated;                     // 是否已创建目标
+
+  /**
+   * 推导执行顺序并剔除输出未被使用的通道
+   */
+  static void sortPasses();
+
+  /**
+   * 资源本帧使用的图像
+   */
+  static VkImage imageOf(RGResource resource);
+
+  /**
+   * 资源本帧第一次使用: 外部资源重新开始跟踪, 共用内存的附件等待之前占用者的访问
+   */
+  static void acquire(VkCommandBuffer &cmd, RGResource resource);
+};
+
+#endif //DEEPERVULKAN_RENDERGRAPH_H_
@@ -0,0 +1,56 @@
+#include "ResourceRegistry.h"
+#include <cassert>
+
+std::vector<std::string> ResourceRegistry::names;
+std::vector<VkImage> ResourceRegistry::images;
+std::vector<MemoryAllocation> ResourceRegistry::memories;
+std::vector<VkImageView> ResourceRegistry::views;
+std::vector<VkDescriptorImageInfo> ResourceRegistry::imageInfos;
+std::vector<int> ResourceRegistry::descSetIndices;
+std::vector<int> ResourceRegistry::movableIds;
+std::unordered_map<std::string, ResHandle> ResourceRegistry::handleOfName;
+
+ResHandle ResourceRegistry::intern(const std::string &name) {
+  std::unordered_map<std::string, ResHandle>::iterator it = handleOfName.find(name);
+  if (it != handleOfName.end()) {                                         // 已驻留
+    return it->second;
+  }
+  ResHandle handle = (ResHandle) names.size();                            // 新句柄为各数组的下一个下标
+  handleOfName[name] = handle;
+  names.push_back(name);
+  images.push_back(VK_NULL_HANDLE);
+  MemoryAllocation emptyMemory = {};
+  emptyMemory.block = -1;                                                 // 空分配, 释放时不做任何事
+  memories.push_back(emptyMemory);
+  views.push_back(VK_NULL_HANDLE);
+  VkDescriptorImageInfo emptyInfo = {};
+  imageInfos.push_back(emptyInfo);
+  descSetIndices.push_back(-1);
+  movableIds.push_back(-1);
+  return handle;
+}
+
+ResHandle ResourceRegistry::find(const std::string &name) {
+  std::unordered_map<std::string, ResHandle>::iterator it = handleOfName.find(name);
+  return it == handleOfName.end() ? RES_HANDLE_INVALID : it->second;
+}
+
+bool ResourceRegistry::loaded(ResHandle handle) {
+  assert(handle < names.size());
+  return images[handle] != VK_NULL_HANDLE;
+}
+
+void ResourceRegistry::release(ResHandle handle) {
+  assert(handle < names.size());
+  images[handle] = VK_NULL_HANDLE;
+  memories[handle].memory = VK_NULL_HANDLE;                               // 分配已由调用者释放
+  memories[handle].block = -1;
+  views[handle] = VK_NULL_HANDLE;
+  VkDescriptorImageInfo emptyInfo = {};
+  imageInfos[handle] = emptyInfo;                                         // 描述集索引保持不变, 重新加载后仍可使用
+  movableIds[handle] = -1;                                                // 登记已由调用者取消
+}
+
+uint32_t ResourceRegistry::size() {
+  return (uint32_t) names.size();
+}
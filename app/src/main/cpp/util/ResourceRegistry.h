@@ -0,0 +1,63 @@
+#ifndef DEEPERVULKAN_RESOURCEREGISTRY_H_
+#define DEEPERVULKAN_RESOURCEREGISTRY_H_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+#include "DeviceMemoryAllocator.h"
+
+typedef uint32_t ResHandle;                     // 资源句柄(纹理名称驻留后得到的稠密下标)
+#define RES_HANDLE_INVALID 0xFFFFFFFFu          // 无效句柄
+
+/**
+ * 在调用处只驻留一次名称, 之后每次执行只读取局部静态变量(用于绘制代码中以字面量指定的纹理)
+ */
+#define RES_HANDLE(name) ([]() -> ResHandle { static const ResHandle handle = ResourceRegistry::intern(name); return handle; }())
+
+/**
+ * 纹理资源注册表
+ * 加载时将纹理名称驻留为稠密的整数句柄, 各项资源数据按句柄存放在连续的数组中(SoA)
+ * 帧内访问一律通过句柄下标完成, 不做字符串哈希或比较; 名称只在加载时与日志中使用
+ * 句柄在进程内保持稳定: 销毁资源只清空对应槽位, 名称不会被移除
+ */
+class ResourceRegistry {
+ public:
+  static std::vector<std::string> names;                  // 句柄对应的名称
+  static std::vector<VkImage> images;                     // 句柄对应的纹理图像
+  static std::vector<MemoryAllocation> memories;          // 句柄对应的纹理图像内存(从子分配器分配)
+  static std::vector<VkImageView> views;                  // 句柄对应的纹理图像视图
+  static std::vector<VkDescriptorImageInfo> imageInfos;   // 句柄对应的纹理图像描述信息
+  static std::vector<int> descSetIndices;                 // 句柄对应的描述集索引(-1为未分配)
+  static std::vector<int> movableIds;                     // 句柄对应的内存整理登记号(-1为不可移动)
+
+  /**
+   * 驻留名称并返回句柄, 名称已驻留时返回原句柄(仅在加载时调用)
+   */
+  static ResHandle intern(const std::string &name);
+
+  /**
+   * 查找已驻留名称的句柄, 未驻留时返回RES_HANDLE_INVALID(仅在加载时调用)
+   */
+  static ResHandle find(const std::string &name);
+
+  /**
+   * 句柄对应的资源是否已创建
+   */
+  static bool loaded(ResHandle handle);
+
+  /**
+   * 清空句柄对应的资源槽位(资源本身由调用者销毁)
+   */
+  static void release(ResHandle handle);
+
+  /**
+   * 已驻留名称的数量
+   */
+  static uint32_t size();
+
+ private:
+  static std::unordered_map<std::string, ResHandle> handleOfName;  // 名称对应的句柄
+};
+
+#endif //DEEPERVULKAN_RESOURCEREGISTRY_H_
@@ -0,0 +1,353 @@
+#include "ResourceStateTracker.h"
+#include <cassert>
+#include "../bndev/mylog.h"
+
+#define RESOURCE_WRITE_ACCESS (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |              \
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |     \
+    VK_ACCESS_MEMORY_WRITE_BIT)                                           // 属于写入的访问类型
+
+long long ResourceStateTracker::barrierCalls = 0;
+long long ResourceStateTracker::imageBarriers = 0;
+long long ResourceStateTracker::bufferBarriers = 0;
+long long ResourceStateTracker::skippedUses = 0;
+std::map<VkImage, TrackedImage> ResourceStateTracker::images;
+std::map<VkBuffer, ResourceState> ResourceStateTracker::buffers;
+std::map<VkCommandBuffer, PendingBarriers> ResourceStateTracker::pending;
+unsigned long long ResourceStateTracker::nextBatch = 1;
+
+/**
+ * 新资源的状态: 没有需要等待的访问, 内容无需保留
+ */
+static ResourceState initialState(VkImageLayout layout) {
+  ResourceState state;
+  state.writeStages = 0;
+  state.writeAccess = 0;
+  state.readStages = 0;
+  state.visibleStages = 0;
+  state.visibleAccess = 0;
+  state.layout = layout;
+  state.queueFamily = VK_QUEUE_FAMILY_IGNORED;
+  state.pendingBatch = 0;
+  return state;
+}
+
+ResourceAccess ResourceStateTracker::accessOf(ResourceUsage usage) {
+  static const ResourceAccess table[RESOURCE_USAGE_COUNT] = {
+      {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL},
+      {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL},
+      {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+       VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+       VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+      {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+       VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL},
+      {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR}, // 呈现引擎的访问由信号量同步
+      {VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL},
+      {VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL},
+      {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED},
+      {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED},
+      {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED},
+  };
+  assert(usage >= 0 && usage < RESOURCE_USAGE_COUNT);
+  return table[usage];
+}
+
+void ResourceStateTracker::registerImage(VkImage image, VkImageAspectFlags aspectMask, uint32_t levelCount,
+                                         uint32_t layerCount, VkImageLayout layout) {
+  TrackedImage &tracked = images[image];
+  tracked.aspectMask = aspectMask;
+  tracked.levelCount = levelCount;
+  tracked.layerCount = layerCount;
+  tracked.states.assign((size_t) levelCount * layerCount, initialState(layout));
+}
+
+void ResourceStateTracker::registerBuffer(VkBuffer buffer) {
+  buffers[buffer] = initialState(VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
+void ResourceStateTracker::forgetImage(VkImage image) {
+  images.erase(image);
+}
+
+void ResourceStateTracker::forgetBuffer(VkBuffer buffer) {
+  buffers.erase(buffer);
+}
+
+void ResourceStateTracker::discardImage(VkImage image, uint32_t baseLevel, uint32_t levelCount) {
+  auto it = images.find(image);
+  if (it == images.end()) {
+    return;
+  }
+  TrackedImage &tracked = it->second;
+  if (levelCount == VK_REMAINING_MIP_LEVELS) {
+    levelCount = tracked.levelCount - baseLevel;
+  }
+  for (uint32_t level = baseLevel; level < baseLevel + levelCount; ++level) {
+    for (uint32_t layer = 0; layer < tracked.layerCount; ++layer) {
+      tracked.states[level * tracked.layerCount + layer].layout = VK_IMAGE_LAYOUT_UNDEFINED; // 仍等待之前的访问
+    }
+  }
+}
+
+void ResourceStateTracker::aliasImage(VkImage image, VkImage previous) {
+  auto it = images.find(image);
+  auto prev = images.find(previous);
+  if (it == images.end() || prev == images.end()) {
+    return;
+  }
+  ResourceState merged = initialState(VK_IMAGE_LAYOUT_UNDEFINED);        // previous所有子资源的访问合并到一起
+  for (const ResourceState &state : prev->second.states) {
+    merged.writeStages |= state.writeStages;
+    merged.writeAccess |= state.writeAccess;
+    merged.readStages |= state.readStages;
+  }
+  it->second.states.assign(it->second.states.size(), merged);             // 不可见的写入在下一次写入时一并等待
+}
+
+bool ResourceStateTracker::transition(ResourceState &state, const ResourceAccess &access, uint32_t queueFamily,
+                                      bool isImage, VkPipelineStageFlags &srcStages, VkAccessFlags &srcAccess,
+                                      VkImageLayout &oldLayout, uint32_t &srcQueueFamily) {
+  bool isWrite = (access.access & RESOURCE_WRITE_ACCESS) != 0;
+  bool layoutChange = isImage && state.layout != access.layout;
+  bool queueChange = queueFamily != VK_QUEUE_FAMILY_IGNORED && state.queueFamily != VK_QUEUE_FAMILY_IGNORED &&
+      queueFamily != state.queueFamily;
+  oldLayout = state.layout;
+  srcQueueFamily = queueChange ? state.queueFamily : VK_QUEUE_FAMILY_IGNORED;
+  if (queueFamily != VK_QUEUE_FAMILY_IGNORED) {
+    state.queueFamily = queueFamily;
+  }
+
+  if (!isWrite && !layoutChange && !queueChange) {                        // 读取: 只需让最近一次写入对本次访问可见
+    bool visible = (access.stages & ~state.visibleStages) == 0 && (access.access & ~state.visibleAccess) == 0;
+    state.readStages |= access.stages;
+    if (state.writeStages == 0 || visible) {                              // 没有写入, 或写入已对这些阶段可见
+      return false;
+    }
+    srcStages = state.writeStages;
+    srcAccess = state.writeAccess;
+    state.visibleStages |= access.stages;
+    state.visibleAccess |= access.access;
+    return true;
+  }
+
+  // 写入或布局、队列家族转换: 等待最近一次写入及其后的所有读取
+  if (state.visibleStages != 0) {                                         // 写入已由之前的屏障使其可用, 只需等待其后的读取
+    srcStages = state.readStages;
+    srcAccess = 0;
+  } else {
+    srcStages = state.writeStages | state.readStages;
+    srcAccess = state.writeAccess;                                        // 读取不需要使其可用, 读后写只需执行依赖
+  }
+  bool needed = layoutChange || queueChange || srcStages != 0;
+  if (srcStages == 0) {
+    srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;                        // 没有需要等待的访问(仅布局转换)
+  }
+  state.layout = isImage ? access.layout : state.layout;
+  state.writeStages = access.stages;                                      // 布局转换也是写入, 在目标阶段之前完成
+  state.writeAccess = isWrite ? access.access : 0;
+  state.readStages = isWrite ? 0 : access.stages;
+  state.visibleStages = isWrite ? 0 : access.stages;
+  state.visibleAccess = isWrite ? 0 : access.access;
+  return needed;
+}
+
+PendingBarriers &ResourceStateTracker::batchOf(VkCommandBuffer cmd) {
+  auto it = pending.find(cmd);
+  if (it == pending.end()) {
+    PendingBarriers batch;
+    batch.srcStages = 0;
+    batch.dstStages = 0;
+    batch.batch = nextBatch++;
+    it = pending.insert(std::make_pair(cmd, batch)).first;
+  }
+  return it->second;
+}
+
+void ResourceStateTracker::useImage(VkCommandBuffer cmd, VkImage image, const ResourceAccess &access,
+                                    uint32_t baseLevel, uint32_t levelCount, uint32_t baseLayer,
+                                    uint32_t layerCount, uint32_t queueFamily) {
+  auto it = images.find(image);
+  if (it == images.end()) {
+    LOGE("ResourceStateTracker: image is not registered");
+    assert(false);
+    return;
+  }
+  TrackedImage &tracked = it->second;
+  if (levelCount == VK_REMAINING_MIP_LEVELS) {
+    levelCount = tracked.levelCount - baseLevel;
+  }
+  if (layerCount == VK_REMAINING_ARRAY_LAYERS) {
+    layerCount = tracked.layerCount - baseLayer;
+  }
+  assert(baseLevel + levelCount <= tracked.levelCount && baseLayer + layerCount <= tracked.layerCount);
+
+  VkPipelineStageFlags srcStages;
+  VkAccessFlags srcAccess;
+  VkImageLayout oldLayout;
+  uint32_t srcQueueFamily;
+  // 同一次vkCmdPipelineBarrier中的屏障之间没有先后顺序: 本批次已转换过的子资源再次需要屏障时先发出本批次
+  unsigned long long current = batchOf(cmd).batch;
+  bool conflict = false;
+  for (uint32_t level = baseLevel; level < baseLevel + levelCount && !conflict; ++level) {
+    for (uint32_t layer = baseLayer; layer < baseLayer + layerCount && !conflict; ++layer) {
+      const ResourceState &state = tracked.states[level * tracked.layerCount + layer];
+      ResourceState trial = state;
+      conflict = state.pendingBatch == current &&
+          transition(trial, access, queueFamily, true, srcStages, srcAccess, oldLayout, srcQueueFamily);
+    }
+  }
+  if (conflict) {
+    flush(cmd);
+  }
+
+  PendingBarriers &batch = batchOf(cmd);
+  size_t firstBarrier = batch.imageBarriers.size();                       // 本次加入的第一个屏障(只与本次的屏障合并)
+  size_t prevLevelBarrier = firstBarrier;                                 // 上一级别加入的第一个屏障
+  for (uint32_t level = baseLevel; level < baseLevel + levelCount; ++level) {
+    size_t levelBarrier = batch.imageBarriers.size();                     // 本级别加入的第一个屏障
+    for (uint32_t layer = baseLayer; layer < baseLayer + layerCount; ++layer) {
+      ResourceState &state = tracked.states[level * tracked.layerCount + layer];
+      if (!transition(state, access, queueFamily, true, srcStages, srcAccess, oldLayout, srcQueueFamily)) {
+        continue;
+      }
+      state.pendingBatch = batch.batch;
+      batch.srcStages |= srcStages;
+      batch.dstStages |= access.stages;
+      if (batch.imageBarriers.size() > levelBarrier) {                    // 与本级别上一层的屏障相同时合并
+        VkImageMemoryBarrier &last = batch.imageBarriers.back();
+        VkImageSubresourceRange &range = last.subresourceRange;
+        if (last.srcAccessMask == srcAccess && last.oldLayout == oldLayout &&
+            last.srcQueueFamilyIndex == srcQueueFamily && range.baseArrayLayer + range.layerCount == layer) {
+          range.layerCount++;
+          continue;
+        }
+      }
+      VkImageMemoryBarrier barrier = {};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.pNext = nullptr;
+      barrier.srcAccessMask = srcAccess;
+      barrier.dstAccessMask = access.access;
+      barrier.oldLayout = oldLayout;
+      barrier.newLayout = access.layout;
+      barrier.srcQueueFamilyIndex = srcQueueFamily;
+      barrier.dstQueueFamilyIndex = srcQueueFamily == VK_QUEUE_FAMILY_IGNORED ? VK_QUEUE_FAMILY_IGNORED : queueFamily;
+      barrier.image = image;
+      barrier.subresourceRange.aspectMask = tracked.aspectMask;
+      barrier.subresourceRange.baseMipLevel = level;
+      barrier.subresourceRange.levelCount = 1;
+      barrier.subresourceRange.baseArrayLayer = layer;
+      barrier.subresourceRange.layerCount = 1;
+      batch.imageBarriers.push_back(barrier);
+    }
+    // 本级别与上一级别都只有一个屏障且层范围、源状态相同时合并为跨级别的屏障
+    if (batch.imageBarriers.size() == levelBarrier + 1 && levelBarrier == prevLevelBarrier + 1 &&
+        levelBarrier > firstBarrier) {
+      VkImageMemoryBarrier &prev = batch.imageBarriers[prevLevelBarrier];
+      const VkImageMemoryBarrier &cur = batch.imageBarriers[levelBarrier];
+      if (prev.srcAccessMask == cur.srcAccessMask && prev.oldLayout == cur.oldLayout &&
+          prev.srcQueueFamilyIndex == cur.srcQueueFamilyIndex &&
+          prev.subresourceRange.baseArrayLayer == cur.subresourceRange.baseArrayLayer &&
+          prev.subresourceRange.layerCount == cur.subresourceRange.layerCount &&
+          prev.subresourceRange.baseMipLevel + prev.subresourceRange.levelCount == level) {
+        prev.subresourceRange.levelCount++;
+        batch.imageBarriers.pop_back();
+        continue;                                                         // 上一级别的屏障仍是最后一个
+      }
+    }
+    prevLevelBarrier = levelBarrier;
+  }
+  if (batch.imageBarriers.size() == firstBarrier) {
+    skippedUses++;
+  }
+}
+
+void ResourceStateTracker::useImage(VkCommandBuffer cmd, VkImage image, ResourceUsage usage, uint32_t baseLevel,
+                                    uint32_t levelCount, uint32_t baseLayer, uint32_t layerCount) {
+  useImage(cmd, image, accessOf(usage), baseLevel, levelCount, baseLayer, layerCount);
+}
+
+void ResourceStateTracker::useBuffer(VkCommandBuffer cmd, VkBuffer buffer, const ResourceAccess &access,
+                                     uint32_t queueFamily) {
+  auto it = buffers.find(buffer);
+  if (it == buffers.end()) {
+    LOGE("ResourceStateTracker: buffer is not registered");
+    assert(false);
+    return;
+  }
+  ResourceState &state = it->second;
+  VkPipelineStageFlags srcStages;
+  VkAccessFlags srcAccess;
+  VkImageLayout oldLayout;
+  uint32_t srcQueueFamily;
+  ResourceState trial = state;
+  if (state.pendingBatch == batchOf(cmd).batch &&
+      transition(trial, access, queueFamily, false, srcStages, srcAccess, oldLayout, srcQueueFamily)) {
+    flush(cmd);                                                           // 本批次已有该缓冲的屏障
+  }
+  PendingBarriers &batch = batchOf(cmd);
+  if (!transition(state, access, queueFamily, false, srcStages, srcAccess, oldLayout, srcQueueFamily)) {
+    skippedUses++;
+    return;
+  }
+  state.pendingBatch = batch.batch;
+  batch.srcStages |= srcStages;
+  batch.dstStages |= access.stages;
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.pNext = nullptr;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = access.access;
+  barrier.srcQueueFamilyIndex = srcQueueFamily;
+  barrier.dstQueueFamilyIndex = srcQueueFamily == VK_QUEUE_FAMILY_IGNORED ? VK_QUEUE_FAMILY_IGNORED : queueFamily;
+  barrier.buffer = buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  batch.bufferBarriers.push_back(barrier);
+}
+
+void ResourceStateTracker::useBuffer(VkCommandBuffer cmd, VkBuffer buffer, ResourceUsage usage) {
+  useBuffer(cmd, buffer, accessOf(usage));
+}
+
+void ResourceStateTracker::flush(VkCommandBuffer cmd) {
+  auto it = pending.find(cmd);
+  if (it == pending.end()) {
+    return;
+  }
+  PendingBarriers &batch = it->second;
+  if (!batch.imageBarriers.empty() || !batch.bufferBarriers.empty()) {
+    vk::vkCmdPipelineBarrier(cmd, batch.srcStages, batch.dstStages, 0, 0, nullptr,
+                             (uint32_t) batch.bufferBarriers.size(), batch.bufferBarriers.data(),
+                             (uint32_t) batch.imageBarriers.size(), batch.imageBarriers.data());
+    barrierCalls++;
+    imageBarriers += batch.imageBarriers.size();
+    bufferBarriers += batch.bufferBarriers.size();
+  }
+  pending.erase(it);                                                      // 下一次使用时开始新的批次
+}
+
+void ResourceStateTracker::reset() {
+  images.clear();
+  buffers.clear();
+  pending.clear();
+}
+
+const ResourceState *ResourceStateTracker::imageState(VkImage image, uint32_t level, uint32_t layer) {
+  auto it = images.find(image);
+  if (it == images.end() || level >= it->second.levelCount || layer >= it->second.layerCount) {
+    return nullptr;
+  }
+  return &it->second.states[level * it->second.layerCount + layer];
+}
+
+const ResourceState *ResourceStateTracker::bufferState(VkBuffer buffer) {
+  auto it = buffers.find(buffer);
+  return it == buffers.end() ? nullptr : &it->second;
+}
+
+void ResourceStateTracker::logStats() {
+  LOGI("ResourceStateTracker: %lld barrier calls, %lld image barriers, %lld buffer barriers, %lld uses without barrier",
+       barrierCalls, imageBarriers, bufferBarriers, skippedUses);
+}
@@ -0,0 +1,183 @@
+#ifndef DEEPERVULKAN_RESOURCESTATETRACKER_H_
+#define DEEPERVULKAN_RESOURCESTATETRACKER_H_
+
+#include <map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+/**
+ * 资源的一种用法, 决定访问它的管线阶段、访问类型与(图像的)布局
+ */
+enum ResourceUsage {
+  RESOURCE_USAGE_TRANSFER_READ,             // 拷贝、blit的源
+  RESOURCE_USAGE_TRANSFER_WRITE,            // 拷贝、blit的目标
+  RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED,   // 片元着色器中采样(或读取一致变量、存储缓冲)
+  RESOURCE_USAGE_VERTEX_SHADER_READ,        // 顶点着色器中读取
+  RESOURCE_USAGE_COLOR_ATTACHMENT_WRITE,    // 颜色附件
+  RESOURCE_USAGE_DEPTH_ATTACHMENT_WRITE,    // 深度模板附件
+  RESOURCE_USAGE_PRESENT,                   // 呈现
+  RESOURCE_USAGE_HOST_READ,                 // 主机读取(读回)
+  RESOURCE_USAGE_HOST_WRITE,                // 主机写入
+  RESOURCE_USAGE_VERTEX_BUFFER,             // 顶点缓冲
+  RESOURCE_USAGE_INDEX_BUFFER,              // 索引缓冲
+  RESOURCE_USAGE_INDIRECT_BUFFER,           // 间接绘制参数
+  RESOURCE_USAGE_COUNT
+};
+
+/**
+ * 一次访问: 管线阶段、访问类型、布局(缓冲忽略)与队列家族
+ */
+struct ResourceAccess {
+  VkPipelineStageFlags stages;              // 访问所在的管线阶段
+  VkAccessFlags access;                     // 访问类型
+  VkImageLayout layout;                     // 图像须处于的布局
+};
+
+/**
+ * 一个资源(缓冲或图像的一个子资源)的最后访问状态
+ */
+struct ResourceState {
+  VkPipelineStageFlags writeStages;         // 最近一次写入(含布局转换)的阶段, 0为没有需要等待的写入
+  VkAccessFlags writeAccess;                // 最近一次写入的访问类型
+  VkPipelineStageFlags readStages;          // 最近一次写入之后读取过的阶段(下一次写入须等待)
+  VkPipelineStageFlags visibleStages;       // 最近一次写入已对其可见的阶段
+  VkAccessFlags visibleAccess;              // 最近一次写入已对其可见的访问类型
+  VkImageLayout layout;                     // 当前布局
+  uint32_t queueFamily;                     // 当前所属的队列家族(VK_QUEUE_FAMILY_IGNORED为未指定)
+  unsigned long long pendingBatch;          // 最后一次加入的屏障批次(批次未发出前同一资源不能再加入)
+};
+
+/**
+ * 一个命令缓冲中尚未发出的屏障
+ */
+struct PendingBarriers {
+  VkPipelineStageFlags srcStages;           // 合并后的源阶段
+  VkPipelineStageFlags dstStages;           // 合并后的目标阶段
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+  unsigned long long batch;                 // 批次序号
+};
+
+/**
+ * 被跟踪的图像: 各子资源(mip级别 * 数组层)的状态
+ */
+struct TrackedImage {
+  VkImageAspectFlags aspectMask;            // 屏障使用的方面
+  uint32_t levelCount;                      // mip级别数
+  uint32_t layerCount;                      // 数组层数
+  std::vector<ResourceState> states;        // 下标为level * layerCount + layer
+};
+
+/**
+ * 资源状态跟踪
+ * 记录每个缓冲与图像子资源最后一次访问的阶段、访问类型、布局与队列家族, 资源以新的方式使用时推导所需的屏障:
+ * 写后读只让写入对新的阶段可见(已可见时不加屏障), 读后写只等待读取过的阶段, 布局或队列家族变化时转换;
+ * 源阶段、目标阶段都取实际访问的阶段, 不再一律使用TOP_OF_PIPE
+ * 推导出的屏障按命令缓冲累积, 调用flush时合并为一次vkCmdPipelineBarrier(状态相同的相邻子资源合并为一个图像屏障)
+ * 使用方式: 对下一条命令访问的所有资源调用use, 然后flush, 再录制该命令; 状态按录制顺序推进, 各命令缓冲须按录制顺序提交
+ * 只在渲染线程中使用
+ */
+class ResourceStateTracker {
+ public:
+  static long long barrierCalls;            // 发出的vkCmdPipelineBarrier次数(统计用)
+  static long long imageBarriers;           // 发出的图像屏障数(统计用)
+  static long long bufferBarriers;          // 发出的缓冲屏障数(统计用)
+  static long long skippedUses;             // 不需要屏障的使用次数(统计用)
+
+  /**
+   * 用法对应的阶段、访问类型与布局
+   */
+  static ResourceAccess accessOf(ResourceUsage usage);
+
+  /**
+   * 开始跟踪图像(新建的图像布局为UNDEFINED, 内容无需保留), 已跟踪的同一图像重新开始
+   */
+  static void registerImage(VkImage image, VkImageAspectFlags aspectMask, uint32_t levelCount, uint32_t layerCount,
+                            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+  /**
+   * 开始跟踪缓冲, 已跟踪的同一缓冲重新开始
+   */
+  static void registerBuffer(VkBuffer buffer);
+
+  /**
+   * 停止跟踪(销毁资源时调用)
+   */
+  static void forgetImage(VkImage image);
+  static void forgetBuffer(VkBuffer buffer);
+
+  /**
+   * 之后的访问不需要保留图像[baseLevel, baseLevel + levelCount)级别的内容: 下一次布局转换从UNDEFINED开始
+   */
+  static void discardImage(VkImage image, uint32_t baseLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
+
+  /**
+   * image与previous共用内存(别名), 之后image不保留内容, 其访问须等待previous此前的所有访问
+   */
+  static void aliasImage(VkImage image, VkImage previous);
+
+  /**
+   * cmd中下一条命令以access访问图像的指定子资源, 需要时向cmd的屏障批次加入图像屏障
+   * queueFamily不为VK_QUEUE_FAMILY_IGNORED且与当前所属的家族不同时转移所有权(本命令缓冲中为获取一半)
+   */
+  static void useImage(VkCommandBuffer cmd, VkImage image, const ResourceAccess &access,
+                       uint32_t baseLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS,
+                       uint32_t baseLayer = 0, uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS,
+                       uint32_t queueFamily = VK_QUEUE_FAMILY_IGNORED);
+  static void useImage(VkCommandBuffer cmd, VkImage image, ResourceUsage usage,
+                       uint32_t baseLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS,
+                       uint32_t baseLayer = 0, uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
+
+  /**
+   * cmd中下一条命令以access访问整个缓冲, 需要时向cmd的屏障批次加入缓冲屏障
+   */
+  static void useBuffer(VkCommandBuffer cmd, VkBuffer buffer, const ResourceAccess &access,
+                        uint32_t queueFamily = VK_QUEUE_FAMILY_IGNORED);
+  static void useBuffer(VkCommandBuffer cmd, VkBuffer buffer, ResourceUsage usage);
+
+  /**
+   * 把cmd中累积的屏障合并为一次vkCmdPipelineBarrier发出(没有屏障时不做任何事)
+   */
+  static void flush(VkCommandBuffer cmd);
+
+  /**
+   * 丢弃所有跟踪状态与未发出的屏障
+   */
+  static void reset();
+
+  /**
+   * 图像子资源当前的状态(未跟踪时返回nullptr), 供调试与测试
+   */
+  static const ResourceState *imageState(VkImage image, uint32_t level, uint32_t layer);
+
+  /**
+   * 缓冲当前的状态(未跟踪时返回nullptr), 供调试与测试
+   */
+  static const ResourceState *bufferState(VkBuffer buffer);
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  static std::map<VkImage, TrackedImage> images;            // 被跟踪的图像
+  static std::map<VkBuffer, ResourceState> buffers;         // 被跟踪的缓冲
+  static std::map<VkCommandBuffer, PendingBarriers> pending; // 各命令缓冲尚未发出的屏障
+  static unsigned long long nextBatch;                      // 下一个屏障批次的序号
+
+  /**
+   * 状态为state的资源以access访问时推导屏障: 需要时返回true并给出屏障的阶段与访问类型, 同时推进state
+   */
+  static bool transition(ResourceState &state, const ResourceAccess &access, uint32_t queueFamily, bool isImage,
+                         VkPipelineStageFlags &srcStages, VkAccessFlags &srcAccess, VkImageLayout &oldLayout,
+                         uint32_t &srcQueueFamily);
+
+  /**
+   * 取得cmd的屏障批次(没有时新建)
+   */
+  static PendingBarriers &batchOf(VkCommandBuffer cmd);
+};
+
+#endif //DEEPERVULKAN_RESOURCESTATETRACKER_H_
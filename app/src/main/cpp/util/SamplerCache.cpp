@@ -0,0 +1,162 @@
+#include "SamplerCache.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include "../bndev/mylog.h"
+
+int SamplerCache::requestCount = 0;
+int SamplerCache::hitCount = 0;
+std::unordered_map<uint64_t, std::vector<SamplerCache::CachedSampler>> SamplerCache::samplers;
+bool SamplerCache::anisotropySupported = false;
+float SamplerCache::maxAnisotropyLimit = 1;
+
+SamplerDesc::SamplerDesc() {
+  magFilter = VK_FILTER_LINEAR;
+  minFilter = VK_FILTER_NEAREST;
+  mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  maxAnisotropy = 1;
+  maxLod = 0;
+}
+
+void SamplerCache::init(VkPhysicalDevice &gpu) {
+  VkPhysicalDeviceFeatures features;
+  vk::vkGetPhysicalDeviceFeatures(gpu, &features);
+  VkPhysicalDeviceProperties properties;
+  vk::vkGetPhysicalDeviceProperties(gpu, &properties);
+  anisotropySupported = features.samplerAnisotropy == VK_TRUE;
+  maxAnisotropyLimit = properties.limits.maxSamplerAnisotropy;
+}
+
+VkSamplerCreateInfo SamplerCache::toCreateInfo(const SamplerDesc &desc) {
+  VkSamplerCreateInfo samplerCreateInfo = {};                             // 构建采样器创建信息结构体实例
+  samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCreateInfo.pNext = nullptr;
+  samplerCreateInfo.magFilter = desc.magFilter;
+  samplerCreateInfo.minFilter = desc.minFilter;
+  samplerCreateInfo.mipmapMode = desc.mipmapMode;
+  samplerCreateInfo.addressModeU = desc.addressMode;
+  samplerCreateInfo.addressModeV = desc.addressMode;
+  samplerCreateInfo.addressModeW = desc.addressMode;
+  samplerCreateInfo.mipLodBias = 0.0;
+  samplerCreateInfo.minLod = 0.0;
+  samplerCreateInfo.maxLod = desc.maxLod;
+  samplerCreateInfo.anisotropyEnable = desc.maxAnisotropy > 1 ? VK_TRUE : VK_FALSE;
+  samplerCreateInfo.maxAnisotropy = std::max(desc.maxAnisotropy, 1.0f);
+  samplerCreateInfo.compareEnable = VK_FALSE;
+  samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+  samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+  return samplerCreateInfo;
+}
+
+VkSamplerCreateInfo SamplerCache::normalize(const VkSamplerCreateInfo &info) {
+  VkSamplerCreateInfo result = info;
+  if (result.anisotropyEnable && !anisotropySupported) {                  // 设备不支持时退回普通过滤
+    LOGE("SamplerCache: samplerAnisotropy not supported, anisotropy disabled");
+    result.anisotropyEnable = VK_FALSE;
+  }
+  if (result.anisotropyEnable) {
+    result.maxAnisotropy = std::min(std::max(result.maxAnisotropy, 1.0f), maxAnisotropyLimit);
+  } else {                                                                // 未启用时该值不起作用
+    result.maxAnisotropy = 1;
+  }
+  if (!result.compareEnable) {
+    result.compareOp = VK_COMPARE_OP_NEVER;
+  }
+  if (result.addressModeU != VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER &&   // 只有边框拉伸方式使用边框颜色
+      result.addressModeV != VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER &&
+      result.addressModeW != VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER) {
+    result.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+  }
+  return result;
+}
+
+/**
+ * 将一个字段的各字节并入FNV-1a哈希值
+ */
+template<typename T>
+static void hashField(uint64_t &h, const T &value) {
+  unsigned char bytes[sizeof(T)];
+  memcpy(bytes, &value, sizeof(T));                                       // 浮点数按位模式参与哈希
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+}
+
+uint64_t SamplerCache::hash(const VkSamplerCreateInfo &info) {
+  uint64_t h = 14695981039346656037ULL;                                   // 逐个字段计算, 不受结构体填充字节影响
+  hashField(h, info.flags);
+  hashField(h, info.magFilter);
+  hashField(h, info.minFilter);
+  hashField(h, info.mipmapMode);
+  hashField(h, info.addressModeU);
+  hashField(h, info.addressModeV);
+  hashField(h, info.addressModeW);
+  hashField(h, info.mipLodBias);
+  hashField(h, info.anisotropyEnable);
+  hashField(h, info.maxAnisotropy);
+  hashField(h, info.compareEnable);
+  hashField(h, info.compareOp);
+  hashField(h, info.minLod);
+  hashField(h, info.maxLod);
+  hashField(h, info.borderColor);
+  hashField(h, info.unnormalizedCoordinates);
+  return h;
+}
+
+bool SamplerCache::equal(const VkSamplerCreateInfo &a, const VkSamplerCreateInfo &b) {
+  return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter &&
+      a.mipmapMode == b.mipmapMode && a.addressModeU == b.addressModeU && a.addressModeV == b.addressModeV &&
+      a.addressModeW == b.addressModeW && a.mipLodBias == b.mipLodBias && a.anisotropyEnable == b.anisotropyEnable &&
+      a.maxAnisotropy == b.maxAnisotropy && a.compareEnable == b.compareEnable && a.compareOp == b.compareOp &&
+      a.minLod == b.minLod && a.maxLod == b.maxLod && a.borderColor == b.borderColor &&
+      a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+VkSampler SamplerCache::get(VkDevice &device, const VkSamplerCreateInfo &info) {
+  assert(info.pNext == nullptr);                                          // 扩展链无法参与比较
+  requestCount++;
+  VkSamplerCreateInfo key = normalize(info);
+  std::vector<CachedSampler> &bucket = samplers[hash(key)];
+  for (size_t i = 0; i < bucket.size(); ++i) {
+    if (equal(bucket[i].info, key)) {                                     // 状态相同, 共用已有采样器
+      hitCount++;
+      return bucket[i].sampler;
+    }
+  }
+  CachedSampler cached;
+  cached.info = key;
+  VkResult result = vk::vkCreateSampler(device, &key, nullptr, &cached.sampler); // 创建采样器
+  assert(result == VK_SUCCESS);
+  bucket.push_back(cached);
+  return cached.sampler;
+}
+
+VkSampler SamplerCache::get(VkDevice &device, const SamplerDesc &desc) {
+  VkSamplerCreateInfo info = toCreateInfo(desc);
+  return get(device, info);
+}
+
+int SamplerCache::size() {
+  int count = 0;
+  for (std::unordered_map<uint64_t, std::vector<CachedSampler>>::iterator it = samplers.begin();
+       it != samplers.end(); ++it) {
+    count += it->second.size();
+  }
+  return count;
+}
+
+void SamplerCache::destroy(VkDevice &device) {
+  LOGI("SamplerCache: %d samplers for %d requests (%d hits)", size(), requestCount, hitCount);
+  for (std::unordered_map<uint64_t, std::vector<CachedSampler>>::iterator it = samplers.begin();
+       it != samplers.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      vk::vkDestroySampler(device, it->second[i].sampler, nullptr);       // 销毁采样器
+    }
+  }
+  samplers.clear();
+  requestCount = 0;
+  hitCount = 0;
+}
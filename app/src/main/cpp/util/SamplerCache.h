@@ -0,0 +1,88 @@
+#ifndef DEEPERVULKAN_SAMPLERCACHE_H_
+#define DEEPERVULKAN_SAMPLERCACHE_H_
+
+#include <vector>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+/**
+ * 常用的采样方式(其余创建信息取默认值)
+ */
+struct SamplerDesc {
+  VkFilter magFilter;                 // 放大时的纹理采样方式
+  VkFilter minFilter;                 // 缩小时的纹理采样方式
+  VkSamplerMipmapMode mipmapMode;     // mipmap模式
+  VkSamplerAddressMode addressMode;   // 纹理S、T、W轴的拉伸方式
+  float maxAnisotropy;                // 各向异性最大过滤值(不大于1时不启用各向异性过滤)
+  float maxLod;                       // 最大Lod值
+
+  SamplerDesc();                      // 默认值与原先采样器的设置相同
+};
+
+/**
+ * 采样器缓存
+ * 以采样器创建信息的哈希值为键, 状态相同的请求共用同一个采样器, 避免重复创建
+ * 对不起作用的字段做归一化(如未启用各向异性时的maxAnisotropy、未启用比较时的compareOp), 使等价的状态命中同一采样器
+ */
+class SamplerCache {
+ public:
+  static int requestCount;            // 请求次数(统计用)
+  static int hitCount;                // 命中缓存的次数(统计用)
+
+  /**
+   * 读取设备的各向异性过滤支持情况, 之后的请求按设备上限截取
+   */
+  static void init(VkPhysicalDevice &gpu);
+
+  /**
+   * 返回与创建信息等价的采样器, 缓存中没有时创建(pNext须为nullptr)
+   */
+  static VkSampler get(VkDevice &device, const VkSamplerCreateInfo &info);
+
+  /**
+   * 返回指定采样方式的采样器
+   */
+  static VkSampler get(VkDevice &device, const SamplerDesc &desc);
+
+  /**
+   * 将采样方式转换为采样器创建信息
+   */
+  static VkSamplerCreateInfo toCreateInfo(const SamplerDesc &desc);
+
+  /**
+   * 缓存中采样器的数量
+   */
+  static int size();
+
+  /**
+   * 销毁缓存中的所有采样器
+   */
+  static void destroy(VkDevice &device);
+
+ private:
+  struct CachedSampler {
+    VkSamplerCreateInfo info;         // 归一化后的创建信息
+    VkSampler sampler;                // 对应的采样器
+  };
+  static std::unordered_map<uint64_t, std::vector<CachedSampler>> samplers; // 哈希值对应的采样器(哈希冲突时逐个比较)
+  static bool anisotropySupported;    // 设备是否支持各向异性过滤
+  static float maxAnisotropyLimit;    // 设备支持的各向异性最大过滤值
+
+  /**
+   * 归一化创建信息: 截取各向异性过滤值并清除不起作用的字段
+   */
+  static VkSamplerCreateInfo normalize(const VkSamplerCreateInfo &info);
+
+  /**
+   * 计算归一化创建信息的哈希值(FNV-1a)
+   */
+  static uint64_t hash(const VkSamplerCreateInfo &info);
+
+  /**
+   * 比较两个归一化创建信息是否相同
+   */
+  static bool equal(const VkSamplerCreateInfo &a, const VkSamplerCreateInfo &b);
+};
+
+#endif //DEEPERVULKAN_SAMPLERCACHE_H_
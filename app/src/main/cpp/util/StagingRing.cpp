@@ -0,0 +1,193 @@
+#include "StagingRing.h"
+#include <cassert>
+#include <algorithm>
+#include "DeviceMemoryAllocator.h"
+#include "../bndev/mylog.h"
+
+VkBuffer StagingRing::buffer = VK_NULL_HANDLE;
+VkDeviceSize StagingRing::capacity = 0;
+long long StagingRing::allocatedBytes = 0;
+int StagingRing::stallCount = 0;
+MemoryAllocation StagingRing::memory;
+uint8_t *StagingRing::mapped = nullptr;
+VkDeviceSize StagingRing::head = 0;
+VkDeviceSize StagingRing::tail = 0;
+bool StagingRing::pending = false;
+std::deque<StagingSegment> StagingRing::inFlight;
+std::vector<VkFence> StagingRing::freeFences;
+
+void StagingRing::create(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties, VkDeviceSize size) {
+  VkBufferCreateInfo buf_info = {};                                       // 构建缓冲创建信息结构体实例
+  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buf_info.pNext = nullptr;
+  buf_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;                      // 缓冲的用途为传输源
+  buf_info.size = size;
+  buf_info.queueFamilyIndexCount = 0;
+  buf_info.pQueueFamilyIndices = nullptr;
+  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buf_info.flags = 0;
+  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &buffer);
+  assert(result == VK_SUCCESS);
+
+  DeviceMemoryAllocator::allocateBuffer(                                  // 主机可见且一致, 写入后无需刷新
+      device, buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory);
+  mapped = memory.mapped;                                                 // 内存块持久映射, 直到销毁时才解除
+
+  capacity = size;
+  head = 0;
+  tail = 0;
+  pending = false;
+  allocatedBytes = 0;
+  stallCount = 0;
+  LOGI("StagingRing created: %d bytes", (int) size);
+}
+
+void StagingRing::destroy(VkDevice &device) {
+  waitIdle(device);
+  for (size_t i = 0; i < freeFences.size(); ++i) {
+    vk::vkDestroyFence(device, freeFences[i], nullptr);
+  }
+  freeFences.clear();
+  vk::vkDestroyBuffer(device, buffer, nullptr);
+  DeviceMemoryAllocator::free(device, memory);
+  LOGI("StagingRing destroyed: %lld bytes allocated, %d stalls", allocatedBytes, stallCount);
+  buffer = VK_NULL_HANDLE;
+  mapped = nullptr;
+  capacity = 0;
+}
+
+bool StagingRing::allocate(VkDevice &device, VkDeviceSize size, VkDeviceSize alignment,
+                           VkDeviceSize &offset, uint8_t *&pData) {
+  assert(size > 0 && size <= capacity);
+  alignment = std::max(alignment, (VkDeviceSize) 1);
+  while (retireOldest(device, false)) {}                                  // 先回收已完成的区域(不阻塞)
+  for (;;) {
+    bool live = pending || !inFlight.empty();                             // 环中是否还有未回收的区域
+    if (!live) {
+      head = 0;
+      tail = 0;
+    }
+    VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+    bool found = false;
+    if (!live || head > tail) {                                           // 空闲区为[head, capacity)与[0, tail)
+      if (aligned + size <= capacity) {
+        offset = aligned;
+        found = true;
+      } else if (size <= tail) {                                          // 末尾放不下时回绕到开头
+        offset = 0;
+        found = true;
+      }
+    } else if (head < tail) {                                             // 已回绕, 空闲区为[head, tail)
+      if (aligned + size <= tail) {
+        offset = aligned;
+        found = true;
+      }
+    }                                                                     // head == tail且有未回收区域时缓冲已满
+    if (found) {
+      head = offset + size;
+      pending = true;
+      allocatedBytes += size;
+      pData = mapped + offset;
+      return true;
+    }
+    if (inFlight.empty()) {                                               // 缓冲被尚未提交的分配占满
+      return false;
+    }
+    stallCount++;
+    retireOldest(device, true);                                           // 等待最早的提交完成后重试
+  }
+}
+
+VkFence StagingRing::submit(VkDevice &device, VkQueue &queue, VkCommandBuffer &cmdBuffer, VkSemaphore signalSemaphore) {
+  VkFence fence;
+  if (freeFences.empty()) {
+    VkFenceCreateInfo fenceInfo;
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.pNext = nullptr;
+    fenceInfo.flags = 0;
+    VkResult result = vk::vkCreateFence(device, &fenceInfo, nullptr, &fence);
+    assert(result == VK_SUCCESS);
+  } else {                                                                // 重用已回收的栅栏
+    fence = freeFences.back();
+    freeFences.pop_back();
+  }
+
+  VkSubmitInfo submit_info[1] = {};
+  submit_info[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info[0].pNext = nullptr;
+  submit_info[0].waitSemaphoreCount = 0;
+  submit_info[0].pWaitSemaphores = VK_NULL_HANDLE;
+  submit_info[0].pWaitDstStageMask = VK_NULL_HANDLE;
+  submit_info[0].commandBufferCount = 1;
+  submit_info[0].pCommandBuffers = &cmdBuffer;
+  submit_info[0].signalSemaphoreCount = signalSemaphore == VK_NULL_HANDLE ? 0 : 1;
+  submit_info[0].pSignalSemaphores = &signalSemaphore;
+  VkResult result = vk::vkQueueSubmit(queue, 1, submit_info, fence);
+  assert(result == VK_SUCCESS);
+
+  StagingSegment segment;
+  segment.fence = fence;
+  segment.end = head;
+  inFlight.push_back(segment);
+  pending = false;
+  return fence;
+}
+
+void StagingRing::wait(VkDevice &device, VkFence fence) {
+  bool submitted = false;
+  for (size_t i = 0; i < inFlight.size(); ++i) {
+    if (inFlight[i].fence == fence) {
+      submitted = true;
+      break;
+    }
+  }
+  if (!submitted) {                                                       // 已被回收, 无需等待
+    return;
+  }
+  for (;;) {
+    VkFence oldest = inFlight.front().fence;
+    retireOldest(device, true);
+    if (oldest == fence) {
+      break;
+    }
+  }
+}
+
+bool StagingRing::poll(VkDevice &device, VkFence fence) {
+  while (retireOldest(device, false)) {}                                  // 回收所有已完成的区域
+  for (size_t i = 0; i < inFlight.size(); ++i) {
+    if (inFlight[i].fence == fence) {                                     // 更早的提交未完成时按栅栏状态判断
+      return vk::vkGetFenceStatus(device, fence) == VK_SUCCESS;
+    }
+  }
+  return true;                                                            // 已被回收
+}
+
+void StagingRing::waitIdle(VkDevice &device) {
+  while (retireOldest(device, true)) {}
+}
+
+bool StagingRing::retireOldest(VkDevice &device, bool block) {
+  if (inFlight.empty()) {
+    return false;
+  }
+  StagingSegment segment = inFlight.front();
+  VkResult result;
+  if (block) {
+    do {                                                                  // 循环等待执行完毕
+      result = vk::vkWaitForFences(device, 1, &segment.fence, VK_TRUE, 100000000);
+    } while (result == VK_TIMEOUT);
+  } else if (vk::vkGetFenceStatus(device, segment.fence) != VK_SUCCESS) {
+    return false;
+  }
+  result = vk::vkResetFences(device, 1, &segment.fence);
+  assert(result == VK_SUCCESS);
+  freeFences.push_back(segment.fence);
+  inFlight.pop_front();
+  tail = segment.end;                                                     // 该区域之前的空间全部可重用
+  if (inFlight.empty() && !pending) {
+    head = 0;
+    tail = 0;
+  }
+  return true;
+}
@@ -0,0 +1,88 @@
+#ifndef DEEPERVULKAN_STAGINGRING_H_
+#define DEEPERVULKAN_STAGINGRING_H_
+
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
+
+#define STAGING_RING_BYTES (16 * 1024 * 1024) // 中转环形缓冲的默认字节数
+#define STAGING_COPY_ALIGNMENT 16              // 缓冲到图像拷贝时偏移量的对齐值(满足4字节像素与16字节压缩块)
+
+/**
+ * 已提交但尚未确认完成的一段中转区域
+ */
+struct StagingSegment {
+  VkFence fence;          // 保护该区域的栅栏
+  VkDeviceSize end;       // 该区域在环形缓冲中的结束偏移量
+};
+
+/**
+ * 纹理与缓冲上传共用的中转环形缓冲
+ * 缓冲在创建时分配并一直保持映射, 分配时只线性推进写指针, 到达末尾时回绕到开头
+ * 每次提交为自上次提交以来的所有分配关联一个栅栏, 栅栏完成后对应区域才被回收
+ */
+class StagingRing {
+ public:
+  static VkBuffer buffer;                       // 中转缓冲
+  static VkDeviceSize capacity;                 // 中转缓冲总字节数
+  static long long allocatedBytes;              // 累计分配的字节数(统计用)
+  static int stallCount;                        // 因空间不足而阻塞等待栅栏的次数(统计用)
+
+  /**
+   * 创建中转缓冲并映射
+   */
+  static void create(VkDevice &device, VkPhysicalDeviceMemoryProperties &memoryroperties,
+                     VkDeviceSize size = STAGING_RING_BYTES);
+
+  /**
+   * 等待所有提交完成后销毁中转缓冲
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 分配size字节的中转区域, offset返回其在中转缓冲中的偏移量, pData返回映射后的CPU地址
+   * 空间不足时依次等待最早提交的栅栏; 若本次提交前已分配的区域占满缓冲则返回false, 需先调用submit
+   */
+  static bool allocate(VkDevice &device, VkDeviceSize size, VkDeviceSize alignment,
+                       VkDeviceSize &offset, uint8_t *&pData);
+
+  /**
+   * 提交已记录完毕的命令缓冲, 并将此前的所有分配与返回的栅栏关联
+   * signalSemaphore不为空时命令执行完毕后发出该信号量(供其他队列等待)
+   */
+  static VkFence submit(VkDevice &device, VkQueue &queue, VkCommandBuffer &cmdBuffer,
+                        VkSemaphore signalSemaphore = VK_NULL_HANDLE);
+
+  /**
+   * 等待指定栅栏完成并回收其之前提交的所有区域
+   */
+  static void wait(VkDevice &device, VkFence fence);
+
+  /**
+   * 不阻塞地查询指定栅栏对应的提交是否已完成, 同时回收已完成的区域
+   */
+  static bool poll(VkDevice &device, VkFence fence);
+
+  /**
+   * 等待所有已提交的上传完成
+   */
+  static void waitIdle(VkDevice &device);
+
+ private:
+  static MemoryAllocation memory;               // 中转缓冲对应的设备内存(从子分配器分配)
+  static uint8_t *mapped;                       // 映射后的CPU地址
+  static VkDeviceSize head;                     // 写指针
+  static VkDeviceSize tail;                     // 最早的未回收区域的起始偏移量
+  static bool pending;                          // 是否有尚未提交的分配
+  static std::deque<StagingSegment> inFlight;   // 已提交未回收的区域(按提交顺序)
+  static std::vector<VkFence> freeFences;       // 可重用的栅栏
+
+  /**
+   * 回收最早提交的区域, block为false时只回收已完成的区域, 返回是否回收了区域
+   */
+  static bool retireOldest(VkDevice &device, bool block);
+};
+
+#endif //DEEPERVULKAN_STAGINGRING_H_
@@ -0,0 +1,33 @@
+#include "TexSliceStream.h"
+#include <cassert>
+
+TexSliceStream::TexSliceStream(AAsset *asset, int width, int height, int sliceCount) {
+  this->asset = asset;
+  this->width = width;
+  this->height = height;
+  this->sliceCount = sliceCount;
+  this->sliceByteCount = width * height * 4;
+  this->slicesRead = 0;
+}
+
+TexSliceStream::~TexSliceStream() {
+  AAsset_close(asset);                                                    // 关闭AAsset对象
+}
+
+int TexSliceStream::readSlices(unsigned char *dst, int count) {
+  if (count > sliceCount - slicesRead) {                                  // 不能超过剩余切片数量
+    count = sliceCount - slicesRead;
+  }
+  size_t byteCount = (size_t) sliceByteCount * count;                     // 本批次需读取的字节数
+  size_t offset = 0;
+  while (offset < byteCount) {                                            // AAsset_read可能分多次返回
+    int readBytes = AAsset_read(asset, (void *) (dst + offset), byteCount - offset);
+    assert(readBytes > 0);
+    if (readBytes <= 0) {                                                 // 文件数据不足时停止读取
+      break;
+    }
+    offset += readBytes;
+  }
+  slicesRead += count;
+  return count;
+}
@@ -0,0 +1,30 @@
+#ifndef DEEPERVULKAN_TEXSLICESTREAM_H_
+#define DEEPERVULKAN_TEXSLICESTREAM_H_
+
+#include "android/asset_manager.h"
+
+/**
+ * 3D纹理(bn3dtex)/2D纹理数组(bntexa)的按切片流式读取对象
+ * 只解析文件头, 纹理数据按切片(层)逐批读入调用方提供的内存, 不在内存中保留整个纹理
+ */
+class TexSliceStream {
+ public:
+  int width;          // 纹理宽度
+  int height;         // 纹理高度
+  int sliceCount;     // 切片数量(3D纹理的深度或纹理数组的长度)
+  int sliceByteCount; // 每个切片的数据字节数
+  int slicesRead;     // 已读取的切片数量
+
+  TexSliceStream(AAsset *asset, int width, int height, int sliceCount);
+  ~TexSliceStream();
+
+  /**
+   * 读取接下来的若干切片到dst所指内存, 返回实际读取的切片数量
+   */
+  int readSlices(unsigned char *dst, int count);
+
+ private:
+  AAsset *asset;      // 对应的AAsset对象
+};
+
+#endif //DEEPERVULKAN_TEXSLICESTREAM_H_
@@ -0,0 +1,181 @@
+#include "TextureAtlas.h"
+#include <cstring>
+#include <algorithm>
+#include <climits>
+
+AtlasPacker::AtlasPacker(int width, int height) {
+  Rect whole = {0, 0, width, height};
+  freeRects.push_back(whole);
+}
+
+bool AtlasPacker::insert(int width, int height, int &x, int &y) {
+  int best = -1;
+  int bestShort = INT_MAX;
+  int bestLong = INT_MAX;
+  for (size_t i = 0; i < freeRects.size(); ++i) {                         // 选择剩余短边最小的空闲矩形
+    const Rect &r = freeRects[i];
+    if (r.width < width || r.height < height) {
+      continue;
+    }
+    int leftW = r.width - width;
+    int leftH = r.height - height;
+    int shortSide = std::min(leftW, leftH);
+    int longSide = std::max(leftW, leftH);
+    if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+      best = (int) i;
+      bestShort = shortSide;
+      bestLong = longSide;
+    }
+  }
+  if (best < 0) {
+    return false;
+  }
+  Rect used = {freeRects[best].x, freeRects[best].y, width, height};
+  splitFreeRects(used);
+  pruneFreeRects();
+  x = used.x;
+  y = used.y;
+  return true;
+}
+
+void AtlasPacker::splitFreeRects(const Rect &used) {
+  std::vector<Rect> result;
+  for (size_t i = 0; i < freeRects.size(); ++i) {
+    const Rect &r = freeRects[i];
+    if (used.x >= r.x + r.width || used.x + used.width <= r.x ||         // 不相交的空闲矩形保持不变
+        used.y >= r.y + r.height || used.y + used.height <= r.y) {
+      result.push_back(r);
+      continue;
+    }
+    if (used.x > r.x) {                                                   // 左侧剩余部分
+      Rect n = {r.x, r.y, used.x - r.x, r.height};
+      result.push_back(n);
+    }
+    if (used.x + used.width < r.x + r.width) {                            // 右侧剩余部分
+      Rect n = {used.x + used.width, r.y, r.x + r.width - used.x - used.width, r.height};
+      result.push_back(n);
+    }
+    if (used.y > r.y) {                                                   // 上方剩余部分
+      Rect n = {r.x, r.y, r.width, used.y - r.y};
+      result.push_back(n);
+    }
+    if (used.y + used.height < r.y + r.height) {                          // 下方剩余部分
+      Rect n = {r.x, used.y + used.height, r.width, r.y + r.height - used.y - used.height};
+      result.push_back(n);
+    }
+  }
+  freeRects.swap(result);
+}
+
+void AtlasPacker::pruneFreeRects() {
+  for (size_t i = 0; i < freeRects.size(); ++i) {                         // 删除被其他空闲矩形包含的矩形
+    for (size_t j = 0; j < freeRects.size(); ++j) {
+      if (i == j) {
+        continue;
+      }
+      const Rect &a = freeRects[i];
+      const Rect &b = freeRects[j];
+      if (a.x >= b.x && a.y >= b.y && a.x + a.width <= b.x + b.width && a.y + a.height <= b.y + b.height) {
+        freeRects.erase(freeRects.begin() + i);
+        --i;
+        break;
+      }
+    }
+  }
+}
+
+TexDataObject *TextureAtlas::build(const std::vector<TexDataObject *> &images, int padding, int mipLevels,
+                                   std::vector<AtlasRegion> &regions) {
+  int align = 1 << std::max(0, mipLevels - 1);                            // 最低一级中子纹理仍占整数个像素
+  padding = std::max(padding, align);                                     // 最低一级中仍至少保留1像素间隔
+  std::vector<int> cellW(images.size());
+  std::vector<int> cellH(images.size());
+  long long area = 0;
+  for (size_t i = 0; i < images.size(); ++i) {                            // 每个子纹理连同间隔占用的单元尺寸
+    cellW[i] = (images[i]->width + padding * 2 + align - 1) / align * align;
+    cellH[i] = (images[i]->height + padding * 2 + align - 1) / align * align;
+    area += (long long) cellW[i] * cellH[i];
+  }
+  std::vector<int> order(images.size());                                  // 按最长边从大到小装箱
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = (int) i;
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return std::max(cellW[a], cellH[a]) > std::max(cellW[b], cellH[b]);
+  });
+
+  int side = 1;
+  while ((long long) side * side < area) {
+    side <<= 1;
+  }
+  std::vector<int> posX(images.size());
+  std::vector<int> posY(images.size());
+  int atlasW = 0;
+  int atlasH = 0;
+  for (; side <= ATLAS_MAX_SIZE && atlasW == 0; side <<= 1) {             // 依次尝试s*s与2s*s
+    for (int wide = 0; wide < 2 && atlasW == 0; ++wide) {
+      int w = wide ? side * 2 : side;
+      if (w > ATLAS_MAX_SIZE) {
+        continue;
+      }
+      AtlasPacker packer(w, side);
+      bool fits = true;
+      for (size_t k = 0; k < order.size() && fits; ++k) {
+        int i = order[k];
+        fits = packer.insert(cellW[i], cellH[i], posX[i], posY[i]);
+      }
+      if (fits) {
+        atlasW = w;
+        atlasH = side;
+      }
+    }
+  }
+  if (atlasW == 0) {                                                      // 超出最大尺寸
+    return nullptr;
+  }
+
+  int dataByteCount = atlasW * atlasH * 4;
+  auto *data = new unsigned char[dataByteCount];
+  memset(data, 0, (size_t) dataByteCount);
+  regions.resize(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
+    TexDataObject *img = images[i];
+    int x0 = posX[i] + padding;
+    int y0 = posY[i] + padding;
+    for (int row = -padding; row < img->height + padding; ++row) {        // 间隔用最近的边缘像素填充
+      int srcRow = std::min(std::max(row, 0), img->height - 1);
+      const unsigned char *src = img->data + (size_t) srcRow * img->width * 4;
+      unsigned char *dst = data + ((size_t) (y0 + row) * atlasW + x0) * 4;
+      for (int col = -padding; col < 0; ++col) {
+        memcpy(dst + col * 4, src, 4);
+      }
+      memcpy(dst, src, (size_t) img->width * 4);
+      for (int col = img->width; col < img->width + padding; ++col) {
+        memcpy(dst + col * 4, src + (img->width - 1) * 4, 4);
+      }
+    }
+    AtlasRegion &region = regions[i];
+    region.x = x0;
+    region.y = y0;
+    region.width = img->width;
+    region.height = img->height;
+    region.u0 = (float) x0 / atlasW;
+    region.v0 = (float) y0 / atlasH;
+    region.u1 = (float) (x0 + img->width) / atlasW;
+    region.v1 = (float) (y0 + img->height) / atlasH;
+  }
+  return new TexDataObject(atlasW, atlasH, data, dataByteCount);
+}
+
+void TextureAtlas::remap(const AtlasRegion &region, float &s, float &t) {
+  s = region.u0 + std::min(std::max(s, 0.0f), 1.0f) * (region.u1 - region.u0);
+  t = region.v0 + std::min(std::max(t, 0.0f), 1.0f) * (region.v1 - region.v0);
+}
+
+void TextureAtlas::remapVertexData(const AtlasRegion &region, float *vdata, int vCount, int floatsPerVertex,
+                                   int texOffset) {
+  for (int i = 0; i < vCount; ++i) {
+    float *st = vdata + i * floatsPerVertex + texOffset;
+    remap(region, st[0], st[1]);
+  }
+}
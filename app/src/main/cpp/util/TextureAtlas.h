@@ -0,0 +1,71 @@
+#ifndef DEEPERVULKAN_TEXTUREATLAS_H_
+#define DEEPERVULKAN_TEXTUREATLAS_H_
+
+#include <vector>
+#include "TexDataObject.h"
+
+#define ATLAS_MAX_SIZE 4096 // 纹理图集的最大边长
+
+/**
+ * 子纹理在图集中的区域
+ */
+struct AtlasRegion {
+  int x;          // 子纹理左上角在图集中的x坐标(不含间隔)
+  int y;          // 子纹理左上角在图集中的y坐标(不含间隔)
+  int width;      // 子纹理宽度
+  int height;     // 子纹理高度
+  float u0;       // 重映射后纹理坐标S的最小值
+  float v0;       // 重映射后纹理坐标T的最小值
+  float u1;       // 重映射后纹理坐标S的最大值
+  float v1;       // 重映射后纹理坐标T的最大值
+};
+
+/**
+ * 矩形装箱器(MaxRects算法, 按最短边最佳适配选择空闲矩形)
+ */
+class AtlasPacker {
+ public:
+  AtlasPacker(int width, int height);
+
+  /**
+   * 放入width*height的矩形, 成功时x、y返回其左上角坐标
+   */
+  bool insert(int width, int height, int &x, int &y);
+
+ private:
+  struct Rect {
+    int x, y, width, height;
+  };
+  std::vector<Rect> freeRects;  // 当前所有极大空闲矩形
+
+  void splitFreeRects(const Rect &used);
+  void pruneFreeRects();
+};
+
+/**
+ * 纹理图集
+ * 将多个小纹理装入一幅图像, 子纹理四周用边缘像素填充间隔, 避免线性过滤与mipmap时颜色渗入相邻子纹理
+ */
+class TextureAtlas {
+ public:
+  /**
+   * 生成图集: images为RGBA8子纹理, padding为子纹理四周的间隔像素数,
+   * mipLevels为图集将使用的mipmap级数(子纹理按2^(mipLevels-1)对齐, 保证各级都有间隔)
+   * regions返回各子纹理的区域, 返回图集纹理数据(宽高为2的幂), 无法装下时返回nullptr
+   */
+  static TexDataObject *build(const std::vector<TexDataObject *> &images, int padding, int mipLevels,
+                              std::vector<AtlasRegion> &regions);
+
+  /**
+   * 将[0, 1]范围内的纹理坐标重映射到子纹理区域(超出范围的坐标被截取到区域内)
+   */
+  static void remap(const AtlasRegion &region, float &s, float &t);
+
+  /**
+   * 重映射顶点数据中的纹理坐标: 每个顶点floatsPerVertex个float, 纹理坐标位于第texOffset个float起
+   */
+  static void remapVertexData(const AtlasRegion &region, float *vdata, int vCount, int floatsPerVertex,
+                              int texOffset);
+};
+
+#endif //DEEPERVULKAN_TEXTUREATLAS_H_
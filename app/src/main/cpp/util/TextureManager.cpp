@@ -2,13 +2,29 @@
 #include "../bndev/mylog.h"
 #include "HelpFunction.h"
 #include "FileUtil.h"
+#include "MipmapGenerator.h"
+#include "StagingRing.h"
+#include "AsyncUploader.h"
+#include "DeviceMemoryDefragmenter.h"
+#include "BindlessTextureTable.h"
+#include "JobSystem.h"
+#include "ResourceStateTracker.h"
+#include <algorithm>
+#include <thread>
+#include <chrono>
 
 std::vector<VkSampler> TextureManager::samplerList;
-std::map<std::string, VkImage> TextureManager::textureImageList;
-std::map<std::string, VkDeviceMemory> TextureManager::textureMemoryList;
-std::map<std::string, VkImageView> TextureManager::viewTextureList;
-std::map<std::string, VkDescriptorImageInfo> TextureManager::texImageInfoList;
 std::map<std::string, int> TextureManager::imageSampler;                  // Sample6_3
+std::map<std::string, SamplerDesc> TextureManager::textureSamplers;
+std::vector<PendingTexture> TextureManager::pendingTextures;
+std::vector<ResHandle> TextureManager::texHandles;
+std::vector<ResHandle> TextureManager::texHandlesSingle;
+std::vector<ResHandle> TextureManager::texHandlesPair;
+std::map<std::string, std::string> TextureManager::atlasOfTexture;
+std::map<std::string, AtlasRegion> TextureManager::atlasRegionList;
+std::map<std::string, std::vector<std::string>> TextureManager::atlasSources;
+//std::map<std::string, std::vector<std::string>> TextureManager::atlasSources = { // 纹理图集-Sample6_3的四幅纹理装入一个图集
+//    {"atlas/robot", {"texture/robot0.bntex", "texture/robot1.bntex", "texture/robot2.bntex", "texture/robot3.bntex"}}};
 
 //std::vector<std::string> TextureManager::texNames = {"texture/wall.bntex"}; // Sample6_1、Sample6_2
 //std::vector<std::string> TextureManager::texNames =                       // Sample6_3
@@ -30,159 +46,80 @@ std::vector<std::string> TextureManager::texNamesPair = {"texture/earth.bntex",
 //std::vector<std::string> TextureManager::texNames = {"texture/vulkan.bntexa"}; // Sample6_10
 //std::vector<std::string>                                                  // Sample6_11
 //TextureManager::texNames = {"texture/mipmapIsotropy.bntex", "texture/mipmapAnisotropy.bntex"};
+//std::vector<std::string> TextureManager::texNames = {"atlas/robot"};     // 纹理图集(名称须在atlasSources中)
 std::vector<std::string> TextureManager::texNames = {"texture/ghxp.bntex"}; // Sample7_4
 
 /**
- * 设置图像布局
+ * 纹理文件名称是否以指定扩展名结尾
  */
-void setImageLayout(VkCommandBuffer cmd,
-                    VkImage image,
-                    VkImageAspectFlags aspectMask,
-                    VkImageLayout old_image_layout,
-                    VkImageLayout new_image_layout,
-                    int32_t layerCount = 1) {                             // Sample6_10
-  VkImageMemoryBarrier image_memory_barrier = {};                         // 构建图像内存屏障结构体实例
-  image_memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  image_memory_barrier.pNext = nullptr;
-  image_memory_barrier.srcAccessMask = 0;                                 // 源访问掩码
-  image_memory_barrier.dstAccessMask = 0;                                 // 目标访问掩码
-  image_memory_barrier.oldLayout = old_image_layout;                      // 旧布局(屏障前)
-  image_memory_barrier.newLayout = new_image_layout;                      // 新布局(屏障后)
-  image_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;     // 源队列家族索引
-  image_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;     // 目标队列家族索引
-  image_memory_barrier.image = image;                                     // 对应的图像
-  image_memory_barrier.subresourceRange.aspectMask = aspectMask;          // 使用方面
-  image_memory_barrier.subresourceRange.baseMipLevel = 0;                 // 基础mipmap级别
-  image_memory_barrier.subresourceRange.levelCount = 1;                   // mipmap级别的数量
-  image_memory_barrier.subresourceRange.baseArrayLayer = 0;               // 基础数组层
-  image_memory_barrier.subresourceRange.layerCount = 1;                   // 数组层的数量
-//  image_memory_barrier.subresourceRange.layerCount = layerCount;          // Sample6_10
-
-  // 根据不同的新布局或旧布局预设值设置了源访问掩码或目标访问掩码
-  if (old_image_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-    image_memory_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  }
-  if (new_image_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  }
-  if (new_image_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
-    image_memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-  }
-  if (old_image_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    image_memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  }
-  if (old_image_layout == VK_IMAGE_LAYOUT_PREINITIALIZED) {
-    image_memory_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-  }
-  if (new_image_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-    image_memory_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
-    image_memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  }
-  if (new_image_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-    image_memory_barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  }
-  if (new_image_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-    image_memory_barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-  }
-
-  VkPipelineStageFlags src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;    // 屏障前阶段(表示当管线刚开始执行的阶段)
-  VkPipelineStageFlags dest_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;   // 屏障后阶段(表示当管线刚开始执行的阶段)
-  // 放置图像内存屏障
-  vk::vkCmdPipelineBarrier(
-      cmd,                                                                // 实现指定内存屏障的命令缓冲
-      src_stages,                                                         // 必须在指定内存屏障实现前执行完毕的管线阶段
-      dest_stages,                                                        // 必须在指定内存屏障结束后才能开始执行的管线阶段
-      0,                                                                  // 指定的内存屏障是否拥有屏幕空间位置
-      0,                                                                  // 指定全局内存屏障的数量
-      nullptr,                                                            // 指向全局内存屏障结构体实例列表的指针
-      0,                                                                  // 指定缓冲内存屏障的数量
-      nullptr,                                                            // 指向缓冲内存屏障结构体实例列表的指针
-      1,                                                                  // 指定图像内存屏障的数量
-      &image_memory_barrier                                               // 指向图像内存屏障结构体实例列表的指针
-  );
+static bool hasExtension(const std::string &texName, const std::string &extension) {
+  return texName.size() >= extension.size() &&
+      texName.compare(texName.size() - extension.size(), extension.size(), extension) == 0;
 }
 
 void TextureManager::initSampler(VkDevice &device, VkPhysicalDevice &gpu) {
-  VkSamplerCreateInfo samplerCreateInfo = {};                             // 构建采样器创建信息结构体实例
-  samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;        // 结构体的类型
+  SamplerCache::init(gpu);                                                // 读取设备的各向异性过滤支持情况
+  SamplerDesc desc;                                                       // 采样方式(其余创建信息由采样器缓存填写)
 
   /// 纹理采样方式
-  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;                         // 放大时的纹理采样方式
-//  samplerCreateInfo.magFilter = VK_FILTER_NEAREST;                        // Sample6_5、Sample6_9、Sample6_11
-  samplerCreateInfo.minFilter = VK_FILTER_NEAREST;                        // 缩小时的纹理采样方式
-  /// Sample6_4 ************************************************** start
-//  for (int i = 0; i < SAMPLER_COUNT; ++i) {                               // 循环设置不同的采样方式
-//    if (i == 0) {
-//      samplerCreateInfo.magFilter = VK_FILTER_NEAREST;                    // 放大时采用最近点采样方式
-//      samplerCreateInfo.minFilter = VK_FILTER_NEAREST;                    // 缩小时采用最近点采样方式
-//    } else if (i == 1) {
-//      samplerCreateInfo.magFilter = VK_FILTER_LINEAR;                     // 放大时采用线性采样方式
-//      samplerCreateInfo.minFilter = VK_FILTER_LINEAR;                     // 缩小时采用线性采样方式
-//    }
-  /// Sample6_4 **************************************************** end
+  desc.magFilter = VK_FILTER_LINEAR;                                      // 放大时的纹理采样方式
+//  desc.magFilter = VK_FILTER_NEAREST;                                     // Sample6_5、Sample6_9、Sample6_11
+  desc.minFilter = VK_FILTER_NEAREST;                                     // 缩小时的纹理采样方式
 
   /// MipMap模式
-  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;          // mipmap模式
-//  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;           // Sample6_5、Sample6_11
+  desc.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;                       // mipmap模式
+//  desc.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;                        // Sample6_5、Sample6_11
 
   /// 纹理拉伸方式
-  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE; // 纹理S轴的拉伸方式
-  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE; // 纹理T轴的拉伸方式
-  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE; // 纹理W轴的拉伸方式
+  desc.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;               // 纹理S、T、W轴的拉伸方式
+//  desc.addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;                      // Sample6_11
 
-  /// Sample6_3 ************************************************** start
-//  for (int i = 0; i < SAMPLER_COUNT; ++i) {                               // 循环设置各种拉伸方式
-//    if (i == 0) {                                                         // 设置为重复拉伸方式
-//      samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-//      samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-//      samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-//    } else if (i == 1) {                                                  // 设置为截取拉伸方式
-//      samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-//      samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-//      samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-//    } else if (i == 2) {                                                  // 设置为镜像重复拉伸方式
-//      samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-//      samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-//      samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-//    } else if (i == 3) {                                                  // 设置为边框拉伸方式
-//      samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-//      samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-//      samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-//    }
-  /// Sample6_3 **************************************************** end
+  desc.maxLod = 0.0;                                                      // 最大Lod值
+//  desc.maxLod = 9.0;                                                      // Sample6_5、Sample6_11
+  desc.maxAnisotropy = 1;                                                 // 各向异性最大过滤值(1为不启用)
+//  desc.maxAnisotropy = 8;                                                 // Sample6_11
 
+  samplerList.push_back(SamplerCache::get(device, desc));                 // 0号采样器
   /// Sample6_11 ************************************************* start
-//  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-//  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-//  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+//  desc.maxAnisotropy = 1;                                                 // 1号采样器禁用各向异性过滤
+//  samplerList.push_back(SamplerCache::get(device, desc));
   /// Sample6_11 *************************************************** end
 
-  samplerCreateInfo.mipLodBias = 0.0;                                     // mipmap时的Lod调整值
-  samplerCreateInfo.minLod = 0.0;                                         // 最小Lod值
-  samplerCreateInfo.maxLod = 0.0;                                         // 最大Lod值
-//  samplerCreateInfo.maxLod = 9.0;                                         // Sample6_5、Sample6_11
-  samplerCreateInfo.anisotropyEnable = VK_FALSE;                          // 是否启用各向异性过滤
-  samplerCreateInfo.maxAnisotropy = 1;                                    // 各向异性最大过滤值
-//  samplerCreateInfo.anisotropyEnable = VK_TRUE;                           // Sample6_11
-//  samplerCreateInfo.maxAnisotropy = 8;                                    // Sample6_11
-  samplerCreateInfo.compareEnable = VK_FALSE;                             // 是否开启比较功能
-  samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;                      // 纹素数据比较操作
-  samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;     // 要使用的预定义边框颜色
-
-  for (int i = 0; i < SAMPLER_COUNT; ++i) {                               // 循环创建指定数量的采样器
-    /// Sample6_11 ************************************************* start
-//    if (i != 0) {                                                         // 第二个采样器禁用各向异性过滤
-//      samplerCreateInfo.anisotropyEnable = VK_FALSE;
-//      samplerCreateInfo.maxAnisotropy = 1;
-//    }
-    /// Sample6_11 *************************************************** end
-
-    VkSampler samplerTexture;                                             // 声明采样器对象
-    VkResult result = vk::vkCreateSampler(                                // 创建采样器
-        device, &samplerCreateInfo, nullptr, &samplerTexture);
-    assert(result == VK_SUCCESS);
-    samplerList.push_back(samplerTexture);                                // 将采样器加入列表
+  /// Sample6_4 ************************************************** start
+//  samplerList.clear();
+//  desc.magFilter = VK_FILTER_NEAREST;                                     // 0号采样器采用最近点采样方式
+//  desc.minFilter = VK_FILTER_NEAREST;
+//  samplerList.push_back(SamplerCache::get(device, desc));
+//  desc.magFilter = VK_FILTER_LINEAR;                                      // 1号采样器采用线性采样方式
+//  desc.minFilter = VK_FILTER_LINEAR;
+//  samplerList.push_back(SamplerCache::get(device, desc));
+  /// Sample6_4 **************************************************** end
+
+  /// Sample6_3 ************************************************** start
+//  samplerList.clear();
+//  VkSamplerAddressMode addressModes[4] = {                                // 重复、截取、镜像重复、边框四种拉伸方式
+//      VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+//      VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER};
+//  for (int i = 0; i < 4; ++i) {                                           // 每种拉伸方式一个采样器
+//    desc.addressMode = addressModes[i];
+//    samplerList.push_back(SamplerCache::get(device, desc));
+//  }
+  /// Sample6_3 **************************************************** end
+
+  /// 按纹理请求采样方式 ******************************************* start
+//  SamplerDesc terrainDesc;                                                // 与已有状态相同的请求共用同一个采样器
+//  terrainDesc.addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+//  textureSamplers["texture/ghxp.bntex"] = terrainDesc;
+  /// 按纹理请求采样方式 ********************************************* end
+}
+
+VkSampler TextureManager::getTextureSampler(VkDevice &device, std::string texName, int samplerIndex) {
+  std::map<std::string, SamplerDesc>::iterator request = textureSamplers.find(texName);
+  if (request != textureSamplers.end()) {                                 // 该纹理单独请求了采样方式
+    return SamplerCache::get(device, request->second);
   }
+  assert(samplerIndex >= 0 && (size_t) samplerIndex < samplerList.size());
+  return samplerList[samplerIndex];
 }
 
 void TextureManager::init_SPEC_2D_Textures(
@@ -195,6 +132,7 @@ void TextureManager::init_SPEC_2D_Textures(
     VkFormat format,
     TexDataObject *ctdo
 ) {
+  ResHandle handle = ResourceRegistry::intern(texName);                   // 加载时驻留名称, 之后按句柄访问
   VkFormatProperties formatProps;                                         // 指定格式纹理的格式属性
   vk::vkGetPhysicalDeviceFormatProperties(gpu, format, &formatProps);     // 获取指定格式纹理的格式属性
   bool needStaging = !(formatProps.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT); // 判断此格式纹理是否能使用线性瓦片纹理
@@ -202,49 +140,12 @@ void TextureManager::init_SPEC_2D_Textures(
 
   if (needStaging) {
     // 不能使用线性瓦片纹理
-    VkBuffer tempBuf;                                                     // 中转存储用的缓冲
-    VkBufferCreateInfo buf_info = {};                                     // 构建缓冲创建信息结构体实例
-    buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buf_info.pNext = nullptr;
-    buf_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;                    // 缓冲的用途为传输源
-    buf_info.size = ctdo->dataByteCount;                                  // 数据总字节数
-    buf_info.queueFamilyIndexCount = 0;                                   // 队列家族数量
-    buf_info.pQueueFamilyIndices = nullptr;                               // 队列家族索引列表
-    buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;                     // 共享模式
-    buf_info.flags = 0;
-    VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &tempBuf); // 创建缓冲
-    assert(result == VK_SUCCESS);
-
-    VkMemoryRequirements mem_reqs;                                        // 缓冲的内存需求
-    vk::vkGetBufferMemoryRequirements(device, tempBuf, &mem_reqs);        // 获取缓冲内存需求
-    assert(ctdo->dataByteCount <= mem_reqs.size);                         // 检查内存需求获取是否正确
-
-    VkMemoryAllocateInfo alloc_info = {};                                 // 构建内存分配信息结构体实例
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.pNext = nullptr;
-    alloc_info.memoryTypeIndex = 0;                                       // 内存类型索引
-    alloc_info.allocationSize = mem_reqs.size;                            // 内存总字节数
-    VkFlags requirements_mask = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |     // 需要的内存类型掩码
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    bool flag = memoryTypeFromProperties(                                 // 获取所需内存类型索引
-        memoryroperties, mem_reqs.memoryTypeBits, requirements_mask, &alloc_info.memoryTypeIndex);
-    if (flag) {
-      LOGI("确定内存类型成功 类型索引为%d", alloc_info.memoryTypeIndex);
-    } else {
-      LOGE("确定内存类型失败!");
-    }
-
-    // 分配->映射->拷贝->解除映射->绑定
-    VkDeviceMemory memTemp;                                               // 设备内存
-    result = vk::vkAllocateMemory(device, &alloc_info, nullptr, &memTemp);// 分配设备内存
-    assert(result == VK_SUCCESS);
+    VkDeviceSize stagingOffset;                                           // 数据在中转环形缓冲中的偏移量
     uint8_t *pData;                                                       // CPU访问时的辅助指针
-    result = vk::vkMapMemory(device, memTemp, 0, mem_reqs.size, 0, (void **) &pData); // 将设备内存映射为CPU可访问
-    assert(result == VK_SUCCESS);
-    memcpy(pData, ctdo->data, ctdo->dataByteCount);                       // 将纹理数据拷贝进设备内存
-    vk::vkUnmapMemory(device, memTemp);                                   // 解除内存映射
-    result = vk::vkBindBufferMemory(device, tempBuf, memTemp, 0);         // 绑定内存与缓冲
-    assert(result == VK_SUCCESS);
+    bool flag = StagingRing::allocate(                                    // 从中转环形缓冲中分配区域
+        device, ctdo->dataByteCount, STAGING_COPY_ALIGNMENT, stagingOffset, pData);
+    assert(flag);
+    memcpy(pData, ctdo->data, ctdo->dataByteCount);                       // 将纹理数据拷贝进中转缓冲
 
     VkImageCreateInfo image_create_info = {};                             // 构建图像创建信息结构体实例
     image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -259,31 +160,21 @@ void TextureManager::init_SPEC_2D_Textures(
     image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;                    // 采样模式
     image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;                   /// 采用最优瓦片组织方式
     image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;          // 初始布局
-    image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT; // 图像用途
+    image_create_info.usage =                                             // 图像用途(可作为拷贝源以便内存整理时移动)
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     image_create_info.queueFamilyIndexCount = 0;                          // 队列家族数量
     image_create_info.pQueueFamilyIndices = nullptr;                      // 队列家族索引列表
     image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;            // 共享模式
     image_create_info.flags = 0;                                          // 标志
 
     VkImage textureImage;                                                 // 纹理对应的图像
-    result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage); // 创建图像
+    VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage); // 创建图像
     assert(result == VK_SUCCESS);
-    textureImageList[texName] = textureImage;                             // 添加到纹理图像列表
-
-    VkMemoryAllocateInfo mem_alloc = {};                                  // 构建内存分配信息结构体实例
-    mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    mem_alloc.pNext = nullptr;
-    mem_alloc.allocationSize = 0;                                         // 内存总字节数
-    mem_alloc.memoryTypeIndex = 0;                                        // 内存类型索引
-    vk::vkGetImageMemoryRequirements(device, textureImage, &mem_reqs);    // 获取纹理图像内存需求
-    mem_alloc.allocationSize = mem_reqs.size;                             // 实际分配的内存字节数
-    flag = memoryTypeFromProperties(                                      // 获取内存类型索引
-        memoryroperties, mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mem_alloc.memoryTypeIndex);
-
-    VkDeviceMemory textureMemory;                                         // 纹理图像对应设备内存
-    result = vk::vkAllocateMemory(device, &mem_alloc, nullptr, &textureMemory); // 分配设备内存
-    textureMemoryList[texName] = textureMemory;                           // 添加到纹理内存列表
-    result = vk::vkBindImageMemory(device, textureImage, textureMemory, 0); // 将图像和设备内存绑定
+    ResourceRegistry::images[handle] = textureImage;                             // 添加到纹理图像列表
+    ResourceStateTracker::registerImage(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1); // 跟踪图像的布局与访问
+
+    DeviceMemoryAllocator::allocateImage(                                 // 从子分配器分配设备内存并与图像绑定
+        device, textureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, ResourceRegistry::memories[handle]);
 
     VkBufferImageCopy bufferCopyRegion = {};                              // 构建缓冲图像拷贝结构体实例
     bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // 使用方面
@@ -293,7 +184,7 @@ void TextureManager::init_SPEC_2D_Textures(
     bufferCopyRegion.imageExtent.width = ctdo->width;                     // 图像宽度
     bufferCopyRegion.imageExtent.height = ctdo->height;                   // 图像高度
     bufferCopyRegion.imageExtent.depth = 1;                               // 图像深度
-    bufferCopyRegion.bufferOffset = 0;                                    // 偏移量
+    bufferCopyRegion.bufferOffset = stagingOffset;                        // 偏移量
 
     VkCommandBufferBeginInfo cmd_buf_info = {};                           // 构建命令缓冲启动信息结构体实例
     cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -301,42 +192,19 @@ void TextureManager::init_SPEC_2D_Textures(
     cmd_buf_info.flags = 0;
     cmd_buf_info.pInheritanceInfo = nullptr;                              // 继承信息
 
-    const VkCommandBuffer cmd_bufs[] = {cmdBuffer};                       // 命令缓冲数组
-    VkSubmitInfo submit_info[1] = {};                                     // 提交信息数组
-    submit_info[0].pNext = nullptr;
-    submit_info[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info[0].waitSemaphoreCount = 0;                                // 等待的信号量数量
-    submit_info[0].pWaitSemaphores = VK_NULL_HANDLE;                      // 等待的信号量列表
-    submit_info[0].pWaitDstStageMask = VK_NULL_HANDLE;                    // 给定目标管线阶段
-    submit_info[0].commandBufferCount = 1;                                // 命令缓冲的数量
-    submit_info[0].pCommandBuffers = cmd_bufs;                            // 命令缓冲列表
-    submit_info[0].signalSemaphoreCount = 0;                              // 任务完毕后设置的信号量数量
-    submit_info[0].pSignalSemaphores = nullptr;                           // 任务完毕后设置的信号量数组
-
-    VkFenceCreateInfo fenceInfo;                                          // 栅栏创建信息结构体实例
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.pNext = nullptr;
-    fenceInfo.flags = 0;
-    VkFence copyFence;                                                    // 拷贝任务用栅栏
-    vk::vkCreateFence(device, &fenceInfo, nullptr, &copyFence);           // 创建栅栏
-
     vk::vkResetCommandBuffer(cmdBuffer, 0);                               // 清除命令缓冲
     result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);          // 启动命令缓冲(开始记录命令)
-    setImageLayout(cmdBuffer, textureImage, VK_IMAGE_ASPECT_COLOR_BIT,  // 修改图像布局(为拷贝做准备)
-                   VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_TRANSFER_WRITE); // 修改图像布局(为拷贝做准备)
+    ResourceStateTracker::flush(cmdBuffer);
     vk::vkCmdCopyBufferToImage(                                           // 将缓冲中的数据拷贝到纹理图像中
-        cmdBuffer, tempBuf, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-    setImageLayout(cmdBuffer, textureImage, VK_IMAGE_ASPECT_COLOR_BIT,  // 修改图像布局(为纹理采样准备)
-                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        cmdBuffer, StagingRing::buffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+    ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED); // 修改图像布局(为纹理采样准备)
+    ResourceStateTracker::flush(cmdBuffer);
     result = vk::vkEndCommandBuffer(cmdBuffer);                           // 结束命令缓冲(停止记录命令)
 
-    result = vk::vkQueueSubmit(queueGraphics, 1, submit_info, copyFence); // 提交给队列执行
-    do {                                                                  // 循环等待执行完毕
-      result = vk::vkWaitForFences(device, 1, &copyFence, VK_TRUE, 100000000);
-    } while (result == VK_TIMEOUT);
-    vk::vkDestroyBuffer(device, tempBuf, nullptr);                        // 销毁中转缓冲
-    vk::vkFreeMemory(device, memTemp, nullptr);                           // 释放中转缓冲的设备内存
-    vk::vkDestroyFence(device, copyFence, nullptr);                       // 销毁拷贝任务用栅栏
+    VkFence copyFence = StagingRing::submit(device, queueGraphics, cmdBuffer); // 提交给队列执行
+    StagingRing::wait(device, copyFence);                                 // 等待执行完毕(之后中转区域可被重用)
+    registerMovable(handle, image_create_info);                           // 上传已完成, 登记为可移动
   } else {
     // 能使用线性瓦片纹理
     VkImageCreateInfo image_create_info = {};                             // 构建图像创建信息结构体实例
@@ -361,27 +229,12 @@ void TextureManager::init_SPEC_2D_Textures(
     VkImage textureImage;                                                 // 纹理对应的图像
     VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage); // 创建图像
     assert(result == VK_SUCCESS);
-    textureImageList[texName] = textureImage;                             // 添加到纹理图像列表
-
-    VkMemoryAllocateInfo mem_alloc = {};                                  // 构建内存分配信息结构体实例
-    mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    mem_alloc.pNext = nullptr;
-    mem_alloc.allocationSize = 0;                                         // 内存字节数
-    mem_alloc.memoryTypeIndex = 0;                                        // 内存类型索引
-    VkMemoryRequirements mem_reqs;                                        // 纹理图像的内存需求
-    vk::vkGetImageMemoryRequirements(device, textureImage, &mem_reqs);    // 获取纹理图像的内存需求
-    mem_alloc.allocationSize = mem_reqs.size;                             // 实际分配的内存字节数
-    bool flag = memoryTypeFromProperties(                                 // 获取内存类型索引
-        memoryroperties, mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &mem_alloc.memoryTypeIndex);
-
-    VkDeviceMemory textureMemory;                                         // 创建设备内存实例
-    result = vk::vkAllocateMemory(device, &mem_alloc, nullptr, &textureMemory); // 分配设备内存
-    textureMemoryList[texName] = textureMemory;                           // 添加到纹理内存列表
-    result = vk::vkBindImageMemory(device, textureImage, textureMemory, 0); // 绑定图像和内存
-    uint8_t *pData;                                                       // CPU访问时的辅助指针
-    vk::vkMapMemory(device, textureMemory, 0, mem_reqs.size, 0, (void **) (&pData)); // 映射内存为CPU可访问
-    memcpy(pData, ctdo->data, mem_reqs.size);                             // 将纹理数据拷贝进设备内存
-    vk::vkUnmapMemory(device, textureMemory);                             // 解除内存映射
+    ResourceRegistry::images[handle] = textureImage;                             // 添加到纹理图像列表
+
+    DeviceMemoryAllocator::allocateImage(                                 // 从子分配器分配设备内存并与图像绑定
+        device, textureImage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, false, ResourceRegistry::memories[handle]);
+    memcpy(ResourceRegistry::memories[handle].mapped, ctdo->data, ctdo->dataByteCount); // 将纹理数据拷贝进设备内存(内存块保持映射)
+    DeviceMemoryAllocator::flush(device, ResourceRegistry::memories[handle]); // 内存类型不一致时刷新
   }
 
   VkImageViewCreateInfo view_info = {};                                   // 构建图像视图创建信息结构体实例
@@ -399,18 +252,18 @@ void TextureManager::init_SPEC_2D_Textures(
   view_info.subresourceRange.levelCount = 1;                              // Mipmap级别的数量
   view_info.subresourceRange.baseArrayLayer = 0;                          // 基础数组层
   view_info.subresourceRange.layerCount = 1;                              // 数组层的数量
-  view_info.image = textureImageList[texName];                            // 对应的图像
+  view_info.image = ResourceRegistry::images[handle];                            // 对应的图像
 
   VkImageView viewTexture;                                                // 纹理图像对应的图像视图
   VkResult result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
-  viewTextureList[texName] = viewTexture;                                 // 添加到图像视图列表
+  ResourceRegistry::views[handle] = viewTexture;                                 // 添加到图像视图列表
 
   VkDescriptorImageInfo texImageInfo;                                     // 构建图像描述信息结构体实例
   texImageInfo.imageView = viewTexture;                                   // 采用的图像视图
-  texImageInfo.sampler = samplerList[0];                                  // 采用的采样器
-//  texImageInfo.sampler = samplerList[imageSampler[texName]];              // Sample6_3、Sample6_4
+  texImageInfo.sampler = getTextureSampler(device, texName, 0);           // 采用的采样器
+//  texImageInfo.sampler = getTextureSampler(device, texName, imageSampler[texName]); // Sample6_3、Sample6_4
   texImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;                     // 图像布局
-  texImageInfoList[texName] = texImageInfo;                               // 添加到纹理图像描述信息列表
+  ResourceRegistry::imageInfos[handle] = texImageInfo;                               // 添加到纹理图像描述信息列表
 
   delete ctdo;                                                            // 删除内存中的纹理数据
 }
@@ -427,6 +280,7 @@ void TextureManager::init_SPEC_Textures_ForMipMap(
     int levels,
     int samplerIndex                                                      // Sample6_11
 ) {
+  ResHandle handle = ResourceRegistry::intern(texName);                   // 加载时驻留名称, 之后按句柄访问
   VkImageCreateInfo image_create_info = {};
   image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   image_create_info.pNext = nullptr;
@@ -450,62 +304,18 @@ void TextureManager::init_SPEC_Textures_ForMipMap(
   VkImage textureImage;
   VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage);
   assert(result == VK_SUCCESS);
-  textureImageList[texName] = textureImage;
-
-  VkMemoryAllocateInfo mem_alloc = {};
-  mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  mem_alloc.pNext = nullptr;
-  mem_alloc.allocationSize = 0;
-  mem_alloc.memoryTypeIndex = 0;
-  VkMemoryRequirements mem_reqs;
-  vk::vkGetImageMemoryRequirements(device, textureImage, &mem_reqs);
-  mem_alloc.allocationSize = mem_reqs.size;
-  LOGI("IMG mem_reqs.size=%d", (int) (mem_reqs.size));
-  bool flag = memoryTypeFromProperties(memoryroperties, mem_reqs.memoryTypeBits, 0, &mem_alloc.memoryTypeIndex);
-  assert(flag);
+  ResourceRegistry::images[handle] = textureImage;
+  ResourceStateTracker::registerImage(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, levels, 1);
 
-  VkDeviceMemory textureMemory;
-  result = vk::vkAllocateMemory(device, &mem_alloc, nullptr, &(textureMemory));
-  assert(result == VK_SUCCESS);
-  textureMemoryList[texName] = textureMemory;
-  result = vk::vkBindImageMemory(device, textureImage, textureMemory, 0);
-  assert(result == VK_SUCCESS);
-
-  /// 创建缓冲，将纹理数据首先搞进缓冲，然后传输进纹理
-  VkBuffer stagingBuffer;
-  VkBufferCreateInfo bufferCreateInfo = {};
-  bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferCreateInfo.pNext = nullptr;
-  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  bufferCreateInfo.size = ctdo->dataByteCount;
-  bufferCreateInfo.queueFamilyIndexCount = 0;
-  bufferCreateInfo.pQueueFamilyIndices = nullptr;
-  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  bufferCreateInfo.flags = 0;
-  result = vk::vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer);
-  assert(result == VK_SUCCESS);
-
-  VkMemoryRequirements memReqs = {};
-  vk::vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-  VkMemoryAllocateInfo memAllocInfo = {};
-  memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  memAllocInfo.pNext = nullptr;
-  memAllocInfo.memoryTypeIndex = 0;
-  memAllocInfo.allocationSize = memReqs.size;
-  memoryTypeFromProperties(memoryroperties, memReqs.memoryTypeBits,
-                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                           &memAllocInfo.memoryTypeIndex);
-
-  VkDeviceMemory stagingMemory;
-  result = vk::vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory);
-  assert(result == VK_SUCCESS);
-  result = vk::vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
-  assert(result == VK_SUCCESS);
+  DeviceMemoryAllocator::allocateImage(device, textureImage, 0, true, ResourceRegistry::memories[handle]);
+  LOGI("IMG mem_reqs.size = %d", (int) ResourceRegistry::memories[handle].size);
 
+  /// 将纹理数据首先搞进中转环形缓冲，然后传输进纹理
+  VkDeviceSize stagingOffset;
   uint8_t *pData;
-  vk::vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **) (&pData));
-  memcpy(pData, ctdo->data, memReqs.size);
-  vk::vkUnmapMemory(device, stagingMemory);
+  bool flag = StagingRing::allocate(device, ctdo->dataByteCount, STAGING_COPY_ALIGNMENT, stagingOffset, pData);
+  assert(flag);
+  memcpy(pData, ctdo->data, ctdo->dataByteCount);
 
   VkBufferImageCopy bufferCopyRegion = {};
   bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -515,7 +325,7 @@ void TextureManager::init_SPEC_Textures_ForMipMap(
   bufferCopyRegion.imageExtent.width = ctdo->width;
   bufferCopyRegion.imageExtent.height = ctdo->height;
   bufferCopyRegion.imageExtent.depth = 1;
-  bufferCopyRegion.bufferOffset = 0;
+  bufferCopyRegion.bufferOffset = stagingOffset;
 
   VkCommandBufferBeginInfo cmd_buf_info = {};
   cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -523,35 +333,17 @@ void TextureManager::init_SPEC_Textures_ForMipMap(
   cmd_buf_info.flags = 0;
   cmd_buf_info.pInheritanceInfo = nullptr;
 
-  const VkCommandBuffer cmd_bufs[] = {cmdBuffer};
-  VkSubmitInfo submit_info[1] = {};
-  submit_info[0].pNext = nullptr;
-  submit_info[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info[0].waitSemaphoreCount = 0;
-  submit_info[0].pWaitSemaphores = VK_NULL_HANDLE;
-  submit_info[0].pWaitDstStageMask = VK_NULL_HANDLE;
-  submit_info[0].commandBufferCount = 1;
-  submit_info[0].pCommandBuffers = cmd_bufs;
-  submit_info[0].signalSemaphoreCount = 0;
-  submit_info[0].pSignalSemaphores = nullptr;
-
-  VkFenceCreateInfo fenceInfo;
-  VkFence copyFence;
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.pNext = nullptr;
-  fenceInfo.flags = 0;
-  vk::vkCreateFence(device, &fenceInfo, nullptr, &copyFence);
-
   vk::vkResetCommandBuffer(cmdBuffer, 0);
   result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);
-  setImageLayout(cmdBuffer, textureImage, VK_IMAGE_ASPECT_COLOR_BIT,
-                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_TRANSFER_WRITE, 0, 1);
+  ResourceStateTracker::flush(cmdBuffer);
   vk::vkCmdCopyBufferToImage(
-      cmdBuffer, stagingBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-  setImageLayout(cmdBuffer, textureImage, VK_IMAGE_ASPECT_COLOR_BIT,
-                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+      cmdBuffer, StagingRing::buffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 
   for (int32_t i = 1; i < levels; ++i) {                                  // 遍历所有mipmap级数
+    ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_TRANSFER_READ, i - 1, 1); // 上一级别作为blit源
+    ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_TRANSFER_WRITE, i, 1); // 本级别作为blit目标
+    ResourceStateTracker::flush(cmdBuffer);                               // 两个屏障合并为一次调用
     VkImageBlit imageBlit{};                                              // 创建图像blit实例
     imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;      // 使用方面
     imageBlit.srcSubresource.layerCount = 1;                              // 源资源的层数量
@@ -576,15 +368,12 @@ void TextureManager::init_SPEC_Textures_ForMipMap(
         VK_FILTER_LINEAR                                                  // 要应用的纹理采样过滤器
     );
   }
+  ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED); // 所有级别转为采样布局
+  ResourceStateTracker::flush(cmdBuffer);
 
   result = vk::vkEndCommandBuffer(cmdBuffer);                             // 结束命令缓冲(停止记录命令)
-  result = vk::vkQueueSubmit(queueGraphics, 1, submit_info, copyFence);   // 提交给队列执行
-  do {
-    result = vk::vkWaitForFences(device, 1, &copyFence, VK_TRUE, 100000000);
-  } while (result == VK_TIMEOUT);
-  vk::vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vk::vkFreeMemory(device, stagingMemory, nullptr);
-  vk::vkDestroyFence(device, copyFence, nullptr);
+  VkFence copyFence = StagingRing::submit(device, queueGraphics, cmdBuffer); // 提交给队列执行
+  StagingRing::wait(device, copyFence);                                   // 等待执行完毕
 
   VkImageViewCreateInfo view_info = {};
   view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -600,18 +389,18 @@ void TextureManager::init_SPEC_Textures_ForMipMap(
   view_info.subresourceRange.levelCount = levels;
   view_info.subresourceRange.baseArrayLayer = 0;
   view_info.subresourceRange.layerCount = 1;
-  view_info.image = textureImageList[texName];
+  view_info.image = ResourceRegistry::images[handle];
 
   VkImageView viewTexture;
   result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
-  viewTextureList[texName] = viewTexture;
+  ResourceRegistry::views[handle] = viewTexture;
 
   VkDescriptorImageInfo texImageInfo;
   texImageInfo.imageView = viewTexture;
-//  texImageInfo.sampler = samplerList[0];
-  texImageInfo.sampler = samplerList[samplerIndex];                       // Sample6_11
-  texImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-  texImageInfoList[texName] = texImageInfo;
+//  texImageInfo.sampler = getTextureSampler(device, texName, 0);
+  texImageInfo.sampler = getTextureSampler(device, texName, samplerIndex); // Sample6_11
+  texImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // 与屏障转换后的布局一致
+  ResourceRegistry::imageInfos[handle] = texImageInfo;
 
   delete ctdo;
 }
@@ -619,9 +408,13 @@ void TextureManager::init_SPEC_Textures_ForMipMap(
 void TextureManager::initTextures(VkDevice &device,
                                   VkPhysicalDevice &gpu,
                                   VkPhysicalDeviceMemoryProperties &memoryroperties,
+                                  VkCommandPool &cmdPool,
                                   VkCommandBuffer &cmdBuffer,
                                   VkQueue &queueGraphics) {
   initSampler(device, gpu);                                         // 初始化采样器
+  texHandles = internNames(texNames);                                     // 驻留纹理名称并分配描述集索引
+//  texHandlesPair = internNames(texNamesPair);                             // Sample6_6
+//  texHandlesSingle = internNames(texNamesSingle);                         // Sample6_6(月球纹理的描述集索引优先)
 
   /// Sample6_5、Sample6_11 ************************************** start
 //  VkFormatProperties formatProps;                                         // 指定格式纹理的格式属性
@@ -630,14 +423,41 @@ void TextureManager::initTextures(VkDevice &device,
 //  assert(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
   /// Sample6_5、Sample6_11 **************************************** end
 
+  std::vector<TexDataObject *> decoded(texNames.size(), nullptr);         // 各纹理文件数据(在作业中并行读取)
+  JobCounter decodeCounter;
+  for (size_t i = 0; i < texNames.size(); ++i) {
+    if (atlasSources.count(texNames[i]) > 0 || hasExtension(texNames[i], ".bn3dtex") ||
+        hasExtension(texNames[i], ".bntexa")) {                           // 纹理图集与分层纹理在下面逐个加载
+      continue;
+    }
+    JobSystem::run([&decoded, i] {
+      decoded[i] = FileUtil::loadCommonTexData(texNames[i]);              // 加载纹理文件数据
+//      decoded[i] = FileUtil::load_RGBA8_ETC2_EAC_TexData(texNames[i]);    // Sample6_7-加载ETC2压缩格式纹理文件数据
+    }, &decodeCounter);
+  }
+  JobSystem::wait(&decodeCounter);                                        // 上传只能在渲染线程中进行
+
   for (int i = 0; i < texNames.size(); ++i) {                             // 遍历纹理文件名称列表
+    if (atlasSources.count(texNames[i]) > 0) {                            // 纹理图集
+      init_SPEC_Atlas_Texture(texNames[i], device, gpu, memoryroperties, cmdBuffer, queueGraphics, 0);
+      continue;
+    }
+    bool is3D = hasExtension(texNames[i], ".bn3dtex");                    // Sample6_9为3D纹理, Sample6_10为纹理数组
+    if (is3D || hasExtension(texNames[i], ".bntexa")) {                   // 分层纹理按切片流式加载(改为整体加载时注释掉此段)
+      TexSliceStream *stream = FileUtil::openTexSliceStream(texNames[i]); // 仅读取文件头
+      LOGI("%s: width=%d height=%d slices=%d", texNames[i].c_str(), stream->width, stream->height, stream->sliceCount);
+      init_SPEC_Layered_Textures_Streaming(texNames[i], device, gpu, memoryroperties, cmdPool, queueGraphics,
+                                           VK_FORMAT_R8G8B8A8_UNORM, stream, is3D);
+      continue;
+    }
 //    imageSampler[texNames[i]] = i;                                        // Sample6_3-设置对应纹理的采样器索引
 //    imageSampler[texNames[i]] = i % 2;                                    // Sample6_4
-    TexDataObject *ctdo = FileUtil::loadCommonTexData(texNames[i]); // 加载纹理文件数据
-//    TexDataObject *ctdo = FileUtil::load_RGBA8_ETC2_EAC_TexData(texNames[i]); // Sample6_7-加载ETC2压缩格式纹理文件数据
+    TexDataObject *ctdo = decoded[i];                                     // 作业中读取的纹理文件数据
     LOGI("%s: width=%d height=%d", texNames[i].c_str(), ctdo->width, ctdo->height); // 打印纹理数据信息
-    init_SPEC_2D_Textures(                                                // 加载2D纹理
-        texNames[i], device, gpu, memoryroperties, cmdBuffer, queueGraphics, VK_FORMAT_R8G8B8A8_UNORM, ctdo);
+    addToUploadBatch(texNames[i], VK_FORMAT_R8G8B8A8_UNORM, ctdo);        // 加入批量上传列表
+//    addToUploadBatch(texNames[i], VK_FORMAT_R8G8B8A8_UNORM, ctdo, imageSampler[texNames[i]]); // Sample6_3、Sample6_4
+//    init_SPEC_2D_Textures(                                                // 逐个加载2D纹理
+//        texNames[i], device, gpu, memoryroperties, cmdBuffer, queueGraphics, VK_FORMAT_R8G8B8A8_UNORM, ctdo);
 //    init_SPEC_2D_Textures(                                                // Sample6_7-加载ETC2压缩格式2D纹理
 //        texNames[i], device, gpu, memoryroperties, cmdBuffer, queueGraphics, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, ctdo);
 //    int levels = floor(log2(max(ctdo->width, ctdo->height))) + 1;         // Sample6_5、Sample6_11-计算mipmap层次数
@@ -645,6 +465,10 @@ void TextureManager::initTextures(VkDevice &device,
 //    init_SPEC_Textures_ForMipMap(texNames[i], device, gpu,                // Sample6_5、Sample6_11-加载2D纹理并生成MipMap
 //                                 memoryroperties, cmdBuffer, queueGraphics, VK_FORMAT_R8G8B8A8_UNORM, ctdo, levels,
 //                                 i);                                       // Sample6_11
+//    MipmapOptions mipmapOptions;                                          // Sample6_5、Sample6_11-CPU端生成MipMap
+//    mipmapOptions.filter = MIPMAP_FILTER_KAISER;                          // 过滤器
+//    init_SPEC_Textures_CpuMipMap(texNames[i], device, gpu, memoryroperties, cmdBuffer, queueGraphics,
+//                                 VK_FORMAT_R8G8B8A8_UNORM, ctdo, levels, i, mipmapOptions);
 
     /// Sample6_9 ************************************************** start
 //    ThreeDTexDataObject *ctdo = FileUtil::load3DTexData(texNames[i]);
@@ -660,33 +484,46 @@ void TextureManager::initTextures(VkDevice &device,
 //        texNames[i], device, gpu, memoryroperties, cmdBuffer, queueGraphics, VK_FORMAT_R8G8B8A8_UNORM, ctdo);
     /// Sample6_10 *************************************************** end
   }
+  flushUploadBatch(device, gpu, memoryroperties, cmdBuffer, queueGraphics); // 一次上传所有2D纹理
 }
 
 void TextureManager::destroyTextures(VkDevice &device) {
-  for (int i = 0; i < SAMPLER_COUNT; ++i) {                               // 遍历所有采样器
-    vk::vkDestroySampler(device, samplerList[i], nullptr);                // 销毁采样器
-  }
-  for (int i = 0; i < texNames.size(); ++i) {                             // 遍历所有纹理
-    vk::vkDestroyImageView(device, viewTextureList[texNames[i]], nullptr); // 销毁图像视图
-    vk::vkDestroyImage(device, textureImageList[texNames[i]], nullptr);   // 销毁图像
-    vk::vkFreeMemory(device, textureMemoryList[texNames[i]], nullptr);    // 释放设备内存
+  SamplerCache::destroy(device);                                          // 销毁所有采样器(列表中的采样器由缓存持有)
+  samplerList.clear();
+  for (ResHandle handle = 0; handle < ResourceRegistry::size(); ++handle) { // 遍历所有已加载的纹理
+    if (!ResourceRegistry::loaded(handle)) {
+      continue;
+    }
+    DeviceMemoryDefragmenter::unregister(ResourceRegistry::movableIds[handle]); // 取消内存整理的登记
+    vk::vkDestroyImageView(device, ResourceRegistry::views[handle], nullptr); // 销毁图像视图
+    ResourceStateTracker::forgetImage(ResourceRegistry::images[handle]); // 停止跟踪图像状态
+    vk::vkDestroyImage(device, ResourceRegistry::images[handle], nullptr); // 销毁图像
+    DeviceMemoryAllocator::free(device, ResourceRegistry::memories[handle]); // 释放设备内存
+    ResourceRegistry::release(handle);
   }
 }
 
 int TextureManager::getVkDescriptorSetIndex(std::string texName) {
-  int result = -1;
-  for (int i = 0; i < texNames.size(); ++i) {                             // 遍历所有纹理
-    if (texNames[i].compare(texName.c_str()) == 0) {                      // 判断名称是否相同
-//  for (int i = 0; i < texNamesSingle.size(); ++i) {                       // Sample6_6
-//    if (texNamesSingle[i].compare(texName.c_str()) == 0) {                // Sample6_6
-      result = i;                                                         // 以当前索引值为结果
-      break;
-    }
-  }
+  ResHandle handle = ResourceRegistry::find(texName);                     // 仅在加载时使用, 帧内请传入句柄
+  assert(handle != RES_HANDLE_INVALID);
+  return getVkDescriptorSetIndex(handle);
+}
+
+int TextureManager::getVkDescriptorSetIndex(ResHandle handle) {
+  int result = ResourceRegistry::descSetIndices[handle];                  // 图集中的子纹理在加载时已指向图集的描述集
   assert(result != -1);
   return result;
 }
 
+std::vector<ResHandle> TextureManager::internNames(const std::vector<std::string> &names) {
+  std::vector<ResHandle> handles(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {                             // 按列表下标分配描述集索引
+    handles[i] = ResourceRegistry::intern(names[i]);
+    ResourceRegistry::descSetIndices[handles[i]] = (int) i;
+  }
+  return handles;
+}
+
 //void TextureManager::init_SPEC_3D_Textures(                               // Sample6_9-加载3D纹理
 void TextureManager::init_SPEC_2DArray_Textures(                          // Sample6_10-加载2D纹理数组
     std::string texName,
@@ -698,41 +535,13 @@ void TextureManager::init_SPEC_2DArray_Textures(                          // Sam
     VkFormat format,
 //    ThreeDTexDataObject *ctdo) {                                          // Sample6_9-加载3D纹理
     TexArrayDataObject *ctdo) {                                           // Sample6_10-加载2D纹理数组
-  // 创建缓冲，将纹理数据首先搞进缓冲，然后传输进纹理
-  VkBuffer stagingBuffer;
-  VkBufferCreateInfo bufferCreateInfo = {};
-  bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferCreateInfo.pNext = nullptr;
-  bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  bufferCreateInfo.size = ctdo->dataByteCount;
-  bufferCreateInfo.queueFamilyIndexCount = 0;
-  bufferCreateInfo.pQueueFamilyIndices = nullptr;
-  bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  bufferCreateInfo.flags = 0;
-  VkResult result = vk::vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer);
-  assert(result == VK_SUCCESS);
-
-  VkMemoryRequirements memReqs = {};
-  vk::vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-  VkMemoryAllocateInfo memAllocInfo = {};
-  memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  memAllocInfo.pNext = nullptr;
-  memAllocInfo.memoryTypeIndex = 0;
-  memAllocInfo.allocationSize = memReqs.size;
-  memoryTypeFromProperties(memoryProperties,
-                           memReqs.memoryTypeBits,
-                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                           &memAllocInfo.memoryTypeIndex);
-  VkDeviceMemory stagingMemory;
-  result = vk::vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory);
-  assert(result == VK_SUCCESS);
-  result = vk::vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
-  assert(result == VK_SUCCESS);
-
+  ResHandle handle = ResourceRegistry::intern(texName);                   // 加载时驻留名称, 之后按句柄访问
+  // 将纹理数据首先搞进中转环形缓冲，然后传输进纹理
+  VkDeviceSize stagingOffset;
   uint8_t *pData;
-  vk::vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **) (&pData));
-  memcpy(pData, ctdo->data, memReqs.size);
-  vk::vkUnmapMemory(device, stagingMemory);
+  bool flag = StagingRing::allocate(device, ctdo->dataByteCount, STAGING_COPY_ALIGNMENT, stagingOffset, pData);
+  assert(flag);
+  memcpy(pData, ctdo->data, ctdo->dataByteCount);
 
   VkImageCreateInfo image_create_info = {};                               // 构建图像创建信息结构体实例
   image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -756,25 +565,13 @@ void TextureManager::init_SPEC_2DArray_Textures(                          // Sam
   image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   image_create_info.flags = 0;
   VkImage textureImage;
-  result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage);
-  assert(result == VK_SUCCESS);
-  textureImageList[texName] = textureImage;
-
-  VkMemoryAllocateInfo mem_alloc = {};
-  mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  mem_alloc.pNext = nullptr;
-  mem_alloc.allocationSize = 0;
-  mem_alloc.memoryTypeIndex = 0;
-  VkMemoryRequirements mem_reqs;
-  vk::vkGetImageMemoryRequirements(device, textureImage, &mem_reqs);
-  mem_alloc.allocationSize = mem_reqs.size;
-  LOGI("mem_reqs.size = %d", (int) mem_reqs.size);
-  bool flag = memoryTypeFromProperties(memoryProperties, mem_reqs.memoryTypeBits, 0, &mem_alloc.memoryTypeIndex);
-  VkDeviceMemory textureMemory;
-  result = vk::vkAllocateMemory(device, &mem_alloc, nullptr, &textureMemory);
-  textureMemoryList[texName] = textureMemory;
-  result = vk::vkBindImageMemory(device, textureImage, textureMemory, 0);
+  VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage);
   assert(result == VK_SUCCESS);
+  ResourceRegistry::images[handle] = textureImage;
+  ResourceStateTracker::registerImage(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, 1, ctdo->length); // Sample6_10
+
+  DeviceMemoryAllocator::allocateImage(device, textureImage, 0, true, ResourceRegistry::memories[handle]);
+  LOGI("mem_reqs.size = %d", (int) ResourceRegistry::memories[handle].size);
 
   VkBufferImageCopy bufferCopyRegion = {};                                // 构建缓冲图像拷贝结构体实例
   bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // 使用方面
@@ -786,6 +583,7 @@ void TextureManager::init_SPEC_2DArray_Textures(                          // Sam
   bufferCopyRegion.imageExtent.height = ctdo->height;                     // 图像高度
 //  bufferCopyRegion.imageExtent.depth = ctdo->depth;                       // 图像深度
   bufferCopyRegion.imageExtent.depth = 1;                                 // Sample6_10
+  bufferCopyRegion.bufferOffset = stagingOffset;                         // 数据在中转缓冲中的偏移量
 
   VkCommandBufferBeginInfo cmd_buf_info = {};
   cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -793,53 +591,21 @@ void TextureManager::init_SPEC_2DArray_Textures(                          // Sam
   cmd_buf_info.flags = 0;
   cmd_buf_info.pInheritanceInfo = nullptr;
 
-  const VkCommandBuffer cmd_bufs[] = {cmdBuffer};
-  VkSubmitInfo submit_info[1] = {};
-  submit_info[0].pNext = nullptr;
-  submit_info[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info[0].waitSemaphoreCount = 0;
-  submit_info[0].pWaitSemaphores = VK_NULL_HANDLE;
-  submit_info[0].pWaitDstStageMask = VK_NULL_HANDLE;
-  submit_info[0].commandBufferCount = 1;
-  submit_info[0].pCommandBuffers = cmd_bufs;
-  submit_info[0].signalSemaphoreCount = 0;
-  submit_info[0].pSignalSemaphores = nullptr;
-
-  VkFenceCreateInfo fenceInfo;
-  VkFence copyFence;
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.pNext = nullptr;
-  fenceInfo.flags = 0;
-  vk::vkCreateFence(device, &fenceInfo, nullptr, &copyFence);
   vk::vkResetCommandBuffer(cmdBuffer, 0);
   result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);
-  setImageLayout(cmdBuffer,
-                 textureImage,
-                 VK_IMAGE_ASPECT_COLOR_BIT,
-                 VK_IMAGE_LAYOUT_UNDEFINED,
-                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                 ctdo->length);                                           // Sample6_10
+  ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_TRANSFER_WRITE); // 所有数组层(Sample6_10)
+  ResourceStateTracker::flush(cmdBuffer);
   vk::vkCmdCopyBufferToImage(cmdBuffer,
-                             stagingBuffer,
+                             StagingRing::buffer,
                              textureImage,
                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                              1,
                              &bufferCopyRegion);
-  setImageLayout(cmdBuffer,
-                 textureImage,
-                 VK_IMAGE_ASPECT_COLOR_BIT,
-                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                 ctdo->length);                                           // Sample6_10
+  ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED); // Sample6_10
+  ResourceStateTracker::flush(cmdBuffer);
   result = vk::vkEndCommandBuffer(cmdBuffer);
-  result = vk::vkQueueSubmit(queueGraphics, 1, submit_info, copyFence);
-  do {
-    result = vk::vkWaitForFences(device, 1, &copyFence, VK_TRUE, 100000000);
-  } while (result == VK_TIMEOUT);
-
-  vk::vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vk::vkFreeMemory(device, stagingMemory, nullptr);
-  vk::vkDestroyFence(device, copyFence, nullptr);
+  VkFence copyFence = StagingRing::submit(device, queueGraphics, cmdBuffer);
+  StagingRing::wait(device, copyFence);
 
   VkImageViewCreateInfo view_info = {};                                   // 构建图像视图创建信息结构体实例
   view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -857,17 +623,646 @@ void TextureManager::init_SPEC_2DArray_Textures(                          // Sam
   view_info.subresourceRange.baseArrayLayer = 0;
 //  view_info.subresourceRange.layerCount = 1;
   view_info.subresourceRange.layerCount = ctdo->length;                   // Sample6_10
-  view_info.image = textureImageList[texName];
+  view_info.image = ResourceRegistry::images[handle];
   VkImageView viewTexture;
   result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
   assert(result == VK_SUCCESS);
-  viewTextureList[texName] = viewTexture;
+  ResourceRegistry::views[handle] = viewTexture;
 
   VkDescriptorImageInfo texImageInfo;
   texImageInfo.imageView = viewTexture;
-  texImageInfo.sampler = samplerList[0];
+  texImageInfo.sampler = getTextureSampler(device, texName, 0);
   texImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  texImageInfoList[texName] = texImageInfo;
+  ResourceRegistry::imageInfos[handle] = texImageInfo;
 
   delete ctdo;
 }
+
+void TextureManager::init_SPEC_Layered_Textures_Streaming(
+    std::string texName,
+    VkDevice &device,
+    VkPhysicalDevice &gpu,
+    VkPhysicalDeviceMemoryProperties &memoryProperties,
+    VkCommandPool &cmdPool,
+    VkQueue &queueGraphics,
+    VkFormat format,
+    TexSliceStream *stream,
+    bool is3D) {
+  ResHandle handle = ResourceRegistry::intern(texName);                   // 加载时驻留名称, 之后按句柄访问
+  int slicesPerBatch = STREAM_STAGING_BYTES / stream->sliceByteCount;     // 每批上传的切片数量
+  if (slicesPerBatch < 1) {                                               // 单个切片超过中转缓冲大小时每批一个切片
+    slicesPerBatch = 1;
+  }
+  VkDeviceSize stagingSize = (VkDeviceSize) slicesPerBatch * stream->sliceByteCount; // 每批占用的中转区域字节数
+  assert(stagingSize <= StagingRing::capacity);
+  LOGI("%s: 流式加载 每批%d个切片 中转区域%d字节", texName.c_str(), slicesPerBatch, (int) stagingSize);
+
+  VkImageCreateInfo image_create_info = {};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.pNext = nullptr;
+  image_create_info.imageType = is3D ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+  image_create_info.format = format;
+  image_create_info.extent.width = stream->width;
+  image_create_info.extent.height = stream->height;
+  image_create_info.extent.depth = is3D ? stream->sliceCount : 1;        // 3D纹理切片为深度
+  image_create_info.mipLevels = 1;
+  image_create_info.arrayLayers = is3D ? 1 : stream->sliceCount;          // 纹理数组切片为数组层
+  image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  image_create_info.queueFamilyIndexCount = 0;
+  image_create_info.pQueueFamilyIndices = nullptr;
+  image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_create_info.flags = 0;
+  VkImage textureImage;
+  VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage);
+  assert(result == VK_SUCCESS);
+  ResourceRegistry::images[handle] = textureImage;
+  ResourceStateTracker::registerImage(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, 1, is3D ? 1 : stream->sliceCount);
+
+  DeviceMemoryAllocator::allocateImage(
+      device, textureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, ResourceRegistry::memories[handle]);
+
+  VkCommandBufferBeginInfo cmd_buf_info = {};
+  cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmd_buf_info.pNext = nullptr;
+  cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  cmd_buf_info.pInheritanceInfo = nullptr;
+
+  VkCommandBufferAllocateInfo cmdBAI = {};
+  cmdBAI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBAI.pNext = nullptr;
+  cmdBAI.commandPool = cmdPool;
+  cmdBAI.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBAI.commandBufferCount = STREAM_BATCH_SLOTS;
+  VkCommandBuffer slotCmdBuffers[STREAM_BATCH_SLOTS];                     // 各批轮流使用的命令缓冲
+  result = vk::vkAllocateCommandBuffers(device, &cmdBAI, slotCmdBuffers);
+  assert(result == VK_SUCCESS);
+  VkFence slotFences[STREAM_BATCH_SLOTS];                                 // 各命令缓冲最近一次提交的栅栏
+  for (int i = 0; i < STREAM_BATCH_SLOTS; ++i) {
+    slotFences[i] = VK_NULL_HANDLE;
+  }
+
+  int layerCount = is3D ? 1 : stream->sliceCount;                         // 布局转换涉及的数组层数量
+  int sliceIndex = 0;                                                     // 下一批的起始切片
+  int batchIndex = 0;                                                     // 下一批的序号
+  VkFence copyFence = VK_NULL_HANDLE;                                     // 最后一批拷贝任务的栅栏
+  while (sliceIndex < stream->sliceCount) {
+    VkDeviceSize stagingOffset;
+    uint8_t *pData;
+    bool flag = StagingRing::allocate(device, stagingSize, STAGING_COPY_ALIGNMENT, stagingOffset, pData);
+    assert(flag);
+    int count = stream->readSlices(pData, slicesPerBatch);                // 将本批切片直接读入中转缓冲(与之前各批的拷贝重叠)
+    assert(count > 0);
+    if (count <= 0) {
+      break;
+    }
+
+    VkBufferImageCopy bufferCopyRegion = {};                              // 本批切片的拷贝区域
+    bufferCopyRegion.bufferOffset = stagingOffset;
+    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bufferCopyRegion.imageSubresource.mipLevel = 0;
+    bufferCopyRegion.imageSubresource.baseArrayLayer = is3D ? 0 : sliceIndex;
+    bufferCopyRegion.imageSubresource.layerCount = is3D ? 1 : count;
+    bufferCopyRegion.imageOffset.z = is3D ? sliceIndex : 0;
+    bufferCopyRegion.imageExtent.width = stream->width;
+    bufferCopyRegion.imageExtent.height = stream->height;
+    bufferCopyRegion.imageExtent.depth = is3D ? count : 1;
+
+    VkCommandBuffer &cmdBuffer = slotCmdBuffers[batchIndex % STREAM_BATCH_SLOTS];
+    VkFence &slotFence = slotFences[batchIndex % STREAM_BATCH_SLOTS];
+    if (slotFence != VK_NULL_HANDLE) {                                    // 只等待该命令缓冲STREAM_BATCH_SLOTS批之前的提交
+      StagingRing::wait(device, slotFence);
+    }
+    vk::vkResetCommandBuffer(cmdBuffer, 0);
+    result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);
+    if (sliceIndex == 0) {                                                // 第一批前转换整个图像的布局
+      ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_TRANSFER_WRITE, 0, 1, 0, layerCount);
+      ResourceStateTracker::flush(cmdBuffer);
+    }
+    vk::vkCmdCopyBufferToImage(cmdBuffer, StagingRing::buffer, textureImage, // 每批切片一次拷贝
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+    sliceIndex += count;
+    if (sliceIndex == stream->sliceCount) {                               // 最后一批后转换为着色器只读布局
+      ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED, 0, 1, 0, layerCount);
+      ResourceStateTracker::flush(cmdBuffer);
+    }
+    result = vk::vkEndCommandBuffer(cmdBuffer);
+    copyFence = StagingRing::submit(device, queueGraphics, cmdBuffer);
+    slotFence = copyFence;
+    batchIndex++;
+  }
+  if (copyFence != VK_NULL_HANDLE) {                                      // 等待最后一批(及之前所有批)拷贝完成
+    StagingRing::wait(device, copyFence);
+  }
+  vk::vkFreeCommandBuffers(device, cmdPool, STREAM_BATCH_SLOTS, slotCmdBuffers);
+
+  VkImageViewCreateInfo view_info = {};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.pNext = nullptr;
+  view_info.viewType = is3D ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+  view_info.format = format;
+  view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+  view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+  view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+  view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = 1;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = layerCount;
+  view_info.image = textureImage;
+  VkImageView viewTexture;
+  result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
+  assert(result == VK_SUCCESS);
+  ResourceRegistry::views[handle] = viewTexture;
+
+  VkDescriptorImageInfo texImageInfo;
+  texImageInfo.imageView = viewTexture;
+  texImageInfo.sampler = getTextureSampler(device, texName, 0);
+  texImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  ResourceRegistry::imageInfos[handle] = texImageInfo;
+
+  delete stream;                                                          // 关闭纹理文件
+}
+
+void TextureManager::init_SPEC_Textures_CpuMipMap(
+    std::string texName,
+    VkDevice &device,
+    VkPhysicalDevice &gpu,
+    VkPhysicalDeviceMemoryProperties &memoryroperties,
+    VkCommandBuffer &cmdBuffer,
+    VkQueue &queueGraphics,
+    VkFormat format,
+    TexDataObject *ctdo,
+    int levels,
+    int samplerIndex,
+    const MipmapOptions &options
+) {
+  ResHandle handle = ResourceRegistry::intern(texName);                   // 加载时驻留名称, 之后按句柄访问
+  std::vector<int> levelOffsets;                                          // 各级数据在mipmap链中的偏移量
+  TexDataObject *chain = MipmapGenerator::generate(ctdo, levels, levelOffsets, options); // CPU端生成mipmap链
+  levels = (int) levelOffsets.size();
+
+  VkImageCreateInfo image_create_info = {};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.pNext = nullptr;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.format = format;
+  image_create_info.extent.width = ctdo->width;
+  image_create_info.extent.height = ctdo->height;
+  image_create_info.extent.depth = 1;
+  image_create_info.mipLevels = levels;
+  image_create_info.arrayLayers = 1;
+  image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // 不再需要作为blit源
+  image_create_info.queueFamilyIndexCount = 0;
+  image_create_info.pQueueFamilyIndices = nullptr;
+  image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_create_info.flags = 0;
+
+  VkImage textureImage;
+  VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage);
+  assert(result == VK_SUCCESS);
+  ResourceRegistry::images[handle] = textureImage;
+  ResourceStateTracker::registerImage(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, levels, 1);
+
+  DeviceMemoryAllocator::allocateImage(
+      device, textureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, ResourceRegistry::memories[handle]);
+
+  /// 将整条mipmap链放入中转环形缓冲, 然后一次传输进纹理的各级
+  VkDeviceSize stagingOffset;
+  uint8_t *pData;
+  bool flag = StagingRing::allocate(device, chain->dataByteCount, STAGING_COPY_ALIGNMENT, stagingOffset, pData);
+  assert(flag);
+  memcpy(pData, chain->data, chain->dataByteCount);
+
+  std::vector<VkBufferImageCopy> bufferCopyRegions(levels);               // 每级一个拷贝区域
+  for (int i = 0; i < levels; ++i) {
+    VkBufferImageCopy &region = bufferCopyRegions[i];
+    region = {};
+    region.bufferOffset = stagingOffset + levelOffsets[i];
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = i;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = std::max(1, ctdo->width >> i);
+    region.imageExtent.height = std::max(1, ctdo->height >> i);
+    region.imageExtent.depth = 1;
+  }
+
+  VkCommandBufferBeginInfo cmd_buf_info = {};
+  cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmd_buf_info.pNext = nullptr;
+  cmd_buf_info.flags = 0;
+  cmd_buf_info.pInheritanceInfo = nullptr;
+
+  vk::vkResetCommandBuffer(cmdBuffer, 0);
+  result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);
+  ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_TRANSFER_WRITE); // 所有级别转换为传输目标布局
+  ResourceStateTracker::flush(cmdBuffer);
+  vk::vkCmdCopyBufferToImage(cmdBuffer, StagingRing::buffer, textureImage, // 一次拷贝所有级别
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levels, bufferCopyRegions.data());
+  ResourceStateTracker::useImage(cmdBuffer, textureImage, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED);
+  ResourceStateTracker::flush(cmdBuffer);
+  result = vk::vkEndCommandBuffer(cmdBuffer);
+  VkFence copyFence = StagingRing::submit(device, queueGraphics, cmdBuffer);
+  StagingRing::wait(device, copyFence);
+
+  VkImageViewCreateInfo view_info = {};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.pNext = nullptr;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format;
+  view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+  view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+  view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+  view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = levels;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+  view_info.image = textureImage;
+
+  VkImageView viewTexture;
+  result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
+  assert(result == VK_SUCCESS);
+  ResourceRegistry::views[handle] = viewTexture;
+
+  VkDescriptorImageInfo texImageInfo;
+  texImageInfo.imageView = viewTexture;
+  texImageInfo.sampler = getTextureSampler(device, texName, samplerIndex);
+  texImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  ResourceRegistry::imageInfos[handle] = texImageInfo;
+
+  delete chain;
+  delete ctdo;
+}
+
+unsigned long long TextureManager::init_SPEC_Textures_Async(
+    std::string texName,
+    VkDevice &device,
+    VkPhysicalDeviceMemoryProperties &memoryroperties,
+    VkFormat format,
+    TexDataObject *ctdo,
+    int levels,
+    int samplerIndex,
+    const MipmapOptions &options
+) {
+  ResHandle handle = ResourceRegistry::intern(texName);
+  std::vector<int> levelOffsets;
+  TexDataObject *chain = MipmapGenerator::generate(ctdo, levels, levelOffsets, options);
+  levels = (int) levelOffsets.size();
+
+  VkImageCreateInfo image_create_info = {};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.pNext = nullptr;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.format = format;
+  image_create_info.extent.width = ctdo->width;
+  image_create_info.extent.height = ctdo->height;
+  image_create_info.extent.depth = 1;
+  image_create_info.mipLevels = levels;
+  image_create_info.arrayLayers = 1;
+  image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  image_create_info.queueFamilyIndexCount = 0;
+  image_create_info.pQueueFamilyIndices = nullptr;
+  image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;             // 通过所有权转移在队列家族间共享
+  image_create_info.flags = 0;
+
+  VkImage textureImage;
+  VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage);
+  assert(result == VK_SUCCESS);
+  ResourceRegistry::images[handle] = textureImage;
+
+  DeviceMemoryAllocator::allocateImage(
+      device, textureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, ResourceRegistry::memories[handle]);
+
+  std::vector<VkBufferImageCopy> bufferCopyRegions(levels);               // 偏移量相对于mipmap链数据的开头
+  for (int i = 0; i < levels; ++i) {
+    VkBufferImageCopy &region = bufferCopyRegions[i];
+    region = {};
+    region.bufferOffset = levelOffsets[i];
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = i;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = std::max(1, ctdo->width >> i);
+    region.imageExtent.height = std::max(1, ctdo->height >> i);
+    region.imageExtent.depth = 1;
+  }
+  unsigned long long ticket = AsyncUploader::uploadImage(                 // 数据交给上传器, 在之后的帧中提交
+      textureImage, (uint32_t) levels, bufferCopyRegions, chain->data, (VkDeviceSize) chain->dataByteCount);
+  chain->data = nullptr;
+
+  VkImageViewCreateInfo view_info = {};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.pNext = nullptr;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format;
+  view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+  view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+  view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+  view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = levels;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+  view_info.image = textureImage;
+
+  VkImageView viewTexture;
+  result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
+  assert(result == VK_SUCCESS);
+  ResourceRegistry::views[handle] = viewTexture;
+
+  VkDescriptorImageInfo texImageInfo;
+  texImageInfo.imageView = viewTexture;
+  texImageInfo.sampler = getTextureSampler(device, texName, samplerIndex);
+  texImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  ResourceRegistry::imageInfos[handle] = texImageInfo;
+
+  delete chain;
+  delete ctdo;
+  return ticket;
+}
+
+void TextureManager::benchmarkMipmapGenerator() {
+  const char *filterNames[] = {"box", "kaiser", "lanczos"};
+  int maxThreads = std::max(1, (int) std::thread::hardware_concurrency());
+  for (int filter = MIPMAP_FILTER_BOX; filter <= MIPMAP_FILTER_LANCZOS; ++filter) {
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {          // 1、2、4...个线程
+      MipmapOptions options;
+      options.filter = (MipmapFilter) filter;
+      options.threadCount = threads;
+      long long producedPixels;
+      double mpixPerSecond = MipmapGenerator::benchmark(1024, 1024, options, 10, producedPixels);
+      LOGI("MipmapGenerator %s threads=%d: %lld px/chain, %.2f Mpx/s",
+           filterNames[filter], threads, producedPixels, mpixPerSecond);
+    }
+  }
+}
+
+void TextureManager::addToUploadBatch(std::string texName, VkFormat format, TexDataObject *ctdo, int samplerIndex) {
+  PendingTexture pending;
+  pending.texName = texName;
+  pending.format = format;
+  pending.ctdo = ctdo;
+  pending.samplerIndex = samplerIndex;
+  pending.handle = ResourceRegistry::intern(texName);
+  pendingTextures.push_back(pending);
+}
+
+void TextureManager::flushUploadBatch(VkDevice &device,
+                                      VkPhysicalDevice &gpu,
+                                      VkPhysicalDeviceMemoryProperties &memoryroperties,
+                                      VkCommandBuffer &cmdBuffer,
+                                      VkQueue &queueGraphics) {
+  if (pendingTextures.empty()) {
+    return;
+  }
+  VkPhysicalDeviceProperties gpuProps;                                    // 获取拷贝时缓冲偏移量的最优对齐值
+  vk::vkGetPhysicalDeviceProperties(gpu, &gpuProps);
+  VkDeviceSize alignment =
+      std::max((VkDeviceSize) STAGING_COPY_ALIGNMENT, gpuProps.limits.optimalBufferCopyOffsetAlignment);
+
+  // 为每个纹理创建图像并分配设备内存
+  VkResult result;
+  for (size_t i = 0; i < pendingTextures.size(); ++i) {
+    PendingTexture &pending = pendingTextures[i];
+    VkImageCreateInfo image_create_info = {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.pNext = nullptr;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = pending.format;
+    image_create_info.extent.width = pending.ctdo->width;
+    image_create_info.extent.height = pending.ctdo->height;
+    image_create_info.extent.depth = 1;
+    image_create_info.mipLevels = 1;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_create_info.usage =
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_create_info.queueFamilyIndexCount = 0;
+    image_create_info.pQueueFamilyIndices = nullptr;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.flags = 0;
+    VkImage textureImage;
+    result = vk::vkCreateImage(device, &image_create_info, nullptr, &textureImage);
+    assert(result == VK_SUCCESS);
+    ResourceRegistry::images[pending.handle] = textureImage;
+    pending.imageInfo = image_create_info;
+    ResourceStateTracker::registerImage(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1);
+
+    DeviceMemoryAllocator::allocateImage(
+      device, textureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, ResourceRegistry::memories[pending.handle]);
+  }
+
+  VkCommandBufferBeginInfo cmd_buf_info = {};
+  cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmd_buf_info.pNext = nullptr;
+  cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  cmd_buf_info.pInheritanceInfo = nullptr;
+  vk::vkResetCommandBuffer(cmdBuffer, 0);
+  result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);
+  for (size_t i = 0; i < pendingTextures.size(); ++i) {                   // 所有图像的布局转换合并为一个管线屏障
+    ResourceStateTracker::useImage(
+        cmdBuffer, ResourceRegistry::images[pendingTextures[i].handle], RESOURCE_USAGE_TRANSFER_WRITE);
+  }
+  ResourceStateTracker::flush(cmdBuffer);
+  for (size_t i = 0; i < pendingTextures.size(); ++i) {                   // 数据拷贝进中转环形缓冲并记录拷贝命令
+    VkDeviceSize stagingOffset;
+    uint8_t *pData;
+    if (!StagingRing::allocate(device, pendingTextures[i].ctdo->dataByteCount, alignment, stagingOffset, pData)) {
+      // 中转环形缓冲已被本批数据占满, 先提交已记录的拷贝, 完成后继续在新的命令缓冲中记录
+      result = vk::vkEndCommandBuffer(cmdBuffer);
+      VkFence copyFence = StagingRing::submit(device, queueGraphics, cmdBuffer);
+      StagingRing::wait(device, copyFence);
+      vk::vkResetCommandBuffer(cmdBuffer, 0);
+      result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);
+      bool flag = StagingRing::allocate(
+          device, pendingTextures[i].ctdo->dataByteCount, alignment, stagingOffset, pData);
+      assert(flag);
+    }
+    memcpy(pData, pendingTextures[i].ctdo->data, pendingTextures[i].ctdo->dataByteCount);
+
+    VkBufferImageCopy bufferCopyRegion = {};
+    bufferCopyRegion.bufferOffset = stagingOffset;
+    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bufferCopyRegion.imageSubresource.mipLevel = 0;
+    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+    bufferCopyRegion.imageSubresource.layerCount = 1;
+    bufferCopyRegion.imageExtent.width = pendingTextures[i].ctdo->width;
+    bufferCopyRegion.imageExtent.height = pendingTextures[i].ctdo->height;
+    bufferCopyRegion.imageExtent.depth = 1;
+    vk::vkCmdCopyBufferToImage(cmdBuffer, StagingRing::buffer, ResourceRegistry::images[pendingTextures[i].handle],
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+  }
+  for (size_t i = 0; i < pendingTextures.size(); ++i) {
+    ResourceStateTracker::useImage(
+        cmdBuffer, ResourceRegistry::images[pendingTextures[i].handle], RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED);
+  }
+  ResourceStateTracker::flush(cmdBuffer);
+  result = vk::vkEndCommandBuffer(cmdBuffer);
+  VkFence copyFence = StagingRing::submit(device, queueGraphics, cmdBuffer); // 通常只提交一次
+  StagingRing::wait(device, copyFence);                                   // 通常只等待一次
+
+  for (size_t i = 0; i < pendingTextures.size(); ++i) {                   // 创建图像视图与图像描述信息
+    PendingTexture &pending = pendingTextures[i];
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.pNext = nullptr;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = pending.format;
+    view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+    view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+    view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+    view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    view_info.image = ResourceRegistry::images[pending.handle];
+    VkImageView viewTexture;
+    result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
+    assert(result == VK_SUCCESS);
+    ResourceRegistry::views[pending.handle] = viewTexture;
+
+    VkDescriptorImageInfo texImageInfo;
+    texImageInfo.imageView = viewTexture;
+    texImageInfo.sampler = getTextureSampler(device, pending.texName, pending.samplerIndex);
+    texImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    ResourceRegistry::imageInfos[pending.handle] = texImageInfo;
+    registerMovable(pending.handle, pending.imageInfo);                   // 上传已完成, 登记为可移动
+
+    delete pending.ctdo;                                                  // 删除内存中的纹理数据
+  }
+  pendingTextures.clear();
+}
+
+void TextureManager::destroyTexture(VkDevice &device, std::string texName) {
+  ResHandle handle = ResourceRegistry::find(texName);
+  assert(handle != RES_HANDLE_INVALID && ResourceRegistry::loaded(handle));
+  DeviceMemoryDefragmenter::unregister(ResourceRegistry::movableIds[handle]);
+  vk::vkDestroyImageView(device, ResourceRegistry::views[handle], nullptr);
+  ResourceStateTracker::forgetImage(ResourceRegistry::images[handle]);
+  vk::vkDestroyImage(device, ResourceRegistry::images[handle], nullptr);
+  DeviceMemoryAllocator::free(device, ResourceRegistry::memories[handle]);
+  ResourceRegistry::release(handle);
+}
+
+void TextureManager::registerMovable(ResHandle handle, const VkImageCreateInfo &imageInfo) {
+  ResourceRegistry::movableIds[handle] = DeviceMemoryDefragmenter::registerImage(
+      ResourceRegistry::images[handle], imageInfo, VK_IMAGE_ASPECT_COLOR_BIT,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, ResourceRegistry::memories[handle],
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+      [handle](VkDevice &device, const MovableResource &resource) {
+        VkImageViewCreateInfo view_info = {};                             // 以新图像重建视图(通道调和与原视图相同)
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.pNext = nullptr;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = resource.imageInfo.format;
+        view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+        view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+        view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+        view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+        view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.baseMipLevel = 0;
+        view_info.subresourceRange.levelCount = resource.imageInfo.mipLevels;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = 1;
+        view_info.image = resource.image;
+        VkImageView viewTexture;
+        VkResult result = vk::vkCreateImageView(device, &view_info, nullptr, &viewTexture);
+        assert(result == VK_SUCCESS);
+        DeviceMemoryDefragmenter::retireView(ResourceRegistry::views[handle]); // 在途帧可能仍在使用旧视图
+
+        ResourceRegistry::images[handle] = resource.image;
+        ResourceRegistry::memories[handle] = resource.allocation;
+        ResourceRegistry::views[handle] = viewTexture;
+        ResourceRegistry::imageInfos[handle].imageView = viewTexture;     // 描述集每帧按描述信息重写
+        int index = BindlessTextureTable::getIndex(ResourceRegistry::names[handle]);
+        if (index >= 0) {                                                 // 已放入纹理表时更新表中的描述
+          BindlessTextureTable::updateTexture(device, (uint32_t) index, ResourceRegistry::imageInfos[handle]);
+        }
+      });
+}
+
+void TextureManager::benchmarkTextureUpload(VkDevice &device,
+                                            VkPhysicalDevice &gpu,
+                                            VkPhysicalDeviceMemoryProperties &memoryroperties,
+                                            VkCommandBuffer &cmdBuffer,
+                                            VkQueue &queueGraphics) {
+  TexDataObject *source = FileUtil::loadCommonTexData(texNames[0]);      // 以第一个纹理的数据作为测试数据
+  const int counts[] = {1, 10, 100};
+  for (int count : counts) {
+    double elapsed[2];
+    for (int batched = 0; batched < 2; ++batched) {                       // 0为逐个上传, 1为批量上传
+      std::vector<std::string> names;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; ++i) {
+        names.push_back("benchmark/" + std::to_string(i));
+        auto *data = new unsigned char[source->dataByteCount];            // 每个纹理使用独立的数据副本
+        memcpy(data, source->data, source->dataByteCount);
+        auto *ctdo = new TexDataObject(source->width, source->height, data, source->dataByteCount);
+        if (batched) {
+          addToUploadBatch(names[i], VK_FORMAT_R8G8B8A8_UNORM, ctdo);
+        } else {
+          init_SPEC_2D_Textures(names[i], device, gpu, memoryroperties, cmdBuffer, queueGraphics,
+                                VK_FORMAT_R8G8B8A8_UNORM, ctdo);
+        }
+      }
+      if (batched) {
+        flushUploadBatch(device, gpu, memoryroperties, cmdBuffer, queueGraphics);
+      }
+      std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+      elapsed[batched] = ms.count();
+      for (size_t i = 0; i < names.size(); ++i) {                         // 销毁测试纹理
+        destroyTexture(device, names[i]);
+      }
+    }
+    LOGI("TextureUpload %d textures (%dx%d): per-texture %.2f ms, batched %.2f ms",
+         count, source->width, source->height, elapsed[0], elapsed[1]);
+  }
+  delete source;
+}
+
+void TextureManager::init_SPEC_Atlas_Texture(std::string atlasName,
+                                             VkDevice &device,
+                                             VkPhysicalDevice &gpu,
+                                             VkPhysicalDeviceMemoryProperties &memoryroperties,
+                                             VkCommandBuffer &cmdBuffer,
+                                             VkQueue &queueGraphics,
+                                             int samplerIndex) {
+  std::vector<std::string> &sources = atlasSources[atlasName];
+  std::vector<TexDataObject *> images;
+  for (size_t i = 0; i < sources.size(); ++i) {                           // 加载所有子纹理数据
+    images.push_back(FileUtil::loadCommonTexData(sources[i]));
+  }
+  std::vector<AtlasRegion> regions;
+  TexDataObject *atlas = TextureAtlas::build(images, ATLAS_PADDING, ATLAS_MIP_LEVELS, regions);
+  assert(atlas != nullptr);
+  for (size_t i = 0; i < sources.size(); ++i) {
+    atlasRegionList[sources[i]] = regions[i];
+    atlasOfTexture[sources[i]] = atlasName;
+    ResourceRegistry::descSetIndices[ResourceRegistry::intern(sources[i])] = // 子纹理共用图集的描述集
+        ResourceRegistry::descSetIndices[ResourceRegistry::intern(atlasName)];
+    delete images[i];
+  }
+  LOGI("%s: %d textures packed into %dx%d", atlasName.c_str(), (int) sources.size(), atlas->width, atlas->height);
+
+  MipmapOptions options;                                                  // 盒式过滤, 对齐的子纹理在各级互不渗色
+  options.filter = MIPMAP_FILTER_BOX;
+  init_SPEC_Textures_CpuMipMap(atlasName, device, gpu, memoryroperties, cmdBuffer, queueGraphics,
+                               VK_FORMAT_R8G8B8A8_UNORM, atlas, ATLAS_MIP_LEVELS, samplerIndex, options);
+}
@@ -9,22 +9,44 @@
 #include "TexDataObject.h"
 #include "ThreeDTexDataObject.h"
 #include "TexArrayDataObject.h"
+#include "TexSliceStream.h"
+#include "MipmapGenerator.h"
+#include "TextureAtlas.h"
+#include "SamplerCache.h"
+#include "ResourceRegistry.h"
 
-//#define SAMPLER_COUNT 1 // 采样器数量
-//#define SAMPLER_COUNT 4 // Sample6_3-四种纹理拉伸方式的采样器
-#define SAMPLER_COUNT 2 // Sample6_4、Sample6_11-两种纹理采样方式的采样器
+#define STREAM_STAGING_BYTES (4 * 1024 * 1024) // 流式加载3D纹理/纹理数组时每批占用的中转区域字节数
+#define STREAM_BATCH_SLOTS 3                   // 流式加载时可同时在途的批次数(每批一个命令缓冲)
+#define ATLAS_PADDING 2                        // 纹理图集中子纹理四周的间隔像素数
+#define ATLAS_MIP_LEVELS 4                     // 纹理图集的mipmap级数
+
+/**
+ * 批量上传中等待上传的2D纹理
+ */
+struct PendingTexture {
+  std::string texName;    // 纹理名称
+  VkFormat format;        // 纹理格式
+  TexDataObject *ctdo;    // 纹理数据(上传后删除)
+  int samplerIndex;       // 采用的采样器索引
+  ResHandle handle;       // 纹理在资源注册表中的句柄
+  VkImageCreateInfo imageInfo; // 图像创建信息(登记为可移动时使用)
+};
 
 class TextureManager {
  public:
   static std::vector<std::string> texNames;                               // 纹理文件名称列表
-  static std::vector<VkSampler> samplerList;                              // 采样器列表
-  static std::map<std::string, VkImage> textureImageList;                 // 纹理图像列表
-  static std::map<std::string, VkDeviceMemory> textureMemoryList;         // 纹理图像内存列表
-  static std::map<std::string, VkImageView> viewTextureList;              // 纹理图像视图列表
-  static std::map<std::string, VkDescriptorImageInfo> texImageInfoList;   // 纹理图像描述信息列表
+  static std::vector<VkSampler> samplerList;                              // 采样器列表(由采样器缓存持有, 状态相同的索引共用同一采样器)
+  static std::vector<ResHandle> texHandles;                               // 纹理文件名称列表对应的句柄(图像、内存、视图等存放在ResourceRegistry中)
   static std::map<std::string, int> imageSampler;                         // Sample6_3-纹理文件名称对应的采样器索引
+  static std::map<std::string, SamplerDesc> textureSamplers;              // 纹理文件名称对应的采样方式(优先于采样器索引, 须在initTextures前设置)
   static std::vector<std::string> texNamesSingle;                         // Sample6_6
   static std::vector<std::string> texNamesPair;                           // Sample6_6
+  static std::vector<ResHandle> texHandlesSingle;                         // Sample6_6
+  static std::vector<ResHandle> texHandlesPair;                           // Sample6_6
+  static std::vector<PendingTexture> pendingTextures;                     // 批量上传中等待上传的纹理
+  static std::map<std::string, std::vector<std::string>> atlasSources;    // 纹理图集名称对应的子纹理文件名称列表
+  static std::map<std::string, std::string> atlasOfTexture;               // 子纹理文件名称对应的纹理图集名称
+  static std::map<std::string, AtlasRegion> atlasRegionList;              // 子纹理在纹理图集中的区域
 
   /**
    * 加载所有纹理
@@ -33,6 +55,7 @@ class TextureManager {
       VkDevice &device,
       VkPhysicalDevice &gpu,
       VkPhysicalDeviceMemoryProperties &memoryroperties,
+      VkCommandPool &cmdPool,
       VkCommandBuffer &cmdBuffer,
       VkQueue &queueGraphics);
 
@@ -42,17 +65,88 @@ class TextureManager {
   static void destroyTextures(VkDevice &device);
 
   /**
-   * 获取指定名称纹理在描述集列表中的索引
+   * 获取指定名称纹理在描述集列表中的索引(需查找名称, 仅在加载时使用)
    */
   static int getVkDescriptorSetIndex(std::string texName);
 
+  /**
+   * 获取指定句柄纹理在描述集列表中的索引(帧内使用)
+   */
+  static int getVkDescriptorSetIndex(ResHandle handle);
+
+  /**
+   * 驻留名称列表, 并以列表下标作为各纹理的描述集索引
+   */
+  static std::vector<ResHandle> internNames(const std::vector<std::string> &names);
+
+  /**
+   * 将2D纹理加入批量上传列表(此时不创建任何Vulkan对象)
+   */
+  static void addToUploadBatch(std::string texName, VkFormat format, TexDataObject *ctdo, int samplerIndex = 0);
+
+  /**
+   * 上传批量列表中的全部纹理: 所有纹理数据放入中转环形缓冲,
+   * 全部拷贝与布局转换记录在一个命令缓冲中, 只提交一次、等待一次栅栏(数据超出环形缓冲容量时分段提交)
+   */
+  static void flushUploadBatch(
+      VkDevice &device,
+      VkPhysicalDevice &gpu,
+      VkPhysicalDeviceMemoryProperties &memoryroperties,
+      VkCommandBuffer &cmdBuffer,
+      VkQueue &queueGraphics);
+
+  /**
+   * 纹理上传基准测试, 分别以逐个上传和批量上传的方式加载1、10、100个纹理并输出耗时
+   */
+  static void benchmarkTextureUpload(
+      VkDevice &device,
+      VkPhysicalDevice &gpu,
+      VkPhysicalDeviceMemoryProperties &memoryroperties,
+      VkCommandBuffer &cmdBuffer,
+      VkQueue &queueGraphics);
+
+  /**
+   * CPU端mipmap生成器的基准测试, 按过滤器与线程数输出每秒产生的像素数
+   */
+  static void benchmarkMipmapGenerator();
+
  private:
+  friend class TextureStreamer;                                           // 流式纹理管理复用这里的加载与销毁
+
+  /**
+   * 加载atlasSources中指定图集的所有子纹理, 装入一幅图集图像后上传(含CPU端生成的mipmap)
+   * 各子纹理的区域记录在atlasRegionList中, 子纹理名称通过atlasOfTexture映射到图集
+   */
+  static void init_SPEC_Atlas_Texture(
+      std::string atlasName,
+      VkDevice &device,
+      VkPhysicalDevice &gpu,
+      VkPhysicalDeviceMemoryProperties &memoryroperties,
+      VkCommandBuffer &cmdBuffer,
+      VkQueue &queueGraphics,
+      int samplerIndex);
+
+  /**
+   * 销毁指定名称的纹理并从各列表中移除
+   */
+  static void destroyTexture(VkDevice &device, std::string texName);
+
+  /**
+   * 把已上传完成、处于着色器只读布局的最优平铺纹理登记为可被内存整理移动
+   * 移动后换用新图像并重建视图, 更新注册表中的描述信息与纹理表中的描述
+   */
+  static void registerMovable(ResHandle handle, const VkImageCreateInfo &imageInfo);
 
   /**
    * 初始化采样器
    */
   static void initSampler(VkDevice &device, VkPhysicalDevice &gpu);
 
+  /**
+   * 获取纹理采用的采样器: 单独请求了采样方式的纹理从采样器缓存获取, 否则取采样器列表中的指定索引
+   */
+  static VkSampler getTextureSampler(VkDevice &device, std::string texName, int samplerIndex);
+
   /**
    * 加载2D纹理
    */
@@ -87,6 +181,39 @@ class TextureManager {
       int samplerIndex // Sample6_11
   );
 
+  /**
+   * 加载2D纹理, 在CPU端用MipmapGenerator生成mipmap链(sRGB正确的过滤, 可保持alpha覆盖率),
+   * 然后一次拷贝到纹理的所有级别, 不再使用vkCmdBlitImage
+   */
+  static void init_SPEC_Textures_CpuMipMap(
+      std::string texName,
+      VkDevice &device,
+      VkPhysicalDevice &gpu,
+      VkPhysicalDeviceMemoryProperties &memoryroperties,
+      VkCommandBuffer &cmdBuffer,
+      VkQueue &queueGraphics,
+      VkFormat format,
+      TexDataObject *ctdo,
+      int levels,
+      int samplerIndex,
+      const MipmapOptions &options
+  );
+
+  /**
+   * 与init_SPEC_Textures_CpuMipMap相同, 但数据交给AsyncUploader在传输队列上异步上传, 不等待栅栏
+   * 图像、视图与描述信息立即创建, 返回的票号完成(AsyncUploader::isComplete)之前不得用于绘制
+   */
+  static unsigned long long init_SPEC_Textures_Async(
+      std::string texName,
+      VkDevice &device,
+      VkPhysicalDeviceMemoryProperties &memoryroperties,
+      VkFormat format,
+      TexDataObject *ctdo,
+      int levels,
+      int samplerIndex,
+      const MipmapOptions &options
+  );
+
   /**
    * Sample6_9
    * 加载3D纹理
@@ -106,6 +233,24 @@ class TextureManager {
 //      ThreeDTexDataObject *ctdo
       TexArrayDataObject *ctdo // Sample6_10
   );
+
+  /**
+   * 按切片流式加载3D纹理(is3D为true)或2D纹理数组
+   * 切片数据分批(每批不超过STREAM_STAGING_BYTES)直接读入中转环形缓冲, 每批切片一次vkCmdCopyBufferToImage,
+   * 各批轮流使用从cmdPool分配的STREAM_BATCH_SLOTS个命令缓冲, 读取下一批时前几批的拷贝仍在执行;
+   * 内存峰值由中转环形缓冲大小决定, 与纹理总大小无关
+   */
+  static void init_SPEC_Layered_Textures_Streaming(
+      std::string texName,
+      VkDevice &device,
+      VkPhysicalDevice &gpu,
+      VkPhysicalDeviceMemoryProperties &memoryProperties,
+      VkCommandPool &cmdPool,
+      VkQueue &queueGraphics,
+      VkFormat format,
+      TexSliceStream *stream,
+      bool is3D
+  );
 };
 
 #endif // DEEPERVULKAN_TEXTUREMANAGER_H_
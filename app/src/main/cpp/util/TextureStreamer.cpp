@@ -0,0 +1,256 @@
+#include "TextureStreamer.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include "TextureManager.h"
+#include "FileUtil.h"
+#include "MipmapGenerator.h"
+#include "AsyncUploader.h"
+#include "../bndev/mylog.h"
+
+std::vector<StreamedTexture> TextureStreamer::textures;
+VkDeviceSize TextureStreamer::budgetBytes = STREAM_BUDGET_BYTES;
+VkDeviceSize TextureStreamer::residentBytes = 0;
+VkDeviceSize TextureStreamer::peakResidentBytes = 0;
+int TextureStreamer::pressureEvictions = 0;
+int TextureStreamer::deferredLoads = 0;
+int TextureStreamer::oversizedLoads = 0;
+VkDevice *TextureStreamer::device = nullptr;
+VkPhysicalDevice *TextureStreamer::gpu = nullptr;
+VkPhysicalDeviceMemoryProperties *TextureStreamer::memoryroperties = nullptr;
+VkCommandBuffer *TextureStreamer::cmdBuffer = nullptr;
+VkQueue *TextureStreamer::queueGraphics = nullptr;
+long long TextureStreamer::frame = 0;
+std::deque<TextureHandle> TextureStreamer::loadQueue;
+
+void TextureStreamer::init(VkDevice &device,
+                           VkPhysicalDevice &gpu,
+                           VkPhysicalDeviceMemoryProperties &memoryroperties,
+                           VkCommandBuffer &cmdBuffer,
+                           VkQueue &queueGraphics,
+                           VkDeviceSize budget) {
+  TextureStreamer::device = &device;
+  TextureStreamer::gpu = &gpu;
+  TextureStreamer::memoryroperties = &memoryroperties;
+  TextureStreamer::cmdBuffer = &cmdBuffer;
+  TextureStreamer::queueGraphics = &queueGraphics;
+  budgetBytes = budget;
+  residentBytes = 0;
+  peakResidentBytes = 0;
+  pressureEvictions = 0;
+  deferredLoads = 0;
+  oversizedLoads = 0;
+  frame = 0;
+}
+
+void TextureStreamer::setBudget(VkDeviceSize budget) {
+  budgetBytes = budget;
+}
+
+TextureHandle TextureStreamer::registerTexture(std::string texName) {
+  TexDataObject *ctdo = FileUtil::loadCommonTexData(texName);            // 加载纹理文件数据
+  StreamedTexture st;
+  st.texName = texName;
+  st.placeholderName = texName + "#placeholder";
+  st.texHandle = ResourceRegistry::intern(st.texName);                    // 注册时驻留名称, 请求时按句柄访问
+  st.placeholderHandle = ResourceRegistry::intern(st.placeholderName);
+  st.width = ctdo->width;
+  st.height = ctdo->height;
+  st.resident = false;
+  st.queued = false;
+  st.uploading = false;
+  st.uploadTicket = 0;
+  st.residentBytes = 0;
+  st.lastUsedFrame = -1;
+  st.requestCount = 0;
+  st.placeholderHits = 0;
+  st.loadCount = 0;
+  st.evictCount = 0;
+
+  int level = 0;                                                          // 找到不超过占位尺寸的第一级
+  while ((ctdo->width >> level) > STREAM_PLACEHOLDER_SIZE || (ctdo->height >> level) > STREAM_PLACEHOLDER_SIZE) {
+    level++;
+  }
+  MipmapOptions options;
+  std::vector<int> levelOffsets;
+  TexDataObject *chain = MipmapGenerator::generate(ctdo, level + 1, levelOffsets, options);
+  level = (int) levelOffsets.size() - 1;
+  int lowWidth = std::max(1, ctdo->width >> level);
+  int lowHeight = std::max(1, ctdo->height >> level);
+  int lowByteCount = lowWidth * lowHeight * 4;
+  auto *lowData = new unsigned char[lowByteCount];                        // 取出该级数据作为占位纹理的第0级
+  memcpy(lowData, chain->data + levelOffsets[level], (size_t) lowByteCount);
+  delete chain;
+  delete ctdo;
+
+  TexDataObject *low = new TexDataObject(lowWidth, lowHeight, lowData, lowByteCount);
+  TextureManager::init_SPEC_Textures_CpuMipMap(                           // 上传常驻的占位纹理(含其余更低级mipmap)
+      st.placeholderName, *device, *gpu, *memoryroperties, *cmdBuffer, *queueGraphics, VK_FORMAT_R8G8B8A8_UNORM,
+      low, MipmapGenerator::getLevelCount(lowWidth, lowHeight), 0, options);
+  st.placeholderBytes = imageBytes(st.placeholderHandle);
+  residentBytes += st.placeholderBytes;
+  peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+
+  textures.push_back(st);
+  LOGI("TextureStreamer register %s: %dx%d placeholder %dx%d", texName.c_str(), st.width, st.height,
+       lowWidth, lowHeight);
+  return (TextureHandle) textures.size() - 1;
+}
+
+VkDescriptorImageInfo &TextureStreamer::request(TextureHandle handle) {
+  StreamedTexture &st = textures[handle];
+  st.requestCount++;
+  st.lastUsedFrame = frame;
+  if (!st.resident) {
+    st.placeholderHits++;
+    prefetch(handle);
+  }
+  return getImageInfo(handle);
+}
+
+void TextureStreamer::prefetch(TextureHandle handle) {
+  StreamedTexture &st = textures[handle];
+  if (!st.resident && !st.queued && !st.uploading) {
+    st.queued = true;
+    loadQueue.push_back(handle);
+  }
+}
+
+VkDescriptorImageInfo &TextureStreamer::getImageInfo(TextureHandle handle) {
+  StreamedTexture &st = textures[handle];
+  return ResourceRegistry::imageInfos[st.resident ? st.texHandle : st.placeholderHandle];
+}
+
+void TextureStreamer::update() {
+  frame++;
+  for (size_t i = 0; i < textures.size(); ++i) {                          // 异步上传已被图形队列获取的纹理转为常驻
+    StreamedTexture &st = textures[i];
+    if (st.uploading && AsyncUploader::isComplete(st.uploadTicket)) {
+      st.uploading = false;
+      st.resident = true;
+    }
+  }
+  VkDeviceSize placeholderTotal = 0;                                      // 占位纹理总是常驻
+  for (size_t i = 0; i < textures.size(); ++i) {
+    placeholderTotal += textures[i].placeholderBytes;
+  }
+
+  int loads = 0;
+  while (!loadQueue.empty() && loads < STREAM_LOADS_PER_UPDATE) {
+    TextureHandle handle = loadQueue.front();
+    StreamedTexture &st = textures[handle];
+    if (st.resident || st.uploading) {
+      loadQueue.pop_front();
+      st.queued = false;
+      continue;
+    }
+    VkDeviceSize estimate = (VkDeviceSize) st.width * st.height * 4 * 4 / 3; // 完整mipmap链约为第0级的4/3
+    if (placeholderTotal + estimate > budgetBytes) {                      // 逐出所有纹理也放不下
+      LOGE("TextureStreamer %s exceeds budget", st.texName.c_str());
+      oversizedLoads++;
+      loadQueue.pop_front();
+      st.queued = false;
+      continue;
+    }
+    bool fits = true;
+    while (residentBytes + estimate > budgetBytes) {
+      if (!evictLeastRecentlyUsed()) {
+        fits = false;
+        break;
+      }
+      pressureEvictions++;
+    }
+    if (!fits) {                                                          // 上一帧使用的纹理已占满预算, 以后再试
+      deferredLoads++;
+      break;
+    }
+    loadQueue.pop_front();
+    st.queued = false;
+    load(handle);
+    loads++;
+  }
+
+  while (residentBytes > budgetBytes && evictLeastRecentlyUsed()) {       // 预算被调小后逐出多余的纹理
+    pressureEvictions++;
+  }
+}
+
+void TextureStreamer::load(TextureHandle handle) {
+  StreamedTexture &st = textures[handle];
+  TexDataObject *ctdo = FileUtil::loadCommonTexData(st.texName);
+  MipmapOptions options;
+  if (AsyncUploader::active()) {                                          // 在传输队列上上传, 完成前继续使用占位纹理
+    st.uploadTicket = TextureManager::init_SPEC_Textures_Async(
+        st.texName, *device, *memoryroperties, VK_FORMAT_R8G8B8A8_UNORM,
+        ctdo, MipmapGenerator::getLevelCount(st.width, st.height), 0, options);
+    st.uploading = true;
+  } else {
+    TextureManager::init_SPEC_Textures_CpuMipMap(
+        st.texName, *device, *gpu, *memoryroperties, *cmdBuffer, *queueGraphics, VK_FORMAT_R8G8B8A8_UNORM,
+        ctdo, MipmapGenerator::getLevelCount(st.width, st.height), 0, options);
+    st.resident = true;
+  }
+  st.residentBytes = imageBytes(st.texHandle);
+  st.loadCount++;
+  residentBytes += st.residentBytes;
+  peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+}
+
+void TextureStreamer::evict(TextureHandle handle) {
+  StreamedTexture &st = textures[handle];
+  TextureManager::destroyTexture(*device, st.texName);                    // 逐出后退回占位纹理
+  residentBytes -= st.residentBytes;
+  st.residentBytes = 0;
+  st.resident = false;
+  st.evictCount++;
+}
+
+bool TextureStreamer::evictLeastRecentlyUsed() {
+  int victim = -1;
+  for (size_t i = 0; i < textures.size(); ++i) {
+    StreamedTexture &st = textures[i];
+    if (!st.resident || st.lastUsedFrame >= frame - 1) {                  // 上一帧使用过的纹理不逐出
+      continue;
+    }
+    if (victim < 0 || st.lastUsedFrame < textures[victim].lastUsedFrame) {
+      victim = (int) i;
+    }
+  }
+  if (victim < 0) {
+    return false;
+  }
+  evict(victim);
+  return true;
+}
+
+VkDeviceSize TextureStreamer::imageBytes(ResHandle handle) {
+  VkMemoryRequirements mem_reqs;
+  vk::vkGetImageMemoryRequirements(*device, ResourceRegistry::images[handle], &mem_reqs);
+  return mem_reqs.size;
+}
+
+void TextureStreamer::logStats() {
+  LOGI("TextureStreamer frame %lld: resident %d / budget %d bytes (peak %d), "
+       "pressure evictions %d, deferred loads %d, oversized %d",
+       frame, (int) residentBytes, (int) budgetBytes, (int) peakResidentBytes,
+       pressureEvictions, deferredLoads, oversizedLoads);
+  for (size_t i = 0; i < textures.size(); ++i) {
+    StreamedTexture &st = textures[i];
+    LOGI("  [%d] %s %s %d bytes, requests %d, placeholder hits %d, loads %d, evictions %d, last used %lld",
+         (int) i, st.texName.c_str(), st.resident ? "resident" : (st.uploading ? "uploading" : "placeholder"),
+         (int) (st.residentBytes + st.placeholderBytes), st.requestCount, st.placeholderHits,
+         st.loadCount, st.evictCount, st.lastUsedFrame);
+  }
+}
+
+void TextureStreamer::destroy() {
+  for (size_t i = 0; i < textures.size(); ++i) {
+    if (textures[i].resident || textures[i].uploading) {
+      TextureManager::destroyTexture(*device, textures[i].texName);
+    }
+    TextureManager::destroyTexture(*device, textures[i].placeholderName);
+  }
+  textures.clear();
+  loadQueue.clear();
+  residentBytes = 0;
+}
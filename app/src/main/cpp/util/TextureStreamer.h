@@ -0,0 +1,133 @@
+#ifndef DEEPERVULKAN_TEXTURESTREAMER_H_
+#define DEEPERVULKAN_TEXTURESTREAMER_H_
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "ResourceRegistry.h"
+
+#define STREAM_BUDGET_BYTES (32 * 1024 * 1024)  // 默认的纹理显存预算字节数
+#define STREAM_PLACEHOLDER_SIZE 32              // 常驻占位mipmap的最大边长
+#define STREAM_LOADS_PER_UPDATE 1               // 每次更新最多加载的完整纹理数量(限制单帧卡顿)
+
+typedef int TextureHandle;                      // 流式纹理句柄
+
+/**
+ * 一个流式纹理的状态与统计
+ */
+struct StreamedTexture {
+  std::string texName;            // 纹理文件名称
+  std::string placeholderName;    // 常驻占位纹理在TextureManager中的名称
+  ResHandle texHandle;            // 完整纹理在资源注册表中的句柄
+  ResHandle placeholderHandle;    // 占位纹理在资源注册表中的句柄
+  int width;                      // 第0级宽度
+  int height;                     // 第0级高度
+  bool resident;                  // 完整纹理是否常驻显存
+  bool queued;                    // 是否已在加载队列中
+  bool uploading;                 // 完整纹理是否正在异步上传(完成前仍使用占位纹理)
+  unsigned long long uploadTicket; // 异步上传的票号
+  VkDeviceSize residentBytes;     // 完整纹理占用的显存字节数
+  VkDeviceSize placeholderBytes;  // 占位纹理占用的显存字节数
+  long long lastUsedFrame;        // 最近一次使用的帧号(LRU依据)
+  int requestCount;               // 被请求的次数
+  int placeholderHits;            // 请求时只能使用占位纹理的次数
+  int loadCount;                  // 完整纹理被加载的次数
+  int evictCount;                 // 完整纹理被逐出的次数
+};
+
+/**
+ * 带显存预算的流式纹理管理
+ * 纹理注册后只常驻低级mipmap作为占位, 完整纹理在首次使用(或预取)时加载,
+ * 显存超出预算时按最近最少使用的顺序逐出完整纹理, 逐出后退回占位纹理
+ * 图像对象仍存放在TextureManager的各列表中, 描述信息可通过getImageInfo获取
+ */
+class TextureStreamer {
+ public:
+  static std::vector<StreamedTexture> textures;   // 所有流式纹理, 下标即句柄
+  static VkDeviceSize budgetBytes;                // 显存预算字节数(含占位纹理)
+  static VkDeviceSize residentBytes;              // 当前占用的显存字节数(含占位纹理)
+  static VkDeviceSize peakResidentBytes;          // 占用显存的峰值
+  static int pressureEvictions;                   // 因预算不足而逐出的次数
+  static int deferredLoads;                       // 因无可逐出纹理而推迟的加载次数
+  static int oversizedLoads;                      // 超过整个预算而无法加载的次数
+
+  /**
+   * 初始化流式纹理管理, 之后的加载与逐出都使用这里给出的设备、命令缓冲与队列
+   */
+  static void init(VkDevice &device, VkPhysicalDevice &gpu, VkPhysicalDeviceMemoryProperties &memoryroperties,
+                   VkCommandBuffer &cmdBuffer, VkQueue &queueGraphics, VkDeviceSize budget = STREAM_BUDGET_BYTES);
+
+  /**
+   * 修改显存预算, 下次更新时生效
+   */
+  static void setBudget(VkDeviceSize budget);
+
+  /**
+   * 注册纹理并上传常驻的占位纹理, 返回纹理句柄
+   */
+  static TextureHandle registerTexture(std::string texName);
+
+  /**
+   * 绘制时请求纹理: 记录使用并在未常驻时加入加载队列
+   * 返回当前可用的图像描述信息(完整纹理未常驻时为占位纹理)
+   */
+  static VkDescriptorImageInfo &request(TextureHandle handle);
+
+  /**
+   * 预测即将使用的纹理, 提前加入加载队列
+   */
+  static void prefetch(TextureHandle handle);
+
+  /**
+   * 返回当前可用的图像描述信息, 不记录使用
+   */
+  static VkDescriptorImageInfo &getImageInfo(TextureHandle handle);
+
+  /**
+   * 每帧开始时调用(须在上一帧的GPU任务完成之后): 进入新的一帧, 处理加载队列并在必要时逐出纹理
+   */
+  static void update();
+
+  /**
+   * 打印各纹理的常驻状态与预算压力统计
+   */
+  static void logStats();
+
+  /**
+   * 销毁所有流式纹理
+   */
+  static void destroy();
+
+ private:
+  static VkDevice *device;
+  static VkPhysicalDevice *gpu;
+  static VkPhysicalDeviceMemoryProperties *memoryroperties;
+  static VkCommandBuffer *cmdBuffer;
+  static VkQueue *queueGraphics;
+  static long long frame;                         // 当前帧号
+  static std::deque<TextureHandle> loadQueue;     // 等待加载的纹理
+
+  /**
+   * 加载完整纹理
+   */
+  static void load(TextureHandle handle);
+
+  /**
+   * 逐出完整纹理
+   */
+  static void evict(TextureHandle handle);
+
+  /**
+   * 逐出最近最少使用且上一帧未使用的完整纹理, 返回是否逐出了纹理
+   */
+  static bool evictLeastRecentlyUsed();
+
+  /**
+   * 返回TextureManager中指定纹理图像占用的显存字节数
+   */
+  static VkDeviceSize imageBytes(ResHandle handle);
+};
+
+#endif //DEEPERVULKAN_TEXTURESTREAMER_H_
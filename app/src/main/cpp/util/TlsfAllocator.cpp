@@ -0,0 +1,320 @@
+#include "TlsfAllocator.h"
+#include <cassert>
+#include <cstring>
+
+static int highestBit(uint64_t value) {                                   // 最高的置位(value不为0)
+  return 63 - __builtin_clzll(value);
+}
+
+static int lowestBit(uint64_t value) {                                    // 最低的置位(value不为0)
+  return __builtin_ctzll(value);
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t size) {
+  this->size = size;
+  usedBytes = 0;
+  allocationCount = 0;
+  flBitmap = 0;
+  memset(slBitmap, 0, sizeof(slBitmap));
+  for (int fl = 0; fl < TLSF_FL_COUNT; ++fl) {
+    for (int sl = 0; sl < TLSF_SL_COUNT; ++sl) {
+      heads[fl][sl] = TLSF_NONE;
+    }
+  }
+  uint32_t node = newNode();                                              // 初始时整个区间为一个空闲段
+  nodes[node].offset = 0;
+  nodes[node].size = size;
+  insertFree(node);
+}
+
+void TlsfAllocator::mapping(uint64_t size, int &fl, int &sl) {
+  if (size < TLSF_SL_COUNT) {                                             // 小尺寸全部落在第0个一级区间
+    fl = 0;
+    sl = (int) size;
+  } else {
+    int bit = highestBit(size);
+    sl = (int) (size >> (bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    fl = bit - TLSF_SL_LOG2 + 1;
+  }
+}
+
+void TlsfAllocator::mappingSearch(uint64_t size, int &fl, int &sl) {
+  if (size >= TLSF_SL_COUNT) {                                            // 向上取整到下一个二级区间的起点
+    uint64_t round = ((uint64_t) 1 << (highestBit(size) - TLSF_SL_LOG2)) - 1;
+    if (size + round > size) {
+      size += round;
+    }
+  }
+  mapping(size, fl, sl);
+}
+
+uint32_t TlsfAllocator::newNode() {
+  uint32_t node;
+  if (unusedNodes.empty()) {
+    node = (uint32_t) nodes.size();
+    nodes.push_back(TlsfNode());
+  } else {
+    node = unusedNodes.back();
+    unusedNodes.pop_back();
+  }
+  TlsfNode &n = nodes[node];
+  n.offset = 0;
+  n.size = 0;
+  n.prevPhys = TLSF_NONE;
+  n.nextPhys = TLSF_NONE;
+  n.prevFree = TLSF_NONE;
+  n.nextFree = TLSF_NONE;
+  n.free = false;
+  return node;
+}
+
+void TlsfAllocator::insertFree(uint32_t node) {
+  int fl, sl;
+  mapping(nodes[node].size, fl, sl);
+  TlsfNode &n = nodes[node];
+  n.free = true;
+  n.prevFree = TLSF_NONE;
+  n.nextFree = heads[fl][sl];                                             // 插入链表头部
+  if (n.nextFree != TLSF_NONE) {
+    nodes[n.nextFree].prevFree = node;
+  }
+  heads[fl][sl] = node;
+  flBitmap |= (uint64_t) 1 << fl;
+  slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t node) {
+  int fl, sl;
+  mapping(nodes[node].size, fl, sl);
+  TlsfNode &n = nodes[node];
+  if (n.prevFree != TLSF_NONE) {
+    nodes[n.prevFree].nextFree = n.nextFree;
+  } else {
+    heads[fl][sl] = n.nextFree;
+  }
+  if (n.nextFree != TLSF_NONE) {
+    nodes[n.nextFree].prevFree = n.prevFree;
+  }
+  if (heads[fl][sl] == TLSF_NONE) {                                       // 区间已空, 清除位图
+    slBitmap[fl] &= ~(1u << sl);
+    if (slBitmap[fl] == 0) {
+      flBitmap &= ~((uint64_t) 1 << fl);
+    }
+  }
+  n.free = false;
+  n.prevFree = TLSF_NONE;
+  n.nextFree = TLSF_NONE;
+}
+
+uint32_t TlsfAllocator::findSuitable(int fl, int sl) const {
+  if (fl >= TLSF_FL_COUNT) {
+    return TLSF_NONE;
+  }
+  uint32_t slMap = slBitmap[fl] & (~0u << sl);                            // 同一级区间中不小于sl的二级区间
+  if (slMap == 0) {
+    if (fl + 1 >= TLSF_FL_COUNT) {
+      return TLSF_NONE;
+    }
+    uint64_t flMap = flBitmap & (~(uint64_t) 0 << (fl + 1));              // 更大的一级区间
+    if (flMap == 0) {
+      return TLSF_NONE;
+    }
+    fl = lowestBit(flMap);
+    slMap = slBitmap[fl];
+  }
+  return heads[fl][lowestBit(slMap)];
+}
+
+bool TlsfAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t &offset, uint32_t &handle) {
+  if (size == 0 || size > this->size) {
+    return false;
+  }
+  if (alignment == 0) {
+    alignment = 1;
+  }
+  uint64_t need = size + alignment - 1;                                   // 对齐填充的最坏情况
+  int fl, sl;
+  mappingSearch(need, fl, sl);
+  uint32_t node = findSuitable(fl, sl);
+  uint64_t aligned = 0;
+  if (node != TLSF_NONE) {
+    aligned = (nodes[node].offset + alignment - 1) / alignment * alignment;
+  } else {                                                                // 向上取整的区间中没有时再逐个检查同区间的空闲段
+    mapping(need, fl, sl);
+    if (fl >= TLSF_FL_COUNT) {
+      return false;
+    }
+    for (uint32_t i = heads[fl][sl]; i != TLSF_NONE; i = nodes[i].nextFree) {
+      uint64_t a = (nodes[i].offset + alignment - 1) / alignment * alignment;
+      if (a + size <= nodes[i].offset + nodes[i].size) {
+        node = i;
+        aligned = a;
+        break;
+      }
+    }
+    if (node == TLSF_NONE) {
+      return false;
+    }
+  }
+  removeFree(node);
+
+  uint64_t pad = aligned - nodes[node].offset;
+  if (pad > 0) {                                                          // 对齐填充切成单独的空闲段
+    uint32_t front = newNode();
+    TlsfNode &f = nodes[front];
+    TlsfNode &n = nodes[node];
+    f.offset = n.offset;
+    f.size = pad;
+    f.prevPhys = n.prevPhys;
+    f.nextPhys = node;
+    if (n.prevPhys != TLSF_NONE) {
+      nodes[n.prevPhys].nextPhys = front;
+    }
+    n.prevPhys = front;
+    n.offset = aligned;
+    n.size -= pad;
+    insertFree(front);
+  }
+  uint64_t remainder = nodes[node].size - size;
+  if (remainder >= TLSF_MIN_BLOCK) {                                      // 剩余部分切成新的空闲段
+    uint32_t back = newNode();
+    TlsfNode &b = nodes[back];
+    TlsfNode &n = nodes[node];
+    b.offset = n.offset + size;
+    b.size = remainder;
+    b.prevPhys = node;
+    b.nextPhys = n.nextPhys;
+    if (n.nextPhys != TLSF_NONE) {
+      nodes[n.nextPhys].prevPhys = back;
+    }
+    n.nextPhys = back;
+    n.size = size;
+    insertFree(back);
+  }
+  usedBytes += nodes[node].size;
+  allocationCount++;
+  offset = nodes[node].offset;
+  handle = node;
+  return true;
+}
+
+void TlsfAllocator::free(uint32_t handle) {
+  assert(handle < nodes.size() && !nodes[handle].free);
+  usedBytes -= nodes[handle].size;
+  allocationCount--;
+  uint32_t node = handle;
+  uint32_t prev = nodes[node].prevPhys;
+  if (prev != TLSF_NONE && nodes[prev].free) {                            // 与前一个空闲段合并
+    removeFree(prev);
+    nodes[prev].size += nodes[node].size;
+    nodes[prev].nextPhys = nodes[node].nextPhys;
+    if (nodes[node].nextPhys != TLSF_NONE) {
+      nodes[nodes[node].nextPhys].prevPhys = prev;
+    }
+    unusedNodes.push_back(node);
+    node = prev;
+  }
+  uint32_t next = nodes[node].nextPhys;
+  if (next != TLSF_NONE && nodes[next].free) {                            // 与后一个空闲段合并
+    removeFree(next);
+    nodes[node].size += nodes[next].size;
+    nodes[node].nextPhys = nodes[next].nextPhys;
+    if (nodes[next].nextPhys != TLSF_NONE) {
+      nodes[nodes[next].nextPhys].prevPhys = node;
+    }
+    unusedNodes.push_back(next);
+  }
+  insertFree(node);
+}
+
+uint64_t TlsfAllocator::offsetOf(uint32_t handle) const {
+  return nodes[handle].offset;
+}
+
+uint64_t TlsfAllocator::sizeOf(uint32_t handle) const {
+  return nodes[handle].size;
+}
+
+uint64_t TlsfAllocator::largestFree() const {
+  if (flBitmap == 0) {
+    return 0;
+  }
+  int fl = highestBit(flBitmap);
+  int sl = highestBit(slBitmap[fl]);
+  uint64_t largest = 0;
+  for (uint32_t i = heads[fl][sl]; i != TLSF_NONE; i = nodes[i].nextFree) {
+    if (nodes[i].size > largest) {
+      largest = nodes[i].size;
+    }
+  }
+  return largest;
+}
+
+int TlsfAllocator::freeBlockCount() const {
+  int count = 0;
+  for (int fl = 0; fl < TLSF_FL_COUNT; ++fl) {
+    for (int sl = 0; sl < TLSF_SL_COUNT; ++sl) {
+      for (uint32_t i = heads[fl][sl]; i != TLSF_NONE; i = nodes[i].nextFree) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+bool TlsfAllocator::validate() const {
+  uint32_t first = TLSF_NONE;                                             // 找到偏移量为0的段
+  for (uint32_t i = 0; i < nodes.size(); ++i) {
+    bool unused = false;
+    for (size_t j = 0; j < unusedNodes.size(); ++j) {
+      if (unusedNodes[j] == i) {
+        unused = true;
+        break;
+      }
+    }
+    if (!unused && nodes[i].prevPhys == TLSF_NONE) {
+      if (first != TLSF_NONE) {
+        return false;
+      }
+      first = i;
+    }
+  }
+  if (first == TLSF_NONE || nodes[first].offset != 0) {
+    return false;
+  }
+  uint64_t end = 0;                                                       // 物理链表须无缝覆盖整个区间
+  uint64_t used = 0;
+  int used_count = 0;
+  int free_count = 0;
+  uint32_t prev = TLSF_NONE;
+  for (uint32_t i = first; i != TLSF_NONE; i = nodes[i].nextPhys) {
+    const TlsfNode &n = nodes[i];
+    if (n.offset != end || n.size == 0 || n.prevPhys != prev) {
+      return false;
+    }
+    if (n.free) {
+      if (prev != TLSF_NONE && nodes[prev].free) {                        // 相邻空闲段须已合并
+        return false;
+      }
+      int fl, sl;
+      mapping(n.size, fl, sl);
+      bool listed = false;
+      for (uint32_t j = heads[fl][sl]; j != TLSF_NONE; j = nodes[j].nextFree) {
+        if (j == i) {
+          listed = true;
+          break;
+        }
+      }
+      if (!listed) {
+        return false;
+      }
+      free_count++;
+    } else {
+      used += n.size;
+      used_count++;
+    }
+    end = n.offset + n.size;
+    prev = i;
+  }
+  return end == size && used == usedBytes && used_count == allocationCount && free_count == freeBlockCount();
+}
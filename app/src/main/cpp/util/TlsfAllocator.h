@@ -0,0 +1,98 @@
+#ifndef DEEPERVULKAN_TLSFALLOCATOR_H_
+#define DEEPERVULKAN_TLSFALLOCATOR_H_
+
+#include <vector>
+#include <cstdint>
+
+#define TLSF_SL_LOG2 5                                  // 每个一级区间划分的二级区间数的对数(32个)
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)               // 每个一级区间的二级区间数
+#define TLSF_FL_COUNT (64 - TLSF_SL_LOG2 + 1)           // 一级区间数(覆盖64位大小)
+#define TLSF_MIN_BLOCK 16                               // 切分后剩余不足该字节数时并入分配(避免碎块)
+#define TLSF_NONE 0xFFFFFFFFu                           // 空节点
+
+/**
+ * 地址区间中的一段(空闲或已分配), 按偏移量串成物理链表
+ */
+struct TlsfNode {
+  uint64_t offset;            // 起始偏移量
+  uint64_t size;              // 字节数
+  uint32_t prevPhys;          // 物理上相邻的前一段
+  uint32_t nextPhys;          // 物理上相邻的后一段
+  uint32_t prevFree;          // 同一空闲链表中的前一段
+  uint32_t nextFree;          // 同一空闲链表中的后一段
+  bool free;                  // 是否空闲
+};
+
+/**
+ * 两级分离适配(TLSF)分配器, 只管理[0, size)的偏移量, 不触及实际内存
+ * 空闲段按大小落入一级(2的幂)与二级(线性细分)区间, 查找、分配与释放均为常数时间,
+ * 释放时与物理相邻的空闲段立即合并; 节点放在数组中重用, 分配时返回节点号作为句柄
+ * 不依赖Vulkan与Android, 由设备内存分配器与几何缓冲池共用
+ */
+class TlsfAllocator {
+ public:
+  uint64_t size;              // 管理的总字节数
+  uint64_t usedBytes;         // 已分配字节数(含对齐填充)
+  int allocationCount;        // 当前分配数
+
+  explicit TlsfAllocator(uint64_t size);
+
+  /**
+   * 分配size字节并按alignment对齐, 成功时offset返回偏移量, handle返回释放用的句柄
+   */
+  bool allocate(uint64_t size, uint64_t alignment, uint64_t &offset, uint32_t &handle);
+
+  /**
+   * 释放句柄对应的分配, 并与相邻空闲段合并
+   */
+  void free(uint32_t handle);
+
+  /**
+   * 句柄对应分配的偏移量与字节数
+   */
+  uint64_t offsetOf(uint32_t handle) const;
+  uint64_t sizeOf(uint32_t handle) const;
+
+  /**
+   * 最大空闲段的字节数
+   */
+  uint64_t largestFree() const;
+
+  /**
+   * 空闲段数量(衡量碎片程度)
+   */
+  int freeBlockCount() const;
+
+  /**
+   * 检查物理链表与空闲链表的一致性(测试用)
+   */
+  bool validate() const;
+
+ private:
+  std::vector<TlsfNode> nodes;                          // 所有节点
+  std::vector<uint32_t> unusedNodes;                    // 可重用的节点号
+  uint64_t flBitmap;                                    // 非空的一级区间
+  uint32_t slBitmap[TLSF_FL_COUNT];                     // 各一级区间中非空的二级区间
+  uint32_t heads[TLSF_FL_COUNT][TLSF_SL_COUNT];         // 各区间空闲链表的头节点
+
+  /**
+   * 计算大小所在的区间(向下取整, 用于插入空闲段)
+   */
+  static void mapping(uint64_t size, int &fl, int &sl);
+
+  /**
+   * 计算能保证放下该大小的区间(向上取整, 用于查找)
+   */
+  static void mappingSearch(uint64_t size, int &fl, int &sl);
+
+  uint32_t newNode();
+  void insertFree(uint32_t node);
+  void removeFree(uint32_t node);
+
+  /**
+   * 从指定区间起查找第一个非空区间的空闲段
+   */
+  uint32_t findSuitable(int fl, int sl) const;
+};
+
+#endif //DEEPERVULKAN_TLSFALLOCATOR_H_
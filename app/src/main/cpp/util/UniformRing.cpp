@@ -0,0 +1,111 @@
+#include "UniformRing.h"
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include "../bndev/mylog.h"
+
+VkBuffer UniformRing::buffer = VK_NULL_HANDLE;
+VkDeviceSize UniformRing::alignment = 256;
+VkDeviceSize UniformRing::frameBytes = 0;
+int UniformRing::frameCount = 0;
+VkDeviceSize UniformRing::peakFrameBytes = 0;
+int UniformRing::overflowCount = 0;
+MemoryAllocation UniformRing::memory;
+int UniformRing::frame = 0;
+VkDeviceSize UniformRing::head = 0;
+
+static const VkFlags uniformPreferences[] = {                             // CPU每帧写入、GPU读取
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+};
+
+void UniformRing::create(VkDevice &device, VkPhysicalDevice &gpu, VkDeviceSize frameBytes, int frameCount) {
+  VkPhysicalDeviceProperties gpuProps;
+  vk::vkGetPhysicalDeviceProperties(gpu, &gpuProps);
+  create(device, gpuProps.limits.minUniformBufferOffsetAlignment, frameBytes, frameCount);
+}
+
+void UniformRing::create(VkDevice &device, VkDeviceSize alignment, VkDeviceSize frameBytes, int frameCount) {
+  assert(frameCount >= 1);
+  UniformRing::alignment = std::max(alignment, (VkDeviceSize) 1);
+  UniformRing::frameBytes = (frameBytes + UniformRing::alignment - 1) / UniformRing::alignment *
+                            UniformRing::alignment;                       // 各帧区域的起点同样满足对齐
+  UniformRing::frameCount = frameCount;
+
+  VkBufferCreateInfo buf_info = {};
+  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buf_info.pNext = nullptr;
+  buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  buf_info.size = UniformRing::frameBytes * frameCount;
+  buf_info.queueFamilyIndexCount = 0;
+  buf_info.pQueueFamilyIndices = nullptr;
+  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buf_info.flags = 0;
+  VkResult result = vk::vkCreateBuffer(device, &buf_info, nullptr, &buffer);
+  assert(result == VK_SUCCESS);
+  DeviceMemoryAllocator::allocateBuffer(                                  // 统一内存时放在设备本地内存中
+      device, buffer, uniformPreferences, sizeof(uniformPreferences) / sizeof(VkFlags), memory);
+  assert(memory.mapped != nullptr);
+
+  frame = frameCount - 1;                                                 // 第一次beginFrame后从0号区域开始
+  head = 0;
+  peakFrameBytes = 0;
+  overflowCount = 0;
+  LOGI("UniformRing created: %d frames x %d bytes, alignment %d",
+       frameCount, (int) UniformRing::frameBytes, (int) UniformRing::alignment);
+}
+
+void UniformRing::destroy(VkDevice &device) {
+  logStats();
+  vk::vkDestroyBuffer(device, buffer, nullptr);
+  DeviceMemoryAllocator::free(device, memory);
+  buffer = VK_NULL_HANDLE;
+}
+
+void UniformRing::beginFrame() {
+  frame = (frame + 1) % frameCount;
+  head = 0;
+}
+
+bool UniformRing::allocate(VkDeviceSize size, uint32_t &offset, uint8_t *&pData) {
+  VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+  if (aligned + size > frameBytes) {
+    overflowCount++;
+    LOGE("UniformRing: frame region full (%d of %d bytes)", (int) head, (int) frameBytes);
+    return false;
+  }
+  head = aligned + size;
+  peakFrameBytes = std::max(peakFrameBytes, head);
+  offset = (uint32_t) (frameBytes * frame + aligned);
+  pData = memory.mapped + offset;
+  return true;
+}
+
+uint32_t UniformRing::push(const void *data, VkDeviceSize size) {
+  uint32_t offset = 0;
+  uint8_t *pData = nullptr;
+  bool flag = allocate(size, offset, pData);
+  assert(flag);                                                           // 区域不足时应增大frameBytes
+  memcpy(pData, data, (size_t) size);
+  return offset;
+}
+
+void UniformRing::flush(VkDevice &device) {
+  if (head > 0) {
+    DeviceMemoryAllocator::flush(device, memory, frameBytes * frame, head);
+  }
+}
+
+VkDescriptorBufferInfo UniformRing::descriptorInfo(VkDeviceSize range) {
+  VkDescriptorBufferInfo info;
+  info.buffer = buffer;
+  info.offset = 0;
+  info.range = range;
+  return info;
+}
+
+void UniformRing::logStats() {
+  LOGI("UniformRing: peak %d of %d bytes per frame, %d overflows",
+       (int) peakFrameBytes, (int) frameBytes, overflowCount);
+}
@@ -0,0 +1,78 @@
+#ifndef DEEPERVULKAN_UNIFORMRING_H_
+#define DEEPERVULKAN_UNIFORMRING_H_
+
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "DeviceMemoryAllocator.h"
+
+#define UNIFORM_RING_FRAME_BYTES (256 * 1024)   // 每帧区域的默认字节数
+#define UNIFORM_RING_FRAMES 3                    // 默认帧区域数(不少于同时在途的帧数)
+
+/**
+ * 每帧一致变量的环形缓冲
+ * 一个缓冲按帧分成若干区域, 创建时映射一次并一直保持; 每帧开始时切换到下一个区域并从头线性分配,
+ * 写入的数据以VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC的动态偏移量在绑定描述集时指定
+ * 区域在frameCount帧之后才被重写, 不会与仍在GPU上执行的帧冲突; 每个物体都可以分配自己的一致变量
+ */
+class UniformRing {
+ public:
+  static VkBuffer buffer;                       // 一致变量缓冲
+  static VkDeviceSize alignment;                // 动态偏移量的对齐值(minUniformBufferOffsetAlignment)
+  static VkDeviceSize frameBytes;               // 每帧区域的字节数
+  static int frameCount;                        // 帧区域数
+  static VkDeviceSize peakFrameBytes;           // 单帧分配字节数的峰值(统计用)
+  static int overflowCount;                     // 因本帧区域已满而分配失败的次数(统计用)
+
+  /**
+   * 读取设备的偏移量对齐要求并创建环形缓冲(须在DeviceMemoryAllocator::init之后调用)
+   */
+  static void create(VkDevice &device, VkPhysicalDevice &gpu, VkDeviceSize frameBytes = UNIFORM_RING_FRAME_BYTES,
+                     int frameCount = UNIFORM_RING_FRAMES);
+
+  /**
+   * 以给定的对齐值创建环形缓冲
+   */
+  static void create(VkDevice &device, VkDeviceSize alignment, VkDeviceSize frameBytes, int frameCount);
+
+  /**
+   * 销毁环形缓冲(须在所有帧执行完毕之后调用)
+   */
+  static void destroy(VkDevice &device);
+
+  /**
+   * 每帧开始时调用: 切换到下一个帧区域(调用者须保证该区域frameCount帧之前的提交已执行完)
+   */
+  static void beginFrame();
+
+  /**
+   * 在本帧区域中分配size字节, offset返回动态偏移量, pData返回映射后的CPU地址, 区域已满时返回false
+   */
+  static bool allocate(VkDeviceSize size, uint32_t &offset, uint8_t *&pData);
+
+  /**
+   * 把size字节的data写入本帧区域, 返回绑定描述集时使用的动态偏移量
+   */
+  static uint32_t push(const void *data, VkDeviceSize size);
+
+  /**
+   * 提交命令缓冲之前调用: 内存非一致时刷新本帧写入的范围
+   */
+  static void flush(VkDevice &device);
+
+  /**
+   * 描述集写入使用的缓冲信息(偏移量为0, 实际位置由动态偏移量给出)
+   */
+  static VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range);
+
+  /**
+   * 打印统计信息
+   */
+  static void logStats();
+
+ private:
+  static MemoryAllocation memory;               // 缓冲对应的设备内存(从子分配器分配并保持映射)
+  static int frame;                             // 当前帧区域编号
+  static VkDeviceSize head;                     // 当前帧区域中的写指针(相对区域起点)
+};
+
+#endif //DEEPERVULKAN_UNIFORMRING_H_
@@ -0,0 +1,464 @@
+#include "VirtualTexture.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include "../bndev/mylog.h"
+
+VirtualTexture::VirtualTexture(int width, int height, int cacheCols, int cacheRows, VtTileReader reader,
+                               bool threaded) {
+  this->width = width;
+  this->height = height;
+  this->cacheCols = cacheCols;
+  this->cacheRows = cacheRows;
+  this->reader = reader;
+  this->threaded = threaded;
+  uploadsPerFrame = VT_UPLOADS_PER_FRAME;
+  protectFrames = 1;
+  frame = 0;
+  requestedPages = 0;
+  residentHits = 0;
+  loadedTiles = 0;
+  evictedTiles = 0;
+  droppedTiles = 0;
+  dirty = true;
+  stopLoader = false;
+  assert(pagesX(0) <= 4096 && pagesY(0) <= 4096);                        // 页号在页标识中占12位
+
+  levels = 1;
+  while (pagesX(levels - 1) > 1 || pagesY(levels - 1) > 1) {              // 直到整级只有一页
+    levels++;
+  }
+  assert(cacheCols * cacheRows > levels);                                 // 至少能容纳一条从最粗到最细的页链
+  pageTable.resize(levels);
+  for (int mip = 0; mip < levels; ++mip) {
+    pageTable[mip].assign(pagesX(mip) * pagesY(mip), -1);
+  }
+  feedbackMip.assign(pagesX(0) * pagesY(0), VT_FEEDBACK_NONE);
+
+  slots.resize(cacheCols * cacheRows);
+  for (int i = (int) slots.size() - 1; i >= 0; --i) {                     // 从0号槽位开始使用
+    slots[i].key = 0;
+    slots[i].state = 0;
+    slots[i].pinned = false;
+    slots[i].lastUsedFrame = -1;
+    slots[i].prev = -1;
+    slots[i].next = -1;
+    freeSlots.push_back(i);
+  }
+  lruHead = -1;
+  lruTail = -1;
+
+  requestPage(levels - 1, 0, 0, 1);                                       // 最粗一级作为所有页的最终回退
+  if (threaded) {
+    loaderThread = std::thread(&VirtualTexture::loaderMain, this);
+  }
+}
+
+VirtualTexture::~VirtualTexture() {
+  if (threaded) {
+    {
+      std::lock_guard<std::mutex> lock(loaderMutex);
+      stopLoader = true;
+    }
+    loaderCondition.notify_all();
+    loaderThread.join();
+  }
+  for (size_t i = 0; i < completedTiles.size(); ++i) {                    // 删除未放入缓存的瓦片
+    delete[] completedTiles[i].pixels;
+  }
+}
+
+int VirtualTexture::pagesX(int mip) const {
+  int w = std::max(1, width >> mip);
+  return (w + VT_TILE_CONTENT - 1) / VT_TILE_CONTENT;
+}
+
+int VirtualTexture::pagesY(int mip) const {
+  int h = std::max(1, height >> mip);
+  return (h + VT_TILE_CONTENT - 1) / VT_TILE_CONTENT;
+}
+
+void VirtualTexture::processFeedback(const uint32_t *feedback, int count) {
+  int pagesX0 = pagesX(0);
+  assert(count == pagesX0 * pagesY(0));
+  for (int i = 0; i < count; ++i) {
+    uint32_t mip = feedback[i];
+    if (mip != VT_FEEDBACK_NONE && mip >= (uint32_t) levels) {            // 过度缩小时使用最粗一级
+      mip = levels - 1;
+    }
+    if (feedbackMip[i] != mip) {                                          // 请求级别变化时间接纹理需要重建
+      feedbackMip[i] = mip;
+      dirty = true;
+    }
+    if (mip == VT_FEEDBACK_NONE) {
+      continue;
+    }
+    int x0 = i % pagesX0;
+    int y0 = i / pagesX0;
+    requestedPages++;
+    for (int l = (int) mip; l < levels; ++l) {                            // 请求的页及其所有上级页(回退链)
+      int px = std::min(x0 >> l, pagesX(l) - 1);
+      int py = std::min(y0 >> l, pagesY(l) - 1);
+      if (l == (int) mip && pageTable[l][py * pagesX(l) + px] >= 0) {
+        residentHits++;
+      }
+      requestPage(l, px, py, 1);
+    }
+  }
+}
+
+void VirtualTexture::requestPage(int mip, int pageX, int pageY, int weight) {
+  int slot = pageTable[mip][pageY * pagesX(mip) + pageX];
+  if (slot >= 0) {                                                        // 已常驻, 只记录使用
+    touchSlot(slot);
+    return;
+  }
+  frameRequests[VT_PAGE_KEY(mip, pageX, pageY)] += weight;
+}
+
+void VirtualTexture::update(std::vector<VtTileUpload> &uploads) {
+  dispatchRequests();
+
+  std::vector<VtTileUpload> arrived;
+  {
+    std::lock_guard<std::mutex> lock(loaderMutex);
+    if (!threaded) {                                                      // 同步模式: 在本线程中加载队首的页
+      while (!loadQueue.empty() && (int) completedTiles.size() < uploadsPerFrame) {
+        completedTiles.push_back(loadTile(loadQueue.front()));
+        loadQueue.pop_front();
+      }
+    }
+    while (!completedTiles.empty() && (int) arrived.size() < uploadsPerFrame) {
+      arrived.push_back(completedTiles.front());
+      completedTiles.pop_front();
+    }
+  }
+
+  for (size_t i = 0; i < arrived.size(); ++i) {
+    VtTileUpload &tile = arrived[i];
+    int slot = acquireSlot();
+    if (slot < 0) {                                                       // 缓存中的页都在使用, 之后重新请求
+      droppedTiles++;
+      pendingPages.erase(tile.key);
+      delete[] tile.pixels;
+      continue;
+    }
+    VtSlot &s = slots[slot];
+    s.key = tile.key;
+    s.state = 1;                                                          // 上传完成前不写入页表
+    s.pinned = VT_PAGE_MIP(tile.key) == levels - 1;
+    touchSlot(slot);
+    tile.slot = slot;
+    tile.slotX = slot % cacheCols;
+    tile.slotY = slot / cacheCols;
+    uploads.push_back(tile);
+    loadedTiles++;
+  }
+  frame++;
+}
+
+void VirtualTexture::completeUpload(int slot) {
+  VtSlot &s = slots[slot];
+  assert(s.state == 1);
+  s.state = 2;
+  int mip = VT_PAGE_MIP(s.key);
+  pageTable[mip][VT_PAGE_Y(s.key) * pagesX(mip) + VT_PAGE_X(s.key)] = slot;
+  pendingPages.erase(s.key);
+  dirty = true;
+}
+
+int VirtualTexture::residentSlot(int mip, int pageX, int pageY) const {
+  return pageTable[mip][pageY * pagesX(mip) + pageX];
+}
+
+bool VirtualTexture::indirectionDirty() const {
+  return dirty;
+}
+
+void VirtualTexture::buildIndirection(unsigned char *dst, int rowPitch) {
+  int pagesX0 = pagesX(0);
+  int pagesY0 = pagesY(0);
+  for (int y0 = 0; y0 < pagesY0; ++y0) {
+    unsigned char *row = dst + y0 * rowPitch;
+    for (int x0 = 0; x0 < pagesX0; ++x0) {
+      uint32_t request = feedbackMip[y0 * pagesX0 + x0];
+      int first = request == VT_FEEDBACK_NONE ? 0 : (int) request;      // 不使用比请求更细的级别, 避免走样
+      unsigned char *texel = row + x0 * 4;
+      texel[0] = texel[1] = texel[2] = texel[3] = 0;                      // 没有常驻页(最粗一级尚未上传)
+      for (int l = first; l < levels; ++l) {
+        int px = std::min(x0 >> l, pagesX(l) - 1);                        // 与着色器中的计算保持一致
+        int py = std::min(y0 >> l, pagesY(l) - 1);
+        int slot = pageTable[l][py * pagesX(l) + px];
+        if (slot >= 0) {
+          texel[0] = (unsigned char) (slot % cacheCols);
+          texel[1] = (unsigned char) (slot / cacheCols);
+          texel[2] = (unsigned char) l;
+          texel[3] = 255;
+          break;
+        }
+      }
+    }
+  }
+  dirty = false;
+}
+
+void VirtualTexture::logStats() const {
+  int resident = 0;
+  for (size_t i = 0; i < slots.size(); ++i) {
+    resident += slots[i].state == 2 ? 1 : 0;
+  }
+  LOGI("VirtualTexture %dx%d (%d levels): %d/%d slots resident, hit rate %.1f%% (%lld/%lld), "
+       "loaded %d, evicted %d, dropped %d",
+       width, height, levels, resident, (int) slots.size(),
+       requestedPages ? 100.0 * residentHits / requestedPages : 0.0, residentHits, requestedPages,
+       loadedTiles, evictedTiles, droppedTiles);
+}
+
+void VirtualTexture::extractTile(const unsigned char *chain, const std::vector<int> &levelOffsets,
+                                 int width, int height, int mip, int pageX, int pageY, unsigned char *dst) {
+  int w = std::max(1, width >> mip);
+  int h = std::max(1, height >> mip);
+  const unsigned char *level = chain + levelOffsets[mip];
+  int originX = pageX * VT_TILE_CONTENT - VT_TILE_BORDER;                 // 瓦片左上角(含边框)在该级中的坐标
+  int originY = pageY * VT_TILE_CONTENT - VT_TILE_BORDER;
+  for (int ty = 0; ty < VT_TILE_SIZE; ++ty) {
+    int sy = std::min(std::max(originY + ty, 0), h - 1);                  // 超出图像时夹取到边缘
+    const unsigned char *srcRow = level + (size_t) sy * w * 4;
+    unsigned char *dstRow = dst + ty * VT_TILE_SIZE * 4;
+    for (int tx = 0; tx < VT_TILE_SIZE; ++tx) {
+      int sx = std::min(std::max(originX + tx, 0), w - 1);
+      memcpy(dstRow + tx * 4, srcRow + sx * 4, 4);
+    }
+  }
+}
+
+void VirtualTexture::loaderMain() {
+  std::unique_lock<std::mutex> lock(loaderMutex);
+  while (true) {
+    loaderCondition.wait(lock, [this] { return stopLoader || !loadQueue.empty(); });
+    if (stopLoader) {
+      return;
+    }
+    VtPageKey key = loadQueue.front();
+    loadQueue.pop_front();
+    lock.unlock();                                                        // 读取瓦片时不持有锁
+    VtTileUpload tile = loadTile(key);
+    lock.lock();
+    completedTiles.push_back(tile);
+  }
+}
+
+VtTileUpload VirtualTexture::loadTile(VtPageKey key) {
+  VtTileUpload tile;
+  tile.key = key;
+  tile.slot = -1;
+  tile.slotX = 0;
+  tile.slotY = 0;
+  tile.pixels = new unsigned char[VT_TILE_BYTES];
+  reader(VT_PAGE_MIP(key), VT_PAGE_X(key), VT_PAGE_Y(key), tile.pixels);
+  return tile;
+}
+
+/**
+ * 请求的排序依据: 粗级别优先, 同级引用数多的优先, 最后按页标识保证结果确定
+ */
+static bool morePressing(const std::pair<VtPageKey, int> &a, const std::pair<VtPageKey, int> &b) {
+  if (VT_PAGE_MIP(a.first) != VT_PAGE_MIP(b.first)) {
+    return VT_PAGE_MIP(a.first) > VT_PAGE_MIP(b.first);
+  }
+  if (a.second != b.second) {
+    return a.second > b.second;
+  }
+  return a.first < b.first;
+}
+
+void VirtualTexture::dispatchRequests() {
+  std::lock_guard<std::mutex> lock(loaderMutex);
+  for (size_t i = 0; i < loadQueue.size(); ++i) {                         // 尚未开始加载的旧请求作废, 按本帧反馈重新排队
+    pendingPages.erase(loadQueue[i]);
+  }
+  loadQueue.clear();
+
+  std::vector<std::pair<VtPageKey, int> > candidates;
+  for (std::unordered_map<VtPageKey, int>::iterator it = frameRequests.begin(); it != frameRequests.end(); ++it) {
+    if (pendingPages.find(it->first) == pendingPages.end()) {             // 正在加载或等待上传的页不重复请求
+      candidates.push_back(*it);
+    }
+  }
+  frameRequests.clear();
+  size_t count = std::min(candidates.size(), (size_t) VT_LOADER_QUEUE_DEPTH);
+  std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), morePressing);
+  for (size_t i = 0; i < count; ++i) {
+    loadQueue.push_back(candidates[i].first);
+    pendingPages.insert(candidates[i].first);
+  }
+  if (threaded && count > 0) {
+    loaderCondition.notify_one();
+  }
+}
+
+int VirtualTexture::acquireSlot() {
+  if (!freeSlots.empty()) {
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+  }
+  for (int slot = lruTail; slot >= 0; slot = slots[slot].prev) {         // 从最久未使用的一端查找
+    VtSlot &s = slots[slot];
+    if (frame - s.lastUsedFrame < protectFrames) {                        // 之后的槽位使用得更近, 都不可逐出
+      return -1;
+    }
+    if (s.state != 2 || s.pinned) {
+      continue;
+    }
+    int mip = VT_PAGE_MIP(s.key);
+    pageTable[mip][VT_PAGE_Y(s.key) * pagesX(mip) + VT_PAGE_X(s.key)] = -1; // 立即从页表中移除
+    dirty = true;
+    evictedTiles++;
+    unlinkSlot(slot);
+    return slot;
+  }
+  return -1;
+}
+
+void VirtualTexture::touchSlot(int slot) {
+  slots[slot].lastUsedFrame = frame;
+  if (lruHead == slot) {
+    return;
+  }
+  unlinkSlot(slot);
+  slots[slot].next = lruHead;
+  if (lruHead >= 0) {
+    slots[lruHead].prev = slot;
+  }
+  lruHead = slot;
+  if (lruTail < 0) {
+    lruTail = slot;
+  }
+}
+
+void VirtualTexture::unlinkSlot(int slot) {
+  VtSlot &s = slots[slot];
+  if (s.prev >= 0) {
+    slots[s.prev].next = s.next;
+  } else if (lruHead == slot) {
+    lruHead = s.next;
+  }
+  if (s.next >= 0) {
+    slots[s.next].prev = s.prev;
+  } else if (lruTail == slot) {
+    lruTail = s.prev;
+  }
+  s.prev = -1;
+  s.next = -1;
+}
+
+bool VirtualTexture::simulate(int width, int height, int cacheCols, int cacheRows, int frames, bool threaded) {
+  // 合成瓦片: 前4字节写入页标识, 用于检查放入缓存的瓦片与页是否对应
+  VtTileReader reader = [threaded](int mip, int pageX, int pageY, unsigned char *dst) {
+    VtPageKey key = VT_PAGE_KEY(mip, pageX, pageY);
+    memset(dst, mip * 32, VT_TILE_BYTES);
+    memcpy(dst, &key, sizeof(key));
+    if (threaded) {                                                       // 模拟读取与解码的耗时
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+  };
+  VirtualTexture vt(width, height, cacheCols, cacheRows, reader, threaded);
+  int pagesX0 = vt.pagesX(0);
+  int pagesY0 = vt.pagesY(0);
+  std::vector<uint32_t> feedback(pagesX0 * pagesY0);
+  std::vector<unsigned char> indirection(pagesX0 * pagesY0 * 4);
+  std::vector<VtTileUpload> inFlight;                                     // 上一帧放入、本帧上传完成的瓦片
+  const int viewW = 1280;                                                 // 模拟的视口大小(屏幕像素)
+  const int viewH = 720;
+  bool ok = true;
+
+  for (int f = 0; f < frames && ok; ++f) {
+    for (size_t i = 0; i < inFlight.size(); ++i) {                        // 模拟一帧的上传延迟
+      vt.completeUpload(inFlight[i].slot);
+    }
+    inFlight.clear();
+
+    // 视口水平平移并在0.5到32倍之间缩放(每个屏幕像素覆盖的第0级纹素数)
+    float zoom = powf(2.0f, 2.0f + 3.0f * sinf(f * 0.013f));
+    float centerX = fmodf(f * 37.0f, (float) width);
+    float centerY = height * (0.5f + 0.3f * sinf(f * 0.007f));
+    int mip = std::max(0, (int) floorf(log2f(zoom)));
+    int x0 = std::max(0, (int) ((centerX - viewW * 0.5f * zoom) / VT_TILE_CONTENT));
+    int x1 = std::min(pagesX0 - 1, (int) ((centerX + viewW * 0.5f * zoom) / VT_TILE_CONTENT));
+    int y0 = std::max(0, (int) ((centerY - viewH * 0.5f * zoom) / VT_TILE_CONTENT));
+    int y1 = std::min(pagesY0 - 1, (int) ((centerY + viewH * 0.5f * zoom) / VT_TILE_CONTENT));
+    std::fill(feedback.begin(), feedback.end(), VT_FEEDBACK_NONE);
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        feedback[y * pagesX0 + x] = (uint32_t) mip;
+      }
+    }
+    vt.processFeedback(feedback.data(), (int) feedback.size());
+
+    std::vector<VtTileUpload> uploads;
+    vt.update(uploads);
+    for (size_t i = 0; i < uploads.size(); ++i) {
+      VtPageKey key;
+      memcpy(&key, uploads[i].pixels, sizeof(key));
+      if (key != uploads[i].key || uploads[i].slotY * cacheCols + uploads[i].slotX != uploads[i].slot) {
+        LOGE("VirtualTexture simulate: frame %d tile/page mismatch", f);
+        ok = false;
+      }
+      delete[] uploads[i].pixels;
+      inFlight.push_back(uploads[i]);
+    }
+
+    // 页表与槽位双向一致, 间接纹理只指向常驻且页号匹配的槽位
+    int mapped = 0;
+    for (int l = 0; l < vt.levels; ++l) {
+      for (int py = 0; py < vt.pagesY(l); ++py) {
+        for (int px = 0; px < vt.pagesX(l); ++px) {
+          int slot = vt.residentSlot(l, px, py);
+          if (slot < 0) {
+            continue;
+          }
+          mapped++;
+          if (vt.slots[slot].state != 2 || vt.slots[slot].key != VT_PAGE_KEY(l, px, py)) {
+            LOGE("VirtualTexture simulate: frame %d page table entry (%d,%d,%d) inconsistent", f, l, px, py);
+            ok = false;
+          }
+        }
+      }
+    }
+    int resident = 0;
+    for (size_t i = 0; i < vt.slots.size(); ++i) {
+      resident += vt.slots[i].state == 2 ? 1 : 0;
+    }
+    if (resident != mapped) {
+      LOGE("VirtualTexture simulate: frame %d %d resident slots but %d mapped pages", f, resident, mapped);
+      ok = false;
+    }
+    vt.buildIndirection(indirection.data(), pagesX0 * 4);
+    for (int i = 0; i < pagesX0 * pagesY0; ++i) {
+      unsigned char *texel = &indirection[i * 4];
+      if (texel[3] == 0) {
+        continue;
+      }
+      int l = texel[2];
+      int slot = texel[1] * cacheCols + texel[0];
+      int px = std::min((i % pagesX0) >> l, vt.pagesX(l) - 1);
+      int py = std::min((i / pagesX0) >> l, vt.pagesY(l) - 1);
+      if (vt.slots[slot].state != 2 || vt.slots[slot].key != VT_PAGE_KEY(l, px, py) ||
+          (feedback[i] != VT_FEEDBACK_NONE && l < std::min((int) feedback[i], vt.levels - 1))) {
+        LOGE("VirtualTexture simulate: frame %d indirection texel %d points to wrong slot", f, i);
+        ok = false;
+      }
+    }
+  }
+  vt.logStats();
+  bool topResident = vt.residentSlot(vt.levels - 1, 0, 0) >= 0;
+  if (frames > 2 && !topResident) {                                       // 最粗一级须已常驻
+    LOGE("VirtualTexture simulate: coarsest page not resident");
+    ok = false;
+  }
+  LOGI("VirtualTexture simulate %s", ok ? "passed" : "FAILED");
+  return ok;
+}
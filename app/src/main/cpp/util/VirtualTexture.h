@@ -0,0 +1,198 @@
+#ifndef DEEPERVULKAN_VIRTUALTEXTURE_H_
+#define DEEPERVULKAN_VIRTUALTEXTURE_H_
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#define VT_TILE_SIZE 128                                    // 物理缓存中一个瓦片的边长(含边框)
+#define VT_TILE_BORDER 4                                    // 瓦片每边的边框像素数(双线性与各向异性过滤不越界)
+#define VT_TILE_CONTENT (VT_TILE_SIZE - 2 * VT_TILE_BORDER) // 瓦片有效内容的边长
+#define VT_TILE_BYTES (VT_TILE_SIZE * VT_TILE_SIZE * 4)     // 一个RGBA8瓦片的字节数
+#define VT_UPLOADS_PER_FRAME 8                              // 每帧最多放入物理缓存的瓦片数量
+#define VT_LOADER_QUEUE_DEPTH 32                            // 加载队列的最大长度(每帧按优先级重建)
+#define VT_FEEDBACK_NONE 0xFFFFFFFFu                        // 反馈缓冲中本帧未被采样的页
+
+typedef uint32_t VtPageKey;                                 // 页标识: mip级(8位) | 页行号(12位) | 页列号(12位)
+#define VT_PAGE_KEY(mip, x, y) (((VtPageKey) (mip) << 24) | ((VtPageKey) (y) << 12) | (VtPageKey) (x))
+#define VT_PAGE_MIP(key) ((int) ((key) >> 24))
+#define VT_PAGE_Y(key) ((int) (((key) >> 12) & 0xFFF))
+#define VT_PAGE_X(key) ((int) ((key) & 0xFFF))
+
+/**
+ * 读取一个瓦片(含边框)的RGBA8数据到dst, 在加载线程中调用
+ */
+typedef std::function<void(int mip, int pageX, int pageY, unsigned char *dst)> VtTileReader;
+
+/**
+ * 待放入物理缓存的瓦片
+ */
+struct VtTileUpload {
+  VtPageKey key;              // 瓦片对应的页
+  int slot;                   // 物理缓存中的槽位
+  int slotX;                  // 槽位在物理缓存中的列号
+  int slotY;                  // 槽位在物理缓存中的行号
+  unsigned char *pixels;      // 瓦片数据(VT_TILE_BYTES字节, 由调用者删除)
+};
+
+/**
+ * 物理缓存中的一个槽位, 同时是LRU双向链表的节点
+ */
+struct VtSlot {
+  VtPageKey key;              // 占用该槽位的页
+  int state;                  // 0-空闲 1-上传中(不参与映射) 2-常驻
+  bool pinned;                // 是否常驻不逐出(最粗一级的页)
+  long long lastUsedFrame;    // 最近一次被反馈引用的帧号
+  int prev;                   // LRU链表中更近使用的槽位(-1为无)
+  int next;                   // LRU链表中更久未使用的槽位(-1为无)
+};
+
+/**
+ * 虚拟纹理的CPU端核心: 页表、物理缓存槽位的LRU替换、请求优先级与后台瓦片加载
+ * 源图像各级按VT_TILE_CONTENT划分为页, 每页加上边框后作为一个瓦片放入物理缓存的一个槽位
+ * 反馈缓冲对第0级的每页记录本帧需要的最细mip级, 缺失的页(及其所有上级页)按优先级交给加载线程,
+ * 加载完成的瓦片由update交给调用者上传, 上传完成后调用completeUpload才写入页表
+ * 不依赖Vulkan与Android, 可在主机上用模拟的反馈流测试(见simulate)
+ */
+class VirtualTexture {
+ public:
+  int width;                  // 虚拟纹理第0级宽度
+  int height;                 // 虚拟纹理第0级高度
+  int levels;                 // mip级数(最粗一级只有一页)
+  int cacheCols;              // 物理缓存每行的槽位数
+  int cacheRows;              // 物理缓存的槽位行数
+  int uploadsPerFrame;        // 每帧最多放入物理缓存的瓦片数量
+  int protectFrames;          // 最近这么多帧内被引用的槽位不逐出(不小于同时在途的帧数)
+  long long frame;            // 当前帧号
+  long long requestedPages;   // 累计被反馈引用的页数(统计用)
+  long long residentHits;     // 其中请求的mip级已常驻的页数(统计用)
+  int loadedTiles;            // 累计加载的瓦片数(统计用)
+  int evictedTiles;           // 累计逐出的瓦片数(统计用)
+  int droppedTiles;           // 因没有可逐出的槽位而丢弃的瓦片数(统计用)
+
+  /**
+   * 创建虚拟纹理, threaded为false时在update中同步加载(用于确定性的测试)
+   * 最粗一级的页立即进入加载队列并在放入后常驻
+   */
+  VirtualTexture(int width, int height, int cacheCols, int cacheRows, VtTileReader reader, bool threaded = true);
+  ~VirtualTexture();
+
+  /**
+   * 指定mip级在水平/竖直方向上的页数
+   */
+  int pagesX(int mip) const;
+  int pagesY(int mip) const;
+
+  /**
+   * 处理一帧的反馈: feedback按行存放第0级每页需要的最细mip级(VT_FEEDBACK_NONE为未采样)
+   * 常驻页记为已使用, 缺失页及其缺失的上级页加入本帧请求
+   */
+  void processFeedback(const uint32_t *feedback, int count);
+
+  /**
+   * 请求一页, weight为引用它的第0级页数(优先级依据之一)
+   */
+  void requestPage(int mip, int pageX, int pageY, int weight);
+
+  /**
+   * 进入下一帧: 按优先级重建加载队列, 取出已加载的瓦片分配槽位(必要时逐出LRU槽位)并填入uploads
+   * 被逐出的页立即从页表中移除
+   */
+  void update(std::vector<VtTileUpload> &uploads);
+
+  /**
+   * 瓦片已上传到物理缓存, 写入页表
+   */
+  void completeUpload(int slot);
+
+  /**
+   * 页常驻时返回其槽位, 否则返回-1
+   */
+  int residentSlot(int mip, int pageX, int pageY) const;
+
+  /**
+   * 页表是否在上次生成间接纹理之后发生了变化
+   */
+  bool indirectionDirty() const;
+
+  /**
+   * 生成间接纹理数据: 第0级每页一个RGBA8像素(槽位列号, 槽位行号, mip级, 255为有效)
+   * 取不粗于反馈请求级别的最细常驻页, 没有反馈时取最细常驻页, rowPitch为每行字节数
+   */
+  void buildIndirection(unsigned char *dst, int rowPitch);
+
+  /**
+   * 打印统计信息
+   */
+  void logStats() const;
+
+  /**
+   * 从紧密排列的RGBA8 mip链中切出一个瓦片(边框取相邻像素, 超出图像时夹取到边缘)
+   */
+  static void extractTile(const unsigned char *chain, const std::vector<int> &levelOffsets,
+                          int width, int height, int mip, int pageX, int pageY, unsigned char *dst);
+
+  /**
+   * 主机端模拟: 以合成的瓦片与平移缩放的视口产生反馈流, 检查页表与缓存的一致性并打印命中率
+   * 返回是否通过一致性检查
+   */
+  static bool simulate(int width, int height, int cacheCols, int cacheRows, int frames, bool threaded);
+
+ private:
+  VtTileReader reader;                                    // 瓦片读取函数
+  std::vector<std::vector<int> > pageTable;               // 各级每页对应的常驻槽位(-1为未常驻)
+  std::vector<uint32_t> feedbackMip;                      // 最近一次反馈中第0级每页请求的mip级
+  std::vector<VtSlot> slots;                              // 物理缓存槽位
+  int lruHead;                                            // 最近使用的槽位
+  int lruTail;                                            // 最久未使用的槽位
+  std::vector<int> freeSlots;                             // 空闲槽位
+  std::unordered_map<VtPageKey, int> frameRequests;       // 本帧请求的页及其权重
+  std::unordered_set<VtPageKey> pendingPages;             // 已交给加载线程或等待上传的页
+  bool dirty;                                             // 页表是否发生了变化
+
+  bool threaded;                                          // 是否使用加载线程
+  std::thread loaderThread;                               // 加载线程
+  std::mutex loaderMutex;                                 // 保护以下加载队列与完成队列
+  std::condition_variable loaderCondition;                // 加载队列非空或退出时通知
+  std::deque<VtPageKey> loadQueue;                        // 等待加载的页(按优先级排列)
+  std::deque<VtTileUpload> completedTiles;                // 已加载等待放入缓存的瓦片
+  bool stopLoader;                                        // 通知加载线程退出
+
+  /**
+   * 加载线程主循环
+   */
+  void loaderMain();
+
+  /**
+   * 加载一页的瓦片数据
+   */
+  VtTileUpload loadTile(VtPageKey key);
+
+  /**
+   * 按优先级重建加载队列: 粗级别优先(作为细级别的回退), 同级按引用数降序
+   */
+  void dispatchRequests();
+
+  /**
+   * 为已加载的瓦片分配槽位, 返回槽位(没有可用槽位时返回-1)
+   */
+  int acquireSlot();
+
+  /**
+   * 将槽位移到LRU链表头部
+   */
+  void touchSlot(int slot);
+
+  /**
+   * 将槽位从LRU链表中摘下
+   */
+  void unlinkSlot(int slot);
+};
+
+#endif //DEEPERVULKAN_VIRTUALTEXTURE_H_
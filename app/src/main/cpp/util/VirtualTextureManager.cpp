@@ -0,0 +1,304 @@
+#include "VirtualTextureManager.h"
+#include <cassert>
+#include <cstring>
+#include "AsyncUploader.h"
+#include "StagingRing.h"
+#include "SamplerCache.h"
+#include "MipmapGenerator.h"
+#include "FileUtil.h"
+#include "HelpFunction.h"
+#include "../bndev/mylog.h"
+
+VirtualTexture *VirtualTextureManager::vt = nullptr;
+VkImage VirtualTextureManager::cacheImage = VK_NULL_HANDLE;
+VkImage VirtualTextureManager::indirectionImage = VK_NULL_HANDLE;
+VkBuffer VirtualTextureManager::feedbackBuffer = VK_NULL_HANDLE;
+VkDescriptorImageInfo VirtualTextureManager::cacheImageInfo;
+VkDescriptorImageInfo VirtualTextureManager::indirectionImageInfo;
+VkDescriptorBufferInfo VirtualTextureManager::feedbackBufferInfo;
+bool VirtualTextureManager::feedbackSupported = false;
+TexDataObject *VirtualTextureManager::chain = nullptr;
+std::vector<int> VirtualTextureManager::levelOffsets;
+int VirtualTextureManager::sourceWidth = 0;
+int VirtualTextureManager::sourceHeight = 0;
+MemoryAllocation VirtualTextureManager::cacheMemory;
+VkImageView VirtualTextureManager::cacheView = VK_NULL_HANDLE;
+MemoryAllocation VirtualTextureManager::indirectionMemory;
+VkImageView VirtualTextureManager::indirectionView = VK_NULL_HANDLE;
+unsigned char *VirtualTextureManager::indirectionMapped = nullptr;
+int VirtualTextureManager::indirectionRowPitch = 0;
+MemoryAllocation VirtualTextureManager::feedbackMemory;
+uint32_t *VirtualTextureManager::feedbackMapped = nullptr;
+std::vector<uint32_t> VirtualTextureManager::fallbackFeedback;
+std::vector<std::pair<unsigned long long, int> > VirtualTextureManager::uploadTickets;
+int VirtualTextureManager::framesInFlight = 1;
+
+/**
+ * 创建2D图像并从子分配器分配、绑定指定属性的设备内存
+ */
+static void createImage(VkDevice &device, uint32_t width, uint32_t height, VkImageTiling tiling,
+                        VkImageUsageFlags usage, VkImageLayout initialLayout, VkFlags memoryMask,
+                        VkImage &image, MemoryAllocation &memory) {
+  uint32_t families[2] = {AsyncUploader::graphicsFamilyIndex, AsyncUploader::transferFamilyIndex};
+  VkImageCreateInfo image_create_info = {};
+  image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_create_info.pNext = nullptr;
+  image_create_info.imageType = VK_IMAGE_TYPE_2D;
+  image_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+  image_create_info.extent.width = width;
+  image_create_info.extent.height = height;
+  image_create_info.extent.depth = 1;
+  image_create_info.mipLevels = 1;
+  image_create_info.arrayLayers = 1;
+  image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_create_info.tiling = tiling;
+  image_create_info.initialLayout = initialLayout;
+  image_create_info.usage = usage;
+  if (AsyncUploader::dedicated) {                                         // 传输队列与图形队列同时访问, 不转移所有权
+    image_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    image_create_info.queueFamilyIndexCount = 2;
+    image_create_info.pQueueFamilyIndices = families;
+  } else {
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.queueFamilyIndexCount = 0;
+    image_create_info.pQueueFamilyIndices = nullptr;
+  }
+  image_create_info.flags = 0;
+  VkResult result = vk::vkCreateImage(device, &image_create_info, nullptr, &image);
+  assert(result == VK_SUCCESS);
+
+  DeviceMemoryAllocator::allocateImage(device, image, memoryMask, tiling == VK_IMAGE_TILING_OPTIMAL, memory);
+}
+
+/**
+ * 创建2D图像视图
+ */
+static VkImageView createView(VkDevice &device, VkImage image) {
+  VkImageViewCreateInfo view_info = {};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.pNext = nullptr;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+  view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+  view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+  view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+  view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = 1;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+  view_info.image = image;
+  VkImageView view;
+  VkResult result = vk::vkCreateImageView(device, &view_info, nullptr, &view);
+  assert(result == VK_SUCCESS);
+  return view;
+}
+
+void VirtualTextureManager::create(VkDevice &device, VkPhysicalDevice &gpu,
+                                   VkPhysicalDeviceMemoryProperties &memoryroperties,
+                                   VkCommandBuffer &cmdBuffer, VkQueue &queueGraphics, std::string texName,
+                                   int cacheCols, int cacheRows) {
+  assert(AsyncUploader::active());                                        // 瓦片通过传输队列上传
+  VkFormatProperties formatProps;
+  vk::vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
+  assert(formatProps.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT); // 间接纹理使用线性瓦片组织方式
+  VkPhysicalDeviceFeatures features;
+  vk::vkGetPhysicalDeviceFeatures(gpu, &features);
+  feedbackSupported = features.fragmentStoresAndAtomics == VK_TRUE;       // 逻辑设备已启用所有支持的特性
+
+  // 源图像的完整mip链留在CPU内存中, 加载线程从中切出瓦片(大型纹理可改为读取预先切好的瓦片文件)
+  TexDataObject *base = FileUtil::loadCommonTexData(texName);
+  sourceWidth = base->width;
+  sourceHeight = base->height;
+  chain = MipmapGenerator::generate(base, MipmapGenerator::getLevelCount(base->width, base->height), levelOffsets,
+                                    MipmapOptions());
+  delete base;
+  VtTileReader reader = [](int mip, int pageX, int pageY, unsigned char *dst) {
+    VirtualTexture::extractTile(chain->data, levelOffsets, sourceWidth, sourceHeight, mip, pageX, pageY, dst);
+  };
+  vt = new VirtualTexture(sourceWidth, sourceHeight, cacheCols, cacheRows, reader);
+  vt->protectFrames = framesInFlight;
+
+  // 物理缓存纹理(设备本地)与间接纹理(主机可见的线性图像)
+  createImage(device, cacheCols * VT_TILE_SIZE, cacheRows * VT_TILE_SIZE, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cacheImage, cacheMemory);
+  createImage(device, vt->pagesX(0), vt->pagesY(0), VK_IMAGE_TILING_LINEAR,
+              VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_PREINITIALIZED,
+              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+              indirectionImage, indirectionMemory);
+  VkImageSubresource subresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+  VkSubresourceLayout layout;
+  vk::vkGetImageSubresourceLayout(device, indirectionImage, &subresource, &layout);
+  indirectionRowPitch = (int) layout.rowPitch;
+  indirectionMapped = indirectionMemory.mapped + layout.offset;           // 内存块保持映射
+  vt->buildIndirection(indirectionMapped, indirectionRowPitch);         // 初始全部无效
+
+  // 两幅图像一次性转换为GENERAL布局, 之后不再转换
+  VkImageMemoryBarrier barriers[2] = {};
+  for (int i = 0; i < 2; ++i) {
+    barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[i].pNext = nullptr;
+    barriers[i].srcAccessMask = i == 0 ? 0 : VK_ACCESS_HOST_WRITE_BIT;
+    barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[i].oldLayout = i == 0 ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PREINITIALIZED;
+    barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].image = i == 0 ? cacheImage : indirectionImage;
+    barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barriers[i].subresourceRange.baseMipLevel = 0;
+    barriers[i].subresourceRange.levelCount = 1;
+    barriers[i].subresourceRange.baseArrayLayer = 0;
+    barriers[i].subresourceRange.layerCount = 1;
+  }
+  VkCommandBufferBeginInfo cmd_buf_info = {};
+  cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmd_buf_info.pNext = nullptr;
+  cmd_buf_info.flags = 0;
+  cmd_buf_info.pInheritanceInfo = nullptr;
+  vk::vkResetCommandBuffer(cmdBuffer, 0);
+  VkResult result = vk::vkBeginCommandBuffer(cmdBuffer, &cmd_buf_info);
+  assert(result == VK_SUCCESS);
+  vk::vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                           0, nullptr, 0, nullptr, 2, barriers);
+  result = vk::vkEndCommandBuffer(cmdBuffer);
+  assert(result == VK_SUCCESS);
+  VkFence fence = StagingRing::submit(device, queueGraphics, cmdBuffer);
+  StagingRing::wait(device, fence);
+
+  cacheView = createView(device, cacheImage);
+  indirectionView = createView(device, indirectionImage);
+  SamplerDesc cacheSampler;                                               // 瓦片带边框, 可直接双线性过滤
+  cacheSampler.minFilter = VK_FILTER_LINEAR;
+  SamplerDesc indirectionSampler;                                         // 着色器中用texelFetch读取
+  indirectionSampler.magFilter = VK_FILTER_NEAREST;
+  cacheImageInfo.imageView = cacheView;
+  cacheImageInfo.sampler = SamplerCache::get(device, cacheSampler);
+  cacheImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  indirectionImageInfo.imageView = indirectionView;
+  indirectionImageInfo.sampler = SamplerCache::get(device, indirectionSampler);
+  indirectionImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  // 反馈缓冲(主机可见, 保持映射)
+  int pageCount = vt->pagesX(0) * vt->pagesY(0);
+  VkBufferCreateInfo buf_info = {};
+  buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buf_info.pNext = nullptr;
+  buf_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  buf_info.size = pageCount * sizeof(uint32_t);
+  buf_info.queueFamilyIndexCount = 0;
+  buf_info.pQueueFamilyIndices = nullptr;
+  buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buf_info.flags = 0;
+  result = vk::vkCreateBuffer(device, &buf_info, nullptr, &feedbackBuffer);
+  assert(result == VK_SUCCESS);
+  DeviceMemoryAllocator::allocateBuffer(device, feedbackBuffer,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                        feedbackMemory);
+  feedbackMapped = (uint32_t *) feedbackMemory.mapped;
+  memset(feedbackMapped, 0xFF, buf_info.size);                            // 全部为VT_FEEDBACK_NONE
+  feedbackBufferInfo.buffer = feedbackBuffer;
+  feedbackBufferInfo.offset = 0;
+  feedbackBufferInfo.range = buf_info.size;
+
+  if (!feedbackSupported) {                                               // 固定请求能放入一半缓存的最细一级
+    int mip = 0;
+    while (mip < vt->levels - 1 && vt->pagesX(mip) * vt->pagesY(mip) > cacheCols * cacheRows / 2) {
+      mip++;
+    }
+    fallbackFeedback.assign(pageCount, (uint32_t) mip);
+    LOGE("VirtualTextureManager: fragmentStoresAndAtomics not supported, streaming mip %d only", mip);
+  }
+  LOGI("VirtualTextureManager: %s %dx%d, %d levels, %dx%d pages, cache %dx%d tiles",
+       texName.c_str(), sourceWidth, sourceHeight, vt->levels, vt->pagesX(0), vt->pagesY(0), cacheCols, cacheRows);
+}
+
+void VirtualTextureManager::setFramesInFlight(int frames) {
+  assert(frames >= 1);
+  framesInFlight = frames;
+  if (vt != nullptr) {
+    vt->protectFrames = frames;
+  }
+}
+
+void VirtualTextureManager::update(VkDevice &device) {
+  size_t done = 0;                                                        // 上传按票号顺序完成
+  while (done < uploadTickets.size() && AsyncUploader::isComplete(uploadTickets[done].first)) {
+    vt->completeUpload(uploadTickets[done].second);
+    done++;
+  }
+  uploadTickets.erase(uploadTickets.begin(), uploadTickets.begin() + done);
+
+  int pageCount = vt->pagesX(0) * vt->pagesY(0);
+  if (feedbackSupported) {                                                // 上一帧的反馈, 读后清空供本帧写入
+    vt->processFeedback(feedbackMapped, pageCount);
+    memset(feedbackMapped, 0xFF, pageCount * sizeof(uint32_t));
+  } else {
+    vt->processFeedback(fallbackFeedback.data(), pageCount);
+  }
+
+  std::vector<VtTileUpload> uploads;
+  vt->update(uploads);
+  for (size_t i = 0; i < uploads.size(); ++i) {
+    std::vector<VkBufferImageCopy> regions(1);
+    regions[0] = {};
+    regions[0].bufferOffset = 0;
+    regions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    regions[0].imageSubresource.mipLevel = 0;
+    regions[0].imageSubresource.baseArrayLayer = 0;
+    regions[0].imageSubresource.layerCount = 1;
+    regions[0].imageOffset.x = uploads[i].slotX * VT_TILE_SIZE;          // 写入瓦片所在的槽位
+    regions[0].imageOffset.y = uploads[i].slotY * VT_TILE_SIZE;
+    regions[0].imageOffset.z = 0;
+    regions[0].imageExtent.width = VT_TILE_SIZE;
+    regions[0].imageExtent.height = VT_TILE_SIZE;
+    regions[0].imageExtent.depth = 1;
+    unsigned long long ticket = AsyncUploader::uploadImageRegions( // 接管瓦片数据
+        cacheImage, VK_IMAGE_LAYOUT_GENERAL, regions, uploads[i].pixels, VT_TILE_BYTES);
+    uploadTickets.push_back(std::make_pair(ticket, uploads[i].slot));
+  }
+
+  if (vt->indirectionDirty()) {                                           // 上一帧已完成, 可直接改写
+    vt->buildIndirection(indirectionMapped, indirectionRowPitch);
+  }
+}
+
+void VirtualTextureManager::recordFeedbackBarrier(VkCommandBuffer &cmdBuffer) {
+  if (!feedbackSupported) {
+    return;
+  }
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.pNext = nullptr;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = feedbackBuffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  vk::vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                           0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void VirtualTextureManager::destroy(VkDevice &device) {
+  if (vt == nullptr) {
+    return;
+  }
+  vt->logStats();
+  delete vt;                                                              // 先停止加载线程再释放mip链
+  vt = nullptr;
+  delete chain;
+  chain = nullptr;
+  uploadTickets.clear();
+  vk::vkDestroyImageView(device, cacheView, nullptr);
+  vk::vkDestroyImage(device, cacheImage, nullptr);
+  DeviceMemoryAllocator::free(device, cacheMemory);
+  vk::vkDestroyImageView(device, indirectionView, nullptr);
+  vk::vkDestroyImage(device, indirectionImage, nullptr);
+  DeviceMemoryAllocator::free(device, indirectionMemory);
+  vk::vkDestroyBuffer(device, feedbackBuffer, nullptr);
+  DeviceMemoryAllocator::free(device, feedbackMemory);
+}
@@ -0,0 +1,80 @@
+#ifndef DEEPERVULKAN_VIRTUALTEXTUREMANAGER_H_
+#define DEEPERVULKAN_VIRTUALTEXTUREMANAGER_H_
+
+#include <vector>
+#include <string>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+#include "VirtualTexture.h"
+#include "TexDataObject.h"
+#include "DeviceMemoryAllocator.h"
+
+#define VT_CACHE_COLS 16  // 物理缓存纹理每行的槽位数(16*128像素)
+#define VT_CACHE_ROWS 16  // 物理缓存纹理的槽位行数
+
+/**
+ * 虚拟纹理的Vulkan资源: 物理缓存纹理、间接纹理与反馈缓冲
+ * 物理缓存纹理常驻GENERAL布局, 瓦片通过AsyncUploader在传输队列上写入各自的槽位;
+ * 间接纹理为主机可见的线性图像, 每帧在上一帧GPU任务完成后由CPU直接改写;
+ * 片元着色器把第0级每页需要的mip级以atomicMin写入反馈缓冲, 下一帧开始时读回交给VirtualTexture
+ * 设备不支持片元着色器写入时退回CPU估计: 常驻能放入一半缓存的最细一级
+ */
+class VirtualTextureManager {
+ public:
+  static VirtualTexture *vt;                            // CPU端页表与瓦片缓存
+  static VkImage cacheImage;                            // 物理缓存纹理
+  static VkImage indirectionImage;                      // 间接纹理(第0级每页一个像素)
+  static VkBuffer feedbackBuffer;                       // 反馈缓冲(第0级每页一个uint)
+  static VkDescriptorImageInfo cacheImageInfo;          // 物理缓存纹理的图像描述信息
+  static VkDescriptorImageInfo indirectionImageInfo;    // 间接纹理的图像描述信息
+  static VkDescriptorBufferInfo feedbackBufferInfo;     // 反馈缓冲的描述信息
+  static bool feedbackSupported;                        // 是否使用GPU反馈(片元着色器写入存储缓冲)
+
+  /**
+   * 加载RGBA8纹理(bntex)作为虚拟纹理的源图像, 创建物理缓存纹理、间接纹理与反馈缓冲(须在AsyncUploader初始化之后)
+   * 源图像的mip链在CPU内存中生成, 显存中只驻留物理缓存
+   */
+  static void create(VkDevice &device, VkPhysicalDevice &gpu, VkPhysicalDeviceMemoryProperties &memoryroperties,
+                     VkCommandBuffer &cmdBuffer, VkQueue &queueGraphics, std::string texName,
+                     int cacheCols = VT_CACHE_COLS, int cacheRows = VT_CACHE_ROWS);
+
+  /**
+   * 每帧在AsyncUploader::pump之前调用(上一帧的GPU任务须已完成):
+   * 读回并清空反馈, 提交已加载的瓦片, 将上传完成的瓦片写入页表并刷新间接纹理
+   */
+  static void update(VkDevice &device);
+
+  /**
+   * 在渲染通道结束后记录反馈缓冲的屏障, 使片元着色器的写入对下一帧的CPU读取可见
+   */
+  static void recordFeedbackBarrier(VkCommandBuffer &cmdBuffer);
+
+  /**
+   * 设置同时在途的帧数: 这么多帧内被引用的瓦片槽位不逐出(反馈相应地来自更早的帧)
+   */
+  static void setFramesInFlight(int frames);
+
+  /**
+   * 销毁所有资源(须在AsyncUploader::destroy之后调用)
+   */
+  static void destroy(VkDevice &device);
+
+ private:
+  static TexDataObject *chain;                          // 源图像的mip链(紧密排列)
+  static std::vector<int> levelOffsets;                 // mip链各级的字节偏移量
+  static int sourceWidth;                               // 源图像宽度
+  static int sourceHeight;                              // 源图像高度
+  static MemoryAllocation cacheMemory;                  // 物理缓存纹理的设备内存
+  static VkImageView cacheView;                         // 物理缓存纹理的图像视图
+  static MemoryAllocation indirectionMemory;            // 间接纹理的设备内存(保持映射)
+  static VkImageView indirectionView;                   // 间接纹理的图像视图
+  static unsigned char *indirectionMapped;              // 间接纹理映射后的CPU地址
+  static int indirectionRowPitch;                       // 间接纹理每行的字节数
+  static MemoryAllocation feedbackMemory;               // 反馈缓冲的设备内存(保持映射)
+  static uint32_t *feedbackMapped;                      // 反馈缓冲映射后的CPU地址
+  static std::vector<uint32_t> fallbackFeedback;        // 不支持GPU反馈时每帧使用的固定请求
+  static std::vector<std::pair<unsigned long long, int> > uploadTickets; // 在途上传的票号及其槽位
+  static int framesInFlight;                            // 同时在途的帧数
+};
+
+#endif //DEEPERVULKAN_VIRTUALTEXTUREMANAGER_H_
@@ -5,6 +5,10 @@ namespace vk {
     int loadVulkan(void) {
         //加载Android下支持Vulkan的动态库文件libvulkan.so
         void *libvulkan = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
+        if (!libvulkan) {
+            //桌面Linux下没有开发包时只有带版本号的加载器(主机上的离屏绘制程序使用)
+            libvulkan = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+        }
         if (!libvulkan) {
             return 0;
         }
@@ -0,0 +1,198 @@
+#include <cstring>
+#include <vector>
+#include "AsyncUploader.h"
+#include "StagingRing.h"
+#include "DeviceMemoryAllocator.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+static VkDevice device = (VkDevice) 0x1;
+static VkQueue transferQueue = reinterpret_cast<VkQueue>(0x2);
+static VkCommandBuffer graphicsCmd = reinterpret_cast<VkCommandBuffer>(0x3);
+static VkBuffer vertexBuffer = (VkBuffer) 0x10;
+static VkImage texture = (VkImage) 0x20;
+static VkImage pageCache = (VkImage) 0x21;
+
+static VkQueueFamilyProperties family(VkQueueFlags flags, uint32_t queueCount) {
+  VkQueueFamilyProperties properties = {};
+  properties.queueFlags = flags;
+  properties.queueCount = queueCount;
+  return properties;
+}
+
+/**
+ * 选择队列家族: 只支持传输的家族优先于计算家族, 都没有(或没有队列)时使用图形家族
+ */
+static void testSelectTransferFamily() {
+  std::vector<VkQueueFamilyProperties> families;
+  families.push_back(family(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 1));
+  families.push_back(family(VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 2));
+  families.push_back(family(VK_QUEUE_TRANSFER_BIT, 1));
+  CHECK(AsyncUploader::selectTransferFamily(families, 0) == 2);
+  families[2].queueCount = 0;
+  CHECK(AsyncUploader::selectTransferFamily(families, 0) == 1);
+  families.pop_back();
+  families.pop_back();
+  CHECK(AsyncUploader::selectTransferFamily(families, 0) == 0);
+  families.push_back(family(VK_QUEUE_SPARSE_BINDING_BIT, 1));             // 不支持传输的家族不被选择
+  CHECK(AsyncUploader::selectTransferFamily(families, 0) == 0);
+}
+
+static void initUploader(uint32_t transferFamily, uint32_t graphicsFamily) {
+  FakeVulkan::reset();
+  FakeVulkan::autoSignalFences = false;
+  DeviceMemoryAllocator::init(FakeVulkan::memoryProperties, 1024, 64);
+  StagingRing::create(device, FakeVulkan::memoryProperties, 64 * 1024);
+  AsyncUploader::init(device, transferQueue, transferFamily, graphicsFamily);
+  AsyncUploader::setFramesInFlight(1);
+}
+
+static void destroyUploader() {
+  AsyncUploader::destroy(device);
+  StagingRing::destroy(device);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(FakeVulkan::commandPools.empty() && FakeVulkan::semaphores.empty() && FakeVulkan::memories.empty());
+}
+
+/**
+ * 上传一个缓冲、一个纹理(UNDEFINED布局)与一个GENERAL布局纹理的区域, 返回最后一个票号
+ */
+static unsigned long long uploadAll() {
+  unsigned char vertices[256];
+  memset(vertices, 7, sizeof(vertices));
+  AsyncUploader::uploadBuffer(vertexBuffer, 64, vertices, sizeof(vertices),
+                              VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  std::vector<VkBufferImageCopy> regions(2);
+  for (uint32_t level = 0; level < 2; ++level) {
+    memset(&regions[level], 0, sizeof(VkBufferImageCopy));
+    regions[level].bufferOffset = level * 1024;
+    regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    regions[level].imageSubresource.mipLevel = level;
+    regions[level].imageSubresource.layerCount = 1;
+    regions[level].imageExtent.width = 16 >> level;
+    regions[level].imageExtent.height = 16 >> level;
+    regions[level].imageExtent.depth = 1;
+  }
+  AsyncUploader::uploadImage(texture, 2, regions, new unsigned char[1280], 1280);
+  regions.resize(1);
+  return AsyncUploader::uploadImageRegions(pageCache, VK_IMAGE_LAYOUT_GENERAL, regions,
+                                           new unsigned char[1024], 1024);
+}
+
+/**
+ * 找出某个缓冲或图像的屏障调用(cmd为录制到的命令缓冲)
+ */
+static std::vector<FakeCommand> barriersFor(VkCommandBuffer cmd, VkBuffer buffer, VkImage image) {
+  std::vector<FakeCommand> result;
+  for (size_t i = 0; i < FakeVulkan::commands.size(); ++i) {
+    const FakeCommand &c = FakeVulkan::commands[i];
+    if (c.type != FAKE_CMD_PIPELINE_BARRIER || c.cmd != cmd) {
+      continue;
+    }
+    if ((buffer != VK_NULL_HANDLE && c.bufferBarriers.size() == 1 && c.bufferBarriers[0].buffer == buffer) ||
+        (image != VK_NULL_HANDLE && c.imageBarriers.size() == 1 && c.imageBarriers[0].image == image)) {
+      result.push_back(c);
+    }
+  }
+  return result;
+}
+
+/**
+ * 同一队列家族: 释放屏障的家族为IGNORED并完成布局转换, 图形队列上不记录获取屏障, 只等待信号量;
+ * 栅栏触发之前不获取, 票号不完成
+ */
+static void testSameFamily() {
+  initUploader(0, 0);
+  unsigned long long last = uploadAll();
+  AsyncUploader::pump(device);
+  CHECK(FakeVulkan::submits.size() == 1 && FakeVulkan::submits[0].queue == transferQueue);
+  CHECK(FakeVulkan::submits[0].signalSemaphores.size() == 1);
+  VkCommandBuffer transferCmd = FakeVulkan::submits[0].commandBuffers[0];
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_COPY_BUFFER, transferCmd) == 1);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_COPY_BUFFER_TO_IMAGE, transferCmd) == 2);
+
+  std::vector<FakeCommand> release = barriersFor(transferCmd, vertexBuffer, VK_NULL_HANDLE);
+  CHECK(release.size() == 1);
+  const VkBufferMemoryBarrier &b = release[0].bufferBarriers[0];
+  CHECK(b.srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED && b.dstQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+  CHECK(b.offset == 64 && b.size == 256 && b.srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT);
+  release = barriersFor(transferCmd, VK_NULL_HANDLE, texture);
+  CHECK(release.size() == 2);                                             // 转为传输目标, 拷贝后释放
+  const VkImageMemoryBarrier &i = release[1].imageBarriers[0];
+  CHECK(i.srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED && i.dstQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+  CHECK(i.oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && i.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  CHECK(i.subresourceRange.levelCount == 2);
+  CHECK(barriersFor(transferCmd, VK_NULL_HANDLE, pageCache).empty());    // GENERAL布局的区域更新不加屏障
+
+  std::vector<VkSemaphore> semaphores;
+  std::vector<VkPipelineStageFlags> stages;
+  AsyncUploader::recordAcquire(device, graphicsCmd, semaphores, stages);
+  CHECK(semaphores.empty() && !AsyncUploader::isComplete(1));             // 传输尚未完成
+  FakeVulkan::signalFence(FakeVulkan::submits[0].fence);
+  AsyncUploader::recordAcquire(device, graphicsCmd, semaphores, stages);
+  CHECK(semaphores.size() == 1 && semaphores[0] == FakeVulkan::submits[0].signalSemaphores[0]);
+  CHECK(stages[0] == (VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_PIPELINE_BARRIER, graphicsCmd) == 0);
+  CHECK(AsyncUploader::isComplete(last) && !AsyncUploader::isComplete(last + 1));
+  destroyUploader();
+}
+
+/**
+ * 独立传输队列家族: 释放屏障从传输家族转给图形家族, 图形队列上记录家族、布局一致的获取屏障,
+ * 其目标阶段与访问类型为首次使用; 保持GENERAL布局的区域更新不转移所有权
+ */
+static void testDedicatedFamily() {
+  initUploader(2, 0);
+  unsigned long long last = uploadAll();
+  AsyncUploader::pump(device);
+  CHECK(FakeVulkan::commandPools.begin()->second == 2);                   // 命令池属于传输家族
+  VkCommandBuffer transferCmd = FakeVulkan::submits[0].commandBuffers[0];
+  std::vector<FakeCommand> release = barriersFor(transferCmd, vertexBuffer, VK_NULL_HANDLE);
+  CHECK(release.size() == 1);
+  CHECK(release[0].bufferBarriers[0].srcQueueFamilyIndex == 2);
+  CHECK(release[0].bufferBarriers[0].dstQueueFamilyIndex == 0);
+  CHECK(release[0].bufferBarriers[0].dstAccessMask == 0);
+  CHECK(release[0].dstStages == VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+  release = barriersFor(transferCmd, VK_NULL_HANDLE, texture);
+  CHECK(release.size() == 2);
+  const VkImageMemoryBarrier released = release[1].imageBarriers[0];
+  CHECK(released.srcQueueFamilyIndex == 2 && released.dstQueueFamilyIndex == 0);
+
+  std::vector<VkSemaphore> semaphores;
+  std::vector<VkPipelineStageFlags> stages;
+  FakeVulkan::signalFence(FakeVulkan::submits[0].fence);
+  AsyncUploader::recordAcquire(device, graphicsCmd, semaphores, stages);
+  CHECK(semaphores.size() == 1 && AsyncUploader::isComplete(last));
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_PIPELINE_BARRIER, graphicsCmd) == 2); // 缓冲与纹理各一个获取屏障
+
+  std::vector<FakeCommand> acquire = barriersFor(graphicsCmd, vertexBuffer, VK_NULL_HANDLE);
+  CHECK(acquire.size() == 1);
+  const VkBufferMemoryBarrier &b = acquire[0].bufferBarriers[0];
+  CHECK(b.srcQueueFamilyIndex == 2 && b.dstQueueFamilyIndex == 0 && b.offset == 64 && b.size == 256);
+  CHECK(b.srcAccessMask == 0 && b.dstAccessMask == VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  CHECK(acquire[0].srcStages == VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);     // 与信号量的等待阶段衔接
+  CHECK(acquire[0].dstStages == VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+  acquire = barriersFor(graphicsCmd, VK_NULL_HANDLE, texture);
+  CHECK(acquire.size() == 1);
+  const VkImageMemoryBarrier &i = acquire[0].imageBarriers[0];
+  CHECK(i.srcQueueFamilyIndex == released.srcQueueFamilyIndex && i.dstQueueFamilyIndex == released.dstQueueFamilyIndex);
+  CHECK(i.oldLayout == released.oldLayout && i.newLayout == released.newLayout);
+  CHECK(i.srcAccessMask == 0 && i.dstAccessMask == VK_ACCESS_SHADER_READ_BIT);
+  CHECK(acquire[0].dstStages == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  CHECK(barriersFor(graphicsCmd, VK_NULL_HANDLE, pageCache).empty());
+
+  semaphores.clear();
+  stages.clear();
+  AsyncUploader::recordAcquire(device, graphicsCmd, semaphores, stages);
+  CHECK(semaphores.empty());                                              // 每个批次只获取一次
+  destroyUploader();
+}
+
+int main() {
+  FakeVulkan::install();
+  testSelectTransferFamily();
+  testSameFamily();
+  testDedicatedFamily();
+  printf("AsyncUploaderTest passed\n");
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "CommandBufferCache.h"
+#include "GeometryPool.h"
+#include "DeviceMemoryDefragmenter.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+static VkDevice device = (VkDevice) 0x1;
+static VkRenderPass renderPass = (VkRenderPass) 0x2;
+static VkRenderPass otherRenderPass = (VkRenderPass) 0x3;
+static VkCommandBuffer primary = reinterpret_cast<VkCommandBuffer>(0x4);
+
+/**
+ * 可缓存的一组命令: 记录被录制的次数, complete为false时模拟几何数据尚在上传
+ */
+struct CountingTask {
+  int calls;                                                              // 录制次数
+  bool complete;                                                          // 录制是否完整
+  uint32_t vertexCount;                                                   // 绘制的顶点数(区分各组命令)
+};
+
+static CachedRecordTask taskFor(CountingTask &counting) {
+  return [&counting](VkCommandBuffer &cmd) {
+    counting.calls++;
+    vk::vkCmdDraw(cmd, counting.vertexCount, 1, 0, 0);
+    return counting.complete;
+  };
+}
+
+/**
+ * 执行一组命令并返回主命令缓冲中执行的二级命令缓冲
+ */
+static VkCommandBuffer execute(int entry, int slot, unsigned long long key = 0, VkRenderPass pass = renderPass) {
+  size_t before = FakeVulkan::commands.size();
+  CommandBufferCache::execute(primary, entry, slot, pass, key);
+  CHECK(FakeVulkan::commands.size() > before);
+  FakeCommand command = FakeVulkan::commands.back();
+  CHECK(command.type == FAKE_CMD_EXECUTE_COMMANDS && command.cmd == primary && command.secondaries.size() == 1);
+  const FakeCommandBuffer &fake = FakeVulkan::commandBuffers[command.secondaries[0]];
+  CHECK(fake.inheritedRenderPass == pass);
+  CHECK((fake.flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) == 0); // 可重复提交
+  return command.secondaries[0];
+}
+
+static void createCache() {
+  FakeVulkan::reset();
+  CommandBufferCache::enabled = true;
+  CommandBufferCache::create(device, 0);
+  CHECK(FakeVulkan::commandPools.size() == 1);
+}
+
+static void destroyCache() {
+  CommandBufferCache::destroy(device);
+  CHECK(FakeVulkan::commandPools.empty() && FakeVulkan::commandBuffers.empty());
+}
+
+/**
+ * 重用: 帧区域与键相同的录制结果在之后各帧(beginFrame之后)直接执行, 不同的帧区域或键各录制一次;
+ * 渲染通道变化或关闭缓存时重新录制到同一个二级命令缓冲
+ */
+static void testReuseAcrossFrames() {
+  createCache();
+  CountingTask counting = {0, true, 3};
+  int entry = CommandBufferCache::add(taskFor(counting));
+  long long hits = CommandBufferCache::hits;
+  long long records = CommandBufferCache::records;
+
+  VkCommandBuffer slot0 = execute(entry, 0, 7);
+  CHECK(counting.calls == 1 && FakeVulkan::countCommands(FAKE_CMD_DRAW, slot0) == 1);
+  VkCommandBuffer slot1 = execute(entry, 1, 8);
+  CHECK(counting.calls == 2 && slot1 != slot0);                           // 在途帧的录制结果不被改写
+  for (int frame = 0; frame < 4; ++frame) {
+    CommandBufferCache::beginFrame();
+    CHECK(execute(entry, frame % 2, 7 + frame % 2) == (frame % 2 == 0 ? slot0 : slot1));
+  }
+  CHECK(counting.calls == 2 && FakeVulkan::commandBuffers[slot0].beginCount == 1);
+  CHECK(CommandBufferCache::hits == hits + 4 && CommandBufferCache::records == records + 2);
+
+  VkCommandBuffer keyed = execute(entry, 0, 9);                           // 动态偏移量不同: 另一份录制结果
+  CHECK(counting.calls == 3 && keyed != slot0 && keyed != slot1);
+  CHECK(execute(entry, 0, 7) == slot0 && counting.calls == 3);
+
+  CHECK(execute(entry, 0, 7, otherRenderPass) == slot0 && counting.calls == 4);
+  CHECK(FakeVulkan::commandBuffers[slot0].beginCount == 2);               // 重新录制时隐式重置
+  CHECK(execute(entry, 0, 7, otherRenderPass) == slot0 && counting.calls == 4);
+
+  CommandBufferCache::enabled = false;
+  execute(entry, 1, 8);
+  execute(entry, 1, 8);
+  CHECK(counting.calls == 6);
+  CommandBufferCache::enabled = true;
+  CHECK(FakeVulkan::commandBuffers.size() == 3);
+  destroyCache();
+}
+
+/**
+ * 失效: invalidate只使一组命令重新录制; 几何缓冲池整理或内存整理移动资源后, beginFrame使所有录制结果失效;
+ * 不完整的录制结果在下次执行前重新录制
+ */
+static void testInvalidation() {
+  createCache();
+  CountingTask a = {0, true, 3};
+  CountingTask b = {0, true, 6};
+  int entryA = CommandBufferCache::add(taskFor(a));
+  int entryB = CommandBufferCache::add(taskFor(b));
+  CHECK(entryA != entryB);
+  execute(entryA, 0);
+  execute(entryB, 0);
+  CHECK(a.calls == 1 && b.calls == 1);
+
+  CommandBufferCache::invalidate(entryA);
+  execute(entryA, 0);
+  execute(entryB, 0);
+  CHECK(a.calls == 2 && b.calls == 1);
+
+  int invalidations = CommandBufferCache::invalidations;
+  CommandBufferCache::beginFrame();                                       // 没有资源移动: 保持有效
+  execute(entryA, 0);
+  execute(entryB, 0);
+  CHECK(a.calls == 2 && b.calls == 1 && CommandBufferCache::invalidations == invalidations);
+
+  GeometryPool::compactions++;                                            // 共享顶点缓冲被替换
+  execute(entryA, 0);
+  CHECK(a.calls == 2);                                                    // beginFrame之前仍重用
+  CommandBufferCache::beginFrame();
+  execute(entryA, 0);
+  execute(entryB, 0);
+  CHECK(a.calls == 3 && b.calls == 2 && CommandBufferCache::invalidations == invalidations + 1);
+  CommandBufferCache::beginFrame();
+  execute(entryA, 0);
+  CHECK(a.calls == 3);                                                    // 同一次整理只失效一次
+
+  DeviceMemoryDefragmenter::movedResources += 2;                          // 单独的缓冲或纹理被移动
+  CommandBufferCache::beginFrame();
+  execute(entryA, 0);
+  execute(entryB, 0);
+  CHECK(a.calls == 4 && b.calls == 3 && CommandBufferCache::invalidations == invalidations + 2);
+
+  CommandBufferCache::invalidateAll();
+  execute(entryB, 0);
+  CHECK(b.calls == 4);
+
+  b.complete = false;                                                     // 跳过了绘制: 下次重新录制
+  CommandBufferCache::invalidate(entryB);
+  execute(entryB, 0);
+  execute(entryB, 0);
+  CHECK(b.calls == 6);
+  b.complete = true;
+  execute(entryB, 0);
+  execute(entryB, 0);
+  CHECK(b.calls == 7);
+
+  CommandBufferCache::remove(entryA);                                     // 释放录制结果, 编号被重用
+  CHECK(FakeVulkan::commandBuffers.size() == 1);
+  CountingTask c = {0, true, 9};
+  CHECK(CommandBufferCache::add(taskFor(c)) == entryA);
+  execute(entryA, 0);
+  CHECK(c.calls == 1 && a.calls == 4);
+  destroyCache();
+}
+
+int main() {
+  FakeVulkan::install();
+  testReuseAcrossFrames();
+  testInvalidation();
+  printf("CommandBufferCacheTest passed\n");
+  return 0;
+}
@@ -0,0 +1,393 @@
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+#include "DeviceMemoryAllocator.h"
+#include "TlsfAllocator.h"
+#include "TestUtil.h"
+
+/**
+ * 伪造的设备内存: 主机可见类型分配真实的主机内存, 以便检查持久映射的地址
+ */
+struct FakeMemory {
+  VkDeviceSize size;
+  uint32_t typeIndex;
+  unsigned char *host;
+  bool mapped;
+};
+
+static VkPhysicalDeviceMemoryProperties fakeProperties;      // 伪造的内存属性表
+static std::map<VkDeviceMemory, FakeMemory> liveMemory;      // 未释放的设备内存
+static uintptr_t nextHandle = 0x1000;
+static int allocateCalls = 0;
+static int freeCalls = 0;
+static VkMemoryRequirements nextRequirements;                // 下一次查询返回的内存需求
+
+static VkResult fakeAllocateMemory(VkDevice, const VkMemoryAllocateInfo *info, const VkAllocationCallbacks *,
+                                   VkDeviceMemory *memory) {
+  const VkMemoryType &type = fakeProperties.memoryTypes[info->memoryTypeIndex];
+  VkDeviceSize heapUsed = 0;
+  for (std::map<VkDeviceMemory, FakeMemory>::iterator it = liveMemory.begin(); it != liveMemory.end(); ++it) {
+    if (fakeProperties.memoryTypes[it->second.typeIndex].heapIndex == type.heapIndex) {
+      heapUsed += it->second.size;
+    }
+  }
+  if (heapUsed + info->allocationSize > fakeProperties.memoryHeaps[type.heapIndex].size) {
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+  FakeMemory fake = {info->allocationSize, info->memoryTypeIndex, nullptr, false};
+  if ((type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+    fake.host = new unsigned char[info->allocationSize];
+  }
+  *memory = (VkDeviceMemory) nextHandle++;
+  liveMemory[*memory] = fake;
+  allocateCalls++;
+  return VK_SUCCESS;
+}
+
+static void fakeFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *) {
+  std::map<VkDeviceMemory, FakeMemory>::iterator it = liveMemory.find(memory);
+  CHECK(it != liveMemory.end() && !it->second.mapped);
+  delete[] it->second.host;
+  liveMemory.erase(it);
+  freeCalls++;
+}
+
+static VkResult fakeMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags,
+                              void **data) {
+  FakeMemory &fake = liveMemory[memory];
+  CHECK(fake.host != nullptr && !fake.mapped);
+  fake.mapped = true;
+  *data = fake.host + offset;
+  return VK_SUCCESS;
+}
+
+static void fakeUnmapMemory(VkDevice, VkDeviceMemory memory) {
+  FakeMemory &fake = liveMemory[memory];
+  CHECK(fake.mapped);
+  fake.mapped = false;
+}
+
+static VkResult fakeFlushMappedMemoryRanges(VkDevice, uint32_t count, const VkMappedMemoryRange *ranges) {
+  for (uint32_t i = 0; i < count; ++i) {                                  // 范围须按nonCoherentAtomSize对齐
+    const FakeMemory &fake = liveMemory[ranges[i].memory];
+    CHECK(ranges[i].offset % 64 == 0);
+    CHECK(ranges[i].offset + ranges[i].size <= fake.size);
+    CHECK((ranges[i].offset + ranges[i].size) % 64 == 0 || ranges[i].offset + ranges[i].size == fake.size);
+  }
+  return VK_SUCCESS;
+}
+
+static void fakeGetBufferMemoryRequirements(VkDevice, VkBuffer, VkMemoryRequirements *requirements) {
+  *requirements = nextRequirements;
+}
+
+static void fakeGetImageMemoryRequirements(VkDevice, VkImage, VkMemoryRequirements *requirements) {
+  *requirements = nextRequirements;
+}
+
+static VkResult fakeBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize) {
+  return VK_SUCCESS;
+}
+
+static VkResult fakeBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize) {
+  return VK_SUCCESS;
+}
+
+/**
+ * 类型0设备本地, 类型1主机可见一致, 类型2主机可见非一致(缓存); 堆1较小
+ */
+static void initFakeProperties() {
+  memset(&fakeProperties, 0, sizeof(fakeProperties));
+  fakeProperties.memoryHeapCount = 2;
+  fakeProperties.memoryHeaps[0].size = 1024ull << 20;
+  fakeProperties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+  fakeProperties.memoryHeaps[1].size = 96ull << 20;
+  fakeProperties.memoryTypeCount = 3;
+  fakeProperties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  fakeProperties.memoryTypes[0].heapIndex = 0;
+  fakeProperties.memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  fakeProperties.memoryTypes[1].heapIndex = 1;
+  fakeProperties.memoryTypes[2].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  fakeProperties.memoryTypes[2].heapIndex = 1;
+}
+
+static void setRequirements(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeBits) {
+  nextRequirements.size = size;
+  nextRequirements.alignment = alignment;
+  nextRequirements.memoryTypeBits = memoryTypeBits;
+}
+
+/**
+ * TLSF: 分割出的块按地址排列, 释放时与相邻的空闲块合并
+ */
+static void testTlsfSplitMerge() {
+  TlsfAllocator tlsf(1024);
+  uint64_t offsets[3];
+  uint32_t handles[3];
+  for (int i = 0; i < 3; ++i) {
+    CHECK(tlsf.allocate(256, 1, offsets[i], handles[i]));
+    CHECK(tlsf.sizeOf(handles[i]) == 256 && tlsf.offsetOf(handles[i]) == offsets[i]);
+  }
+  CHECK(offsets[0] == 0 && offsets[1] == 256 && offsets[2] == 512);
+  CHECK(tlsf.freeBlockCount() == 1 && tlsf.largestFree() == 256 && tlsf.usedBytes == 768);
+  tlsf.free(handles[1]);                                                  // 两侧都在使用, 不合并
+  CHECK(tlsf.validate() && tlsf.freeBlockCount() == 2 && tlsf.largestFree() == 256);
+  tlsf.free(handles[0]);                                                  // 与右侧的空闲块合并
+  CHECK(tlsf.validate() && tlsf.freeBlockCount() == 2 && tlsf.largestFree() == 512);
+  uint64_t offset;
+  uint32_t handle;
+  CHECK(tlsf.allocate(512, 1, offset, handle) && offset == 0);            // 合并后的块可整块再分配
+  tlsf.free(handle);
+  tlsf.free(handles[2]);                                                  // 与两侧合并为整块
+  CHECK(tlsf.validate() && tlsf.freeBlockCount() == 1 && tlsf.largestFree() == 1024 && tlsf.usedBytes == 0);
+  CHECK(!tlsf.allocate(1025, 1, offset, handle));
+}
+
+/**
+ * TLSF: 对齐的分配与随机的分配、释放序列(不重叠、不越界, 全部释放后恢复为整块)
+ */
+static void testTlsfAlignment() {
+  TlsfAllocator tlsf(16384);
+  uint64_t offset;
+  uint32_t first;
+  uint32_t aligned;
+  CHECK(tlsf.allocate(100, 1, offset, first) && offset == 0);
+  CHECK(tlsf.allocate(10, 4096, offset, aligned) && offset == 4096);      // 对齐前的空隙留作空闲块
+  CHECK(tlsf.validate() && tlsf.freeBlockCount() == 2);
+  tlsf.free(first);
+  tlsf.free(aligned);
+  CHECK(tlsf.validate() && tlsf.freeBlockCount() == 1);
+
+  std::mt19937 rng(7);
+  for (int round = 0; round < 10; ++round) {
+    uint64_t total = 1 + rng() % (1 << 24);
+    TlsfAllocator random(total);
+    struct Range {
+      uint64_t offset;
+      uint64_t size;
+      uint32_t handle;
+    };
+    std::vector<Range> live;
+    for (int step = 0; step < 2000; ++step) {
+      if (live.empty() || rng() % 3 != 0) {
+        uint64_t size = 1 + rng() % (1 + (rng() % 4 != 0 ? 4096 : total / 4));
+        uint64_t alignment = 1ull << (rng() % 13);
+        uint32_t handle;
+        if (random.allocate(size, alignment, offset, handle)) {
+          CHECK(offset % alignment == 0 && offset + size <= total && random.sizeOf(handle) >= size);
+          for (size_t i = 0; i < live.size(); ++i) {
+            CHECK(offset + random.sizeOf(handle) <= live[i].offset || live[i].offset + live[i].size <= offset);
+          }
+          Range range = {offset, random.sizeOf(handle), handle};
+          live.push_back(range);
+        }
+      } else {
+        size_t i = rng() % live.size();
+        random.free(live[i].handle);
+        live[i] = live.back();
+        live.pop_back();
+      }
+      if (step % 97 == 0) {
+        CHECK(random.validate());
+      }
+    }
+    for (size_t i = 0; i < live.size(); ++i) {
+      random.free(live[i].handle);
+    }
+    CHECK(random.validate() && random.usedBytes == 0 && random.freeBlockCount() == 1);
+    CHECK(random.largestFree() == total);
+  }
+}
+
+/**
+ * 内存类型按属性掩码与偏好顺序选择, 主机可见的分配持久映射
+ */
+static void testMemoryTypeSelection() {
+  DeviceMemoryAllocator::init(fakeProperties, 1, 64);
+  VkDevice device = (VkDevice) 1;
+  MemoryAllocation local;
+  MemoryAllocation coherent;
+  MemoryAllocation cached;
+  setRequirements(1000, 16, 0x7);
+  CHECK(DeviceMemoryAllocator::allocate(device, nextRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, local));
+  CHECK(local.memoryTypeIndex == 0 && local.mapped == nullptr);
+  CHECK(DeviceMemoryAllocator::allocate(device, nextRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, false, coherent));
+  CHECK(coherent.memoryTypeIndex == 1);                                   // 满足掩码的第一个类型
+  CHECK(coherent.mapped == liveMemory[coherent.memory].host + coherent.offset);
+  setRequirements(1000, 16, 0x4);                                         // 资源只允许类型2
+  CHECK(DeviceMemoryAllocator::allocate(device, nextRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, false, cached));
+  CHECK(cached.memoryTypeIndex == 2 && cached.mapped != nullptr);
+  MemoryAllocation none;
+  CHECK(!DeviceMemoryAllocator::allocate(device, nextRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, none));
+
+  // 偏好顺序: 不存在的类型跳过, 使用第一个可用的
+  const VkFlags preferences[3] = {
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT};
+  MemoryAllocation preferred;
+  setRequirements(1000, 16, 0x7);
+  CHECK(DeviceMemoryAllocator::allocate(device, nextRequirements, preferences, 3, false, preferred));
+  CHECK(preferred.memoryTypeIndex == 2);
+  DeviceMemoryAllocator::free(device, preferred);
+  CHECK(DeviceMemoryAllocator::allocate(device, nextRequirements, preferences + 2, 1, false, preferred));
+  CHECK(preferred.memoryTypeIndex == 2);
+
+  DeviceMemoryAllocator::free(device, local);
+  DeviceMemoryAllocator::free(device, coherent);
+  DeviceMemoryAllocator::free(device, cached);
+  DeviceMemoryAllocator::free(device, preferred);
+  CHECK(local.block == -1 && DeviceMemoryAllocator::usedBytes == 0);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(liveMemory.empty());
+}
+
+/**
+ * 对齐: 资源的对齐要求, 非一致内存按nonCoherentAtomSize对齐, bufferImageGranularity大于1时最优图像与缓冲分块存放
+ */
+static void testAlignment() {
+  DeviceMemoryAllocator::init(fakeProperties, 4096, 64);
+  VkDevice device = (VkDevice) 1;
+  MemoryAllocation buffer;
+  MemoryAllocation image;
+  MemoryAllocation linear;
+  VkBuffer fakeBuffer = (VkBuffer) nextHandle++;
+  VkImage fakeImage = (VkImage) nextHandle++;
+  setRequirements(100, 16, 0x1);
+  DeviceMemoryAllocator::allocateBuffer(device, fakeBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer);
+  setRequirements(5000, 1024, 0x1);
+  DeviceMemoryAllocator::allocateImage(device, fakeImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, image);
+  CHECK(image.offset % 1024 == 0);
+  CHECK(image.memory != buffer.memory);                                   // 粒度冲突的资源不在同一内存块中
+  setRequirements(100, 16, 0x4);
+  MemoryAllocation a;
+  MemoryAllocation b;
+  DeviceMemoryAllocator::allocateBuffer(device, fakeBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, a);
+  DeviceMemoryAllocator::allocateBuffer(device, fakeBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, b);
+  CHECK(a.memory == b.memory && a.offset % 64 == 0 && b.offset % 64 == 0); // 非一致内存: 刷新范围不与相邻资源重叠
+  CHECK(a.offset + 64 <= b.offset || b.offset + 64 <= a.offset);
+  DeviceMemoryAllocator::flush(device, a, 10, 50);
+  setRequirements(300, 256, 0x4);
+  DeviceMemoryAllocator::allocateImage(device, fakeImage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, false, linear);
+  CHECK(linear.memory == a.memory && linear.offset % 256 == 0);           // 线性图像与缓冲同块
+  DeviceMemoryAllocator::free(device, buffer);
+  DeviceMemoryAllocator::free(device, image);
+  DeviceMemoryAllocator::free(device, a);
+  DeviceMemoryAllocator::free(device, b);
+  DeviceMemoryAllocator::free(device, linear);
+  DeviceMemoryAllocator::destroy(device);
+
+  DeviceMemoryAllocator::init(fakeProperties, 1, 64);                    // 粒度为1时不区分资源种类
+  setRequirements(100, 16, 0x1);
+  DeviceMemoryAllocator::allocateBuffer(device, fakeBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer);
+  DeviceMemoryAllocator::allocateImage(device, fakeImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, image);
+  CHECK(image.memory == buffer.memory);
+  DeviceMemoryAllocator::free(device, buffer);
+  DeviceMemoryAllocator::free(device, image);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(liveMemory.empty());
+}
+
+/**
+ * 随机的分配与释放: 块内不重叠, vkAllocateMemory次数远少于分配次数, 大资源单独分配, 堆不足时内存块减半
+ */
+static void testBlocks() {
+  DeviceMemoryAllocator::init(fakeProperties, 4096, 64);
+  VkDevice device = (VkDevice) 1;
+  allocateCalls = 0;
+  freeCalls = 0;
+  std::mt19937 rng(3);
+  std::vector<MemoryAllocation> allocations;
+  std::vector<bool> optimal;
+  int count = 0;
+  for (int step = 0; step < 4000; ++step) {
+    if (allocations.empty() || rng() % 4 != 0) {
+      int kind = rng() % 4;                                               // 0一致缓冲 1顶点缓冲 2最优纹理 3非一致线性图像
+      VkDeviceSize size = kind == 2 ? 4096 * (1 + rng() % 512) : 16 + rng() % 65536;
+      if (kind == 2 && rng() % 50 == 0) {
+        size = 40ull << 20;                                               // 大纹理单独分配
+      }
+      setRequirements(size, kind == 2 ? 4096 : (kind == 0 ? 256 : 16), kind == 3 ? 0x4 : 0x7);
+      VkFlags mask = kind == 2 ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : kind == 3 ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                     : (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+      MemoryAllocation allocation;
+      if (kind >= 2) {
+        VkImage image = (VkImage) nextHandle++;
+        DeviceMemoryAllocator::allocateImage(device, image, mask, kind == 2, allocation);
+      } else {
+        VkBuffer buffer = (VkBuffer) nextHandle++;
+        DeviceMemoryAllocator::allocateBuffer(device, buffer, mask, allocation);
+      }
+      CHECK(allocation.offset % nextRequirements.alignment == 0 && allocation.size >= size);
+      CHECK(allocation.memoryTypeIndex == (uint32_t) (kind == 2 ? 0 : kind == 3 ? 2 : 1));
+      if (kind != 2) {
+        memset(allocation.mapped, kind, size);                            // 映射地址可写且在内存块范围内
+      }
+      allocations.push_back(allocation);
+      optimal.push_back(kind == 2);
+      count++;
+    } else {
+      size_t i = rng() % allocations.size();
+      DeviceMemoryAllocator::free(device, allocations[i]);
+      allocations[i] = allocations.back();
+      allocations.pop_back();
+      optimal[i] = optimal.back();
+      optimal.pop_back();
+    }
+    if (step % 50 == 0) {
+      for (size_t i = 0; i < allocations.size(); ++i) {
+        for (size_t j = i + 1; j < allocations.size(); ++j) {
+          if (allocations[i].memory != allocations[j].memory) {
+            continue;
+          }
+          CHECK(optimal[i] == optimal[j]);
+          CHECK(allocations[i].offset + allocations[i].size <= allocations[j].offset ||
+                allocations[j].offset + allocations[j].size <= allocations[i].offset);
+        }
+      }
+    }
+  }
+  DeviceMemoryAllocator::logStats();
+  CHECK(allocateCalls * 10 < count);
+  for (size_t i = 0; i < allocations.size(); ++i) {
+    DeviceMemoryAllocator::free(device, allocations[i]);
+  }
+  CHECK(DeviceMemoryAllocator::usedBytes == 0 && DeviceMemoryAllocator::liveAllocationCount == 0);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(liveMemory.empty() && allocateCalls == freeCalls);
+
+  DeviceMemoryAllocator::init(fakeProperties, 1, 64);
+  MemoryAllocation big;
+  MemoryAllocation small;
+  setRequirements(90ull << 20, 16, 0x2);
+  CHECK(DeviceMemoryAllocator::allocate(device, nextRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, false, big));
+  CHECK(liveMemory[big.memory].size == (90ull << 20));                    // 单独分配
+  setRequirements(1000, 16, 0x2);
+  CHECK(DeviceMemoryAllocator::allocate(device, nextRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, false, small));
+  CHECK(liveMemory[small.memory].size <= (6ull << 20));                   // 堆只剩6MB, 内存块逐次减半后成功
+  DeviceMemoryAllocator::free(device, small);
+  DeviceMemoryAllocator::free(device, big);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(liveMemory.empty());
+}
+
+int main() {
+  vk::vkAllocateMemory = fakeAllocateMemory;
+  vk::vkFreeMemory = fakeFreeMemory;
+  vk::vkMapMemory = fakeMapMemory;
+  vk::vkUnmapMemory = fakeUnmapMemory;
+  vk::vkFlushMappedMemoryRanges = fakeFlushMappedMemoryRanges;
+  vk::vkGetBufferMemoryRequirements = fakeGetBufferMemoryRequirements;
+  vk::vkGetImageMemoryRequirements = fakeGetImageMemoryRequirements;
+  vk::vkBindBufferMemory = fakeBindBufferMemory;
+  vk::vkBindImageMemory = fakeBindImageMemory;
+  initFakeProperties();
+  testTlsfSplitMerge();
+  testTlsfAlignment();
+  testMemoryTypeSelection();
+  testAlignment();
+  testBlocks();
+  printf("DeviceMemoryAllocatorTest passed\n");
+  return 0;
+}
@@ -0,0 +1,198 @@
+#include <map>
+#include <vector>
+#include "DeviceMemoryDefragmenter.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+#define BUFFER_BYTES (1024 * 1024)                            // 每个缓冲1MB
+#define BLOCK_BUFFERS 32                                      // 每个32MB内存块可容纳的缓冲数
+#define BUFFER_COUNT 40                                       // 第一个块占满, 第二个块只用1/4
+
+static VkDevice device = (VkDevice) 0x1;
+static VkCommandBuffer cmd = reinterpret_cast<VkCommandBuffer>(0x2);
+
+/**
+ * 所有者持有的缓冲: 移动回调中换用新的句柄与内存
+ */
+struct OwnedBuffer {
+  VkBuffer buffer;
+  MemoryAllocation allocation;
+  int id;                                                     // 整理登记号
+  int moves;                                                  // 被移动的次数
+};
+
+static std::vector<OwnedBuffer> owned;
+static std::map<VkBuffer, VkBuffer> movedFrom;                // 新缓冲 -> 旧缓冲
+
+static VkBufferCreateInfo bufferInfo() {
+  VkBufferCreateInfo info = {};
+  info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  info.size = BUFFER_BYTES;
+  info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  return info;
+}
+
+static int freeRanges() {
+  VkDeviceSize freeBytes, largestFree;
+  int ranges;
+  DeviceMemoryAllocator::fragmentationStats(freeBytes, largestFree, ranges);
+  return ranges;
+}
+
+/**
+ * 设备本地内存堆256MB(内存块32MB): 第一个块中每隔一个缓冲释放一个, 留下16个1MB的空洞,
+ * 第二个块只有8个缓冲(使用率1/4, 成为稀疏块), 剩余的缓冲全部登记为可移动
+ */
+static void createBuffers() {
+  FakeVulkan::reset();
+  DeviceMemoryAllocator::init(FakeVulkan::memoryProperties, 1024, 64);
+  DeviceMemoryDefragmenter::frameBudgetMicros = 1000000000;               // 只由字节预算限制每帧的移动数
+  DeviceMemoryDefragmenter::frameBudgetBytes = 4 * BUFFER_BYTES;
+  DeviceMemoryDefragmenter::setFramesInFlight(2);
+  owned.clear();
+  movedFrom.clear();
+  VkBufferCreateInfo info = bufferInfo();
+  for (int i = 0; i < BUFFER_COUNT; ++i) {
+    OwnedBuffer b = {};
+    VkResult result = vk::vkCreateBuffer(device, &info, nullptr, &b.buffer);
+    CHECK(result == VK_SUCCESS);
+    DeviceMemoryAllocator::allocateBuffer(device, b.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, b.allocation);
+    b.id = -1;
+    owned.push_back(b);
+  }
+  CHECK(owned[0].allocation.block == owned[BLOCK_BUFFERS - 1].allocation.block);
+  CHECK(owned[BLOCK_BUFFERS].allocation.block != owned[0].allocation.block);
+  std::vector<OwnedBuffer> kept;
+  for (int i = 0; i < BUFFER_COUNT; ++i) {
+    if (i < BLOCK_BUFFERS && i % 2 == 0) {
+      vk::vkDestroyBuffer(device, owned[i].buffer, nullptr);
+      DeviceMemoryAllocator::free(device, owned[i].allocation);
+    } else {
+      kept.push_back(owned[i]);
+    }
+  }
+  owned = kept;
+  for (size_t i = 0; i < owned.size(); ++i) {
+    size_t index = i;
+    owned[i].id = DeviceMemoryDefragmenter::registerBuffer(
+        owned[i].buffer, info, owned[i].allocation, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0, [index](VkDevice &, const MovableResource &resource) {
+          OwnedBuffer &b = owned[index];
+          movedFrom[resource.buffer] = b.buffer;
+          b.buffer = resource.buffer;
+          b.allocation = resource.allocation;
+          b.moves++;
+        });
+  }
+}
+
+static void destroyBuffers() {
+  for (size_t i = 0; i < owned.size(); ++i) {
+    DeviceMemoryDefragmenter::unregister(owned[i].id);
+    vk::vkDestroyBuffer(device, owned[i].buffer, nullptr);
+    DeviceMemoryAllocator::free(device, owned[i].allocation);
+  }
+  DeviceMemoryDefragmenter::destroy(device);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(FakeVulkan::buffers.empty() && FakeVulkan::memories.empty());
+}
+
+/**
+ * 整理: 稀疏块中的缓冲按字节预算分两帧移动到第一个块的空洞, 移动后大小不变、绑定到新的内存,
+ * 拷贝整个缓冲; 旧缓冲在在途帧结束后销毁, 之后空闲段数减少, 稀疏块成为空块
+ */
+static void testEvacuateSparseBlock() {
+  createBuffers();
+  int denseBlock = owned[0].allocation.block;
+  int sparseBlock = owned.back().allocation.block;
+  std::vector<int> sparse;
+  DeviceMemoryAllocator::findSparseBlocks(DEFRAG_SPARSE_USAGE, sparse);
+  CHECK(sparse.size() == 1 && sparse[0] == sparseBlock);
+  int rangesBefore = freeRanges();
+  double fragmentationBefore = DeviceMemoryAllocator::fragmentation();
+  CHECK(rangesBefore == BLOCK_BUFFERS / 2 + 1);                           // 16个空洞与稀疏块末尾的空闲段
+
+  DeviceMemoryDefragmenter::requestPass();
+  DeviceMemoryDefragmenter::step(device, cmd);
+  CHECK(DeviceMemoryDefragmenter::passes == 1 && DeviceMemoryDefragmenter::movedResources == 4); // 字节预算
+  DeviceMemoryDefragmenter::step(device, cmd);
+  CHECK(DeviceMemoryDefragmenter::movedResources == BUFFER_COUNT - BLOCK_BUFFERS);
+  CHECK(DeviceMemoryDefragmenter::movedBytes == (long long) (BUFFER_COUNT - BLOCK_BUFFERS) * BUFFER_BYTES);
+  CHECK(DeviceMemoryDefragmenter::failedMoves == 0);
+
+  int copies = 0;
+  for (size_t i = 0; i < owned.size(); ++i) {
+    const OwnedBuffer &b = owned[i];
+    bool wasSparse = i >= BLOCK_BUFFERS / 2;
+    CHECK(b.moves == (wasSparse ? 1 : 0));                                // 只移动稀疏块中的缓冲
+    CHECK(b.allocation.size == BUFFER_BYTES && b.allocation.block == denseBlock);
+    const FakeBuffer &fake = FakeVulkan::buffers[b.buffer];
+    CHECK(fake.info.size == BUFFER_BYTES && fake.memory == b.allocation.memory);
+    CHECK(fake.offset == b.allocation.offset);
+    if (!wasSparse) {
+      continue;
+    }
+    for (size_t c = 0; c < FakeVulkan::commands.size(); ++c) {
+      const FakeCommand &command = FakeVulkan::commands[c];
+      if (command.type == FAKE_CMD_COPY_BUFFER && command.buffer == b.buffer) {
+        CHECK(command.srcBuffer == movedFrom[b.buffer] && command.bufferCopies.size() == 1);
+        CHECK(command.bufferCopies[0].size == BUFFER_BYTES);
+        copies++;
+      }
+    }
+    CHECK(FakeVulkan::buffers.count(movedFrom[b.buffer]) == 1);           // 在途帧仍可能使用旧缓冲
+  }
+  CHECK(copies == BUFFER_COUNT - BLOCK_BUFFERS);
+
+  DeviceMemoryDefragmenter::step(device, cmd);
+  DeviceMemoryDefragmenter::step(device, cmd);
+  for (std::map<VkBuffer, VkBuffer>::iterator it = movedFrom.begin(); it != movedFrom.end(); ++it) {
+    CHECK(FakeVulkan::buffers.count(it->second) == 0);
+  }
+  CHECK(freeRanges() < rangesBefore);
+  CHECK(freeRanges() == BLOCK_BUFFERS / 2 - (BUFFER_COUNT - BLOCK_BUFFERS) + 1); // 剩余空洞与清空的块
+  CHECK(DeviceMemoryAllocator::fragmentation() < fragmentationBefore);
+  sparse.clear();
+  DeviceMemoryAllocator::findSparseBlocks(DEFRAG_SPARSE_USAGE, sparse);
+  CHECK(sparse.empty());
+  destroyBuffers();
+}
+
+/**
+ * 其他内存块没有空间时放弃本轮, 不创建新块, 资源保持原位
+ */
+static void testNoRoom() {
+  createBuffers();
+  int sparseBlock = owned.back().allocation.block;
+  VkBufferCreateInfo info = bufferInfo();
+  std::vector<OwnedBuffer> fillers;                                       // 填满第一个块的空洞
+  for (int i = 0; i < BLOCK_BUFFERS / 2; ++i) {
+    OwnedBuffer b = {};
+    vk::vkCreateBuffer(device, &info, nullptr, &b.buffer);
+    DeviceMemoryAllocator::allocateBuffer(device, b.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, b.allocation);
+    CHECK(b.allocation.block == owned[0].allocation.block);
+    fillers.push_back(b);
+  }
+  int allocations = DeviceMemoryAllocator::deviceAllocationCount;
+  int failedMoves = DeviceMemoryDefragmenter::failedMoves;
+  DeviceMemoryDefragmenter::requestPass();
+  DeviceMemoryDefragmenter::step(device, cmd);
+  CHECK(DeviceMemoryDefragmenter::failedMoves == failedMoves + 1);
+  CHECK(DeviceMemoryAllocator::deviceAllocationCount == allocations);
+  CHECK(owned.back().moves == 0 && owned.back().allocation.block == sparseBlock);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_COPY_BUFFER) == 0);
+  for (size_t i = 0; i < fillers.size(); ++i) {
+    vk::vkDestroyBuffer(device, fillers[i].buffer, nullptr);
+    DeviceMemoryAllocator::free(device, fillers[i].allocation);
+  }
+  destroyBuffers();
+}
+
+int main() {
+  FakeVulkan::install();
+  testEvacuateSparseBlock();
+  testNoRoom();
+  printf("DeviceMemoryDefragmenterTest passed\n");
+  return 0;
+}
@@ -0,0 +1,691 @@
+#include "FakeVulkan.h"
+#include <cstring>
+#include <mutex>
+#include "TestUtil.h"
+
+VkPhysicalDeviceMemoryProperties FakeVulkan::memoryProperties;
+VkPhysicalDeviceFeatures FakeVulkan::features;
+VkPhysicalDeviceProperties FakeVulkan::properties;
+VkMemoryRequirements FakeVulkan::imageRequirements;
+VkDeviceSize FakeVulkan::bufferAlignment = 16;
+bool FakeVulkan::autoSignalFences = true;
+std::map<VkDeviceMemory, FakeMemory> FakeVulkan::memories;
+std::map<VkBuffer, FakeBuffer> FakeVulkan::buffers;
+std::map<VkImage, FakeImage> FakeVulkan::images;
+std::map<VkImageView, VkImage> FakeVulkan::imageViews;
+std::map<VkRenderPass, FakeRenderPass> FakeVulkan::renderPasses;
+std::map<VkFramebuffer, VkRenderPass> FakeVulkan::framebuffers;
+std::map<VkSampler, VkSamplerCreateInfo> FakeVulkan::samplers;
+std::map<VkCommandPool, uint32_t> FakeVulkan::commandPools;
+std::map<VkCommandBuffer, FakeCommandBuffer> FakeVulkan::commandBuffers;
+std::map<VkFence, bool> FakeVulkan::fences;
+std::map<VkSemaphore, bool> FakeVulkan::semaphores;
+std::vector<FakeCommand> FakeVulkan::commands;
+std::vector<FakeSubmit> FakeVulkan::submits;
+int FakeVulkan::fenceWaits = 0;
+int FakeVulkan::poolResets = 0;
+uint64_t FakeVulkan::nextHandle = 0x1000;
+static std::mutex recordMutex;                                            // 工作线程并行录制时保护命令缓冲状态与命令记录
+
+uint64_t FakeVulkan::newHandle() {
+  return nextHandle++;
+}
+
+static FakeCommand newCommand(FakeCommandType type, VkCommandBuffer cmd) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it = FakeVulkan::commandBuffers.find(cmd);
+  CHECK(it == FakeVulkan::commandBuffers.end() || it->second.recording); // 分配的命令缓冲须在录制中
+  FakeCommand command = {};
+  command.type = type;
+  command.cmd = cmd;
+  return command;
+}
+
+static void pushCommand(const FakeCommand &command) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  FakeVulkan::commands.push_back(command);
+}
+
+static uint32_t allMemoryTypes() {
+  return (1u << FakeVulkan::memoryProperties.memoryTypeCount) - 1;
+}
+
+static VkResult fakeAllocateMemory(VkDevice, const VkMemoryAllocateInfo *info, const VkAllocationCallbacks *,
+                                   VkDeviceMemory *memory) {
+  CHECK(info->memoryTypeIndex < FakeVulkan::memoryProperties.memoryTypeCount);
+  FakeMemory fake;
+  fake.size = info->allocationSize;
+  fake.typeIndex = info->memoryTypeIndex;
+  fake.mapped = false;
+  *memory = (VkDeviceMemory) FakeVulkan::newHandle();
+  FakeVulkan::memories[*memory] = fake;
+  return VK_SUCCESS;
+}
+
+static void fakeFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *) {
+  if (memory == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::memories.erase(memory) == 1);
+}
+
+static VkResult fakeMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags,
+                              void **data) {
+  std::map<VkDeviceMemory, FakeMemory>::iterator it = FakeVulkan::memories.find(memory);
+  CHECK(it != FakeVulkan::memories.end() && !it->second.mapped);
+  FakeMemory &fake = it->second;
+  CHECK((FakeVulkan::memoryProperties.memoryTypes[fake.typeIndex].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0);
+  fake.host.resize(fake.size);                                            // 首次映射时才分配主机内存
+  fake.mapped = true;
+  *data = fake.host.data() + offset;
+  return VK_SUCCESS;
+}
+
+static void fakeUnmapMemory(VkDevice, VkDeviceMemory memory) {
+  std::map<VkDeviceMemory, FakeMemory>::iterator it = FakeVulkan::memories.find(memory);
+  CHECK(it != FakeVulkan::memories.end() && it->second.mapped);
+  it->second.mapped = false;
+}
+
+static VkResult fakeMappedMemoryRanges(VkDevice, uint32_t count, const VkMappedMemoryRange *ranges) {
+  for (uint32_t i = 0; i < count; ++i) {
+    std::map<VkDeviceMemory, FakeMemory>::iterator it = FakeVulkan::memories.find(ranges[i].memory);
+    CHECK(it != FakeVulkan::memories.end() && it->second.mapped);
+    CHECK(ranges[i].size == VK_WHOLE_SIZE || ranges[i].offset + ranges[i].size <= it->second.size);
+  }
+  return VK_SUCCESS;
+}
+
+static VkResult fakeCreateBuffer(VkDevice, const VkBufferCreateInfo *info, const VkAllocationCallbacks *,
+                                 VkBuffer *buffer) {
+  FakeBuffer fake;
+  fake.info = *info;
+  fake.info.pNext = nullptr;
+  fake.info.queueFamilyIndexCount = 0;
+  fake.info.pQueueFamilyIndices = nullptr;
+  fake.memory = VK_NULL_HANDLE;
+  fake.offset = 0;
+  *buffer = (VkBuffer) FakeVulkan::newHandle();
+  FakeVulkan::buffers[*buffer] = fake;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks *) {
+  if (buffer == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::buffers.erase(buffer) == 1);
+}
+
+static void fakeGetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements *requirements) {
+  std::map<VkBuffer, FakeBuffer>::iterator it = FakeVulkan::buffers.find(buffer);
+  CHECK(it != FakeVulkan::buffers.end());
+  VkDeviceSize alignment = FakeVulkan::bufferAlignment;
+  requirements->size = (it->second.info.size + alignment - 1) / alignment * alignment;
+  requirements->alignment = alignment;
+  requirements->memoryTypeBits = allMemoryTypes();
+}
+
+static VkResult fakeBindBufferMemory(VkDevice, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize offset) {
+  std::map<VkBuffer, FakeBuffer>::iterator it = FakeVulkan::buffers.find(buffer);
+  CHECK(it != FakeVulkan::buffers.end() && it->second.memory == VK_NULL_HANDLE);
+  std::map<VkDeviceMemory, FakeMemory>::iterator mem = FakeVulkan::memories.find(memory);
+  CHECK(mem != FakeVulkan::memories.end() && offset + it->second.info.size <= mem->second.size);
+  it->second.memory = memory;
+  it->second.offset = offset;
+  return VK_SUCCESS;
+}
+
+static VkResult fakeCreateImage(VkDevice, const VkImageCreateInfo *info, const VkAllocationCallbacks *,
+                                VkImage *image) {
+  FakeImage fake;
+  fake.info = *info;
+  fake.info.pNext = nullptr;
+  fake.info.queueFamilyIndexCount = 0;
+  fake.info.pQueueFamilyIndices = nullptr;
+  fake.memory = VK_NULL_HANDLE;
+  fake.offset = 0;
+  *image = (VkImage) FakeVulkan::newHandle();
+  FakeVulkan::images[*image] = fake;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks *) {
+  if (image == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::images.erase(image) == 1);
+}
+
+static void fakeGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements *requirements) {
+  std::map<VkImage, FakeImage>::iterator it = FakeVulkan::images.find(image);
+  CHECK(it != FakeVulkan::images.end());
+  if (FakeVulkan::imageRequirements.size != 0) {
+    *requirements = FakeVulkan::imageRequirements;
+    return;
+  }
+  const VkImageCreateInfo &info = it->second.info;
+  VkDeviceSize size = 0;
+  for (uint32_t level = 0; level < info.mipLevels; ++level) {            // 各级按每像素4字节计算
+    VkDeviceSize w = info.extent.width >> level;
+    VkDeviceSize h = info.extent.height >> level;
+    size += (w > 0 ? w : 1) * (h > 0 ? h : 1) * 4;
+  }
+  requirements->size = (size * info.arrayLayers + 255) / 256 * 256;
+  requirements->alignment = 256;
+  requirements->memoryTypeBits = allMemoryTypes();
+}
+
+static VkResult fakeBindImageMemory(VkDevice, VkImage image, VkDeviceMemory memory, VkDeviceSize offset) {
+  std::map<VkImage, FakeImage>::iterator it = FakeVulkan::images.find(image);
+  CHECK(it != FakeVulkan::images.end() && it->second.memory == VK_NULL_HANDLE);
+  CHECK(FakeVulkan::memories.count(memory) == 1);
+  it->second.memory = memory;
+  it->second.offset = offset;
+  return VK_SUCCESS;
+}
+
+static VkResult fakeCreateImageView(VkDevice, const VkImageViewCreateInfo *info, const VkAllocationCallbacks *,
+                                    VkImageView *view) {
+  *view = (VkImageView) FakeVulkan::newHandle();
+  FakeVulkan::imageViews[*view] = info->image;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroyImageView(VkDevice, VkImageView view, const VkAllocationCallbacks *) {
+  if (view == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::imageViews.erase(view) == 1);
+}
+
+static VkResult fakeCreateRenderPass(VkDevice, const VkRenderPassCreateInfo *info, const VkAllocationCallbacks *,
+                                     VkRenderPass *renderPass) {
+  FakeRenderPass fake;
+  fake.attachments.assign(info->pAttachments, info->pAttachments + info->attachmentCount);
+  fake.colorCount = info->subpassCount > 0 ? info->pSubpasses[0].colorAttachmentCount : 0;
+  fake.depth = info->subpassCount > 0 && info->pSubpasses[0].pDepthStencilAttachment != nullptr;
+  *renderPass = (VkRenderPass) FakeVulkan::newHandle();
+  FakeVulkan::renderPasses[*renderPass] = fake;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroyRenderPass(VkDevice, VkRenderPass renderPass, const VkAllocationCallbacks *) {
+  if (renderPass == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::renderPasses.erase(renderPass) == 1);
+}
+
+static VkResult fakeCreateFramebuffer(VkDevice, const VkFramebufferCreateInfo *info, const VkAllocationCallbacks *,
+                                      VkFramebuffer *framebuffer) {
+  CHECK(FakeVulkan::renderPasses.count(info->renderPass) == 1);
+  *framebuffer = (VkFramebuffer) FakeVulkan::newHandle();
+  FakeVulkan::framebuffers[*framebuffer] = info->renderPass;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroyFramebuffer(VkDevice, VkFramebuffer framebuffer, const VkAllocationCallbacks *) {
+  if (framebuffer == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::framebuffers.erase(framebuffer) == 1);
+}
+
+static VkResult fakeCreateSampler(VkDevice, const VkSamplerCreateInfo *info, const VkAllocationCallbacks *,
+                                  VkSampler *sampler) {
+  *sampler = (VkSampler) FakeVulkan::newHandle();
+  FakeVulkan::samplers[*sampler] = *info;
+  FakeVulkan::samplers[*sampler].pNext = nullptr;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroySampler(VkDevice, VkSampler sampler, const VkAllocationCallbacks *) {
+  if (sampler == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::samplers.erase(sampler) == 1);
+}
+
+static VkResult fakeCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo *info, const VkAllocationCallbacks *,
+                                      VkCommandPool *pool) {
+  *pool = (VkCommandPool) FakeVulkan::newHandle();
+  FakeVulkan::commandPools[*pool] = info->queueFamilyIndex;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroyCommandPool(VkDevice, VkCommandPool pool, const VkAllocationCallbacks *) {
+  if (pool == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::commandPools.erase(pool) == 1);
+  std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it = FakeVulkan::commandBuffers.begin();
+  while (it != FakeVulkan::commandBuffers.end()) {                        // 命令池中的命令缓冲一并释放
+    if (it->second.pool == pool) {
+      FakeVulkan::commandBuffers.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+static VkResult fakeResetCommandPool(VkDevice, VkCommandPool pool, VkCommandPoolResetFlags) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  CHECK(FakeVulkan::commandPools.count(pool) == 1);
+  std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it;
+  for (it = FakeVulkan::commandBuffers.begin(); it != FakeVulkan::commandBuffers.end(); ++it) {
+    if (it->second.pool == pool) {
+      it->second.recording = false;
+    }
+  }
+  FakeVulkan::poolResets++;
+  return VK_SUCCESS;
+}
+
+static VkResult fakeAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo *info,
+                                           VkCommandBuffer *commandBuffers) {
+  CHECK(FakeVulkan::commandPools.count(info->commandPool) == 1);
+  for (uint32_t i = 0; i < info->commandBufferCount; ++i) {
+    FakeCommandBuffer fake = {};
+    fake.pool = info->commandPool;
+    fake.level = info->level;
+    commandBuffers[i] = reinterpret_cast<VkCommandBuffer>(FakeVulkan::newHandle());
+    FakeVulkan::commandBuffers[commandBuffers[i]] = fake;
+  }
+  return VK_SUCCESS;
+}
+
+static void fakeFreeCommandBuffers(VkDevice, VkCommandPool pool, uint32_t count,
+                                   const VkCommandBuffer *commandBuffers) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if (commandBuffers[i] == VK_NULL_HANDLE) {
+      continue;
+    }
+    std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it = FakeVulkan::commandBuffers.find(commandBuffers[i]);
+    CHECK(it != FakeVulkan::commandBuffers.end() && it->second.pool == pool);
+    FakeVulkan::commandBuffers.erase(it);
+  }
+}
+
+static VkResult fakeBeginCommandBuffer(VkCommandBuffer cmd, const VkCommandBufferBeginInfo *info) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it = FakeVulkan::commandBuffers.find(cmd);
+  CHECK(it != FakeVulkan::commandBuffers.end() && !it->second.recording);
+  FakeCommandBuffer &fake = it->second;
+  fake.recording = true;
+  fake.beginCount++;
+  fake.flags = info->flags;
+  fake.inheritedRenderPass = VK_NULL_HANDLE;
+  fake.inheritedFramebuffer = VK_NULL_HANDLE;
+  if (fake.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY && info->pInheritanceInfo != nullptr) {
+    fake.inheritedRenderPass = info->pInheritanceInfo->renderPass;
+    fake.inheritedFramebuffer = info->pInheritanceInfo->framebuffer;
+  }
+  return VK_SUCCESS;
+}
+
+static VkResult fakeEndCommandBuffer(VkCommandBuffer cmd) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it = FakeVulkan::commandBuffers.find(cmd);
+  CHECK(it != FakeVulkan::commandBuffers.end() && it->second.recording);
+  it->second.recording = false;
+  return VK_SUCCESS;
+}
+
+static VkResult fakeResetCommandBuffer(VkCommandBuffer cmd, VkCommandBufferResetFlags) {
+  std::lock_guard<std::mutex> lock(recordMutex);
+  std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it = FakeVulkan::commandBuffers.find(cmd);
+  CHECK(it != FakeVulkan::commandBuffers.end());
+  it->second.recording = false;
+  return VK_SUCCESS;
+}
+
+static VkResult fakeCreateFence(VkDevice, const VkFenceCreateInfo *info, const VkAllocationCallbacks *,
+                                VkFence *fence) {
+  *fence = (VkFence) FakeVulkan::newHandle();
+  FakeVulkan::fences[*fence] = (info->flags & VK_FENCE_CREATE_SIGNALED_BIT) != 0;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroyFence(VkDevice, VkFence fence, const VkAllocationCallbacks *) {
+  if (fence == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::fences.erase(fence) == 1);
+}
+
+static VkResult fakeGetFenceStatus(VkDevice, VkFence fence) {
+  std::map<VkFence, bool>::iterator it = FakeVulkan::fences.find(fence);
+  CHECK(it != FakeVulkan::fences.end());
+  return it->second ? VK_SUCCESS : VK_NOT_READY;
+}
+
+static VkResult fakeWaitForFences(VkDevice, uint32_t count, const VkFence *fences, VkBool32, uint64_t) {
+  FakeVulkan::fenceWaits++;
+  for (uint32_t i = 0; i < count; ++i) {                                  // 阻塞等待相当于GPU执行完成
+    FakeVulkan::signalFence(fences[i]);
+  }
+  return VK_SUCCESS;
+}
+
+static VkResult fakeResetFences(VkDevice, uint32_t count, const VkFence *fences) {
+  for (uint32_t i = 0; i < count; ++i) {
+    std::map<VkFence, bool>::iterator it = FakeVulkan::fences.find(fences[i]);
+    CHECK(it != FakeVulkan::fences.end());
+    it->second = false;
+  }
+  return VK_SUCCESS;
+}
+
+static VkResult fakeCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo *, const VkAllocationCallbacks *,
+                                    VkSemaphore *semaphore) {
+  *semaphore = (VkSemaphore) FakeVulkan::newHandle();
+  FakeVulkan::semaphores[*semaphore] = false;
+  return VK_SUCCESS;
+}
+
+static void fakeDestroySemaphore(VkDevice, VkSemaphore semaphore, const VkAllocationCallbacks *) {
+  if (semaphore == VK_NULL_HANDLE) {
+    return;
+  }
+  CHECK(FakeVulkan::semaphores.erase(semaphore) == 1);
+}
+
+static VkResult fakeQueueSubmit(VkQueue queue, uint32_t count, const VkSubmitInfo *infos, VkFence fence) {
+  for (uint32_t i = 0; i < count; ++i) {
+    const VkSubmitInfo &info = infos[i];
+    FakeSubmit submit;
+    submit.queue = queue;
+    submit.commandBuffers.assign(info.pCommandBuffers, info.pCommandBuffers + info.commandBufferCount);
+    submit.waitSemaphores.assign(info.pWaitSemaphores, info.pWaitSemaphores + info.waitSemaphoreCount);
+    submit.waitStages.assign(info.pWaitDstStageMask, info.pWaitDstStageMask + info.waitSemaphoreCount);
+    submit.signalSemaphores.assign(info.pSignalSemaphores, info.pSignalSemaphores + info.signalSemaphoreCount);
+    submit.fence = i + 1 == count ? fence : VK_NULL_HANDLE;
+    for (size_t c = 0; c < submit.commandBuffers.size(); ++c) {          // 提交的命令缓冲须已结束录制
+      std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it =
+          FakeVulkan::commandBuffers.find(submit.commandBuffers[c]);
+      CHECK(it == FakeVulkan::commandBuffers.end() || !it->second.recording);
+    }
+    FakeVulkan::submits.push_back(submit);
+  }
+  if (fence != VK_NULL_HANDLE) {
+    std::map<VkFence, bool>::iterator it = FakeVulkan::fences.find(fence);
+    CHECK(it != FakeVulkan::fences.end() && !it->second);                 // 提交时栅栏须未触发
+    if (FakeVulkan::autoSignalFences) {
+      it->second = true;
+    }
+  }
+  return VK_SUCCESS;
+}
+
+static VkResult fakeQueueWaitIdle(VkQueue) {
+  return VK_SUCCESS;
+}
+
+static VkResult fakeDeviceWaitIdle(VkDevice) {
+  return VK_SUCCESS;
+}
+
+static void fakeGetPhysicalDeviceFeatures(VkPhysicalDevice, VkPhysicalDeviceFeatures *features) {
+  *features = FakeVulkan::features;
+}
+
+static void fakeGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties *properties) {
+  *properties = FakeVulkan::properties;
+}
+
+static void fakeGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties *properties) {
+  *properties = FakeVulkan::memoryProperties;
+}
+
+static void fakeCmdPipelineBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStages,
+                                   VkPipelineStageFlags dstStages, VkDependencyFlags, uint32_t,
+                                   const VkMemoryBarrier *, uint32_t bufferCount,
+                                   const VkBufferMemoryBarrier *bufferBarriers, uint32_t imageCount,
+                                   const VkImageMemoryBarrier *imageBarriers) {
+  FakeCommand command = newCommand(FAKE_CMD_PIPELINE_BARRIER, cmd);
+  command.srcStages = srcStages;
+  command.dstStages = dstStages;
+  command.bufferBarriers.assign(bufferBarriers, bufferBarriers + bufferCount);
+  command.imageBarriers.assign(imageBarriers, imageBarriers + imageCount);
+  pushCommand(command);
+}
+
+static void fakeCmdCopyBuffer(VkCommandBuffer cmd, VkBuffer src, VkBuffer dst, uint32_t count,
+                              const VkBufferCopy *regions) {
+  FakeCommand command = newCommand(FAKE_CMD_COPY_BUFFER, cmd);
+  command.srcBuffer = src;
+  command.buffer = dst;
+  command.bufferCopies.assign(regions, regions + count);
+  pushCommand(command);
+}
+
+static void fakeCmdCopyImage(VkCommandBuffer cmd, VkImage src, VkImageLayout, VkImage dst, VkImageLayout,
+                             uint32_t count, const VkImageCopy *regions) {
+  FakeCommand command = newCommand(FAKE_CMD_COPY_IMAGE, cmd);
+  command.srcImage = src;
+  command.image = dst;
+  command.imageCopies.assign(regions, regions + count);
+  pushCommand(command);
+}
+
+static void fakeCmdCopyBufferToImage(VkCommandBuffer cmd, VkBuffer src, VkImage dst, VkImageLayout,
+                                     uint32_t count, const VkBufferImageCopy *regions) {
+  FakeCommand command = newCommand(FAKE_CMD_COPY_BUFFER_TO_IMAGE, cmd);
+  command.srcBuffer = src;
+  command.image = dst;
+  command.bufferImageCopies.assign(regions, regions + count);
+  pushCommand(command);
+}
+
+static void fakeCmdBeginRenderPass(VkCommandBuffer cmd, const VkRenderPassBeginInfo *info,
+                                   VkSubpassContents contents) {
+  FakeCommand command = newCommand(FAKE_CMD_BEGIN_RENDER_PASS, cmd);
+  command.renderPass = info->renderPass;
+  command.framebuffer = info->framebuffer;
+  command.contents = contents;
+  pushCommand(command);
+}
+
+static void fakeCmdEndRenderPass(VkCommandBuffer cmd) {
+  pushCommand(newCommand(FAKE_CMD_END_RENDER_PASS, cmd));
+}
+
+static void fakeCmdBindVertexBuffers(VkCommandBuffer cmd, uint32_t, uint32_t count, const VkBuffer *buffers,
+                                     const VkDeviceSize *offsets) {
+  FakeCommand command = newCommand(FAKE_CMD_BIND_VERTEX_BUFFERS, cmd);
+  command.buffer = count > 0 ? buffers[0] : VK_NULL_HANDLE;
+  command.offset = count > 0 ? offsets[0] : 0;
+  command.count = count;
+  pushCommand(command);
+}
+
+static void fakeCmdBindIndexBuffer(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkIndexType) {
+  FakeCommand command = newCommand(FAKE_CMD_BIND_INDEX_BUFFER, cmd);
+  command.buffer = buffer;
+  command.offset = offset;
+  pushCommand(command);
+}
+
+static void fakeCmdDraw(VkCommandBuffer cmd, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+                        uint32_t firstInstance) {
+  FakeCommand command = newCommand(FAKE_CMD_DRAW, cmd);
+  command.count = vertexCount;
+  command.instanceCount = instanceCount;
+  command.first = firstVertex;
+  command.firstInstance = firstInstance;
+  pushCommand(command);
+}
+
+static void fakeCmdDrawIndexed(VkCommandBuffer cmd, uint32_t indexCount, uint32_t instanceCount,
+                               uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+  FakeCommand command = newCommand(FAKE_CMD_DRAW_INDEXED, cmd);
+  command.count = indexCount;
+  command.instanceCount = instanceCount;
+  command.first = firstIndex;
+  command.vertexOffset = vertexOffset;
+  command.firstInstance = firstInstance;
+  pushCommand(command);
+}
+
+static void fakeCmdDrawIndirect(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+                                uint32_t stride) {
+  FakeCommand command = newCommand(FAKE_CMD_DRAW_INDIRECT, cmd);
+  command.buffer = buffer;
+  command.offset = offset;
+  command.count = drawCount;
+  command.stride = stride;
+  pushCommand(command);
+}
+
+static void fakeCmdDrawIndexedIndirect(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset,
+                                       uint32_t drawCount, uint32_t stride) {
+  FakeCommand command = newCommand(FAKE_CMD_DRAW_INDEXED_INDIRECT, cmd);
+  command.buffer = buffer;
+  command.offset = offset;
+  command.count = drawCount;
+  command.stride = stride;
+  pushCommand(command);
+}
+
+static void fakeCmdExecuteCommands(VkCommandBuffer cmd, uint32_t count, const VkCommandBuffer *secondaries) {
+  FakeCommand command = newCommand(FAKE_CMD_EXECUTE_COMMANDS, cmd);
+  command.secondaries.assign(secondaries, secondaries + count);
+  for (uint32_t i = 0; i < count; ++i) {                                  // 执行的次级命令缓冲须已结束录制
+    std::map<VkCommandBuffer, FakeCommandBuffer>::iterator it = FakeVulkan::commandBuffers.find(secondaries[i]);
+    CHECK(it != FakeVulkan::commandBuffers.end() && !it->second.recording);
+    CHECK(it->second.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+  }
+  pushCommand(command);
+}
+
+void FakeVulkan::install() {
+  vk::vkAllocateMemory = fakeAllocateMemory;
+  vk::vkFreeMemory = fakeFreeMemory;
+  vk::vkMapMemory = fakeMapMemory;
+  vk::vkUnmapMemory = fakeUnmapMemory;
+  vk::vkFlushMappedMemoryRanges = fakeMappedMemoryRanges;
+  vk::vkInvalidateMappedMemoryRanges = fakeMappedMemoryRanges;
+  vk::vkCreateBuffer = fakeCreateBuffer;
+  vk::vkDestroyBuffer = fakeDestroyBuffer;
+  vk::vkGetBufferMemoryRequirements = fakeGetBufferMemoryRequirements;
+  vk::vkBindBufferMemory = fakeBindBufferMemory;
+  vk::vkCreateImage = fakeCreateImage;
+  vk::vkDestroyImage = fakeDestroyImage;
+  vk::vkGetImageMemoryRequirements = fakeGetImageMemoryRequirements;
+  vk::vkBindImageMemory = fakeBindImageMemory;
+  vk::vkCreateImageView = fakeCreateImageView;
+  vk::vkDestroyImageView = fakeDestroyImageView;
+  vk::vkCreateRenderPass = fakeCreateRenderPass;
+  vk::vkDestroyRenderPass = fakeDestroyRenderPass;
+  vk::vkCreateFramebuffer = fakeCreateFramebuffer;
+  vk::vkDestroyFramebuffer = fakeDestroyFramebuffer;
+  vk::vkCreateSampler = fakeCreateSampler;
+  vk::vkDestroySampler = fakeDestroySampler;
+  vk::vkCreateCommandPool = fakeCreateCommandPool;
+  vk::vkDestroyCommandPool = fakeDestroyCommandPool;
+  vk::vkResetCommandPool = fakeResetCommandPool;
+  vk::vkAllocateCommandBuffers = fakeAllocateCommandBuffers;
+  vk::vkFreeCommandBuffers = fakeFreeCommandBuffers;
+  vk::vkBeginCommandBuffer = fakeBeginCommandBuffer;
+  vk::vkEndCommandBuffer = fakeEndCommandBuffer;
+  vk::vkResetCommandBuffer = fakeResetCommandBuffer;
+  vk::vkCreateFence = fakeCreateFence;
+  vk::vkDestroyFence = fakeDestroyFence;
+  vk::vkGetFenceStatus = fakeGetFenceStatus;
+  vk::vkWaitForFences = fakeWaitForFences;
+  vk::vkResetFences = fakeResetFences;
+  vk::vkCreateSemaphore = fakeCreateSemaphore;
+  vk::vkDestroySemaphore = fakeDestroySemaphore;
+  vk::vkQueueSubmit = fakeQueueSubmit;
+  vk::vkQueueWaitIdle = fakeQueueWaitIdle;
+  vk::vkDeviceWaitIdle = fakeDeviceWaitIdle;
+  vk::vkGetPhysicalDeviceFeatures = fakeGetPhysicalDeviceFeatures;
+  vk::vkGetPhysicalDeviceProperties = fakeGetPhysicalDeviceProperties;
+  vk::vkGetPhysicalDeviceMemoryProperties = fakeGetPhysicalDeviceMemoryProperties;
+  vk::vkCmdPipelineBarrier = fakeCmdPipelineBarrier;
+  vk::vkCmdCopyBuffer = fakeCmdCopyBuffer;
+  vk::vkCmdCopyImage = fakeCmdCopyImage;
+  vk::vkCmdCopyBufferToImage = fakeCmdCopyBufferToImage;
+  vk::vkCmdBeginRenderPass = fakeCmdBeginRenderPass;
+  vk::vkCmdEndRenderPass = fakeCmdEndRenderPass;
+  vk::vkCmdBindVertexBuffers = fakeCmdBindVertexBuffers;
+  vk::vkCmdBindIndexBuffer = fakeCmdBindIndexBuffer;
+  vk::vkCmdDraw = fakeCmdDraw;
+  vk::vkCmdDrawIndexed = fakeCmdDrawIndexed;
+  vk::vkCmdDrawIndirect = fakeCmdDrawIndirect;
+  vk::vkCmdDrawIndexedIndirect = fakeCmdDrawIndexedIndirect;
+  vk::vkCmdExecuteCommands = fakeCmdExecuteCommands;
+  reset();
+}
+
+void FakeVulkan::reset() {
+  memories.clear();
+  buffers.clear();
+  images.clear();
+  imageViews.clear();
+  renderPasses.clear();
+  framebuffers.clear();
+  samplers.clear();
+  commandPools.clear();
+  commandBuffers.clear();
+  fences.clear();
+  semaphores.clear();
+  commands.clear();
+  submits.clear();
+  fenceWaits = 0;
+  poolResets = 0;
+  autoSignalFences = true;
+  bufferAlignment = 16;
+  memset(&imageRequirements, 0, sizeof(imageRequirements));
+  memset(&features, 0, sizeof(features));
+  memset(&properties, 0, sizeof(properties));
+  properties.limits.maxSamplerAnisotropy = 16.0f;
+  properties.limits.nonCoherentAtomSize = 64;
+  properties.limits.bufferImageGranularity = 1024;
+  setDefaultMemoryProperties();
+}
+
+void FakeVulkan::setDefaultMemoryProperties() {
+  memset(&memoryProperties, 0, sizeof(memoryProperties));
+  memoryProperties.memoryHeapCount = 2;
+  memoryProperties.memoryHeaps[0].size = 256ull << 20;
+  memoryProperties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+  memoryProperties.memoryHeaps[1].size = 64ull << 20;
+  memoryProperties.memoryTypeCount = 3;
+  memoryProperties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  memoryProperties.memoryTypes[0].heapIndex = 0;
+  memoryProperties.memoryTypes[1].propertyFlags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  memoryProperties.memoryTypes[1].heapIndex = 1;
+  memoryProperties.memoryTypes[2].propertyFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+  memoryProperties.memoryTypes[2].heapIndex = 0;
+}
+
+void FakeVulkan::signalFence(VkFence fence) {
+  std::map<VkFence, bool>::iterator it = fences.find(fence);
+  CHECK(it != fences.end());
+  it->second = true;
+}
+
+unsigned char *FakeVulkan::hostData(VkBuffer buffer) {
+  std::map<VkBuffer, FakeBuffer>::iterator it = buffers.find(buffer);
+  CHECK(it != buffers.end());
+  std::map<VkDeviceMemory, FakeMemory>::iterator mem = memories.find(it->second.memory);
+  if (mem == memories.end() || mem->second.host.empty()) {
+    return nullptr;
+  }
+  return mem->second.host.data() + it->second.offset;
+}
+
+int FakeVulkan::countCommands(FakeCommandType type, VkCommandBuffer cmd) {
+  int count = 0;
+  for (size_t i = 0; i < commands.size(); ++i) {
+    if (commands[i].type == type && (cmd == VK_NULL_HANDLE || commands[i].cmd == cmd)) {
+      count++;
+    }
+  }
+  return count;
+}
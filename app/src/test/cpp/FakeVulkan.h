@@ -0,0 +1,189 @@
+#ifndef DEEPERVULKAN_FAKEVULKAN_H_
+#define DEEPERVULKAN_FAKEVULKAN_H_
+
+#include <map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "../vksysutil/vulkan_wrapper.h"
+
+/**
+ * 伪造的设备内存(主机可见类型分配真实的主机内存, 以便检查映射后写入的内容)
+ */
+struct FakeMemory {
+  VkDeviceSize size;                        // 分配的字节数
+  uint32_t typeIndex;                       // 内存类型
+  std::vector<unsigned char> host;          // 主机可见类型的内容
+  bool mapped;                              // 是否已映射
+};
+
+/**
+ * 伪造的缓冲
+ */
+struct FakeBuffer {
+  VkBufferCreateInfo info;                  // 创建信息(不含pNext与队列族列表)
+  VkDeviceMemory memory;                    // 绑定的内存
+  VkDeviceSize offset;                      // 绑定的偏移量
+};
+
+/**
+ * 伪造的图像
+ */
+struct FakeImage {
+  VkImageCreateInfo info;                   // 创建信息(不含pNext与队列族列表)
+  VkDeviceMemory memory;                    // 绑定的内存
+  VkDeviceSize offset;                      // 绑定的偏移量
+};
+
+/**
+ * 伪造的渲染通道(只保存检查需要的部分)
+ */
+struct FakeRenderPass {
+  std::vector<VkAttachmentDescription> attachments;   // 附件描述
+  uint32_t colorCount;                                // 第一个子通道的颜色附件数
+  bool depth;                                         // 第一个子通道是否有深度附件
+};
+
+/**
+ * 伪造的命令缓冲
+ */
+struct FakeCommandBuffer {
+  VkCommandPool pool;                       // 所属的命令池
+  VkCommandBufferLevel level;               // 主/次级
+  bool recording;                           // 是否在录制中
+  int beginCount;                           // 开始录制的次数
+  VkCommandBufferUsageFlags flags;          // 最近一次开始录制的标志
+  VkRenderPass inheritedRenderPass;         // 次级命令缓冲继承的渲染通道
+  VkFramebuffer inheritedFramebuffer;       // 次级命令缓冲继承的帧缓冲
+};
+
+/**
+ * 记录的命令类型
+ */
+enum FakeCommandType {
+  FAKE_CMD_PIPELINE_BARRIER,
+  FAKE_CMD_COPY_BUFFER,
+  FAKE_CMD_COPY_IMAGE,
+  FAKE_CMD_COPY_BUFFER_TO_IMAGE,
+  FAKE_CMD_BEGIN_RENDER_PASS,
+  FAKE_CMD_END_RENDER_PASS,
+  FAKE_CMD_BIND_VERTEX_BUFFERS,
+  FAKE_CMD_BIND_INDEX_BUFFER,
+  FAKE_CMD_DRAW,
+  FAKE_CMD_DRAW_INDEXED,
+  FAKE_CMD_DRAW_INDIRECT,
+  FAKE_CMD_DRAW_INDEXED_INDIRECT,
+  FAKE_CMD_EXECUTE_COMMANDS
+};
+
+/**
+ * 记录的一条命令(只填写与类型相关的字段)
+ */
+struct FakeCommand {
+  FakeCommandType type;                               // 命令类型
+  VkCommandBuffer cmd;                                // 录制到的命令缓冲
+  VkPipelineStageFlags srcStages;                     // 屏障的源阶段
+  VkPipelineStageFlags dstStages;                     // 屏障的目标阶段
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;  // 缓冲屏障
+  std::vector<VkImageMemoryBarrier> imageBarriers;    // 图像屏障
+  VkBuffer srcBuffer;                                 // 拷贝源缓冲
+  VkBuffer buffer;                                    // 拷贝目标、绑定或间接绘制的缓冲
+  VkImage srcImage;                                   // 拷贝源图像
+  VkImage image;                                      // 拷贝目标图像
+  std::vector<VkBufferCopy> bufferCopies;             // 缓冲拷贝区域
+  std::vector<VkImageCopy> imageCopies;               // 图像拷贝区域
+  std::vector<VkBufferImageCopy> bufferImageCopies;   // 缓冲到图像的拷贝区域
+  VkRenderPass renderPass;                            // 开始的渲染通道
+  VkFramebuffer framebuffer;                          // 开始的帧缓冲
+  VkSubpassContents contents;                         // 子通道内容来源
+  VkDeviceSize offset;                                // 绑定或间接绘制的偏移量
+  uint32_t count;                                     // 顶点/索引数或间接绘制数
+  uint32_t instanceCount;                             // 实例数
+  uint32_t first;                                     // 第一个顶点/索引
+  int32_t vertexOffset;                               // 顶点偏移量
+  uint32_t firstInstance;                             // 第一个实例
+  uint32_t stride;                                    // 间接绘制命令的间隔
+  std::vector<VkCommandBuffer> secondaries;           // 执行的次级命令缓冲
+};
+
+/**
+ * 记录的一次队列提交
+ */
+struct FakeSubmit {
+  VkQueue queue;                                      // 提交到的队列
+  std::vector<VkCommandBuffer> commandBuffers;        // 提交的命令缓冲
+  std::vector<VkSemaphore> waitSemaphores;            // 等待的信号量
+  std::vector<VkPipelineStageFlags> waitStages;       // 等待信号量的阶段
+  std::vector<VkSemaphore> signalSemaphores;          // 触发的信号量
+  VkFence fence;                                      // 完成时触发的栅栏
+};
+
+/**
+ * 主机测试共用的伪造Vulkan设备: 把vk::函数指针替换为记录调用的实现
+ * 创建的对象以递增的句柄表示, 测试可检查其创建信息、绑定的内存与录制的命令;
+ * 栅栏默认在提交时立即触发, autoSignalFences为false时须由测试调用signalFence模拟GPU完成
+ * 录制命令(开始/结束录制、重置命令池与vkCmd*)可在多个线程中并行进行, 其余调用只能在测试线程中进行
+ */
+class FakeVulkan {
+ public:
+  static VkPhysicalDeviceMemoryProperties memoryProperties; // 内存属性表
+  static VkPhysicalDeviceFeatures features;                 // 物理设备特性
+  static VkPhysicalDeviceProperties properties;             // 物理设备属性
+  static VkMemoryRequirements imageRequirements;            // 图像的内存需求(size为0时按宽×高×4计算)
+  static VkDeviceSize bufferAlignment;                      // 缓冲内存需求的对齐
+  static bool autoSignalFences;                             // 提交时是否立即触发栅栏
+  static std::map<VkDeviceMemory, FakeMemory> memories;     // 未释放的设备内存
+  static std::map<VkBuffer, FakeBuffer> buffers;            // 未销毁的缓冲
+  static std::map<VkImage, FakeImage> images;               // 未销毁的图像
+  static std::map<VkImageView, VkImage> imageViews;         // 未销毁的图像视图
+  static std::map<VkRenderPass, FakeRenderPass> renderPasses; // 未销毁的渲染通道
+  static std::map<VkFramebuffer, VkRenderPass> framebuffers;  // 未销毁的帧缓冲
+  static std::map<VkSampler, VkSamplerCreateInfo> samplers; // 未销毁的采样器
+  static std::map<VkCommandPool, uint32_t> commandPools;    // 未销毁的命令池(值为队列族)
+  static std::map<VkCommandBuffer, FakeCommandBuffer> commandBuffers; // 未释放的命令缓冲
+  static std::map<VkFence, bool> fences;                    // 未销毁的栅栏(值为是否已触发)
+  static std::map<VkSemaphore, bool> semaphores;            // 未销毁的信号量
+  static std::vector<FakeCommand> commands;                 // 按录制顺序记录的命令
+  static std::vector<FakeSubmit> submits;                   // 按顺序记录的提交
+  static int fenceWaits;                                    // vkWaitForFences调用次数
+  static int poolResets;                                    // vkResetCommandPool调用次数
+
+  /**
+   * 把vk::函数指针替换为伪造实现并设置默认属性
+   */
+  static void install();
+
+  /**
+   * 清除所有对象与记录并恢复默认属性(不重新安装函数指针)
+   */
+  static void reset();
+
+  /**
+   * 默认内存类型: 类型0设备本地, 类型1主机可见一致, 类型2设备本地且惰性分配
+   */
+  static void setDefaultMemoryProperties();
+
+  /**
+   * 模拟GPU完成: 触发栅栏
+   */
+  static void signalFence(VkFence fence);
+
+  /**
+   * 缓冲绑定内存的主机地址(内存不可见时返回nullptr)
+   */
+  static unsigned char *hostData(VkBuffer buffer);
+
+  /**
+   * 统计某类命令的条数(cmd为VK_NULL_HANDLE时统计所有命令缓冲)
+   */
+  static int countCommands(FakeCommandType type, VkCommandBuffer cmd = VK_NULL_HANDLE);
+
+  /**
+   * 新的伪造句柄
+   */
+  static uint64_t newHandle();
+
+ private:
+  static uint64_t nextHandle;                               // 下一个句柄值
+};
+
+#endif //DEEPERVULKAN_FAKEVULKAN_H_
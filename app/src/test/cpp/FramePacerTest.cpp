@@ -0,0 +1,160 @@
+#include <cmath>
+#include <vector>
+#include "FramePacer.h"
+#include "TestUtil.h"
+
+static long long fakeTime = 1000000000LL;                     // 伪造时钟的当前时刻(纳秒)
+static long long fakeTick = 0;                                // 每次读取时钟后前进的纳秒数(使自旋能够结束)
+static long long fakeOversleep = 0;                           // 每次休眠多睡的纳秒数(模拟唤醒误差)
+static std::vector<long long> sleeps;                         // 记录的休眠时长
+
+static long long fakeNow() {
+  long long t = fakeTime;
+  fakeTime += fakeTick;
+  return t;
+}
+
+static void fakeSleep(long long ns) {
+  sleeps.push_back(ns);
+  fakeTime += ns + fakeOversleep;
+}
+
+/**
+ * 帧间隔取不短于1 / fps的刷新周期整数倍
+ */
+static void testTargetInterval() {
+  FramePacer::setRefreshInterval(16666667);
+  FramePacer::setTargetFps(60);
+  CHECK(FramePacer::targetIntervalNs == 16666667);
+  FramePacer::setTargetFps(58);                                           // 超出不到FRAME_PACER_REFRESH_SLACK视为1倍
+  CHECK(FramePacer::targetIntervalNs == 16666667);
+  FramePacer::setTargetFps(30);
+  CHECK(FramePacer::targetIntervalNs == 2 * 16666667);
+  FramePacer::setRefreshInterval(11111111);                               // 90Hz显示器上限制30帧: 每3个刷新周期一帧
+  CHECK(FramePacer::targetIntervalNs == 3 * 11111111);
+  FramePacer::setTargetFps(0);
+  CHECK(FramePacer::targetIntervalNs == 0);
+  FramePacer::setRefreshInterval(0);                                      // 查询不到时使用默认值
+  CHECK(FramePacer::refreshIntervalNs == FRAME_PACER_REFRESH_NS);
+}
+
+/**
+ * 休眠到目标时刻之前FRAME_PACER_SPIN_NS, 余下的时间自旋; 各帧开始时刻落在起点 + k * 帧间隔上, 不累积误差
+ */
+static void testSleepTargets() {
+  fakeTick = 1000;
+  fakeOversleep = 300000;                                                 // 每次多睡0.3毫秒, 由自旋吸收
+  FramePacer::setClock(fakeNow, fakeSleep);
+  FramePacer::setRefreshInterval(16666667);
+  FramePacer::setTargetFps(60);
+  long long interval = FramePacer::targetIntervalNs;
+  long long origin = 0;
+  for (int k = 0; k < 100; ++k) {
+    FramePacer::begin();
+    long long start = fakeTime - fakeTick;                                // begin读取的时刻
+    if (k == 0) {
+      origin = start;
+    }
+    CHECK(start >= origin + k * interval && start <= origin + k * interval + 4 * fakeTick);
+    fakeTime += 3000000 + (k % 7) * 1000000;                              // 3~9毫秒的工作
+    long long workEnd = fakeTime;
+    sleeps.clear();
+    FramePacer::end();
+    CHECK(sleeps.size() == 1);
+    long long expected = origin + (k + 1) * interval - workEnd - FRAME_PACER_SPIN_NS;
+    CHECK(std::llabs(sleeps[0] - expected) <= 2 * fakeTick);              // 休眠到目标时刻之前FRAME_PACER_SPIN_NS
+  }
+  CHECK(FramePacer::missedFrames == 0 && FramePacer::frames == 100);
+
+  // 超时的帧跳到下一个对齐的时刻, 不连续补帧
+  FramePacer::reset();
+  FramePacer::begin();
+  origin = fakeTime - fakeTick;
+  fakeTime += 40000000;                                                   // 40毫秒, 跨过两个帧间隔
+  FramePacer::end();
+  CHECK(FramePacer::missedFrames == 1);
+  CHECK(fakeTime >= origin + 3 * interval && fakeTime <= origin + 3 * interval + 2 * fakeTick);
+  FramePacer::begin();
+  fakeTime += 1000000;
+  sleeps.clear();
+  FramePacer::end();
+  CHECK(FramePacer::missedFrames == 1 && sleeps.size() == 1);
+  CHECK(fakeTime >= origin + 4 * interval && fakeTime <= origin + 4 * interval + 2 * fakeTick);
+
+  // 距目标时刻不足FRAME_PACER_SPIN_NS时不休眠, 只自旋
+  FramePacer::begin();
+  fakeTime += interval - FRAME_PACER_SPIN_NS / 2;
+  sleeps.clear();
+  FramePacer::end();
+  CHECK(sleeps.empty() && fakeTime >= origin + 5 * interval);
+
+  // 不限帧率时不等待
+  FramePacer::setTargetFps(0);
+  FramePacer::begin();
+  long long before = fakeTime;
+  FramePacer::end();
+  CHECK(sleeps.empty() && fakeTime - before <= 2 * fakeTick);
+}
+
+/**
+ * 每个统计周期的帧率、帧间隔标准差与最长帧间隔
+ */
+static void testJitterStatistics() {
+  fakeTick = 0;
+  fakeOversleep = 0;
+  FramePacer::setClock(fakeNow, fakeSleep);
+  FramePacer::setTargetFps(0);
+  std::vector<double> intervals;                                          // 进入统计的帧间隔(毫秒)
+  long long elapsed = 0;
+  float previousFps = FramePacer::currFPS;
+  FramePacer::reset();
+  FramePacer::begin();
+  for (int k = 0; elapsed < FRAME_PACER_LOG_INTERVAL_NS; ++k) {
+    long long ns = k % 4 == 3 ? 25000000 : 10000000;                      // 每4帧有一帧25毫秒
+    fakeTime += ns;
+    elapsed += ns;
+    intervals.push_back(ns / 1e6);
+    FramePacer::end(false);
+    CHECK(FramePacer::currFPS == previousFps || elapsed >= FRAME_PACER_LOG_INTERVAL_NS); // 统计周期结束时才更新
+    FramePacer::begin();
+  }
+  double sum = 0;
+  double squareSum = 0;
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    sum += intervals[i];
+    squareSum += intervals[i] * intervals[i];
+  }
+  double mean = sum / intervals.size();
+  double jitter = std::sqrt(squareSum / intervals.size() - mean * mean);
+  CHECK(std::fabs(FramePacer::currFPS - 1000.0 / mean) < 1e-3);
+  CHECK(std::fabs(FramePacer::jitterMs - jitter) < 1e-6 && jitter > 6.0);
+  CHECK(FramePacer::maxIntervalMs == 25.0);
+
+  // 下一个周期全部均匀: 抖动为0
+  for (int k = 0; k < 100; ++k) {
+    fakeTime += 12500000;
+    FramePacer::end(false);
+    FramePacer::begin();
+  }
+  CHECK(std::fabs(FramePacer::currFPS - 80.0f) < 1e-3 && FramePacer::jitterMs < 1e-6);
+  CHECK(FramePacer::maxIntervalMs == 12.5);
+
+  fakeTime += 5000000000LL;                                               // 暂停5秒后重新开始: 暂停的时间不计入
+  FramePacer::reset();
+  FramePacer::begin();
+  for (int k = 0; k < 100; ++k) {
+    fakeTime += 12500000;
+    FramePacer::end(false);
+    FramePacer::begin();
+  }
+  CHECK(FramePacer::maxIntervalMs == 12.5 && FramePacer::missedFrames == 0);
+  FramePacer::setClock(nullptr, nullptr);
+}
+
+int main() {
+  testTargetInterval();
+  testSleepTargets();
+  testJitterStatistics();
+  printf("FramePacerTest passed\n");
+  return 0;
+}
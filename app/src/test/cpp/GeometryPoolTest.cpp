@@ -0,0 +1,275 @@
+#include <cstring>
+#include <vector>
+#include "GeometryPool.h"
+#include "AsyncUploader.h"
+#include "StagingRing.h"
+#include "ResourceStateTracker.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+#define VERTEX_STRIDE 16
+#define MESH_VERTICES 16                                      // 每个网格256字节顶点
+#define MESH_INDICES 8                                        // 每个网格16字节索引
+#define POOL_MESHES 16                                        // 共享缓冲可容纳的网格数
+#define MESH_COUNT 15                                         // 测试分配的网格数(TLSF按最坏对齐查找, 不能完全占满)
+
+static VkDevice device = (VkDevice) 0x1;
+static VkPhysicalDevice gpu = reinterpret_cast<VkPhysicalDevice>(0x2);
+static VkQueue queue = reinterpret_cast<VkQueue>(0x3);
+static VkCommandBuffer cmd = reinterpret_cast<VkCommandBuffer>(0x4);
+
+/**
+ * 统一内存设备(共享缓冲可映射, 网格数据直接写入), multiDrawIndirect决定是否合并为间接调用
+ */
+static void createPool(bool multiDrawIndirect) {
+  FakeVulkan::reset();
+  VkPhysicalDeviceMemoryProperties &mp = FakeVulkan::memoryProperties;
+  mp.memoryHeapCount = 1;
+  mp.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+  mp.memoryTypeCount = 2;
+  mp.memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  mp.memoryTypes[1].heapIndex = 0;
+  FakeVulkan::features.multiDrawIndirect = multiDrawIndirect ? VK_TRUE : VK_FALSE;
+  FakeVulkan::features.drawIndirectFirstInstance = VK_TRUE;
+  ResourceStateTracker::reset();
+  DeviceMemoryAllocator::init(mp, 1024, 64);
+  CHECK(DeviceMemoryAllocator::unifiedMemory);
+  StagingRing::create(device, mp, 64 * 1024);
+  AsyncUploader::init(device, queue, 0, 0);
+  GeometryPool::create(device, gpu, POOL_MESHES * MESH_VERTICES * VERTEX_STRIDE,
+                       POOL_MESHES * MESH_INDICES * sizeof(uint16_t));
+  GeometryPool::setFramesInFlight(1);
+  CHECK(GeometryPool::multiDrawIndirect == multiDrawIndirect);
+}
+
+static void destroyPool() {
+  GeometryPool::destroy(device);
+  AsyncUploader::destroy(device);
+  StagingRing::destroy(device);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(FakeVulkan::buffers.empty() && FakeVulkan::memories.empty());
+}
+
+/**
+ * 分配一个网格, 顶点数据的每个字节为value, 索引为0..indexCount-1
+ */
+static int allocateMesh(unsigned char value, uint32_t indexCount) {
+  unsigned char vertices[MESH_VERTICES * VERTEX_STRIDE];
+  memset(vertices, value, sizeof(vertices));
+  uint16_t indices[MESH_INDICES];
+  for (uint16_t i = 0; i < MESH_INDICES; ++i) {
+    indices[i] = i;
+  }
+  int mesh = GeometryPool::allocate(device, vertices, MESH_VERTICES, VERTEX_STRIDE,
+                                    indexCount > 0 ? indices : nullptr, indexCount);
+  CHECK(mesh >= 0 && GeometryPool::ready(mesh));                          // 直接写入, 无需等待上传
+  return mesh;
+}
+
+/**
+ * 最后一条某类命令的副本(之后的录制会使指向记录的指针失效)
+ */
+static FakeCommand lastCommand(FakeCommandType type) {
+  for (size_t i = FakeVulkan::commands.size(); i > 0; --i) {
+    if (FakeVulkan::commands[i - 1].type == type) {
+      return FakeVulkan::commands[i - 1];
+    }
+  }
+  CHECK(false);
+  return FakeCommand();
+}
+
+/**
+ * 拷贝到buffer之后是否有屏障使其对顶点输入阶段的access读取可见
+ */
+static bool readableAfterCopy(VkBuffer buffer, VkAccessFlags access) {
+  bool copied = false;
+  for (size_t i = 0; i < FakeVulkan::commands.size(); ++i) {
+    const FakeCommand &c = FakeVulkan::commands[i];
+    if (c.type == FAKE_CMD_COPY_BUFFER && c.buffer == buffer) {
+      copied = true;
+    }
+    for (size_t b = 0; copied && b < c.bufferBarriers.size(); ++b) {
+      const VkBufferMemoryBarrier &barrier = c.bufferBarriers[b];
+      if (barrier.buffer == buffer && barrier.srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT &&
+          barrier.dstAccessMask == access && (c.dstStages & VK_PIPELINE_STAGE_VERTEX_INPUT_BIT) != 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * 整理: 释放编号为偶数的网格后碎片超过阈值, 在途帧结束后存活网格按编号紧凑拷贝到新缓冲,
+ * 首顶点与首索引随之更新, 拷贝区域的源为原来的位置; 旧缓冲在在途帧结束后销毁
+ */
+static void testCompactionOffsets() {
+  createPool(true);
+  GeometryPool::beginFrame(device, cmd);
+  std::vector<int> meshes;
+  for (int i = 0; i < MESH_COUNT; ++i) {
+    meshes.push_back(allocateMesh((unsigned char) i, MESH_INDICES));
+  }
+  std::vector<GeometryMesh> before;
+  for (int i = 0; i < MESH_COUNT; ++i) {
+    before.push_back(GeometryPool::mesh(meshes[i]));
+  }
+  GeometryPool::bind(cmd);
+  VkBuffer oldVertexBuffer = lastCommand(FAKE_CMD_BIND_VERTEX_BUFFERS).buffer;
+  VkBuffer oldIndexBuffer = lastCommand(FAKE_CMD_BIND_INDEX_BUFFER).buffer;
+  const unsigned char *oldVertices = FakeVulkan::hostData(oldVertexBuffer);
+  for (int i = 0; i < MESH_COUNT; ++i) {                                  // 数据写在各网格的位置
+    CHECK(oldVertices[before[i].firstVertex * VERTEX_STRIDE] == i);
+  }
+  for (int i = 0; i < MESH_COUNT; i += 2) {
+    GeometryPool::free(meshes[i]);
+  }
+
+  FakeVulkan::commands.clear();
+  GeometryPool::beginFrame(device, cmd);                                  // 回收释放的空间并整理
+  CHECK(GeometryPool::compactions == 2);
+  std::vector<FakeCommand> copies;                                        // 之后的录制会使指向记录的指针失效
+  for (size_t i = 0; i < FakeVulkan::commands.size(); ++i) {
+    if (FakeVulkan::commands[i].type == FAKE_CMD_COPY_BUFFER) {
+      copies.push_back(FakeVulkan::commands[i]);
+    }
+  }
+  CHECK(copies.size() == 2);
+  CHECK(copies[0].srcBuffer == oldVertexBuffer && copies[1].srcBuffer == oldIndexBuffer);
+  CHECK(copies[0].bufferCopies.size() == MESH_COUNT / 2 && copies[1].bufferCopies.size() == MESH_COUNT / 2);
+  for (int k = 0; k < MESH_COUNT / 2; ++k) {
+    const GeometryMesh &m = GeometryPool::mesh(meshes[2 * k + 1]);
+    const GeometryMesh &old = before[2 * k + 1];
+    CHECK(m.firstVertex == (uint32_t) (k * MESH_VERTICES));               // 按编号顺序紧凑排列
+    CHECK(m.firstIndex == (uint32_t) (k * MESH_INDICES));
+    CHECK(m.vertexCount == MESH_VERTICES && m.indexCount == MESH_INDICES);
+    const VkBufferCopy &v = copies[0].bufferCopies[k];
+    CHECK(v.srcOffset == old.firstVertex * VERTEX_STRIDE && v.dstOffset == m.firstVertex * VERTEX_STRIDE);
+    CHECK(v.size == MESH_VERTICES * VERTEX_STRIDE);
+    const VkBufferCopy &i = copies[1].bufferCopies[k];
+    CHECK(i.srcOffset == old.firstIndex * sizeof(uint16_t) && i.dstOffset == m.firstIndex * sizeof(uint16_t));
+    CHECK(i.size == MESH_INDICES * sizeof(uint16_t));
+  }
+  CHECK(GeometryPool::compactedBytes == (MESH_COUNT / 2) * (MESH_VERTICES * VERTEX_STRIDE +
+                                                            MESH_INDICES * sizeof(uint16_t)));
+  CHECK(readableAfterCopy(copies[0].buffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT));
+  CHECK(readableAfterCopy(copies[1].buffer, VK_ACCESS_INDEX_READ_BIT));
+
+  GeometryPool::bind(cmd);
+  VkBuffer newVertexBuffer = lastCommand(FAKE_CMD_BIND_VERTEX_BUFFERS).buffer;
+  CHECK(newVertexBuffer == copies[0].buffer && newVertexBuffer != oldVertexBuffer);
+  CHECK(lastCommand(FAKE_CMD_BIND_INDEX_BUFFER).buffer == copies[1].buffer);
+  CHECK(FakeVulkan::buffers.count(oldVertexBuffer) == 1);                 // 本帧的拷贝仍读取旧缓冲
+
+  int extra = allocateMesh(0xEE, 0);                                      // 紧凑后的空闲区在末尾
+  CHECK(GeometryPool::mesh(extra).firstVertex == (MESH_COUNT / 2) * MESH_VERTICES);
+  CHECK(FakeVulkan::hostData(newVertexBuffer)[GeometryPool::mesh(extra).firstVertex * VERTEX_STRIDE] == 0xEE);
+  GeometryPool::beginFrame(device, cmd);
+  CHECK(FakeVulkan::buffers.count(oldVertexBuffer) == 0 && FakeVulkan::buffers.count(oldIndexBuffer) == 0);
+  CHECK(GeometryPool::compactions == 2);                                  // 不再碎片化
+
+  GeometryPool::free(extra);
+  for (int i = 1; i < MESH_COUNT; i += 2) {
+    GeometryPool::free(meshes[i]);
+  }
+  destroyPool();
+}
+
+/**
+ * 间接绘制: 命令写入本帧区域, 无索引与有索引的命令各一次间接调用, 内容为网格的位置与实例参数;
+ * 释放的网格不绘制; 同一帧的下一批接在之后写入
+ */
+static void testIndirectCommands() {
+  createPool(true);
+  GeometryPool::beginFrame(device, cmd);
+  int indexed = allocateMesh(1, MESH_INDICES);
+  int plain = allocateMesh(2, 0);
+  int freed = allocateMesh(3, MESH_INDICES);
+  GeometryPool::free(freed);
+  FakeVulkan::commands.clear();
+  GeometryPool::addDraw(indexed, 2, 5);
+  GeometryPool::addDraw(plain, 1, 7);
+  GeometryPool::addDraw(freed);
+  GeometryPool::addDraw(indexed, 1, 9);
+  GeometryPool::drawBatch(cmd);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_BIND_VERTEX_BUFFERS) == 1);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_DRAW) == 0 && FakeVulkan::countCommands(FAKE_CMD_DRAW_INDEXED) == 0);
+
+  const VkDeviceSize regionBytes = GEOMETRY_POOL_INDIRECT_COUNT * sizeof(VkDrawIndexedIndirectCommand);
+  FakeCommand draw = lastCommand(FAKE_CMD_DRAW_INDIRECT);
+  CHECK(draw.count == 1 && draw.stride == sizeof(VkDrawIndirectCommand));
+  CHECK(draw.offset == regionBytes * (1 % GEOMETRY_POOL_FRAMES));        // 第1帧的区域
+  const unsigned char *host = FakeVulkan::hostData(draw.buffer);
+  VkDrawIndirectCommand d;
+  memcpy(&d, host + draw.offset, sizeof(d));
+  CHECK(d.vertexCount == MESH_VERTICES && d.instanceCount == 1 && d.firstInstance == 7);
+  CHECK(d.firstVertex == GeometryPool::mesh(plain).firstVertex);
+
+  FakeCommand indexedDraw = lastCommand(FAKE_CMD_DRAW_INDEXED_INDIRECT);
+  CHECK(indexedDraw.count == 2);
+  CHECK(indexedDraw.stride == sizeof(VkDrawIndexedIndirectCommand) && indexedDraw.buffer == draw.buffer);
+  CHECK(indexedDraw.offset == draw.offset + sizeof(VkDrawIndirectCommand));
+  VkDrawIndexedIndirectCommand di[2];
+  memcpy(di, host + indexedDraw.offset, sizeof(di));
+  const GeometryMesh &m = GeometryPool::mesh(indexed);
+  CHECK(di[0].indexCount == MESH_INDICES && di[0].instanceCount == 2 && di[0].firstInstance == 5);
+  CHECK(di[0].firstIndex == m.firstIndex && di[0].vertexOffset == (int32_t) m.firstVertex);
+  CHECK(di[1].instanceCount == 1 && di[1].firstInstance == 9 && di[1].firstIndex == m.firstIndex);
+
+  GeometryPool::addDraw(plain, 3, 0);                                     // 同一帧的第二批
+  GeometryPool::drawBatch(cmd);
+  FakeCommand second = lastCommand(FAKE_CMD_DRAW_INDIRECT);
+  CHECK(second.offset == indexedDraw.offset + sizeof(di));
+  memcpy(&d, host + second.offset, sizeof(d));
+  CHECK(d.instanceCount == 3 && d.firstVertex == GeometryPool::mesh(plain).firstVertex);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_BIND_VERTEX_BUFFERS) == 1);   // 同一命令缓冲不重复绑定
+
+  GeometryPool::beginFrame(device, cmd);                                  // 下一帧使用下一个区域
+  GeometryPool::addDraw(plain);
+  GeometryPool::drawBatch(cmd);
+  CHECK(lastCommand(FAKE_CMD_DRAW_INDIRECT).offset == regionBytes * (2 % GEOMETRY_POOL_FRAMES));
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_BIND_VERTEX_BUFFERS) == 2);
+
+  GeometryPool::free(indexed);
+  GeometryPool::free(plain);
+  destroyPool();
+}
+
+/**
+ * 不支持multiDrawIndirect时逐条直接绘制, 参数与间接命令相同
+ */
+static void testDirectFallback() {
+  createPool(false);
+  GeometryPool::beginFrame(device, cmd);
+  allocateMesh(1, 0);
+  int indexed = allocateMesh(2, MESH_INDICES);
+  int plain = allocateMesh(3, 0);
+  FakeVulkan::commands.clear();
+  GeometryPool::addDraw(indexed, 2, 5);
+  GeometryPool::addDraw(plain, 1, 7);
+  GeometryPool::drawBatch(cmd);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_DRAW_INDIRECT) == 0);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_DRAW_INDEXED_INDIRECT) == 0);
+  FakeCommand draw = lastCommand(FAKE_CMD_DRAW);
+  CHECK(draw.count == MESH_VERTICES && draw.first == GeometryPool::mesh(plain).firstVertex);
+  CHECK(draw.first == MESH_VERTICES * 2 && draw.instanceCount == 1 && draw.firstInstance == 7);
+  FakeCommand indexedDraw = lastCommand(FAKE_CMD_DRAW_INDEXED);
+  CHECK(indexedDraw.count == MESH_INDICES && indexedDraw.first == 0);
+  CHECK(indexedDraw.vertexOffset == MESH_VERTICES && indexedDraw.instanceCount == 2);
+  CHECK(indexedDraw.firstInstance == 5);
+  GeometryPool::free(0);
+  GeometryPool::free(indexed);
+  GeometryPool::free(plain);
+  destroyPool();
+}
+
+int main() {
+  FakeVulkan::install();
+  testCompactionOffsets();
+  testIndirectCommands();
+  testDirectFallback();
+  printf("GeometryPoolTest passed\n");
+  return 0;
+}
@@ -0,0 +1,363 @@
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "HeadlessRenderer.h"
+#include "GpuTimer.h"
+#include "DeviceMemoryAllocator.h"
+#include "ResourceStateTracker.h"
+#include "../bndev/mylog.h"
+
+#define FRAMES_IN_FLIGHT 2                                                // 在途帧数(与应用相同)
+
+/**
+ * 桌面主机上的离屏无窗口绘制程序
+ * 在lavapipe、SwiftShader等CPU实现上运行HeadlessRenderer与GpuTimer: 创建离屏颜色图像代替交换链图像,
+ * 每帧以随帧号变化的颜色清除, 记录CPU录制提交耗时与GPU执行耗时, 结束时打印统计并读回最后一帧
+ * 示例场景依赖Android资源管理器与运行时编译着色器, 此处只绘制清除颜色, 用于验证离屏目标、计时与读回
+ * 用法: HeadlessDesktop [--frames N] [--size WxH] [--output path.ppm]
+ */
+static VkInstance instance;
+static VkPhysicalDevice gpu;
+static VkDevice device;
+static VkQueue queue;
+static uint32_t queueFamilyIndex;
+static VkRenderPass renderPass;
+static std::vector<VkImage> images;
+static std::vector<VkImageView> views;
+static std::vector<VkFramebuffer> framebuffers;
+static VkCommandPool commandPool;
+static VkCommandBuffer cmdBuffers[FRAMES_IN_FLIGHT];
+static VkFence fences[FRAMES_IN_FLIGHT];
+
+/**
+ * 第frame帧的清除颜色(红色随帧号由0变到1, 绿色相反)
+ */
+static VkClearColorValue clearColorOf(int frame) {
+  float t = HeadlessRenderer::frameCount > 1 ? (float) frame / (HeadlessRenderer::frameCount - 1) : 1.0f;
+  VkClearColorValue color;
+  color.float32[0] = t;
+  color.float32[1] = 1.0f - t;
+  color.float32[2] = 0.5f;
+  color.float32[3] = 1.0f;
+  return color;
+}
+
+static bool parseArguments(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--frames" && i + 1 < argc) {
+      HeadlessRenderer::frameCount = atoi(argv[++i]);
+    } else if (arg == "--size" && i + 1 < argc) {
+      unsigned int w, h;
+      if (sscanf(argv[++i], "%ux%u", &w, &h) != 2) {
+        return false;
+      }
+      HeadlessRenderer::width = w;
+      HeadlessRenderer::height = h;
+    } else if (arg == "--output" && i + 1 < argc) {
+      HeadlessRenderer::readback = true;
+      HeadlessRenderer::outputPath = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return HeadlessRenderer::frameCount > 0 && HeadlessRenderer::width > 0 && HeadlessRenderer::height > 0;
+}
+
+/**
+ * 创建实例与逻辑设备(不启用任何扩展), 选用第一个物理设备中支持图形工作的队列家族
+ */
+static bool createDevice() {
+  if (!vk::loadVulkan()) {
+    LOGE("load Vulkan application interfaces failed!");
+    return false;
+  }
+  VkApplicationInfo appInfo = {};
+  appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  appInfo.pNext = nullptr;
+  appInfo.pApplicationName = "HeadlessDesktop";
+  appInfo.applicationVersion = 1;
+  appInfo.pEngineName = "DeepVulkanEngine";
+  appInfo.engineVersion = 1;
+  appInfo.apiVersion = VK_API_VERSION_1_0;
+  VkInstanceCreateInfo instInfo = {};
+  instInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instInfo.pNext = nullptr;
+  instInfo.flags = 0;
+  instInfo.pApplicationInfo = &appInfo;
+  instInfo.enabledExtensionCount = 0;                                     // 不创建表面, 不需要实例扩展
+  instInfo.ppEnabledExtensionNames = nullptr;
+  instInfo.enabledLayerCount = 0;
+  instInfo.ppEnabledLayerNames = nullptr;
+  if (vk::vkCreateInstance(&instInfo, nullptr, &instance) != VK_SUCCESS) {
+    LOGE("Vulkan instance create failed!");
+    return false;
+  }
+
+  uint32_t gpuCount = 0;
+  vk::vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr);
+  if (gpuCount == 0) {
+    LOGE("no Vulkan physical device (set VK_ICD_FILENAMES to a software ICD such as lavapipe or SwiftShader)");
+    return false;
+  }
+  std::vector<VkPhysicalDevice> gpus(gpuCount);
+  vk::vkEnumeratePhysicalDevices(instance, &gpuCount, gpus.data());
+  gpu = gpus[0];
+  VkPhysicalDeviceProperties properties;
+  vk::vkGetPhysicalDeviceProperties(gpu, &properties);
+  LOGI("HeadlessDesktop: using %s", properties.deviceName);
+
+  uint32_t familyCount = 0;
+  vk::vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vk::vkGetPhysicalDeviceQueueFamilyProperties(gpu, &familyCount, families.data());
+  queueFamilyIndex = familyCount;
+  for (uint32_t i = 0; i < familyCount; ++i) {
+    if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      queueFamilyIndex = i;
+      break;
+    }
+  }
+  if (queueFamilyIndex == familyCount) {
+    LOGE("no queue family supports graphics");
+    return false;
+  }
+
+  float priorities[1] = {0.0f};
+  VkDeviceQueueCreateInfo queueInfo = {};
+  queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queueInfo.pNext = nullptr;
+  queueInfo.queueFamilyIndex = queueFamilyIndex;
+  queueInfo.queueCount = 1;
+  queueInfo.pQueuePriorities = priorities;
+  VkDeviceCreateInfo deviceInfo = {};
+  deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceInfo.pNext = nullptr;
+  deviceInfo.queueCreateInfoCount = 1;
+  deviceInfo.pQueueCreateInfos = &queueInfo;
+  deviceInfo.enabledExtensionCount = 0;                                   // 离屏无窗口模式不需要交换链扩展
+  deviceInfo.ppEnabledExtensionNames = nullptr;
+  deviceInfo.enabledLayerCount = 0;
+  deviceInfo.ppEnabledLayerNames = nullptr;
+  deviceInfo.pEnabledFeatures = nullptr;
+  if (vk::vkCreateDevice(gpu, &deviceInfo, nullptr, &device) != VK_SUCCESS) {
+    LOGE("Vulkan device create failed!");
+    return false;
+  }
+  vk::vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+  return true;
+}
+
+/**
+ * 创建离屏颜色图像、渲染通道(清除后转为TRANSFER_SRC布局以便读回)、帧缓冲以及每个在途帧的命令缓冲与栅栏
+ */
+static void createTargets() {
+  DeviceMemoryAllocator::init(gpu);
+  GpuTimer::create(device, gpu, queueFamilyIndex, FRAMES_IN_FLIGHT);
+  HeadlessRenderer::createTargets(device, HEADLESS_IMAGE_COUNT, HEADLESS_COLOR_FORMAT, images, views);
+
+  VkAttachmentDescription attachment = {};
+  attachment.format = HEADLESS_COLOR_FORMAT;
+  attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;                   // 每帧整体清除, 不保留上一次的内容
+  attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;          // 与应用的离屏模式相同, 结束时可直接复制
+  VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorReference;
+  VkRenderPassCreateInfo rpInfo = {};
+  rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  rpInfo.pNext = nullptr;
+  rpInfo.attachmentCount = 1;
+  rpInfo.pAttachments = &attachment;
+  rpInfo.subpassCount = 1;
+  rpInfo.pSubpasses = &subpass;
+  rpInfo.dependencyCount = 0;
+  rpInfo.pDependencies = nullptr;
+  VkResult result = vk::vkCreateRenderPass(device, &rpInfo, nullptr, &renderPass);
+  assert(result == VK_SUCCESS);
+
+  framebuffers.resize(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
+    VkFramebufferCreateInfo fbInfo = {};
+    fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fbInfo.pNext = nullptr;
+    fbInfo.renderPass = renderPass;
+    fbInfo.attachmentCount = 1;
+    fbInfo.pAttachments = &views[i];
+    fbInfo.width = HeadlessRenderer::width;
+    fbInfo.height = HeadlessRenderer::height;
+    fbInfo.layers = 1;
+    result = vk::vkCreateFramebuffer(device, &fbInfo, nullptr, &framebuffers[i]);
+    assert(result == VK_SUCCESS);
+  }
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.pNext = nullptr;
+  poolInfo.queueFamilyIndex = queueFamilyIndex;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;       // 每帧单独重新录制, 读回时也重置
+  result = vk::vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+  assert(result == VK_SUCCESS);
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.pNext = nullptr;
+  allocInfo.commandPool = commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = FRAMES_IN_FLIGHT;
+  result = vk::vkAllocateCommandBuffers(device, &allocInfo, cmdBuffers);
+  assert(result == VK_SUCCESS);
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.pNext = nullptr;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;                         // 第一次使用时不等待
+  for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+    result = vk::vkCreateFence(device, &fenceInfo, nullptr, &fences[i]);
+    assert(result == VK_SUCCESS);
+  }
+}
+
+/**
+ * 绘制固定帧数: 等待该帧区域的上一次提交完成后读取其GPU耗时, 再录制并提交本帧
+ */
+static void drawFrames() {
+  HeadlessRenderer::reset();
+  LOGI("headless: drawing %d frames at %d x %d", HeadlessRenderer::frameCount,
+       HeadlessRenderer::width, HeadlessRenderer::height);
+  for (int frame = 0; frame < HeadlessRenderer::frameCount; ++frame) {
+    int frameIndex = frame % FRAMES_IN_FLIGHT;
+    vk::vkWaitForFences(device, 1, &fences[frameIndex], VK_TRUE, UINT64_MAX);
+    double gpuMs;
+    if (GpuTimer::read(device, frameIndex, gpuMs)) {                      // 该帧区域上一次提交的GPU耗时
+      HeadlessRenderer::recordGpu(gpuMs);
+    }
+    vk::vkResetFences(device, 1, &fences[frameIndex]);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    VkCommandBuffer &cmd = cmdBuffers[frameIndex];
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = nullptr;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+    vk::vkResetCommandBuffer(cmd, 0);
+    VkResult result = vk::vkBeginCommandBuffer(cmd, &beginInfo);
+    assert(result == VK_SUCCESS);
+    GpuTimer::begin(cmd, frameIndex);
+
+    VkClearValue clearValue;
+    clearValue.color = clearColorOf(frame);
+    VkRenderPassBeginInfo rpBegin = {};
+    rpBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpBegin.pNext = nullptr;
+    rpBegin.renderPass = renderPass;
+    rpBegin.framebuffer = framebuffers[frame % framebuffers.size()];      // 轮流使用离屏颜色图像
+    rpBegin.renderArea.offset.x = 0;
+    rpBegin.renderArea.offset.y = 0;
+    rpBegin.renderArea.extent.width = HeadlessRenderer::width;
+    rpBegin.renderArea.extent.height = HeadlessRenderer::height;
+    rpBegin.clearValueCount = 1;
+    rpBegin.pClearValues = &clearValue;
+    vk::vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
+    vk::vkCmdEndRenderPass(cmd);
+
+    GpuTimer::end(cmd, frameIndex);
+    result = vk::vkEndCommandBuffer(cmd);
+    assert(result == VK_SUCCESS);
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    result = vk::vkQueueSubmit(queue, 1, &submitInfo, fences[frameIndex]);
+    assert(result == VK_SUCCESS);
+    HeadlessRenderer::recordCpu(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+  vk::vkDeviceWaitIdle(device);
+  for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {                            // 最后几帧的GPU耗时
+    double gpuMs;
+    if (GpuTimer::read(device, i, gpuMs)) {
+      HeadlessRenderer::recordGpu(gpuMs);
+    }
+  }
+  HeadlessRenderer::logStats();
+}
+
+/**
+ * 读回最后一帧并检查保存的PPM图像为最后一帧的清除颜色
+ */
+static bool saveLastFrame() {
+  int last = HeadlessRenderer::frameCount - 1;
+  if (!HeadlessRenderer::saveImage(device, queue, cmdBuffers[0], images[last % images.size()],
+                                   HeadlessRenderer::outputPath)) {
+    return false;
+  }
+  FILE *file = fopen(HeadlessRenderer::outputPath.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  unsigned int w = 0, h = 0, maxValue = 0;
+  bool ok = fscanf(file, "P6 %u %u %u", &w, &h, &maxValue) == 3 && fgetc(file) == '\n' &&
+      w == HeadlessRenderer::width && h == HeadlessRenderer::height && maxValue == 255;
+  VkClearColorValue color = clearColorOf(last);
+  std::vector<unsigned char> rgb((size_t) w * h * 3);
+  ok = ok && fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+  fclose(file);
+  for (size_t i = 0; ok && i < rgb.size(); ++i) {                         // UNORM量化误差不超过1
+    int expected = (int) (color.float32[i % 3] * 255.0f + 0.5f);
+    ok = abs(rgb[i] - expected) <= 1;
+  }
+  if (!ok) {
+    LOGE("HeadlessDesktop: %s does not contain the last clear color", HeadlessRenderer::outputPath.c_str());
+  }
+  return ok;
+}
+
+static void destroyAll() {
+  for (int i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+    vk::vkDestroyFence(device, fences[i], nullptr);
+  }
+  vk::vkDestroyCommandPool(device, commandPool, nullptr);
+  for (size_t i = 0; i < framebuffers.size(); ++i) {
+    vk::vkDestroyFramebuffer(device, framebuffers[i], nullptr);
+  }
+  vk::vkDestroyRenderPass(device, renderPass, nullptr);
+  HeadlessRenderer::destroyTargets(device, images, views);
+  GpuTimer::destroy(device);
+  DeviceMemoryAllocator::destroy(device);
+  ResourceStateTracker::reset();
+  vk::vkDestroyDevice(device, nullptr);
+  vk::vkDestroyInstance(instance, nullptr);
+}
+
+int main(int argc, char **argv) {
+  HeadlessRenderer::enabled = true;
+  HeadlessRenderer::frameCount = 120;                                     // 软件实现较慢, 默认帧数少于应用
+  if (!parseArguments(argc, argv)) {
+    fprintf(stderr, "usage: %s [--frames N] [--size WxH] [--output path.ppm]\n", argv[0]);
+    return 2;
+  }
+  if (!createDevice()) {
+    return 1;
+  }
+  createTargets();
+  drawFrames();
+  bool ok = !HeadlessRenderer::readback || saveLastFrame();
+  destroyAll();
+  if (ok && GpuTimer::supported && HeadlessRenderer::gpuMs.size() != (size_t) HeadlessRenderer::frameCount) {
+    LOGE("HeadlessDesktop: %d GPU timings for %d frames", (int) HeadlessRenderer::gpuMs.size(),
+         HeadlessRenderer::frameCount);
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
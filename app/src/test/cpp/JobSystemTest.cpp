@@ -0,0 +1,161 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "JobSystem.h"
+#include "TestUtil.h"
+
+/**
+ * 并行循环: [0, count)中每个下标恰好处理一次, 各段不少于grain个元素(最后的段除外)
+ */
+static void checkParallelFor(uint32_t count, uint32_t grain) {
+  std::vector<std::atomic<int> > hits(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    hits[i] = 0;
+  }
+  std::atomic<uint32_t> ranges(0);
+  JobSystem::parallelFor(count, grain, [&](uint32_t begin, uint32_t end) {
+    CHECK(begin < end && end <= count);
+    CHECK(end - begin <= std::max(1u, grain) || end - begin == count);
+    for (uint32_t i = begin; i < end; ++i) {
+      hits[i]++;
+    }
+    ranges++;
+  });
+  for (uint32_t i = 0; i < count; ++i) {
+    CHECK(hits[i] == 1);
+  }
+  CHECK(count == 0 || ranges >= (count + std::max(1u, grain) - 1) / std::max(1u, grain));
+}
+
+/**
+ * 未初始化时run在调用线程中直接执行
+ */
+static void testInactive() {
+  CHECK(!JobSystem::active());
+  JobCounter counter;
+  bool ran = false;
+  JobSystem::run([&ran] { ran = true; }, &counter);
+  CHECK(ran && counter.done());
+  JobSystem::wait(&counter);
+  checkParallelFor(1000, 64);
+}
+
+/**
+ * 工作窃取: 主线程队列中的作业被其他工作线程窃取执行
+ */
+static void testWorkStealing() {
+  long long stolenBefore = JobSystem::stolenJobs;
+  std::mutex idMutex;
+  std::set<std::thread::id> threads;
+  JobCounter counter;
+  for (int i = 0; i < 64; ++i) {                                          // 全部压入主线程自己的队列
+    JobSystem::run([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      std::lock_guard<std::mutex> lock(idMutex);
+      threads.insert(std::this_thread::get_id());
+    }, &counter);
+  }
+  JobSystem::wait(&counter);                                              // 主线程等待时也执行作业
+  CHECK(counter.done());
+  CHECK(threads.size() > 1);
+  CHECK(JobSystem::stolenJobs > stolenBefore);
+}
+
+/**
+ * 计数器与后续作业: 后续作业在依赖的计数器归0后才执行, 作业中提交的子作业计入同一计数器
+ */
+static void testCountersAndContinuations() {
+  JobCounter first;
+  JobCounter second;
+  std::atomic<int> firstDone(0);
+  std::atomic<int> seenByContinuation(-1);
+  std::atomic<int> children(0);
+  for (int i = 0; i < 16; ++i) {
+    JobSystem::run([&] {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      for (int c = 0; c < 4; ++c) {                                       // 子作业在父作业完成前提交, 计数器不会提前归0
+        JobSystem::run([&] { children++; }, &first);
+      }
+      firstDone++;
+    }, &first);
+  }
+  JobSystem::run([&] { seenByContinuation = children + firstDone; }, &second, &first);
+  CHECK(!second.done());
+  JobSystem::wait(&second);
+  CHECK(first.done());
+  CHECK(seenByContinuation == 16 + 64);                                   // 后续作业看到全部完成的结果
+
+  JobCounter already;                                                     // 依赖已归0时直接进入队列
+  std::atomic<bool> ran(false);
+  JobSystem::run([&ran] { ran = true; }, &already, &first);
+  JobSystem::wait(&already);
+  CHECK(ran);
+
+  // 链式依赖: a -> b -> c, a在依赖全部挂好之后才允许完成
+  JobCounter a;
+  JobCounter b;
+  JobCounter c;
+  std::vector<int> order;
+  std::mutex orderMutex;
+  std::atomic<bool> release(false);
+  JobSystem::run([&] {
+    while (!release) {
+      std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(orderMutex);
+    order.push_back(1);
+  }, &a);
+  JobSystem::run([&] { std::lock_guard<std::mutex> lock(orderMutex); order.push_back(2); }, &b, &a);
+  JobSystem::run([&] { std::lock_guard<std::mutex> lock(orderMutex); order.push_back(3); }, &c, &b);
+  CHECK(!b.done() && !c.done());
+  release = true;
+  JobSystem::wait(&c);
+  CHECK(order.size() == 3 && order[0] == 1 && order[1] == 2 && order[2] == 3);
+}
+
+/**
+ * 只能在主线程中执行的作业: 由工作线程提交, 在主线程等待时或runMainThreadJobs中执行
+ */
+static void testMainThreadJobs() {
+  JobCounter counter;
+  std::atomic<int> onMain(0);
+  std::atomic<int> offMain(0);
+  for (int i = 0; i < 8; ++i) {
+    JobSystem::run([&] {
+      JobSystem::run([&] { (JobSystem::isMainThread() ? onMain : offMain)++; }, &counter, nullptr, true);
+    }, &counter);
+  }
+  JobSystem::wait(&counter);
+  CHECK(onMain == 8 && offMain == 0);
+
+  JobCounter later;
+  JobSystem::run([&] { (JobSystem::isMainThread() ? onMain : offMain)++; }, &later, nullptr, true);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  CHECK(!later.done());                                                   // 工作线程不会执行
+  JobSystem::runMainThreadJobs();
+  CHECK(later.done() && onMain == 9);
+}
+
+int main() {
+  testInactive();
+  JobSystem::init(4);
+  CHECK(JobSystem::active() && JobSystem::isMainThread() && JobSystem::workerCount == 4);
+  testWorkStealing();
+  testCountersAndContinuations();
+  testMainThreadJobs();
+  checkParallelFor(0, 16);
+  checkParallelFor(10, 64);                                               // 少于一段
+  checkParallelFor(100003, 64);
+  checkParallelFor(4096, 0);                                              // grain为0时按1处理
+  JobSystem::logStats();
+  JobSystem::shutdown();
+  CHECK(!JobSystem::active());
+  JobSystem::init(2);                                                     // 停止后可以重新启动
+  checkParallelFor(50000, 100);
+  JobSystem::shutdown();
+  printf("JobSystemTest passed\n");
+  return 0;
+}
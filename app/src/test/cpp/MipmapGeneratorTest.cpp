@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "MipmapGenerator.h"
+#include "TestUtil.h"
+
+static double srgbToLinear(int v) {
+  double c = v / 255.0;
+  return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double linearToSrgb(double l) {
+  l = l < 0 ? 0 : (l > 1 ? 1 : l);
+  return (l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055) * 255.0;
+}
+
+/**
+ * 标量参考实现: 以双精度逐像素计算盒式过滤, 每个目标像素为其覆盖的源像素区域按面积加权的平均
+ */
+static void referenceBox(const std::vector<double> &src, int srcW, int srcH, std::vector<double> &dst,
+                         int dstW, int dstH) {
+  double scaleX = (double) srcW / dstW;
+  double scaleY = (double) srcH / dstH;
+  dst.assign((size_t) dstW * dstH * 4, 0.0);
+  for (int y = 0; y < dstH; ++y) {
+    for (int x = 0; x < dstW; ++x) {
+      double x0 = x * scaleX, x1 = x0 + scaleX;
+      double y0 = y * scaleY, y1 = y0 + scaleY;
+      for (int sy = (int) y0; sy < srcH && sy < y1; ++sy) {
+        double wy = std::min(sy + 1.0, y1) - std::max((double) sy, y0);
+        for (int sx = (int) x0; sx < srcW && sx < x1; ++sx) {
+          double w = (std::min(sx + 1.0, x1) - std::max((double) sx, x0)) * wy / (scaleX * scaleY);
+          for (int c = 0; c < 4; ++c) {
+            dst[((size_t) y * dstW + x) * 4 + c] += src[((size_t) sy * srcW + sx) * 4 + c] * w;
+          }
+        }
+      }
+    }
+  }
+}
+
+static TexDataObject *makeImage(int width, int height, unsigned int seed) {
+  int byteCount = width * height * 4;
+  unsigned char *data = new unsigned char[byteCount];
+  for (int i = 0; i < byteCount; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    data[i] = (unsigned char) (seed >> 16);
+  }
+  return new TexDataObject(width, height, data, byteCount);
+}
+
+static int levelWidth(int width, int level) {
+  return std::max(1, width >> level);
+}
+
+/**
+ * SIMD路径与标量参考一致: 偶数尺寸(2x2快速路径)与奇数尺寸(可分离重采样)的各级误差不超过1,
+ * 多线程与单线程的结果逐字节相同
+ */
+static void testSimdMatchesScalar() {
+  const int sizes[][2] = {{64, 32}, {37, 23}, {1, 9}};
+  for (int s = 0; s < 3; ++s) {
+    for (int srgb = 0; srgb < 2; ++srgb) {
+      int width = sizes[s][0];
+      int height = sizes[s][1];
+      TexDataObject *base = makeImage(width, height, 7 + s);
+      MipmapOptions options;
+      options.srgb = srgb != 0;
+      options.threadCount = 1;
+      int levels = MipmapGenerator::getLevelCount(width, height);
+      std::vector<int> offsets;
+      TexDataObject *chain = MipmapGenerator::generate(base, levels, offsets, options);
+      CHECK((int) offsets.size() == levels && memcmp(chain->data, base->data, (size_t) width * height * 4) == 0);
+
+      std::vector<double> current((size_t) width * height * 4);
+      for (int i = 0; i < width * height * 4; ++i) {
+        current[i] = (options.srgb && i % 4 != 3) ? srgbToLinear(base->data[i]) : base->data[i] / 255.0;
+      }
+      int srcW = width, srcH = height;
+      for (int level = 1; level < levels; ++level) {
+        int dstW = levelWidth(width, level), dstH = levelWidth(height, level);
+        std::vector<double> next;
+        referenceBox(current, srcW, srcH, next, dstW, dstH);
+        const unsigned char *out = chain->data + offsets[level];
+        for (int i = 0; i < dstW * dstH * 4; ++i) {
+          double expected = (options.srgb && i % 4 != 3) ? linearToSrgb(next[i]) : next[i] * 255.0;
+          CHECK(fabs(out[i] - expected) <= 1.0);
+        }
+        current.swap(next);
+        srcW = dstW;
+        srcH = dstH;
+      }
+
+      options.threadCount = 4;                                            // 按行拆分不改变结果
+      std::vector<int> threadedOffsets;
+      TexDataObject *threaded = MipmapGenerator::generate(base, levels, threadedOffsets, options);
+      CHECK(threadedOffsets == offsets && memcmp(threaded->data, chain->data, chain->dataByteCount) == 0);
+      delete threaded;
+      delete chain;
+      delete base;
+    }
+  }
+}
+
+/**
+ * sRGB往返: 各2x2块颜色相同时, 解码到线性空间平均再编码得到原值;
+ * 黑白相间时在线性空间平均(得到188), 而非sRGB数据直接平均(得到128)
+ */
+static void testSrgbRoundTrip() {
+  const int width = 64, height = 32;                                      // 32*16个2x2块, 覆盖0到255
+  unsigned char *data = new unsigned char[width * height * 4];
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      int v = ((y / 2) * (width / 2) + x / 2) % 256;
+      unsigned char *p = data + (y * width + x) * 4;
+      p[0] = (unsigned char) v;
+      p[1] = (unsigned char) (255 - v);
+      p[2] = (unsigned char) (v * 7);
+      p[3] = (unsigned char) v;
+    }
+  }
+  TexDataObject base(width, height, data, width * height * 4);
+  MipmapOptions options;
+  std::vector<int> offsets;
+  TexDataObject *chain = MipmapGenerator::generate(&base, 2, offsets, options);
+  const unsigned char *level1 = chain->data + offsets[1];
+  for (int y = 0; y < height / 2; ++y) {
+    for (int x = 0; x < width / 2; ++x) {
+      CHECK(memcmp(level1 + (y * width / 2 + x) * 4, data + (2 * y * width + 2 * x) * 4, 4) == 0);
+    }
+  }
+  delete chain;
+
+  unsigned char checker[4 * 4] = {0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 255};
+  unsigned char *checkerData = new unsigned char[sizeof(checker)];
+  memcpy(checkerData, checker, sizeof(checker));
+  TexDataObject checkerBase(2, 2, checkerData, sizeof(checker));
+  chain = MipmapGenerator::generate(&checkerBase, 2, offsets, options);
+  CHECK(chain->data[offsets[1]] == (int) (linearToSrgb(0.5) + 0.5) && chain->data[offsets[1]] == 188);
+  CHECK(chain->data[offsets[1] + 3] == 255);
+  delete chain;
+  options.srgb = false;
+  chain = MipmapGenerator::generate(&checkerBase, 2, offsets, options);
+  CHECK(chain->data[offsets[1]] == 128);
+  delete chain;
+}
+
+static float coverage(const unsigned char *pixels, int pixelCount, float cutoff) {
+  int covered = 0;
+  for (int i = 0; i < pixelCount; ++i) {
+    if (pixels[i * 4 + 3] / 255.0f > cutoff) {
+      covered++;
+    }
+  }
+  return (float) covered / pixelCount;
+}
+
+/**
+ * alpha覆盖率: 稀疏的不透明像素(镂空纹理的枝叶)在各级中保持第0级的覆盖率(误差在一个像素或5%以内),
+ * 不保持时覆盖率随级数迅速下降; 颜色通道不受影响
+ */
+static void testAlphaCoverage() {
+  const int size = 128;
+  const float cutoff = 0.5f;
+  unsigned char *data = new unsigned char[size * size * 4];
+  unsigned int seed = 99;
+  for (int i = 0; i < size * size; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    int x = i % size, y = i / size;
+    float smooth = 0.5f + 0.5f * sinf(x * 0.15f) * cosf(y * 0.11f);      // 低频的形状与高频的稀疏细节
+    data[i * 4 + 0] = (unsigned char) x;
+    data[i * 4 + 1] = (unsigned char) y;
+    data[i * 4 + 2] = 128;
+    data[i * 4 + 3] = ((seed >> 16) % 100) < (unsigned) (smooth * 40) ? 255 : 0;
+  }
+  TexDataObject base(size, size, data, size * size * 4);
+  float baseCoverage = coverage(data, size * size, cutoff);
+  CHECK(baseCoverage > 0.1f && baseCoverage < 0.3f);
+
+  MipmapOptions options;
+  options.alphaCutoff = cutoff;
+  int levels = MipmapGenerator::getLevelCount(size, size);
+  std::vector<int> offsets;
+  TexDataObject *kept = MipmapGenerator::generate(&base, levels, offsets, options);
+  options.alphaCutoff = 0;
+  std::vector<int> plainOffsets;
+  TexDataObject *plain = MipmapGenerator::generate(&base, levels, plainOffsets, options);
+  for (int level = 1; level < levels - 2; ++level) {                      // 最后两级像素太少, 覆盖率无法逼近
+    int pixels = levelWidth(size, level) * levelWidth(size, level);
+    float keptCoverage = coverage(kept->data + offsets[level], pixels, cutoff);
+    float plainCoverage = coverage(plain->data + offsets[level], pixels, cutoff);
+    CHECK(fabsf(keptCoverage - baseCoverage) <= std::max(0.05f, 1.0f / pixels));
+    CHECK(level < 2 || plainCoverage < baseCoverage * 0.5f);
+    for (int i = 0; i < pixels; ++i) {
+      CHECK(memcmp(kept->data + offsets[level] + i * 4, plain->data + offsets[level] + i * 4, 3) == 0);
+    }
+  }
+  delete plain;
+  delete kept;
+}
+
+/**
+ * Kaiser与Lanczos过滤器的权重归一化: 纯色纹理的各级仍为该颜色
+ */
+static void testWindowedFiltersKeepConstant() {
+  const MipmapFilter filters[] = {MIPMAP_FILTER_KAISER, MIPMAP_FILTER_LANCZOS};
+  for (int f = 0; f < 2; ++f) {
+    const int width = 40, height = 24;
+    unsigned char *data = new unsigned char[width * height * 4];
+    for (int i = 0; i < width * height; ++i) {
+      data[i * 4 + 0] = 200;
+      data[i * 4 + 1] = 30;
+      data[i * 4 + 2] = 90;
+      data[i * 4 + 3] = 160;
+    }
+    TexDataObject base(width, height, data, width * height * 4);
+    MipmapOptions options;
+    options.filter = filters[f];
+    std::vector<int> offsets;
+    TexDataObject *chain = MipmapGenerator::generate(&base, 4, offsets, options);
+    CHECK(offsets.size() == 4);
+    for (int i = 0; i < chain->dataByteCount; i += 4) {
+      CHECK(abs(chain->data[i] - 200) <= 1 && abs(chain->data[i + 1] - 30) <= 1);
+      CHECK(abs(chain->data[i + 2] - 90) <= 1 && abs(chain->data[i + 3] - 160) <= 1);
+    }
+    delete chain;
+  }
+}
+
+int main() {
+  testSimdMatchesScalar();
+  testSrgbRoundTrip();
+  testAlphaCoverage();
+  testWindowedFiltersKeepConstant();
+  printf("MipmapGeneratorTest passed\n");
+  return 0;
+}
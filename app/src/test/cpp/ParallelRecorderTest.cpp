@@ -0,0 +1,145 @@
+#include <atomic>
+#include <cmath>
+#include <set>
+#include <vector>
+#include "ParallelRecorder.h"
+#include "JobSystem.h"
+#include "MatrixState3D.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+#define FRAME_COUNT 2                                                     // 帧区域数
+#define THREAD_COUNT 4                                                    // 作业系统线程数
+
+static VkDevice device = (VkDevice) 0x1;
+static VkRenderPass renderPass = (VkRenderPass) 0x2;
+static VkFramebuffer framebuffer = (VkFramebuffer) 0x3;
+static std::atomic<int> wrongMatrix(0);                                  // 起点不是调用线程矩阵的段数
+
+/**
+ * 每个物体录制一次绘制(首顶点为物体下标), 并检查本段的基本变换矩阵以调用线程的平移(1, 2, 3)为起点;
+ * 录制后改动当前线程的矩阵, 下次录制须重新从调用线程的矩阵开始
+ */
+static RecordTask drawItems = [](VkCommandBuffer &cmd, uint32_t begin, uint32_t end) {
+  float *m = MatrixState3D::getMMatrix();
+  if (std::fabs(m[12] - 1) > 1e-6f || std::fabs(m[13] - 2) > 1e-6f || std::fabs(m[14] - 3) > 1e-6f) {
+    wrongMatrix++;
+  }
+  for (uint32_t i = begin; i < end; ++i) {
+    vk::vkCmdDraw(cmd, 3, 1, i, 0);
+  }
+  MatrixState3D::translate(10, 0, 0);
+};
+
+static VkCommandBuffer createPrimary(VkCommandPool &pool) {
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  vk::vkCreateCommandPool(device, &poolInfo, nullptr, &pool);
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = pool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkCommandBuffer primary;
+  vk::vkAllocateCommandBuffers(device, &allocInfo, &primary);
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  vk::vkBeginCommandBuffer(primary, &beginInfo);
+  return primary;
+}
+
+/**
+ * 录制一帧并返回执行的二级命令缓冲: 主命令缓冲中只有一条执行命令, 各段按顺序覆盖[0, itemCount)且互不重叠,
+ * 二级命令缓冲继承渲染通道与帧缓冲, 调用线程的当前矩阵不变
+ */
+static std::vector<VkCommandBuffer> recordFrame(VkCommandBuffer primary, int frame, uint32_t itemCount,
+                                                int threads, size_t expectedChunks) {
+  FakeVulkan::commands.clear();
+  int poolResets = FakeVulkan::poolResets;
+  ParallelRecorder::record(primary, frame, renderPass, framebuffer, itemCount, drawItems, threads);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_EXECUTE_COMMANDS, primary) == 1);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_EXECUTE_COMMANDS) == 1);
+  std::vector<VkCommandBuffer> secondaries;
+  for (size_t i = 0; i < FakeVulkan::commands.size(); ++i) {
+    if (FakeVulkan::commands[i].type == FAKE_CMD_EXECUTE_COMMANDS) {
+      secondaries = FakeVulkan::commands[i].secondaries;
+    }
+  }
+  CHECK(secondaries.size() == expectedChunks);
+  CHECK(FakeVulkan::poolResets == poolResets + (int) expectedChunks);    // 每段录制前重置自己的命令池
+
+  uint32_t next = 0;
+  for (size_t s = 0; s < secondaries.size(); ++s) {
+    const FakeCommandBuffer &fake = FakeVulkan::commandBuffers[secondaries[s]];
+    CHECK(fake.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY && !fake.recording);
+    CHECK(fake.inheritedRenderPass == renderPass && fake.inheritedFramebuffer == framebuffer);
+    CHECK((fake.flags & VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT) != 0);
+    std::vector<uint32_t> firsts;
+    for (size_t i = 0; i < FakeVulkan::commands.size(); ++i) {
+      if (FakeVulkan::commands[i].type == FAKE_CMD_DRAW && FakeVulkan::commands[i].cmd == secondaries[s]) {
+        firsts.push_back(FakeVulkan::commands[i].first);
+      }
+    }
+    CHECK(!firsts.empty() && firsts.front() == next);                     // 各段按物体顺序相接
+    for (size_t i = 0; i < firsts.size(); ++i) {
+      CHECK(firsts[i] == next + i);
+    }
+    next += (uint32_t) firsts.size();
+  }
+  CHECK(next == itemCount);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_DRAW) == (int) itemCount);
+  CHECK(wrongMatrix == 0);
+  CHECK(MatrixState3D::getMMatrix()[12] == 1);                            // 调用线程录制过的段不改变其矩阵
+  return secondaries;
+}
+
+/**
+ * 分段录制: 各帧区域使用各自的二级命令缓冲, 同一帧区域再次录制时重用并重新开始录制;
+ * 段数不超过创建时的线程数, 自动选择时每段至少PARALLEL_RECORDER_MIN_ITEMS个物体
+ */
+static void testRecordChunks() {
+  FakeVulkan::reset();
+  JobSystem::init(THREAD_COUNT);
+  CHECK(JobSystem::workerCount == THREAD_COUNT);
+  ParallelRecorder::create(device, 0, FRAME_COUNT);
+  CHECK(ParallelRecorder::active() && ParallelRecorder::threadCount == THREAD_COUNT);
+  CHECK(FakeVulkan::commandPools.size() == FRAME_COUNT * THREAD_COUNT);
+  CHECK(FakeVulkan::commandBuffers.size() == FRAME_COUNT * THREAD_COUNT);
+  VkCommandPool primaryPool;
+  VkCommandBuffer primary = createPrimary(primaryPool);
+  MatrixState3D::setInitStack();
+  MatrixState3D::translate(1, 2, 3);
+
+  std::vector<VkCommandBuffer> frame0 = recordFrame(primary, 0, 1000, THREAD_COUNT, THREAD_COUNT);
+  std::vector<VkCommandBuffer> frame1 = recordFrame(primary, 1, 1000, THREAD_COUNT, THREAD_COUNT);
+  std::set<VkCommandBuffer> all(frame0.begin(), frame0.end());
+  all.insert(frame1.begin(), frame1.end());
+  CHECK(all.size() == 2 * THREAD_COUNT);                                  // 在途帧的二级命令缓冲不被改写
+
+  std::vector<VkCommandBuffer> again = recordFrame(primary, 0, 1000, THREAD_COUNT, THREAD_COUNT);
+  CHECK(again == frame0);
+  for (size_t i = 0; i < again.size(); ++i) {
+    CHECK(FakeVulkan::commandBuffers[again[i]].beginCount == 2);
+  }
+
+  recordFrame(primary, 1, 1000, 0, 1000 / PARALLEL_RECORDER_MIN_ITEMS);   // 自动选择段数
+  recordFrame(primary, 1, 300, 0, 1);                                     // 不足两段的物体在一个二级命令缓冲中录制
+  recordFrame(primary, 0, 2 * PARALLEL_RECORDER_MIN_ITEMS, 0, 2);
+  recordFrame(primary, 0, 100 * PARALLEL_RECORDER_MIN_ITEMS, 0, THREAD_COUNT);
+  recordFrame(primary, 0, 1000, 2 * THREAD_COUNT, THREAD_COUNT);          // 指定的段数超过线程数时截断
+  CHECK(ParallelRecorder::recordedFrames == 8);
+  CHECK(ParallelRecorder::recordedItems == 4000 + 300 + 102 * PARALLEL_RECORDER_MIN_ITEMS + 1000);
+
+  ParallelRecorder::destroy(device);
+  vk::vkDestroyCommandPool(device, primaryPool, nullptr);
+  CHECK(!ParallelRecorder::active());
+  CHECK(FakeVulkan::commandPools.empty() && FakeVulkan::commandBuffers.empty());
+  JobSystem::shutdown();
+}
+
+int main() {
+  FakeVulkan::install();
+  testRecordChunks();
+  printf("ParallelRecorderTest passed\n");
+  return 0;
+}
@@ -0,0 +1,248 @@
+#include <vector>
+#include "RenderGraph.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+static VkDevice device = (VkDevice) 0x1;
+static VkCommandBuffer cmd = reinterpret_cast<VkCommandBuffer>(0x2);
+static int drawCalls = 0;                                     // 通道录制函数的调用次数
+
+static void recordDraw(VkCommandBuffer &) {
+  drawCalls++;
+}
+
+static const VkClearColorValue clearColor = {{0.0f, 0.0f, 0.0f, 1.0f}};
+static const VkClearDepthStencilValue clearDepth = {1.0f, 0};
+
+/**
+ * 测试场景中声明的资源与通道
+ */
+struct TestGraph {
+  RGResource swapchain;
+  RGResource gbuffer;
+  RGResource depth0;
+  RGResource depth1;
+  RGResource debug;
+  RGPass geometry;
+  RGPass debugPass;
+  RGPass light;
+};
+
+/**
+ * 几何通道清除并写入gbuffer与depth0; 调试通道采样gbuffer写入debug(没有通道使用, 应被剔除);
+ * 光照通道采样gbuffer, 保留交换链图像之前的内容写入并清除depth1
+ */
+static TestGraph declareGraph() {
+  TestGraph g;
+  g.swapchain = RenderGraph::importImage("swapchain", VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT,
+                                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, RESOURCE_USAGE_PRESENT);
+  g.gbuffer = RenderGraph::createImage("gbuffer", VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+  g.depth0 = RenderGraph::createImage("depth0", VK_FORMAT_D16_UNORM, VK_IMAGE_ASPECT_DEPTH_BIT);
+  g.depth1 = RenderGraph::createImage("depth1", VK_FORMAT_D16_UNORM, VK_IMAGE_ASPECT_DEPTH_BIT);
+  g.debug = RenderGraph::createImage("debug", VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+  g.geometry = RenderGraph::addPass("geometry", recordDraw);
+  RenderGraph::writeColor(g.geometry, g.gbuffer, &clearColor);
+  RenderGraph::writeDepth(g.geometry, g.depth0, &clearDepth);
+  g.debugPass = RenderGraph::addPass("debug", recordDraw);
+  RenderGraph::sample(g.debugPass, g.gbuffer);
+  RenderGraph::writeColor(g.debugPass, g.debug, &clearColor);
+  g.light = RenderGraph::addPass("light", recordDraw);
+  RenderGraph::sample(g.light, g.gbuffer);
+  RenderGraph::writeColor(g.light, g.swapchain);
+  RenderGraph::writeDepth(g.light, g.depth1, &clearDepth);
+  return g;
+}
+
+static std::vector<VkImage> swapchainImages() {
+  std::vector<VkImage> images;
+  images.push_back((VkImage) 0x10);
+  images.push_back((VkImage) 0x11);
+  return images;
+}
+
+static std::vector<VkImageView> swapchainViews() {
+  std::vector<VkImageView> views;
+  views.push_back((VkImageView) 0x20);
+  views.push_back((VkImageView) 0x21);
+  return views;
+}
+
+/**
+ * 按用途找出渲染图创建的图像
+ */
+static std::vector<VkImage> imagesWithUsage(VkImageUsageFlags usage) {
+  std::vector<VkImage> result;
+  for (std::map<VkImage, FakeImage>::iterator it = FakeVulkan::images.begin(); it != FakeVulkan::images.end(); ++it) {
+    if ((it->second.info.usage & usage) != 0) {
+      result.push_back(it->first);
+    }
+  }
+  return result;
+}
+
+static const VkImageMemoryBarrier *findBarrier(const FakeCommand &command, VkImage image) {
+  for (size_t i = 0; i < command.imageBarriers.size(); ++i) {
+    if (command.imageBarriers[i].image == image) {
+      return &command.imageBarriers[i];
+    }
+  }
+  return nullptr;
+}
+
+static std::vector<FakeCommand> barrierCommands() {
+  std::vector<FakeCommand> result;
+  for (size_t i = 0; i < FakeVulkan::commands.size(); ++i) {
+    if (FakeVulkan::commands[i].type == FAKE_CMD_PIPELINE_BARRIER) {
+      result.push_back(FakeVulkan::commands[i]);
+    }
+  }
+  return result;
+}
+
+/**
+ * 编译: 输出没有被使用的通道被剔除; 清除的附件LOAD_OP_CLEAR, 之前没有通道写入的附件DONT_CARE;
+ * 之后被采样的附件与外部资源STORE, 之后不再使用的深度附件DONT_CARE
+ */
+static void testCullingAndAttachmentOps() {
+  FakeVulkan::reset();
+  TestGraph g = declareGraph();
+  RenderGraph::compile(device);
+  CHECK(FakeVulkan::renderPasses.size() == 2);                            // 调试通道被剔除
+  CHECK(RenderGraph::renderPassOf(g.debugPass) == VK_NULL_HANDLE);
+
+  const FakeRenderPass &geometry = FakeVulkan::renderPasses[RenderGraph::renderPassOf(g.geometry)];
+  CHECK(geometry.attachments.size() == 2 && geometry.colorCount == 1 && geometry.depth);
+  CHECK(geometry.attachments[0].loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR);   // gbuffer之后被光照通道采样
+  CHECK(geometry.attachments[0].storeOp == VK_ATTACHMENT_STORE_OP_STORE);
+  CHECK(geometry.attachments[1].loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR);   // depth0之后不再使用
+  CHECK(geometry.attachments[1].storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+  const FakeRenderPass &light = FakeVulkan::renderPasses[RenderGraph::renderPassOf(g.light)];
+  CHECK(light.attachments.size() == 2 && light.colorCount == 1 && light.depth);
+  CHECK(light.attachments[0].loadOp == VK_ATTACHMENT_LOAD_OP_DONT_CARE);  // 交换链图像之前没有通道写入
+  CHECK(light.attachments[0].storeOp == VK_ATTACHMENT_STORE_OP_STORE);    // 外部资源须写回
+  CHECK(light.attachments[0].finalLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+  CHECK(light.attachments[1].loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR);
+  CHECK(light.attachments[1].storeOp == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+  RenderGraph::destroy(device);
+  CHECK(FakeVulkan::renderPasses.empty());
+}
+
+/**
+ * 创建目标: 被剔除通道的附件不创建; 生命期不重叠的两个瞬时深度附件共用同一内存与偏移量,
+ * 以TRANSIENT用途创建在惰性分配的内存中; 之后被采样的gbuffer不是瞬时附件
+ */
+static void testTransientAliasing() {
+  FakeVulkan::reset();
+  FakeVulkan::imageRequirements.size = 1 << 20;
+  FakeVulkan::imageRequirements.alignment = 256;
+  FakeVulkan::imageRequirements.memoryTypeBits = 0x5;                     // 设备本地与惰性分配
+  DeviceMemoryAllocator::init(FakeVulkan::memoryProperties, 1024, 64);
+  TestGraph g = declareGraph();
+  RenderGraph::compile(device);
+  RenderGraph::setImportedImages(g.swapchain, swapchainImages(), swapchainViews());
+  RenderGraph::createTargets(device, FakeVulkan::memoryProperties, 640, 480);
+  CHECK(FakeVulkan::images.size() == 3);                                  // gbuffer与两个深度附件
+  CHECK(FakeVulkan::framebuffers.size() == 4);                            // 两个通道各有每个交换链图像的帧缓冲
+  CHECK(RenderGraph::framebufferOf(g.geometry) != RenderGraph::framebufferOf(g.light));
+
+  std::vector<VkImage> depths = imagesWithUsage(VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+  CHECK(depths.size() == 2);
+  const FakeImage &d0 = FakeVulkan::images[depths[0]];
+  const FakeImage &d1 = FakeVulkan::images[depths[1]];
+  CHECK(d0.memory != VK_NULL_HANDLE && d0.memory == d1.memory && d0.offset == d1.offset);
+  CHECK((d0.info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0);
+  CHECK((d1.info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0);
+  CHECK(FakeVulkan::memories[d0.memory].typeIndex == 2);
+
+  std::vector<VkImage> sampled = imagesWithUsage(VK_IMAGE_USAGE_SAMPLED_BIT);
+  CHECK(sampled.size() == 1);
+  const FakeImage &gbuffer = FakeVulkan::images[sampled[0]];
+  CHECK((gbuffer.info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) == 0);
+  CHECK(gbuffer.memory != d0.memory || gbuffer.offset != d0.offset);
+  CHECK(gbuffer.info.extent.width == 640 && gbuffer.info.extent.height == 480);
+  CHECK(RenderGraph::transientBytes == (2 << 20) && RenderGraph::unaliasedBytes == (3 << 20));
+  CHECK(RenderGraph::lazyResources == 2);
+
+  RenderGraph::destroy(device);
+  CHECK(FakeVulkan::images.empty() && FakeVulkan::framebuffers.empty() && FakeVulkan::imageViews.empty());
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(FakeVulkan::memories.empty());
+}
+
+/**
+ * 执行: 每个通道之前一次合并的屏障; gbuffer在光照通道前转为采样布局, 交换链图像从UNDEFINED转为颜色附件,
+ * 共用内存的depth1等待depth0; endPass之后交换链图像转为PRESENT_SRC
+ */
+static void testExecuteAndFinalUsage() {
+  FakeVulkan::reset();
+  DeviceMemoryAllocator::init(FakeVulkan::memoryProperties, 1024, 64);
+  TestGraph g = declareGraph();
+  RenderGraph::compile(device);
+  std::vector<VkImage> swapchain = swapchainImages();
+  RenderGraph::setImportedImages(g.swapchain, swapchain, swapchainViews());
+  RenderGraph::createTargets(device, FakeVulkan::memoryProperties, 640, 480);
+  VkImage gbuffer = imagesWithUsage(VK_IMAGE_USAGE_SAMPLED_BIT)[0];
+
+  for (uint32_t frame = 0; frame < 2; ++frame) {
+    FakeVulkan::commands.clear();
+    drawCalls = 0;
+    RenderGraph::beginFrame(frame);
+    RenderGraph::execute(cmd);
+    CHECK(drawCalls == 2);                                                // 调试通道不录制
+    const FakeCommandType expected[] = {
+        FAKE_CMD_PIPELINE_BARRIER, FAKE_CMD_BEGIN_RENDER_PASS, FAKE_CMD_END_RENDER_PASS,
+        FAKE_CMD_PIPELINE_BARRIER, FAKE_CMD_BEGIN_RENDER_PASS, FAKE_CMD_END_RENDER_PASS,
+        FAKE_CMD_PIPELINE_BARRIER};
+    CHECK(FakeVulkan::commands.size() == sizeof(expected) / sizeof(expected[0]));
+    for (size_t i = 0; i < FakeVulkan::commands.size(); ++i) {
+      CHECK(FakeVulkan::commands[i].type == expected[i]);
+    }
+    CHECK(FakeVulkan::commands[4].renderPass == RenderGraph::renderPassOf(g.light));
+    CHECK(FakeVulkan::commands[4].framebuffer == RenderGraph::framebufferOf(g.light));
+
+    std::vector<FakeCommand> barriers = barrierCommands();
+    const FakeCommand &beforeLight = barriers[1];
+    CHECK(beforeLight.imageBarriers.size() == 3);                         // gbuffer、交换链图像与depth1
+    const VkImageMemoryBarrier *b = findBarrier(beforeLight, gbuffer);
+    CHECK(b != nullptr && b->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK(b->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    b = findBarrier(beforeLight, swapchain[frame]);
+    CHECK(b != nullptr && b->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    CHECK(b->newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK((beforeLight.srcStages & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT) != 0);
+    CHECK((beforeLight.dstStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) != 0);
+
+    const FakeCommand &present = barriers[2];                             // endPass: 转为呈现布局
+    CHECK(present.imageBarriers.size() == 1 && present.imageBarriers[0].image == swapchain[frame]);
+    CHECK(present.imageBarriers[0].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    CHECK(present.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    CHECK(present.imageBarriers[0].dstAccessMask == 0);
+    CHECK(present.dstStages == VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+  }
+
+  FakeVulkan::commands.clear();                                           // 自行录制: 同样在endPass之后转换
+  RenderGraph::beginFrame(1);
+  RenderGraph::beginPass(cmd, g.geometry, VK_SUBPASS_CONTENTS_INLINE);
+  RenderGraph::endPass(cmd, g.geometry);
+  CHECK(FakeVulkan::countCommands(FAKE_CMD_PIPELINE_BARRIER) == 1);       // 交换链图像尚未使用, 不转换
+  RenderGraph::beginPass(cmd, g.light, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  RenderGraph::endPass(cmd, g.light);
+  const FakeCommand &last = FakeVulkan::commands.back();
+  CHECK(last.type == FAKE_CMD_PIPELINE_BARRIER && last.imageBarriers.size() == 1);
+  CHECK(last.imageBarriers[0].image == swapchain[1]);
+  CHECK(last.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+  RenderGraph::destroy(device);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(FakeVulkan::images.empty() && FakeVulkan::renderPasses.empty() && FakeVulkan::memories.empty());
+}
+
+int main() {
+  FakeVulkan::install();
+  testCullingAndAttachmentOps();
+  testTransientAliasing();
+  testExecuteAndFinalUsage();
+  printf("RenderGraphTest passed\n");
+  return 0;
+}
@@ -0,0 +1,311 @@
+#include <vector>
+#include "ResourceStateTracker.h"
+#include "TestUtil.h"
+
+/**
+ * 记录的一次vkCmdPipelineBarrier调用
+ */
+struct BarrierCall {
+  VkCommandBuffer cmd;
+  VkPipelineStageFlags srcStages;
+  VkPipelineStageFlags dstStages;
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+};
+
+static std::vector<BarrierCall> calls;                        // 按录制顺序记录的屏障调用
+
+static void fakeCmdPipelineBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStages,
+                                   VkPipelineStageFlags dstStages, VkDependencyFlags, uint32_t,
+                                   const VkMemoryBarrier *, uint32_t bufferCount,
+                                   const VkBufferMemoryBarrier *bufferBarriers, uint32_t imageCount,
+                                   const VkImageMemoryBarrier *imageBarriers) {
+  BarrierCall call;
+  call.cmd = cmd;
+  call.srcStages = srcStages;
+  call.dstStages = dstStages;
+  call.bufferBarriers.assign(bufferBarriers, bufferBarriers + bufferCount);
+  call.imageBarriers.assign(imageBarriers, imageBarriers + imageCount);
+  calls.push_back(call);
+}
+
+static VkCommandBuffer fakeCmd(uintptr_t id) {
+  return reinterpret_cast<VkCommandBuffer>(id);
+}
+
+static VkImage fakeImage(uintptr_t id) {
+  return (VkImage) id;
+}
+
+static VkBuffer fakeBuffer(uintptr_t id) {
+  return (VkBuffer) id;
+}
+
+/**
+ * 检查图像屏障的访问类型、布局与子资源范围
+ */
+static void checkImageBarrier(const VkImageMemoryBarrier &b, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                              VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseLevel,
+                              uint32_t levelCount, uint32_t baseLayer, uint32_t layerCount) {
+  CHECK(b.srcAccessMask == srcAccess && b.dstAccessMask == dstAccess);
+  CHECK(b.oldLayout == oldLayout && b.newLayout == newLayout);
+  CHECK(b.srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED && b.dstQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+  CHECK(b.subresourceRange.aspectMask == VK_IMAGE_ASPECT_COLOR_BIT);
+  CHECK(b.subresourceRange.baseMipLevel == baseLevel && b.subresourceRange.levelCount == levelCount);
+  CHECK(b.subresourceRange.baseArrayLayer == baseLayer && b.subresourceRange.layerCount == layerCount);
+}
+
+/**
+ * 检查整个缓冲的屏障
+ */
+static void checkBufferBarrier(const VkBufferMemoryBarrier &b, VkBuffer buffer, VkAccessFlags srcAccess,
+                               VkAccessFlags dstAccess) {
+  CHECK(b.buffer == buffer && b.offset == 0 && b.size == VK_WHOLE_SIZE);
+  CHECK(b.srcAccessMask == srcAccess && b.dstAccessMask == dstAccess);
+  CHECK(b.srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED && b.dstQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+}
+
+/**
+ * 纹理上传: 多个图像的转换合并为一次调用, 源阶段、目标阶段取实际访问的阶段; 重复采样不加屏障
+ */
+static void testUploadBatching() {
+  ResourceStateTracker::reset();
+  calls.clear();
+  VkCommandBuffer cmd = fakeCmd(0x10);
+  VkImage a = fakeImage(0x100);
+  VkImage b = fakeImage(0x101);
+  ResourceStateTracker::registerImage(a, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1);
+  ResourceStateTracker::registerImage(b, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1);
+  ResourceStateTracker::useImage(cmd, a, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::useImage(cmd, b, RESOURCE_USAGE_TRANSFER_WRITE);
+  CHECK(calls.empty());                                                   // flush之前不录制
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 1 && calls[0].cmd == cmd);
+  CHECK(calls[0].srcStages == VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);         // 新图像没有需要等待的访问
+  CHECK(calls[0].dstStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  CHECK(calls[0].bufferBarriers.empty() && calls[0].imageBarriers.size() == 2);
+  checkImageBarrier(calls[0].imageBarriers[0], 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, 1, 0, 1);
+  CHECK(calls[0].imageBarriers[0].image == a && calls[0].imageBarriers[1].image == b);
+
+  ResourceStateTracker::useImage(cmd, a, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED);
+  ResourceStateTracker::useImage(cmd, b, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 2);
+  CHECK(calls[1].srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  CHECK(calls[1].dstStages == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  CHECK(calls[1].imageBarriers.size() == 2);
+  checkImageBarrier(calls[1].imageBarriers[1], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 1, 0, 1);
+
+  long long skipped = ResourceStateTracker::skippedUses;
+  ResourceStateTracker::useImage(cmd, a, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED); // 写入已对片元着色器可见
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 2 && ResourceStateTracker::skippedUses == skipped + 1);
+  const ResourceState *state = ResourceStateTracker::imageState(a, 0, 0);
+  CHECK(state != nullptr && state->layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  CHECK(state->visibleStages == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+  ResourceStateTracker::forgetImage(a);
+  CHECK(ResourceStateTracker::imageState(a, 0, 0) == nullptr);
+  CHECK(ResourceStateTracker::imageState(b, 1, 0) == nullptr);            // 越界的子资源
+}
+
+/**
+ * mipmap生成: 上一级别作为源、本级别作为目标的两个屏障一次发出, 最后状态相同的级别合并为一个屏障
+ */
+static void testMipChain() {
+  ResourceStateTracker::reset();
+  calls.clear();
+  VkCommandBuffer cmd = fakeCmd(0x10);
+  VkImage image = fakeImage(0x200);
+  ResourceStateTracker::registerImage(image, VK_IMAGE_ASPECT_COLOR_BIT, 4, 1);
+  ResourceStateTracker::useImage(cmd, image, RESOURCE_USAGE_TRANSFER_WRITE, 0, 1);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 1 && calls[0].imageBarriers.size() == 1);
+  for (uint32_t i = 1; i < 4; ++i) {
+    ResourceStateTracker::useImage(cmd, image, RESOURCE_USAGE_TRANSFER_READ, i - 1, 1);
+    ResourceStateTracker::useImage(cmd, image, RESOURCE_USAGE_TRANSFER_WRITE, i, 1);
+    ResourceStateTracker::flush(cmd);
+    const BarrierCall &call = calls.back();
+    CHECK(calls.size() == 1 + i && call.imageBarriers.size() == 2);
+    CHECK(call.srcStages == (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
+    CHECK(call.dstStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+    checkImageBarrier(call.imageBarriers[0], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i - 1, 1, 0, 1);
+    checkImageBarrier(call.imageBarriers[1], 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, i, 1, 0, 1);
+  }
+  ResourceStateTracker::useImage(cmd, image, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED); // 所有级别转为采样布局
+  ResourceStateTracker::flush(cmd);
+  const BarrierCall &call = calls.back();
+  CHECK(calls.size() == 5 && call.imageBarriers.size() == 2);             // 级别0~2(被读取过)合并, 级别3单独
+  CHECK(call.srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  CHECK(call.dstStages == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  checkImageBarrier(call.imageBarriers[0], 0, VK_ACCESS_SHADER_READ_BIT,   // 读后转换只需执行依赖
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 3, 0, 1);
+  checkImageBarrier(call.imageBarriers[1], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 3, 1, 0, 1);
+}
+
+/**
+ * 数组纹理: 各层合并为一个屏障; 本批次已转换过的层再次需要屏障时先发出本批次
+ */
+static void testLayersAndConflict() {
+  ResourceStateTracker::reset();
+  calls.clear();
+  VkCommandBuffer cmd = fakeCmd(0x10);
+  VkImage image = fakeImage(0x300);
+  ResourceStateTracker::registerImage(image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 6);
+  ResourceStateTracker::useImage(cmd, image, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 1 && calls[0].imageBarriers.size() == 1);
+  checkImageBarrier(calls[0].imageBarriers[0], 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, 1, 0, 6);
+
+  ResourceStateTracker::useImage(cmd, image, RESOURCE_USAGE_TRANSFER_READ, 0, 1, 0, 2);
+  CHECK(calls.size() == 1);
+  ResourceStateTracker::useImage(cmd, image, RESOURCE_USAGE_FRAGMENT_SHADER_SAMPLED); // 层0~1与待发出的屏障冲突
+  CHECK(calls.size() == 2);
+  checkImageBarrier(calls[1].imageBarriers[0], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, 1, 0, 2);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 3 && calls[2].imageBarriers.size() == 2);
+  CHECK(calls[2].srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  checkImageBarrier(calls[2].imageBarriers[0], 0, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 1, 0, 2);
+  checkImageBarrier(calls[2].imageBarriers[1], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 1, 2, 4);
+
+  VkCommandBuffer other = fakeCmd(0x11);                                  // 各命令缓冲的批次相互独立
+  VkImage second = fakeImage(0x301);
+  ResourceStateTracker::registerImage(second, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1);
+  ResourceStateTracker::useImage(other, second, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 3);
+  ResourceStateTracker::flush(other);
+  CHECK(calls.size() == 4 && calls[3].cmd == other);
+}
+
+/**
+ * 读回缓冲(HeadlessRenderer): 新缓冲的拷贝写入不需要屏障, 主机读取前让拷贝结果对主机可见
+ */
+static void testReadbackBuffer() {
+  ResourceStateTracker::reset();
+  calls.clear();
+  VkCommandBuffer cmd = fakeCmd(0x10);
+  VkBuffer buffer = fakeBuffer(0x400);
+  ResourceStateTracker::registerBuffer(buffer);
+  ResourceStateTracker::useBuffer(cmd, buffer, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.empty());
+  ResourceStateTracker::useBuffer(cmd, buffer, RESOURCE_USAGE_HOST_READ);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 1 && calls[0].imageBarriers.empty() && calls[0].bufferBarriers.size() == 1);
+  CHECK(calls[0].srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT && calls[0].dstStages == VK_PIPELINE_STAGE_HOST_BIT);
+  checkBufferBarrier(calls[0].bufferBarriers[0], buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+  const ResourceState *state = ResourceStateTracker::bufferState(buffer);
+  CHECK(state != nullptr && state->visibleAccess == VK_ACCESS_HOST_READ_BIT);
+  ResourceStateTracker::forgetBuffer(buffer);
+  CHECK(ResourceStateTracker::bufferState(buffer) == nullptr);
+}
+
+/**
+ * 几何缓冲池整理(GeometryPool): 顶点与索引缓冲各拷贝到新缓冲, 拷贝写入对顶点输入可见;
+ * 下一次整理读取上次整理写入的缓冲时先让写入对传输阶段可见
+ */
+static void testCompactionBuffers() {
+  ResourceStateTracker::reset();
+  calls.clear();
+  VkCommandBuffer cmd = fakeCmd(0x10);
+  VkBuffer vertexOld = fakeBuffer(0x500);
+  VkBuffer vertexNew = fakeBuffer(0x501);
+  VkBuffer indexOld = fakeBuffer(0x502);
+  VkBuffer indexNew = fakeBuffer(0x503);
+  ResourceStateTracker::registerBuffer(vertexOld);
+  ResourceStateTracker::registerBuffer(vertexNew);
+  ResourceStateTracker::registerBuffer(indexOld);
+  ResourceStateTracker::registerBuffer(indexNew);
+
+  ResourceStateTracker::useBuffer(cmd, vertexOld, RESOURCE_USAGE_TRANSFER_READ); // 顶点缓冲整理
+  ResourceStateTracker::useBuffer(cmd, vertexNew, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.empty());
+  ResourceStateTracker::useBuffer(cmd, vertexNew, RESOURCE_USAGE_VERTEX_BUFFER);
+  ResourceStateTracker::useBuffer(cmd, indexOld, RESOURCE_USAGE_TRANSFER_READ); // 索引缓冲整理
+  ResourceStateTracker::useBuffer(cmd, indexNew, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::flush(cmd);                                       // 发出顶点缓冲拷贝后的屏障
+  CHECK(calls.size() == 1 && calls[0].bufferBarriers.size() == 1);
+  CHECK(calls[0].srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  CHECK(calls[0].dstStages == VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+  checkBufferBarrier(calls[0].bufferBarriers[0], vertexNew, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  ResourceStateTracker::useBuffer(cmd, indexNew, RESOURCE_USAGE_INDEX_BUFFER);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 2 && calls[1].dstStages == VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+  checkBufferBarrier(calls[1].bufferBarriers[0], indexNew, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+  ResourceStateTracker::useBuffer(cmd, vertexNew, RESOURCE_USAGE_VERTEX_BUFFER); // 之后各帧绑定读取: 不加屏障
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 2);
+
+  VkBuffer vertexNext = fakeBuffer(0x504);                                // 再次整理
+  ResourceStateTracker::forgetBuffer(vertexOld);
+  ResourceStateTracker::registerBuffer(vertexNext);
+  ResourceStateTracker::useBuffer(cmd, vertexNew, RESOURCE_USAGE_TRANSFER_READ);
+  ResourceStateTracker::useBuffer(cmd, vertexNext, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 3 && calls[2].bufferBarriers.size() == 1);
+  CHECK(calls[2].srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT && calls[2].dstStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  checkBufferBarrier(calls[2].bufferBarriers[0], vertexNew, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_ACCESS_TRANSFER_READ_BIT);
+}
+
+/**
+ * 读后写只需等待读取过的阶段(执行依赖); 同一批次中再次需要屏障时先发出本批次; 队列家族变化时转移所有权
+ */
+static void testBufferHazards() {
+  ResourceStateTracker::reset();
+  calls.clear();
+  VkCommandBuffer cmd = fakeCmd(0x10);
+  VkBuffer buffer = fakeBuffer(0x600);
+  ResourceStateTracker::registerBuffer(buffer);
+  ResourceStateTracker::useBuffer(cmd, buffer, RESOURCE_USAGE_TRANSFER_WRITE);
+  ResourceStateTracker::useBuffer(cmd, buffer, RESOURCE_USAGE_VERTEX_BUFFER);
+  CHECK(calls.empty());
+  ResourceStateTracker::useBuffer(cmd, buffer, RESOURCE_USAGE_TRANSFER_WRITE); // 与待发出的屏障冲突
+  CHECK(calls.size() == 1);
+  checkBufferBarrier(calls[0].bufferBarriers[0], buffer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 2);
+  CHECK(calls[1].srcStages == VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);          // 读后写: 只等待读取的阶段
+  CHECK(calls[1].dstStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  checkBufferBarrier(calls[1].bufferBarriers[0], buffer, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+  ResourceStateTracker::useBuffer(cmd, buffer, ResourceStateTracker::accessOf(RESOURCE_USAGE_TRANSFER_READ), 0);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 3);                                               // 之前未指定家族: 只是写后读
+  ResourceStateTracker::useBuffer(cmd, buffer, ResourceStateTracker::accessOf(RESOURCE_USAGE_INDEX_BUFFER), 1);
+  ResourceStateTracker::flush(cmd);
+  CHECK(calls.size() == 4);
+  const VkBufferMemoryBarrier &transfer = calls[3].bufferBarriers[0];
+  CHECK(transfer.srcQueueFamilyIndex == 0 && transfer.dstQueueFamilyIndex == 1);
+  CHECK(transfer.srcAccessMask == 0 && transfer.dstAccessMask == VK_ACCESS_INDEX_READ_BIT);
+  CHECK(calls[3].srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT);
+  CHECK(ResourceStateTracker::bufferState(buffer)->queueFamily == 1);
+}
+
+int main() {
+  vk::vkCmdPipelineBarrier = fakeCmdPipelineBarrier;
+  testUploadBatching();
+  testMipChain();
+  testLayersAndConflict();
+  testReadbackBuffer();
+  testCompactionBuffers();
+  testBufferHazards();
+  ResourceStateTracker::logStats();
+  ResourceStateTracker::reset();
+  printf("ResourceStateTrackerTest passed\n");
+  return 0;
+}
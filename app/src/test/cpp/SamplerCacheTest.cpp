@@ -0,0 +1,130 @@
+#include <cstring>
+#include "SamplerCache.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+static VkDevice device = (VkDevice) 0x1;
+static VkPhysicalDevice gpu = reinterpret_cast<VkPhysicalDevice>(0x2);
+
+/**
+ * 逐个字段填写的创建信息(填充字节为非零值, 哈希值不应受其影响)
+ */
+static VkSamplerCreateInfo createInfo(VkFilter filter, VkSamplerAddressMode addressMode, float maxLod) {
+  VkSamplerCreateInfo info;
+  memset(&info, 0xCD, sizeof(info));
+  info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  info.pNext = nullptr;
+  info.flags = 0;
+  info.magFilter = filter;
+  info.minFilter = filter;
+  info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  info.addressModeU = addressMode;
+  info.addressModeV = addressMode;
+  info.addressModeW = addressMode;
+  info.mipLodBias = 0;
+  info.anisotropyEnable = VK_FALSE;
+  info.maxAnisotropy = 1;
+  info.compareEnable = VK_FALSE;
+  info.compareOp = VK_COMPARE_OP_NEVER;
+  info.minLod = 0;
+  info.maxLod = maxLod;
+  info.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+  info.unnormalizedCoordinates = VK_FALSE;
+  return info;
+}
+
+static void initCache(bool anisotropy) {
+  FakeVulkan::reset();
+  FakeVulkan::features.samplerAnisotropy = anisotropy ? VK_TRUE : VK_FALSE;
+  FakeVulkan::properties.limits.maxSamplerAnisotropy = 16;
+  SamplerCache::init(gpu);
+}
+
+static void destroyCache() {
+  SamplerCache::destroy(device);
+  CHECK(SamplerCache::size() == 0 && FakeVulkan::samplers.empty());
+}
+
+/**
+ * 去重: 相等的创建信息得到同一个采样器, 只创建一次; 任一有效字段不同时创建新的采样器
+ */
+static void testDedup() {
+  initCache(true);
+  VkSamplerCreateInfo info = createInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, 8);
+  VkSampler sampler = SamplerCache::get(device, info);
+  CHECK(FakeVulkan::samplers.size() == 1 && FakeVulkan::samplers[sampler].maxLod == 8);
+  VkSamplerCreateInfo copy = createInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, 8);
+  CHECK(SamplerCache::get(device, copy) == sampler);
+  CHECK(SamplerCache::get(device, info) == sampler);
+  CHECK(SamplerCache::size() == 1 && FakeVulkan::samplers.size() == 1);
+  CHECK(SamplerCache::requestCount == 3 && SamplerCache::hitCount == 2);
+
+  VkSamplerCreateInfo variants[4] = {
+      createInfo(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT, 8),
+      createInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 8),
+      createInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, 4),
+      createInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, 8)};
+  variants[3].addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+  for (int i = 0; i < 4; ++i) {
+    CHECK(SamplerCache::get(device, variants[i]) != sampler);
+    CHECK(SamplerCache::size() == 2 + i);
+  }
+  for (int i = 0; i < 4; ++i) {
+    SamplerCache::get(device, variants[i]);
+  }
+  CHECK(FakeVulkan::samplers.size() == 5 && SamplerCache::hitCount == 6);
+
+  SamplerDesc desc;                                                       // 采样方式与等价的创建信息共用采样器
+  VkSamplerCreateInfo fromDesc = SamplerCache::toCreateInfo(desc);
+  VkSampler descSampler = SamplerCache::get(device, desc);
+  CHECK(SamplerCache::get(device, fromDesc) == descSampler && FakeVulkan::samplers.size() == 6);
+  destroyCache();
+}
+
+/**
+ * 归一化: 不起作用的字段(未启用比较时的compareOp、未启用各向异性时的maxAnisotropy、
+ * 不使用边框时的borderColor)不影响命中; 各向异性过滤值按设备上限截取
+ */
+static void testNormalization() {
+  initCache(true);
+  VkSamplerCreateInfo base = createInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, 1);
+  VkSampler sampler = SamplerCache::get(device, base);
+
+  VkSamplerCreateInfo info = base;
+  info.compareOp = VK_COMPARE_OP_LESS;
+  info.maxAnisotropy = 8;
+  info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  CHECK(SamplerCache::get(device, info) == sampler);
+  info.compareEnable = VK_TRUE;
+  CHECK(SamplerCache::get(device, info) != sampler);
+
+  VkSamplerCreateInfo border = createInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER, 1);
+  VkSampler black = SamplerCache::get(device, border);
+  border.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  CHECK(SamplerCache::get(device, border) != black);                      // 边框拉伸方式使用边框颜色
+
+  VkSamplerCreateInfo aniso = base;
+  aniso.anisotropyEnable = VK_TRUE;
+  aniso.maxAnisotropy = 16;
+  VkSampler anisoSampler = SamplerCache::get(device, aniso);
+  CHECK(anisoSampler != sampler && FakeVulkan::samplers[anisoSampler].maxAnisotropy == 16);
+  aniso.maxAnisotropy = 64;                                               // 超过设备上限: 截取后命中
+  CHECK(SamplerCache::get(device, aniso) == anisoSampler);
+  aniso.maxAnisotropy = 4;
+  CHECK(SamplerCache::get(device, aniso) != anisoSampler);
+  destroyCache();
+
+  initCache(false);                                                       // 设备不支持时退回普通过滤
+  sampler = SamplerCache::get(device, base);
+  CHECK(SamplerCache::get(device, aniso) == sampler);
+  CHECK(FakeVulkan::samplers[sampler].anisotropyEnable == VK_FALSE && SamplerCache::size() == 1);
+  destroyCache();
+}
+
+int main() {
+  FakeVulkan::install();
+  testDedup();
+  testNormalization();
+  printf("SamplerCacheTest passed\n");
+  return 0;
+}
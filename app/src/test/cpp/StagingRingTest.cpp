@@ -0,0 +1,104 @@
+#include "StagingRing.h"
+#include "DeviceMemoryAllocator.h"
+#include "FakeVulkan.h"
+#include "TestUtil.h"
+
+static VkDevice device = (VkDevice) 0x1;
+static VkQueue queue = reinterpret_cast<VkQueue>(0x2);
+static VkCommandBuffer cmd = reinterpret_cast<VkCommandBuffer>(0x3);
+
+/**
+ * 栅栏由测试触发, 中转环形缓冲为1024字节
+ */
+static void createRing() {
+  FakeVulkan::reset();
+  FakeVulkan::autoSignalFences = false;
+  DeviceMemoryAllocator::init(FakeVulkan::memoryProperties, 1024, 64);
+  StagingRing::create(device, FakeVulkan::memoryProperties, 1024);
+  CHECK(StagingRing::capacity == 1024);
+}
+
+static void destroyRing() {
+  StagingRing::destroy(device);
+  DeviceMemoryAllocator::destroy(device);
+  CHECK(FakeVulkan::buffers.empty() && FakeVulkan::fences.empty() && FakeVulkan::memories.empty());
+}
+
+static VkDeviceSize allocate(VkDeviceSize size) {
+  VkDeviceSize offset = 0;
+  uint8_t *data = nullptr;
+  CHECK(StagingRing::allocate(device, size, STAGING_COPY_ALIGNMENT, offset, data));
+  CHECK(data == FakeVulkan::hostData(StagingRing::buffer) + offset);      // 返回持久映射中的地址
+  CHECK(offset % STAGING_COPY_ALIGNMENT == 0 && offset + size <= StagingRing::capacity);
+  return offset;
+}
+
+/**
+ * 回绕: 末尾放不下时, 最早的提交完成后从缓冲开头分配, 不阻塞等待
+ */
+static void testWrapAround() {
+  createRing();
+  CHECK(allocate(400) == 0);
+  VkFence first = StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  CHECK(allocate(390) == 400);
+  VkFence second = StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  CHECK(first != second && FakeVulkan::submits.size() == 2);
+  CHECK(FakeVulkan::submits[1].fence == second && FakeVulkan::submits[1].commandBuffers[0] == cmd);
+
+  FakeVulkan::signalFence(first);
+  CHECK(allocate(10) == 800);                                             // 对齐到16
+  CHECK(allocate(400) == 0);                                              // 末尾只剩208字节, 回绕到已回收的开头
+  CHECK(StagingRing::stallCount == 0 && FakeVulkan::fenceWaits == 0);
+  VkFence third = StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  CHECK(third == first);                                                  // 回收的栅栏被重用
+  CHECK(FakeVulkan::fences[first] == false);                              // 重用前已重置
+
+  FakeVulkan::signalFence(second);
+  FakeVulkan::signalFence(third);
+  CHECK(StagingRing::poll(device, third));
+  CHECK(allocate(1024) == 0);                                             // 全部回收后整个缓冲可用
+  StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  CHECK(StagingRing::allocatedBytes == 400 + 390 + 10 + 400 + 1024);
+  destroyRing();
+}
+
+/**
+ * 回收: 栅栏触发之前区域不被重用, 空间不足时阻塞等待最早的栅栏; 尚未提交的分配占满缓冲时返回false
+ */
+static void testReclaimAfterFence() {
+  createRing();
+  CHECK(allocate(600) == 0);
+  VkFence first = StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  CHECK(!StagingRing::poll(device, first));
+  CHECK(allocate(300) == 608);                                            // 未完成的区域之后
+  CHECK(!StagingRing::poll(device, first) && FakeVulkan::fenceWaits == 0);
+
+  CHECK(allocate(500) == 0);                                              // 只能回绕: 须等待第一次提交
+  CHECK(StagingRing::stallCount == 1 && FakeVulkan::fenceWaits == 1);
+  CHECK(StagingRing::poll(device, first));
+  VkFence second = StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  CHECK(second == first);
+
+  CHECK(allocate(200) == 0);                                              // [500, 608)放不下, 等待第二次提交
+  CHECK(StagingRing::stallCount == 2 && FakeVulkan::fenceWaits == 2);
+  StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  StagingRing::waitIdle(device);
+
+  VkDeviceSize offset;
+  uint8_t *data;
+  CHECK(allocate(1024) == 0);
+  CHECK(!StagingRing::allocate(device, 16, STAGING_COPY_ALIGNMENT, offset, data)); // 未提交的分配占满缓冲
+  StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  StagingRing::wait(device, FakeVulkan::submits.back().fence);
+  CHECK(allocate(16) == 0);
+  StagingRing::submit(device, queue, cmd, VK_NULL_HANDLE);
+  destroyRing();
+}
+
+int main() {
+  FakeVulkan::install();
+  testWrapAround();
+  testReclaimAfterFence();
+  printf("StagingRingTest passed\n");
+  return 0;
+}
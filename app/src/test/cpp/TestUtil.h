@@ -0,0 +1,19 @@
+#ifndef DEEPERVULKAN_TESTUTIL_H_
+#define DEEPERVULKAN_TESTUTIL_H_
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * 主机测试的检查: 失败时打印位置与条件并立即以非0退出(不受NDEBUG影响, 也不析构仍在运行的工作线程)
+ */
+#define CHECK(condition)                                                        \
+  do {                                                                          \
+    if (!(condition)) {                                                         \
+      printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #condition);                \
+      fflush(stdout);                                                           \
+      _Exit(1);                                                                 \
+    }                                                                           \
+  } while (0)
+
+#endif //DEEPERVULKAN_TESTUTIL_H_
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <vector>
+#include "TextureAtlas.h"
+#include "TestUtil.h"
+
+/**
+ * 矩形(检查重叠用)
+ */
+struct Box {
+  int x, y, width, height;
+};
+
+static bool overlaps(const Box &a, const Box &b) {
+  return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static bool isPowerOfTwo(int v) {
+  return v > 0 && (v & (v - 1)) == 0;
+}
+
+/**
+ * 子纹理i在(x, y)处的像素: 各子纹理、各位置互不相同
+ */
+static void pixelOf(int i, int x, int y, unsigned char *rgba) {
+  rgba[0] = (unsigned char) (i * 37 + 1);
+  rgba[1] = (unsigned char) x;
+  rgba[2] = (unsigned char) y;
+  rgba[3] = (unsigned char) (x * 7 + y * 13);
+}
+
+static TexDataObject *makeImage(int i, int width, int height) {
+  int byteCount = width * height * 4;
+  unsigned char *data = new unsigned char[byteCount];
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      pixelOf(i, x, y, data + (y * width + x) * 4);
+    }
+  }
+  return new TexDataObject(width, height, data, byteCount);
+}
+
+/**
+ * 装箱: 放入的矩形互不重叠且不超出边界; 恰好填满后再放入失败
+ */
+static void testPackerNoOverlap() {
+  AtlasPacker exact(128, 128);
+  std::vector<Box> boxes;
+  for (int i = 0; i < 4; ++i) {
+    Box b = {0, 0, 64, 64};
+    CHECK(exact.insert(64, 64, b.x, b.y));
+    for (size_t j = 0; j < boxes.size(); ++j) {
+      CHECK(!overlaps(b, boxes[j]));
+    }
+    boxes.push_back(b);
+  }
+  int x, y;
+  CHECK(!exact.insert(1, 1, x, y));
+
+  AtlasPacker packer(512, 512);                                           // 伪随机尺寸, 放满为止
+  boxes.clear();
+  unsigned int seed = 12345;
+  long long usedArea = 0;
+  int failures = 0;
+  while (failures < 16) {
+    seed = seed * 1103515245u + 12345u;
+    int w = 4 + (int) ((seed >> 8) % 60);
+    seed = seed * 1103515245u + 12345u;
+    int h = 4 + (int) ((seed >> 8) % 60);
+    Box b = {0, 0, w, h};
+    if (!packer.insert(w, h, b.x, b.y)) {
+      failures++;
+      continue;
+    }
+    CHECK(b.x >= 0 && b.y >= 0 && b.x + w <= 512 && b.y + h <= 512);
+    for (size_t j = 0; j < boxes.size(); ++j) {
+      CHECK(!overlaps(b, boxes[j]));
+    }
+    boxes.push_back(b);
+    usedArea += (long long) w * h;
+  }
+  CHECK(boxes.size() > 50);
+  CHECK(usedArea > 512 * 512 * 7 / 10);                                   // 最短边最佳适配的填充率
+}
+
+/**
+ * 生成图集: 宽高为2的幂, 子纹理连同间隔互不重叠且按最低一级mipmap对齐,
+ * 子纹理像素原样拷贝, 间隔为最近的边缘像素, 纹理坐标与区域一致
+ */
+static void testBuild() {
+  const int sizes[][2] = {{100, 60}, {32, 32}, {1, 1}, {64, 17}, {7, 90}, {50, 50}, {128, 8}, {3, 5}};
+  const int count = (int) (sizeof(sizes) / sizeof(sizes[0]));
+  const int padding = 2;
+  const int mipLevels = 3;
+  const int align = 1 << (mipLevels - 1);
+  std::vector<TexDataObject *> images;
+  for (int i = 0; i < count; ++i) {
+    images.push_back(makeImage(i, sizes[i][0], sizes[i][1]));
+  }
+  std::vector<AtlasRegion> regions;
+  TexDataObject *atlas = TextureAtlas::build(images, padding, mipLevels, regions);
+  CHECK(atlas != nullptr && regions.size() == (size_t) count);
+  CHECK(isPowerOfTwo(atlas->width) && isPowerOfTwo(atlas->height));
+  CHECK(atlas->dataByteCount == atlas->width * atlas->height * 4);
+  int gap = std::max(padding, align);                                     // 间隔不小于对齐粒度
+
+  for (int i = 0; i < count; ++i) {
+    const AtlasRegion &r = regions[i];
+    CHECK(r.width == sizes[i][0] && r.height == sizes[i][1]);
+    CHECK((r.x - gap) % align == 0 && (r.y - gap) % align == 0);
+    Box cell = {r.x - gap, r.y - gap, r.width + gap * 2, r.height + gap * 2};
+    CHECK(cell.x >= 0 && cell.y >= 0 && cell.x + cell.width <= atlas->width && cell.y + cell.height <= atlas->height);
+    for (int j = 0; j < i; ++j) {
+      const AtlasRegion &o = regions[j];
+      Box other = {o.x - gap, o.y - gap, o.width + gap * 2, o.height + gap * 2};
+      CHECK(!overlaps(cell, other));
+    }
+    CHECK(r.u0 == (float) r.x / atlas->width && r.u1 == (float) (r.x + r.width) / atlas->width);
+    CHECK(r.v0 == (float) r.y / atlas->height && r.v1 == (float) (r.y + r.height) / atlas->height);
+
+    for (int y = -gap; y < r.height + gap; ++y) {
+      for (int x = -gap; x < r.width + gap; ++x) {
+        unsigned char expected[4];
+        pixelOf(i, std::min(std::max(x, 0), r.width - 1), std::min(std::max(y, 0), r.height - 1), expected);
+        const unsigned char *texel = atlas->data + ((size_t) (r.y + y) * atlas->width + r.x + x) * 4;
+        CHECK(std::equal(expected, expected + 4, texel));
+      }
+    }
+
+    float s = 0, t = 1;
+    TextureAtlas::remap(r, s, t);
+    CHECK(s == r.u0 && t == r.v1);
+    s = -0.5f;                                                            // 超出范围的坐标截取到区域内
+    t = 1.5f;
+    TextureAtlas::remap(r, s, t);
+    CHECK(s == r.u0 && t == r.v1);
+  }
+
+  float vdata[] = {9, 0.0f, 0.0f, 9, 1.0f, 1.0f};                         // 每个顶点: 位置, 纹理坐标
+  TextureAtlas::remapVertexData(regions[0], vdata, 2, 3, 1);
+  CHECK(vdata[0] == 9 && vdata[1] == regions[0].u0 && vdata[2] == regions[0].v0);
+  CHECK(vdata[3] == 9 && vdata[4] == regions[0].u1 && vdata[5] == regions[0].v1);
+
+  delete atlas;
+  for (int i = 0; i < count; ++i) {
+    delete images[i];
+  }
+}
+
+/**
+ * 超出最大尺寸时返回nullptr
+ */
+static void testTooLarge() {
+  std::vector<TexDataObject *> images;
+  images.push_back(new TexDataObject(ATLAS_MAX_SIZE, 1, new unsigned char[ATLAS_MAX_SIZE * 4], ATLAS_MAX_SIZE * 4));
+  std::vector<AtlasRegion> regions;
+  CHECK(TextureAtlas::build(images, 1, 1, regions) == nullptr);          // 加上间隔后超出
+  delete images[0];
+}
+
+int main() {
+  testPackerNoOverlap();
+  testBuild();
+  testTooLarge();
+  printf("TextureAtlasTest passed\n");
+  return 0;
+}
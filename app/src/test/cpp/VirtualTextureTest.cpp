@@ -0,0 +1,109 @@
+#include <cstring>
+#include <vector>
+#include "VirtualTexture.h"
+#include "TestUtil.h"
+
+/**
+ * 合成瓦片: 前4字节为页标识
+ */
+static void readTile(int mip, int pageX, int pageY, unsigned char *dst) {
+  VtPageKey key = VT_PAGE_KEY(mip, pageX, pageY);
+  memset(dst, 0, VT_TILE_BYTES);
+  memcpy(dst, &key, sizeof(key));
+}
+
+/**
+ * 一帧: 处理反馈, 取出放入缓存的瓦片并检查瓦片与页对应, 返回放入的页
+ */
+static std::vector<VtTileUpload> step(VirtualTexture &vt, const std::vector<uint32_t> &feedback) {
+  vt.processFeedback(feedback.data(), (int) feedback.size());
+  std::vector<VtTileUpload> uploads;
+  vt.update(uploads);
+  for (size_t i = 0; i < uploads.size(); ++i) {
+    VtPageKey key;
+    memcpy(&key, uploads[i].pixels, sizeof(key));
+    CHECK(key == uploads[i].key);
+    CHECK(uploads[i].slotY * vt.cacheCols + uploads[i].slotX == uploads[i].slot);
+    delete[] uploads[i].pixels;
+  }
+  return uploads;
+}
+
+static void checkTexel(const std::vector<unsigned char> &indirection, int pagesX0, int x, int y,
+                       int slotX, int slotY, int mip) {
+  const unsigned char *texel = &indirection[(y * pagesX0 + x) * 4];
+  CHECK(texel[0] == slotX && texel[1] == slotY && texel[2] == mip && texel[3] == 255);
+}
+
+/**
+ * 4x2页的第0级(共3级)与2x2槽位的缓存: 页驻留、LRU逐出与间接纹理内容
+ */
+static void testResidencyAndEviction() {
+  VirtualTexture vt(4 * VT_TILE_CONTENT, 2 * VT_TILE_CONTENT, 2, 2, readTile, false);
+  CHECK(vt.levels == 3 && vt.pagesX(0) == 4 && vt.pagesY(0) == 2 && vt.pagesX(1) == 2 && vt.pagesY(1) == 1);
+  std::vector<uint32_t> feedback(8, VT_FEEDBACK_NONE);
+  std::vector<unsigned char> indirection(8 * 4);
+
+  // 第0帧: 只有最粗一级, 放入0号槽位, 上传完成前不映射
+  std::vector<VtTileUpload> uploads = step(vt, feedback);
+  CHECK(uploads.size() == 1 && uploads[0].key == VT_PAGE_KEY(2, 0, 0) && uploads[0].slot == 0);
+  CHECK(vt.residentSlot(2, 0, 0) == -1);
+  vt.completeUpload(0);
+  CHECK(vt.residentSlot(2, 0, 0) == 0 && vt.indirectionDirty());
+  vt.buildIndirection(indirection.data(), 4 * 4);
+  CHECK(!vt.indirectionDirty());
+  for (int i = 0; i < 8; ++i) {
+    checkTexel(indirection, 4, i % 4, i / 4, 0, 0, 2);                    // 全部回退到最粗一级
+  }
+
+  // 第1帧: 第0级(0,0)页需要第0级, 先放入粗一级的上级页
+  feedback[0] = 0;
+  uploads = step(vt, feedback);
+  CHECK(uploads.size() == 2);
+  CHECK(uploads[0].key == VT_PAGE_KEY(1, 0, 0) && uploads[0].slot == 1);
+  CHECK(uploads[1].key == VT_PAGE_KEY(0, 0, 0) && uploads[1].slot == 2);
+  vt.completeUpload(1);
+  vt.completeUpload(2);
+  CHECK(vt.requestedPages == 1 && vt.residentHits == 0);
+  vt.buildIndirection(indirection.data(), 4 * 4);
+  checkTexel(indirection, 4, 0, 0, 0, 1, 0);                              // 请求的级别已常驻
+  checkTexel(indirection, 4, 1, 0, 1, 0, 1);                              // 未请求的页取最细常驻页
+  checkTexel(indirection, 4, 2, 0, 0, 0, 2);
+
+  // 第2帧: 只请求第0级(3,1)页; 最后一个空闲槽位给上级页, 第0级页逐出最久未使用的(1,0,0)
+  feedback[0] = VT_FEEDBACK_NONE;
+  feedback[7] = 0;
+  uploads = step(vt, feedback);
+  CHECK(uploads.size() == 2);
+  CHECK(uploads[0].key == VT_PAGE_KEY(1, 1, 0) && uploads[0].slot == 3);
+  CHECK(uploads[1].key == VT_PAGE_KEY(0, 3, 1) && uploads[1].slot == 1);
+  CHECK(vt.evictedTiles == 1 && vt.droppedTiles == 0);
+  CHECK(vt.residentSlot(1, 0, 0) == -1);                                  // 逐出的页立即从页表中移除
+  CHECK(vt.residentSlot(0, 0, 0) == 2 && vt.residentSlot(2, 0, 0) == 0);
+  vt.buildIndirection(indirection.data(), 4 * 4);
+  checkTexel(indirection, 4, 1, 0, 0, 0, 2);                              // 上级页被逐出后回退到最粗一级
+  checkTexel(indirection, 4, 3, 1, 0, 0, 2);                              // 上传完成前仍回退
+  vt.completeUpload(3);
+  vt.completeUpload(1);
+  vt.buildIndirection(indirection.data(), 4 * 4);
+  checkTexel(indirection, 4, 3, 1, 1, 0, 0);
+  checkTexel(indirection, 4, 2, 1, 1, 1, 1);
+  checkTexel(indirection, 4, 0, 0, 0, 1, 0);
+
+  // 第3帧: 所有槽位都在本帧被引用(protectFrames), 新页无处可放时丢弃并在之后重新请求
+  feedback[0] = 0;
+  feedback[2] = 0;
+  uploads = step(vt, feedback);
+  CHECK(vt.requestedPages == 5 && vt.residentHits == 2);                 // (0,0)与(3,1)已常驻
+  CHECK(uploads.empty() && vt.droppedTiles == 2 && vt.evictedTiles == 1); // 被逐出的(1,0,0)与新的(0,2,0)
+  CHECK(vt.residentSlot(0, 2, 0) == -1);
+  CHECK(vt.residentSlot(2, 0, 0) == 0);                                   // 最粗一级常驻不逐出
+}
+
+int main() {
+  testResidencyAndEviction();
+  CHECK(VirtualTexture::simulate(16384, 8192, 16, 16, 600, false));      // 模拟的反馈流: 页表、缓存与间接纹理一致
+  CHECK(VirtualTexture::simulate(4096, 4096, 8, 8, 200, true));          // 加载线程
+  printf("VirtualTextureTest passed\n");
+  return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef DEEPERVULKAN_TEST_ANDROID_LOG_H_
+#define DEEPERVULKAN_TEST_ANDROID_LOG_H_
+
+#include <cstdarg>
+#include <cstdio>
+
+/**
+ * 主机测试用的android/log.h: mylog.h中的LOGI、LOGW、LOGE输出到标准输出
+ */
+enum {
+  ANDROID_LOG_INFO = 4,
+  ANDROID_LOG_WARN = 5,
+  ANDROID_LOG_ERROR = 6
+};
+
+inline int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  printf("%s: ", prio == ANDROID_LOG_ERROR ? "E" : (prio == ANDROID_LOG_WARN ? "W" : "I"));
+  int n = vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+  return n;
+}
+
+#endif //DEEPERVULKAN_TEST_ANDROID_LOG_H_